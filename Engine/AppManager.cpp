@@ -271,6 +271,12 @@ AppManager::getMaxThreadCount()
     return QThreadPool::globalInstance()->maxThreadCount();
 }
 
+TaskScheduler*
+AppManager::getTaskScheduler() const
+{
+    return _imp->taskScheduler.get();
+}
+
 AppManager::AppManager()
     : QObject()
     , _imp( new AppManagerPrivate() )
@@ -457,6 +463,9 @@ AppManager::~AppManager()
         }
     }
 
+    ///Let the scheduler finish its pending tasks before the plug-ins and caches are destroyed
+    _imp->taskScheduler.reset();
+
     for (PluginsMap::iterator it = _imp->_plugins.begin(); it != _imp->_plugins.end(); ++it) {
         for (PluginVersionsOrdered::reverse_iterator itver = it->second.rbegin(); itver != it->second.rend(); ++itver) {
             delete *itver;
@@ -965,6 +974,7 @@ AppManager::loadInternalAfterInitGui(const CLArgs& cl)
         U64 maxDiskCacheNode = _imp->_settings->getMaximumDiskCacheNodeSize();
 
         _imp->_nodeCache = std::make_shared<Cache<Image> >("NodeCache", NATRON_CACHE_VERSION, maxCacheRAM, 1.);
+        _imp->_nodeCache->setMaximumCompressedSize( _imp->_settings->getCompressedRamPercent() * getSystemTotalRAM() );
         _imp->_diskCache = std::make_shared<Cache<Image> >("DiskCache", NATRON_CACHE_VERSION, maxDiskCacheNode, 0.);
         _imp->_viewerCache = std::make_shared<Cache<FrameEntry> >("ViewerCache", NATRON_CACHE_VERSION, viewerCacheSize, 0.);
         _imp->setViewerCacheTileSize();
@@ -985,6 +995,8 @@ AppManager::loadInternalAfterInitGui(const CLArgs& cl)
     if (oldCacheVersion != NATRON_CACHE_VERSION || cl.isCacheClearRequestedOnLaunch()) {
         setLoadingStatus( tr("Clearing the image cache...") );
         wipeAndCreateDiskCacheStructure();
+        // Start the persistent indexes of the new caches
+        _imp->restoreCaches();
     } else {
         setLoadingStatus( tr("Restoring the image cache...") );
         _imp->restoreCaches();
@@ -1330,6 +1342,7 @@ AppManager::wipeAndCreateDiskCacheStructure()
 
     assert(_imp->_diskCache);
     _imp->cleanUpCacheDiskStructure( _imp->_diskCache->getCachePath(), false );
+    _imp->_diskCache->clearPersistentIndex();
     assert(_imp->_viewerCache);
     _imp->cleanUpCacheDiskStructure( _imp->_viewerCache->getCachePath() , true);
 }
@@ -1396,6 +1409,13 @@ AppManager::setApplicationsCachesMaximumMemoryPercent(double p)
     _imp->_nodeCache->setMaximumInMemorySize(1);
 }
 
+void
+AppManager::setApplicationsCachesMaximumCompressedMemoryPercent(double p)
+{
+    _imp->_nodeCache->setMaximumCompressedSize( p * getSystemTotalRAM_conditionnally() );
+    _imp->_nodeCache->clearExceedingEntries();
+}
+
 void
 AppManager::setApplicationsCachesMaximumViewerDiskSpace(unsigned long long size)
 {
@@ -2470,6 +2490,34 @@ AppManager::getTextureOrCreate(const FrameKey & key,
     return _imp->_viewerCache->getOrCreate(key, params, locker, returnValue);
 }
 
+void
+AppManager::prefetchImages_diskCache(const std::list<ImageKey>& keys) const
+{
+    if ( keys.empty() || !_imp->taskScheduler ) {
+        return;
+    }
+    ImageCachePtr cache = _imp->_diskCache;
+    _imp->taskScheduler->start([cache, keys]() {
+        for (std::list<ImageKey>::const_iterator it = keys.begin(); it != keys.end(); ++it) {
+            cache->prefetch(*it);
+        }
+    });
+}
+
+void
+AppManager::prefetchTextures(const std::list<FrameKey>& keys) const
+{
+    if ( keys.empty() || !_imp->taskScheduler ) {
+        return;
+    }
+    FrameEntryCachePtr cache = _imp->_viewerCache;
+    _imp->taskScheduler->start([cache, keys]() {
+        for (std::list<FrameKey>::const_iterator it = keys.begin(); it != keys.end(); ++it) {
+            cache->prefetch(*it);
+        }
+    });
+}
+
 bool
 AppManager::isAggressiveCachingEnabled() const
 {
@@ -2479,7 +2527,7 @@ AppManager::isAggressiveCachingEnabled() const
 U64
 AppManager::getCachesTotalMemorySize() const
 {
-    return  _imp->_nodeCache->getMemoryCacheSize();
+    return  _imp->_nodeCache->getMemoryCacheSize() + _imp->_nodeCache->getCompressedCacheSize();
 }
 
 U64
@@ -2798,7 +2846,8 @@ AppManager::checkCacheFreeMemoryIsGoodEnough()
         qDebug() << "Total system free RAM is below the threshold:" << printAsRAM(totalFreeRAM)
         << ", clearing least recently used NodeCache image...";
 #endif
-        if ( !_imp->_nodeCache->evictLRUInMemoryEntry() ) {
+        // Entries evicted from the memory portion may only be compressed, so recycle the compressed ones too
+        if ( !_imp->_nodeCache->evictLRUInMemoryEntry() && !_imp->_nodeCache->evictLRUCompressedEntry() ) {
             break;
         }
 
@@ -3763,7 +3812,6 @@ NATRON_PYTHON_NAMESPACE::interpretPythonScript(const std::string& script,
     }
 } // NATRON_PYTHON_NAMESPACE::interpretPythonScript
 
-#if 0 // dead code
 void
 NATRON_PYTHON_NAMESPACE::compilePyScript(const std::string& script,
                                          PyObject** code)
@@ -3780,8 +3828,6 @@ NATRON_PYTHON_NAMESPACE::compilePyScript(const std::string& script,
     }
 }
 
-#endif
-
 static std::string
 makeNameScriptFriendlyInternal(const std::string& str,
                                bool allowDots)
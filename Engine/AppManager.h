@@ -217,6 +217,14 @@ public:
                             FrameEntryLocker* locker,
                             FrameEntryPtr* returnValue) const;
 
+    /**
+     * @brief Asks the system to read ahead, on a worker thread, the data of the images of the disk cache
+     * (resp. the textures of the viewer cache) matching the keys, that are going to be looked-up shortly.
+     **/
+    void prefetchImages_diskCache(const std::list<ImageKey>& keys) const;
+
+    void prefetchTextures(const std::list<FrameKey>& keys) const;
+
 
     U64 getCachesTotalMemorySize() const;
     U64 getCachesTotalDiskSize() const;
@@ -224,6 +232,8 @@ public:
 
     void setApplicationsCachesMaximumMemoryPercent(double p);
 
+    void setApplicationsCachesMaximumCompressedMemoryPercent(double p);
+
     void setApplicationsCachesMaximumViewerDiskSpace(unsigned long long size);
 
     void setApplicationsCachesMaximumDiskSpace(unsigned long long size);
@@ -362,6 +372,8 @@ public:
     int getHardwareIdealThreadCount();
     int getMaxThreadCount(); //!<  actual number of threads in the thread pool (depends on application settings)
 
+    TaskScheduler* getTaskScheduler() const;
+
 
     /**
      * @brief Toggle on/off multi-threading globally in Natron
@@ -777,7 +789,11 @@ PyObject* getMainModule();
 bool interpretPythonScript(const std::string& script, std::string* error, std::string* output);
 
 
-//void compilePyScript(const std::string& script,PyObject** code);
+/**
+ * @brief Compiles the given script with Py_file_input. The resulting code object is a new reference.
+ * This function throws an exception upon failure. The Python GIL must be held.
+ **/
+void compilePyScript(const std::string& script, PyObject** code);
 
 std::string makeNameScriptFriendlyWithDots(const std::string& str);
 std::string makeNameScriptFriendly(const std::string& str);
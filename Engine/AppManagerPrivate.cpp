@@ -250,6 +250,7 @@ AppManagerPrivate::AppManagerPrivate()
     , nThreadsPerEffect(0)
     , useThreadPool(true)
     , nThreadsMutex()
+    , taskScheduler( new TaskScheduler() )
     , runningThreadsCount()
     , lastProjectLoadedCreatedDuringRC2Or3(false)
 #if PY_MAJOR_VERSION >= 3
@@ -466,6 +467,13 @@ template <typename T>
 void
 saveCache(Cache<T>* cache)
 {
+    // The persistent index is updated whenever an entry is written back to disk
+    if ( cache->hasPersistentIndex() ) {
+        cache->syncPersistentIndex();
+
+        return;
+    }
+
     std::string cacheRestoreFilePath = cache->getRestoreFilePath();
     FStreamsSupport::ofstream ofile;
     FStreamsSupport::open(&ofile, cacheRestoreFilePath);
@@ -503,6 +511,19 @@ void
 restoreCache(AppManagerPrivate* p,
              Cache<T>* cache)
 {
+    if ( !cache->isTileCache() ) {
+        // Entries are restored from the persistent index when they are looked-up, so that the startup time
+        // does not depend on the size of the cache
+        p->checkForCacheDiskStructure( cache->getCachePath(), false );
+        try {
+            cache->openPersistentIndex();
+        } catch (const std::exception & e) {
+            qDebug() << "Failed to open the cache index:" << e.what();
+        }
+
+        return;
+    }
+
     if ( p->checkForCacheDiskStructure( cache->getCachePath(), cache->isTileCache() ) ) {
         std::string settingsFilePath = cache->getRestoreFilePath();
         FStreamsSupport::ifstream ifile;
@@ -554,7 +575,8 @@ AppManagerPrivate::checkForCacheDiskStructure(const QString & cachePath, bool is
     if ( !settingsFilePath.endsWith( QChar::fromLatin1('/') ) ) {
         settingsFilePath += QChar::fromLatin1('/');
     }
-    settingsFilePath += QString::fromUtf8("restoreFile." NATRON_CACHE_FILE_EXT);
+    // Caches which are not tiled have a persistent index instead of a table of contents
+    settingsFilePath += QString::fromUtf8(isTiled ? "restoreFile." NATRON_CACHE_FILE_EXT : "index." NATRON_CACHE_FILE_EXT);
 
     if ( !QFile::exists(settingsFilePath) ) {
         cleanUpCacheDiskStructure(cachePath, isTiled);
@@ -567,9 +589,7 @@ AppManagerPrivate::checkForCacheDiskStructure(const QString & cachePath, bool is
         QStringList files = directory.entryList(QDir::AllDirs);
 
 
-        /*Now counting actual data files in the cache*/
         /*check if there's 256 subfolders, otherwise reset cache.*/
-        int count = 0; // -1 because of the restoreFile
         int subFolderCount = 0;
         Q_FOREACH(const QString &file, files) {
             QString subFolder(cachePath);
@@ -582,12 +602,6 @@ AppManagerPrivate::checkForCacheDiskStructure(const QString & cachePath, bool is
             QDir d(subFolder);
             if ( d.exists() ) {
                 ++subFolderCount;
-                QStringList items = d.entryList();
-                for (int j = 0; j < items.size(); ++j) {
-                    if ( ( items[j] != QString::fromUtf8(".") ) && ( items[j] != QString::fromUtf8("..") ) ) {
-                        ++count;
-                    }
-                }
             }
         }
         if (subFolderCount < 256) {
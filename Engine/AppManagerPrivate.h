@@ -55,6 +55,7 @@
 #include "Engine/Image.h"
 #include "Engine/GPUContextPool.h"
 #include "Engine/GenericSchedulerThreadWatcher.h"
+#include "Engine/TaskScheduler.h"
 #include "Engine/TLSHolder.h"
 
 // include breakpad after Engine, because it includes /usr/include/AssertMacros.h on OS X which defines a check(x) macro, which conflicts with boost
@@ -118,8 +119,9 @@ public:
     int idealThreadCount; // return value of QThread::idealThreadCount() cached here
     int nThreadsToRender; // the value held by the corresponding Knob in the Settings, stored here for faster access (3 RW lock vs 1 mutex here)
     int nThreadsPerEffect;  // the value held by the corresponding Knob in the Settings, stored here for faster access (3 RW lock vs 1 mutex here)
-    bool useThreadPool; // whether the multi-thread suite should use the global thread pool (of QtConcurrent) or not
+    bool useThreadPool; // whether the multi-thread suite should use the task scheduler or spawn its own threads
     mutable QMutex nThreadsMutex; // protects nThreadsToRender & nThreadsPerEffect & useThreadPool
+    std::unique_ptr<TaskScheduler> taskScheduler; // the scheduler for host frame threading, the multi-thread suite and viewer renders
 
     //The idea here is to keep track of the number of threads launched by Natron (except the ones of the global thread pool of QtConcurrent)
     //So that we can properly have an estimation of how much the cores of the CPU are used.
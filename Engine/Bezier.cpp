@@ -32,6 +32,7 @@
 #include <cmath>
 #include <cassert>
 #include <stdexcept>
+#include <vector>
 
 #include <QtCore/QLineF>
 #include <QtCore/QDebug>
@@ -81,6 +82,9 @@
 // http://www.davidrevoy.com/article182/calibrating-wacom-stylus-pressure-on-krita
 #define ROTO_PRESSURE_LEVELS 512
 
+// The maximum distance, in pixels, that a point of a shape moves between 2 of its motion blur samples
+#define NATRON_ROTO_MOTION_BLUR_MAX_PIXELS_PER_SAMPLE 1.
+
 #ifndef M_PI
 #define M_PI        3.14159265358979323846264338327950288   /* pi             */
 #endif
@@ -708,27 +712,23 @@ recursiveBezier(const Point& p0, const Point& p1, const Point& p2, const Point&
 }
 #endif // #ifdef ROTO_BEZIER_EVAL_ITERATIVE
 
-// compute nbPointsperSegment points and update the bbox bounding box for the Bezier
-// segment from 'first' to 'last' evaluated at 'time'
-// If nbPointsPerSegment is -1 then it will be automatically computed
+// compute the control points of the Bezier segment from 'first' to 'last' evaluated at 'time',
+// in the coordinates of its polygon
 static void
-bezierSegmentEval(bool useGuiCurves,
-                  const BezierCP & first,
-                  const BezierCP & last,
-                  double time,
-                  ViewIdx view,
-                  unsigned int mipmapLevel,
-#ifdef ROTO_BEZIER_EVAL_ITERATIVE
-                  int nbPointsPerSegment,
-#else
-                  double errorScale,
-#endif
-                  const Transform::Matrix3x3& transform,
-                  std::list<ParametricPoint >* points, ///< output
-                  RectD* bbox = NULL) ///< input/output (optional)
+bezierSegmentControlPoints(bool useGuiCurves,
+                           const BezierCP & first,
+                           const BezierCP & last,
+                           double time,
+                           ViewIdx view,
+                           unsigned int mipmapLevel,
+                           const Transform::Matrix3x3& transform,
+                           BezierPolygonCache::Segment* segment) ///< output
 {
     Transform::Point3D p0M, p1M, p2M, p3M;
-    Point p0, p1, p2, p3;
+    Point& p0 = segment->p0;
+    Point& p1 = segment->p1;
+    Point& p2 = segment->p2;
+    Point& p3 = segment->p3;
 
     try {
         first.getPositionAtTime(useGuiCurves, time, view, &p0M.x, &p0M.y);
@@ -766,6 +766,23 @@ bezierSegmentEval(bool useGuiCurves,
         p3.x /= pot;
         p3.y /= pot;
     }
+}
+
+// compute nbPointsperSegment points of the Bezier segment
+// If nbPointsPerSegment is -1 then it will be automatically computed
+static void
+bezierSegmentPolygon(const BezierPolygonCache::Segment& segment,
+#ifdef ROTO_BEZIER_EVAL_ITERATIVE
+                     int nbPointsPerSegment,
+#else
+                     double errorScale,
+#endif
+                     std::list<ParametricPoint >* points) ///< output
+{
+    const Point& p0 = segment.p0;
+    const Point& p1 = segment.p1;
+    const Point& p2 = segment.p2;
+    const Point& p3 = segment.p3;
 
 #ifdef ROTO_BEZIER_EVAL_ITERATIVE
     if (nbPointsPerSegment == -1) {
@@ -799,10 +816,104 @@ bezierSegmentEval(bool useGuiCurves,
     static const int maxRecursion = 32;
     recursiveBezier(p0, p1, p2, p3, errorScale, maxRecursion, points);
 #endif
-    if (bbox) {
-        Bezier::bezierPointBboxUpdate(p0,  p1,  p2,  p3, bbox);
+}
+
+// Returns the Bezier segments joining the consecutive control points, and the last one to the first if the curve is finished.
+// The last point of the polygon of a segment must be removed if the segment is followed by another one, so that there are no duplicates.
+static void
+bezierSegmentList(bool isOpenBezier,
+                  bool useGuiCurves,
+                  const BezierCPs& cps,
+                  double time,
+                  unsigned int mipmapLevel,
+                  bool finished,
+                  const Transform::Matrix3x3& transform,
+                  std::vector<BezierPolygonCache::Segment>* segments, ///< output
+                  std::vector<bool>* removeLastPoint) ///< output
+{
+    BezierCPs::const_iterator next = cps.begin();
+
+    if ( next != cps.end() ) {
+        ++next;
+    }
+    BezierCPs::const_iterator nextnext = next;
+    if ( nextnext != cps.end() ) {
+        ++nextnext;
+    }
+
+    const bool isClosed = finished && !isOpenBezier;
+
+    for (BezierCPs::const_iterator it = cps.begin(); it != cps.end(); ++it) {
+        if ( next == cps.end() ) {
+            if (!finished) {
+                break;
+            }
+            next = cps.begin();
+        }
+
+        const bool isLastSegment = nextnext == cps.end();
+
+        BezierPolygonCache::Segment segment;
+        bezierSegmentControlPoints(useGuiCurves, *(*it), *(*next), time, ViewIdx(0), mipmapLevel, transform, &segment);
+        segments->push_back(segment);
+        // If we are a closed bezier or we are not on the last segment, remove the last point so we don't add duplicates
+        removeLastPoint->push_back(isClosed || !isLastSegment);
+
+        // increment for next iteration
+        if ( next != cps.end() ) {
+            ++next;
+        }
+        if ( nextnext != cps.end() ) {
+            ++nextnext;
+        }
+    } // for()
+}
+
+// Returns in points the polygons of the segments, which are cached by the bezier.
+// The last point of the segments for which removeLastPoint is true is removed, so that there are no duplicates.
+static void
+bezierSegmentListPolygons(BezierPolygonCache* cache,
+                          const BezierPolygonCache::Key& key,
+                          const std::vector<BezierPolygonCache::Segment>& segments,
+                          const std::vector<bool>& removeLastPoint,
+#ifdef ROTO_BEZIER_EVAL_ITERATIVE
+                          int nbPointsPerSegment,
+#else
+                          double errorScale,
+#endif
+                          std::list<std::list<ParametricPoint> >* points, ///< output
+                          std::list<ParametricPoint >* pointsSingleList, ///< output
+                          RectD* bbox) ///< input/output (optional)
+{
+    assert( segments.size() == removeLastPoint.size() );
+    std::vector<BezierPolygonCache::PolygonPtr> polygons;
+    cache->getPolygons(key, segments, [ = ](const BezierPolygonCache::Segment & segment, std::list<ParametricPoint>* polygon) {
+        bezierSegmentPolygon(segment,
+#ifdef ROTO_BEZIER_EVAL_ITERATIVE
+                             nbPointsPerSegment,
+#else
+                             errorScale,
+#endif
+                             polygon);
+    }, &polygons);
+
+    for (std::size_t i = 0; i < segments.size(); ++i) {
+        const std::list<ParametricPoint>& polygon = *polygons[i];
+        std::list<ParametricPoint>::const_iterator end = polygon.end();
+        if ( removeLastPoint[i] && !polygon.empty() ) {
+            --end;
+        }
+        if (points) {
+            points->push_back( std::list<ParametricPoint>( polygon.begin(), end ) );
+        } else {
+            assert(pointsSingleList);
+            pointsSingleList->insert( pointsSingleList->end(), polygon.begin(), end );
+        }
+        if (bbox) {
+            Bezier::bezierPointBboxUpdate(segments[i].p0, segments[i].p1, segments[i].p2, segments[i].p3, bbox);
+        }
     }
-} // bezierSegmentEval
+}
 
 /**
  * @brief Determines if the point (x,y) lies on the bezier curve segment defined by first and last.
@@ -2548,58 +2659,26 @@ Bezier::deCastelJau(bool isOpenBezier,
                     RectD* bbox)
 {
     assert((points && !pointsSingleList) || (!points && pointsSingleList));
-    BezierCPs::const_iterator next = cps.begin();
-
-    if ( next != cps.end() ) {
-        ++next;
-    }
-    BezierCPs::const_iterator nextnext = next;
-    if ( nextnext != cps.end() ) {
-        ++nextnext;
-    }
-
-    const bool isClosed = finished && !isOpenBezier;
+    std::vector<BezierPolygonCache::Segment> segments;
+    std::vector<bool> removeLastPoint;
+    bezierSegmentList(isOpenBezier, useGuiCurves, cps, time, mipmapLevel, finished, transform, &segments, &removeLastPoint);
 
-    for (BezierCPs::const_iterator it = cps.begin(); it != cps.end(); ++it) {
-        if ( next == cps.end() ) {
-            if (!finished) {
-                break;
-            }
-            next = cps.begin();
+    for (std::size_t i = 0; i < segments.size(); ++i) {
+        std::list<ParametricPoint> segmentPoints;
+        bezierSegmentPolygon(segments[i], nBPointsPerSegment, &segmentPoints);
+        if ( removeLastPoint[i] && !segmentPoints.empty() ) {
+            segmentPoints.pop_back();
         }
-
-        const bool isLastSegment = nextnext == cps.end();
-
         if (points) {
-            std::list<ParametricPoint> segmentPoints;
-            bezierSegmentEval(useGuiCurves, *(*it), *(*next), time, ViewIdx(0), mipmapLevel, nBPointsPerSegment, transform, &segmentPoints, bbox);
-
-            // If we are a closed bezier or we are not on the last segment, remove the last point so we don't add duplicates
-            if (isClosed || !isLastSegment) {
-                if (!segmentPoints.empty()) {
-                    segmentPoints.pop_back();
-                }
-            }
             points->push_back(segmentPoints);
         } else {
             assert(pointsSingleList);
-            bezierSegmentEval(useGuiCurves, *(*it), *(*next), time, ViewIdx(0), mipmapLevel, nBPointsPerSegment, transform, pointsSingleList, bbox);
-            // If we are a closed bezier or we are not on the last segment, remove the last point so we don't add duplicates
-            if (isClosed || !isLastSegment) {
-                if (!pointsSingleList->empty()) {
-                    pointsSingleList->pop_back();
-                }
-            }
-        }
-
-        // increment for next iteration
-        if ( next != cps.end() ) {
-            ++next;
+            pointsSingleList->splice(pointsSingleList->end(), segmentPoints);
         }
-        if ( nextnext != cps.end() ) {
-            ++nextnext;
+        if (bbox) {
+            Bezier::bezierPointBboxUpdate(segments[i].p0, segments[i].p1, segments[i].p2, segments[i].p3, bbox);
         }
-    } // for()
+    }
 }
 
 void
@@ -2662,13 +2741,30 @@ Bezier::evaluateAtTime_DeCasteljau_internal(bool useGuiCurves,
 
     getTransformAtTime(time, &transform);
     QMutexLocker l(&itemMutex);
-    deCastelJau(isOpenBezier(), useGuiCurves, _imp->points, time, mipmapLevel, _imp->finished,
+
+    // Same segments as deCastelJau(), but their polygons are cached
+    std::vector<BezierPolygonCache::Segment> segments;
+    std::vector<bool> removeLastPoint;
+    bezierSegmentList(isOpenBezier(), useGuiCurves, _imp->points, time, mipmapLevel, _imp->finished, transform, &segments, &removeLastPoint);
+
+    BezierPolygonCache::Key key;
+    key.useGuiCurves = useGuiCurves;
+    key.feather = false;
+    key.evaluateIfEqual = true;
+    key.time = time;
+    key.mipmapLevel = mipmapLevel;
 #ifdef ROTO_BEZIER_EVAL_ITERATIVE
-                nbPointsPerSegment,
+    key.precision = nbPointsPerSegment;
 #else
-                errorScale,
+    key.precision = errorScale;
 #endif
-                transform, points, pointsSingleList, bbox);
+    bezierSegmentListPolygons(&_imp->polygonCache, key, segments, removeLastPoint,
+#ifdef ROTO_BEZIER_EVAL_ITERATIVE
+                              nbPointsPerSegment,
+#else
+                              errorScale,
+#endif
+                              points, pointsSingleList, bbox);
 }
 
 void
@@ -2744,6 +2840,9 @@ Bezier::evaluateFeatherPointsAtTime_DeCasteljau_internal(bool useGuiPoints,
     Transform::Matrix3x3 transform;
     getTransformAtTime(time, &transform);
 
+    // The polygons of the segments are cached
+    std::vector<BezierPolygonCache::Segment> segments;
+    std::vector<bool> removeLastPoint;
     for (BezierCPs::const_iterator it = _imp->featherPoints.begin(); it != _imp->featherPoints.end();
          ++it) {
         if ( next == _imp->featherPoints.end() ) {
@@ -2758,39 +2857,11 @@ Bezier::evaluateFeatherPointsAtTime_DeCasteljau_internal(bool useGuiPoints,
         if ( !evaluateIfEqual && bezierSegmenEqual(useGuiPoints, time, ViewIdx(0), **itCp, **nextCp, **it, **next) ) {
             continue;
         }
-        if (points) {
-            std::list<ParametricPoint> segmentPoints;
-            bezierSegmentEval(useGuiPoints, *(*it), *(*next), time, ViewIdx(0),  mipmapLevel,
-#ifdef ROTO_BEZIER_EVAL_ITERATIVE
-                              nbPointsPerSegment,
-#else
-                              errorScale,
-#endif
-                              transform, &segmentPoints, bbox);
-
-            // If we are a closed bezier or we are not on the last segment, remove the last point so we don't add duplicates
-            if (!isOpenBezier() || next != _imp->featherPoints.end()) {
-                if (!segmentPoints.empty()) {
-                    segmentPoints.pop_back();
-                }
-            }
-            points->push_back(segmentPoints);
-        } else {
-            assert(pointsSingleList);
-            bezierSegmentEval(useGuiPoints, *(*it), *(*next), time, ViewIdx(0),  mipmapLevel,
-#ifdef ROTO_BEZIER_EVAL_ITERATIVE
-                              nbPointsPerSegment,
-#else
-                              errorScale,
-#endif
-                              transform, pointsSingleList, bbox);
-            // If we are a closed bezier or we are not on the last segment, remove the last point so we don't add duplicates
-            if (!isOpenBezier() || next != _imp->featherPoints.end()) {
-                if (!pointsSingleList->empty()) {
-                    pointsSingleList->pop_back();
-                }
-            }
-        }
+        BezierPolygonCache::Segment segment;
+        bezierSegmentControlPoints(useGuiPoints, *(*it), *(*next), time, ViewIdx(0), mipmapLevel, transform, &segment);
+        segments.push_back(segment);
+        // If we are a closed bezier or we are not on the last segment, remove the last point so we don't add duplicates
+        removeLastPoint.push_back( !isOpenBezier() || next != _imp->featherPoints.end() );
 
         // increment for next iteration
         if ( itCp != _imp->featherPoints.end() ) {
@@ -2804,6 +2875,24 @@ Bezier::evaluateFeatherPointsAtTime_DeCasteljau_internal(bool useGuiPoints,
         }
     } // for(it)
 
+    BezierPolygonCache::Key key;
+    key.useGuiCurves = useGuiPoints;
+    key.feather = true;
+    key.evaluateIfEqual = evaluateIfEqual;
+    key.time = time;
+    key.mipmapLevel = mipmapLevel;
+#ifdef ROTO_BEZIER_EVAL_ITERATIVE
+    key.precision = nbPointsPerSegment;
+#else
+    key.precision = errorScale;
+#endif
+    bezierSegmentListPolygons(&_imp->polygonCache, key, segments, removeLastPoint,
+#ifdef ROTO_BEZIER_EVAL_ITERATIVE
+                              nbPointsPerSegment,
+#else
+                              errorScale,
+#endif
+                              points, pointsSingleList, bbox);
 }
 
 void
@@ -2828,6 +2917,41 @@ Bezier::evaluateFeatherPointsAtTime_DeCasteljau(bool useGuiPoints,
                                                      evaluateIfEqual, points, 0, bbox);
 } // Bezier::evaluateFeatherPointsAtTime_DeCasteljau
 
+#ifdef NATRON_ROTO_ENABLE_MOTION_BLUR
+// Returns the length of the longest path followed by a control point or one of its tangents, after the transform,
+// through the given times
+static double
+getControlPointsMaxMotion(const BezierCPs& points,
+                          const std::vector<double>& times,
+                          const std::vector<Transform::Matrix3x3>& transforms)
+{
+    double maxMotion = 0.;
+
+    for (BezierCPs::const_iterator it = points.begin(); it != points.end(); ++it) {
+        Transform::Point3D prev[3];
+        double motion[3] = {0., 0., 0.};
+        for (std::size_t i = 0; i < times.size(); ++i) {
+            Transform::Point3D p[3];
+            p[0].z = p[1].z = p[2].z = 1;
+            (*it)->getPositionAtTime(false, times[i], ViewIdx(0), &p[0].x, &p[0].y);
+            (*it)->getLeftBezierPointAtTime(false, times[i], ViewIdx(0), &p[1].x, &p[1].y);
+            (*it)->getRightBezierPointAtTime(false, times[i], ViewIdx(0), &p[2].x, &p[2].y);
+            for (int k = 0; k < 3; ++k) {
+                p[k] = Transform::matApply(transforms[i], p[k]);
+                if (i > 0) {
+                    motion[k] += std::sqrt( (p[k].x - prev[k].x) * (p[k].x - prev[k].x) + (p[k].y - prev[k].y) * (p[k].y - prev[k].y) );
+                }
+                prev[k] = p[k];
+            }
+        }
+        maxMotion = std::max( maxMotion, std::max( motion[0], std::max(motion[1], motion[2]) ) );
+    }
+
+    return maxMotion;
+}
+
+#endif
+
 void
 Bezier::getMotionBlurSettings(const double time,
                               double* startTime,
@@ -2847,9 +2971,6 @@ Bezier::getMotionBlurSettings(const double time,
         return;
     }
     int shutterType_i = getShutterTypeKnob()->getValueAtTime(time);
-    if (nbSamples != 0) {
-        *timeStep = shutterInterval / nbSamples;
-    }
     if (shutterType_i == 0) { // centered
         *startTime = time - shutterInterval / 2.;
         *endTime = time + shutterInterval / 2.;
@@ -2865,10 +2986,55 @@ Bezier::getMotionBlurSettings(const double time,
     } else {
         assert(false);
     }
+    if (nbSamples == 0) {
+        return;
+    }
 
+    // A shape which moves slowly needs fewer samples: measure the motion of each control point at the times of
+    // the samples, and of the feather edge, so that 2 consecutive samples are at most
+    // NATRON_ROTO_MOTION_BLUR_MAX_PIXELS_PER_SAMPLE apart
+    std::vector<double> times(nbSamples + 1);
+    std::vector<Transform::Matrix3x3> transforms(nbSamples + 1);
+    double featherMotion = 0.;
+    double prevFeatherDistance = 0.;
+    const double fallOff = getFeatherFallOff(*startTime);
+    bool fallOffAnimated = false;
+    for (int i = 0; i <= nbSamples; ++i) {
+        times[i] = *startTime + i * shutterInterval / nbSamples;
+        getTransformAtTime(times[i], &transforms[i]);
+        const double featherDistance = getFeatherDistance(times[i]);
+        if (i > 0) {
+            featherMotion += std::abs(featherDistance - prevFeatherDistance);
+        }
+        prevFeatherDistance = featherDistance;
+        fallOffAnimated |= getFeatherFallOff(times[i]) != fallOff;
+    }
+    if (!fallOffAnimated) {
+        double maxMotion;
+        {
+            QMutexLocker l(&itemMutex);
+            maxMotion = getControlPointsMaxMotion(_imp->points, times, transforms);
+            if ( useFeatherPoints() ) {
+                maxMotion = std::max( maxMotion, getControlPointsMaxMotion(_imp->featherPoints, times, transforms) );
+            }
+        }
+        maxMotion += featherMotion;
+        if (maxMotion == 0.) {
+            // all the samples would be the same
+            *startTime = *endTime = time;
 
+            return;
+        }
+        nbSamples = std::min( nbSamples, std::max( 1, (int)std::ceil(maxMotion / NATRON_ROTO_MOTION_BLUR_MAX_PIXELS_PER_SAMPLE) ) );
+    }
+    {
+        // Keep the polygons of all the samples, in addition to the ones of the overlay and of the other mipmap levels
+        QMutexLocker l(&itemMutex);
+        _imp->polygonCache.reserveEntries( NATRON_BEZIER_POLYGON_CACHE_MAX_ENTRIES + NATRON_BEZIER_POLYGON_CACHE_ENTRIES_PER_SAMPLE * (nbSamples + 1) );
+    }
+    *timeStep = shutterInterval / nbSamples;
 #endif
-}
+} // Bezier::getMotionBlurSettings
 
 RectD
 Bezier::getBoundingBox(double time) const
@@ -41,6 +41,7 @@ CLANG_DIAG_ON(deprecated-declarations)
 
 #include "Global/GlobalDefines.h"
 
+#include "Engine/BezierPolygonCache.h"
 #include "Engine/RotoDrawableItem.h"
 #include "Engine/ViewIdx.h"
 #include "Engine/EngineFwd.h"
@@ -65,11 +66,6 @@ NATRON_NAMESPACE_ENTER
  * has at least a minimum of 1 keyframe.
  **/
 
-struct ParametricPoint
-{
-    double x,y,t;
-};
-
 struct BezierPrivate;
 class Bezier
     : public RotoDrawableItem
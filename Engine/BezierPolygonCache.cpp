@@ -0,0 +1,231 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * (C) 2018-2023 The Natron developers
+ * (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "BezierPolygonCache.h"
+
+#include <algorithm> // min, max
+#include <cassert>
+
+#include "Engine/AppManager.h"
+#include "Engine/TaskScheduler.h"
+
+// Below this number of segments to evaluate, the segments are evaluated by a single task
+#define NATRON_BEZIER_POLYGON_MIN_SEGMENTS_PER_TASK 32
+
+NATRON_NAMESPACE_ENTER
+
+bool
+BezierPolygonCache::Key::operator<(const Key& other) const
+{
+    if (useGuiCurves != other.useGuiCurves) {
+        return useGuiCurves < other.useGuiCurves;
+    }
+    if (feather != other.feather) {
+        return feather < other.feather;
+    }
+    if (evaluateIfEqual != other.evaluateIfEqual) {
+        return evaluateIfEqual < other.evaluateIfEqual;
+    }
+    if (mipmapLevel != other.mipmapLevel) {
+        return mipmapLevel < other.mipmapLevel;
+    }
+    if (precision != other.precision) {
+        return precision < other.precision;
+    }
+
+    return time < other.time;
+}
+
+static bool
+pointLess(const Point& a,
+          const Point& b,
+          bool* equal)
+{
+    *equal = false;
+    if (a.x != b.x) {
+        return a.x < b.x;
+    }
+    if (a.y != b.y) {
+        return a.y < b.y;
+    }
+    *equal = true;
+
+    return false;
+}
+
+bool
+BezierPolygonCache::SegmentCompare::operator()(const Segment& a,
+                                               const Segment& b) const
+{
+    bool equal;
+    bool less = pointLess(a.p0, b.p0, &equal);
+
+    if (!equal) {
+        return less;
+    }
+    less = pointLess(a.p1, b.p1, &equal);
+    if (!equal) {
+        return less;
+    }
+    less = pointLess(a.p2, b.p2, &equal);
+    if (!equal) {
+        return less;
+    }
+
+    return pointLess(a.p3, b.p3, &equal);
+}
+
+BezierPolygonCache::BezierPolygonCache(std::size_t maxEntries)
+    : _entries()
+    , _maxEntries( std::max( (std::size_t)1, maxEntries ) )
+    , _useCount(0)
+{
+}
+
+const BezierPolygonCache::Entry*
+BezierPolygonCache::findSourceEntry(const Key& key) const
+{
+    EntriesMap::const_iterator found = _entries.find(key);
+
+    if ( found != _entries.end() ) {
+        return &found->second;
+    }
+
+    // A shape which is not animated has the same segments at any time: start from the most recently used time
+    const Entry* source = 0;
+    for (EntriesMap::const_iterator it = _entries.begin(); it != _entries.end(); ++it) {
+        const Key& other = it->first;
+        if ( (other.useGuiCurves != key.useGuiCurves) || (other.feather != key.feather) || (other.evaluateIfEqual != key.evaluateIfEqual) ||
+             (other.mipmapLevel != key.mipmapLevel) || (other.precision != key.precision) ) {
+            continue;
+        }
+        if ( !source || (it->second.lastUse > source->lastUse) ) {
+            source = &it->second;
+        }
+    }
+
+    return source;
+}
+
+void
+BezierPolygonCache::evictLeastRecentlyUsed()
+{
+    while (_entries.size() >= _maxEntries) {
+        EntriesMap::iterator oldest = _entries.begin();
+        for (EntriesMap::iterator it = _entries.begin(); it != _entries.end(); ++it) {
+            if (it->second.lastUse < oldest->second.lastUse) {
+                oldest = it;
+            }
+        }
+        _entries.erase(oldest);
+    }
+}
+
+int
+BezierPolygonCache::getPolygons(const Key& key,
+                                const std::vector<Segment>& segments,
+                                const EvaluateFunction& evaluate,
+                                std::vector<PolygonPtr>* polygons)
+{
+    polygons->assign( segments.size(), PolygonPtr() );
+
+    // Share the polygons of the segments which did not move
+    const Entry* source = findSourceEntry(key);
+    std::vector<std::size_t> dirtySegments;
+    if (source) {
+        std::map<Segment, PolygonPtr, SegmentCompare> sourcePolygons;
+        for (std::size_t i = 0; i < source->segments.size(); ++i) {
+            sourcePolygons[source->segments[i]] = source->polygons[i];
+        }
+        for (std::size_t i = 0; i < segments.size(); ++i) {
+            std::map<Segment, PolygonPtr, SegmentCompare>::const_iterator found = sourcePolygons.find(segments[i]);
+            if ( found != sourcePolygons.end() ) {
+                (*polygons)[i] = found->second;
+            } else {
+                dirtySegments.push_back(i);
+            }
+        }
+    } else {
+        for (std::size_t i = 0; i < segments.size(); ++i) {
+            dirtySegments.push_back(i);
+        }
+    }
+
+    // Evaluate the other ones
+    const int nDirty = (int)dirtySegments.size();
+    const int nTasks = std::max( 1, std::min( nDirty, nDirty / NATRON_BEZIER_POLYGON_MIN_SEGMENTS_PER_TASK ) );
+    const int segmentsPerTask = nDirty == 0 ? 0 : (nDirty + nTasks - 1) / nTasks;
+    std::vector<std::shared_ptr<std::list<ParametricPoint> > > evaluated(nDirty);
+    const std::function<void(int)> evaluateTask = [&](int task) {
+        const int first = task * segmentsPerTask;
+        const int last = std::min(first + segmentsPerTask, nDirty);
+        for (int i = first; i < last; ++i) {
+            evaluated[i] = std::make_shared<std::list<ParametricPoint> >();
+            evaluate(segments[dirtySegments[i]], evaluated[i].get());
+        }
+    };
+    TaskScheduler* scheduler = appPTR ? appPTR->getTaskScheduler() : NULL;
+
+    if ( (nTasks > 1) && scheduler ) {
+        scheduler->parallelFor( (nDirty + segmentsPerTask - 1) / segmentsPerTask, evaluateTask );
+    } else if (nDirty > 0) {
+        evaluateTask(0);
+    }
+    for (int i = 0; i < nDirty; ++i) {
+        (*polygons)[dirtySegments[i]] = evaluated[i];
+    }
+
+    // Store the result under the key
+    EntriesMap::iterator found = _entries.find(key);
+    if ( found == _entries.end() ) {
+        evictLeastRecentlyUsed();
+        found = _entries.insert( std::make_pair( key, Entry() ) ).first;
+    }
+    found->second.segments = segments;
+    found->second.polygons = *polygons;
+    found->second.lastUse = ++_useCount;
+
+    return nDirty;
+} // BezierPolygonCache::getPolygons
+
+void
+BezierPolygonCache::reserveEntries(std::size_t maxEntries)
+{
+    _maxEntries = std::max(_maxEntries, maxEntries);
+}
+
+void
+BezierPolygonCache::clear()
+{
+    _entries.clear();
+}
+
+std::size_t
+BezierPolygonCache::getNumEntries() const
+{
+    return _entries.size();
+}
+
+NATRON_NAMESPACE_EXIT
@@ -0,0 +1,148 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * (C) 2018-2023 The Natron developers
+ * (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_BEZIERPOLYGONCACHE_H
+#define NATRON_ENGINE_BEZIERPOLYGONCACHE_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "Global/GlobalDefines.h"
+
+#include "Engine/EngineFwd.h"
+
+// The number of polygonizations of a bezier kept in its cache
+#define NATRON_BEZIER_POLYGON_CACHE_MAX_ENTRIES 16
+
+// The number of polygonizations of a bezier at each time of its motion blur: the shape and its feather
+#define NATRON_BEZIER_POLYGON_CACHE_ENTRIES_PER_SAMPLE 2
+
+NATRON_NAMESPACE_ENTER
+
+struct ParametricPoint
+{
+    double x,y,t;
+};
+
+/**
+ * @brief Caches the polygons of the segments of a bezier, so that the shape is not subdivided again each time the
+ * bounding box, the render or the overlay request it for the same time and mipmap level.
+ *
+ * The polygons are cached per segment, under the control points of the segment, in the coordinates of the polygon
+ * (i.e after the transform and the mipmap level were applied): a segment is evaluated again only when one of its
+ * control points moved. Editing a point of a shape with hundreds of control points only evaluates the two segments
+ * around it, and a shape which is not animated is only evaluated once when the time changes.
+ *
+ * This class is not MT-safe: the bezier accesses it with its item mutex held.
+ **/
+class BezierPolygonCache
+{
+public:
+
+    /**
+     * @brief The control points of a bezier segment, in the coordinates of its polygon
+     **/
+    struct Segment
+    {
+        Point p0, p1, p2, p3;
+    };
+
+    /**
+     * @brief The parameters of a polygonization of the bezier
+     **/
+    struct Key
+    {
+        bool useGuiCurves;
+        bool feather;
+        bool evaluateIfEqual;
+        double time;
+        unsigned int mipmapLevel;
+        // The number of points per segment, or the error scale of the recursive subdivision
+        double precision;
+
+        bool operator<(const Key& other) const;
+    };
+
+    typedef std::shared_ptr<const std::list<ParametricPoint> > PolygonPtr;
+    typedef std::function<void (const Segment& segment, std::list<ParametricPoint>* polygon)> EvaluateFunction;
+
+    explicit BezierPolygonCache(std::size_t maxEntries = NATRON_BEZIER_POLYGON_CACHE_MAX_ENTRIES);
+
+    /**
+     * @brief Returns in polygons the polygon of each segment, including both of its end points.
+     * The polygons of the segments found in the entry of the key, or else in the most recently used entry of
+     * another time with the same parameters, are shared. The other ones are computed by evaluate, which is called
+     * in parallel by the TaskScheduler of the application when there are many of them.
+     * @returns The number of segments that were evaluated.
+     **/
+    int getPolygons(const Key& key,
+                    const std::vector<Segment>& segments,
+                    const EvaluateFunction& evaluate,
+                    std::vector<PolygonPtr>* polygons);
+
+    /**
+     * @brief Raises the maximum number of entries to maxEntries, if it is lower. The bezier reserves an entry for each
+     * of its motion blur samples, so that the samples of a frame do not evict each other.
+     **/
+    void reserveEntries(std::size_t maxEntries);
+
+    void clear();
+
+    std::size_t getNumEntries() const;
+
+private:
+
+    struct SegmentCompare
+    {
+        bool operator()(const Segment& a, const Segment& b) const;
+    };
+
+    struct Entry
+    {
+        std::vector<Segment> segments;
+        std::vector<PolygonPtr> polygons;
+        U64 lastUse;
+    };
+
+    typedef std::map<Key, Entry> EntriesMap;
+
+    const Entry* findSourceEntry(const Key& key) const;
+
+    void evictLeastRecentlyUsed();
+
+    EntriesMap _entries;
+    std::size_t _maxEntries;
+    U64 _useCount;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_BEZIERPOLYGONCACHE_H
@@ -0,0 +1,82 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * (C) 2018-2023 The Natron developers
+ * (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "CPUFeatures.h"
+
+#if ( defined(__GNUC__) || defined(__clang__) ) && ( defined(__x86_64__) || defined(__i386__) )
+#define NATRON_CPU_FEATURES_CPUID 1
+#include <cpuid.h>
+#endif
+
+NATRON_NAMESPACE_ENTER
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+CPUFeatures
+probeCPUFeatures()
+{
+    CPUFeatures ret;
+
+    ret.sse41 = false;
+    ret.avx = false;
+    ret.avx2 = false;
+    ret.f16c = false;
+#ifdef NATRON_CPU_FEATURES_CPUID
+    unsigned int eax, ebx, ecx, edx;
+
+    if ( !__get_cpuid(1, &eax, &ebx, &ecx, &edx) ) {
+        return ret;
+    }
+    ret.sse41 = (ecx & bit_SSE4_1) != 0;
+    // The OS must save the AVX registers (OSXSAVE, and XCR0 bits 1 and 2)
+    if ( (ecx & bit_OSXSAVE) && (ecx & bit_AVX) ) {
+        unsigned int xcr0Low, xcr0High;
+        __asm__ ("xgetbv" : "=a" (xcr0Low), "=d" (xcr0High) : "c" (0));
+        ret.avx = (xcr0Low & 6) == 6;
+    }
+    if (!ret.avx) {
+        return ret;
+    }
+    ret.f16c = (ecx & bit_F16C) != 0;
+    if (__get_cpuid_max(0, 0) >= 7) {
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        ret.avx2 = (ebx & bit_AVX2) != 0;
+    }
+#endif
+
+    return ret;
+}
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+const CPUFeatures&
+getCPUFeatures()
+{
+    static const CPUFeatures features = probeCPUFeatures();
+
+    return features;
+}
+
+NATRON_NAMESPACE_EXIT
@@ -0,0 +1,54 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * (C) 2018-2023 The Natron developers
+ * (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_CPUFEATURES_H
+#define NATRON_ENGINE_CPUFEATURES_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief The instruction set extensions of the CPU used by the image processing code. The functions using them
+ * are compiled for these extensions with a target attribute and only called if the CPU supports them.
+ * AVX, AVX2 and F16C are only reported if the OS also saves the AVX registers.
+ * All members are false on other CPUs than x86, or with compilers that cannot probe the CPU.
+ **/
+struct CPUFeatures
+{
+    bool sse41;
+    bool avx;
+    bool avx2;
+    bool f16c;
+};
+
+/**
+ * @brief Returns the features of the CPU, which are probed once on the first call.
+ **/
+const CPUFeatures& getCPUFeatures();
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_CPUFEATURES_H
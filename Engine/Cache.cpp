@@ -28,7 +28,130 @@
 #include <cassert>
 #include <stdexcept>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define NATRON_TILE_BITMAP_WORD_BITS 64
+
 NATRON_NAMESPACE_ENTER
+
+static inline int
+findFirstSetBit(U64 word)
+{
+    assert(word != 0);
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(word);
+#elif defined(_MSC_VER) && defined(_WIN64)
+    unsigned long index;
+    _BitScanForward64(&index, word);
+
+    return (int)index;
+#else
+    int index = 0;
+    while ( !(word & 1) ) {
+        word >>= 1;
+        ++index;
+    }
+
+    return index;
+#endif
+}
+
+TileCacheFile::TileCacheFile()
+    : file()
+    , _nTiles(0)
+    , _nWords(0)
+    , _usedTiles()
+    , _nUsedTiles(0)
+    , _firstFreeWordHint(0)
+{
+}
+
+void
+TileCacheFile::initTiles(std::size_t nTiles)
+{
+    _nTiles = nTiles;
+    _nWords = (nTiles + NATRON_TILE_BITMAP_WORD_BITS - 1) / NATRON_TILE_BITMAP_WORD_BITS;
+    _usedTiles.reset(new std::atomic<U64>[_nWords]);
+    for (std::size_t i = 0; i < _nWords; ++i) {
+        _usedTiles[i] = 0;
+    }
+    // Mark the bits past the last tile as used so that they are never allocated
+    std::size_t nPaddingBits = _nWords * NATRON_TILE_BITMAP_WORD_BITS - nTiles;
+    if (nPaddingBits > 0) {
+        _usedTiles[_nWords - 1] = ~( ( (U64)1 << (NATRON_TILE_BITMAP_WORD_BITS - nPaddingBits) ) - 1 );
+    }
+    _nUsedTiles = 0;
+    _firstFreeWordHint = 0;
+}
+
+int
+TileCacheFile::allocTile()
+{
+    if ( isFull() ) {
+        return -1;
+    }
+    std::size_t firstWord = _firstFreeWordHint;
+    for (std::size_t i = 0; i < _nWords; ++i) {
+        std::size_t w = firstWord + i;
+        if (w >= _nWords) {
+            w -= _nWords;
+        }
+        U64 word = _usedTiles[w].load();
+        while (word != ~(U64)0) {
+            int bit = findFirstSetBit(~word);
+            U64 mask = (U64)1 << bit;
+            // If another thread took a tile in the same word in the meantime, word is updated and we retry
+            if ( _usedTiles[w].compare_exchange_weak(word, word | mask) ) {
+                ++_nUsedTiles;
+                _firstFreeWordHint = w;
+
+                return (int)(w * NATRON_TILE_BITMAP_WORD_BITS + bit);
+            }
+        }
+    }
+
+    return -1;
+}
+
+bool
+TileCacheFile::markTileUsed(std::size_t index)
+{
+    assert(index < _nTiles);
+    U64 mask = (U64)1 << (index % NATRON_TILE_BITMAP_WORD_BITS);
+    U64 prev = _usedTiles[index / NATRON_TILE_BITMAP_WORD_BITS].fetch_or(mask);
+    if (prev & mask) {
+        return false;
+    }
+    ++_nUsedTiles;
+
+    return true;
+}
+
+void
+TileCacheFile::freeTile(std::size_t index)
+{
+    assert(index < _nTiles);
+    std::size_t w = index / NATRON_TILE_BITMAP_WORD_BITS;
+    U64 mask = (U64)1 << (index % NATRON_TILE_BITMAP_WORD_BITS);
+    U64 prev = _usedTiles[w].fetch_and(~mask);
+    assert(prev & mask);
+    if (prev & mask) {
+        --_nUsedTiles;
+        // The next allocation will most likely reuse this tile
+        _firstFreeWordHint = w;
+    }
+}
+
+bool
+TileCacheFile::isTileUsed(std::size_t index) const
+{
+    assert(index < _nTiles);
+
+    return (_usedTiles[index / NATRON_TILE_BITMAP_WORD_BITS].load() >> (index % NATRON_TILE_BITMAP_WORD_BITS) & 1) != 0;
+}
+
 NATRON_NAMESPACE_EXIT
 
 NATRON_NAMESPACE_USING
@@ -39,6 +39,7 @@
 #include <algorithm> // min, max
 #include <string>
 #include <stdexcept>
+#include <atomic>
 
 #include "Global/GlobalDefines.h"
 #include "Global/StrUtils.h"
@@ -48,6 +49,7 @@ GCC_DIAG_OFF(deprecated)
 #include <QtCore/QThread>
 #include <QtCore/QWaitCondition>
 #include <QtCore/QMutexLocker>
+#include <QtCore/QReadWriteLock>
 #include <QtCore/QObject>
 #include <QtCore/QBuffer>
 #include <QtCore/QRunnable>
@@ -55,6 +57,7 @@ GCC_DIAG_ON(deprecated)
 
 #include "Engine/AppManager.h" //for access to settings
 #include "Engine/CacheEntry.h"
+#include "Engine/CacheIndexFile.h"
 #include "Engine/ImageLocker.h"
 #include "Engine/LRUHashTable.h"
 #include "Engine/MemoryInfo.h" // getSystemTotalRAM
@@ -68,6 +71,9 @@ GCC_DIAG_ON(deprecated)
 
 #define NATRON_TILE_CACHE_FILE_SIZE_BYTES 2000000000
 
+//Number of hash-partitioned shards of the cache, each with its own LRU and lock. Must be a power of 2.
+#define NATRON_CACHE_SHARDS_COUNT 32
+
 ///When defined, number of opened files, memory size and disk size of the cache are printed whenever there's activity.
 //#define NATRON_DEBUG_CACHE
 
@@ -477,24 +483,51 @@ public:
 
 private:
 
+    /**
+     * @brief A partition of the cache. Entries are dispatched to a shard according to their hash so that
+     * threads looking-up or inserting entries with different hashes do not contend on the same lock.
+     * Each shard has its own LRU, hence eviction is only LRU within a shard, not across the whole cache.
+     **/
+    struct CacheShard
+    {
+        mutable QMutex lock; //protects memoryCache, compressedCache & diskCache
+        mutable QMutex getLock; //prevents get() and getOrCreate() to be called simultaneously for entries of this shard
+        CacheContainer memoryCache;
+
+        // Entries evicted from memoryCache whose RAM buffer was compressed. They are uncompressed when looked-up.
+        CacheContainer compressedCache;
+        CacheContainer diskCache;
+
+        CacheShard()
+            : lock()
+            , getLock()
+            , memoryCache()
+            , compressedCache()
+            , diskCache()
+        {
+        }
+    };
+
+    std::atomic<std::size_t> _maximumInMemorySize;     // the maximum size of the in-memory portion of the cache.(in % of the maximum cache size)
+    std::atomic<std::size_t> _maximumCacheSize;     // maximum size allowed for the cache
 
-    std::size_t _maximumInMemorySize;     // the maximum size of the in-memory portion of the cache.(in % of the maximum cache size)
-    std::size_t _maximumCacheSize;     // maximum size allowed for the cache
+    // The maximum size of the compressed portion of the cache, on top of _maximumCacheSize. 0 disables it.
+    std::atomic<std::size_t> _maximumCompressedSize;
 
     /*mutable because we need to change modify it in the sealEntryInternal function which
          is called by an external object that have a const ref to the cache.
      */
-    mutable std::size_t _memoryCacheSize;     // current size of the cache in bytes
-    mutable std::size_t _diskCacheSize;
-    mutable QMutex _sizeLock; // protects _memoryCacheSize & _diskCacheSize & _maximumInMemorySize & _maximumCacheSize
-    mutable QMutex _lock; //protects _memoryCache & _diskCache
-    mutable QMutex _getLock;  //prevents get() and getOrCreate() to be called simultaneously
+    mutable std::atomic<std::size_t> _memoryCacheSize;     // current size of the cache in bytes
+    mutable std::atomic<std::size_t> _diskCacheSize;
+    mutable std::atomic<std::size_t> _compressedCacheSize;
+    mutable QMutex _sizeLock; // protects _memoryFullCondition
 
-
-    /*These 2 are mutable because we need to modify the LRU list even
+    /*Mutable because we need to modify the LRU lists even
          when we call get() and we want this function to be const.*/
-    mutable CacheContainer _memoryCache;
-    mutable CacheContainer _diskCache;
+    mutable CacheShard _shards[NATRON_CACHE_SHARDS_COUNT];
+
+    // Shard from which the next global eviction starts, so that evictions are spread across shards
+    mutable std::atomic<unsigned int> _nextEvictedShard;
     const std::string _cacheName;
     const unsigned int _version;
 
@@ -504,26 +537,36 @@ private:
 
     ///Store the system physical total RAM in a member
     std::size_t _maxPhysicalRAM;
-    bool _tearingDown;
+    std::atomic<bool> _tearingDown;
     mutable DeleterThread<EntryType> _deleterThread;
     mutable QWaitCondition _memoryFullCondition; //< protected by _sizeLock
     mutable CacheCleanerThread _cleanerThread;
 
     // If tiled, the cache will consist only of a few large files that each contain tiles of the same size.
     // This is useful to cache chunks of data that always have the same size.
-    mutable QMutex _tileCacheMutex;
+    // Tiles are allocated in the files without holding the lock for writing: each file has its own atomic bitmap.
+    // The lock is only taken for writing when a file is added to or removed from the cache.
+    mutable QReadWriteLock _tileCacheLock;
     bool _isTiled;
     std::size_t _tileByteSize;
 
-    // True when clearing the cache, protected by _tileCacheMutex
+    // True when clearing the cache, protected by _tileCacheLock
     bool _clearingCache;
 
-    // Used when the cache is tiled
+    // Used when the cache is tiled, protected by _tileCacheLock
     std::set<TileCacheFilePtr> _cacheFiles;
 
-    // When set these are used for fast search of a free tile
-    TileCacheFileWPtr _nextAvailableCacheFile;
-    int _nextAvailableCacheFileIndex;
+    // The persistent index of the entries stored on disk, opened by openPersistentIndex() on startup instead of restoring
+    // all entries: it is looked-up when an entry is not found in the shards.
+    // It is set before the cache is used, hence it is not protected by a lock
+    std::shared_ptr<CacheIndexFile> _persistentIndex;
+
+    // The cache location, to which the file paths of the index records are relative
+    std::string _persistentIndexCachePath;
+
+    // Convert entries to index records and back. They depend on boost serialization, hence they are set by openPersistentIndex()
+    std::function<void (const EntryType&, CacheIndexRecord*)> _makeIndexRecord;
+    std::function<EntryTypePtr (const CacheIndexRecord&)> _makeEntryFromIndexRecord;
 public:
 
 
@@ -535,13 +578,13 @@ public:
         : CacheAPI()
         , _maximumInMemorySize(maximumCacheSize * maximumInMemoryPercentage)
         , _maximumCacheSize(maximumCacheSize)
+        , _maximumCompressedSize(0)
         , _memoryCacheSize(0)
         , _diskCacheSize(0)
+        , _compressedCacheSize(0)
         , _sizeLock()
-        , _lock()
-        , _getLock()
-        , _memoryCache()
-        , _diskCache()
+        , _shards()
+        , _nextEvictedShard(0)
         , _cacheName(cacheName)
         , _version(version)
         , _signalEmitter()
@@ -550,35 +593,39 @@ public:
         , _deleterThread(this)
         , _memoryFullCondition()
         , _cleanerThread(this)
-        , _tileCacheMutex()
+        , _tileCacheLock()
         , _isTiled(false)
         , _tileByteSize(0)
         , _clearingCache(false)
         , _cacheFiles()
-        , _nextAvailableCacheFile()
-        , _nextAvailableCacheFileIndex(-1)
+        , _persistentIndex()
+        , _persistentIndexCachePath()
+        , _makeIndexRecord()
+        , _makeEntryFromIndexRecord()
     {
         _signalEmitter = std::make_shared<CacheSignalEmitter>();
     }
 
     virtual ~Cache()
     {
-        QMutexLocker locker(&_lock);
-
         _tearingDown = true;
-        _memoryCache.clear();
-        _diskCache.clear();
+        for (int i = 0; i < NATRON_CACHE_SHARDS_COUNT; ++i) {
+            QMutexLocker locker(&_shards[i].lock);
+            _shards[i].memoryCache.clear();
+            _shards[i].compressedCache.clear();
+            _shards[i].diskCache.clear();
+        }
     }
 
     virtual bool isTileCache() const OVERRIDE FINAL
     {
-        QMutexLocker k(&_tileCacheMutex);
+        QReadLocker k(&_tileCacheLock);
         return _isTiled;
     }
 
     virtual std::size_t getTileSizeBytes() const OVERRIDE FINAL
     {
-        QMutexLocker k(&_tileCacheMutex);
+        QReadLocker k(&_tileCacheLock);
         return _tileByteSize;
     }
 
@@ -589,7 +636,7 @@ public:
      **/
     void setTiled(bool tiled, std::size_t tileByteSize)
     {
-        QMutexLocker k(&_tileCacheMutex);
+        QWriteLocker k(&_tileCacheLock);
         _isTiled = tiled;
         _tileByteSize = tileByteSize;
     }
@@ -615,22 +662,98 @@ public:
     bool get(const typename EntryType::key_type & key,
              std::list<EntryTypePtr>* returnValue) const
     {
+        CacheShard& shard = getShard( key.getHash() );
+
         ///Be atomic, so it cannot be created by another thread in the meantime
-        QMutexLocker getlocker(&_getLock);
+        QMutexLocker getlocker(&shard.getLock);
 
-        ///lock the cache before reading it.
-        QMutexLocker locker(&_lock);
+        ///lock the shard before reading it.
+        QMutexLocker locker(&shard.lock);
 
-        return getInternal(key, returnValue);
+        return getInternal(shard, key, returnValue);
     } // get
 
+    /**
+     * @brief Asks the system to read ahead the data of the entries matching the key that are stored on disk,
+     * so that a later get() does not have to wait for their pages to be read.
+     * Unlike get(), this does not change the LRU order and does not move entries back to the memory portion.
+     * This may block on I/O and should be called from a worker thread.
+     * Returns the number of entries read ahead.
+     **/
+    std::size_t prefetch(const typename EntryType::key_type & key) const
+    {
+        std::list<EntryTypePtr> entries;
+        std::list<CacheIndexRecord> records;
+        {
+            CacheShard& shard = getShard( key.getHash() );
+            QMutexLocker locker(&shard.lock);
+
+            CacheIterator found = shard.memoryCache.find( key.getHash() );
+            if ( found != shard.memoryCache.end() ) {
+                const std::list<EntryTypePtr> & list = getValueFromIterator(found);
+                for (typename std::list<EntryTypePtr>::const_iterator it = list.begin(); it != list.end(); ++it) {
+                    if ( (*it)->isStoredOnDisk() && ( (*it)->getKey() == key ) ) {
+                        entries.push_back(*it);
+                    }
+                }
+            }
+            found = shard.diskCache.find( key.getHash() );
+            if ( found != shard.diskCache.end() ) {
+                const std::list<EntryTypePtr> & list = getValueFromIterator(found);
+                for (typename std::list<EntryTypePtr>::const_iterator it = list.begin(); it != list.end(); ++it) {
+                    if ( (*it)->getKey() == key ) {
+                        entries.push_back(*it);
+                    }
+                }
+            }
+            if ( entries.empty() && _persistentIndex ) {
+                // The entry may have been stored on disk by a previous session. Records of the same hash are
+                // not deserialized to compare their key: collisions are rare and only cost a useless read-ahead.
+                _persistentIndex->find(key.getHash(), &records);
+            }
+        }
+
+        // Read ahead outside of the shard lock so that lookups of the render threads are not blocked
+        for (typename std::list<EntryTypePtr>::iterator it = entries.begin(); it != entries.end(); ++it) {
+            (*it)->prefetch();
+        }
+        for (std::list<CacheIndexRecord>::iterator it = records.begin(); it != records.end(); ++it) {
+            MemoryFile::prefetchFile(fromIndexFilePath(it->filePath), it->dataOffsetInFile, it->size);
+        }
+
+        return entries.size() + records.size();
+    } // prefetch
+
 private:
 
+    /**
+     * @brief Returns the shard in which entries with the given hash are stored.
+     **/
+    CacheShard& getShard(hash_type hash) const
+    {
+        // Fold the high bits so that hashes differing only by their high bits are still spread across shards
+        U64 h = (U64)hash;
+
+        return _shards[(h ^ (h >> 32)) & (NATRON_CACHE_SHARDS_COUNT - 1)];
+    }
+
+    /**
+     * @brief Decrements value by size without wrapping below 0.
+     **/
+    static void atomicSubtractClamped(std::atomic<std::size_t>& value,
+                                      std::size_t size)
+    {
+        std::size_t cur = value.load();
+
+        while ( !value.compare_exchange_weak(cur, size > cur ? 0 : cur - size) ) {
+        }
+    }
+
 
 
     virtual TileCacheFilePtr getTileCacheFile(const std::string& filepath, std::size_t dataOffset) OVERRIDE FINAL WARN_UNUSED_RETURN
     {
-        QMutexLocker k(&_tileCacheMutex);
+        QWriteLocker k(&_tileCacheLock);
         assert(_isTiled);
         if (!_isTiled) {
             throw std::logic_error("allocTile() but cache is not tiled!");
@@ -641,8 +764,9 @@ private:
 
                 // The dataOffset should be a multiple of the tile size
                 assert(_tileByteSize * index == dataOffset);
-                assert(!(*it)->usedTiles[index]);
-                (*it)->usedTiles[index] = true;
+                bool wasFree = (*it)->markTileUsed(index);
+                assert(wasFree);
+                Q_UNUSED(wasFree);
                 return *it;
             }
         }
@@ -652,14 +776,13 @@ private:
             TileCacheFilePtr ret = std::make_shared<TileCacheFile>();
             ret->file = std::make_shared<MemoryFile>(filepath, MemoryFile::eFileOpenModeEnumIfExistsKeepElseFail);
             std::size_t nTilesPerFile = std::floor( ( (double)NATRON_TILE_CACHE_FILE_SIZE_BYTES ) / _tileByteSize );
-            ret->usedTiles.resize(nTilesPerFile, false);
+            ret->initTiles(nTilesPerFile);
             int index = dataOffset / _tileByteSize;
 
             // The dataOffset should be a multiple of the tile size
             assert(_tileByteSize * index == dataOffset);
-            assert(index >= 0 && index < (int)ret->usedTiles.size());
-            assert(!ret->usedTiles[index]);
-            ret->usedTiles[index] = true;
+            assert(index >= 0 && index < (int)ret->getTilesCount());
+            ret->markTileUsed(index);
             _cacheFiles.insert(ret);
             return ret;
 
@@ -667,6 +790,25 @@ private:
 
     }
 
+    /**
+     * @brief Returns a file of the tiled cache in which a free tile could be marked as used and sets dataOffset to the
+     * offset of the tile in the file. Returns NULL if all files are full.
+     * The caller must hold _tileCacheLock (either for reading or writing).
+     **/
+    TileCacheFilePtr allocTileInExistingFiles(std::size_t *dataOffset) const
+    {
+        for (std::set<TileCacheFilePtr>::const_iterator it = _cacheFiles.begin(); it != _cacheFiles.end(); ++it) {
+            // Full files are skipped in O(1) thanks to their used tiles counter
+            int index = (*it)->allocTile();
+            if (index != -1) {
+                *dataOffset = index * _tileByteSize;
+                return *it;
+            }
+        }
+
+        return TileCacheFilePtr();
+    }
+
     /**
      * @brief Relevant only for tiled caches. This will allocate the memory required for a tile in the cache and lock it.
      * Note that the calling entry should have exactly the size of a tile in the cache.
@@ -677,67 +819,48 @@ private:
      **/
     virtual TileCacheFilePtr allocTile(std::size_t *dataOffset) OVERRIDE FINAL
     {
-
-        QMutexLocker k(&_tileCacheMutex);
-
-        assert(_isTiled);
-        if (!_isTiled) {
-            throw std::logic_error("allocTile() but cache is not tiled!");
-        }
-        // First, search for a file with available space.
-        // If not found create one
-        TileCacheFilePtr foundAvailableFile;
-        int foundTileIndex = -1;
+        // First, search for a file with available space: several threads may do this concurrently
         {
-            foundAvailableFile = _nextAvailableCacheFile.lock();
-            if (_nextAvailableCacheFileIndex != -1 && foundAvailableFile) {
-                foundTileIndex = _nextAvailableCacheFileIndex;
-                *dataOffset = foundTileIndex * _tileByteSize;
-                _nextAvailableCacheFileIndex = -1;
-                _nextAvailableCacheFile.reset();
-            } else {
-                foundTileIndex = -1;
-                foundAvailableFile.reset();
+            QReadLocker k(&_tileCacheLock);
+
+            assert(_isTiled);
+            if (!_isTiled) {
+                throw std::logic_error("allocTile() but cache is not tiled!");
             }
-        }
-        if (foundTileIndex == -1) {
-            for (std::set<TileCacheFilePtr>::iterator it = _cacheFiles.begin(); it != _cacheFiles.end(); ++it) {
-                for (std::size_t i = 0; i < (*it)->usedTiles.size(); ++i) {
-                    if (!(*it)->usedTiles[i])  {
-                        foundTileIndex = i;
-                        *dataOffset = i * _tileByteSize;
-                        break;
-                    }
-                }
-                if (foundTileIndex != -1) {
-                    foundAvailableFile = *it;
-                    break;
-                }
+            TileCacheFilePtr foundAvailableFile = allocTileInExistingFiles(dataOffset);
+            if (foundAvailableFile) {
+                return foundAvailableFile;
             }
         }
 
-        if (!foundAvailableFile) {
-            // Create a file if all space is taken
-            foundAvailableFile = std::make_shared<TileCacheFile>();
-            int nCacheFiles = (int)_cacheFiles.size();
-            std::stringstream cacheFilePathSs;
-            cacheFilePathSs << getCachePath().toStdString() << "/CachePart" << nCacheFiles;
-            std::string cacheFilePath = cacheFilePathSs.str();
-            foundAvailableFile->file = std::make_shared<MemoryFile>(cacheFilePath, MemoryFile::eFileOpenModeEnumIfExistsKeepElseCreate);
+        // If not found create one
+        QWriteLocker k(&_tileCacheLock);
 
-            std::size_t nTilesPerFile = std::floor(((double)NATRON_TILE_CACHE_FILE_SIZE_BYTES) / _tileByteSize);
-            std::size_t cacheFileSize = nTilesPerFile * _tileByteSize;
-            foundAvailableFile->file->resize(cacheFileSize);
-            foundAvailableFile->usedTiles.resize(nTilesPerFile, false);
-            *dataOffset = 0;
-            foundTileIndex = 0;
-            _cacheFiles.insert(foundAvailableFile);
-            _nextAvailableCacheFile = foundAvailableFile;
-            _nextAvailableCacheFileIndex = 1;
+        // Another thread may have created a file or freed a tile while we were not holding the lock
+        TileCacheFilePtr foundAvailableFile = allocTileInExistingFiles(dataOffset);
+        if (foundAvailableFile) {
+            return foundAvailableFile;
         }
 
+        // Create a file if all space is taken
+        foundAvailableFile = std::make_shared<TileCacheFile>();
+        int nCacheFiles = (int)_cacheFiles.size();
+        std::stringstream cacheFilePathSs;
+        cacheFilePathSs << getCachePath().toStdString() << "/CachePart" << nCacheFiles;
+        std::string cacheFilePath = cacheFilePathSs.str();
+        foundAvailableFile->file = std::make_shared<MemoryFile>(cacheFilePath, MemoryFile::eFileOpenModeEnumIfExistsKeepElseCreate);
+
+        std::size_t nTilesPerFile = std::floor(((double)NATRON_TILE_CACHE_FILE_SIZE_BYTES) / _tileByteSize);
+        std::size_t cacheFileSize = nTilesPerFile * _tileByteSize;
+        foundAvailableFile->file->resize(cacheFileSize);
+        foundAvailableFile->initTiles(nTilesPerFile);
+
         // Notify the memory file that this portion of the file is valid
-        foundAvailableFile->usedTiles[foundTileIndex] = true;
+        int foundTileIndex = foundAvailableFile->allocTile();
+        assert(foundTileIndex == 0);
+        *dataOffset = foundTileIndex * _tileByteSize;
+        _cacheFiles.insert(foundAvailableFile);
+
         return foundAvailableFile;
     }
 
@@ -746,40 +869,51 @@ private:
              **/
     virtual void freeTile(const TileCacheFilePtr& file, std::size_t dataOffset) OVERRIDE FINAL
     {
-        QMutexLocker k(&_tileCacheMutex);
+        bool removeFile = false;
+        {
+            QReadLocker k(&_tileCacheLock);
 
-        assert(_isTiled);
-        if (!_isTiled) {
-            throw std::logic_error("allocTile() but cache is not tiled!");
-        }
-        std::set<TileCacheFilePtr>::iterator foundTileFile = _cacheFiles.find(file);
-        assert(foundTileFile != _cacheFiles.end());
-        if (foundTileFile == _cacheFiles.end()) {
-            return;
-        }
-        int index = dataOffset / _tileByteSize;
+            assert(_isTiled);
+            if (!_isTiled) {
+                throw std::logic_error("allocTile() but cache is not tiled!");
+            }
+            std::set<TileCacheFilePtr>::iterator foundTileFile = _cacheFiles.find(file);
+            assert(foundTileFile != _cacheFiles.end());
+            if (foundTileFile == _cacheFiles.end()) {
+                return;
+            }
+            int index = dataOffset / _tileByteSize;
 
-        // The dataOffset should be a multiple of the tile size
-        assert(_tileByteSize * index == dataOffset);
-        assert(index >= 0 && index < (int)(*foundTileFile)->usedTiles.size());
-        assert((*foundTileFile)->usedTiles[index]);
-        (*foundTileFile)->usedTiles[index] = false;
+            // The dataOffset should be a multiple of the tile size
+            assert(_tileByteSize * index == dataOffset);
+            assert(index >= 0 && index < (int)(*foundTileFile)->getTilesCount());
+            assert((*foundTileFile)->isTileUsed(index));
+
+            // If the file does not have any tile associated, remove it
+            // A use_count of 2 means that the tile file is only referenced by the cache itself and the entry calling
+            // the freeTile() function, hence once its freed, no tile should be using it anymore
+            if ((*foundTileFile).use_count() <= 2) {
+                // Do not remove the file except if we are clearing the cache
+                if (_clearingCache) {
+                    removeFile = true;
+                } else {
+                    // Invalidate this portion of the cache
+                    (*foundTileFile)->file->flush(MemoryFile::eFlushTypeInvalidate, (*foundTileFile)->file->data() + dataOffset, _tileByteSize);
+                }
+            }
 
-        // If the file does not have any tile associated, remove it
-        // A use_count of 2 means that the tile file is only referenced by the cache itself and the entry calling
-        // the freeTile() function, hence once its freed, no tile should be using it anymore
-        if ((*foundTileFile).use_count() <= 2) {
-            // Do not remove the file except if we are clearing the cache
-            if (_clearingCache) {
+            // Make the tile available only once it was flushed: another thread may allocate it and write to it
+            // as soon as its bit is cleared
+            (*foundTileFile)->freeTile(index);
+        }
+        if (removeFile) {
+            QWriteLocker k(&_tileCacheLock);
+            std::set<TileCacheFilePtr>::iterator foundTileFile = _cacheFiles.find(file);
+            // Another thread freeing a tile of the same file may have removed it already
+            if ( foundTileFile != _cacheFiles.end() && (*foundTileFile).use_count() <= 2 ) {
                 (*foundTileFile)->file->remove();
                 _cacheFiles.erase(foundTileFile);
-            } else {
-                // Invalidate this portion of the cache
-                (*foundTileFile)->file->flush(MemoryFile::eFlushTypeInvalidate, (*foundTileFile)->file->data() + dataOffset, _tileByteSize);
             }
-        } else {
-            _nextAvailableCacheFile = *foundTileFile;
-            _nextAvailableCacheFileIndex = index;
         }
     }
 
@@ -789,7 +923,7 @@ private:
                         ImageLockerHelper<EntryType>* entryLocker,
                         EntryTypePtr* returnValue) const
     {
-        //_lock must not be taken here
+        //No shard lock must be taken here, only the getLock of the shard of the key
 
         ///Before allocating the memory check that there's enough space to fit in memory
         appPTR->checkCacheFreeMemoryIsGoodEnough();
@@ -808,15 +942,11 @@ private:
             ++safeCounter;
         }
 
-        U64 memoryCacheSize, maximumInMemorySize;
-        {
-            QMutexLocker k(&_sizeLock);
-            memoryCacheSize = _memoryCacheSize;
-            maximumInMemorySize = std::max( (std::size_t)1, _maximumInMemorySize );
-        }
+        U64 memoryCacheSize = _memoryCacheSize;
+        U64 maximumInMemorySize = std::max( (std::size_t)1, _maximumInMemorySize.load() );
         {
-            QMutexLocker locker(&_lock);
             std::list<EntryTypePtr> entriesToBeDeleted;
+            U64 deletedSize = 0;
             double occupationPercentage = (double)memoryCacheSize / maximumInMemorySize;
             ///While the current cache size can't fit the new entry, erase the last recently used entries.
             ///Also if the total free RAM is under the limit of the system free RAM to keep free, erase LRU entries.
@@ -828,9 +958,12 @@ private:
 
                 for (typename std::list<EntryTypePtr>::iterator it = deleted.begin(); it != deleted.end(); ++it) {
                     entriesToBeDeleted.push_back(*it);
-                    memoryCacheSize -= (*it)->size();
+                    deletedSize += (*it)->size();
                 }
 
+                // Entries moved to the compressed portion are not deleted but no longer count in the memory size
+                memoryCacheSize = _memoryCacheSize;
+                memoryCacheSize = memoryCacheSize > deletedSize ? memoryCacheSize - deletedSize : 0;
                 occupationPercentage = (double)memoryCacheSize / maximumInMemorySize;
             }
 
@@ -846,26 +979,23 @@ private:
         {
             //If _maximumcacheSize == 0 we don't return 1 otherwise we would cause a deadlock
             QMutexLocker k(&_sizeLock);
-            double occupationPercentage =  _maximumCacheSize == 0 ? 0.99 : (double)_memoryCacheSize / _maximumCacheSize;
+            std::size_t maximumCacheSize = _maximumCacheSize;
+            double occupationPercentage =  maximumCacheSize == 0 ? 0.99 : (double)_memoryCacheSize / maximumCacheSize;
 
             //_memoryCacheSize member will get updated while images are being destroyed by the parallel thread.
             //we wait for cache memory occupation to be < 100% to be sure we don't hit swap here
             while ( occupationPercentage >= 1. && _deleterThread.isWorking() ) {
                 _memoryFullCondition.wait(k.mutex());
-                occupationPercentage =  _maximumCacheSize == 0 ? 0.99 : (double)_memoryCacheSize / _maximumCacheSize;
+                maximumCacheSize = _maximumCacheSize;
+                occupationPercentage =  maximumCacheSize == 0 ? 0.99 : (double)_memoryCacheSize / maximumCacheSize;
             }
         }
         if (_isTiled) {
 
-            QMutexLocker locker(&_lock);
             // For tiled caches, we insert directly into the disk cache, so make sure there is room for it
             std::list<EntryTypePtr> entriesToBeDeleted;
-            U64 diskCacheSize, maximumDiskCacheSize;
-            {
-                QMutexLocker k(&_sizeLock);
-                diskCacheSize = _diskCacheSize;
-                maximumDiskCacheSize = std::max( (std::size_t)1, _maximumCacheSize - _maximumInMemorySize );
-            }
+            U64 diskCacheSize = _diskCacheSize;
+            U64 maximumDiskCacheSize = std::max( (std::size_t)1, _maximumCacheSize - _maximumInMemorySize );
             double diskPercentage = (double)diskCacheSize / maximumDiskCacheSize;
             while (diskPercentage >= NATRON_CACHE_LIMIT_PERCENT) {
                 std::list<EntryTypePtr> deleted;
@@ -890,7 +1020,8 @@ private:
 
         }
         {
-            QMutexLocker locker(&_lock);
+            CacheShard& shard = getShard( key.getHash() );
+            QMutexLocker locker(&shard.lock);
 
             try {
                 returnValue->reset( new EntryType(key, params, this ) );
@@ -909,7 +1040,7 @@ private:
                 if (entryLocker) {
                     entryLocker->lock(*returnValue);
                 }
-                sealEntry(*returnValue, _isTiled ? false : true);
+                sealEntry(shard, *returnValue, _isTiled ? false : true);
             }
         }
     } // createInternal
@@ -919,13 +1050,14 @@ public:
     void swapOrInsert(const EntryTypePtr& entryToBeEvicted,
                       const EntryTypePtr& newEntry)
     {
-        QMutexLocker locker(&_lock);
-
         const typename EntryType::key_type& key = entryToBeEvicted->getKey();
         typename EntryType::hash_type hash = entryToBeEvicted->getHashKey();
+        CacheShard& shard = getShard(hash);
+        QMutexLocker locker(&shard.lock);
+
         ///find a matching value in the internal memory container
-        CacheIterator memoryCached = _memoryCache(hash);
-        if ( memoryCached != _memoryCache.end() ) {
+        CacheIterator memoryCached = shard.memoryCache(hash);
+        if ( memoryCached != shard.memoryCache.end() ) {
             std::list<EntryTypePtr> & ret = getValueFromIterator(memoryCached);
             for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
                 if ( ( (*it)->getKey() == key ) && ( (*it)->getParams() == entryToBeEvicted->getParams() ) ) {
@@ -937,8 +1069,8 @@ public:
             ret.push_back(newEntry);
         } else {
             ///Look in disk cache
-            CacheIterator diskCached = _diskCache(hash);
-            if ( diskCached != _diskCache.end() ) {
+            CacheIterator diskCached = shard.diskCache(hash);
+            if ( diskCached != shard.diskCache.end() ) {
                 ///Remove the old entry
                 std::list<EntryTypePtr> & ret = getValueFromIterator(diskCached);
                 for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
@@ -949,7 +1081,7 @@ public:
                 }
             }
             ///Insert in mem cache
-            _memoryCache.insert(hash, newEntry);
+            shard.memoryCache.insert(hash, newEntry);
         }
     }
 
@@ -989,13 +1121,16 @@ public:
         ///so that the memory freeing (which might be expensive for large images) doesn't happen while under the lock
 
         {
-            ///Be atomic, so it cannot be created by another thread in the meantime
-            QMutexLocker getlocker(&_getLock);
+            CacheShard& shard = getShard( key.getHash() );
+
+            ///Be atomic, so it cannot be created by another thread in the meantime.
+            ///Entries with the same hash always live in the same shard, hence locking the shard is enough.
+            QMutexLocker getlocker(&shard.getLock);
             std::list<EntryTypePtr> entries;
             bool didGetSucceed;
             {
-                QMutexLocker locker(&_lock);
-                didGetSucceed = getInternal(key, &entries);
+                QMutexLocker locker(&shard.lock);
+                didGetSucceed = getInternal(shard, key, &entries);
             }
             if (didGetSucceed) {
                 for (typename std::list<EntryTypePtr>::iterator it = entries.begin(); it != entries.end(); ++it) {
@@ -1019,7 +1154,7 @@ public:
     void clear()
     {
         {
-            QMutexLocker k(&_tileCacheMutex);
+            QWriteLocker k(&_tileCacheLock);
             _clearingCache = true;
         }
         clearDiskPortion();
@@ -1029,13 +1164,18 @@ public:
             ///block signals otherwise the we would be spammed of notifications
             _signalEmitter->blockSignals(true);
         }
-        QMutexLocker locker(&_lock);
-        std::pair<hash_type, EntryTypePtr> evictedFromMemory = _memoryCache.evict();
-        while (evictedFromMemory.second) {
-            if ( !_isTiled && evictedFromMemory.second->isStoredOnDisk() ) {
-                evictedFromMemory.second->removeAnyBackingFile();
+        for (int i = 0; i < NATRON_CACHE_SHARDS_COUNT; ++i) {
+            CacheShard& shard = _shards[i];
+            QMutexLocker locker(&shard.lock);
+            std::pair<hash_type, EntryTypePtr> evictedFromMemory = shard.memoryCache.evict();
+            while (evictedFromMemory.second) {
+                if ( !_isTiled && evictedFromMemory.second->isStoredOnDisk() ) {
+                    evictedFromMemory.second->removeAnyBackingFile();
+                }
+                evictedFromMemory = shard.memoryCache.evict();
+            }
+            while ( shard.compressedCache.evict().second ) {
             }
-            evictedFromMemory = _memoryCache.evict();
         }
 
         if (_signalEmitter) {
@@ -1044,7 +1184,7 @@ public:
         }
 
         {
-            QMutexLocker k(&_tileCacheMutex);
+            QWriteLocker k(&_tileCacheLock);
             _clearingCache = false;
         }
     }
@@ -1059,19 +1199,27 @@ public:
             ///block signals otherwise the we would be spammed of notifications
             _signalEmitter->blockSignals(true);
         }
-        QMutexLocker locker(&_lock);
 
-        /// An entry which has a use_count greater than 1 is not removable:
-        /// The backing file must not be removed because it might be read/written to
-        /// at the same time. The best we can do is just let it here in the cache.
-        std::pair<hash_type, EntryTypePtr> evictedFromDisk = _diskCache.evict();
-        //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
-        //we'll let the user of these entries purge the extra entries left in the cache later on
-        while (evictedFromDisk.second) {
-            if (!_isTiled) {
-                evictedFromDisk.second->removeAnyBackingFile();
+        // Remove the entries of previous sessions that were never looked-up
+        std::size_t evictedSize;
+        while ( evictPersistentIndexRecord(&evictedSize) ) {
+        }
+        for (int i = 0; i < NATRON_CACHE_SHARDS_COUNT; ++i) {
+            CacheShard& shard = _shards[i];
+            QMutexLocker locker(&shard.lock);
+
+            /// An entry which has a use_count greater than 1 is not removable:
+            /// The backing file must not be removed because it might be read/written to
+            /// at the same time. The best we can do is just let it here in the cache.
+            std::pair<hash_type, EntryTypePtr> evictedFromDisk = shard.diskCache.evict();
+            //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
+            //we'll let the user of these entries purge the extra entries left in the cache later on
+            while (evictedFromDisk.second) {
+                if (!_isTiled) {
+                    evictedFromDisk.second->removeAnyBackingFile();
+                }
+                evictedFromDisk = shard.diskCache.evict();
             }
-            evictedFromDisk = _diskCache.evict();
         }
 
 
@@ -1088,27 +1236,26 @@ public:
             ///block signals otherwise the we would be spammed of notifications
             _signalEmitter->blockSignals(true);
         }
-        QMutexLocker locker(&_lock);
-        std::pair<hash_type, EntryTypePtr> evictedFromMemory = _memoryCache.evict();
-        while (evictedFromMemory.second) {
-            // Move back the entry on disk if it can be store on disk
-            // For tiled caches, the tile is sharing the same file with other entries
-            // so we cannot close it, just remove the entry
-            if ( evictedFromMemory.second->isStoredOnDisk() && !_isTiled) {
-                evictedFromMemory.second->deallocate();
-                /*insert it back into the disk portion */
-
-                U64 diskCacheSize, maximumCacheSize;
-                {
-                    QMutexLocker k(&_sizeLock);
-                    diskCacheSize = _diskCacheSize;
-                    maximumCacheSize = _maximumCacheSize;
-                }
-
-                /*before that we need to clear the disk cache if it exceeds the maximum size allowed*/
-                while (diskCacheSize + evictedFromMemory.second->size() >= maximumCacheSize) {
-                    {
-                        std::pair<hash_type, EntryTypePtr> evictedFromDisk = _diskCache.evict();
+        for (int i = 0; i < NATRON_CACHE_SHARDS_COUNT; ++i) {
+            CacheShard& shard = _shards[i];
+            QMutexLocker locker(&shard.lock);
+            std::pair<hash_type, EntryTypePtr> evictedFromMemory = shard.memoryCache.evict();
+            while (evictedFromMemory.second) {
+                // Move back the entry on disk if it can be store on disk
+                // For tiled caches, the tile is sharing the same file with other entries
+                // so we cannot close it, just remove the entry
+                if ( evictedFromMemory.second->isStoredOnDisk() && !_isTiled) {
+                    evictedFromMemory.second->deallocate();
+                    addToPersistentIndex(*evictedFromMemory.second);
+                    /*insert it back into the disk portion */
+
+                    /*before that we need to clear the disk cache if it exceeds the maximum size allowed*/
+                    while (_diskCacheSize + evictedFromMemory.second->size() >= _maximumCacheSize) {
+                        std::size_t evictedSize;
+                        if ( evictPersistentIndexRecord(&evictedSize) ) {
+                            continue;
+                        }
+                        std::pair<hash_type, EntryTypePtr> evictedFromDisk = shard.diskCache.evict();
                         //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
                         //we'll let the user of these entries purge the extra entries left in the cache later on
                         if (!evictedFromDisk.second) {
@@ -1117,22 +1264,21 @@ public:
                         ///Erase the file from the disk if we reach the limit.
                         evictedFromDisk.second->removeAnyBackingFile();
                     }
-                    {
-                        QMutexLocker k(&_sizeLock);
-                        diskCacheSize = _diskCacheSize;
-                        maximumCacheSize = _maximumCacheSize;
+
+                    /*update the disk cache size*/
+                    CacheIterator existingDiskCacheEntry = shard.diskCache( evictedFromMemory.second->getHashKey() );
+                    /*if the entry doesn't exist on the disk cache,make a new list and insert it*/
+                    if ( existingDiskCacheEntry == shard.diskCache.end() ) {
+                        shard.diskCache.insert(evictedFromMemory.second->getHashKey(), evictedFromMemory.second);
                     }
                 }
 
-                /*update the disk cache size*/
-                CacheIterator existingDiskCacheEntry = _diskCache( evictedFromMemory.second->getHashKey() );
-                /*if the entry doesn't exist on the disk cache,make a new list and insert it*/
-                if ( existingDiskCacheEntry == _diskCache.end() ) {
-                    _diskCache.insert(evictedFromMemory.second->getHashKey(), evictedFromMemory.second);
-                }
+                evictedFromMemory = shard.memoryCache.evict();
             }
 
-            evictedFromMemory = _memoryCache.evict();
+            // Compressed entries are in RAM too
+            while ( shard.compressedCache.evict().second ) {
+            }
         }
 
         _signalEmitter->blockSignals(false);
@@ -1148,13 +1294,9 @@ public:
         std::list<EntryTypePtr> entriesToBeDeleted;
 
         {
-            QMutexLocker locker(&_lock);
-            U64 memoryCacheSize, maximumInMemorySize;
-            {
-                QMutexLocker k(&_sizeLock);
-                memoryCacheSize = _memoryCacheSize;
-                maximumInMemorySize = std::max( (std::size_t)1, _maximumInMemorySize );
-            }
+            U64 memoryCacheSize = _memoryCacheSize;
+            U64 maximumInMemorySize = std::max( (std::size_t)1, _maximumInMemorySize.load() );
+            U64 deletedSize = 0;
             double occupationPercentage = (double)memoryCacheSize / maximumInMemorySize;
             while (occupationPercentage >= NATRON_CACHE_LIMIT_PERCENT) {
                 std::list<EntryTypePtr> deleted;
@@ -1164,21 +1306,42 @@ public:
 
                 for (typename std::list<EntryTypePtr>::iterator it = deleted.begin(); it != deleted.end(); ++it) {
                     if ( !(*it)->isStoredOnDisk() ) {
-                        memoryCacheSize -= (*it)->size();
+                        deletedSize += (*it)->size();
                     }
                     entriesToBeDeleted.push_back(*it);
                 }
+                // Entries moved to the compressed portion are not deleted but no longer count in the memory size
+                memoryCacheSize = _memoryCacheSize;
+                memoryCacheSize = memoryCacheSize > deletedSize ? memoryCacheSize - deletedSize : 0;
                 occupationPercentage = (double)memoryCacheSize / maximumInMemorySize;
             }
 
-            U64 diskCacheSize, maximumDiskCacheSize;
-            {
-                QMutexLocker k(&_sizeLock);
-                diskCacheSize = _diskCacheSize;
-                maximumDiskCacheSize = std::max( (std::size_t)1, _maximumCacheSize - _maximumInMemorySize );
+            // The compressed portion may exceed its maximum size if it was lowered
+            U64 compressedCacheSize = _compressedCacheSize;
+            while ( compressedCacheSize > _maximumCompressedSize ) {
+                std::list<EntryTypePtr> deleted;
+                if ( !tryEvictCompressedEntry(deleted) ) {
+                    break;
+                }
+
+                for (typename std::list<EntryTypePtr>::iterator it = deleted.begin(); it != deleted.end(); ++it) {
+                    compressedCacheSize -= std::min( compressedCacheSize, (U64)(*it)->getCompressedSize() );
+                    entriesToBeDeleted.push_back(*it);
+                }
             }
+
+            U64 diskCacheSize = _diskCacheSize;
+            U64 maximumDiskCacheSize = std::max( (std::size_t)1, _maximumCacheSize - _maximumInMemorySize );
             double diskPercentage = (double)diskCacheSize / maximumDiskCacheSize;
             while (diskPercentage >= NATRON_CACHE_LIMIT_PERCENT) {
+                // The entries of previous sessions that were never looked-up are evicted first
+                std::size_t evictedSize;
+                if ( evictPersistentIndexRecord(&evictedSize) ) {
+                    diskCacheSize -= std::min( diskCacheSize, (U64)evictedSize );
+                    diskPercentage = (double)diskCacheSize / maximumDiskCacheSize;
+                    continue;
+                }
+
                 std::list<EntryTypePtr> deleted;
                 if ( !tryEvictDiskEntry(deleted) ) {
                     break;
@@ -1202,21 +1365,28 @@ public:
      **/
     void getCopy(std::list<EntryTypePtr>* copy) const
     {
-        QMutexLocker locker(&_lock);
+        for (int i = 0; i < NATRON_CACHE_SHARDS_COUNT; ++i) {
+            CacheShard& shard = _shards[i];
+            QMutexLocker locker(&shard.lock);
 
-        for (CacheIterator it = _memoryCache.begin(); it != _memoryCache.end(); ++it) {
-            const std::list<EntryTypePtr> & entries = getValueFromIterator(it);
-            copy->insert( copy->end(), entries.begin(), entries.end() );
-        }
-        for (CacheIterator it = _diskCache.begin(); it != _diskCache.end(); ++it) {
-            const std::list<EntryTypePtr> & entries = getValueFromIterator(it);
-            copy->insert( copy->end(), entries.begin(), entries.end() );
+            for (CacheIterator it = shard.memoryCache.begin(); it != shard.memoryCache.end(); ++it) {
+                const std::list<EntryTypePtr> & entries = getValueFromIterator(it);
+                copy->insert( copy->end(), entries.begin(), entries.end() );
+            }
+            for (CacheIterator it = shard.compressedCache.begin(); it != shard.compressedCache.end(); ++it) {
+                const std::list<EntryTypePtr> & entries = getValueFromIterator(it);
+                copy->insert( copy->end(), entries.begin(), entries.end() );
+            }
+            for (CacheIterator it = shard.diskCache.begin(); it != shard.diskCache.end(); ++it) {
+                const std::list<EntryTypePtr> & entries = getValueFromIterator(it);
+                copy->insert( copy->end(), entries.begin(), entries.end() );
+            }
         }
     }
 
     /**
-     * @brief Removes the last recently used entry from the in-memory cache.
-     * This is expensive since it takes the lock. Returns false
+     * @brief Removes the last recently used entry of a shard from the in-memory cache.
+     * This is expensive since it takes the shard locks. Returns false
      * if there's nothing left to evict.
      **/
     bool evictLRUInMemoryEntry() const
@@ -1224,25 +1394,31 @@ public:
         ///Make sure the shared_ptrs live in this list and are destroyed not while under the lock
         ///so that the memory freeing (which might be expensive for large images) doesn't happen while under the lock
         std::list<EntryTypePtr> entriesToBeDeleted;
-        bool ret;
-        {
-            QMutexLocker locker(&_lock);
-            ret = tryEvictInMemoryEntry(entriesToBeDeleted);
-        }
 
-        return ret;
+        return tryEvictInMemoryEntry(entriesToBeDeleted);
     }
 
     /**
-     * @brief Removes the last recently used entry from the disk cache.
-     * This is expensive since it takes the lock. Returns false
+     * @brief Removes the last recently used entry of a shard from the compressed portion of the cache.
+     * This is expensive since it takes the shard locks. Returns false
      * if there's nothing left to evict.
      **/
-    bool evictLRUDiskEntry() const
+    bool evictLRUCompressedEntry() const
     {
+        std::list<EntryTypePtr> entriesToBeDeleted;
+
+        return tryEvictCompressedEntry(entriesToBeDeleted);
+    }
 
-        QMutexLocker locker(&_lock);
+    /**
+     * @brief Removes the last recently used entry of a shard from the disk cache.
+     * This is expensive since it takes the shard locks. Returns false
+     * if there's nothing left to evict.
+     **/
+    bool evictLRUDiskEntry() const
+    {
         std::list<EntryTypePtr> entriesToBeDeleted;
+
         return tryEvictDiskEntry(entriesToBeDeleted);
     }
 
@@ -1254,24 +1430,34 @@ public:
                                         std::size_t newSize) const OVERRIDE FINAL
     {
         ///The entry has notified it's memory layout has changed, it must have been due to an action from the cache
-        QMutexLocker k(&_sizeLock);
 
         ///This function can only be called for RAM buffers or while a memory mapped file is mapped into the RAM, so
         ///we just have to modify the RAM size.
 
         ///Avoid overflows, _memoryCacheSize may not always fallback to 0
-        qint64 diff = (qint64)newSize - (qint64)oldSize;
-
-        if (diff < 0) {
-            _memoryCacheSize = diff > (qint64)_memoryCacheSize ? 0 : _memoryCacheSize + diff;
+        if (newSize < oldSize) {
+            atomicSubtractClamped(_memoryCacheSize, oldSize - newSize);
         } else {
-            _memoryCacheSize += diff;
+            _memoryCacheSize += newSize - oldSize;
         }
 #ifdef NATRON_DEBUG_CACHE
         qDebug() << cacheName().c_str() << " memory size: " << printAsRAM(_memoryCacheSize);
 #endif
     }
 
+    virtual void notifyEntryCompressedSizeChanged(std::size_t oldSize,
+                                                  std::size_t newSize) const OVERRIDE FINAL
+    {
+        if (newSize < oldSize) {
+            atomicSubtractClamped(_compressedCacheSize, oldSize - newSize);
+        } else {
+            _compressedCacheSize += newSize - oldSize;
+        }
+#ifdef NATRON_DEBUG_CACHE
+        qDebug() << cacheName().c_str() << " compressed size: " << printAsRAM(_compressedCacheSize);
+#endif
+    }
+
     /**
      * @brief To be called by a CacheEntry on allocation.
      **/
@@ -1279,10 +1465,8 @@ public:
                                       std::size_t size,
                                       StorageModeEnum storage) const OVERRIDE FINAL
     {
-        ///The entry has notified it's memory layout has changed, it must have been due to an action from the cache, hence the
-        ///lock should already be taken.
-        QMutexLocker k(&_sizeLock);
-
+        ///The entry has notified it's memory layout has changed, it must have been due to an action from the cache.
+        ///Sizes are atomic so that entries of different shards may be allocated concurrently.
         if (storage == eStorageModeDisk) {
             if (_isTiled) {
                 // For tile caches, we do not control which portion of the cache is in memory, so just keep track of the disk portion
@@ -1310,15 +1494,13 @@ public:
                                       std::size_t size,
                                       StorageModeEnum storage) const OVERRIDE FINAL
     {
-        QMutexLocker k(&_sizeLock);
-
         if (storage == eStorageModeRAM) {
-            _memoryCacheSize = size > _memoryCacheSize ? 0 : _memoryCacheSize - size;
+            atomicSubtractClamped(_memoryCacheSize, size);
 #ifdef NATRON_DEBUG_CACHE
             qDebug() << cacheName().c_str() << " memory size: " << printAsRAM(_memoryCacheSize);
 #endif
         } else if (storage == eStorageModeDisk) {
-            _diskCacheSize = size > _diskCacheSize ? 0 : _diskCacheSize - size;
+            atomicSubtractClamped(_diskCacheSize, size);
 #ifdef NATRON_DEBUG_CACHE
             qDebug() << cacheName().c_str() << " disk size: " << printAsRAM(_diskCacheSize);
 #endif
@@ -1349,12 +1531,11 @@ public:
         if (_tearingDown) {
             return;
         }
-        QMutexLocker k(&_sizeLock);
 
         assert(oldStorage != newStorage);
         assert(newStorage != eStorageModeNone);
         if (oldStorage == eStorageModeRAM) {
-            _memoryCacheSize = size > _memoryCacheSize ? 0 : _memoryCacheSize - size;
+            atomicSubtractClamped(_memoryCacheSize, size);
             _diskCacheSize += size;
 #ifdef NATRON_DEBUG_CACHE
             qDebug() << cacheName().c_str() << " memory size: " << printAsRAM(_memoryCacheSize);
@@ -1364,7 +1545,7 @@ public:
             appPTR->decreaseNCacheFilesOpened();
         } else if (oldStorage == eStorageModeDisk) {
             _memoryCacheSize += size;
-            _diskCacheSize = size > _diskCacheSize ? 0 : _diskCacheSize - size;
+            atomicSubtractClamped(_diskCacheSize, size);
 #ifdef NATRON_DEBUG_CACHE
             qDebug() << cacheName().c_str() << " memory size: " << printAsRAM(_memoryCacheSize);
             qDebug() << cacheName().c_str() << " disk size: " << printAsRAM(_diskCacheSize);
@@ -1388,6 +1569,14 @@ public:
         appPTR->decreaseNCacheFilesOpened();
     }
 
+    virtual void notifyEntryBackingFileRemoved(U64 hash,
+                                               const std::string& filePath) const OVERRIDE FINAL
+    {
+        if (_persistentIndex) {
+            _persistentIndex->remove( hash, toIndexFilePath(filePath) );
+        }
+    }
+
     // const data member: no need to take the lock
     const std::string & cacheName() const
     {
@@ -1424,48 +1613,65 @@ public:
         return newCachePath.toStdString();
     }
 
-    void setMaximumCacheSize(U64 newSize)
+    std::string getPersistentIndexFilePath() const
     {
-        QMutexLocker k(&_sizeLock);
+        QString newCachePath( getCachePath() );
+        StrUtils::ensureLastPathSeparator(newCachePath);
+
+        newCachePath.append( QString::fromUtf8("index." NATRON_CACHE_FILE_EXT) );
+
+        return newCachePath.toStdString();
+    }
 
+    void setMaximumCacheSize(U64 newSize)
+    {
         _maximumCacheSize = newSize;
     }
 
     void setMaximumInMemorySize(double percentage)
     {
-        QMutexLocker k(&_sizeLock);
-
         _maximumInMemorySize = _maximumCacheSize * percentage;
     }
 
     std::size_t getMaximumSize() const
     {
-        QMutexLocker k(&_sizeLock);
-
         return _maximumCacheSize;
     }
 
     std::size_t getMaximumMemorySize() const
     {
-        QMutexLocker k(&_sizeLock);
-
         return _maximumInMemorySize;
     }
 
     std::size_t getMemoryCacheSize() const
     {
-        QMutexLocker k(&_sizeLock);
-
         return _memoryCacheSize;
     }
 
     std::size_t getDiskCacheSize() const
     {
-        QMutexLocker k(&_sizeLock);
-
         return _diskCacheSize;
     }
 
+    /**
+     * @brief Sets the maximum size of the compressed portion of the cache, in which entries evicted from the RAM
+     * are kept compressed instead of being deleted. 0 disables it. This has no effect on tiled caches.
+     **/
+    void setMaximumCompressedSize(std::size_t size)
+    {
+        _maximumCompressedSize = size;
+    }
+
+    std::size_t getMaximumCompressedSize() const
+    {
+        return _maximumCompressedSize;
+    }
+
+    std::size_t getCompressedCacheSize() const
+    {
+        return _compressedCacheSize;
+    }
+
     CacheSignalEmitterPtr activateSignalEmitter() const
     {
         return _signalEmitter;
@@ -1483,9 +1689,10 @@ public:
         std::list<EntryTypePtr> toRemove;
 
         {
-            QMutexLocker l(&_lock);
-            CacheIterator existingEntry = _memoryCache( entry->getHashKey() );
-            if ( existingEntry != _memoryCache.end() ) {
+            CacheShard& shard = getShard( entry->getHashKey() );
+            QMutexLocker l(&shard.lock);
+            CacheIterator existingEntry = shard.memoryCache( entry->getHashKey() );
+            if ( existingEntry != shard.memoryCache.end() ) {
                 std::list<EntryTypePtr> & ret = getValueFromIterator(existingEntry);
                 for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
                     if ( (*it)->getKey() == entry->getKey() ) {
@@ -1495,11 +1702,11 @@ public:
                     }
                 }
                 if ( ret.empty() ) {
-                    _memoryCache.erase(existingEntry);
+                    shard.memoryCache.erase(existingEntry);
                 }
             } else {
-                existingEntry = _diskCache( entry->getHashKey() );
-                if ( existingEntry != _diskCache.end() ) {
+                existingEntry = shard.diskCache( entry->getHashKey() );
+                if ( existingEntry != shard.diskCache.end() ) {
                     std::list<EntryTypePtr> & ret = getValueFromIterator(existingEntry);
                     for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
                         if ( (*it)->getKey() == entry->getKey() ) {
@@ -1509,11 +1716,27 @@ public:
                         }
                     }
                     if ( ret.empty() ) {
-                        _diskCache.erase(existingEntry);
+                        shard.diskCache.erase(existingEntry);
                     }
                 }
             }
-        } // QMutexLocker l(&_lock);
+
+            // Other entries with the same hash may have been compressed
+            existingEntry = shard.compressedCache( entry->getHashKey() );
+            if ( existingEntry != shard.compressedCache.end() ) {
+                std::list<EntryTypePtr> & ret = getValueFromIterator(existingEntry);
+                for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
+                    if ( (*it)->getKey() == entry->getKey() ) {
+                        toRemove.push_back(*it);
+                        ret.erase(it);
+                        break;
+                    }
+                }
+                if ( ret.empty() ) {
+                    shard.compressedCache.erase(existingEntry);
+                }
+            }
+        } // QMutexLocker l(&shard.lock);
         if ( !toRemove.empty() ) {
             _deleterThread.appendToQueue(toRemove);
 
@@ -1527,25 +1750,35 @@ public:
     {
         std::list<EntryTypePtr> toRemove;
         {
-            QMutexLocker l(&_lock);
-            CacheIterator existingEntry = _memoryCache( hash);
-            if ( existingEntry != _memoryCache.end() ) {
+            CacheShard& shard = getShard(hash);
+            QMutexLocker l(&shard.lock);
+            CacheIterator existingEntry = shard.memoryCache( hash);
+            if ( existingEntry != shard.memoryCache.end() ) {
                 std::list<EntryTypePtr> & ret = getValueFromIterator(existingEntry);
                 for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
                     toRemove.push_back(*it);
                 }
-                _memoryCache.erase(existingEntry);
+                shard.memoryCache.erase(existingEntry);
             } else {
-                existingEntry = _diskCache( hash );
-                if ( existingEntry != _diskCache.end() ) {
+                existingEntry = shard.diskCache( hash );
+                if ( existingEntry != shard.diskCache.end() ) {
                     std::list<EntryTypePtr> & ret = getValueFromIterator(existingEntry);
                     for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
                         toRemove.push_back(*it);
                     }
-                    _diskCache.erase(existingEntry);
+                    shard.diskCache.erase(existingEntry);
                 }
             }
-        } // QMutexLocker l(&_lock);
+
+            existingEntry = shard.compressedCache(hash);
+            if ( existingEntry != shard.compressedCache.end() ) {
+                std::list<EntryTypePtr> & ret = getValueFromIterator(existingEntry);
+                for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
+                    toRemove.push_back(*it);
+                }
+                shard.compressedCache.erase(existingEntry);
+            }
+        } // QMutexLocker l(&shard.lock);
 
         if ( !toRemove.empty() ) {
             _deleterThread.appendToQueue(toRemove);
@@ -1564,6 +1797,40 @@ public:
     /*Restores the cache from disk.*/
     void restore(const CacheTOC & tableOfContents);
 
+    /**
+     * @brief Opens the persistent index of the entries stored on disk, instead of restoring them with restore():
+     * the entries stored on disk by previous sessions are then restored when they are looked-up.
+     * This must be called before the cache is used. This has no effect on tiled caches.
+     * This function throws a std::runtime_error if the index could not be opened.
+     **/
+    void openPersistentIndex();
+
+    bool hasPersistentIndex() const
+    {
+        return (bool)_persistentIndex;
+    }
+
+    /**
+     * @brief Writes the entries mapped in RAM back to disk and the persistent index to its file, instead of save().
+     **/
+    void syncPersistentIndex()
+    {
+        clearInMemoryPortion(false);
+        if (_persistentIndex) {
+            _persistentIndex->flush();
+        }
+    }
+
+    /**
+     * @brief Starts a new persistent index, to be called when the cache location was wiped.
+     **/
+    void clearPersistentIndex()
+    {
+        if (_persistentIndex) {
+            _persistentIndex->clear();
+        }
+    }
+
 
     void removeAllEntriesWithDifferentNodeHashForHolderPublic(const CacheEntryHolder* holder,
                                                               U64 nodeHash)
@@ -1589,29 +1856,45 @@ public:
         *diskOccupied = 0;
 
         std::string holderID = holder->getCacheID();
-        QMutexLocker locker(&_lock);
+        for (int i = 0; i < NATRON_CACHE_SHARDS_COUNT; ++i) {
+            CacheShard& shard = _shards[i];
+            QMutexLocker locker(&shard.lock);
 
-        for (ConstCacheIterator memIt = _memoryCache.begin(); memIt != _memoryCache.end(); ++memIt) {
-            const std::list<EntryTypePtr> & entries = getValueFromIterator(memIt);
-            if ( !entries.empty() ) {
-                const EntryTypePtr & front = entries.front();
+            for (ConstCacheIterator memIt = shard.memoryCache.begin(); memIt != shard.memoryCache.end(); ++memIt) {
+                const std::list<EntryTypePtr> & entries = getValueFromIterator(memIt);
+                if ( !entries.empty() ) {
+                    const EntryTypePtr & front = entries.front();
 
-                if (front->getKey().getCacheHolderID() == holderID) {
-                    for (typename std::list<EntryTypePtr>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
-                        *ramOccupied += (*it)->size();
+                    if (front->getKey().getCacheHolderID() == holderID) {
+                        for (typename std::list<EntryTypePtr>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+                            *ramOccupied += (*it)->size();
+                        }
                     }
                 }
             }
-        }
 
-        for (ConstCacheIterator memIt = _diskCache.begin(); memIt != _diskCache.end(); ++memIt) {
-            const std::list<EntryTypePtr> & entries = getValueFromIterator(memIt);
-            if ( !entries.empty() ) {
-                const EntryTypePtr & front = entries.front();
+            for (ConstCacheIterator memIt = shard.compressedCache.begin(); memIt != shard.compressedCache.end(); ++memIt) {
+                const std::list<EntryTypePtr> & entries = getValueFromIterator(memIt);
+                if ( !entries.empty() ) {
+                    const EntryTypePtr & front = entries.front();
 
-                if (front->getKey().getCacheHolderID() == holderID) {
-                    for (typename std::list<EntryTypePtr>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
-                        *diskOccupied += (*it)->size();
+                    if (front->getKey().getCacheHolderID() == holderID) {
+                        for (typename std::list<EntryTypePtr>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+                            *ramOccupied += (*it)->size() + (*it)->getCompressedSize();
+                        }
+                    }
+                }
+            }
+
+            for (ConstCacheIterator memIt = shard.diskCache.begin(); memIt != shard.diskCache.end(); ++memIt) {
+                const std::list<EntryTypePtr> & entries = getValueFromIterator(memIt);
+                if ( !entries.empty() ) {
+                    const EntryTypePtr & front = entries.front();
+
+                    if (front->getKey().getCacheHolderID() == holderID) {
+                        for (typename std::list<EntryTypePtr>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+                            *diskOccupied += (*it)->size();
+                        }
                     }
                 }
             }
@@ -1625,11 +1908,13 @@ private:
                                                                        bool removeAll) OVERRIDE FINAL
     {
         std::list<EntryTypePtr> toDelete;
-        CacheContainer newMemCache, newDiskCache;
-        {
-            QMutexLocker locker(&_lock);
 
-            for (ConstCacheIterator memIt = _memoryCache.begin(); memIt != _memoryCache.end(); ++memIt) {
+        for (int i = 0; i < NATRON_CACHE_SHARDS_COUNT; ++i) {
+            CacheShard& shard = _shards[i];
+            CacheContainer newMemCache, newCompressedCache, newDiskCache;
+            QMutexLocker locker(&shard.lock);
+
+            for (ConstCacheIterator memIt = shard.memoryCache.begin(); memIt != shard.memoryCache.end(); ++memIt) {
                 const std::list<EntryTypePtr> & entries = getValueFromIterator(memIt);
                 if ( !entries.empty() ) {
                     const EntryTypePtr & front = entries.front();
@@ -1646,7 +1931,24 @@ private:
                 }
             }
 
-            for (ConstCacheIterator dIt = _diskCache.begin(); dIt != _diskCache.end(); ++dIt) {
+            for (ConstCacheIterator cIt = shard.compressedCache.begin(); cIt != shard.compressedCache.end(); ++cIt) {
+                const std::list<EntryTypePtr> & entries = getValueFromIterator(cIt);
+                if ( !entries.empty() ) {
+                    const EntryTypePtr & front = entries.front();
+
+                    if ( (front->getKey().getCacheHolderID() == holderID) &&
+                         ( ( front->getKey().getTreeVersion() != nodeHash) || removeAll ) ) {
+                        for (typename std::list<EntryTypePtr>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+                            toDelete.push_back(*it);
+                        }
+                    } else {
+                        typename EntryType::hash_type hash = front->getHashKey();
+                        newCompressedCache.insert(hash, entries);
+                    }
+                }
+            }
+
+            for (ConstCacheIterator dIt = shard.diskCache.begin(); dIt != shard.diskCache.end(); ++dIt) {
                 const std::list<EntryTypePtr> & entries = getValueFromIterator(dIt);
                 if ( !entries.empty() ) {
                     const EntryTypePtr & front = entries.front();
@@ -1663,9 +1965,10 @@ private:
                 }
             }
 
-            _memoryCache = newMemCache;
-            _diskCache = newDiskCache;
-        } // QMutexLocker locker(&_lock);
+            shard.memoryCache = newMemCache;
+            shard.compressedCache = newCompressedCache;
+            shard.diskCache = newDiskCache;
+        } // for each shard
 
         if ( !toDelete.empty() ) {
             _deleterThread.appendToQueue(toDelete);
@@ -1676,16 +1979,17 @@ private:
         }
     } // removeAllEntriesWithDifferentNodeHashForHolderPrivate
 
-    bool getInternal(const typename EntryType::key_type & key,
+    bool getInternal(CacheShard& shard,
+                     const typename EntryType::key_type & key,
                      std::list<EntryTypePtr>* returnValue) const
     {
         ///Private should be locked
-        assert( !_lock.tryLock() );
+        assert( !shard.lock.tryLock() );
 
         ///find a matching value in the internal memory container
-        CacheIterator memoryCached = _memoryCache( key.getHash() );
+        CacheIterator memoryCached = shard.memoryCache( key.getHash() );
 
-        if ( memoryCached != _memoryCache.end() ) {
+        if ( memoryCached != shard.memoryCache.end() ) {
             ///we found something with a matching hash key. There may be several entries linked to
             ///this key, we need to find one with matching params
             std::list<EntryTypePtr> & ret = getValueFromIterator(memoryCached);
@@ -1703,12 +2007,65 @@ private:
 
             return returnValue->size() > 0;
         } else {
+            ///look-up the entries that were compressed when evicted from the memory cache
+            CacheIterator compressedCached = shard.compressedCache( key.getHash() );
+            if ( compressedCached != shard.compressedCache.end() ) {
+                std::list<EntryTypePtr> & ret = getValueFromIterator(compressedCached);
+                for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
+                    if ( (*it)->getKey() == key ) {
+                        EntryTypePtr entry = *it;
+                        ret.erase(it);
+                        if ( ret.empty() ) {
+                            shard.compressedCache.erase(compressedCached);
+                        }
+
+                        try {
+                            entry->uncompressMemory();
+                        } catch (const std::exception & e) {
+                            qDebug() << "Error while uncompressing cache entry: " << e.what();
+
+                            return false;
+                        }
+
+                        //put it back into the RAM
+                        shard.memoryCache.insert(entry->getHashKey(), entry);
+                        returnValue->push_back(entry);
+                        if (_signalEmitter) {
+                            _signalEmitter->emitAddedEntry( key.getTime() );
+                        }
+
+                        //now make room in the RAM, by compressing other entries of this shard
+                        std::list<EntryTypePtr> entriesToBeDeleted;
+                        U64 deletedSize = 0;
+                        for (;;) {
+                            U64 memoryCacheSize = _memoryCacheSize;
+                            if (memoryCacheSize <= deletedSize || memoryCacheSize - deletedSize <= _maximumInMemorySize) {
+                                break;
+                            }
+                            std::list<EntryTypePtr> deleted;
+                            if ( !tryEvictInMemoryEntry(shard, deleted) ) {
+                                break;
+                            }
+                            for (typename std::list<EntryTypePtr>::iterator it2 = deleted.begin(); it2 != deleted.end(); ++it2) {
+                                deletedSize += (*it2)->size();
+                                entriesToBeDeleted.push_back(*it2);
+                            }
+                        }
+                        if ( !entriesToBeDeleted.empty() ) {
+                            _deleterThread.appendToQueue(entriesToBeDeleted);
+                        }
+
+                        return true;
+                    }
+                }
+            }
+
             ///fallback on the disk cache internal container
-            CacheIterator diskCached = _diskCache( key.getHash() );
+            CacheIterator diskCached = shard.diskCache( key.getHash() );
 
-            if ( diskCached == _diskCache.end() ) {
-                /*the entry was neither in memory or disk, just allocate a new one*/
-                return false;
+            if ( diskCached == shard.diskCache.end() ) {
+                /*the entry was neither in memory or disk, it may have been stored on disk by a previous session*/
+                return restoreFromPersistentIndex(shard, key, returnValue);
             } else {
                 /*we found something with a matching hash key. There may be several entries linked to
                    this key, we need to find one with matching values(operator ==)*/
@@ -1738,28 +2095,17 @@ private:
                             }
 
                             //put it back into the RAM
-                            _memoryCache.insert( (*it)->getHashKey(), *it );
-
+                            shard.memoryCache.insert( (*it)->getHashKey(), *it );
 
-                            U64 memoryCacheSize, maximumInMemorySize;
-                            {
-                                QMutexLocker k(&_sizeLock);
-                                memoryCacheSize = _memoryCacheSize;
-                                maximumInMemorySize = _maximumInMemorySize;
-                            }
                             std::list<EntryTypePtr> entriesToBeDeleted;
 
                             //now clear extra entries from the disk cache so it doesn't exceed the RAM limit.
-                            while (memoryCacheSize > maximumInMemorySize) {
-                                if ( !tryEvictInMemoryEntry(entriesToBeDeleted) ) {
+                            //Only this shard is locked, so we can only evict entries from it: other shards
+                            //will be trimmed by the next call to createInternal()
+                            while (_memoryCacheSize > _maximumInMemorySize) {
+                                if ( !tryEvictInMemoryEntry(shard, entriesToBeDeleted) ) {
                                     break;
                                 }
-
-                                {
-                                    QMutexLocker k(&_sizeLock);
-                                    memoryCacheSize = _memoryCacheSize;
-                                    maximumInMemorySize = _maximumInMemorySize;
-                                }
                             }
                         }
                         
@@ -1775,16 +2121,16 @@ private:
                             ret.erase(it);
 
                             ///Remove it from the disk cache
-                            _diskCache.erase(diskCached);
+                            shard.diskCache.erase(diskCached);
                         }
 
                         return true;
                     }
                 }
 
-                /*if we reache here it means no entries linked to the hash key matches the params,then
-                   we allocate a new one*/
-                return false;
+                /*if we reache here it means no entries linked to the hash key matches the params, it may have
+                   been stored on disk by a previous session*/
+                return restoreFromPersistentIndex(shard, key, returnValue);
             }
         }
     } // getInternal
@@ -1792,25 +2138,26 @@ private:
     /** @brief Inserts into the cache an entry that was previously allocated by the createInternal()
      * function. This is called directly by createInternal() if the allocation was successful
      **/
-    void sealEntry(const EntryTypePtr & entry,
+    void sealEntry(CacheShard& shard,
+                   const EntryTypePtr & entry,
                    bool inMemory) const
     {
-        assert( !_lock.tryLock() );   // must be locked
+        assert( !shard.lock.tryLock() );   // must be locked
         typename EntryType::hash_type hash = entry->getHashKey();
 
         if (inMemory) {
             /*if the entry doesn't exist on the memory cache,make a new list and insert it*/
-            CacheIterator existingEntry = _memoryCache(hash);
-            if ( existingEntry == _memoryCache.end() ) {
-                _memoryCache.insert(hash, entry);
+            CacheIterator existingEntry = shard.memoryCache(hash);
+            if ( existingEntry == shard.memoryCache.end() ) {
+                shard.memoryCache.insert(hash, entry);
             } else {
                 /*append to the existing list*/
                 getValueFromIterator(existingEntry).push_back(entry);
             }
         } else {
-            CacheIterator existingEntry = _diskCache(hash);
-            if ( existingEntry == _diskCache.end() ) {
-                _diskCache.insert(hash, entry);
+            CacheIterator existingEntry = shard.diskCache(hash);
+            if ( existingEntry == shard.diskCache.end() ) {
+                shard.diskCache.insert(hash, entry);
             } else {
                 /*append to the existing list*/
                 getValueFromIterator(existingEntry).push_back(entry);
@@ -1818,10 +2165,49 @@ private:
         }
     }
 
+    /**
+     * @brief Evicts the LRU in-memory entry of the first shard (starting from _nextEvictedShard) that has an
+     * evictable entry. No shard lock must be held by the caller.
+     **/
     bool tryEvictInMemoryEntry(std::list<EntryTypePtr> & entriesToBeDeleted) const
     {
-        assert( !_lock.tryLock() );
-        std::pair<hash_type, EntryTypePtr> evicted = _memoryCache.evict();
+        unsigned int firstShard = _nextEvictedShard.fetch_add(1);
+
+        for (int i = 0; i < NATRON_CACHE_SHARDS_COUNT; ++i) {
+            CacheShard& shard = _shards[(firstShard + i) & (NATRON_CACHE_SHARDS_COUNT - 1)];
+            QMutexLocker locker(&shard.lock);
+            if ( tryEvictInMemoryEntry(shard, entriesToBeDeleted) ) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /**
+     * @brief Evicts the LRU on-disk entry of the first shard (starting from _nextEvictedShard) that has an
+     * evictable entry. No shard lock must be held by the caller.
+     **/
+    bool tryEvictDiskEntry(std::list<EntryTypePtr> & entriesToBeDeleted) const
+    {
+        unsigned int firstShard = _nextEvictedShard.fetch_add(1);
+
+        for (int i = 0; i < NATRON_CACHE_SHARDS_COUNT; ++i) {
+            CacheShard& shard = _shards[(firstShard + i) & (NATRON_CACHE_SHARDS_COUNT - 1)];
+            QMutexLocker locker(&shard.lock);
+            if ( tryEvictDiskEntry(shard, entriesToBeDeleted) ) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool tryEvictInMemoryEntry(CacheShard& shard,
+                               std::list<EntryTypePtr> & entriesToBeDeleted) const
+    {
+        assert( !shard.lock.tryLock() );
+        std::pair<hash_type, EntryTypePtr> evicted = shard.memoryCache.evict();
         //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
         //we'll let the user of these entries purge the extra entries left in the cache later on
         if (!evicted.second) {
@@ -1832,27 +2218,32 @@ private:
         // If the cache is tiled, the entry is sharing the same file with other entries so we cannot close the file.
         // Just deallocate it
         if ( !evicted.second->isStoredOnDisk()) {
-            entriesToBeDeleted.push_back(evicted.second);
+            // Keep it compressed rather than deleting it if the compressed portion of the cache is enabled
+            if ( _isTiled || (_maximumCompressedSize == 0) || !moveToCompressedCache(shard, evicted.second, entriesToBeDeleted) ) {
+                entriesToBeDeleted.push_back(evicted.second);
+            }
         } else {
 
             assert( evicted.second.unique() );
 
             ///This is EXPENSIVE! it calls msync
             evicted.second->deallocate();
+            addToPersistentIndex(*evicted.second);
 
             /*insert it back into the disk portion */
 
-            U64 diskCacheSize, maximumCacheSize, maximumInMemorySize;
-            {
-                QMutexLocker k(&_sizeLock);
-                diskCacheSize = _diskCacheSize;
-                maximumInMemorySize = _maximumInMemorySize;
-                maximumCacheSize = _maximumCacheSize;
-            }
+            U64 diskCacheSize = _diskCacheSize;
 
             /*before that we need to clear the disk cache if it exceeds the maximum size allowed*/
-            while ( ( diskCacheSize  + evicted.second->size() ) >= (maximumCacheSize - maximumInMemorySize) ) {
-                std::pair<hash_type, EntryTypePtr> evictedFromDisk = _diskCache.evict();
+            while ( ( diskCacheSize  + evicted.second->size() ) >= (_maximumCacheSize - _maximumInMemorySize) ) {
+                // The entries of previous sessions that were never looked-up are evicted first
+                std::size_t evictedSize;
+                if ( evictPersistentIndexRecord(&evictedSize) ) {
+                    diskCacheSize -= std::min( diskCacheSize, (U64)evictedSize );
+                    continue;
+                }
+
+                std::pair<hash_type, EntryTypePtr> evictedFromDisk = shard.diskCache.evict();
                 //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
                 //we'll let the user of these entries purge the extra entries left in the cache later on
                 if (!evictedFromDisk.second) {
@@ -1864,22 +2255,16 @@ private:
 
                 entriesToBeDeleted.push_back(evictedFromDisk.second);
 
-                {
-                    QMutexLocker k(&_sizeLock);
-                    maximumInMemorySize = _maximumInMemorySize;
-                    maximumCacheSize = _maximumCacheSize;
-                }
-
                 //The entry is not yet deleted for real since it's done in a separate thread when this function
                 ///size() will return 0 at this point, we have to recompute it
                 std::size_t fsize = evictedFromDisk.second->getElementsCountFromParams();
                 diskCacheSize -= fsize;
             }
 
-            CacheIterator existingDiskCacheEntry = _diskCache(evicted.first);
+            CacheIterator existingDiskCacheEntry = shard.diskCache(evicted.first);
             /*if the entry doesn't exist on the disk cache,make a new list and insert it*/
-            if ( existingDiskCacheEntry == _diskCache.end() ) {
-                _diskCache.insert(evicted.first, evicted.second);
+            if ( existingDiskCacheEntry == shard.diskCache.end() ) {
+                shard.diskCache.insert(evicted.first, evicted.second);
             } else {   /*append to the existing list*/
                 getValueFromIterator(existingDiskCacheEntry).push_back(evicted.second);
             }
@@ -1888,11 +2273,192 @@ private:
         return true;
     } // tryEvictEntry
 
-    bool tryEvictDiskEntry(std::list<EntryTypePtr> & entriesToBeDeleted) const
+    /**
+     * @brief Compresses an entry evicted from the memory cache of the shard and inserts it in its compressed cache,
+     * evicting the LRU compressed entries of the shard to make room for it.
+     * Returns false if the entry does not compress well enough or if there is no room for it, in which case
+     * the caller should delete it.
+     **/
+    bool moveToCompressedCache(CacheShard& shard,
+                               const EntryTypePtr& entry,
+                               std::list<EntryTypePtr> & entriesToBeDeleted) const
+    {
+        assert( !shard.lock.tryLock() );
+        std::size_t maximumCompressedSize = _maximumCompressedSize;
+
+        ///This is expensive, although much less than writing the entry to disk
+        if ( !entry->compressMemory() ) {
+            return false;
+        }
+
+        // The compressed cache size already accounts for this entry. Only this shard is locked, so we can only
+        // evict entries from it: if other shards hold the whole compressed portion, the entry is deleted
+        U64 compressedCacheSize = _compressedCacheSize;
+        while (compressedCacheSize > maximumCompressedSize) {
+            std::pair<hash_type, EntryTypePtr> evictedCompressed = shard.compressedCache.evict();
+            if (!evictedCompressed.second) {
+                return false;
+            }
+
+            //The entry is not yet deleted for real since it's done in a separate thread
+            compressedCacheSize -= std::min( compressedCacheSize, (U64)evictedCompressed.second->getCompressedSize() );
+            entriesToBeDeleted.push_back(evictedCompressed.second);
+        }
+
+        CacheIterator existingCompressedEntry = shard.compressedCache( entry->getHashKey() );
+        if ( existingCompressedEntry == shard.compressedCache.end() ) {
+            shard.compressedCache.insert(entry->getHashKey(), entry);
+        } else {
+            getValueFromIterator(existingCompressedEntry).push_back(entry);
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Evicts the LRU compressed entry of the first shard (starting from _nextEvictedShard) that has an
+     * evictable entry. No shard lock must be held by the caller.
+     **/
+    bool tryEvictCompressedEntry(std::list<EntryTypePtr> & entriesToBeDeleted) const
+    {
+        unsigned int firstShard = _nextEvictedShard.fetch_add(1);
+
+        for (int i = 0; i < NATRON_CACHE_SHARDS_COUNT; ++i) {
+            CacheShard& shard = _shards[(firstShard + i) & (NATRON_CACHE_SHARDS_COUNT - 1)];
+            QMutexLocker locker(&shard.lock);
+            std::pair<hash_type, EntryTypePtr> evicted = shard.compressedCache.evict();
+            if (evicted.second) {
+                entriesToBeDeleted.push_back(evicted.second);
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    std::string toIndexFilePath(const std::string& filePath) const
+    {
+        if ( !_persistentIndexCachePath.empty() && (filePath.compare(0, _persistentIndexCachePath.size(), _persistentIndexCachePath) == 0) ) {
+            return filePath.substr( _persistentIndexCachePath.size() );
+        }
+
+        return filePath;
+    }
+
+    std::string fromIndexFilePath(const std::string& filePath) const
+    {
+        if ( !filePath.empty() && (filePath[0] != '/') && ( (filePath.size() < 2) || (filePath[1] != ':') ) ) {
+            return _persistentIndexCachePath + filePath;
+        }
+
+        return filePath;
+    }
+
+    /**
+     * @brief Adds to the persistent index an entry whose data was just written back to its file.
+     **/
+    void addToPersistentIndex(const EntryType& entry) const
+    {
+        if ( !_persistentIndex || !entry.isStoredOnDisk() ) {
+            return;
+        }
+        CacheIndexRecord record;
+        try {
+            _makeIndexRecord(entry, &record);
+        } catch (const std::exception & e) {
+            qDebug() << "Failed to serialize cache entry:" << e.what();
+
+            return;
+        }
+        // If the record is too large, the entry will not be restored by the next sessions
+        _persistentIndex->insert(record);
+    }
+
+    /**
+     * @brief Removes an entry of the persistent index and its file.
+     **/
+    void discardIndexRecord(const CacheIndexRecord& record) const
+    {
+        _persistentIndex->remove(record.hash, record.filePath);
+        std::remove( fromIndexFilePath(record.filePath).c_str() );
+        atomicSubtractClamped(_diskCacheSize, record.size);
+    }
+
+    /**
+     * @brief Removes an entry of a previous session which was never looked-up from the persistent index,
+     * along with its file. Returns false if there is none.
+     **/
+    bool evictPersistentIndexRecord(std::size_t* evictedSize) const
+    {
+        CacheIndexRecord record;
+
+        if ( !_persistentIndex || !_persistentIndex->evict(&record) ) {
+            return false;
+        }
+        std::remove( fromIndexFilePath(record.filePath).c_str() );
+        atomicSubtractClamped(_diskCacheSize, record.size);
+        *evictedSize = record.size;
+
+        return true;
+    }
+
+    /**
+     * @brief Looks-up the persistent index for entries matching the key that were stored on disk by a previous session,
+     * and inserts them in the disk portion of the shard before looking them up again.
+     **/
+    bool restoreFromPersistentIndex(CacheShard& shard,
+                                    const typename EntryType::key_type & key,
+                                    std::list<EntryTypePtr>* returnValue) const
+    {
+        assert( !shard.lock.tryLock() );
+        if (!_persistentIndex) {
+            return false;
+        }
+
+        std::list<CacheIndexRecord> records;
+        _persistentIndex->find(key.getHash(), &records);
+
+        bool restored = false;
+        for (std::list<CacheIndexRecord>::const_iterator it = records.begin(); it != records.end(); ++it) {
+            EntryTypePtr entry;
+            try {
+                entry = _makeEntryFromIndexRecord(*it);
+            } catch (const std::exception & e) {
+                qDebug() << "Failed to restore cache entry:" << e.what();
+                discardIndexRecord(*it);
+                continue;
+            }
+
+            // Other entries with the same hash are left in the index
+            if ( !( entry->getKey() == key ) || !_persistentIndex->acquire(it->hash, it->filePath) ) {
+                continue;
+            }
+
+            // The index records are accounted for in the disk portion until they are restored
+            atomicSubtractClamped(_diskCacheSize, it->size);
+            try {
+                ///This will not put the entry back into RAM, instead we just insert back the entry into the disk cache
+                entry->restoreMetadataFromFile(it->size, fromIndexFilePath(it->filePath), it->dataOffsetInFile);
+            } catch (const std::exception & e) {
+                qDebug() << "Failed to restore cache entry:" << e.what();
+                _diskCacheSize += it->size;
+                discardIndexRecord(*it);
+                continue;
+            }
+            sealEntry(shard, entry, false /*inMemory*/);
+            restored = true;
+        }
+
+        return restored && getInternal(shard, key, returnValue);
+    }
+
+    bool tryEvictDiskEntry(CacheShard& shard,
+                           std::list<EntryTypePtr> & entriesToBeDeleted) const
     {
 
-        assert( !_lock.tryLock() );
-        std::pair<hash_type, EntryTypePtr> evicted = _diskCache.evict();
+        assert( !shard.lock.tryLock() );
+        std::pair<hash_type, EntryTypePtr> evicted = shard.diskCache.evict();
         //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
         //we'll let the user of these entries purge the extra entries left in the cache later on
         if (!evicted.second) {
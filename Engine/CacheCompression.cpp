@@ -0,0 +1,482 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * (C) 2018-2023 The Natron developers
+ * (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "CacheCompression.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define NATRON_CACHE_COMPRESSION_BLOCK_SIZE (1 << 16)
+#define NATRON_CACHE_COMPRESSION_HEADER_SIZE 4
+#define NATRON_CACHE_COMPRESSION_RAW_BLOCK 0x80000000u
+
+// Matches are at least 4 bytes long, and the last bytes of a block are always literals so that matches
+// can be extended 8 bytes at a time
+#define LZ_MIN_MATCH 4
+#define LZ_LAST_LITERALS 8
+#define LZ_HASH_LOG2 13
+
+NATRON_NAMESPACE_ENTER
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+inline unsigned int
+read32(const unsigned char* p)
+{
+    unsigned int v;
+
+    std::memcpy( &v, p, sizeof(v) );
+
+    return v;
+}
+
+inline unsigned long long
+read64(const unsigned char* p)
+{
+    unsigned long long v;
+
+    std::memcpy( &v, p, sizeof(v) );
+
+    return v;
+}
+
+inline int
+countEqualBytes(unsigned long long diff)
+{
+    // diff is non zero. The first differing byte in memory is the lowest non-zero byte on little endian CPUs
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(diff) >> 3;
+#else
+    int n = 0;
+    while ( !(diff & 0xff) ) {
+        diff >>= 8;
+        ++n;
+    }
+
+    return n;
+#endif
+}
+
+inline unsigned int
+hashSequence(unsigned int sequence)
+{
+    return (sequence * 2654435761u) >> (32 - LZ_HASH_LOG2);
+}
+
+inline void
+writeLength(std::size_t length,
+            unsigned char** op)
+{
+    while (length >= 255) {
+        *(*op)++ = 255;
+        length -= 255;
+    }
+    *(*op)++ = (unsigned char)length;
+}
+
+/**
+ * @brief Writes a sequence of literals followed by a match, or only literals if matchLength is 0.
+ * Returns false if it does not fit before oend.
+ **/
+inline bool
+writeSequence(const unsigned char* literals,
+              std::size_t nLiterals,
+              std::size_t offset,
+              std::size_t matchLength,
+              unsigned char** op,
+              const unsigned char* oend)
+{
+    if ( *op + nLiterals + nLiterals / 255 + matchLength / 255 + 8 > oend ) {
+        return false;
+    }
+    unsigned char* token = (*op)++;
+    std::size_t matchCode = matchLength ? matchLength - LZ_MIN_MATCH : 0;
+    *token = (unsigned char)( ( (nLiterals < 15 ? nLiterals : 15) << 4 ) | (matchCode < 15 ? matchCode : 15) );
+    if (nLiterals >= 15) {
+        writeLength(nLiterals - 15, op);
+    }
+    std::memcpy(*op, literals, nLiterals);
+    *op += nLiterals;
+    if (matchLength) {
+        *(*op)++ = (unsigned char)(offset & 0xff);
+        *(*op)++ = (unsigned char)(offset >> 8);
+        if (matchCode >= 15) {
+            writeLength(matchCode - 15, op);
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Compresses a block of at most 64KiB. Returns the compressed size, or 0 if it is not smaller than dstCapacity.
+ **/
+std::size_t
+compressBlock(const unsigned char* src,
+              std::size_t size,
+              unsigned char* dst,
+              std::size_t dstCapacity)
+{
+    assert(size <= NATRON_CACHE_COMPRESSION_BLOCK_SIZE);
+    unsigned short table[1 << LZ_HASH_LOG2];
+    std::memset( table, 0, sizeof(table) );
+
+    unsigned char* op = dst;
+    const unsigned char* oend = dst + dstCapacity;
+    std::size_t anchor = 0;
+
+    if (size > LZ_LAST_LITERALS + LZ_MIN_MATCH) {
+        const std::size_t matchLimit = size - LZ_LAST_LITERALS;
+        std::size_t ip = 1;
+        while (ip < matchLimit) {
+            unsigned int sequence = read32(src + ip);
+            unsigned int h = hashSequence(sequence);
+            std::size_t ref = table[h];
+            table[h] = (unsigned short)ip;
+            if ( (ref >= ip) || ( read32(src + ref) != sequence ) ) {
+                // Skip faster through data that does not compress
+                ip += 1 + ( (ip - anchor) >> 6 );
+                continue;
+            }
+
+            // Extend the match backward then forward
+            while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1]) {
+                --ip;
+                --ref;
+            }
+            std::size_t length = LZ_MIN_MATCH;
+            while (ip + length + 8 <= matchLimit) {
+                unsigned long long diff = read64(src + ip + length) ^ read64(src + ref + length);
+                if (diff) {
+                    length += countEqualBytes(diff);
+                    break;
+                }
+                length += 8;
+            }
+            while (ip + length < matchLimit && src[ip + length] == src[ref + length]) {
+                ++length;
+            }
+
+            if ( !writeSequence(src + anchor, ip - anchor, ip - ref, length, &op, oend) ) {
+                return 0;
+            }
+            ip += length;
+            anchor = ip;
+            if (ip < matchLimit) {
+                table[hashSequence( read32(src + ip - 2) )] = (unsigned short)(ip - 2);
+            }
+        }
+    }
+    if ( !writeSequence(src + anchor, size - anchor, 0, 0, &op, oend) ) {
+        return 0;
+    }
+
+    return op - dst;
+}
+
+inline bool
+readLength(const unsigned char** ip,
+           const unsigned char* iend,
+           std::size_t* length)
+{
+    unsigned char b;
+
+    do {
+        if (*ip >= iend) {
+            return false;
+        }
+        b = *(*ip)++;
+        *length += b;
+    } while (b == 255);
+
+    return true;
+}
+
+bool
+uncompressBlock(const unsigned char* src,
+                std::size_t compressedSize,
+                unsigned char* dst,
+                std::size_t size)
+{
+    const unsigned char* ip = src;
+    const unsigned char* iend = src + compressedSize;
+    unsigned char* op = dst;
+    unsigned char* oend = dst + size;
+
+    while (ip < iend) {
+        unsigned int token = *ip++;
+        std::size_t nLiterals = token >> 4;
+        if ( (nLiterals == 15) && !readLength(&ip, iend, &nLiterals) ) {
+            return false;
+        }
+        if ( ( nLiterals > (std::size_t)(iend - ip) ) || ( nLiterals > (std::size_t)(oend - op) ) ) {
+            return false;
+        }
+        std::memcpy(op, ip, nLiterals);
+        ip += nLiterals;
+        op += nLiterals;
+        if (ip == iend) {
+            // The last sequence only has literals
+            break;
+        }
+
+        if (iend - ip < 2) {
+            return false;
+        }
+        std::size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        std::size_t length = token & 15;
+        if ( (length == 15) && !readLength(&ip, iend, &length) ) {
+            return false;
+        }
+        length += LZ_MIN_MATCH;
+        if ( (offset == 0) || ( offset > (std::size_t)(op - dst) ) || ( length > (std::size_t)(oend - op) ) ) {
+            return false;
+        }
+        const unsigned char* ref = op - offset;
+        if (offset == 1) {
+            std::memset(op, *ref, length);
+        } else if (offset >= 8) {
+            std::size_t i = 0;
+            for (; i + 8 <= length; i += 8) {
+                std::memcpy(op + i, ref + i, 8);
+            }
+            for (; i < length; ++i) {
+                op[i] = ref[i];
+            }
+        } else {
+            // The match overlaps the output: copy byte per byte to repeat the pattern
+            for (std::size_t i = 0; i < length; ++i) {
+                op[i] = ref[i];
+            }
+        }
+        op += length;
+    }
+
+    return op == oend;
+}
+
+/**
+ * @brief Groups the n-th bytes of the elements of src. Trailing bytes that do not make a full element are copied as is.
+ **/
+void
+shuffleBytes(const unsigned char* src,
+             std::size_t size,
+             int elementSize,
+             unsigned char* dst)
+{
+    std::size_t nElements = size / elementSize;
+
+    if (elementSize == 4) {
+        unsigned char* dst0 = dst;
+        unsigned char* dst1 = dst + nElements;
+        unsigned char* dst2 = dst + 2 * nElements;
+        unsigned char* dst3 = dst + 3 * nElements;
+        std::size_t i = 0;
+#ifdef __SSE2__
+        // 16 elements at a time: 4 rounds of interleaving transpose the 4x16 bytes
+        for (; i + 16 <= nElements; i += 16, src += 64) {
+            __m128i x0 = _mm_loadu_si128( (const __m128i*)src );
+            __m128i x1 = _mm_loadu_si128( (const __m128i*)(src + 16) );
+            __m128i x2 = _mm_loadu_si128( (const __m128i*)(src + 32) );
+            __m128i x3 = _mm_loadu_si128( (const __m128i*)(src + 48) );
+            for (int r = 0; r < 4; ++r) {
+                __m128i y0 = _mm_unpacklo_epi8(x0, x2);
+                __m128i y1 = _mm_unpackhi_epi8(x0, x2);
+                __m128i y2 = _mm_unpacklo_epi8(x1, x3);
+                __m128i y3 = _mm_unpackhi_epi8(x1, x3);
+                x0 = y0;
+                x1 = y1;
+                x2 = y2;
+                x3 = y3;
+            }
+            _mm_storeu_si128( (__m128i*)(dst0 + i), x0 );
+            _mm_storeu_si128( (__m128i*)(dst1 + i), x1 );
+            _mm_storeu_si128( (__m128i*)(dst2 + i), x2 );
+            _mm_storeu_si128( (__m128i*)(dst3 + i), x3 );
+        }
+#endif
+        for (; i < nElements; ++i, src += 4) {
+            dst0[i] = src[0];
+            dst1[i] = src[1];
+            dst2[i] = src[2];
+            dst3[i] = src[3];
+        }
+    } else {
+        for (std::size_t i = 0; i < nElements; ++i, src += elementSize) {
+            for (int k = 0; k < elementSize; ++k) {
+                dst[k * nElements + i] = src[k];
+            }
+        }
+    }
+    std::memcpy(dst + nElements * elementSize, src, size - nElements * elementSize);
+}
+
+void
+unshuffleBytes(const unsigned char* src,
+               std::size_t size,
+               int elementSize,
+               unsigned char* dst)
+{
+    std::size_t nElements = size / elementSize;
+
+    if (elementSize == 4) {
+        const unsigned char* src0 = src;
+        const unsigned char* src1 = src + nElements;
+        const unsigned char* src2 = src + 2 * nElements;
+        const unsigned char* src3 = src + 3 * nElements;
+        std::size_t i = 0;
+#ifdef __SSE2__
+        // The inverse of the transposition of shuffleBytes() takes 2 rounds
+        for (; i + 16 <= nElements; i += 16, dst += 64) {
+            __m128i x0 = _mm_loadu_si128( (const __m128i*)(src0 + i) );
+            __m128i x1 = _mm_loadu_si128( (const __m128i*)(src1 + i) );
+            __m128i x2 = _mm_loadu_si128( (const __m128i*)(src2 + i) );
+            __m128i x3 = _mm_loadu_si128( (const __m128i*)(src3 + i) );
+            for (int r = 0; r < 2; ++r) {
+                __m128i y0 = _mm_unpacklo_epi8(x0, x2);
+                __m128i y1 = _mm_unpackhi_epi8(x0, x2);
+                __m128i y2 = _mm_unpacklo_epi8(x1, x3);
+                __m128i y3 = _mm_unpackhi_epi8(x1, x3);
+                x0 = y0;
+                x1 = y1;
+                x2 = y2;
+                x3 = y3;
+            }
+            _mm_storeu_si128( (__m128i*)dst, x0 );
+            _mm_storeu_si128( (__m128i*)(dst + 16), x1 );
+            _mm_storeu_si128( (__m128i*)(dst + 32), x2 );
+            _mm_storeu_si128( (__m128i*)(dst + 48), x3 );
+        }
+#endif
+        for (; i < nElements; ++i, dst += 4) {
+            dst[0] = src0[i];
+            dst[1] = src1[i];
+            dst[2] = src2[i];
+            dst[3] = src3[i];
+        }
+    } else {
+        for (std::size_t i = 0; i < nElements; ++i, dst += elementSize) {
+            for (int k = 0; k < elementSize; ++k) {
+                dst[k] = src[k * nElements + i];
+            }
+        }
+    }
+    std::memcpy(dst, src + nElements * elementSize, size - nElements * elementSize);
+}
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+namespace CacheCompression {
+
+std::size_t
+getMaxCompressedSize(std::size_t size)
+{
+    std::size_t nBlocks = (size + NATRON_CACHE_COMPRESSION_BLOCK_SIZE - 1) / NATRON_CACHE_COMPRESSION_BLOCK_SIZE;
+
+    return size + nBlocks * NATRON_CACHE_COMPRESSION_HEADER_SIZE;
+}
+
+std::size_t
+compress(const unsigned char* src,
+         std::size_t size,
+         int elementSize,
+         unsigned char* dst)
+{
+    std::vector<unsigned char> shuffled(elementSize > 1 ? NATRON_CACHE_COMPRESSION_BLOCK_SIZE : 0);
+    unsigned char* op = dst;
+
+    for (std::size_t offset = 0; offset < size; offset += NATRON_CACHE_COMPRESSION_BLOCK_SIZE) {
+        std::size_t blockSize = std::min( (std::size_t)NATRON_CACHE_COMPRESSION_BLOCK_SIZE, size - offset );
+        const unsigned char* block = src + offset;
+        if (elementSize > 1) {
+            shuffleBytes(block, blockSize, elementSize, &shuffled[0]);
+            block = &shuffled[0];
+        }
+        unsigned char* payload = op + NATRON_CACHE_COMPRESSION_HEADER_SIZE;
+        unsigned int header = (unsigned int)compressBlock(block, blockSize, payload, blockSize);
+        if (header == 0) {
+            // Store the block as is: it is not shuffled either
+            std::memcpy(payload, src + offset, blockSize);
+            header = (unsigned int)blockSize | NATRON_CACHE_COMPRESSION_RAW_BLOCK;
+        }
+        std::memcpy(op, &header, NATRON_CACHE_COMPRESSION_HEADER_SIZE);
+        op = payload + (header & ~NATRON_CACHE_COMPRESSION_RAW_BLOCK);
+    }
+
+    return op - dst;
+}
+
+bool
+uncompress(const unsigned char* src,
+           std::size_t compressedSize,
+           int elementSize,
+           unsigned char* dst,
+           std::size_t size)
+{
+    std::vector<unsigned char> shuffled(elementSize > 1 ? NATRON_CACHE_COMPRESSION_BLOCK_SIZE : 0);
+    const unsigned char* ip = src;
+    const unsigned char* iend = src + compressedSize;
+
+    for (std::size_t offset = 0; offset < size; offset += NATRON_CACHE_COMPRESSION_BLOCK_SIZE) {
+        std::size_t blockSize = std::min( (std::size_t)NATRON_CACHE_COMPRESSION_BLOCK_SIZE, size - offset );
+        if (iend - ip < NATRON_CACHE_COMPRESSION_HEADER_SIZE) {
+            return false;
+        }
+        unsigned int header;
+        std::memcpy(&header, ip, NATRON_CACHE_COMPRESSION_HEADER_SIZE);
+        ip += NATRON_CACHE_COMPRESSION_HEADER_SIZE;
+        std::size_t payloadSize = header & ~NATRON_CACHE_COMPRESSION_RAW_BLOCK;
+        if ( payloadSize > (std::size_t)(iend - ip) ) {
+            return false;
+        }
+        if (header & NATRON_CACHE_COMPRESSION_RAW_BLOCK) {
+            if (payloadSize != blockSize) {
+                return false;
+            }
+            std::memcpy(dst + offset, ip, blockSize);
+        } else if (elementSize > 1) {
+            if ( !uncompressBlock(ip, payloadSize, &shuffled[0], blockSize) ) {
+                return false;
+            }
+            unshuffleBytes(&shuffled[0], blockSize, elementSize, dst + offset);
+        } else if ( !uncompressBlock(ip, payloadSize, dst + offset, blockSize) ) {
+            return false;
+        }
+        ip += payloadSize;
+    }
+
+    return ip == iend;
+}
+
+} // namespace CacheCompression
+
+NATRON_NAMESPACE_EXIT
@@ -0,0 +1,69 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * (C) 2018-2023 The Natron developers
+ * (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_CACHECOMPRESSION_H
+#define NATRON_ENGINE_CACHECOMPRESSION_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cstddef>
+
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief The lossless codec of the compressed tier of the cache.
+ *
+ * The data is cut in blocks of 64KiB which are compressed independently. The bytes of each block are first
+ * shuffled so that the n-th bytes of all elements (e.g the exponents of floats) are contiguous, then
+ * compressed with a byte-oriented LZ77 in the spirit of LZ4, which is fast on the long runs and repeated
+ * rows of mattes and constant areas. Blocks that do not compress are stored as is.
+ **/
+namespace CacheCompression
+{
+
+    /**
+     * @brief Returns the size of the buffer to pass to compress() to compress size bytes.
+     **/
+    std::size_t getMaxCompressedSize(std::size_t size);
+
+    /**
+     * @brief Compresses size bytes of src made of elements of elementSize bytes (1, 2 or 4) to dst, which
+     * must be getMaxCompressedSize(size) bytes long. Returns the number of bytes written to dst.
+     **/
+    std::size_t compress(const unsigned char* src, std::size_t size, int elementSize, unsigned char* dst);
+
+    /**
+     * @brief Uncompresses the compressedSize bytes of src, returned by compress() with the same elementSize,
+     * to the size bytes of dst. Returns false if src is corrupted.
+     **/
+    bool uncompress(const unsigned char* src, std::size_t compressedSize, int elementSize, unsigned char* dst, std::size_t size);
+
+}
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_CACHECOMPRESSION_H
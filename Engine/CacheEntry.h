@@ -40,6 +40,8 @@
 #include <sstream> // stringstream
 #include <algorithm>
 #include <utility>
+#include <atomic>
+#include <memory>
 
 #ifdef __NATRON_WIN32__
 #include <windows.h>
@@ -55,6 +57,7 @@
 #include <SequenceParsing.h> // for removePath
 #endif
 
+#include "Engine/CacheCompression.h"
 #include "Engine/Hash64.h"
 #include "Engine/CacheEntryHolder.h"
 #include "Engine/MemoryFile.h"
@@ -64,6 +67,9 @@
 #include "Global/GlobalDefines.h"
 #include "Global/StrUtils.h"
 
+//Entries evicted from the RAM are kept compressed only if they compress to less than this fraction of their size
+#define NATRON_CACHE_COMPRESSION_MAX_RATIO 0.75
+
 NATRON_NAMESPACE_ENTER
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -123,6 +129,21 @@ public:
         }
     }
 
+    /**
+     * @brief Gives back the memory past the first size elements, keeping the data.
+     **/
+    void shrink(U64 size)
+    {
+        if ( !data || (size == 0) || (size >= count) ) {
+            return;
+        }
+        T* shrunk = (T*)realloc( data, size * sizeof(T) );
+        if (shrunk) {
+            data = shrunk;
+            count = size;
+        }
+    }
+
     void clear()
     {
         count = 0;
@@ -142,13 +163,62 @@ public:
 };
 
 // This is a cache file with a fixed size that is a multiple of the tileByteSize.
-// A bitset represents the allocated tiles in the file.
-// A value of true means that a tile is used by a cache entry.
+// A bitmap of 64-bit words represents the allocated tiles in the file.
+// A set bit means that a tile is used by a cache entry.
+// Tiles are allocated and freed with atomic operations, so that threads allocating tiles do not need to lock.
 class TileCacheFile
 {
 public:
     MemoryFilePtr file;
-    std::vector<bool> usedTiles;
+
+    TileCacheFile();
+
+    /**
+     * @brief Resets the bitmap so that the file can hold nTiles tiles, all of them free.
+     * Must be called before the file is shared with other threads.
+     **/
+    void initTiles(std::size_t nTiles);
+
+    std::size_t getTilesCount() const
+    {
+        return _nTiles;
+    }
+
+    std::size_t getUsedTilesCount() const
+    {
+        return _nUsedTiles;
+    }
+
+    bool isFull() const
+    {
+        return _nUsedTiles >= _nTiles;
+    }
+
+    /**
+     * @brief Marks the first free tile as used and returns its index, or -1 if the file is full.
+     **/
+    int allocTile();
+
+    /**
+     * @brief Marks the given tile as used. Returns false if it was already used.
+     **/
+    bool markTileUsed(std::size_t index);
+
+    void freeTile(std::size_t index);
+
+    bool isTileUsed(std::size_t index) const;
+
+private:
+
+    std::size_t _nTiles;
+    std::size_t _nWords;
+    std::unique_ptr<std::atomic<U64>[]> _usedTiles;
+
+    // Number of tiles marked as used
+    std::atomic<std::size_t> _nUsedTiles;
+
+    // Index of a word likely to contain a free tile, where the search for a free tile starts
+    std::atomic<std::size_t> _firstFreeWordHint;
 };
 
 typedef TileCacheFilePtr TileCacheFilePtr;
@@ -182,6 +252,12 @@ public:
      **/
     virtual void notifyEntrySizeChanged(size_t oldSize, size_t newSize) const = 0;
 
+    /**
+     * @brief To be called by a CacheEntry whenever the size of its compressed buffer changes, i.e when it is
+     * compressed, uncompressed or destroyed while compressed.
+     **/
+    virtual void notifyEntryCompressedSizeChanged(size_t oldSize, size_t newSize) const = 0;
+
     /**
      * @brief To be called by a CacheEntry on allocation.
      **/
@@ -202,6 +278,11 @@ public:
      **/
     virtual void backingFileClosed() const = 0;
 
+    /**
+     * @brief To be called when the backing file of an entry has been removed, i.e when the entry is removed from the disk.
+     **/
+    virtual void notifyEntryBackingFileRemoved(U64 hash, const std::string& filePath) const = 0;
+
     /**
      * @brief To be called whenever an entry is deallocated from memory and put back on disk or whenever
      * it is reallocated in the RAM.
@@ -393,6 +474,9 @@ public:
         , _entry(0)
         , _cacheFile()
         , _cacheFileDataOffset(0)
+        , _compressedBuffer()
+        , _uncompressedCount(0)
+        , _compressionElementSize(1)
         , _storageMode(eStorageModeRAM)
     {
     }
@@ -572,12 +656,68 @@ public:
         _storageMode = eStorageModeDisk;
     }
 
+    /**
+     * @brief Compresses the RAM buffer, made of elements of elementSize bytes, and frees it.
+     * Returns the compressed size, or 0 if the buffer does not compress well enough, in which case it is left untouched.
+     * This function throws a std::bad_alloc if the allocation of the compressed buffer fails.
+     **/
+    std::size_t compressRAM(int elementSize)
+    {
+        assert(_storageMode == eStorageModeRAM && !_compressedBuffer);
+        if ( !_buffer || (_buffer->size() == 0) ) {
+            return 0;
+        }
+        std::size_t size = _buffer->size() * sizeof(DataType);
+        std::unique_ptr<RamBuffer<unsigned char> > compressed( new RamBuffer<unsigned char>() );
+
+        // The pages past the compressed size are never touched, and are given back by shrink()
+        compressed->resize( CacheCompression::getMaxCompressedSize(size) );
+        std::size_t compressedSize = CacheCompression::compress( (const unsigned char*)_buffer->getData(), size, elementSize, compressed->getData() );
+        if (compressedSize > size * NATRON_CACHE_COMPRESSION_MAX_RATIO) {
+            return 0;
+        }
+        compressed->shrink(compressedSize);
+        _compressedBuffer.swap(compressed);
+        _uncompressedCount = _buffer->size();
+        _compressionElementSize = elementSize;
+        _buffer->clear();
+
+        return compressedSize;
+    }
+
+    /**
+     * @brief Restores the RAM buffer compressed by compressRAM(). The buffer stays compressed if this throws.
+     **/
+    void uncompressRAM()
+    {
+        assert(_storageMode == eStorageModeRAM && _compressedBuffer);
+        if (!_buffer) {
+            _buffer.reset( new RamBuffer<DataType>() );
+        }
+        _buffer->resize(_uncompressedCount);
+        if ( !CacheCompression::uncompress( _compressedBuffer->getData(), _compressedBuffer->size(), _compressionElementSize,
+                                            (unsigned char*)_buffer->getData(), _uncompressedCount * sizeof(DataType) ) ) {
+            _buffer->clear();
+            throw std::runtime_error("Corrupted compressed cache entry");
+        }
+        _compressedBuffer.reset();
+    }
+
+    /**
+     * @brief Returns the size in bytes of the compressed buffer, or 0 if the buffer is not compressed.
+     **/
+    std::size_t getCompressedSize() const
+    {
+        return _compressedBuffer ? _compressedBuffer->size() : 0;
+    }
+
     void deallocate()
     {
         if (_storageMode == eStorageModeRAM) {
             if (_buffer) {
                 _buffer->clear();
             }
+            _compressedBuffer.reset();
         } else if (_storageMode == eStorageModeDisk) {
             if (_backingFile) {
                 bool flushOk = _backingFile->flush(MemoryFile::eFlushTypeAsync, 0, 0);
@@ -606,6 +746,21 @@ public:
         }
     }
 
+    void prefetch() const
+    {
+        if (_storageMode != eStorageModeDisk) {
+            return;
+        }
+        if (_backingFile) {
+            _backingFile->prefetch(0, 0);
+        } else if (_cacheFile && _entry) {
+            _cacheFile->file->prefetch(_cacheFile->file->data() + _cacheFileDataOffset, _entry->getCacheTileSizeBytes());
+        } else if ( !_path.empty() ) {
+            // The file is not mapped: it will be when the entry is looked-up
+            MemoryFile::prefetchFile(_path, 0, 0);
+        }
+    }
+
     bool removeAnyBackingFile() const
     {
         if (_storageMode == eStorageModeDisk && !_cacheFile) {
@@ -733,6 +888,11 @@ private:
     TileCacheFilePtr _cacheFile;
     std::size_t _cacheFileDataOffset;
 
+    // Set while the RAM buffer is compressed by compressRAM()
+    std::unique_ptr<RamBuffer<unsigned char> > _compressedBuffer;
+    U64 _uncompressedCount;
+    int _compressionElementSize;
+
     // Used when we store images as OpenGL textures
     std::unique_ptr<Texture> _glTexture;
     StorageModeEnum _storageMode;
@@ -956,6 +1116,70 @@ public:
         }
     }
 
+    /**
+     * @brief Called by the cache to move an entry evicted from the RAM to its compressed portion.
+     * Returns false if the entry is not allocated in RAM or does not compress well enough, in which case it is left untouched.
+     **/
+    bool compressMemory()
+    {
+        std::size_t sz;
+        std::size_t compressedSize;
+        {
+            QWriteLocker k(&_entryLock);
+            if ( (_data.getStorageMode() != eStorageModeRAM) || !_data.isAllocated() ) {
+                return false;
+            }
+            sz = _data.size();
+            try {
+                compressedSize = _data.compressRAM( _params->getStorageInfo().dataTypeSize );
+            } catch (const std::bad_alloc &) {
+                return false;
+            }
+            if (compressedSize == 0) {
+                return false;
+            }
+        }
+        if (_cache) {
+            _cache->notifyEntrySizeChanged(sz, 0);
+            _cache->notifyEntryCompressedSizeChanged(0, compressedSize);
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Restores an entry compressed by compressMemory(), when it is found in the compressed portion of the cache.
+     * WARNING: This function throws a std::bad_alloc if the allocation fails.
+     **/
+    void uncompressMemory()
+    {
+        std::size_t compressedSize;
+        std::size_t sz;
+        {
+            QWriteLocker k(&_entryLock);
+            compressedSize = _data.getCompressedSize();
+            if (compressedSize == 0) {
+                return;
+            }
+            _data.uncompressRAM();
+            sz = _data.size();
+        }
+        if (_cache) {
+            _cache->notifyEntryCompressedSizeChanged(compressedSize, 0);
+            _cache->notifyEntrySizeChanged(0, sz);
+        }
+    }
+
+    /**
+     * @brief Returns the size in bytes of the compressed buffer, or 0 if the entry is not compressed.
+     **/
+    std::size_t getCompressedSize() const
+    {
+        QReadLocker k(&_entryLock);
+
+        return _data.getCompressedSize();
+    }
+
     /**
      * @brief Can be called several times without harm
      **/
@@ -963,14 +1187,19 @@ public:
     {
         std::size_t sz = size();
         bool dataAllocated;
+        std::size_t compressedSize;
         double time = getTime();
         {
             QWriteLocker k(&_entryLock);
             dataAllocated = _data.isAllocated();
+            compressedSize = _data.getCompressedSize();
             _data.deallocate();
         }
 
         if (_cache) {
+            if (compressedSize) {
+                _cache->notifyEntryCompressedSizeChanged(compressedSize, 0);
+            }
             const CacheEntryStorageInfo& info = _params->getStorageInfo();
             if (info.mode == eStorageModeDisk) {
                 if (dataAllocated) {
@@ -981,7 +1210,8 @@ public:
                     }
                 }
             } else if (info.mode == eStorageModeRAM) {
-                if (dataAllocated) {
+                // A compressed entry may still have some memory accounted in RAM (e.g the bitmap of an Image)
+                if (dataAllocated || compressedSize) {
                     _cache->notifyEntryDestroyed(time, sz, eStorageModeRAM);
                 }
             } else if (info.mode == eStorageModeGLTex) {
@@ -1043,6 +1273,16 @@ public:
         return _data.syncBackingFile();
     }
 
+    /**
+     * @brief Asks the system to read ahead the data of the entry if it is stored on disk.
+     **/
+    void prefetch() const
+    {
+        QReadLocker k(&_entryLock);
+
+        _data.prefetch();
+    }
+
     /**
      * @brief An entry stored on disk is effectively destroyed when its backing file is removed.
      **/
@@ -1063,6 +1303,7 @@ public:
         if (hasRemovedFile) {
             _cache->backingFileClosed();
         }
+        _cache->notifyEntryBackingFileRemoved( getHashKey(), getFilePath() );
         if (isAlloc) {
             _cache->notifyEntryDestroyed(getTime(), getElementsCountFromParams(), eStorageModeRAM);
         } else {
@@ -0,0 +1,614 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * (C) 2018-2023 The Natron developers
+ * (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "CacheIndexFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <stdexcept>
+#include <utility>
+
+#include <QtCore/QLockFile>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+
+#include "Engine/MemoryFile.h"
+
+// "NTCINDEX" in little endian
+#define NATRON_CACHE_INDEX_MAGIC 0x5845444e49435442ULL
+#define NATRON_CACHE_INDEX_FORMAT_VERSION 1
+
+// Each slot holds a record header followed by the file path and the serialized key and parameters
+#define NATRON_CACHE_INDEX_SLOT_SIZE 1024
+#define NATRON_CACHE_INDEX_MIN_SLOTS_COUNT 4096
+
+#define NATRON_CACHE_INDEX_SLOT_EMPTY 0
+#define NATRON_CACHE_INDEX_SLOT_LIVE 1
+#define NATRON_CACHE_INDEX_SLOT_REMOVED 2
+
+NATRON_NAMESPACE_ENTER
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+struct CacheIndexFileHeader
+{
+    U64 magic;
+    U32 formatVersion;
+    U32 cacheVersion;
+    U64 slotsCount; // a power of 2
+    U64 usedSlotsCount; // slots that are not empty, removed records are only reclaimed when the table is rebuilt
+    U64 recordsCount;
+    U64 totalSize;
+    U64 reserved[2];
+};
+
+struct CacheIndexSlotHeader
+{
+    U64 hash;
+    U32 state; // written last when a record is inserted, and alone when it is removed
+    U32 checksum; // of the hash and of everything following the checksum
+    U64 size;
+    U64 dataOffsetInFile;
+    U16 filePathLength;
+    U16 dataLength;
+    U32 reserved;
+};
+
+#define NATRON_CACHE_INDEX_MAX_PAYLOAD_SIZE (NATRON_CACHE_INDEX_SLOT_SIZE - sizeof(CacheIndexSlotHeader))
+
+std::size_t
+getTableFileSize(U64 slotsCount)
+{
+    return sizeof(CacheIndexFileHeader) + slotsCount * NATRON_CACHE_INDEX_SLOT_SIZE;
+}
+
+// FNV-1a
+U32
+computeChecksum(const unsigned char* data,
+                std::size_t size,
+                U32 checksum)
+{
+    for (std::size_t i = 0; i < size; ++i) {
+        checksum = (checksum ^ data[i]) * 16777619u;
+    }
+
+    return checksum;
+}
+
+U32
+computeSlotChecksum(const char* slot)
+{
+    const CacheIndexSlotHeader* header = (const CacheIndexSlotHeader*)slot;
+    U32 checksum = computeChecksum( (const unsigned char*)&header->hash, sizeof(header->hash), 2166136261u );
+    std::size_t payloadSize = header->filePathLength + header->dataLength;
+
+    if (payloadSize > NATRON_CACHE_INDEX_MAX_PAYLOAD_SIZE) {
+        return ~header->checksum;
+    }
+
+    return computeChecksum( (const unsigned char*)&header->size, sizeof(CacheIndexSlotHeader) - offsetof(CacheIndexSlotHeader, size) + payloadSize, checksum );
+}
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+struct CacheIndexFilePrivate
+{
+    std::string filePath;
+    unsigned int cacheVersion;
+    // Held as long as the index is open, so that another process does not map the same file
+    std::unique_ptr<QLockFile> lockFile;
+    std::unique_ptr<MemoryFile> file;
+
+    // Records loaded in the cache by this session
+    std::set<std::pair<U64, std::string> > pinnedRecords;
+
+    // The slot from which evict() looks for a record, so that successive evictions do not scan the same slots
+    U64 evictCursor;
+    mutable QMutex lock; // protects all fields
+
+    CacheIndexFilePrivate(const std::string& filePath,
+                          unsigned int cacheVersion)
+        : filePath(filePath)
+        , cacheVersion(cacheVersion)
+        , lockFile()
+        , file()
+        , pinnedRecords()
+        , evictCursor(0)
+        , lock()
+    {
+    }
+
+    CacheIndexFileHeader* header() const
+    {
+        return (CacheIndexFileHeader*)file->data();
+    }
+
+    char* slot(U64 index) const
+    {
+        return file->data() + sizeof(CacheIndexFileHeader) + index * NATRON_CACHE_INDEX_SLOT_SIZE;
+    }
+
+    static CacheIndexSlotHeader* slotHeader(char* slot)
+    {
+        return (CacheIndexSlotHeader*)slot;
+    }
+
+    static bool isRecordValid(const char* slot)
+    {
+        const CacheIndexSlotHeader* header = (const CacheIndexSlotHeader*)slot;
+
+        return header->state == NATRON_CACHE_INDEX_SLOT_LIVE && header->checksum == computeSlotChecksum(slot);
+    }
+
+    static void readRecord(const char* slot, CacheIndexRecord* record)
+    {
+        const CacheIndexSlotHeader* header = (const CacheIndexSlotHeader*)slot;
+        const char* payload = slot + sizeof(CacheIndexSlotHeader);
+
+        record->hash = header->hash;
+        record->size = header->size;
+        record->dataOffsetInFile = header->dataOffsetInFile;
+        record->filePath.assign(payload, header->filePathLength);
+        record->data.assign(payload + header->filePathLength, header->dataLength);
+    }
+
+    static bool recordFilePathEquals(const char* slot, const std::string& filePath)
+    {
+        const CacheIndexSlotHeader* header = (const CacheIndexSlotHeader*)slot;
+
+        return header->filePathLength == filePath.size() &&
+               std::memcmp(slot + sizeof(CacheIndexSlotHeader), filePath.c_str(), filePath.size()) == 0;
+    }
+
+    static bool recordEquals(const char* slot, const CacheIndexRecord& record)
+    {
+        const CacheIndexSlotHeader* header = (const CacheIndexSlotHeader*)slot;
+
+        return isRecordValid(slot) && header->size == record.size && header->dataOffsetInFile == record.dataOffsetInFile &&
+               recordFilePathEquals(slot, record.filePath) && header->dataLength == record.data.size() &&
+               std::memcmp(slot + sizeof(CacheIndexSlotHeader) + header->filePathLength, record.data.c_str(), record.data.size()) == 0;
+    }
+
+    void openFile(MemoryFile::FileOpenModeEnum mode);
+
+    void createTable(MemoryFile* file, U64 slotsCount) const;
+
+    bool isHeaderValid() const;
+
+    bool isTableValid() const;
+
+    /**
+     * @brief Writes the record in a free slot of the probe sequence of its hash and commits it.
+     * Returns false if there is no free slot.
+     **/
+    bool writeRecord(const CacheIndexRecord& record);
+
+    void removeRecordAt(U64 index);
+
+    /**
+     * @brief Rebuilds the table in a new file with enough slots to hold recordsCount records, without the
+     * removed records, and replaces the index file with it.
+     **/
+    void rebuild(U64 recordsCount);
+};
+
+void
+CacheIndexFilePrivate::openFile(MemoryFile::FileOpenModeEnum mode)
+{
+    file.reset( new MemoryFile(filePath, mode) );
+    if ( isTableValid() ) {
+        return;
+    }
+
+    if ( isHeaderValid() && ( file->size() < getTableFileSize(header()->slotsCount) ) ) {
+        // Truncated by a crash or a full disk: the missing slots are read as empty, and a checksum
+        // fails for the records that were cut. Only the intact records are copied to the new table.
+        try {
+            U64 recordsCount = std::min( header()->recordsCount, header()->slotsCount );
+            file->resize( getTableFileSize(header()->slotsCount) );
+            rebuild(recordsCount);
+
+            return;
+        } catch (const std::exception &) {
+        }
+    }
+
+    // Unexisting, corrupted or from another version: start from an empty index
+    file.reset( new MemoryFile(filePath, MemoryFile::eFileOpenModeEnumIfExistsTruncateElseCreate) );
+    createTable(file.get(), NATRON_CACHE_INDEX_MIN_SLOTS_COUNT);
+}
+
+void
+CacheIndexFilePrivate::createTable(MemoryFile* tableFile,
+                                   U64 slotsCount) const
+{
+    // The file is sparse: the slots take disk space only once written to
+    tableFile->resize( getTableFileSize(slotsCount) );
+    CacheIndexFileHeader* tableHeader = (CacheIndexFileHeader*)tableFile->data();
+    std::memset( tableHeader, 0, sizeof(CacheIndexFileHeader) );
+    tableHeader->magic = NATRON_CACHE_INDEX_MAGIC;
+    tableHeader->formatVersion = NATRON_CACHE_INDEX_FORMAT_VERSION;
+    tableHeader->cacheVersion = cacheVersion;
+    tableHeader->slotsCount = slotsCount;
+}
+
+bool
+CacheIndexFilePrivate::isHeaderValid() const
+{
+    if ( !file || !file->data() || (file->size() < sizeof(CacheIndexFileHeader) ) ) {
+        return false;
+    }
+    const CacheIndexFileHeader* tableHeader = header();
+    if ( (tableHeader->magic != NATRON_CACHE_INDEX_MAGIC) ||
+         ( tableHeader->formatVersion != NATRON_CACHE_INDEX_FORMAT_VERSION) ||
+         ( tableHeader->cacheVersion != cacheVersion) ) {
+        return false;
+    }
+    U64 slotsCount = tableHeader->slotsCount;
+
+    return slotsCount >= NATRON_CACHE_INDEX_MIN_SLOTS_COUNT && (slotsCount & (slotsCount - 1)) == 0;
+}
+
+bool
+CacheIndexFilePrivate::isTableValid() const
+{
+    return isHeaderValid() && file->size() == getTableFileSize(header()->slotsCount);
+}
+
+bool
+CacheIndexFilePrivate::writeRecord(const CacheIndexRecord& record)
+{
+    CacheIndexFileHeader* tableHeader = header();
+    U64 mask = tableHeader->slotsCount - 1;
+    char* freeSlot = 0;
+
+    for (U64 i = 0, index = record.hash & mask; i <= mask; ++i, index = (index + 1) & mask) {
+        if (slotHeader( slot(index) )->state != NATRON_CACHE_INDEX_SLOT_LIVE) {
+            freeSlot = slot(index);
+            break;
+        }
+    }
+    if (!freeSlot) {
+        return false;
+    }
+
+    // The state of the slot is left as is while the record is written: a crash leaves it empty or removed
+    CacheIndexSlotHeader* recordHeader = slotHeader(freeSlot);
+    bool wasEmpty = recordHeader->state == NATRON_CACHE_INDEX_SLOT_EMPTY;
+    recordHeader->hash = record.hash;
+    recordHeader->size = record.size;
+    recordHeader->dataOffsetInFile = record.dataOffsetInFile;
+    recordHeader->filePathLength = (U16)record.filePath.size();
+    recordHeader->dataLength = (U16)record.data.size();
+    recordHeader->reserved = 0;
+    char* payload = freeSlot + sizeof(CacheIndexSlotHeader);
+    std::memcpy( payload, record.filePath.c_str(), record.filePath.size() );
+    std::memcpy( payload + record.filePath.size(), record.data.c_str(), record.data.size() );
+    recordHeader->checksum = computeSlotChecksum(freeSlot);
+    std::atomic_thread_fence(std::memory_order_release);
+    recordHeader->state = NATRON_CACHE_INDEX_SLOT_LIVE;
+
+    if (wasEmpty) {
+        ++tableHeader->usedSlotsCount;
+    }
+    ++tableHeader->recordsCount;
+    tableHeader->totalSize += record.size;
+
+    return true;
+}
+
+void
+CacheIndexFilePrivate::removeRecordAt(U64 index)
+{
+    CacheIndexFileHeader* tableHeader = header();
+    CacheIndexSlotHeader* recordHeader = slotHeader( slot(index) );
+
+    assert(recordHeader->state == NATRON_CACHE_INDEX_SLOT_LIVE);
+    recordHeader->state = NATRON_CACHE_INDEX_SLOT_REMOVED;
+    if (tableHeader->recordsCount > 0) {
+        --tableHeader->recordsCount;
+    }
+    tableHeader->totalSize -= std::min( (U64)recordHeader->size, tableHeader->totalSize );
+}
+
+void
+CacheIndexFilePrivate::rebuild(U64 recordsCount)
+{
+    U64 slotsCount = NATRON_CACHE_INDEX_MIN_SLOTS_COUNT;
+
+    // Keep the load factor under 3/8 after the rebuild so that it does not happen again soon
+    while (recordsCount * 8 >= slotsCount * 3) {
+        slotsCount *= 2;
+    }
+
+    std::string tmpFilePath = filePath + ".tmp";
+    {
+        std::unique_ptr<MemoryFile> newFile( new MemoryFile(tmpFilePath, MemoryFile::eFileOpenModeEnumIfExistsTruncateElseCreate) );
+        createTable(newFile.get(), slotsCount);
+
+        std::unique_ptr<MemoryFile> oldFile;
+        oldFile.swap(file);
+        file.swap(newFile);
+        const char* oldSlots = oldFile->data() + sizeof(CacheIndexFileHeader);
+        U64 oldSlotsCount = ( (const CacheIndexFileHeader*)oldFile->data() )->slotsCount;
+        CacheIndexRecord record;
+        for (U64 i = 0; i < oldSlotsCount; ++i) {
+            const char* oldSlot = oldSlots + i * NATRON_CACHE_INDEX_SLOT_SIZE;
+            if ( isRecordValid(oldSlot) ) {
+                readRecord(oldSlot, &record);
+                writeRecord(record);
+            }
+        }
+        // The new file must be complete on disk before it replaces the old one
+        file->flush(MemoryFile::eFlushTypeSync, 0, 0);
+    }
+
+    // Files cannot be replaced while they are mapped on Windows
+    file.reset();
+    if (std::rename( tmpFilePath.c_str(), filePath.c_str() ) != 0) {
+        std::remove( filePath.c_str() );
+        if (std::rename( tmpFilePath.c_str(), filePath.c_str() ) != 0) {
+            throw std::runtime_error("Failed to replace the cache index " + filePath);
+        }
+    }
+    file.reset( new MemoryFile(filePath, MemoryFile::eFileOpenModeEnumIfExistsKeepElseFail) );
+    evictCursor = 0;
+}
+
+CacheIndexFile::CacheIndexFile(const std::string& filePath,
+                               unsigned int cacheVersion)
+    : _imp( new CacheIndexFilePrivate(filePath, cacheVersion) )
+{
+    // The records are modified in place in the mapped file and the table may be replaced by rebuild(),
+    // which is only safe within one process. The lock is not considered stale while its process is alive.
+    _imp->lockFile.reset( new QLockFile( QString::fromUtf8( (filePath + ".lock").c_str() ) ) );
+    _imp->lockFile->setStaleLockTime(0);
+    if ( !_imp->lockFile->tryLock(0) ) {
+        throw std::runtime_error("The cache index " + filePath + " is used by another process");
+    }
+    _imp->openFile(MemoryFile::eFileOpenModeEnumIfExistsKeepElseCreate);
+}
+
+CacheIndexFile::~CacheIndexFile()
+{
+}
+
+bool
+CacheIndexFile::insert(const CacheIndexRecord& record)
+{
+    if ( (record.filePath.size() + record.data.size() > NATRON_CACHE_INDEX_MAX_PAYLOAD_SIZE) ) {
+        return false;
+    }
+
+    QMutexLocker k(&_imp->lock);
+    if (!_imp->file) {
+        return false;
+    }
+
+    const CacheIndexFileHeader* tableHeader = _imp->header();
+    if ( (tableHeader->usedSlotsCount + 1) * 4 > tableHeader->slotsCount * 3 ) {
+        try {
+            _imp->rebuild(tableHeader->recordsCount + 1);
+        } catch (const std::exception &) {
+            // Keep on working with the old index, which was left untouched
+            _imp->file.reset();
+            try {
+                _imp->openFile(MemoryFile::eFileOpenModeEnumIfExistsKeepElseCreate);
+            } catch (const std::exception &) {
+            }
+
+            return false;
+        }
+    }
+
+    // Look for a previous record of the same entry: it is removed only once the new record is committed
+    std::list<U64> previousRecords;
+    U64 mask = _imp->header()->slotsCount - 1;
+    for (U64 i = 0, index = record.hash & mask; i <= mask; ++i, index = (index + 1) & mask) {
+        char* slot = _imp->slot(index);
+        U32 state = CacheIndexFilePrivate::slotHeader(slot)->state;
+        if (state == NATRON_CACHE_INDEX_SLOT_EMPTY) {
+            break;
+        }
+        if ( (state == NATRON_CACHE_INDEX_SLOT_LIVE) && (CacheIndexFilePrivate::slotHeader(slot)->hash == record.hash) &&
+             CacheIndexFilePrivate::recordFilePathEquals(slot, record.filePath) ) {
+            previousRecords.push_back(index);
+        }
+    }
+
+    // Entries are indexed each time they are written back to disk, most of the time with the same record
+    if ( (previousRecords.size() == 1) && _imp->recordEquals(_imp->slot( previousRecords.front() ), record) ) {
+        _imp->pinnedRecords.insert( std::make_pair(record.hash, record.filePath) );
+
+        return true;
+    }
+
+    if ( !_imp->writeRecord(record) ) {
+        return false;
+    }
+    for (std::list<U64>::iterator it = previousRecords.begin(); it != previousRecords.end(); ++it) {
+        _imp->removeRecordAt(*it);
+    }
+    _imp->pinnedRecords.insert( std::make_pair(record.hash, record.filePath) );
+
+    return true;
+} // insert
+
+void
+CacheIndexFile::find(U64 hash,
+                     std::list<CacheIndexRecord>* records) const
+{
+    QMutexLocker k(&_imp->lock);
+
+    if (!_imp->file) {
+        return;
+    }
+    U64 mask = _imp->header()->slotsCount - 1;
+    for (U64 i = 0, index = hash & mask; i <= mask; ++i, index = (index + 1) & mask) {
+        const char* slot = _imp->slot(index);
+        const CacheIndexSlotHeader* recordHeader = (const CacheIndexSlotHeader*)slot;
+        if (recordHeader->state == NATRON_CACHE_INDEX_SLOT_EMPTY) {
+            break;
+        }
+        if ( (recordHeader->hash != hash) || !CacheIndexFilePrivate::isRecordValid(slot) ) {
+            continue;
+        }
+        CacheIndexRecord record;
+        CacheIndexFilePrivate::readRecord(slot, &record);
+        if ( _imp->pinnedRecords.find( std::make_pair(hash, record.filePath) ) == _imp->pinnedRecords.end() ) {
+            records->push_back(record);
+        }
+    }
+}
+
+bool
+CacheIndexFile::acquire(U64 hash,
+                        const std::string& filePath)
+{
+    QMutexLocker k(&_imp->lock);
+
+    if (!_imp->file) {
+        return false;
+    }
+    U64 mask = _imp->header()->slotsCount - 1;
+    for (U64 i = 0, index = hash & mask; i <= mask; ++i, index = (index + 1) & mask) {
+        char* slot = _imp->slot(index);
+        U32 state = CacheIndexFilePrivate::slotHeader(slot)->state;
+        if (state == NATRON_CACHE_INDEX_SLOT_EMPTY) {
+            return false;
+        }
+        if ( (state == NATRON_CACHE_INDEX_SLOT_LIVE) && (CacheIndexFilePrivate::slotHeader(slot)->hash == hash) &&
+             CacheIndexFilePrivate::recordFilePathEquals(slot, filePath) ) {
+            return _imp->pinnedRecords.insert( std::make_pair(hash, filePath) ).second;
+        }
+    }
+
+    return false;
+}
+
+void
+CacheIndexFile::remove(U64 hash,
+                       const std::string& filePath)
+{
+    QMutexLocker k(&_imp->lock);
+
+    _imp->pinnedRecords.erase( std::make_pair(hash, filePath) );
+    if (!_imp->file) {
+        return;
+    }
+    U64 mask = _imp->header()->slotsCount - 1;
+    for (U64 i = 0, index = hash & mask; i <= mask; ++i, index = (index + 1) & mask) {
+        char* slot = _imp->slot(index);
+        U32 state = CacheIndexFilePrivate::slotHeader(slot)->state;
+        if (state == NATRON_CACHE_INDEX_SLOT_EMPTY) {
+            break;
+        }
+        if ( (state == NATRON_CACHE_INDEX_SLOT_LIVE) && (CacheIndexFilePrivate::slotHeader(slot)->hash == hash) &&
+             CacheIndexFilePrivate::recordFilePathEquals(slot, filePath) ) {
+            _imp->removeRecordAt(index);
+        }
+    }
+}
+
+bool
+CacheIndexFile::evict(CacheIndexRecord* record)
+{
+    QMutexLocker k(&_imp->lock);
+
+    if ( !_imp->file || (_imp->header()->recordsCount == 0) ) {
+        return false;
+    }
+    U64 slotsCount = _imp->header()->slotsCount;
+    for (U64 i = 0; i < slotsCount; ++i) {
+        U64 index = (_imp->evictCursor + i) & (slotsCount - 1);
+        char* slot = _imp->slot(index);
+        if (CacheIndexFilePrivate::slotHeader(slot)->state != NATRON_CACHE_INDEX_SLOT_LIVE) {
+            continue;
+        }
+        if ( !CacheIndexFilePrivate::isRecordValid(slot) ) {
+            // Torn by a crash
+            _imp->removeRecordAt(index);
+            continue;
+        }
+        CacheIndexFilePrivate::readRecord(slot, record);
+        if ( _imp->pinnedRecords.find( std::make_pair(record->hash, record->filePath) ) != _imp->pinnedRecords.end() ) {
+            continue;
+        }
+        _imp->removeRecordAt(index);
+        _imp->evictCursor = index + 1;
+
+        return true;
+    }
+
+    return false;
+}
+
+void
+CacheIndexFile::clear()
+{
+    QMutexLocker k(&_imp->lock);
+
+    _imp->pinnedRecords.clear();
+    _imp->evictCursor = 0;
+    try {
+        _imp->file.reset();
+        _imp->openFile(MemoryFile::eFileOpenModeEnumIfExistsTruncateElseCreate);
+    } catch (const std::exception &) {
+        _imp->file.reset();
+    }
+}
+
+std::size_t
+CacheIndexFile::getRecordsCount() const
+{
+    QMutexLocker k(&_imp->lock);
+
+    return _imp->file ? _imp->header()->recordsCount : 0;
+}
+
+std::size_t
+CacheIndexFile::getTotalSize() const
+{
+    QMutexLocker k(&_imp->lock);
+
+    return _imp->file ? _imp->header()->totalSize : 0;
+}
+
+void
+CacheIndexFile::flush()
+{
+    QMutexLocker k(&_imp->lock);
+
+    if (_imp->file) {
+        _imp->file->flush(MemoryFile::eFlushTypeAsync, 0, 0);
+    }
+}
+
+NATRON_NAMESPACE_EXIT
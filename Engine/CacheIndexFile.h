@@ -0,0 +1,152 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * (C) 2018-2023 The Natron developers
+ * (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_CACHEINDEXFILE_H
+#define NATRON_ENGINE_CACHEINDEXFILE_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <string>
+
+#include "Global/GlobalDefines.h"
+
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief An entry of the persistent index of a cache: the location of the data of an entry stored on disk,
+ * along with its serialized key and parameters.
+ **/
+struct CacheIndexRecord
+{
+    U64 hash;
+    std::size_t size; //< the data size in bytes
+    std::size_t dataOffsetInFile;
+    std::string filePath; //< relative to the cache location, several entries can have the same hash
+    std::string data; //< the serialized key and parameters of the entry
+
+    CacheIndexRecord()
+        : hash(0)
+        , size(0)
+        , dataOffsetInFile(0)
+        , filePath()
+        , data()
+    {
+    }
+};
+
+struct CacheIndexFilePrivate;
+
+/**
+ * @brief The persistent index of the entries of a cache stored on disk.
+ *
+ * This is a hash table of fixed-size records keyed by the hash of the entries, memory-mapped from a file:
+ * opening it only maps the file, whatever the number of entries, and records are read only when the cache
+ * looks up their hash. A record is written to an unused slot before it is committed by a single store to
+ * its state, and each record is checksummed, so that a record torn by a crash is ignored. If the file was
+ * truncated, the table is rebuilt with the records left intact.
+ * When the table is too full, it is rebuilt in a new file which replaces the old one.
+ *
+ * The file is modified in place without any synchronization between processes, hence an index is opened by
+ * one process at a time: a lock file next to it is held while it is open.
+ *
+ * Records that were inserted, or returned by acquire(), during this session are pinned: they belong to an
+ * entry loaded in the cache and are never returned by evict(). This class is MT-safe.
+ **/
+class CacheIndexFile
+{
+public:
+
+    /**
+     * @brief Opens the index at the given path, or creates it if it does not exist or was written
+     * for another version of the cache.
+     * This function throws a std::runtime_error if the file could not be opened, or if it is opened by another process
+     * (e.g. another Natron instance sharing the same cache location), in which case the cache should be used without index.
+     **/
+    CacheIndexFile(const std::string& filePath,
+                   unsigned int cacheVersion);
+
+    ~CacheIndexFile();
+
+    /**
+     * @brief Adds a record to the index and pins it. If a record with the same hash and file path already exists,
+     * it is replaced. Returns false if the record is too large to fit in a slot.
+     **/
+    bool insert(const CacheIndexRecord& record);
+
+    /**
+     * @brief Appends to records the records of the given hash that are not pinned.
+     **/
+    void find(U64 hash, std::list<CacheIndexRecord>* records) const;
+
+    /**
+     * @brief Pins the record of the given hash and file path, returned by find(), once its entry is loaded
+     * in the cache. Returns false if it was removed in the meantime.
+     **/
+    bool acquire(U64 hash, const std::string& filePath);
+
+    /**
+     * @brief Removes the record of the given hash and file path, if any.
+     **/
+    void remove(U64 hash, const std::string& filePath);
+
+    /**
+     * @brief Removes a record which is not pinned and returns it, so that the caller removes its file.
+     * Returns false if all records are pinned.
+     **/
+    bool evict(CacheIndexRecord* record);
+
+    /**
+     * @brief Removes all records.
+     **/
+    void clear();
+
+    /**
+     * @brief Returns the number of records.
+     **/
+    std::size_t getRecordsCount() const;
+
+    /**
+     * @brief Returns the sum of the data size of all records.
+     **/
+    std::size_t getTotalSize() const;
+
+    /**
+     * @brief Writes the modified records to the file.
+     **/
+    void flush();
+
+private:
+
+    std::unique_ptr<CacheIndexFilePrivate> _imp;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_CACHEINDEXFILE_H
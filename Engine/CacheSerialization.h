@@ -30,6 +30,7 @@
 
 #include <list>
 #include <set>
+#include <sstream>
 #include <cstddef>
 #include <stdexcept>
 
@@ -77,10 +78,11 @@ void
 Cache<EntryType>::save(CacheTOC* tableOfContents)
 {
     clearInMemoryPortion(false);
-    {
-        QMutexLocker l(&_lock);     // must be locked
+    for (int i = 0; i < NATRON_CACHE_SHARDS_COUNT; ++i) {
+        CacheShard& shard = _shards[i];
+        QMutexLocker l(&shard.lock);     // must be locked
 
-        for (ConstCacheIterator it = _diskCache.begin(); it != _diskCache.end(); ++it) {
+        for (ConstCacheIterator it = shard.diskCache.begin(); it != shard.diskCache.end(); ++it) {
             const std::list<EntryTypePtr> & listOfValues  = getValueFromIterator(it);
             for (typename std::list<EntryTypePtr>::const_iterator it2 = listOfValues.begin(); it2 != listOfValues.end(); ++it2) {
                 if ( (*it2)->isStoredOnDisk() ) {
@@ -155,8 +157,9 @@ Cache<EntryType>::restore(const CacheTOC & tableOfContents)
         const std::string& filePath = value->getFilePath();
         usedFilePaths.insert(QString::fromUtf8(filePath.c_str()));
         {
-            QMutexLocker locker(&_lock);
-            sealEntry(EntryTypePtr(value), false /*inMemory*/);
+            CacheShard& shard = getShard( value->getHashKey() );
+            QMutexLocker locker(&shard.lock);
+            sealEntry(shard, EntryTypePtr(value), false /*inMemory*/);
         }
     }
 
@@ -198,6 +201,55 @@ Cache<EntryType>::restore(const CacheTOC & tableOfContents)
     }
 }
 
+template<typename EntryType>
+void
+Cache<EntryType>::openPersistentIndex()
+{
+    if (_isTiled) {
+        return;
+    }
+
+    QString cachePath = getCachePath();
+    StrUtils::ensureLastPathSeparator(cachePath);
+    _persistentIndexCachePath = cachePath.toStdString();
+
+    _makeIndexRecord = [this](const EntryType& entry, CacheIndexRecord* record) {
+        record->hash = entry.getHashKey();
+        ///size() returns 0 once the entry is written back to disk, we have to recompute it
+        record->size = entry.getElementsCountFromParams();
+        record->dataOffsetInFile = entry.getOffsetInFile();
+        record->filePath = toIndexFilePath( entry.getFilePath() );
+
+        std::ostringstream ss;
+        {
+            boost::archive::binary_oarchive oArchive(ss, boost::archive::no_header);
+            const ParamsTypePtr params = entry.getParams();
+            oArchive << entry.getKey();
+            oArchive << params;
+        }
+        record->data = ss.str();
+    };
+
+    _makeEntryFromIndexRecord = [this](const CacheIndexRecord& record) {
+        std::istringstream ss(record.data);
+        boost::archive::binary_iarchive iArchive(ss, boost::archive::no_header);
+        typename EntryType::key_type key;
+        ParamsTypePtr params;
+        iArchive >> key;
+        iArchive >> params;
+        if ( !params || (key.getHash() != record.hash) ) {
+            throw std::runtime_error("Cache index record does not match its hash key");
+        }
+
+        return std::make_shared<EntryType>(key, params, this);
+    };
+
+    _persistentIndex = std::make_shared<CacheIndexFile>(getPersistentIndexFilePath(), _version);
+
+    // The entries of the index are restored when they are looked-up, but they already occupy the disk
+    _diskCacheSize += _persistentIndex->getTotalSize();
+}
+
 template<typename EntryType>
 struct Cache<EntryType>::SerializedEntry
 {
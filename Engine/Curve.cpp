@@ -27,6 +27,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <limits>
 #include <stdexcept>
 
@@ -214,63 +215,63 @@ Curve::Curve(KnobI *owner,
     if (!found) {
         KnobDouble* k = dynamic_cast<KnobDouble*>(owner);
         if (k) {
-            _imp->type = CurvePrivate::eCurveTypeDouble;
+            _imp->type = eCurveTypeDouble;
             found = true;
         }
     }
     if (!found) {
         KnobColor* k = dynamic_cast<KnobColor*>(owner);
         if (k) {
-            _imp->type = CurvePrivate::eCurveTypeDouble;
+            _imp->type = eCurveTypeDouble;
             found = true;
         }
     }
     if (!found) {
         KnobInt* k = dynamic_cast<KnobInt*>(owner);
         if (k) {
-            _imp->type = CurvePrivate::eCurveTypeInt;
+            _imp->type = eCurveTypeInt;
             found = true;
         }
     }
     if (!found) {
         KnobChoice* k = dynamic_cast<KnobChoice*>(owner);
         if (k) {
-            _imp->type = CurvePrivate::eCurveTypeIntConstantInterp;
+            _imp->type = eCurveTypeIntConstantInterp;
             found = true;
         }
     }
     if (!found) {
         KnobString* k = dynamic_cast<KnobString*>(owner);
         if (k) {
-            _imp->type = CurvePrivate::eCurveTypeString;
+            _imp->type = eCurveTypeString;
             found = true;
         }
     }
     if (!found) {
         KnobFile* k = dynamic_cast<KnobFile*>(owner);
         if (k) {
-            _imp->type = CurvePrivate::eCurveTypeString;
+            _imp->type = eCurveTypeString;
             found = true;
         }
     }
     if (!found) {
         KnobOutputFile* k = dynamic_cast<KnobOutputFile*>(owner);
         if (k) {
-            _imp->type = CurvePrivate::eCurveTypeString;
+            _imp->type = eCurveTypeString;
             found = true;
         }
     }
     if (!found) {
         KnobPath* k = dynamic_cast<KnobPath*>(owner);
         if (k) {
-            _imp->type = CurvePrivate::eCurveTypeString;
+            _imp->type = eCurveTypeString;
             found = true;
         }
     }
     if (!found) {
         KnobBool* k = dynamic_cast<KnobBool*>(owner);
         if (k) {
-            _imp->type = CurvePrivate::eCurveTypeBool;
+            _imp->type = eCurveTypeBool;
             found = true;
         }
     }
@@ -283,6 +284,7 @@ Curve::Curve(KnobI *owner,
         }
     }
     assert(found);
+    publishSnapshot();
 }
 
 Curve::Curve(const Curve & other)
@@ -301,6 +303,7 @@ Curve::setPeriodic(bool periodic)
     QMutexLocker k(&_imp->_lock);
     _imp->isPeriodic = periodic;
     _imp->keyFrames.clear();
+    publishSnapshot();
 }
 
 bool
@@ -321,6 +324,7 @@ Curve::clearKeyFrames()
     QMutexLocker l(&_imp->_lock);
 
     _imp->keyFrames.clear();
+    publishSnapshot();
 }
 
 bool
@@ -423,9 +427,9 @@ Curve::addKeyFrame(KeyFrame key)
     QMutexLocker l(&_imp->_lock);
 
     // the default interpolation for bool, string, chaice, int is constant
-    if ( (_imp->type == CurvePrivate::eCurveTypeBool) || (_imp->type == CurvePrivate::eCurveTypeString) ||
-         ( _imp->type == CurvePrivate::eCurveTypeInt) ||
-         ( _imp->type == CurvePrivate::eCurveTypeIntConstantInterp) ) {
+    if ( (_imp->type == eCurveTypeBool) || (_imp->type == eCurveTypeString) ||
+         ( _imp->type == eCurveTypeInt) ||
+         ( _imp->type == eCurveTypeIntConstantInterp) ) {
         key.setInterpolation(eKeyframeTypeConstant);
     }
 
@@ -783,12 +787,12 @@ Curve::getKeyFrameWithTime(double time,
 /// compute interpolation parameters from keyframes and an iterator
 /// to the next keyframe (the first with time > t)
 static void
-interParams(const KeyFrameSet &keyFrames,
+interParams(const KeyFrameVector &keyFrames,
             bool isPeriodic,
             double xMin,
             double xMax,
             double *t,
-            KeyFrameSet::const_iterator itup,
+            KeyFrameVector::const_iterator itup,
             double *tcur,
             double *vcur,
             double *vcurDerivRight,
@@ -814,7 +818,7 @@ interParams(const KeyFrameSet &keyFrames,
             }
             assert(*t >= minKeyFrameX && *t <= minKeyFrameX + period);
         }
-        itup = keyFrames.upper_bound(KeyFrame(*t, 0.));
+        itup = std::upper_bound( keyFrames.begin(), keyFrames.end(), KeyFrame(*t, 0.), KeyFrame_compare_time() );
     }
     if ( itup == keyFrames.begin() ) {
         // We are in the case where all keys have a greater time
@@ -824,7 +828,7 @@ interParams(const KeyFrameSet &keyFrames,
             *vnext = itup->getValue();
             *vnextDerivLeft = itup->getLeftDerivative();
             *interpNext = itup->getInterpolation();
-            KeyFrameSet::const_reverse_iterator last =  keyFrames.rbegin();
+            KeyFrameVector::const_reverse_iterator last =  keyFrames.rbegin();
             *tcur = last->getTime() - period;
             *vcur = last->getValue();
             *vcurDerivRight = last->getRightDerivative();
@@ -845,8 +849,8 @@ interParams(const KeyFrameSet &keyFrames,
         // We are in the case where no key has a greater time
         // If periodic, we are in-between the last keyframe and xMax
         if (isPeriodic) {
-            KeyFrameSet::const_iterator next = keyFrames.begin();
-            KeyFrameSet::const_reverse_iterator prev = keyFrames.rbegin();
+            KeyFrameVector::const_iterator next = keyFrames.begin();
+            KeyFrameVector::const_reverse_iterator prev = keyFrames.rbegin();
             *tcur = prev->getTime();
             *vcur = prev->getValue();
             *vcurDerivRight = prev->getRightDerivative();
@@ -857,7 +861,7 @@ interParams(const KeyFrameSet &keyFrames,
             *interpNext = next->getInterpolation();
         } else {
 
-            KeyFrameSet::const_reverse_iterator itlast = keyFrames.rbegin();
+            KeyFrameVector::const_reverse_iterator itlast = keyFrames.rbegin();
             *tcur = itlast->getTime();
             *vcur = itlast->getValue();
             *vcurDerivRight = itlast->getRightDerivative();
@@ -871,7 +875,7 @@ interParams(const KeyFrameSet &keyFrames,
     } else {
         // between two keyframes
         // get the last keyframe with time <= t
-        KeyFrameSet::const_iterator itcur = itup;
+        KeyFrameVector::const_iterator itcur = itup;
         --itcur;
         assert(itcur->getTime() <= *t);
         *tcur = itcur->getTime();
@@ -889,9 +893,11 @@ double
 Curve::getValueAt(double t,
                   bool doClamp) const
 {
-    QMutexLocker l(&_imp->_lock);
+    // Without the curve lock: the snapshot remains valid even if the curve is modified meanwhile
+    CurveSnapshotPtr snapshot = getSnapshot();
+    const KeyFrameVector& keyFrames = snapshot->keyFrames;
 
-    if ( _imp->keyFrames.empty() ) {
+    if ( keyFrames.empty() ) {
         //throw std::runtime_error("Curve has no control points!");
 
         // A curve with no control points is considered to be 0
@@ -899,34 +905,32 @@ Curve::getValueAt(double t,
         return 0.;
 
         // There is no special case for a curve with one (1) keyframe: the result is a linear curve before and after the keyframe.
-    //} else if (_imp->keyFrames.size() == 1) {
-    //    return _imp->keyFrames.begin()->getValue();
+    //} else if (keyFrames.size() == 1) {
+    //    return keyFrames.begin()->getValue();
     }
 
     double v;
 #ifdef NATRON_CURVE_USE_CACHE
-    std::map<double, double>::const_iterator foundCached = _imp->resultCache.find(t);
-    if ( foundCached != _imp->resultCache.end() ) {
-        v = foundCached->second;
-    } else
+    if ( !snapshot->resultCache.get(t, &v) )
 #endif
     {
         // even when there is only one keyframe, there may be tangents!
-        //if (_imp->keyFrames.size() == 1) {
+        //if (keyFrames.size() == 1) {
         //    //if there's only 1 keyframe, don't bother interpolating
-        //    return (*_imp->keyFrames.begin()).getValue();
+        //    return (*keyFrames.begin()).getValue();
         //}
         double tcur, tnext;
         double vcurDerivRight, vnextDerivLeft, vcur, vnext;
         KeyframeTypeEnum interp, interpNext;
-        KeyFrame k(t, 0.);
+#ifdef NATRON_CURVE_USE_CACHE
+        const double tKey = t; // interParams may wrap t on periodic curves
+#endif
         // find the first keyframe with time greater than t
-        KeyFrameSet::const_iterator itup;
-        itup = _imp->keyFrames.upper_bound(k);
-        interParams(_imp->keyFrames,
-                    _imp->isPeriodic,
-                    _imp->xMin,
-                    _imp->xMax,
+        KeyFrameVector::const_iterator itup = std::upper_bound( keyFrames.begin(), keyFrames.end(), KeyFrame(t, 0.), KeyFrame_compare_time() );
+        interParams(keyFrames,
+                    snapshot->isPeriodic,
+                    snapshot->xMin,
+                    snapshot->xMax,
                     &t,
                     itup,
                     &tcur,
@@ -946,23 +950,23 @@ Curve::getValueAt(double t,
                                        interp,
                                        interpNext);
 #ifdef NATRON_CURVE_USE_CACHE
-        _imp->resultCache[t] = v;
+        snapshot->resultCache.insert(tKey, v);
 #endif
     }
 
-    if ( doClamp && mustClamp() ) {
-        v = clampValueToCurveYRange(v);
+    if ( doClamp && mustClamp(*snapshot) ) {
+        v = clampValueToCurveYRange(*snapshot, v);
     }
 
-    switch (_imp->type) {
-    case CurvePrivate::eCurveTypeString:
-    case CurvePrivate::eCurveTypeInt:
+    switch (snapshot->type) {
+    case eCurveTypeString:
+    case eCurveTypeInt:
 
         return std::floor(v + 0.5);
-    case CurvePrivate::eCurveTypeDouble:
+    case eCurveTypeDouble:
 
         return v;
-    case CurvePrivate::eCurveTypeBool:
+    case eCurveTypeBool:
 
         return v >= 0.5 ? 1. : 0.;
     default:
@@ -971,32 +975,139 @@ Curve::getValueAt(double t,
     }
 } // getValueAt
 
+void
+Curve::getValuesAt(const double* times,
+                   double* values,
+                   std::size_t n,
+                   bool doClamp) const
+{
+    CurveSnapshotPtr snapshot = getSnapshot();
+    const KeyFrameVector& keyFrames = snapshot->keyFrames;
+
+    if ( keyFrames.empty() ) {
+        // A curve with no control points is considered to be 0 (@see getValueAt())
+        std::fill(values, values + n, 0.);
+
+        return;
+    }
+
+    std::size_t i = 0;
+    while (i < n) {
+        double t = times[i];
+        double tcur, tnext;
+        double vcurDerivRight, vnextDerivLeft, vcur, vnext;
+        KeyframeTypeEnum interp, interpNext;
+        // find the first keyframe with time greater than t
+        KeyFrameVector::const_iterator itup = std::upper_bound( keyFrames.begin(), keyFrames.end(), KeyFrame(t, 0.), KeyFrame_compare_time() );
+        interParams(keyFrames,
+                    snapshot->isPeriodic,
+                    snapshot->xMin,
+                    snapshot->xMax,
+                    &t,
+                    itup,
+                    &tcur,
+                    &vcur,
+                    &vcurDerivRight,
+                    &interp,
+                    &tnext,
+                    &vnext,
+                    &vnextDerivLeft,
+                    &interpNext);
+
+        // all the following times which fall in the same segment share the same cubic
+        std::size_t end = i + 1;
+        if (snapshot->isPeriodic) {
+            // t was brought back in the period, evaluate the wrapped time alone
+            values[i] = Interpolation::interpolate(tcur, vcur,
+                                                   vcurDerivRight,
+                                                   vnextDerivLeft,
+                                                   tnext, vnext,
+                                                   t,
+                                                   interp,
+                                                   interpNext);
+        } else {
+            const double segmentMin = ( itup == keyFrames.begin() ) ? -std::numeric_limits<double>::infinity() : (itup - 1)->getTime();
+            const double segmentMax = ( itup == keyFrames.end() ) ? std::numeric_limits<double>::infinity() : itup->getTime();
+            while ( end < n && segmentMin <= times[end] && times[end] < segmentMax ) {
+                ++end;
+            }
+            Interpolation::interpolateMany(tcur, vcur,
+                                           vcurDerivRight,
+                                           vnextDerivLeft,
+                                           tnext, vnext,
+                                           times + i,
+                                           values + i,
+                                           end - i,
+                                           interp,
+                                           interpNext);
+        }
+        i = end;
+    }
+
+    if ( doClamp && mustClamp(*snapshot) ) {
+        const Curve::YRange minmax = getCurveYRange_internal(*snapshot);
+        for (std::size_t j = 0; j < n; ++j) {
+            values[j] = std::min( std::max(values[j], minmax.min), minmax.max );
+        }
+    }
+
+    switch (snapshot->type) {
+    case eCurveTypeString:
+    case eCurveTypeInt:
+        for (std::size_t j = 0; j < n; ++j) {
+            values[j] = std::floor(values[j] + 0.5);
+        }
+        break;
+    case eCurveTypeBool:
+        for (std::size_t j = 0; j < n; ++j) {
+            values[j] = values[j] >= 0.5 ? 1. : 0.;
+        }
+        break;
+    case eCurveTypeDouble:
+    default:
+        break;
+    }
+} // getValuesAt
+
+void
+Curve::getValuesAtUniformTimes(double t0,
+                               double step,
+                               double* values,
+                               std::size_t n,
+                               bool clamp) const
+{
+    // the times are evaluated in place
+    for (std::size_t i = 0; i < n; ++i) {
+        values[i] = t0 + i * step;
+    }
+    getValuesAt(values, values, n, clamp);
+}
+
 double
 Curve::getDerivativeAt(double t) const
 {
-    QMutexLocker l(&_imp->_lock);
+    CurveSnapshotPtr snapshot = getSnapshot();
+    const KeyFrameVector& keyFrames = snapshot->keyFrames;
 
-    if ( _imp->keyFrames.empty() ) {
+    if ( keyFrames.empty() ) {
         throw std::runtime_error("Curve has no control points!");
     }
-    assert(_imp->type == CurvePrivate::eCurveTypeDouble); // only real-valued curves can be derived
+    assert(snapshot->type == eCurveTypeDouble); // only real-valued curves can be derived
 
     // even when there is only one keyframe, there may be tangents!
-    //if (_imp->keyFrames.size() == 1) {
+    //if (keyFrames.size() == 1) {
     //    //if there's only 1 keyframe, don't bother interpolating
-    //    return (*_imp->keyFrames.begin()).getValue();
+    //    return (*keyFrames.begin()).getValue();
     //}
     double tcur, tnext;
     double vcurDerivRight, vnextDerivLeft, vcur, vnext;
     KeyframeTypeEnum interp, interpNext;
-    KeyFrame k(t, 0.);
     // find the first keyframe with time greater than t
-    KeyFrameSet::const_iterator itup;
-    itup = _imp->keyFrames.upper_bound(k);
-    interParams(_imp->keyFrames,
-                _imp->isPeriodic,
-                _imp->xMin,
-                _imp->xMax,
+    KeyFrameVector::const_iterator itup = std::upper_bound( keyFrames.begin(), keyFrames.end(), KeyFrame(t, 0.), KeyFrame_compare_time() );
+    interParams(keyFrames,
+                snapshot->isPeriodic,
+                snapshot->xMin,
+                snapshot->xMax,
                 &t,
                 itup,
                 &tcur,
@@ -1010,8 +1121,8 @@ Curve::getDerivativeAt(double t) const
 
     double d;
 
-    if ( mustClamp() ) {
-        Curve::YRange minmax = getCurveYRange();
+    if ( mustClamp(*snapshot) ) {
+        Curve::YRange minmax = getCurveYRange_internal(*snapshot);
         d = Interpolation::derive_clamp(tcur, vcur,
                                         vcurDerivRight,
                                         vnextDerivLeft,
@@ -1037,7 +1148,8 @@ double
 Curve::getIntegrateFromTo(double t1,
                           double t2) const
 {
-    QMutexLocker l(&_imp->_lock);
+    CurveSnapshotPtr snapshot = getSnapshot();
+    const KeyFrameVector& keyFrames = snapshot->keyFrames;
     bool opposite = false;
 
     // the following assumes that t2 > t1. If it's not the case, swap them and return the opposite.
@@ -1046,27 +1158,25 @@ Curve::getIntegrateFromTo(double t1,
         std::swap(t1, t2);
     }
 
-    if ( _imp->keyFrames.empty() ) {
+    if ( keyFrames.empty() ) {
         throw std::runtime_error("Curve has no control points!");
     }
-    assert(_imp->type == CurvePrivate::eCurveTypeDouble); // only real-valued curves can be derived
+    assert(snapshot->type == eCurveTypeDouble); // only real-valued curves can be derived
 
     // even when there is only one keyframe, there may be tangents!
-    //if (_imp->keyFrames.size() == 1) {
+    //if (keyFrames.size() == 1) {
     //    //if there's only 1 keyframe, don't bother interpolating
-    //    return (*_imp->keyFrames.begin()).getValue();
+    //    return (*keyFrames.begin()).getValue();
     //}
     double tcur, tnext;
     double vcurDerivRight, vnextDerivLeft, vcur, vnext;
     KeyframeTypeEnum interp, interpNext;
-    KeyFrame k(t1, 0.);
     // find the first keyframe with time strictly greater than t1
-    KeyFrameSet::const_iterator itup;
-    itup = _imp->keyFrames.upper_bound(k);
-    interParams(_imp->keyFrames,
-                _imp->isPeriodic,
-                _imp->xMin,
-                _imp->xMax,
+    KeyFrameVector::const_iterator itup = std::upper_bound( keyFrames.begin(), keyFrames.end(), KeyFrame(t1, 0.), KeyFrame_compare_time() );
+    interParams(keyFrames,
+                snapshot->isPeriodic,
+                snapshot->xMin,
+                snapshot->xMax,
                 &t1,
                 itup,
                 &tcur,
@@ -1079,12 +1189,13 @@ Curve::getIntegrateFromTo(double t1,
                 &interpNext);
 
     double sum = 0.;
+    const bool clamp = mustClamp(*snapshot);
+    const Curve::YRange minmax = clamp ? getCurveYRange_internal(*snapshot) : Curve::YRange(0., 0.);
 
     // while there are still keyframes after the current time, add to the total sum and advance
-    while (itup != _imp->keyFrames.end() && itup->getTime() < t2) {
+    while (itup != keyFrames.end() && itup->getTime() < t2) {
         // add integral from t1 to itup->getTime() to sum
-        if ( mustClamp() ) {
-            Curve::YRange minmax = getCurveYRange();
+        if (clamp) {
             sum += Interpolation::integrate_clamp(tcur, vcur,
                                                   vcurDerivRight,
                                                   vnextDerivLeft,
@@ -1105,10 +1216,10 @@ Curve::getIntegrateFromTo(double t1,
         // advance
         t1 = itup->getTime();
         ++itup;
-        interParams(_imp->keyFrames,
-                    _imp->isPeriodic,
-                    _imp->xMin,
-                    _imp->xMax,
+        interParams(keyFrames,
+                    snapshot->isPeriodic,
+                    snapshot->xMin,
+                    snapshot->xMax,
                     &t1,
                     itup,
                     &tcur,
@@ -1121,10 +1232,9 @@ Curve::getIntegrateFromTo(double t1,
                     &interpNext);
     }
 
-    assert( itup == _imp->keyFrames.end() || t2 <= itup->getTime() );
+    assert( itup == keyFrames.end() || t2 <= itup->getTime() );
     // add integral from t1 to t2 to sum
-    if ( mustClamp() ) {
-        Curve::YRange minmax = getCurveYRange();
+    if (clamp) {
         sum += Interpolation::integrate_clamp(tcur, vcur,
                                               vcurDerivRight,
                                               vnextDerivLeft,
@@ -1149,13 +1259,13 @@ Curve::getIntegrateFromTo(double t1,
 Curve::YRange
 Curve::getCurveDisplayYRange() const
 {
-    QMutexLocker l(&_imp->_lock);
+    CurveSnapshotPtr snapshot = getSnapshot();
 
-    if ( !mustClamp() ) {
+    if ( !mustClamp(*snapshot) ) {
         return YRange( -std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity() );
     }
     if (!_imp->owner) {
-        return YRange(_imp->yMin, _imp->yMax);
+        return YRange(snapshot->yMin, snapshot->yMax);
     }
 
     KnobDoubleBase* isDouble = dynamic_cast<KnobDoubleBase*>(_imp->owner);
@@ -1183,13 +1293,18 @@ Curve::getCurveDisplayYRange() const
 
 Curve::YRange Curve::getCurveYRange() const
 {
-    QMutexLocker l(&_imp->_lock);
+    return getCurveYRange_internal( *getSnapshot() );
+}
 
-    if ( !mustClamp() ) {
+Curve::YRange
+Curve::getCurveYRange_internal(const CurveSnapshot& snapshot) const
+{
+    // PRIVATE - should not lock: the owner is set at construction and the knob min/max have their own lock
+    if ( !mustClamp(snapshot) ) {
         return YRange( -std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity() );
     }
     if (!_imp->owner) {
-        return YRange(_imp->yMin, _imp->yMax);
+        return YRange(snapshot.yMin, snapshot.yMax);
     }
 
     KnobDoubleBase* isDouble = dynamic_cast<KnobDoubleBase*>(_imp->owner);
@@ -1217,11 +1332,12 @@ Curve::YRange Curve::getCurveYRange() const
 }
 
 double
-Curve::clampValueToCurveYRange(double v) const
+Curve::clampValueToCurveYRange(const CurveSnapshot& snapshot,
+                               double v) const
 {
     // PRIVATE - should not lock
     ////clamp to min/max if the owner of the curve is a Double or Int knob.
-    YRange minmax = getCurveYRange();
+    YRange minmax = getCurveYRange_internal(snapshot);
 
     if (v > minmax.max) {
         return minmax.max;
@@ -1249,6 +1365,7 @@ Curve::setXRange(double a,
 
     _imp->xMin = a;
     _imp->xMax = b;
+    publishSnapshot();
 }
 
 std::pair<double, double> Curve::getXRange() const
@@ -1356,9 +1473,9 @@ Curve::moveKeyFrameValueAndTimeInternal(const double time, const double dt, cons
 
         double newX = it->getTime() + dt;
         double newY = it->getValue() + dv;
-        if (_imp->type == CurvePrivate::eCurveTypeInt) {
+        if (_imp->type == eCurveTypeInt) {
             newY = std::floor(newY + 0.5);
-        } else if (_imp->type == CurvePrivate::eCurveTypeBool) {
+        } else if (_imp->type == eCurveTypeBool) {
             newY = newY < 0.5 ? 0 : 1;
         }
 
@@ -1489,8 +1606,8 @@ Curve::setKeyFrameInterpolationInternal(KeyframeTypeEnum interp, int index, int*
         assert( it != _imp->keyFrames.end() );
 
         ///if the curve is a string_curve or bool_curve the interpolation is bound to be constant.
-        if ( ( (_imp->type == CurvePrivate::eCurveTypeString) || (_imp->type == CurvePrivate::eCurveTypeBool) ||
-              ( _imp->type == CurvePrivate::eCurveTypeIntConstantInterp) ) && ( interp != eKeyframeTypeConstant) ) {
+        if ( ( (_imp->type == eCurveTypeString) || (_imp->type == eCurveTypeBool) ||
+              ( _imp->type == eCurveTypeIntConstantInterp) ) && ( interp != eKeyframeTypeConstant) ) {
             return *it;
         }
 
@@ -1522,10 +1639,11 @@ Curve::setCurveInterpolation(KeyframeTypeEnum interp)
     {
         QMutexLocker l(&_imp->_lock);
         ///if the curve is a string_curve or bool_curve the interpolation is bound to be constant.
-        if ( ( (_imp->type == CurvePrivate::eCurveTypeString) || (_imp->type == CurvePrivate::eCurveTypeBool) ||
-               ( _imp->type == CurvePrivate::eCurveTypeIntConstantInterp) ) && ( interp != eKeyframeTypeConstant) ) {
+        if ( ( (_imp->type == eCurveTypeString) || (_imp->type == eCurveTypeBool) ||
+               ( _imp->type == eCurveTypeIntConstantInterp) ) && ( interp != eKeyframeTypeConstant) ) {
             return;
         }
+        beginChangesBatch();
         for (int i = 0; i < (int)_imp->keyFrames.size(); ++i) {
             KeyFrameSet::iterator it = _imp->keyFrames.begin();
             std::advance(it, i);
@@ -1533,6 +1651,7 @@ Curve::setCurveInterpolation(KeyframeTypeEnum interp)
                 it = setKeyframeInterpolation_internal(it, interp);
             }
         }
+        endChangesBatch();
     }
 }
 
@@ -1787,7 +1906,7 @@ Curve::isYComponentMovable() const
 {
     QMutexLocker l(&_imp->_lock);
 
-    return _imp->type != CurvePrivate::eCurveTypeString;
+    return _imp->type != eCurveTypeString;
 }
 
 bool
@@ -1795,7 +1914,7 @@ Curve::areKeyFramesValuesClampedToIntegers() const
 {
     QMutexLocker l(&_imp->_lock);
 
-    return _imp->type == CurvePrivate::eCurveTypeInt;
+    return _imp->type == eCurveTypeInt;
 }
 
 bool
@@ -1803,7 +1922,7 @@ Curve::areKeyFramesValuesClampedToBooleans() const
 {
     QMutexLocker l(&_imp->_lock);
 
-    return _imp->type == CurvePrivate::eCurveTypeBool;
+    return _imp->type == eCurveTypeBool;
 }
 
 void
@@ -1814,30 +1933,75 @@ Curve::setYRange(double yMin,
 
     _imp->yMin = yMin;
     _imp->yMax = yMax;
+    publishSnapshot();
 }
 
 bool
-Curve::mustClamp() const
+Curve::mustClamp(const CurveSnapshot& snapshot) const
 {
     // PRIVATE - should not lock
-    return _imp->owner || _imp->yMin != -std::numeric_limits<double>::infinity() || _imp->yMax != std::numeric_limits<double>::infinity();
+    return _imp->owner || snapshot.yMin != -std::numeric_limits<double>::infinity() || snapshot.yMax != std::numeric_limits<double>::infinity();
 }
 
 void
 Curve::onCurveChanged()
 {
     // PRIVATE - should not lock
+    if (_imp->changesBatchLevel > 0) {
+        _imp->changedInBatch = true;
+
+        return;
+    }
+    publishSnapshot();
     if (_imp->owner) {
         _imp->owner->clearExpressionsResults(_imp->dimensionInOwner);
     }
-#ifdef NATRON_CURVE_USE_CACHE
-    _imp->resultCache.clear();
-#endif
+}
+
+void
+Curve::beginChangesBatch()
+{
+    // PRIVATE - should be locked
+    ++_imp->changesBatchLevel;
+}
+
+void
+Curve::endChangesBatch()
+{
+    // PRIVATE - should be locked
+    assert(_imp->changesBatchLevel > 0);
+    if ( (--_imp->changesBatchLevel == 0) && _imp->changedInBatch ) {
+        _imp->changedInBatch = false;
+        onCurveChanged();
+    }
+}
+
+CurveSnapshotPtr
+Curve::getSnapshot() const
+{
+    return std::atomic_load(&_imp->snapshot);
+}
+
+void
+Curve::publishSnapshot()
+{
+    // PRIVATE - should be locked
+    std::shared_ptr<CurveSnapshot> snapshot = std::make_shared<CurveSnapshot>();
+
+    snapshot->keyFrames.assign( _imp->keyFrames.begin(), _imp->keyFrames.end() );
+    snapshot->type = _imp->type;
+    snapshot->isPeriodic = _imp->isPeriodic;
+    snapshot->xMin = _imp->xMin;
+    snapshot->xMax = _imp->xMax;
+    snapshot->yMin = _imp->yMin;
+    snapshot->yMax = _imp->yMax;
+    std::atomic_store( &_imp->snapshot, CurveSnapshotPtr(snapshot) );
 }
 
 void
 Curve::setKeyframesInternal(const KeyFrameSet& keys, bool refreshDerivatives)
 {
+    beginChangesBatch();
     if (!refreshDerivatives) {
         _imp->keyFrames = keys;
     } else {
@@ -1852,7 +2016,7 @@ Curve::setKeyframesInternal(const KeyFrameSet& keys, bool refreshDerivatives)
 
     }
     onCurveChanged();
-
+    endChangesBatch();
 }
 
 void
@@ -29,9 +29,11 @@
 #include "Global/Macros.h"
 
 #include <vector>
+#include <cstddef>
 #include <map>
 #include <set>
 #include <list>
+#include <memory>
 #include <utility>
 
 #include "Global/GlobalDefines.h"
@@ -126,6 +128,7 @@ typedef std::set<KeyFrame, KeyFrame_compare_time> KeyFrameSet;
 
 
 struct CurvePrivate;
+struct CurveSnapshot;
 
 class Curve
 {
@@ -251,6 +254,18 @@ public:
      */
     double getValueAt(double t, bool clamp = true) const WARN_UNUSED_RETURN;
 
+    /*
+     * Same as getValueAt() for the n times in the 'times' array, stored in 'values'.
+     * The keyframes are looked up once per segment rather than once per time, which is much faster
+     * when the times are sorted, e.g. to draw or sample the curve. 'times' and 'values' may be the same array.
+     */
+    void getValuesAt(const double* times, double* values, std::size_t n, bool clamp = true) const;
+
+    /*
+     * Same as getValuesAt() for the n times t0, t0 + step, ..., t0 + (n - 1) * step.
+     */
+    void getValuesAtUniformTimes(double t0, double step, double* values, std::size_t n, bool clamp = true) const;
+
     double getDerivativeAt(double t) const WARN_UNUSED_RETURN;
 
     double getIntegrateFromTo(double t1, double t2) const WARN_UNUSED_RETURN;
@@ -362,11 +377,11 @@ private:
     KeyFrameSet::const_iterator atIndex(int index) const WARN_UNUSED_RETURN;
     KeyFrameSet::const_iterator begin() const WARN_UNUSED_RETURN;
     KeyFrameSet::const_iterator end() const WARN_UNUSED_RETURN;
-    YRange getCurveYRange_internal() const WARN_UNUSED_RETURN;
+    YRange getCurveYRange_internal(const CurveSnapshot& snapshot) const WARN_UNUSED_RETURN;
 
     void removeKeyFrame(KeyFrameSet::const_iterator it);
 
-    double clampValueToCurveYRange(double v) const WARN_UNUSED_RETURN;
+    double clampValueToCurveYRange(const CurveSnapshot& snapshot, double v) const WARN_UNUSED_RETURN;
 
     void setKeyframesInternal(const KeyFrameSet& keys, bool refreshDerivatives);
 
@@ -385,7 +400,7 @@ private:
     KeyFrameSet::iterator refreshDerivatives(CurveChangedReasonEnum reason, KeyFrameSet::iterator key);
     KeyFrameSet::iterator setKeyFrameValueAndTimeNoUpdate(double value, double time, KeyFrameSet::iterator k) WARN_UNUSED_RETURN;
 
-    bool mustClamp() const;
+    bool mustClamp(const CurveSnapshot& snapshot) const;
 
     KeyFrameSet::iterator setKeyframeInterpolation_internal(KeyFrameSet::iterator it, KeyframeTypeEnum type);
 
@@ -394,6 +409,28 @@ private:
      **/
     void onCurveChanged();
 
+    /**
+     * @brief Returns the last published snapshot of the curve, without taking the curve lock. The snapshot
+     * can be used as long as it is held, even if the curve is modified meanwhile.
+     **/
+    std::shared_ptr<const CurveSnapshot> getSnapshot() const;
+
+    /**
+     * @brief Publishes a new snapshot of the keyframes. Must be called with the curve lock held
+     * after any modification of the keyframes or of the curve parameters.
+     * This copies all the keyframes, so adding n keyframes one by one is O(n^2): to set many keyframes,
+     * use setKeyframes() or a changes batch.
+     **/
+    void publishSnapshot();
+
+    /**
+     * @brief Between these calls, onCurveChanged() only records that the curve changed, and the snapshot is
+     * published once by the outermost endChangesBatch(), instead of once per keyframe.
+     * Must be called with the curve lock held.
+     **/
+    void beginChangesBatch();
+    void endChangesBatch();
+
 private:
     std::unique_ptr<CurvePrivate> _imp;
 };
@@ -28,6 +28,13 @@
 
 #include "Global/Macros.h"
 
+#include <atomic>
+#include <cmath>
+#include <cstring> // memcpy
+#include <limits>
+#include <memory>
+#include <vector>
+
 #include <QtCore/QMutex>
 #if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
 #include <QtCore/QRecursiveMutex>
@@ -41,26 +48,144 @@
 
 //#define NATRON_CURVE_USE_CACHE
 
+// Number of interpolation results cached per snapshot, must be a power of 2
+#define NATRON_CURVE_RESULT_CACHE_SIZE 64
+
 NATRON_NAMESPACE_ENTER
 
-struct CurvePrivate
+enum CurveTypeEnum
+{
+    eCurveTypeDouble = 0, //< the values held by the keyframes can be any real
+    eCurveTypeInt, //< the values held by the keyframes can only be integers
+    eCurveTypeIntConstantInterp, //< same as eCurveTypeInt but interpolation is restricted to eKeyframeTypeConstant
+    eCurveTypeBool, //< the values held by the keyframes can be either 0 or 1
+    eCurveTypeString //< the values held by the keyframes can only be integers and keyframes are ordered by increasing values
+    // and times
+};
+
+typedef std::vector<KeyFrame> KeyFrameVector;
+
+#ifdef NATRON_CURVE_USE_CACHE
+/**
+ * @brief A fixed-size, direct-mapped cache of interpolation results that can be read and written
+ * concurrently without locking. Each slot is protected by a sequence number (seqlock): a writer that finds
+ * the slot busy simply does not cache its result, and a reader that sees the slot change misses.
+ **/
+class CurveResultCache
 {
-    enum CurveTypeEnum
+    struct Entry
     {
-        eCurveTypeDouble = 0, //< the values held by the keyframes can be any real
-        eCurveTypeInt, //< the values held by the keyframes can only be integers
-        eCurveTypeIntConstantInterp, //< same as eCurveTypeInt but interpolation is restricted to eKeyframeTypeConstant
-        eCurveTypeBool, //< the values held by the keyframes can be either 0 or 1
-        eCurveTypeString //< the values held by the keyframes can only be integers and keyframes are ordered by increasing values
-        // and times
+        std::atomic<unsigned int> seq; //< odd while the entry is being written
+        std::atomic<double> time;
+        std::atomic<double> value;
+
+        Entry()
+            : seq(0)
+            , time( std::numeric_limits<double>::quiet_NaN() ) // never equal to any time
+            , value(0.)
+        {
+        }
     };
 
-    KeyFrameSet keyFrames;
+    mutable Entry _entries[NATRON_CURVE_RESULT_CACHE_SIZE];
+
+    static unsigned int slot(double t)
+    {
+        unsigned long long bits;
+
+        std::memcpy( &bits, &t, sizeof(bits) );
+        bits ^= bits >> 29;
+        bits *= 0x9E3779B97F4A7C15ULL;
+
+        return (unsigned int)(bits >> 40) & (NATRON_CURVE_RESULT_CACHE_SIZE - 1);
+    }
+
+public:
+
+    bool get(double t,
+             double* v) const
+    {
+        const Entry& e = _entries[slot(t)];
+        unsigned int seq = e.seq.load(std::memory_order_acquire);
+
+        if (seq & 1) {
+            return false;
+        }
+        double time = e.time.load(std::memory_order_relaxed);
+        double value = e.value.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if ( (e.seq.load(std::memory_order_relaxed) != seq) || (time != t) ) {
+            return false;
+        }
+        *v = value;
+
+        return true;
+    }
+
+    void insert(double t,
+                double v) const
+    {
+        Entry& e = _entries[slot(t)];
+        unsigned int seq = e.seq.load(std::memory_order_relaxed);
+
+        if ( (seq & 1) || !e.seq.compare_exchange_strong(seq, seq + 1, std::memory_order_acquire) ) {
+            return;
+        }
+        e.time.store(t, std::memory_order_relaxed);
+        e.value.store(v, std::memory_order_relaxed);
+        e.seq.store(seq + 2, std::memory_order_release);
+    }
+};
+#endif // NATRON_CURVE_USE_CACHE
+
+/**
+ * @brief Immutable copy of everything needed to evaluate a curve.
+ * A new snapshot is published by the writers (under the curve lock) each time the curve changes, or once at
+ * the end of an operation changing many keyframes, so that readers such as Curve::getValueAt() never take the
+ * curve lock: they load the current snapshot, which remains valid for as long as they hold it (read-copy-update).
+ * Note that std::atomic_load/std::atomic_store on a shared_ptr are not lock-free in the common standard libraries:
+ * they take a short internal lock, but readers never wait for a writer editing the curve.
+ **/
+struct CurveSnapshot
+{
+    KeyFrameVector keyFrames; //< sorted by increasing time
+    CurveTypeEnum type;
+    bool isPeriodic;
+    double xMin, xMax;
+    double yMin, yMax;
 
 #ifdef NATRON_CURVE_USE_CACHE
-    std::map<double, double> resultCache; //< a cache for interpolations
+    CurveResultCache resultCache; //< a cache for interpolations, discarded with the snapshot
 #endif
 
+    CurveSnapshot()
+        : keyFrames()
+        , type(eCurveTypeDouble)
+        , isPeriodic(false)
+        , xMin(-std::numeric_limits<double>::infinity())
+        , xMax(std::numeric_limits<double>::infinity())
+        , yMin(-std::numeric_limits<double>::infinity())
+        , yMax(std::numeric_limits<double>::infinity())
+#ifdef NATRON_CURVE_USE_CACHE
+        , resultCache()
+#endif
+    {
+    }
+};
+
+typedef std::shared_ptr<const CurveSnapshot> CurveSnapshotPtr;
+
+struct CurvePrivate
+{
+    KeyFrameSet keyFrames;
+
+    // The snapshot read by the evaluation functions. Only accessed with std::atomic_load/std::atomic_store.
+    CurveSnapshotPtr snapshot;
+
+    // While positive, the changes of the curve are published once, when the outermost batch ends
+    int changesBatchLevel;
+    bool changedInBatch;
+
     KnobI* owner;
     int dimensionInOwner;
     CurveTypeEnum type;
@@ -76,9 +201,9 @@ struct CurvePrivate
 
     CurvePrivate()
         : keyFrames()
-#ifdef NATRON_CURVE_USE_CACHE
-        , resultCache()
-#endif
+        , snapshot( std::make_shared<CurveSnapshot>() )
+        , changesBatchLevel(0)
+        , changedInBatch(false)
         , owner(NULL)
         , dimensionInOwner(-1)
         , type(eCurveTypeDouble)
@@ -97,10 +222,12 @@ struct CurvePrivate
     }
 
     CurvePrivate(const CurvePrivate & other)
+        : changesBatchLevel(0)
+        , changedInBatch(false)
 #if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
-        : _lock()
+        , _lock()
 #else
-        : _lock(QMutex::Recursive)
+        , _lock(QMutex::Recursive)
 #endif
     {
         *this = other;
@@ -109,6 +236,7 @@ struct CurvePrivate
     void operator=(const CurvePrivate & other)
     {
         keyFrames = other.keyFrames;
+        std::atomic_store( &snapshot, std::atomic_load(&other.snapshot) );
         owner = other.owner;
         dimensionInOwner = other.dimensionInOwner;
         isParametric = other.isParametric;
@@ -70,6 +70,9 @@ Curve::serialize(Archive & ar,
 {
     QMutexLocker l(&_imp->_lock);
     ar & ::boost::serialization::make_nvp("KeyFrameSet", _imp->keyFrames);
+    if (Archive::is_loading::value) {
+        publishSnapshot();
+    }
 }
 
 NATRON_NAMESPACE_EXIT
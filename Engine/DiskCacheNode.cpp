@@ -32,7 +32,11 @@
 #include "Engine/Node.h"
 #include "Engine/Image.h"
 #include "Engine/AppInstance.h"
+#include "Engine/AppManager.h"
+#include "Engine/ImageKey.h"
 #include "Engine/KnobTypes.h"
+#include "Engine/OutputSchedulerThread.h"
+#include "Engine/PlaybackPrefetchWindow.h"
 #include "Engine/TimeLine.h"
 #include "Engine/ViewIdx.h"
 
@@ -45,6 +49,9 @@ struct DiskCacheNodePrivate
     KnobIntWPtr lastFrame;
     KnobButtonWPtr preRender;
 
+    // The frames whose images are read ahead from the disk cache during playback
+    PlaybackPrefetchWindow playbackPrefetchWindow;
+
     DiskCacheNodePrivate()
     {
     }
@@ -244,6 +251,27 @@ DiskCacheNode::isHostChannelSelectorSupported(bool* /*defaultR*/,
     return false;
 }
 
+void
+DiskCacheNode::prefetchPlaybackImages(const ImageKey& key,
+                                      const NodePtr& treeRoot)
+{
+    OutputEffectInstancePtr output = treeRoot ? std::dynamic_pointer_cast<OutputEffectInstance>( treeRoot->getEffectInstance() ) : OutputEffectInstancePtr();
+    RenderEnginePtr engine = output ? output->getRenderEngine() : RenderEnginePtr();
+
+    if (!engine) {
+        return;
+    }
+
+    std::vector<int> frames;
+    _imp->playbackPrefetchWindow.getFramesToPrefetch( (int)key.getTime(), engine->getPlaybackDirection() == eRenderDirectionForward, engine->getDesiredFPS(), &frames );
+
+    std::list<ImageKey> keys;
+    for (std::vector<int>::iterator it = frames.begin(); it != frames.end(); ++it) {
+        keys.push_back( key.getKeyAtTime(*it) );
+    }
+    appPTR->prefetchImages_diskCache(keys);
+}
+
 NATRON_NAMESPACE_EXIT
 NATRON_NAMESPACE_USING
 
@@ -139,6 +139,12 @@ public:
 
     virtual bool isHostChannelSelectorSupported(bool* defaultR, bool* defaultG, bool* defaultB, bool* defaultA) const OVERRIDE WARN_UNUSED_RETURN;
 
+    /**
+     * @brief Called during playback when the image of key is looked-up in the disk cache: reads ahead the images
+     * of the frames that follow, in the direction of the playback of the render engine of treeRoot.
+     **/
+    void prefetchPlaybackImages(const ImageKey& key, const NodePtr& treeRoot);
+
 private:
 
     virtual bool knobChanged(KnobI* k,
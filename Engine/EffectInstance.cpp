@@ -2157,8 +2157,10 @@ EffectInstance::Implementation::tiledRenderingFunctor(EffectInstance::Implementa
                                                                         args.processChannels,
                                                                         args.planes);
 
-    //Exit of the host frame threading thread
-    appPTR->getAppTLS()->cleanupTLSForThread();
+    //Exit of the host frame threading thread. The calling thread may render tiles too, its TLS must be kept.
+    if (callingThread != curThread) {
+        appPTR->getAppTLS()->cleanupTLSForThread();
+    }
 
     return ret;
 }
@@ -2625,6 +2627,8 @@ EffectInstance::Implementation::renderHandler(const EffectTLSDataPtr& tls,
 
     bool renderAborted = false;
     std::map<ImagePlaneDesc, EffectInstance::PlaneToRender> outputPlanes;
+    // The render action is timed to estimate the cost of the effect per pixel, see splitRectsForHostFrameThreading
+    TimeLapse renderActionTimer;
     for (std::list<std::list<std::pair<ImagePlaneDesc, ImagePtr> > >::iterator it = planesLists.begin(); it != planesLists.end(); ++it) {
         if (!multiPlanar) {
             assert( !it->empty() );
@@ -2726,6 +2730,10 @@ EffectInstance::Implementation::renderHandler(const EffectTLSDataPtr& tls,
 
     assert(!renderAborted);
 
+    if (!planes.useOpenGL) {
+        addRenderCost( actionArgs.roi, renderActionTimer.getTimeSinceCreation() );
+    }
+
     bool unPremultIfNeeded = planes.outputPremult == eImagePremultiplicationPremultiplied;
     bool useMaskMix = _publicInterface->isHostMaskingEnabled() || _publicInterface->isHostMixingEnabled();
     double mix = useMaskMix ? _publicInterface->getNode()->getHostMixingValue(time, view) : 1.;
@@ -34,6 +34,8 @@
 #include "Engine/NodeGroup.h"
 #include "Engine/ViewIdx.h"
 
+// Weight of the last measure in the running average of the render cost of an effect
+#define NATRON_RENDER_COST_SMOOTHING 0.25
 
 NATRON_NAMESPACE_ENTER
 
@@ -434,6 +436,8 @@ EffectInstance::Implementation::Implementation(EffectInstance* publicInterface)
     , renderClonesMutex()
     , renderClonesPool()
     , mustSyncPrivateData(false)
+    , renderCostMutex()
+    , renderTimePerPixel(-1.)
 {
     tlsData = std::make_shared<TLSHolder<EffectTLSData> >();
     actionsCache = std::make_shared<ActionsCache>(appPTR->getHardwareIdealThreadCount() * 2);
@@ -467,10 +471,46 @@ EffectInstance::Implementation::Implementation(const Implementation& other)
 , isDoingInstanceSafeRender(false)
 , renderClonesMutex()
 , renderClonesPool()
+, renderCostMutex()
+, renderTimePerPixel(-1.)
 {
 
 }
 
+void
+EffectInstance::Implementation::addRenderCost(const RectI& roi,
+                                              double timeSpent)
+{
+    if ( roi.isNull() || (timeSpent <= 0.) ) {
+        return;
+    }
+    if (mainInstance) {
+        mainInstance->_imp->addRenderCost(roi, timeSpent);
+
+        return;
+    }
+
+    double timePerPixel = timeSpent / (double)roi.area();
+    QMutexLocker k(&renderCostMutex);
+    if (renderTimePerPixel < 0.) {
+        renderTimePerPixel = timePerPixel;
+    } else {
+        // Exponential moving average, so that the estimate follows parameter changes within a few renders
+        renderTimePerPixel += (timePerPixel - renderTimePerPixel) * NATRON_RENDER_COST_SMOOTHING;
+    }
+}
+
+double
+EffectInstance::Implementation::getRenderTimePerPixel() const
+{
+    if (mainInstance) {
+        return mainInstance->_imp->getRenderTimePerPixel();
+    }
+    QMutexLocker k(&renderCostMutex);
+
+    return renderTimePerPixel;
+}
+
 void
 EffectInstance::Implementation::runChangedParamCallback(KnobI* k,
                                                         bool userEdited,
@@ -246,11 +246,26 @@ public:
     bool mustSyncPrivateData; //!< true if the effect's knobs were changed but instanceChanged could not be called (e.g. when loading a PyPlug), so that syncPrivateData should be called in getPreferredMetadata_public before calling getPreferredMetadata
     mutable QMutex mustSyncPrivateDataMutex; //!< protects mustSyncPrivateData
 
+    // Running average of the time in seconds spent in the render action per pixel, used to choose the tiles of host frame threading.
+    // It is negative until the render action was called once.
+    mutable QMutex renderCostMutex; //!< protects renderTimePerPixel
+    double renderTimePerPixel;
+
 public:
     void runChangedParamCallback(KnobI* k, bool userEdited, const std::string & callback);
 
     void setDuringInteractAction(bool b);
 
+    /**
+     * @brief Records the time spent by the render action on the given rectangle. Render clones report to the main instance.
+     **/
+    void addRenderCost(const RectI& roi, double timeSpent);
+
+    /**
+     * @brief Returns the average time spent by the render action per pixel, or a negative value if it was never measured.
+     **/
+    double getRenderTimePerPixel() const;
+
 #if NATRON_ENABLE_TRIMAP
     void markImageAsBeingRendered(const ImagePtr & img, const RectI& roi, std::list<RectI>* restToRender, bool *renderedElsewhere);
 
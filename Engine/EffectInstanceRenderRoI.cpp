@@ -34,12 +34,11 @@
 #include <cassert>
 #include <stdexcept>
 #include <sstream> // stringstream
+#include <vector>
 
 #include <QtCore/QThreadPool>
 #include <QtCore/QReadWriteLock>
 #include <QtCore/QCoreApplication>
-#include <QtConcurrentMap> // QtCore on Qt4, QtConcurrent on Qt5
-#include <QtConcurrentRun> // QtCore on Qt4, QtConcurrent on Qt5
 
 #include "Global/QtCompat.h"
 
@@ -66,6 +65,7 @@
 #include "Engine/RotoContext.h"
 #include "Engine/RotoDrawableItem.h"
 #include "Engine/Settings.h"
+#include "Engine/TaskScheduler.h"
 #include "Engine/Timer.h"
 #include "Engine/Transform.h"
 #include "Engine/ThreadPool.h"
@@ -74,8 +74,56 @@
 
 //#define NATRON_ALWAYS_ALLOCATE_FULL_IMAGE_BOUNDS
 
+// Minimum estimated time in seconds of the render action on a tile for host frame threading: below that, the cost
+// of scheduling the tile and calling the render action is not worth it
+#define NATRON_HOST_FRAME_THREADING_MIN_TILE_COST 0.002
+
+// Maximum number of tiles per thread for host frame threading
+#define NATRON_HOST_FRAME_THREADING_MAX_TILES_PER_THREAD 8
+
 NATRON_NAMESPACE_ENTER
 
+/*
+ * @brief Split the non-identity rects to render with host frame threading according to the measured cost of the effect.
+ * Cheap effects are cut in a few tiles that cost at least NATRON_HOST_FRAME_THREADING_MIN_TILE_COST each, whereas expensive
+ * effects are cut in more tiles than threads so that the threads that finish early can steal the remaining tiles.
+ * Tiles are never smaller than what splitIntoSmallerRects() allows (128x128 pixels), which keeps them cache friendly.
+ * If the effect was never rendered, the rects are cut in one tile per thread.
+ * The input images and RoIs of a rect are shared by its tiles.
+ */
+static void
+splitRectsForHostFrameThreading(double timePerPixel,
+                                int nThreads,
+                                std::list<EffectInstance::RectToRender>* rectsToRender)
+{
+    if (nThreads <= 1) {
+        return;
+    }
+    std::list<EffectInstance::RectToRender> ret;
+    for (std::list<EffectInstance::RectToRender>::const_iterator it = rectsToRender->begin(); it != rectsToRender->end(); ++it) {
+        int nTiles;
+        if (it->isIdentity) {
+            nTiles = 1;
+        } else if (timePerPixel < 0.) {
+            nTiles = nThreads;
+        } else {
+            double cost = timePerPixel * (double)it->rect.area();
+            nTiles = (int)std::min( cost / NATRON_HOST_FRAME_THREADING_MIN_TILE_COST, (double)nThreads * NATRON_HOST_FRAME_THREADING_MAX_TILES_PER_THREAD );
+        }
+        if (nTiles <= 1) {
+            ret.push_back(*it);
+            continue;
+        }
+        std::vector<RectI> splits = it->rect.splitIntoSmallerRects(nTiles);
+        for (std::size_t i = 0; i < splits.size(); ++i) {
+            EffectInstance::RectToRender r = *it;
+            r.rect = splits[i];
+            ret.push_back(r);
+        }
+    }
+    rectsToRender->swap(ret);
+}
+
 /*
  * @brief Split all rects to render in smaller rects and check if each one of them is identity.
  * For identity rectangles, we just call renderRoI again on the identity input in the tiledRenderingFunctor.
@@ -897,11 +945,31 @@ EffectInstance::renderRoI(const RenderRoIArgs & args,
      * that the plug-in expects.
      */
     ImageBitDepthEnum outputDepth = getBitDepth(-1);
+
+    /*
+     * The depth of the image held in the cache: float images may be stored in half float. The plug-in then renders in a temporary
+     * image of outputDepth which is converted to the cached image, and the image returned is converted back to args.bitdepth.
+     * Paint strokes render directly in the cached image and OpenGL textures are not cached, keep them in the requested depth.
+     */
+    ImageBitDepthEnum cachedDepth = args.bitdepth;
+    if ( (storage != eStorageModeGLTex) && !isDuringPaintStroke && !isPaintingOverItselfEnabled() ) {
+        cachedDepth = getNode()->getCachedImagesBitDepth(args.bitdepth);
+    }
     ImagePlaneDesc outputClipPrefComps, outputClipPrefCompsPaired;
     getMetadataComponents(-1, &outputClipPrefComps, &outputClipPrefCompsPaired);
     ImagePlanesToRenderPtr planesToRender = std::make_shared<ImagePlanesToRender>();
     planesToRender->useOpenGL = storage == eStorageModeGLTex;
     FramesNeededMapPtr framesNeeded = std::make_shared<FramesNeededMap>();
+
+    // During playback, read ahead the images of the next frames cached on disk so that looking them up does not wait for their pages to be read
+    if ( (storage == eStorageModeDisk) && frameArgs->isSequentialRender && isFrameVaryingOrAnimated ) {
+        DiskCacheNode* diskCacheNode = dynamic_cast<DiskCacheNode*>(this);
+        assert(diskCacheNode);
+        if (diskCacheNode) {
+            diskCacheNode->prefetchPlaybackImages(*nonDraftKey, frameArgs->treeRoot);
+        }
+    }
+
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     ////////////////////////////// Look-up the cache ///////////////////////////////////////////////////////////////
 
@@ -945,7 +1013,7 @@ EffectInstance::renderRoI(const RenderRoIArgs & args,
                     getImageFromCacheAndConvertIfNeeded(createInCache, storage, args.returnStorage, n == 0 ? *nonDraftKey : *key, lookupMipmapLevel,
                                                         &downscaledImageBounds,
                                                         &rod, args.roi,
-                                                        args.bitdepth, *it,
+                                                        cachedDepth, *it,
                                                         args.inputImagesList,
                                                         frameArgs->stats,
                                                         glContextLocker,
@@ -977,7 +1045,7 @@ EffectInstance::renderRoI(const RenderRoIArgs & args,
                         getImageFromCacheAndConvertIfNeeded(createInCache, storage, args.returnStorage, n == 0 ? *nonDraftKey : *key, renderMappedMipmapLevel,
                                                             &upscaledImageBounds,
                                                             &rod, roi,
-                                                            args.bitdepth, *it,
+                                                            cachedDepth, *it,
                                                             args.inputImagesList,
                                                             frameArgs->stats,
                                                             glContextLocker,
@@ -1238,9 +1306,10 @@ EffectInstance::renderRoI(const RenderRoIArgs & args,
         // If the plug-in is eRenderSafetyFullySafeFrame that means it wants the host to perform SMP aka slice up the RoI into chunks
         // but if the effect doesn't support tiles it won't work.
         // Also check that the number of threads indicating by the settings are appropriate for this render mode.
+        // Nested host frame threading is fine: the task scheduler never runs more threads than the maximum and the
+        // calling thread renders the tiles that no other thread picked.
         if ( !frameArgs->tilesSupported || (nbThreads == -1) || (nbThreads == 1) ||
-            ( (nbThreads == 0) && (appPTR->getHardwareIdealThreadCount() == 1) ) ||
-            ( QThreadPool::globalInstance()->activeThreadCount() >= QThreadPool::globalInstance()->maxThreadCount() )) {
+            ( (nbThreads == 0) && (appPTR->getHardwareIdealThreadCount() == 1) ) ) {
             safety = eRenderSafetyFullySafe;
         }
     }
@@ -1249,24 +1318,6 @@ EffectInstance::renderRoI(const RenderRoIArgs & args,
     if (tryIdentityOptim) {
         optimizeRectsToRender(this, inputsRoDIntersectionPixel, rectsLeftToRender, args.time, args.view, renderMappedScale, &planesToRender->rectsToRender);
     } else {
-        // If plug-in wants host frame threading and there is only 1 rect to render, split it
-        /*if (safety == eRenderSafetyFullySafeFrame && rectsLeftToRender.size() == 1 && frameArgs->tilesSupported) {
-            QThreadPool* tp = QThreadPool::globalInstance();
-            int nThreads = (tp->maxThreadCount() - tp->activeThreadCount());
-
-            std::vector<RectI> splits;
-            if (nThreads > 1) {
-                splits = rectsLeftToRender.front().splitIntoSmallerRects(nThreads);
-            } else {
-                splits.push_back(rectsLeftToRender.front());
-            }
-            for (std::vector<RectI>::iterator it = splits.begin(); it != splits.end(); ++it) {
-                RectToRender r;
-                r.rect = *it;
-                r.isIdentity = false;
-                planesToRender->rectsToRender.push_back(r);
-            }
-        }*/
         for (std::list<RectI>::iterator it = rectsLeftToRender.begin(); it != rectsLeftToRender.end(); ++it) {
             RectToRender r;
             r.rect = *it;
@@ -1348,6 +1399,12 @@ EffectInstance::renderRoI(const RenderRoIArgs & args,
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     ////////////////////////////// End Pre-render input images ////////////////////////////////////////////////////////////
 
+    // If the plug-in wants host frame threading, split the rects to render in tiles now that the inputs are rendered:
+    // splitting earlier would render the inputs tile by tile
+    if ( (safety == eRenderSafetyFullySafeFrame) && hasSomethingToRender && !planesToRender->useOpenGL ) {
+        splitRectsForHostFrameThreading( _imp->getRenderTimePerPixel(), appPTR->getMaxThreadCount(), &planesToRender->rectsToRender );
+    }
+
 
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     ////////////////////////////// Allocate planes in the cache ////////////////////////////////////////////////////////////
@@ -1387,7 +1444,7 @@ EffectInstance::renderRoI(const RenderRoIArgs & args,
                                    upscaledImageBounds,
                                    isProjectFormat,
                                    *components,
-                                   args.bitdepth,
+                                   cachedDepth,
                                    planesToRender->outputPremult,
                                    fieldingOrder,
                                    par,
@@ -1455,7 +1512,7 @@ EffectInstance::renderRoI(const RenderRoIArgs & args,
                                                                           downscaledImageBounds,
                                                                           args.mipmapLevel,
                                                                           it->second.fullscaleImage->getPixelAspectRatio(),
-                                                                          outputDepth,
+                                                                          it->second.fullscaleImage->getBitDepth(),
                                                                           planesToRender->outputPremult,
                                                                           fieldingOrder,
                                                                           true);
@@ -1958,13 +2015,19 @@ EffectInstance::renderRoIInternal(EffectInstance* self,
 
 #else
 
-            std::function<RenderingFunctorRetEnum(const RectToRender&)> render = [&](const RectToRender& rect) {
-                return self->_imp->tiledRenderingFunctor(*tiledArgs, rect, currentThread);
+            std::vector<RectToRender> rects( planesToRender->rectsToRender.begin(), planesToRender->rectsToRender.end() );
+            std::vector<EffectInstance::RenderingFunctorRetEnum> ret( rects.size() );
+            std::function<void(int)> render = [&](int i) {
+                ret[i] = self->_imp->tiledRenderingFunctor(*tiledArgs, rects[i], currentThread);
             };
 
-            QFuture<RenderingFunctorRetEnum> ret = QtConcurrent::mapped(planesToRender->rectsToRender, render);
-            ret.waitForFinished();
-            QFuture<EffectInstance::RenderingFunctorRetEnum>::const_iterator it2;
+            // The calling thread renders tiles too, and idle threads of the scheduler steal the others
+            TaskSchedulerStats schedulerStats;
+            appPTR->getTaskScheduler()->parallelFor( (int)rects.size(), render, &schedulerStats );
+            if ( frameArgs->stats && frameArgs->stats->isInDepthProfilingEnabled() ) {
+                frameArgs->stats->addSchedulerInfosForNode(self->getNode(), schedulerStats.nTasks, schedulerStats.nTasksStolen, schedulerStats.queueDepth);
+            }
+            std::vector<EffectInstance::RenderingFunctorRetEnum>::const_iterator it2;
 
 #endif
             for (it2 = ret.begin(); it2 != ret.end(); ++it2) {
@@ -76,9 +76,13 @@ SOURCES += \
     Backdrop.cpp \
     Bezier.cpp \
     BezierCP.cpp \
+    BezierPolygonCache.cpp \
     BlockingBackgroundRender.cpp \
     CLArgs.cpp \
+    CPUFeatures.cpp \
     Cache.cpp \
+    CacheCompression.cpp \
+    CacheIndexFile.cpp \
     CoonsRegularization.cpp \
     CreateNodeArgs.cpp \
     Curve.cpp \
@@ -102,6 +106,7 @@ SOURCES += \
     GenericSchedulerThreadWatcher.cpp \
     GroupInput.cpp \
     GroupOutput.cpp \
+    Half.cpp \
     Hash64.cpp \
     HistogramCPU.cpp \
     HostOverlaySupport.cpp \
@@ -117,6 +122,7 @@ SOURCES += \
     Knob.cpp \
     KnobFactory.cpp \
     KnobFile.cpp \
+    KnobNativeExpression.cpp \
     KnobSerialization.cpp \
     KnobTypes.cpp \
     LibraryBinary.cpp \
@@ -155,6 +161,7 @@ SOURCES += \
     OutputEffectInstance.cpp \
     OutputSchedulerThread.cpp \
     ParallelRenderArgs.cpp \
+    PlaybackPrefetchWindow.cpp \
     Plugin.cpp \
     PluginMemory.cpp \
     PrecompNode.cpp \
@@ -180,7 +187,9 @@ SOURCES += \
     RotoItem.cpp \
     RotoLayer.cpp \
     RotoPaint.cpp \
+    RotoPaintCompositor.cpp \
     RotoPaintInteract.cpp \
+    RotoShapeRasterizer.cpp \
     RotoSmear.cpp \
     RotoStrokeItem.cpp \
     RotoUndoCommand.cpp \
@@ -190,6 +199,7 @@ SOURCES += \
     StandardPaths.cpp \
     StringAnimationManager.cpp \
     TLSHolder.cpp \
+    TaskScheduler.cpp \
     Texture.cpp \
     TextureRect.cpp \
     ThreadPool.cpp \
@@ -204,6 +214,7 @@ SOURCES += \
     TrackerUndoCommand.cpp \
     Transform.cpp \
     Utils.cpp \
+    ViewerDisplayTransform.cpp \
     ViewerInstance.cpp \
     WriteNode.cpp \
     ../Global/glad_source.c \
@@ -225,13 +236,17 @@ HEADERS += \
     BezierCP.h \
     BezierCPPrivate.h \
     BezierCPSerialization.h \
+    BezierPolygonCache.h \
     BezierSerialization.h \
     BlockingBackgroundRender.h \
     BufferableObject.h \
     CLArgs.h \
+    CPUFeatures.h \
     Cache.h \
+    CacheCompression.h \
     CacheEntry.h \
     CacheEntryHolder.h \
+    CacheIndexFile.h \
     CacheSerialization.h \
     ChoiceOption.h \
     CoonsRegularization.h \
@@ -264,6 +279,7 @@ HEADERS += \
     GenericSchedulerThreadWatcher.h \
     GroupInput.h \
     GroupOutput.h \
+    Half.h \
     Hash64.h \
     HistogramCPU.h \
     HostOverlaySupport.h \
@@ -282,6 +298,7 @@ HEADERS += \
     KnobFile.h \
     KnobGuiI.h \
     KnobImpl.h \
+    KnobNativeExpression.h \
     KnobSerialization.h \
     KnobTypes.h \
     LRUHashTable.h \
@@ -323,6 +340,7 @@ HEADERS += \
     OutputSchedulerThread.h \
     OverlaySupport.h \
     ParallelRenderArgs.h \
+    PlaybackPrefetchWindow.h \
     Plugin.h \
     PluginActionShortcut.h \
     PluginMemory.h \
@@ -356,8 +374,10 @@ HEADERS += \
     RotoLayer.h \
     RotoLayerSerialization.h \
     RotoPaint.h \
+    RotoPaintCompositor.h \
     RotoPaintInteract.h \
     RotoPoint.h \
+    RotoShapeRasterizer.h \
     RotoSmear.h \
     RotoStrokeItem.h \
     RotoStrokeItemSerialization.h \
@@ -370,6 +390,7 @@ HEADERS += \
     StringAnimationManager.h \
     TLSHolder.h \
     TLSHolderImpl.h \
+    TaskScheduler.h \
     Texture.h \
     TextureRect.h \
     TextureRectSerialization.h \
@@ -393,6 +414,7 @@ HEADERS += \
     Variant.h \
     VariantSerialization.h \
     ViewIdx.h \
+    ViewerDisplayTransform.h \
     ViewerInstance.h \
     ViewerInstancePrivate.h \
     WriteNode.h \
@@ -179,6 +179,7 @@ class KnobHolder;
 class KnobI;
 class KnobInt;
 class KnobLayers;
+class KnobNativeExpression;
 class KnobOutputFile;
 class KnobPage;
 class KnobParametric;
@@ -245,11 +246,13 @@ class RotoLayerSerialization;
 class RotoPaint;
 class RotoPaintInteract;
 class RotoPoint;
+class RotoShapeRasterizer;
 class RotoStrokeItem;
 class RotoStrokeItemSerialization;
 class Settings;
 class StringAnimationManager;
 class TLSHolderBase;
+class TaskScheduler;
 class Texture;
 class TextureRect;
 class TileCacheFile;
@@ -367,6 +370,7 @@ typedef std::shared_ptr<KnobHolder> KnobHolderPtr;
 typedef std::shared_ptr<KnobI> KnobIPtr;
 typedef std::shared_ptr<KnobInt> KnobIntPtr;
 typedef std::shared_ptr<KnobLayers> KnobLayersPtr;
+typedef std::shared_ptr<KnobNativeExpression> KnobNativeExpressionPtr;
 typedef std::shared_ptr<KnobOutputFile> KnobOutputFilePtr;
 typedef std::shared_ptr<KnobPage> KnobPagePtr;
 typedef std::shared_ptr<KnobParametric> KnobParametricPtr;
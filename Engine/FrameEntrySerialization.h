@@ -52,7 +52,8 @@ GCC_DIAG_ON(unused-parameter)
 #define FRAME_KEY_HANDLE_FP_CORRECTLY 6
 #define FRAME_KEY_INTRODUCES_DRAFT 7
 #define FRAME_KEY_INTRODUCES_CACHE_HOLDER_ID 8
-#define FRAME_KEY_VERSION FRAME_KEY_INTRODUCES_CACHE_HOLDER_ID
+#define FRAME_KEY_REMOVES_DISPLAY_TRANSFORM 9
+#define FRAME_KEY_VERSION FRAME_KEY_REMOVES_DISPLAY_TRANSFORM
 
 NATRON_NAMESPACE_ENTER
 
@@ -63,12 +64,17 @@ FrameKey::serialize(Archive & ar,
 {
     ar & ::boost::serialization::make_nvp("Time", _time);
     ar & ::boost::serialization::make_nvp("TreeVersion", _treeVersion);
-    ar & ::boost::serialization::make_nvp("Gain", _gain);
-
-    if (version >= FRAME_KEY_INTRODUCES_GAMMA) {
-        ar & ::boost::serialization::make_nvp("Gamma", _gamma);
+    if (version < FRAME_KEY_REMOVES_DISPLAY_TRANSFORM) {
+        // Older keys baked the display transform in 8bit textures: these entries are stored with eImageBitDepthByte
+        // and will never be looked up again since 8bit viewers now cache half-float linear tiles.
+        double gain, gamma;
+        int lut;
+        ar & ::boost::serialization::make_nvp("Gain", gain);
+        if (version >= FRAME_KEY_INTRODUCES_GAMMA) {
+            ar & ::boost::serialization::make_nvp("Gamma", gamma);
+        }
+        ar & ::boost::serialization::make_nvp("Lut", lut);
     }
-    ar & ::boost::serialization::make_nvp("Lut", _lut);
     ar & ::boost::serialization::make_nvp("BitDepth", _bitDepth);
     if (version < FRAME_KEY_CHANGES_BITDEPTH_ENUM) {
         _bitDepth += 1;
@@ -86,10 +92,9 @@ FrameKey::serialize(Archive & ar,
         ar & ::boost::serialization::make_nvp("Layer", _layer);
         ar & ::boost::serialization::make_nvp("Alpha", _alphaChannelFullName);
     }
-    if (version >= FRAME_KEY_HANDLE_FP_CORRECTLY) {
-        ar & ::boost::serialization::make_nvp("UserShader", _useShaders);
-    } else {
-        _useShaders = false;
+    if ( (version >= FRAME_KEY_HANDLE_FP_CORRECTLY) && (version < FRAME_KEY_REMOVES_DISPLAY_TRANSFORM) ) {
+        bool useShaders;
+        ar & ::boost::serialization::make_nvp("UserShader", useShaders);
     }
     if (version >= FRAME_KEY_INTRODUCES_DRAFT) {
         ar & ::boost::serialization::make_nvp("Draft", _draftMode);
@@ -36,9 +36,6 @@ FrameKey::FrameKey()
     : KeyHelper<U64>()
     , _time(0)
     , _treeVersion(0)
-    , _gain(1)
-    , _gamma(1)
-    , _lut(0)
     , _bitDepth(0)
     , _channels(0)
     , _view(0)
@@ -46,7 +43,6 @@ FrameKey::FrameKey()
     , _mipmapLevel(0)
     , _layer()
     , _alphaChannelFullName()
-    , _useShaders(false)
     , _draftMode(false)
 {
 }
@@ -54,9 +50,6 @@ FrameKey::FrameKey()
 FrameKey::FrameKey(const CacheEntryHolder* holder,
                    SequenceTime time,
                    U64 treeVersion,
-                   double gain,
-                   double gamma,
-                   int lut,
                    int bitDepth,
                    int channels,
                    ViewIdx view,
@@ -65,14 +58,10 @@ FrameKey::FrameKey(const CacheEntryHolder* holder,
                    const std::string & inputName,
                    const ImagePlaneDesc& layer,
                    const std::string& alphaChannelFullName,
-                   bool useShaders,
                    bool draftMode)
     : KeyHelper<U64>(holder)
     , _time(time)
     , _treeVersion(treeVersion)
-    , _gain(gain)
-    , _gamma(gamma)
-    , _lut(lut)
     , _bitDepth(bitDepth)
     , _channels(channels)
     , _view(view)
@@ -81,7 +70,6 @@ FrameKey::FrameKey(const CacheEntryHolder* holder,
     , _inputName(inputName)
     , _layer(layer)
     , _alphaChannelFullName(alphaChannelFullName)
-    , _useShaders(useShaders)
     , _draftMode(draftMode)
 {
 }
@@ -91,11 +79,6 @@ FrameKey::fillHash(Hash64* hash) const
 {
     hash->append(_time);
     hash->append(_treeVersion);
-    if (!_useShaders) {
-        hash->append(_gain);
-        hash->append(_gamma);
-        hash->append(_lut);
-    }
     hash->append(_bitDepth);
     hash->append(_channels);
     hash->append(_view);
@@ -123,9 +106,6 @@ FrameKey::operator==(const FrameKey & other) const
 {
     return _time == other._time &&
            _treeVersion == other._treeVersion &&
-           ( (_gain == other._gain &&
-              _gamma == other._gamma &&
-              _lut == other._lut) || (_useShaders && other._useShaders) ) &&
            _bitDepth == other._bitDepth &&
            _channels == other._channels &&
            _view == other._view &&
@@ -137,4 +117,15 @@ FrameKey::operator==(const FrameKey & other) const
            _draftMode == other._draftMode;
 }
 
+FrameKey
+FrameKey::getKeyAtTime(SequenceTime time) const
+{
+    FrameKey ret(*this);
+
+    ret._time = time;
+    ret.resetHash();
+
+    return ret;
+}
+
 NATRON_NAMESPACE_EXIT
@@ -45,9 +45,6 @@ public:
     FrameKey(const CacheEntryHolder* holder,
              SequenceTime time,
              U64 treeVersion,
-             double gain,
-             double gamma,
-             int lut,
              int bitDepth,
              int channels,
              ViewIdx view,
@@ -56,13 +53,18 @@ public:
              const std::string & inputName,
              const ImagePlaneDesc& layer,
              const std::string& alphaChannelFullName,
-             bool useShaders,
              bool draftMode);
 
     void fillHash(Hash64* hash) const;
 
     bool operator==(const FrameKey & other) const;
 
+    /**
+     * @brief Returns the key of the same texture at another time. During playback the keys of the next frames
+     * are predicted this way from the key of the current frame.
+     **/
+    FrameKey getKeyAtTime(SequenceTime time) const;
+
     SequenceTime getTime() const WARN_UNUSED_RETURN
     {
         return _time;
@@ -78,21 +80,6 @@ public:
         return _treeVersion;
     }
 
-    double getGain() const WARN_UNUSED_RETURN
-    {
-        return _gain;
-    }
-
-    double getGamma() const WARN_UNUSED_RETURN
-    {
-        return _gamma;
-    }
-
-    int getLut() const WARN_UNUSED_RETURN
-    {
-        return _lut;
-    }
-
     int getChannels() const WARN_UNUSED_RETURN
     {
         return _channels;
@@ -124,10 +111,7 @@ public:
 private:
     SequenceTime _time; // The frame in the sequence
     U64 _treeVersion; // The hash of the viewer node
-    double _gain; // The gain on the viewer (if we don't apply it through GLSL shaders)
-    double _gamma;  // The gamma on the viewer (if we don't apply it through GLSL shaders)
-    int _lut;  // The lut on the viewer (if we don't apply it through GLSL shaders)
-    int _bitDepth;  // The bitdepth of the texture (i.e: 8bit or 32bit fp)
+    int _bitDepth;  // The bitdepth of the stored linear tile (16bit half for 8bit viewers or 32bit fp). Gain, gamma and lut are applied after the cache.
     int _channels; // The display channels, as requested by the user. Note that this will make a new cache entry whenever the user
                    // picks a new value in dropdown on the GUI
     int /*ViewIdx*/ _view; // The view of the frame, store it locally as an int for easier serialization
@@ -136,7 +120,6 @@ private:
     std::string _inputName; // The name of the input node used (to not mix up input 1, 2, 3 etc...)
     ImagePlaneDesc _layer; // The Layer of the image
     std::string _alphaChannelFullName; /// e.g: color.a , only used if _channels if A
-    bool _useShaders; // Whether GLSL shaders are active or not
     bool _draftMode; // Whether draft mode is enabled or not
 };
 
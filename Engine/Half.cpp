@@ -0,0 +1,129 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * (C) 2018-2023 The Natron developers
+ * (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Half.h"
+
+#include "Engine/CPUFeatures.h"
+
+// F16C converts 8 values per instruction. When the compiler targets it, it is always used, otherwise
+// it is used if the CPU supports it.
+#if defined(__F16C__)
+#define NATRON_HALF_F16C 1
+#include <immintrin.h>
+#define NATRON_HALF_F16C_TARGET
+#elif ( defined(__GNUC__) || defined(__clang__) ) && ( defined(__x86_64__) || defined(__i386__) )
+#define NATRON_HALF_F16C 1
+#define NATRON_HALF_F16C_DISPATCH 1
+#include <immintrin.h>
+#define NATRON_HALF_F16C_TARGET __attribute__( ( target("avx,f16c") ) )
+#endif
+
+NATRON_NAMESPACE_ENTER
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+#ifdef NATRON_HALF_F16C
+
+NATRON_HALF_F16C_TARGET
+void
+convertHalfToFloatF16C(const Half* src,
+                       float* dst,
+                       std::size_t count)
+{
+    std::size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i h = _mm_loadu_si128( (const __m128i*)(src + i) );
+        _mm256_storeu_ps( dst + i, _mm256_cvtph_ps(h) );
+    }
+    for (; i < count; ++i) {
+        dst[i] = src[i];
+    }
+}
+
+NATRON_HALF_F16C_TARGET
+void
+convertFloatToHalfF16C(const float* src,
+                       Half* dst,
+                       std::size_t count)
+{
+    std::size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256 f = _mm256_loadu_ps(src + i);
+        _mm_storeu_si128( (__m128i*)(dst + i), _mm256_cvtps_ph(f, _MM_FROUND_TO_NEAREST_INT) );
+    }
+    for (; i < count; ++i) {
+        dst[i] = src[i];
+    }
+}
+
+#endif // NATRON_HALF_F16C
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+void
+convertHalfToFloat(const Half* src,
+                   float* dst,
+                   std::size_t count)
+{
+#if defined(NATRON_HALF_F16C) && !defined(NATRON_HALF_F16C_DISPATCH)
+    convertHalfToFloatF16C(src, dst, count);
+#else
+#ifdef NATRON_HALF_F16C_DISPATCH
+    if ( getCPUFeatures().f16c ) {
+        convertHalfToFloatF16C(src, dst, count);
+
+        return;
+    }
+#endif
+    for (std::size_t i = 0; i < count; ++i) {
+        dst[i] = src[i];
+    }
+#endif
+}
+
+void
+convertFloatToHalf(const float* src,
+                   Half* dst,
+                   std::size_t count)
+{
+#if defined(NATRON_HALF_F16C) && !defined(NATRON_HALF_F16C_DISPATCH)
+    convertFloatToHalfF16C(src, dst, count);
+#else
+#ifdef NATRON_HALF_F16C_DISPATCH
+    if ( getCPUFeatures().f16c ) {
+        convertFloatToHalfF16C(src, dst, count);
+
+        return;
+    }
+#endif
+    for (std::size_t i = 0; i < count; ++i) {
+        dst[i] = src[i];
+    }
+#endif
+}
+
+NATRON_NAMESPACE_EXIT
@@ -0,0 +1,176 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * (C) 2018-2023 The Natron developers
+ * (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_HALF_H
+#define NATRON_ENGINE_HALF_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cstddef>
+#include <cstring>
+
+#include "Global/GlobalDefines.h"
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief A 16-bit floating point number (1 sign bit, 5 exponent bits, 10 mantissa bits), the pixel type of
+ * eImageBitDepthHalf images. It has the same layout as the half of OpenEXR and the half-float images of OpenFX.
+ *
+ * It converts implicitly from and to float, so that the templated image processing code works on it as it does
+ * on float, and float values are rounded to the nearest half (ties to even), as the F16C instructions do.
+ * To convert many values at once, use convertHalfToFloat() and convertFloatToHalf() which use F16C when available.
+ **/
+class Half
+{
+public:
+
+    // Not initialized, like the other pixel types
+    Half() = default;
+
+    Half(float f)
+        : _bits( floatToBits(f) )
+    {
+    }
+
+    operator float() const
+    {
+        return bitsToFloat(_bits);
+    }
+
+    U16 bits() const
+    {
+        return _bits;
+    }
+
+    static Half fromBits(U16 bits)
+    {
+        Half h;
+
+        h._bits = bits;
+
+        return h;
+    }
+
+    bool isNan() const
+    {
+        return (_bits & 0x7fff) > 0x7c00;
+    }
+
+    static float bitsToFloat(U16 h)
+    {
+        U32 sign = (U32)(h & 0x8000) << 16;
+        U32 exponent = (h >> 10) & 0x1f;
+        U32 mantissa = h & 0x3ff;
+        U32 f;
+
+        if (exponent == 0) {
+            if (mantissa == 0) {
+                // +/- 0
+                f = sign;
+            } else {
+                // denormalized half: normalize it, all half values are normalized floats
+                exponent = 127 - 15 + 1;
+                while ( !(mantissa & 0x400) ) {
+                    mantissa <<= 1;
+                    --exponent;
+                }
+                mantissa &= 0x3ff;
+                f = sign | (exponent << 23) | (mantissa << 13);
+            }
+        } else if (exponent == 31) {
+            // inf or NaN, NaNs are made quiet
+            f = sign | 0x7f800000 | (mantissa << 13) | (mantissa ? 0x400000 : 0);
+        } else {
+            f = sign | ( (exponent + 127 - 15) << 23 ) | (mantissa << 13);
+        }
+        float ret;
+        std::memcpy( &ret, &f, sizeof(float) );
+
+        return ret;
+    }
+
+    static U16 floatToBits(float value)
+    {
+        U32 f;
+
+        std::memcpy( &f, &value, sizeof(float) );
+        const U32 sign = (f >> 16) & 0x8000;
+        const U32 absf = f & 0x7fffffff;
+
+        if (absf >= 0x7f800000) {
+            // inf or NaN, NaNs are made quiet
+            return (U16)( sign | 0x7c00 | ( absf > 0x7f800000 ? ( 0x200 | ( (absf >> 13) & 0x3ff ) ) : 0 ) );
+        }
+        if (absf >= 0x477ff000) {
+            // 65520 and above round to inf
+            return (U16)(sign | 0x7c00);
+        }
+        if (absf < 0x38800000) {
+            // below the smallest normalized half (2^-14): the result is denormalized or 0
+            if (absf <= 0x33000000) {
+                // 2^-25 and below round to 0
+                return (U16)sign;
+            }
+            const U32 exponent = absf >> 23;
+            const U32 mantissa = (absf & 0x7fffff) | 0x800000;
+            const U32 shift = 126 - exponent;
+            U32 h = mantissa >> shift;
+            const U32 rest = mantissa & ( (1U << shift) - 1 );
+            const U32 halfway = 1U << (shift - 1);
+            if ( (rest > halfway) || ( (rest == halfway) && (h & 1) ) ) {
+                ++h;
+            }
+
+            return (U16)(sign | h);
+        }
+        // rebias the exponent, a carry of the rounding into the exponent is correct
+        U32 h = (absf - ( (U32)(127 - 15) << 23 ) ) >> 13;
+        const U32 rest = absf & 0x1fff;
+        if ( (rest > 0x1000) || ( (rest == 0x1000) && (h & 1) ) ) {
+            ++h;
+        }
+
+        return (U16)(sign | h);
+    }
+
+private:
+
+    U16 _bits;
+};
+
+/**
+ * @brief Converts count halfs to floats. src and dst must not overlap.
+ **/
+void convertHalfToFloat(const Half* src, float* dst, std::size_t count);
+
+/**
+ * @brief Converts count floats to halfs, rounding to the nearest half. src and dst must not overlap.
+ **/
+void convertFloatToHalf(const float* src, Half* dst, std::size_t count);
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_HALF_H
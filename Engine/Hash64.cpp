@@ -25,46 +25,85 @@
 
 #include "Hash64.h"
 
-#include <algorithm>  // for std::for_each
 #include <cassert>
+#include <cstring> // memcpy
 #include <stdexcept>
 
-#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
-#include <boost/crc.hpp>
-#endif
 #include <QtCore/QString>
 
-#include "Engine/Node.h"
-
 NATRON_NAMESPACE_ENTER
 
+static U64
+mergeRound(U64 acc,
+           U64 lane)
+{
+    // Same as Hash64::mixRound with a null accumulator
+    lane *= NATRON_HASH64_PRIME_2;
+    lane = (lane << 31) | (lane >> 33);
+    lane *= NATRON_HASH64_PRIME_1;
+    acc ^= lane;
+
+    return acc * NATRON_HASH64_PRIME_1 + NATRON_HASH64_PRIME_4;
+}
+
 void
 Hash64::computeHash()
 {
-    if ( node_values.empty() ) {
+    if (count == 0) {
         return;
     }
 
-    const unsigned char* data = reinterpret_cast<const unsigned char*>( &node_values.front() );
-    boost::crc_optimal<64, 0x42F0E1EBA9EA3693ULL, 0, 0, false, false> crc_64;
-    crc_64 = std::for_each( data, data + node_values.size() * sizeof(node_values[0]), crc_64 );
-    hash = crc_64();
+    // The lanes are left untouched so that more values may be appended and the hash computed again
+    U64 h = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18);
+    for (int i = 0; i < 4; ++i) {
+        h = mergeRound(h, lanes[i]);
+    }
+    h += count * NATRON_HASH64_PRIME_5;
+
+    // Final avalanche
+    h ^= h >> 33;
+    h *= NATRON_HASH64_PRIME_2;
+    h ^= h >> 29;
+    h *= NATRON_HASH64_PRIME_3;
+    h ^= h >> 32;
+
+    // 0 means invalid
+    hash = h == 0 ? 1 : h;
 }
 
 void
-Hash64::reset()
+Hash64::appendBytes(const void* data,
+                    std::size_t size)
 {
-    node_values.clear();
-    hash = 0;
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    std::size_t nWords = size / sizeof(U64);
+
+    for (std::size_t i = 0; i < nWords; ++i) {
+        U64 word;
+        std::memcpy(&word, bytes + i * sizeof(U64), sizeof(U64));
+        appendU64(word);
+    }
+    std::size_t remainder = size - nWords * sizeof(U64);
+    if (remainder > 0) {
+        U64 word = 0;
+        std::memcpy(&word, bytes + nWords * sizeof(U64), remainder);
+        appendU64(word);
+    }
+    appendU64( (U64)size );
 }
 
 void
 Hash64_appendQString(Hash64* hash,
                      const QString & str)
 {
-    Q_FOREACH (QChar ch, str) {
-        hash->append<unsigned short>( ch.unicode() );
-    }
+    hash->appendBytes( str.utf16(), str.size() * sizeof(ushort) );
+}
+
+void
+Hash64_appendStdString(Hash64* hash,
+                       const std::string & str)
+{
+    hash->appendBytes( str.data(), str.size() );
 }
 
 NATRON_NAMESPACE_EXIT
@@ -28,7 +28,8 @@
 
 #include "Global/Macros.h"
 
-#include <vector>
+#include <cstddef>
+#include <string>
 
 #include "Global/GlobalDefines.h"
 
@@ -36,22 +37,31 @@
 
 NATRON_NAMESPACE_ENTER
 
-/*The hash of a Node is the checksum of the vector of data containing:
+/*The hash of a Node is the checksum of the stream of data containing:
     - the values of the current knob for this node + the name of the node
     - the hash values for the  tree upstream
+ 
+   Values are folded into the hash as they are appended, 64 bits at a time, with the
+   xxHash64 round function over 4 independent lanes so that consecutive appends do not
+   depend on each other. Nothing is stored, so recomputing a hash does not allocate.
  */
 
+#define NATRON_HASH64_PRIME_1 0x9E3779B185EBCA87ULL
+#define NATRON_HASH64_PRIME_2 0xC2B2AE3D27D4EB4FULL
+#define NATRON_HASH64_PRIME_3 0x165667B19E3779F9ULL
+#define NATRON_HASH64_PRIME_4 0x85EBCA77C2B2AE63ULL
+#define NATRON_HASH64_PRIME_5 0x27D4EB2F165667C5ULL
+
 class Hash64
 {
 public:
     Hash64()
     {
-        hash = 0;
+        reset();
     }
 
     ~Hash64()
     {
-        node_values.clear();
     }
 
     U64 value() const
@@ -61,7 +71,15 @@ public:
 
     void computeHash();
 
-    void reset();
+    void reset()
+    {
+        hash = 0;
+        count = 0;
+        lanes[0] = NATRON_HASH64_PRIME_1 + NATRON_HASH64_PRIME_2;
+        lanes[1] = NATRON_HASH64_PRIME_2;
+        lanes[2] = 0;
+        lanes[3] = 0 - NATRON_HASH64_PRIME_1;
+    }
 
     bool valid() const
     {
@@ -82,9 +100,15 @@ public:
     template<typename T>
     void append(T value)
     {
-        node_values.push_back( toU64(value) );
+        appendU64( toU64(value) );
     }
 
+    /**
+     * @brief Appends a buffer of raw bytes, 8 bytes at a time. The last word is padded with zeroes
+     * and the size is appended so that buffers differing only by trailing zeroes do not collide.
+     **/
+    void appendBytes(const void* data, std::size_t size);
+
     bool operator== (const Hash64 & h) const
     {
         return this->hash == h.value();
@@ -111,12 +135,39 @@ private:
         };
     };
 
+    static U64 rotl(U64 x,
+                    int r)
+    {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    static U64 mixRound(U64 acc,
+                        U64 input)
+    {
+        acc += input * NATRON_HASH64_PRIME_2;
+        acc = rotl(acc, 31);
+        acc *= NATRON_HASH64_PRIME_1;
+
+        return acc;
+    }
+
+    void appendU64(U64 value)
+    {
+        U64& lane = lanes[count & 3];
+
+        lane = mixRound(lane, value);
+        ++count;
+    }
+
     U64 hash;
-    std::vector<U64> node_values;
+    U64 lanes[4];
+    U64 count; //< number of 64 bit words appended
 };
 
 void Hash64_appendQString(Hash64* hash, const QString & str);
 
+void Hash64_appendStdString(Hash64* hash, const std::string & str);
+
 NATRON_NAMESPACE_EXIT
 
 #endif // NATRON_ENGINE_Hash64_H
@@ -27,16 +27,24 @@
 
 #include <algorithm>
 #include <cassert>
+#include <functional>
+#include <list>
 #include <stdexcept>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include <QtCore/QMutex>
 #include <QtCore/QWaitCondition>
 
 #ifdef DEBUG
 #include "Global/FloatingPointExceptions.h"
 #endif
+#include "Engine/AppManager.h"
 #include "Engine/Image.h"
 #include "Engine/Smooth1D.h"
+#include "Engine/TaskScheduler.h"
 
 NATRON_NAMESPACE_ENTER
 
@@ -106,6 +114,46 @@ struct FinishedHistogram
 
 typedef std::shared_ptr<FinishedHistogram> FinishedHistogramPtr;
 
+struct HistogramBand
+{
+    RectI rect;
+
+    // true if all the pixels of the band were rendered when it was binned: they will not change anymore
+    bool complete;
+    std::vector<U32> bins[3];
+
+    HistogramBand()
+        : rect()
+        , complete(false)
+    {
+    }
+};
+
+/**
+ * @brief The bins of the last histogram request, per band of NATRON_BITMAP_TILE_SIZE rows. When the viewer updates
+ * the same image, only the bands that were not fully rendered yet need to be binned again.
+ **/
+struct HistogramBandsCache
+{
+    ImageWPtr image;
+    RectI rect;
+    int mode;
+    int binsCount;
+    double vmin, vmax;
+    std::vector<HistogramBand> bands;
+
+    HistogramBandsCache()
+        : image()
+        , rect()
+        , mode(-1)
+        , binsCount(0)
+        , vmin(0)
+        , vmax(0)
+        , bands()
+    {
+    }
+};
+
 struct HistogramCPUPrivate
 {
     QWaitCondition requestCond;
@@ -117,6 +165,9 @@ struct HistogramCPUPrivate
     QMutex mustQuitMutex;
     bool mustQuit;
 
+    // only used by the histogram thread
+    HistogramBandsCache bandsCache;
+
     HistogramCPUPrivate()
         : requestCond()
         , requestMutex()
@@ -126,6 +177,7 @@ struct HistogramCPUPrivate
         , mustQuitCond()
         , mustQuitMutex()
         , mustQuit(false)
+        , bandsCache()
     {
     }
 };
@@ -224,86 +276,268 @@ HistogramCPU::getMostRecentlyProducedHistogram(std::vector<float>* histogram1,
     return true;
 }
 
-///putting these in an anonymous namespace will yield this error on gcc 4.2:
-///"function has not external linkage"
-struct pix_red
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+// The channels binned for each histogram of a mode, -1 being the luminance
+void
+getModeChannels(int mode,
+                int* nHistograms,
+                int channels[3])
 {
-    static float val(const float *pix)
-    {
-        return pix[0];
+    /// keep the mode parameter in sync with Histogram::DisplayModeEnum
+    switch (mode) {
+    case 0:     //< RGB
+        *nHistograms = 3;
+        channels[0] = 0;
+        channels[1] = 1;
+        channels[2] = 2;
+        break;
+    case 1:     //< A
+        *nHistograms = 1;
+        channels[0] = 3;
+        break;
+    case 2:     //< Y
+        *nHistograms = 1;
+        channels[0] = -1;
+        break;
+    case 3:     //< R
+    case 4:     //< G
+    case 5:     //< B
+        *nHistograms = 1;
+        channels[0] = mode - 3;
+        break;
+    default:
+        assert(false);
+        *nHistograms = 0;
+        break;
     }
-};
+}
 
-struct pix_green
+inline float
+luminance(float r,
+          float g,
+          float b)
 {
-    static float val(const float *pix)
-    {
-        return pix[1];
-    }
-};
+    return 0.299f * r + 0.587f * g + 0.114f * b;
+}
 
-struct pix_blue
+// Increments the bin of each value v of nPixels in [vmin, vmax)
+class HistogramBinner
 {
-    static float val(const float *pix)
+public:
+
+    HistogramBinner(int nBins,
+                    double vmin,
+                    double vmax)
+        : _nBins(nBins)
+        , _vmin( (float)vmin )
+        , _vmax( (float)vmax )
+        , _scale( (float)(nBins / (vmax - vmin)) )
+        , _lastBin( (float)(nBins - 1) )
     {
-        return pix[2];
     }
-};
 
-struct pix_alpha
-{
-    static float val(const float *pix)
+    void add(float v,
+             U32* bins) const
     {
-        return pix[3];
+        if ( (_vmin <= v) && (v < _vmax) ) {
+            // the product may round up to nBins for values just below vmax
+            ++bins[(int)std::min( (v - _vmin) * _scale, _lastBin )];
+        }
     }
+
+    void addRow(const float* pix,
+                int nPixels,
+                int nComps,
+                int nHistograms,
+                const int channels[3],
+                U32* bins[3]) const;
+
+private:
+
+    int _nBins;
+    float _vmin, _vmax, _scale, _lastBin;
 };
 
-struct pix_lum
+void
+HistogramBinner::addRow(const float* pix,
+                        int nPixels,
+                        int nComps,
+                        int nHistograms,
+                        const int channels[3],
+                        U32* bins[3]) const
 {
-    static float val(const float *pix)
-    {
-        return 0.299 * pix[0] + 0.587 * pix[1] + 0.114 * pix[2];
+    int x = 0;
+
+#ifdef __SSE2__
+    if (nComps == 4) {
+        // The bins are computed 4 pixels at a time, only the increments are scalar
+        const __m128 vmin = _mm_set1_ps(_vmin);
+        const __m128 vmax = _mm_set1_ps(_vmax);
+        const __m128 scale = _mm_set1_ps(_scale);
+        const __m128 lastBin = _mm_set1_ps(_lastBin);
+        const __m128 zero = _mm_setzero_ps();
+        for (; x + 4 <= nPixels; x += 4, pix += 16) {
+            __m128 c[4] = { _mm_loadu_ps(pix), _mm_loadu_ps(pix + 4), _mm_loadu_ps(pix + 8), _mm_loadu_ps(pix + 12) };
+            _MM_TRANSPOSE4_PS(c[0], c[1], c[2], c[3]);
+            for (int h = 0; h < nHistograms; ++h) {
+                __m128 v;
+                if (channels[h] < 0) {
+                    v = _mm_add_ps( _mm_add_ps( _mm_mul_ps( c[0], _mm_set1_ps(0.299f) ), _mm_mul_ps( c[1], _mm_set1_ps(0.587f) ) ),
+                                    _mm_mul_ps( c[2], _mm_set1_ps(0.114f) ) );
+                } else {
+                    v = c[channels[h]];
+                }
+                // NaNs fail both comparisons
+                const int inRange = _mm_movemask_ps( _mm_and_ps( _mm_cmpge_ps(v, vmin), _mm_cmplt_ps(v, vmax) ) );
+                if (!inRange) {
+                    continue;
+                }
+                // The index of the lanes out of range is computed too: clamp it to a valid bin, which gets a zero increment.
+                // _mm_max_ps returns its second operand for NaNs.
+                const __m128i idx = _mm_cvttps_epi32( _mm_min_ps( _mm_max_ps( _mm_mul_ps( _mm_sub_ps(v, vmin), scale ), zero ), lastBin ) );
+                // the indices are read before incrementing, since the bins may alias them
+                const int i0 = _mm_cvtsi128_si32(idx);
+                const int i1 = _mm_cvtsi128_si32( _mm_shuffle_epi32(idx, 1) );
+                const int i2 = _mm_cvtsi128_si32( _mm_shuffle_epi32(idx, 2) );
+                const int i3 = _mm_cvtsi128_si32( _mm_shuffle_epi32(idx, 3) );
+                U32* histoBins = bins[h];
+                if (inRange == 0xf) {
+                    ++histoBins[i0];
+                    ++histoBins[i1];
+                    ++histoBins[i2];
+                    ++histoBins[i3];
+                } else {
+                    histoBins[i0] += inRange & 1;
+                    histoBins[i1] += (inRange >> 1) & 1;
+                    histoBins[i2] += (inRange >> 2) & 1;
+                    histoBins[i3] += (inRange >> 3) & 1;
+                }
+            }
+        }
     }
-};
+#endif
 
+    for (; x < nPixels; ++x, pix += nComps) {
+        for (int h = 0; h < nHistograms; ++h) {
+            float v;
+            if (channels[h] < 0) {
+                v = nComps >= 3 ? luminance(pix[0], pix[1], pix[2]) : pix[0];
+            } else if (nComps == 1) {
+                v = pix[0];
+            } else if (channels[h] < nComps) {
+                v = pix[channels[h]];
+            } else {
+                // opaque if there is no alpha
+                v = channels[h] == 3 ? 1.f : 0.f;
+            }
+            add(v, bins[h]);
+        }
+    }
+} // HistogramBinner::addRow
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
 
-template <float pix_func(const float*)>
 void
-computeHisto(const HistogramRequest & request,
-             int upscale,
-             std::vector<float> *histo)
+HistogramCPU::binPixels(const Image* image,
+                        const RectI& rect,
+                        int mode,
+                        int binsCount,
+                        double vmin,
+                        double vmax,
+                        U32* bins[3])
 {
-    assert(histo);
-    histo->resize(request.binsCount * upscale);
-    std::fill(histo->begin(), histo->end(), 0.f);
-    double binSize = (request.vmax - request.vmin) / histo->size();
-
     ///Images come from the viewer which is in float.
-    assert(request.image->getBitDepth() == eImageBitDepthFloat);
-
-    Image::ReadAccess acc = request.image->getReadRights();
-
-    for (int y = request.rect.bottom(); y < request.rect.top(); ++y) {
-        for (int x = request.rect.left(); x < request.rect.right(); ++x) {
-            const float *pix = (const float*)acc.pixelAt(x, y);
-            float v = pix_func(pix);
-            if ( (request.vmin <= v) && (v < request.vmax) ) {
-                int index = (int)( (v - request.vmin) / binSize );
-                assert( 0 <= index && index < (int)histo->size() );
-                (*histo)[index] += 1.f;
-            }
-        }
+    assert(image->getBitDepth() == eImageBitDepthFloat);
+    assert(vmax > vmin);
+
+    int nHistograms = 0;
+    int channels[3];
+    getModeChannels(mode, &nHistograms, channels);
+
+    const RectI roi = rect.intersect( image->getBounds() );
+    if ( roi.isNull() ) {
+        return;
+    }
+    const HistogramBinner binner(binsCount, vmin, vmax);
+    const int nComps = (int)image->getComponentsCount();
+    Image::ReadAccess acc = image->getReadRights();
+    for (int y = roi.y1; y < roi.y2; ++y) {
+        binner.addRow( (const float*)acc.pixelAt(roi.x1, y), roi.width(), nComps, nHistograms, channels, bins );
     }
 }
 
+static void
+binHistogramBands(const HistogramRequest & request,
+                  int binsCount,
+                  HistogramBandsCache* cache)
+{
+    const RectI rect = request.rect.intersect( request.image->getBounds() );
+    const bool reuseBands = ( cache->image.lock() == request.image && cache->rect == rect && cache->mode == request.mode &&
+                              cache->binsCount == binsCount && cache->vmin == request.vmin && cache->vmax == request.vmax );
+
+    if (!reuseBands) {
+        cache->image = request.image;
+        cache->rect = rect;
+        cache->mode = request.mode;
+        cache->binsCount = binsCount;
+        cache->vmin = request.vmin;
+        cache->vmax = request.vmax;
+        cache->bands.clear();
+        // the bands are aligned on the tiles of the bitmap
+        for (int y = rect.y1; y < rect.y2; ) {
+            const int y2 = std::min( ( (y >> NATRON_BITMAP_TILE_SIZE_LOG2) + 1 ) << NATRON_BITMAP_TILE_SIZE_LOG2, rect.y2 );
+            HistogramBand band;
+            band.rect = RectI(rect.x1, y, rect.x2, y2);
+            cache->bands.push_back(band);
+            y = y2;
+        }
+    }
 
+    int nHistograms = 0;
+    int channels[3];
+    getModeChannels(request.mode, &nHistograms, channels);
+
+    std::vector<int> dirtyBands;
+    for (std::size_t i = 0; i < cache->bands.size(); ++i) {
+        if (!cache->bands[i].complete) {
+            dirtyBands.push_back( (int)i );
+        }
+    }
+
+    // Each band has its own bins, which are merged by the caller
+    const Image* image = request.image.get();
+    std::function<void(int)> binBand = [&](int i) {
+        HistogramBand& band = cache->bands[dirtyBands[i]];
+        U32* bins[3] = { 0, 0, 0 };
+        for (int h = 0; h < nHistograms; ++h) {
+            band.bins[h].assign(binsCount, 0);
+            bins[h] = &band.bins[h].front();
+        }
+        // Check the render state before binning: pixels rendered in between are binned again next time
+        std::list<RectI> restToRender;
+        image->getRestToRender(band.rect, restToRender);
+        band.complete = image->usesBitMap() && restToRender.empty();
+        HistogramCPU::binPixels(image, band.rect, request.mode, binsCount, request.vmin, request.vmax, bins);
+    };
+
+    TaskScheduler* scheduler = appPTR ? appPTR->getTaskScheduler() : NULL;
+    if ( scheduler && (dirtyBands.size() > 1) ) {
+        scheduler->parallelFor( (int)dirtyBands.size(), binBand );
+    } else {
+        for (std::size_t i = 0; i < dirtyBands.size(); ++i) {
+            binBand( (int)i );
+        }
+    }
+} // binHistogramBands
 
 static void
 computeHistogramStatic(const HistogramRequest & request,
+                       const HistogramBandsCache & cache,
+                       int upscale,
                        FinishedHistogramPtr ret,
                        int histogramIndex)
 {
-    const int upscale = 5;
     std::vector<float> *histo = 0;
 
     switch (histogramIndex) {
@@ -324,38 +558,16 @@ computeHistogramStatic(const HistogramRequest & request,
         return;
     }
 
-    /// keep the mode parameter in sync with Histogram::DisplayModeEnum
-
-    int mode = request.mode;
-
-    ///if the mode is RGB, adjust the mode to either R,G or B depending on the histogram index
-    if (mode == 0) {
-        mode = histogramIndex + 2;
-    }
-
     ret->pixelsCount = request.rect.area();
-    // a histogram with upscale more bins
-    std::vector<float> histo_upscaled;
-    switch (mode) {
-    case 1:     //< A
-        computeHisto<&pix_alpha::val>(request, upscale, &histo_upscaled);
-        break;
-    case 2:     //<Y
-        computeHisto<&pix_lum::val>(request, upscale, &histo_upscaled);
-        break;
-    case 3:     //< R
-        computeHisto<&pix_red::val>(request, upscale, &histo_upscaled);
-        break;
-    case 4:     //< G
-        computeHisto<&pix_green::val>(request, upscale, &histo_upscaled);
-        break;
-    case 5:     //< B
-        computeHisto<&pix_blue::val>(request, upscale, &histo_upscaled);
-        break;
 
-    default:
-        assert(false);
-        break;
+    // a histogram with upscale more bins: merge the bins of all bands
+    std::vector<float> histo_upscaled(request.binsCount * upscale, 0.f);
+    for (std::size_t i = 0; i < cache.bands.size(); ++i) {
+        const std::vector<U32>& bins = cache.bands[i].bins[histogramIndex - 1];
+        assert( bins.size() == histo_upscaled.size() );
+        for (std::size_t j = 0; j < bins.size(); ++j) {
+            histo_upscaled[j] += (float)bins[j];
+        }
     }
     double sigma = upscale;
     if (request.smoothingKernelSize > 1) {
@@ -420,18 +632,22 @@ HistogramCPU::run()
         ret->mipmapLevel = request.image->getMipmapLevel();
 
 
+        ///All the histograms of the mode are binned in a single pass over the image
+        const int upscale = 5;
+        binHistogramBands(request, request.binsCount * upscale, &_imp->bandsCache);
+
         switch (request.mode) {
         case 0:     //< RGB
-            computeHistogramStatic(request, ret, 1);
-            computeHistogramStatic(request, ret, 2);
-            computeHistogramStatic(request, ret, 3);
+            computeHistogramStatic(request, _imp->bandsCache, upscale, ret, 1);
+            computeHistogramStatic(request, _imp->bandsCache, upscale, ret, 2);
+            computeHistogramStatic(request, _imp->bandsCache, upscale, ret, 3);
             break;
         case 1:
         case 2:
         case 3:
         case 4:
         case 5:
-            computeHistogramStatic(request, ret, 1);
+            computeHistogramStatic(request, _imp->bandsCache, upscale, ret, 1);
             break;
         default:
             assert(false);     //< unknown case.
@@ -32,6 +32,7 @@
 
 #include <QtCore/QThread>
 
+#include "Global/GlobalDefines.h"
 #include "Engine/EngineFwd.h"
 
 NATRON_NAMESPACE_ENTER
@@ -79,6 +80,19 @@ public:
 
     void quitAnyComputation();
 
+    /**
+     * @brief Adds to bins the number of pixels of rect in the float image whose value falls in each of the binsCount
+     * bins between vmin and vmax. The mode corresponds to the enum Histogram::DisplayModeEnum: bins must hold
+     * 3 arrays of binsCount values for RGB, 1 otherwise. All the channels of the mode are binned in a single pass.
+     **/
+    static void binPixels(const Image* image,
+                          const RectI& rect,
+                          int mode,
+                          int binsCount,
+                          double vmin,
+                          double vmax,
+                          U32* bins[3]);
+
 Q_SIGNALS:
 
     void histogramProduced();
@@ -25,10 +25,17 @@
 
 #include "Image.h"
 
-#include <algorithm> // min, max
+#include <algorithm> // min, max, fill
 #include <cassert>
 #include <cstring> // for std::memcpy, std::memset
+#include <functional>
 #include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include <QtCore/QDebug>
 
@@ -37,166 +44,334 @@
 #include "Engine/GPUContextPool.h"
 #include "Engine/OSGLContext.h"
 #include "Engine/GLShader.h"
+#include "Engine/TaskScheduler.h"
 
 NATRON_NAMESPACE_ENTER
 
-#define BM_GET(i, j) (&_map[( i - _bounds.bottom() ) * _bounds.width() + ( j - _bounds.left() )])
-
 #define PIXEL_UNAVAILABLE 2
 
-template <int trimap>
+// The flags returned by Bitmap::getRowFlags() and Bitmap::getColumnFlags(): (1 << state) for each state met
+#define BITMAP_HAS_NOT_RENDERED 1
+#define BITMAP_HAS_RENDERED 2
+#define BITMAP_HAS_UNAVAILABLE 4
+#define BITMAP_HAS_ALL 7
+
+Bitmap::Bitmap(const RectI & bounds)
+    : _bounds()
+    , _nTilesX(0)
+    , _nTilesY(0)
+    , _tiles()
+    , _tilePixels()
+    , _dirtyZone()
+    , _dirtyZoneSet(false)
+{
+    //Do not assert !rod.isNull() : An empty image can be created for entries that correspond to
+    // "identities" images (i.e: images that are just a link to another image). See EffectInstance :
+    // "!!!Note that if isIdentity is true it will allocate an empty image object with 0 bytes of data."
+    //assert(!rod.isNull());
+    initialize(bounds);
+}
+
+Bitmap::Bitmap()
+    : _bounds()
+    , _nTilesX(0)
+    , _nTilesY(0)
+    , _tiles()
+    , _tilePixels()
+    , _dirtyZone()
+    , _dirtyZoneSet(false)
+{
+    std::fill(_nTilesPerState, _nTilesPerState + 4, 0);
+}
+
+Bitmap::~Bitmap()
+{
+}
+
+void
+Bitmap::initialize(const RectI & bounds)
+{
+    _bounds = bounds;
+    if ( bounds.isNull() ) {
+        _nTilesX = 0;
+        _nTilesY = 0;
+    } else {
+        _nTilesX = (bounds.width() + NATRON_BITMAP_TILE_SIZE - 1) >> NATRON_BITMAP_TILE_SIZE_LOG2;
+        _nTilesY = (bounds.height() + NATRON_BITMAP_TILE_SIZE - 1) >> NATRON_BITMAP_TILE_SIZE_LOG2;
+    }
+    std::size_t nTiles = (std::size_t)_nTilesX * _nTilesY;
+    _tiles.assign(nTiles, 0);
+    _tilePixels.clear();
+    _tilePixels.resize(nTiles);
+    std::fill(_nTilesPerState, _nTilesPerState + 4, 0);
+    _nTilesPerState[0] = (int)nTiles;
+}
+
+void
+Bitmap::setTo1()
+{
+    std::size_t nTiles = _tiles.size();
+
+    _tiles.assign(nTiles, 1);
+    _tilePixels.clear();
+    _tilePixels.resize(nTiles);
+    std::fill(_nTilesPerState, _nTilesPerState + 4, 0);
+    _nTilesPerState[1] = (int)nTiles;
+}
+
+std::size_t
+Bitmap::getMemorySize() const
+{
+    return _tiles.size() * ( sizeof(char) + sizeof(std::unique_ptr<char[]>) );
+}
+
 RectI
-minimalNonMarkedBbox_internal(const RectI& roi,
-                              const RectI& _bounds,
-                              const std::vector<char>& _map,
-                              bool* isBeingRenderedElsewhere)
+Bitmap::getTileRect(int tx,
+                    int ty) const
 {
-    RectI bbox;
+    int x1 = _bounds.x1 + (tx << NATRON_BITMAP_TILE_SIZE_LOG2);
+    int y1 = _bounds.y1 + (ty << NATRON_BITMAP_TILE_SIZE_LOG2);
 
-    assert( _bounds.contains(roi) );
-    bbox = roi;
+    return RectI( x1, y1, std::min(x1 + NATRON_BITMAP_TILE_SIZE, _bounds.x2), std::min(y1 + NATRON_BITMAP_TILE_SIZE, _bounds.y2) );
+}
 
-    //find bottom
-    for (int i = bbox.bottom(); i < bbox.top(); ++i) {
-        const char* buf = BM_GET( i, bbox.left() );
-
-        if (trimap) {
-            const char* lineEnd = buf + bbox.width();
-            bool metUnavailablePixel = false;
-            while (buf < lineEnd) {
-                if (!*buf) {
-                    buf = 0;
-                    break;
-                } else if (*buf == PIXEL_UNAVAILABLE) {
-                    metUnavailablePixel = true;
-                }
-                ++buf;
-            }
-            if (!buf) {
-                break;
-            } else if (metUnavailablePixel) {
-                *isBeingRenderedElsewhere = true; //< only flag if the whole row is not 0
-                ++bbox.y1;
-            } else {
-                ++bbox.y1;
+char*
+Bitmap::getTilePixels(int tile)
+{
+    char state = _tiles[tile];
+
+    if (state != eTileStateMixed) {
+        if (!_tilePixels[tile]) {
+            _tilePixels[tile].reset(new char[NATRON_BITMAP_TILE_SIZE * NATRON_BITMAP_TILE_SIZE]);
+        }
+        std::memset(_tilePixels[tile].get(), state, NATRON_BITMAP_TILE_SIZE * NATRON_BITMAP_TILE_SIZE);
+        --_nTilesPerState[(int)state];
+        ++_nTilesPerState[eTileStateMixed];
+        _tiles[tile] = eTileStateMixed;
+    }
+
+    return _tilePixels[tile].get();
+}
+
+void
+Bitmap::setTileState(int tile,
+                     char state)
+{
+    assert(state != eTileStateMixed);
+    --_nTilesPerState[(int)_tiles[tile]];
+    ++_nTilesPerState[(int)state];
+    _tiles[tile] = state;
+    _tilePixels[tile].reset();
+}
+
+void
+Bitmap::collapseTile(int tile,
+                     const RectI& tileRect)
+{
+    if (_tiles[tile] != eTileStateMixed) {
+        return;
+    }
+    const char* pixels = _tilePixels[tile].get();
+    const char state = pixels[0];
+    const int w = tileRect.width();
+    for (int y = tileRect.y1; y < tileRect.y2; ++y, pixels += NATRON_BITMAP_TILE_SIZE) {
+        for (int x = 0; x < w; ++x) {
+            if (pixels[x] != state) {
+                return;
             }
+        }
+    }
+    setTileState(tile, state);
+}
+
+void
+Bitmap::collapseTiles(const RectI& roi)
+{
+    const RectI r = roi.intersect(_bounds);
+
+    if ( r.isNull() ) {
+        return;
+    }
+    const int tx1 = (r.x1 - _bounds.x1) >> NATRON_BITMAP_TILE_SIZE_LOG2;
+    const int tx2 = (r.x2 - 1 - _bounds.x1) >> NATRON_BITMAP_TILE_SIZE_LOG2;
+    const int ty1 = (r.y1 - _bounds.y1) >> NATRON_BITMAP_TILE_SIZE_LOG2;
+    const int ty2 = (r.y2 - 1 - _bounds.y1) >> NATRON_BITMAP_TILE_SIZE_LOG2;
+    for (int ty = ty1; ty <= ty2; ++ty) {
+        for (int tx = tx1; tx <= tx2; ++tx) {
+            collapseTile( ty * _nTilesX + tx, getTileRect(tx, ty) );
+        }
+    }
+}
+
+/**
+ * @brief Returns the states met in the row y in [x1, x2). nRows is set to the number of rows, starting at y and going upwards
+ * or downwards, that are guaranteed to return the same flags: all the rows of a tile are the same if none of the tiles is mixed.
+ **/
+int
+Bitmap::getRowFlags(int y,
+                    int x1,
+                    int x2,
+                    bool upwards,
+                    int* nRows) const
+{
+    assert(_bounds.y1 <= y && y < _bounds.y2 && _bounds.x1 <= x1 && x1 < x2 && x2 <= _bounds.x2);
+    const int ty = (y - _bounds.y1) >> NATRON_BITMAP_TILE_SIZE_LOG2;
+    const int tileY1 = _bounds.y1 + (ty << NATRON_BITMAP_TILE_SIZE_LOG2);
+    const int tileY2 = std::min(tileY1 + NATRON_BITMAP_TILE_SIZE, _bounds.y2);
+    const int tx1 = (x1 - _bounds.x1) >> NATRON_BITMAP_TILE_SIZE_LOG2;
+    const int tx2 = (x2 - 1 - _bounds.x1) >> NATRON_BITMAP_TILE_SIZE_LOG2;
+    int flags = 0;
+    bool mixed = false;
+
+    for (int tx = tx1; tx <= tx2; ++tx) {
+        const int tile = ty * _nTilesX + tx;
+        const char state = _tiles[tile];
+        if (state != eTileStateMixed) {
+            flags |= 1 << state;
         } else {
-            const char* lineEnd = buf + bbox.width();
-            while (buf < lineEnd) {
-                if ( !*buf || (*buf == PIXEL_UNAVAILABLE) ) {
-                    buf = 0;
-                    break;
-                }
-                ++buf;
-            }
-            if (!buf) {
-                break;
-            } else {
-                ++bbox.y1;
+            mixed = true;
+            const int tileX1 = _bounds.x1 + (tx << NATRON_BITMAP_TILE_SIZE_LOG2);
+            const int segX1 = std::max(x1, tileX1);
+            const int segX2 = std::min(x2, tileX1 + NATRON_BITMAP_TILE_SIZE);
+            const char* pix = _tilePixels[tile].get() + ( (y - tileY1) << NATRON_BITMAP_TILE_SIZE_LOG2 ) + (segX1 - tileX1);
+            const char* end = pix + (segX2 - segX1);
+            for (; pix < end; ++pix) {
+                flags |= 1 << *pix;
             }
         }
+        if (flags == BITMAP_HAS_ALL) {
+            // No caller goes further
+            mixed = true;
+            break;
+        }
     }
+    *nRows = mixed ? 1 : (upwards ? tileY2 - y : y - tileY1 + 1);
 
-    //find top (will do zero iteration if the bbox is already empty)
-    for (int i = bbox.top() - 1; i >= bbox.bottom(); --i) {
-        const char* buf = BM_GET( i, bbox.left() );
-
-        if (trimap) {
-            const char* lineEnd = buf + bbox.width();
-            bool metUnavailablePixel = false;
-            while (buf < lineEnd) {
-                if (!*buf) {
-                    buf = 0;
-                    break;
-                } else if (*buf == PIXEL_UNAVAILABLE) {
-                    metUnavailablePixel = true;
-                }
-                ++buf;
-            }
-            if (!buf) {
-                break;
-            } else if (metUnavailablePixel) {
-                *isBeingRenderedElsewhere = true; //< only flag if the whole row is not 0
-                --bbox.y2;
-            } else {
-                --bbox.y2;
-            }
+    return flags;
+}
+
+/**
+ * @brief Same as getRowFlags() for the column x in [y1, y2).
+ **/
+int
+Bitmap::getColumnFlags(int x,
+                       int y1,
+                       int y2,
+                       bool rightwards,
+                       int* nColumns) const
+{
+    assert(_bounds.x1 <= x && x < _bounds.x2 && _bounds.y1 <= y1 && y1 < y2 && y2 <= _bounds.y2);
+    const int tx = (x - _bounds.x1) >> NATRON_BITMAP_TILE_SIZE_LOG2;
+    const int tileX1 = _bounds.x1 + (tx << NATRON_BITMAP_TILE_SIZE_LOG2);
+    const int tileX2 = std::min(tileX1 + NATRON_BITMAP_TILE_SIZE, _bounds.x2);
+    const int ty1 = (y1 - _bounds.y1) >> NATRON_BITMAP_TILE_SIZE_LOG2;
+    const int ty2 = (y2 - 1 - _bounds.y1) >> NATRON_BITMAP_TILE_SIZE_LOG2;
+    int flags = 0;
+    bool mixed = false;
+
+    for (int ty = ty1; ty <= ty2; ++ty) {
+        const int tile = ty * _nTilesX + tx;
+        const char state = _tiles[tile];
+        if (state != eTileStateMixed) {
+            flags |= 1 << state;
         } else {
-            const char* lineEnd = buf + bbox.width();
-            while (buf < lineEnd) {
-                if ( !*buf || (*buf == PIXEL_UNAVAILABLE) ) {
-                    buf = 0;
-                    break;
-                }
-                ++buf;
-            }
-            if (!buf) {
-                break;
-            } else {
-                --bbox.y2;
+            mixed = true;
+            const int tileY1 = _bounds.y1 + (ty << NATRON_BITMAP_TILE_SIZE_LOG2);
+            const int segY1 = std::max(y1, tileY1);
+            const int segY2 = std::min(y2, tileY1 + NATRON_BITMAP_TILE_SIZE);
+            const char* pix = _tilePixels[tile].get() + ( (segY1 - tileY1) << NATRON_BITMAP_TILE_SIZE_LOG2 ) + (x - tileX1);
+            for (int y = segY1; y < segY2; ++y, pix += NATRON_BITMAP_TILE_SIZE) {
+                flags |= 1 << *pix;
             }
         }
+        if (flags == BITMAP_HAS_ALL) {
+            mixed = true;
+            break;
+        }
     }
+    *nColumns = mixed ? 1 : (rightwards ? tileX2 - x : x - tileX1 + 1);
 
-    // avoid making bbox.width() iterations for nothing
+    return flags;
+}
+
+template <int trimap>
+RectI
+Bitmap::minimalNonMarkedBbox_internal(const RectI& roi,
+                                      bool* isBeingRenderedElsewhere) const
+{
+    RectI bbox;
+
+    assert( _bounds.contains(roi) );
+    bbox = roi;
     if ( bbox.isNull() ) {
         return bbox;
     }
 
-    //find left
-    for (int j = bbox.left(); j < bbox.right(); ++j) {
-        const char* pix = BM_GET(bbox.bottom(), j);
-        bool metUnavailablePixel = false;
+    const int nTiles = (int)_tiles.size();
+    if (_nTilesPerState[0] == nTiles) {
+        // nothing is rendered
+        return bbox;
+    } else if (_nTilesPerState[1] == nTiles) {
+        // everything is rendered
+        return RectI();
+    }
 
-        for ( int i = bbox.bottom(); i < bbox.top(); ++i, pix += _bounds.width() ) {
-            if (!*pix) {
-                pix = 0;
-                break;
-            } else if (*pix == PIXEL_UNAVAILABLE) {
-                if (trimap) {
-                    metUnavailablePixel = true;
-                } else {
-                    pix = 0;
-                    break;
-                }
-            }
+    // A row or column is stripped off the bounding box if it has no pixel to render. With the trimap, pixels being
+    // rendered elsewhere need not be rendered, but the caller has to wait for them.
+    const int toRenderMask = trimap ? BITMAP_HAS_NOT_RENDERED : (BITMAP_HAS_NOT_RENDERED | BITMAP_HAS_UNAVAILABLE);
+    int n;
+
+    //find bottom
+    while ( bbox.bottom() < bbox.top() ) {
+        int flags = getRowFlags(bbox.bottom(), bbox.left(), bbox.right(), true, &n);
+        if (flags & toRenderMask) {
+            break;
         }
-        if (pix) {
-            ++bbox.x1;
-            if (trimap && metUnavailablePixel) {
-                *isBeingRenderedElsewhere = true; //< only flag is the whole column is not 0
-            }
-        } else {
+        if ( trimap && (flags & BITMAP_HAS_UNAVAILABLE) ) {
+            *isBeingRenderedElsewhere = true; //< only flag if the whole row is not 0
+        }
+        bbox.y1 = std::min(bbox.y1 + n, bbox.y2);
+    }
+
+    //find top (will do zero iteration if the bbox is already empty)
+    while ( bbox.bottom() < bbox.top() ) {
+        int flags = getRowFlags(bbox.top() - 1, bbox.left(), bbox.right(), false, &n);
+        if (flags & toRenderMask) {
             break;
         }
+        if ( trimap && (flags & BITMAP_HAS_UNAVAILABLE) ) {
+            *isBeingRenderedElsewhere = true;
+        }
+        bbox.y2 = std::max(bbox.y2 - n, bbox.y1);
     }
 
-    //find right
-    for (int j = bbox.right() - 1; j >= bbox.left(); --j) {
-        const char* pix = BM_GET(bbox.bottom(), j);
-        bool metUnavailablePixel = false;
+    // avoid making bbox.width() iterations for nothing
+    if ( bbox.isNull() ) {
+        return bbox;
+    }
 
-        for ( int i = bbox.bottom(); i < bbox.top(); ++i, pix += _bounds.width() ) {
-            if (!*pix) {
-                pix = 0;
-                break;
-            } else if (*pix == PIXEL_UNAVAILABLE) {
-                if (trimap) {
-                    metUnavailablePixel = true;
-                } else {
-                    pix = 0;
-                    break;
-                }
-            }
+    //find left
+    while ( bbox.left() < bbox.right() ) {
+        int flags = getColumnFlags(bbox.left(), bbox.bottom(), bbox.top(), true, &n);
+        if (flags & toRenderMask) {
+            break;
         }
-        if (pix) {
-            --bbox.x2;
-            if (trimap && metUnavailablePixel) {
-                *isBeingRenderedElsewhere = true; //< only flag is the whole column is not 0
-            }
-        } else {
+        if ( trimap && (flags & BITMAP_HAS_UNAVAILABLE) ) {
+            *isBeingRenderedElsewhere = true; //< only flag is the whole column is not 0
+        }
+        bbox.x1 = std::min(bbox.x1 + n, bbox.x2);
+    }
+
+    //find right
+    while ( bbox.left() < bbox.right() ) {
+        int flags = getColumnFlags(bbox.right() - 1, bbox.bottom(), bbox.top(), false, &n);
+        if (flags & toRenderMask) {
             break;
         }
+        if ( trimap && (flags & BITMAP_HAS_UNAVAILABLE) ) {
+            *isBeingRenderedElsewhere = true;
+        }
+        bbox.x2 = std::max(bbox.x2 - n, bbox.x1);
     }
 
     return bbox;
@@ -205,11 +380,9 @@ minimalNonMarkedBbox_internal(const RectI& roi,
 
 template <int trimap>
 void
-minimalNonMarkedRects_internal(const RectI & roi,
-                               const RectI& _bounds,
-                               const std::vector<char>& _map,
-                               std::list<RectI>& ret,
-                               bool* isBeingRenderedElsewhere)
+Bitmap::minimalNonMarkedRects_internal(const RectI & roi,
+                                       std::list<RectI>& ret,
+                                       bool* isBeingRenderedElsewhere) const
 {
     assert(ret.empty());
     ///Any out of bounds portion is pushed to the rectangles to render
@@ -243,7 +416,7 @@ minimalNonMarkedRects_internal(const RectI & roi,
         return;
     }
 
-    RectI bboxM = minimalNonMarkedBbox_internal<trimap>(intersection, _bounds, _map, isBeingRenderedElsewhere);
+    RectI bboxM = minimalNonMarkedBbox_internal<trimap>(intersection, isBeingRenderedElsewhere);
     assert( (trimap && isBeingRenderedElsewhere) || (!trimap && !isBeingRenderedElsewhere) );
 
     //#define NATRON_BITMAP_DISABLE_OPTIMIZATION
@@ -277,44 +450,26 @@ minimalNonMarkedRects_internal(const RectI & roi,
     // CXXXXXXXXXXDDD
     // AAAAAAAAAAAAAA
 
+    // A row or column belongs to A, B, C or D if it has no rendered pixel. With the trimap, it must not have pixels
+    // being rendered elsewhere either.
+    const int renderedMask = trimap ? (BITMAP_HAS_RENDERED | BITMAP_HAS_UNAVAILABLE) : BITMAP_HAS_RENDERED;
+    int n;
+
     // First, find if there's an "A" rectangle, and push it to the result
     //find bottom
     RectI bboxX = bboxM;
     RectI bboxA = bboxX;
     bboxA.set_top( bboxX.bottom() );
-    for (int i = bboxX.bottom(); i < bboxX.top(); ++i) {
-        const char* buf = BM_GET( i, bboxX.left() );
-        if (trimap) {
-            const char* lineEnd = buf + bboxX.width();
-            bool metUnavailablePixel = false;
-            while (buf < lineEnd) {
-                if (*buf == 1) {
-                    buf = 0;
-                    break;
-                } else if ( (*buf == PIXEL_UNAVAILABLE) && trimap ) {
-                    buf = 0;
-                    metUnavailablePixel = true;
-                    break;
-                }
-                ++buf;
-            }
-            if (buf) {
-                ++bboxX.y1;
-                bboxA.y2 = bboxX.y1;
-            } else {
-                if (metUnavailablePixel) {
-                    *isBeingRenderedElsewhere = true;
-                }
-                break;
-            }
-        } else {
-            if ( !memchr( buf, 1, bboxX.width() ) ) {
-                ++bboxX.y1;
-                bboxA.y2 = bboxX.y1;
-            } else {
-                break;
+    while ( bboxX.bottom() < bboxX.top() ) {
+        int flags = getRowFlags(bboxX.bottom(), bboxX.left(), bboxX.right(), true, &n);
+        if (flags & renderedMask) {
+            if ( trimap && (flags & BITMAP_HAS_UNAVAILABLE) ) {
+                *isBeingRenderedElsewhere = true;
             }
+            break;
         }
+        bboxX.y1 = std::min(bboxX.y1 + n, bboxX.y2);
+        bboxA.y2 = bboxX.y1;
     }
     if ( !bboxA.isNull() ) { // empty boxes should not be pushed
         ret.push_back(bboxA);
@@ -324,40 +479,16 @@ minimalNonMarkedRects_internal(const RectI & roi,
     //find top
     RectI bboxB = bboxX;
     bboxB.set_bottom( bboxX.top() );
-    for (int i = bboxX.top() - 1; i >= bboxX.bottom(); --i) {
-        const char* buf = BM_GET( i, bboxX.left() );
-
-        if (trimap) {
-            const char* lineEnd = buf + bboxX.width();
-            bool metUnavailablePixel = false;
-            while (buf < lineEnd) {
-                if (*buf == 1) {
-                    buf = 0;
-                    break;
-                } else if ( (*buf == PIXEL_UNAVAILABLE) && trimap ) {
-                    buf = 0;
-                    metUnavailablePixel = true;
-                    break;
-                }
-                ++buf;
-            }
-            if (buf) {
-                --bboxX.y2;
-                bboxB.y1 = bboxX.y2;
-            } else {
-                if (metUnavailablePixel) {
-                    *isBeingRenderedElsewhere = true;
-                }
-                break;
-            }
-        } else {
-            if ( !memchr( buf, 1, bboxX.width() ) ) {
-                --bboxX.y2;
-                bboxB.y1 = bboxX.y2;
-            } else {
-                break;
+    while ( bboxX.bottom() < bboxX.top() ) {
+        int flags = getRowFlags(bboxX.top() - 1, bboxX.left(), bboxX.right(), false, &n);
+        if (flags & renderedMask) {
+            if ( trimap && (flags & BITMAP_HAS_UNAVAILABLE) ) {
+                *isBeingRenderedElsewhere = true;
             }
+            break;
         }
+        bboxX.y2 = std::max(bboxX.y2 - n, bboxX.y1);
+        bboxB.y1 = bboxX.y2;
     }
     if ( !bboxB.isNull() ) { // empty boxes should not be pushed
         ret.push_back(bboxB);
@@ -367,29 +498,16 @@ minimalNonMarkedRects_internal(const RectI & roi,
     RectI bboxC = bboxX;
     bboxC.set_right( bboxX.left() );
     if ( bboxX.bottom() < bboxX.top() ) {
-        for (int j = bboxX.left(); j < bboxX.right(); ++j) {
-            const char* pix = BM_GET(bboxX.bottom(), j);
-            bool metUnavailablePixel = false;
-
-            for ( int i = bboxX.bottom(); i < bboxX.top(); ++i, pix += _bounds.width() ) {
-                if (*pix == 1) {
-                    pix = 0;
-                    break;
-                } else if ( trimap && (*pix == PIXEL_UNAVAILABLE) ) {
-                    pix = 0;
-                    metUnavailablePixel = true;
-                    break;
-                }
-            }
-            if (pix) {
-                ++bboxX.x1;
-                bboxC.x2 = bboxX.x1;
-            } else {
-                if (metUnavailablePixel) {
+        while ( bboxX.left() < bboxX.right() ) {
+            int flags = getColumnFlags(bboxX.left(), bboxX.bottom(), bboxX.top(), true, &n);
+            if (flags & renderedMask) {
+                if ( trimap && (flags & BITMAP_HAS_UNAVAILABLE) ) {
                     *isBeingRenderedElsewhere = true;
                 }
                 break;
             }
+            bboxX.x1 = std::min(bboxX.x1 + n, bboxX.x2);
+            bboxC.x2 = bboxX.x1;
         }
     }
     if ( !bboxC.isNull() ) { // empty boxes should not be pushed
@@ -400,29 +518,16 @@ minimalNonMarkedRects_internal(const RectI & roi,
     RectI bboxD = bboxX;
     bboxD.set_left( bboxX.right() );
     if ( bboxX.bottom() < bboxX.top() ) {
-        for (int j = bboxX.right() - 1; j >= bboxX.left(); --j) {
-            const char* pix = BM_GET(bboxX.bottom(), j);
-            bool metUnavailablePixel = false;
-
-            for ( int i = bboxX.bottom(); i < bboxX.top(); ++i, pix += _bounds.width() ) {
-                if (*pix == 1) {
-                    pix = 0;
-                    break;
-                } else if ( trimap && (*pix == PIXEL_UNAVAILABLE) ) {
-                    pix = 0;
-                    metUnavailablePixel = true;
-                    break;
-                }
-            }
-            if (pix) {
-                --bboxX.x2;
-                bboxD.x1 = bboxX.x2;
-            } else {
-                if (metUnavailablePixel) {
+        while ( bboxX.left() < bboxX.right() ) {
+            int flags = getColumnFlags(bboxX.right() - 1, bboxX.bottom(), bboxX.top(), false, &n);
+            if (flags & renderedMask) {
+                if ( trimap && (flags & BITMAP_HAS_UNAVAILABLE) ) {
                     *isBeingRenderedElsewhere = true;
                 }
                 break;
             }
+            bboxX.x2 = std::max(bboxX.x2 - n, bboxX.x1);
+            bboxD.x1 = bboxX.x2;
         }
     }
     if ( !bboxD.isNull() ) { // empty boxes should not be pushed
@@ -450,7 +555,7 @@ minimalNonMarkedRects_internal(const RectI & roi,
     assert( bboxD.bottom() == bboxX.bottom() );
 
     // get the bounding box of what's left (the X rectangle in the drawing above)
-    bboxX = minimalNonMarkedBbox_internal<trimap>(bboxX, _bounds, _map, isBeingRenderedElsewhere);
+    bboxX = minimalNonMarkedBbox_internal<trimap>(bboxX, isBeingRenderedElsewhere);
 
     if ( !bboxX.isNull() ) { // empty boxes should not be pushed
         ret.push_back(bboxX);
@@ -467,7 +572,7 @@ Bitmap::minimalNonMarkedBbox(const RectI & roi) const
         return RectI();
     }
 
-    return minimalNonMarkedBbox_internal<0>(realRoi, _bounds, _map, NULL);
+    return minimalNonMarkedBbox_internal<0>(realRoi, NULL);
 }
 
 void
@@ -478,7 +583,7 @@ Bitmap::minimalNonMarkedRects(const RectI & roi,
     if (_dirtyZoneSet && !realRoi.clipIfOverlaps(_dirtyZone)) {
         return;
     }
-    minimalNonMarkedRects_internal<0>(realRoi, _bounds, _map, ret, NULL);
+    minimalNonMarkedRects_internal<0>(realRoi, ret, NULL);
 }
 
 #if NATRON_ENABLE_TRIMAP
@@ -492,7 +597,7 @@ Bitmap::minimalNonMarkedBbox_trimap(const RectI & roi,
         return RectI();
     }
 
-    return minimalNonMarkedBbox_internal<1>(realRoi, _bounds, _map, isBeingRenderedElsewhere);
+    return minimalNonMarkedBbox_internal<1>(realRoi, isBeingRenderedElsewhere);
 }
 
 void
@@ -505,7 +610,7 @@ Bitmap::minimalNonMarkedRects_trimap(const RectI & roi,
         *isBeingRenderedElsewhere = false;
         return;
     }
-    minimalNonMarkedRects_internal<1>(realRoi, _bounds, _map, ret, isBeingRenderedElsewhere);
+    minimalNonMarkedRects_internal<1>(realRoi, ret, isBeingRenderedElsewhere);
 }
 
 #endif
@@ -513,39 +618,53 @@ Bitmap::minimalNonMarkedRects_trimap(const RectI & roi,
 void
 Bitmap::markFor(const RectI & roi, char value)
 {
-    int x1 = std::max(roi.x1, _bounds.x1);
-    int y1 = std::max(roi.y1, _bounds.y1);
-    int x2 = std::min(roi.x2, _bounds.x2);
-    int y2 = std::min(roi.y2, _bounds.y2);
-
-    char* buf = BM_GET(y1, x1);
-    int w = _bounds.width();
-    int roiw = x2 - x1;
+    const RectI r = roi.intersect(_bounds);
 
-    for (int i = y1; i < y2; ++i, buf += w) {
-        std::memset( buf, value, roiw);
+    if ( r.isNull() ) {
+        return;
+    }
+    const int tx1 = (r.x1 - _bounds.x1) >> NATRON_BITMAP_TILE_SIZE_LOG2;
+    const int tx2 = (r.x2 - 1 - _bounds.x1) >> NATRON_BITMAP_TILE_SIZE_LOG2;
+    const int ty1 = (r.y1 - _bounds.y1) >> NATRON_BITMAP_TILE_SIZE_LOG2;
+    const int ty2 = (r.y2 - 1 - _bounds.y1) >> NATRON_BITMAP_TILE_SIZE_LOG2;
+    for (int ty = ty1; ty <= ty2; ++ty) {
+        for (int tx = tx1; tx <= tx2; ++tx) {
+            const int tile = ty * _nTilesX + tx;
+            const RectI tileRect = getTileRect(tx, ty);
+            if ( r.contains(tileRect) ) {
+                setTileState(tile, value);
+                continue;
+            }
+            if (_tiles[tile] == value) {
+                continue;
+            }
+            // Only part of the tile is marked: store the state of each pixel
+            const RectI seg = r.intersect(tileRect);
+            char* pix = getTilePixels(tile) + ( (seg.y1 - tileRect.y1) << NATRON_BITMAP_TILE_SIZE_LOG2 ) + (seg.x1 - tileRect.x1);
+            for (int y = seg.y1; y < seg.y2; ++y, pix += NATRON_BITMAP_TILE_SIZE) {
+                std::memset( pix, value, seg.width() );
+            }
+            collapseTile(tile, tileRect);
+        }
     }
 }
 
 bool
 Bitmap::isNonMarked(const RectI & roi) const
 {
-    int x1 = std::max(roi.x1, _bounds.x1);
-    int y1 = std::max(roi.y1, _bounds.y1);
-    int x2 = std::min(roi.x2, _bounds.x2);
-    int y2 = std::min(roi.y2, _bounds.y2);
-
-    const char* buf = BM_GET(y1, x1);
-    int w = _bounds.width();
-    int roiw = x2 - x1;
+    const RectI r = roi.intersect(_bounds);
 
-    for (int i = y1; i < y2; ++i, buf += w) {
-        for (int j = 0; j < roiw; ++j) {
-            if (buf[j]) {
-                return false;
-            }
+    if ( r.isNull() || (_nTilesPerState[0] == (int)_tiles.size()) ) {
+        return true;
+    }
+    for (int y = r.y1; y < r.y2; ) {
+        int n;
+        if (getRowFlags(y, r.x1, r.x2, true, &n) != BITMAP_HAS_NOT_RENDERED) {
+            return false;
         }
+        y += n;
     }
+
     return true;
 }
 
@@ -561,32 +680,168 @@ Bitmap::markForRendering(const RectI & roi)
 void
 Bitmap::swap(Bitmap& other)
 {
-    _map.swap(other._map);
-    _bounds = other._bounds;
+    std::swap(_bounds, other._bounds);
+    std::swap(_nTilesX, other._nTilesX);
+    std::swap(_nTilesY, other._nTilesY);
+    _tiles.swap(other._tiles);
+    _tilePixels.swap(other._tilePixels);
+    std::swap_ranges(_nTilesPerState, _nTilesPerState + 4, other._nTilesPerState);
     _dirtyZone.clear(); //merge(other._dirtyZone);
     _dirtyZoneSet = false;
 }
 
-const char*
-Bitmap::getBitmapAt(int x,
-                    int y) const
+void
+Bitmap::getRow(int y,
+               int x1,
+               int x2,
+               char* buf) const
 {
-    if ( ( x >= _bounds.left() ) && ( x < _bounds.right() ) && ( y >= _bounds.bottom() ) && ( y < _bounds.top() ) ) {
-        return BM_GET(y, x);
-    } else {
-        return NULL;
+    assert(_bounds.y1 <= y && y < _bounds.y2 && _bounds.x1 <= x1 && x2 <= _bounds.x2);
+    if (x1 >= x2) {
+        return;
+    }
+    const int ty = (y - _bounds.y1) >> NATRON_BITMAP_TILE_SIZE_LOG2;
+    const int tileY1 = _bounds.y1 + (ty << NATRON_BITMAP_TILE_SIZE_LOG2);
+    const int tx1 = (x1 - _bounds.x1) >> NATRON_BITMAP_TILE_SIZE_LOG2;
+    const int tx2 = (x2 - 1 - _bounds.x1) >> NATRON_BITMAP_TILE_SIZE_LOG2;
+    for (int tx = tx1; tx <= tx2; ++tx) {
+        const int tile = ty * _nTilesX + tx;
+        const int tileX1 = _bounds.x1 + (tx << NATRON_BITMAP_TILE_SIZE_LOG2);
+        const int segX1 = std::max(x1, tileX1);
+        const int segX2 = std::min(x2, tileX1 + NATRON_BITMAP_TILE_SIZE);
+        if (_tiles[tile] != eTileStateMixed) {
+            std::memset(buf + (segX1 - x1), _tiles[tile], segX2 - segX1);
+        } else {
+            std::memcpy(buf + (segX1 - x1), _tilePixels[tile].get() + ( (y - tileY1) << NATRON_BITMAP_TILE_SIZE_LOG2 ) + (segX1 - tileX1), segX2 - segX1);
+        }
     }
 }
 
-char*
-Bitmap::getBitmapAt(int x,
-                    int y)
+void
+Bitmap::setRow(int y,
+               int x1,
+               int x2,
+               const char* buf)
 {
-    if ( ( x >= _bounds.left() ) && ( x < _bounds.right() ) && ( y >= _bounds.bottom() ) && ( y < _bounds.top() ) ) {
-        return BM_GET(y, x);
-    } else {
-        return NULL;
+    assert(_bounds.y1 <= y && y < _bounds.y2 && _bounds.x1 <= x1 && x2 <= _bounds.x2);
+    if (x1 >= x2) {
+        return;
+    }
+    const int ty = (y - _bounds.y1) >> NATRON_BITMAP_TILE_SIZE_LOG2;
+    const int tileY1 = _bounds.y1 + (ty << NATRON_BITMAP_TILE_SIZE_LOG2);
+    const int tx1 = (x1 - _bounds.x1) >> NATRON_BITMAP_TILE_SIZE_LOG2;
+    const int tx2 = (x2 - 1 - _bounds.x1) >> NATRON_BITMAP_TILE_SIZE_LOG2;
+    for (int tx = tx1; tx <= tx2; ++tx) {
+        const int tile = ty * _nTilesX + tx;
+        const int tileX1 = _bounds.x1 + (tx << NATRON_BITMAP_TILE_SIZE_LOG2);
+        const int segX1 = std::max(x1, tileX1);
+        const int segX2 = std::min(x2, tileX1 + NATRON_BITMAP_TILE_SIZE);
+        const char* src = buf + (segX1 - x1);
+        const char state = _tiles[tile];
+        if (state != eTileStateMixed) {
+            const char* end = src + (segX2 - segX1);
+            const char* it = src;
+            while (it < end && *it == state) {
+                ++it;
+            }
+            if (it == end) {
+                // nothing changes
+                continue;
+            }
+        }
+        std::memcpy(getTilePixels(tile) + ( (y - tileY1) << NATRON_BITMAP_TILE_SIZE_LOG2 ) + (segX1 - tileX1), src, segX2 - segX1);
+    }
+}
+
+void
+Bitmap::copyBitmapPortion(const RectI& roi,
+                          const Bitmap& other)
+{
+    assert(roi.x1 >= _bounds.x1 && roi.x2 <= _bounds.x2 && roi.y1 >= _bounds.y1 && roi.y2 <= _bounds.y2);
+    assert(roi.x1 >= other._bounds.x1 && roi.x2 <= other._bounds.x2 && roi.y1 >= other._bounds.y1 && roi.y2 <= other._bounds.y2);
+
+    if ( roi.isNull() ) {
+        return;
+    }
+
+    // When the tiles of both bitmaps are aligned, the tiles that are entirely in the roi are copied as a whole
+    const bool tilesAligned = ( ( (other._bounds.x1 - _bounds.x1) & (NATRON_BITMAP_TILE_SIZE - 1) ) == 0 ) &&
+                              ( ( (other._bounds.y1 - _bounds.y1) & (NATRON_BITMAP_TILE_SIZE - 1) ) == 0 );
+    std::vector<char> row( roi.width() );
+    const int tx1 = (roi.x1 - _bounds.x1) >> NATRON_BITMAP_TILE_SIZE_LOG2;
+    const int tx2 = (roi.x2 - 1 - _bounds.x1) >> NATRON_BITMAP_TILE_SIZE_LOG2;
+    const int ty1 = (roi.y1 - _bounds.y1) >> NATRON_BITMAP_TILE_SIZE_LOG2;
+    const int ty2 = (roi.y2 - 1 - _bounds.y1) >> NATRON_BITMAP_TILE_SIZE_LOG2;
+    for (int ty = ty1; ty <= ty2; ++ty) {
+        for (int tx = tx1; tx <= tx2; ++tx) {
+            const int tile = ty * _nTilesX + tx;
+            const RectI tileRect = getTileRect(tx, ty);
+            const RectI seg = roi.intersect(tileRect);
+            if ( tilesAligned && (seg == tileRect) ) {
+                const int otherTile = ( (tileRect.y1 - other._bounds.y1) >> NATRON_BITMAP_TILE_SIZE_LOG2 ) * other._nTilesX +
+                                      ( (tileRect.x1 - other._bounds.x1) >> NATRON_BITMAP_TILE_SIZE_LOG2 );
+                const char otherState = other._tiles[otherTile];
+                if (otherState != eTileStateMixed) {
+                    setTileState(tile, otherState);
+                } else {
+                    // The pixels of both tiles have the same layout
+                    std::memcpy(getTilePixels(tile), other._tilePixels[otherTile].get(), NATRON_BITMAP_TILE_SIZE * NATRON_BITMAP_TILE_SIZE);
+                }
+            } else {
+                for (int y = seg.y1; y < seg.y2; ++y) {
+                    other.getRow(y, seg.x1, seg.x2, &row.front());
+                    setRow(y, seg.x1, seg.x2, &row.front());
+                }
+            }
+            collapseTile(tile, tileRect);
+        }
+    }
+}
+
+void
+Bitmap::halveFrom(const Bitmap& src,
+                  const RectI& dstRoI)
+{
+    downscaleFrom(src, src._bounds, 1, dstRoI);
+}
+
+void
+Bitmap::downscaleFrom(const Bitmap& src,
+                      const RectI& srcRoI,
+                      unsigned int levels,
+                      const RectI& dstRoI)
+{
+    if ( dstRoI.isNull() ) {
+        return;
+    }
+    assert( _bounds.contains(dstRoI) );
+
+    // Only the src pixels that are both in srcRoI and covered by dstRoI count.
+    // Pixels out of the bounds of src are considered rendered so that they do not count.
+    const RectI srcRect = srcRoI.intersect(src._bounds);
+    const int srcX1 = std::max(srcRect.x1, dstRoI.x1 << levels);
+    const int srcX2 = std::min(srcRect.x2, dstRoI.x2 << levels);
+    const int w = dstRoI.width();
+    std::vector<char> srcRow( std::max(srcX2 - srcX1, 1) );
+    std::vector<char> dstRow(w);
+
+    for (int y = dstRoI.y1; y < dstRoI.y2; ++y) {
+        std::fill(dstRow.begin(), dstRow.end(), 1);
+        const int srcY1 = std::max(srcRect.y1, y << levels);
+        const int srcY2 = std::min(srcRect.y2, (y + 1) << levels);
+        for (int srcy = srcY1; srcy < srcY2 && srcX1 < srcX2; ++srcy) {
+            src.getRow(srcy, srcX1, srcX2, &srcRow.front());
+            for (int x = srcX1; x < srcX2; ++x) {
+                // Pixels being rendered are considered not rendered, otherwise the caller would have to wait for the
+                // original fullscale image render to be finished and then re-downscale again.
+                if (srcRow[x - srcX1] != 1) {
+                    dstRow[(x >> levels) - dstRoI.x1] = 0;
+                }
+            }
+        }
+        setRow(y, dstRoI.x1, dstRoI.x2, &dstRow.front());
     }
+    collapseTiles(dstRoI);
 }
 
 #ifdef DEBUG
@@ -597,9 +852,11 @@ Image::printUnrenderedPixels(const RectI& roi) const
         return;
     }
     QReadLocker k(&_entryLock);
-    const char* bm = _bitmap.getBitmapAt(roi.x1, roi.y1);
-    int roiw = roi.x2 - roi.x1;
-    int boundsW = _bitmap.getBounds().width();
+    const RectI r = roi.intersect( _bitmap.getBounds() );
+    if ( r.isNull() ) {
+        return;
+    }
+    std::vector<char> row( r.width() );
     RectD bboxUnrendered;
     bboxUnrendered.setupInfinity();
     RectD bboxUnavailable;
@@ -608,9 +865,10 @@ Image::printUnrenderedPixels(const RectI& roi) const
     bool hasUnrendered = false;
     bool hasUnavailable = false;
 
-    for ( int y = roi.y1; y < roi.y2; ++y,
-          bm += (boundsW - roiw) ) {
-        for (int x = roi.x1; x < roi.x2; ++x, ++bm) {
+    for (int y = r.y1; y < r.y2; ++y) {
+        _bitmap.getRow(y, r.x1, r.x2, &row.front());
+        const char* bm = &row.front();
+        for (int x = r.x1; x < r.x2; ++x, ++bm) {
             if (*bm == 0) {
                 if (x < bboxUnrendered.x1) {
                     bboxUnrendered.x1 = x;
@@ -889,7 +1147,7 @@ Image::pasteFromForDepth(const Image & srcImg,
     ///Cannot copy images with different bit depth, this is not the purpose of this function.
     ///@see convert
     assert( getBitDepth() == srcImg.getBitDepth() );
-    assert( (getBitDepth() == eImageBitDepthByte && sizeof(PIX) == 1) || (getBitDepth() == eImageBitDepthShort && sizeof(PIX) == 2) || (getBitDepth() == eImageBitDepthFloat && sizeof(PIX) == 4) );
+    assert( (getBitDepth() == eImageBitDepthByte && sizeof(PIX) == 1) || (getBitDepth() == eImageBitDepthShort && sizeof(PIX) == 2) || (getBitDepth() == eImageBitDepthHalf && sizeof(PIX) == 2) || (getBitDepth() == eImageBitDepthFloat && sizeof(PIX) == 4) );
     // NOTE: before removing the following asserts, please explain why an empty image may happen
 
     QWriteLocker k(&_entryLock);
@@ -1027,9 +1285,7 @@ Image::resizeInternal(const Image* srcImg,
             std::size_t memsize = a * pixelSize;
             std::memset(pix, 0, memsize);
             if ( setBitmapTo1 && (*outputImage)->usesBitMap() ) {
-                char* bm = wacc.bitmapAt(aRect.x1, aRect.y1);
-                assert(bm);
-                std::memset(bm, 1, a);
+                (*outputImage)->_bitmap.markForRendered(aRect);
             }
         }
         if ( !cRect.isNull() ) {
@@ -1039,9 +1295,7 @@ Image::resizeInternal(const Image* srcImg,
             std::size_t memsize = a * pixelSize;
             std::memset(pix, 0, memsize);
             if ( setBitmapTo1 && (*outputImage)->usesBitMap() ) {
-                char* bm = (char*)wacc.bitmapAt(cRect.x1, cRect.y1);
-                assert(bm);
-                std::memset(bm, 1, a);
+                (*outputImage)->_bitmap.markForRendered(cRect);
             }
         }
         if ( !bRect.isNull() ) {
@@ -1051,13 +1305,11 @@ Image::resizeInternal(const Image* srcImg,
             std::size_t rowsize = mw * pixelSize;
             int bw = bRect.width();
             std::size_t rectRowSize = bw * pixelSize;
-            char* bm = ( setBitmapTo1 && (*outputImage)->usesBitMap() ) ? wacc.bitmapAt(bRect.x1, bRect.y1) : 0;
             for (int y = bRect.y1; y < bRect.y2; ++y, pix += rowsize) {
                 std::memset(pix, 0, rectRowSize);
-                if (bm) {
-                    std::memset(bm, 1, bw);
-                    bm += mw;
-                }
+            }
+            if ( setBitmapTo1 && (*outputImage)->usesBitMap() ) {
+                (*outputImage)->_bitmap.markForRendered(bRect);
             }
         }
         if ( !dRect.isNull() ) {
@@ -1067,13 +1319,11 @@ Image::resizeInternal(const Image* srcImg,
             std::size_t rowsize = mw * pixelSize;
             int dw = dRect.width();
             std::size_t rectRowSize = dw * pixelSize;
-            char* bm = ( setBitmapTo1 && (*outputImage)->usesBitMap() ) ? wacc.bitmapAt(dRect.x1, dRect.y1) : 0;
             for (int y = dRect.y1; y < dRect.y2; ++y, pix += rowsize) {
                 std::memset(pix, 0, rectRowSize);
-                if (bm) {
-                    std::memset(bm, 1, dw);
-                    bm += mw;
-                }
+            }
+            if ( setBitmapTo1 && (*outputImage)->usesBitMap() ) {
+                (*outputImage)->_bitmap.markForRendered(dRect);
             }
         }
     } // fillWithBlackAndTransparent
@@ -1087,7 +1337,7 @@ Image::resizeInternal(const Image* srcImg,
         (*outputImage)->pasteFromForDepth<unsigned short>(*srcImg, srcBounds, srcImg->usesBitMap(), false);
         break;
     case eImageBitDepthHalf:
-        assert(false);
+        (*outputImage)->pasteFromForDepth<Half>(*srcImg, srcBounds, srcImg->usesBitMap(), false);
         break;
     case eImageBitDepthFloat:
         (*outputImage)->pasteFromForDepth<float>(*srcImg, srcBounds, srcImg->usesBitMap(), false);
@@ -1364,7 +1614,7 @@ Image::pasteFrom(const Image & src,
             pasteFromForDepth<unsigned short>(src, srcRoi, copyBitmap, true);
             break;
         case eImageBitDepthHalf:
-            assert(false);
+            pasteFromForDepth<Half>(src, srcRoi, copyBitmap, true);
             break;
         case eImageBitDepthFloat:
             pasteFromForDepth<float>(src, srcRoi, copyBitmap, true);
@@ -1383,7 +1633,7 @@ Image::fillForDepthForComponents(const RectI & roi_,
                                  float b,
                                  float a)
 {
-    assert( (getBitDepth() == eImageBitDepthByte && sizeof(PIX) == 1) || (getBitDepth() == eImageBitDepthShort && sizeof(PIX) == 2) || (getBitDepth() == eImageBitDepthFloat && sizeof(PIX) == 4) );
+    assert( (getBitDepth() == eImageBitDepthByte && sizeof(PIX) == 1) || (getBitDepth() == eImageBitDepthShort && sizeof(PIX) == 2) || (getBitDepth() == eImageBitDepthHalf && sizeof(PIX) == 2) || (getBitDepth() == eImageBitDepthFloat && sizeof(PIX) == 4) );
 
     RectI roi = roi_;
     if (!roi.clipIfOverlaps(_bounds)) {
@@ -1501,7 +1751,7 @@ Image::fill(const RectI & roi,
         fillForDepth<unsigned short, 65535>(roi, r, g, b, a);
         break;
     case eImageBitDepthHalf:
-        assert(false);
+        fillForDepth<Half, 1>(roi, r, g, b, a);
         break;
     case eImageBitDepthFloat:
         fillForDepth<float, 1>(roi, r, g, b, a);
@@ -1538,7 +1788,7 @@ Image::fillZero(const RectI& roi,
         rowSize *= sizeof(unsigned short);
         break;
     case eImageBitDepthHalf:
-        rowSize *= sizeof(unsigned short);
+        rowSize *= sizeof(Half);
         break;
     case eImageBitDepthFloat:
         rowSize *= sizeof(float);
@@ -1578,7 +1828,7 @@ Image::fillBoundsZero(const OSGLContextPtr& glContext)
         rowSize *= sizeof(unsigned short);
         break;
     case eImageBitDepthHalf:
-        rowSize *= sizeof(unsigned short);
+        rowSize *= sizeof(Half);
         break;
     case eImageBitDepthFloat:
         rowSize *= sizeof(float);
@@ -1781,280 +2031,350 @@ Image::getRowElements() const
     return getComponentsCount() * _bounds.width();
 }
 
-// code proofread and fixed by @devernay on 4/12/2014
-template <typename PIX, int maxValue>
+// The box filter of the mipmaps: each pixel of a level is the average of the pixels of the 2x2 block of the
+// previous level that it covers, counting only the pixels inside the previous level.
+// Integer pixels are averaged with an integer division, as the other integer processing of Natron does.
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+// Averages a block of 1 or 2 columns of the rows r0 and r1 (r1 may be NULL) into dst.
+template <typename PIX>
+inline void
+averageBlock(const PIX* r0,
+             const PIX* r1,
+             int nCols,
+             int nComps,
+             PIX* dst)
+{
+    const int sum = nCols * (r1 ? 2 : 1);
+
+    for (int k = 0; k < nComps; ++k) {
+        ///a b
+        ///c d
+        decltype(PIX() + PIX()) v = r0[k];
+        if (nCols == 2) {
+            v = v + r0[k + nComps];
+        }
+        if (r1) {
+            v = v + r1[k];
+            if (nCols == 2) {
+                v = v + r1[k + nComps];
+            }
+        }
+        dst[k] = PIX(v / sum);
+    }
+}
+
+// Averages n full 2x2 blocks of the rows r0 and r1 into dst. Overloaded below with SSE2 versions.
+template <typename PIX>
 void
-Image::halveRoIForDepth(const RectI & roi,
-                        bool copyBitMap,
-                        Image* output) const
-{
-    assert( (getBitDepth() == eImageBitDepthByte && sizeof(PIX) == 1) ||
-            (getBitDepth() == eImageBitDepthShort && sizeof(PIX) == 2) ||
-            (getBitDepth() == eImageBitDepthFloat && sizeof(PIX) == 4) );
+halveBlocks(const PIX* r0,
+            const PIX* r1,
+            int n,
+            int nComps,
+            PIX* dst)
+{
+    for (int x = 0; x < n; ++x, r0 += 2 * nComps, r1 += 2 * nComps, dst += nComps) {
+        for (int k = 0; k < nComps; ++k) {
+            dst[k] = PIX( (r0[k] + r0[k + nComps] + r1[k] + r1[k + nComps]) / 4 );
+        }
+    }
+}
 
-    ///handle case where there is only 1 column/row
-    if ( (roi.width() == 1) || (roi.height() == 1) ) {
-        assert( !(roi.width() == 1 && roi.height() == 1) ); /// can't be 1x1
-        halve1DImage(roi, output);
+#ifdef __SSE2__
+// Same as the scalar version, including the order of the additions, so that the result is the same.
+void
+halveBlocks(const float* r0,
+            const float* r1,
+            int n,
+            int nComps,
+            float* dst)
+{
+    int x = 0;
+    const __m128 quarter = _mm_set1_ps(0.25f);
+
+    if (nComps == 4) {
+        for (; x < n; ++x, r0 += 8, r1 += 8, dst += 4) {
+            __m128 v = _mm_add_ps( _mm_loadu_ps(r0), _mm_loadu_ps(r0 + 4) );
+            v = _mm_add_ps( v, _mm_loadu_ps(r1) );
+            v = _mm_add_ps( v, _mm_loadu_ps(r1 + 4) );
+            _mm_storeu_ps( dst, _mm_mul_ps(v, quarter) );
+        }
+    } else if (nComps == 1) {
+        for (; x + 4 <= n; x += 4, r0 += 8, r1 += 8, dst += 4) {
+            const __m128 a0 = _mm_loadu_ps(r0);
+            const __m128 a1 = _mm_loadu_ps(r0 + 4);
+            const __m128 b0 = _mm_loadu_ps(r1);
+            const __m128 b1 = _mm_loadu_ps(r1 + 4);
+            __m128 v = _mm_add_ps( _mm_shuffle_ps( a0, a1, _MM_SHUFFLE(2, 0, 2, 0) ), _mm_shuffle_ps( a0, a1, _MM_SHUFFLE(3, 1, 3, 1) ) );
+            v = _mm_add_ps( v, _mm_shuffle_ps( b0, b1, _MM_SHUFFLE(2, 0, 2, 0) ) );
+            v = _mm_add_ps( v, _mm_shuffle_ps( b0, b1, _MM_SHUFFLE(3, 1, 3, 1) ) );
+            _mm_storeu_ps( dst, _mm_mul_ps(v, quarter) );
+        }
+    }
+    halveBlocks<float>(r0, r1, n - x, nComps, dst);
+}
 
-        return;
+void
+halveBlocks(const unsigned char* r0,
+            const unsigned char* r1,
+            int n,
+            int nComps,
+            unsigned char* dst)
+{
+    int x = 0;
+    const __m128i zero = _mm_setzero_si128();
+
+    if (nComps == 4) {
+        // 4 pixels of each row per iteration, widened to 16 bits
+        for (; x + 2 <= n; x += 2, r0 += 16, r1 += 16, dst += 8) {
+            const __m128i a = _mm_loadu_si128( (const __m128i*)r0 );
+            const __m128i b = _mm_loadu_si128( (const __m128i*)r1 );
+            const __m128i lo = _mm_add_epi16( _mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero) ); // pixels 0 and 1
+            const __m128i hi = _mm_add_epi16( _mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero) ); // pixels 2 and 3
+            __m128i v = _mm_add_epi16( _mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi) );
+            v = _mm_srli_epi16(v, 2);
+            _mm_storel_epi64( (__m128i*)dst, _mm_packus_epi16(v, v) );
+        }
+    } else if (nComps == 1) {
+        const __m128i lowBytes = _mm_set1_epi16(0xff);
+        for (; x + 8 <= n; x += 8, r0 += 16, r1 += 16, dst += 8) {
+            const __m128i a = _mm_loadu_si128( (const __m128i*)r0 );
+            const __m128i b = _mm_loadu_si128( (const __m128i*)r1 );
+            __m128i v = _mm_add_epi16( _mm_and_si128(a, lowBytes), _mm_srli_epi16(a, 8) );
+            v = _mm_add_epi16( v, _mm_and_si128(b, lowBytes) );
+            v = _mm_add_epi16( v, _mm_srli_epi16(b, 8) );
+            v = _mm_srli_epi16(v, 2);
+            _mm_storel_epi64( (__m128i*)dst, _mm_packus_epi16(v, v) );
+        }
     }
+    halveBlocks<unsigned char>(r0, r1, n - x, nComps, dst);
+}
+#endif // __SSE2__
 
-    /// Take the lock for both bitmaps since we're about to read/write from them!
-    QWriteLocker k1(&output->_entryLock);
-    QReadLocker k2(&_entryLock);
+// Halves the rows r0 and r1 (r1 may be NULL if there is a single row in the source) which span the columns
+// [srcX1, srcX2) into dst, which spans the columns [srcX1 >> 1, (srcX2 + 1) >> 1).
+template <typename PIX>
+void
+halveRows(const PIX* r0,
+          const PIX* r1,
+          int srcX1,
+          int srcX2,
+          int nComps,
+          PIX* dst)
+{
+    if (srcX1 & 1) {
+        // the first dst pixel only covers srcX1
+        averageBlock<PIX>(r0, r1, 1, nComps, dst);
+        r0 += nComps;
+        if (r1) {
+            r1 += nComps;
+        }
+        dst += nComps;
+    }
+    const int nBlocks = (srcX2 >> 1) - ( (srcX1 + 1) >> 1 );
+    if (r1) {
+        halveBlocks(r0, r1, nBlocks, nComps, dst);
+    } else {
+        for (int x = 0; x < nBlocks; ++x) {
+            averageBlock<PIX>(r0 + 2 * nComps * x, NULL, 2, nComps, dst + nComps * x);
+        }
+    }
+    if (srcX2 & 1) {
+        // the last dst pixel only covers srcX2 - 1
+        r0 += 2 * nComps * nBlocks;
+        if (r1) {
+            r1 += 2 * nComps * nBlocks;
+        }
+        averageBlock<PIX>(r0, r1, 1, nComps, dst + nComps * nBlocks);
+    }
+}
 
-    ///The source rectangle, intersected to this image region of definition in pixels
-    const RectI &srcBounds = _bounds;
-    const RectI &dstBounds = output->_bounds;
-    const RectI &srcBmBounds = _bitmap.getBounds();
-    const RectI &dstBmBounds = output->_bitmap.getBounds();
-    assert( !copyBitMap || usesBitMap() );
-    assert( !usesBitMap() || (srcBmBounds == srcBounds && dstBmBounds == dstBounds) );
-
-    // the srcRoD of the output should be enclosed in half the roi.
-    // It does not have to be exactly half of the input.
-    //    assert(dstRoD.x1*2 >= roi.x1 &&
-    //           dstRoD.x2*2 <= roi.x2 &&
-    //           dstRoD.y1*2 >= roi.y1 &&
-    //           dstRoD.y2*2 <= roi.y2 &&
-    //           dstRoD.width()*2 <= roi.width() &&
-    //           dstRoD.height()*2 <= roi.height());
-    assert( getComponents() == output->getComponents() );
-
-    RectI dstRoI;
-    RectI srcRoI = roi;
-    srcRoI.clipIfOverlaps(srcBounds); // intersect srcRoI with the region of definition
-#ifdef DEBUG_NAN
-    assert(!checkForNaNsNoLock(srcRoI));
-#endif
-    dstRoI.x1 = (srcRoI.x1 + 1) / 2; // equivalent to ceil(srcRoI.x1/2.0)
-    dstRoI.y1 = (srcRoI.y1 + 1) / 2; // equivalent to ceil(srcRoI.y1/2.0)
-    dstRoI.x2 = srcRoI.x2 / 2; // equivalent to floor(srcRoI.x2/2.0)
-    dstRoI.y2 = srcRoI.y2 / 2; // equivalent to floor(srcRoI.y2/2.0)
-
-
-    const PIX* const srcPixels      = (const PIX*)pixelAt(srcBounds.x1,   srcBounds.y1);
-    const char* const srcBmPixels   = _bitmap.getBitmapAt(srcBmBounds.x1, srcBmBounds.y1);
-    PIX* const dstPixels          = (PIX*)output->pixelAt(dstBounds.x1,   dstBounds.y1);
-    char* const dstBmPixels = output->_bitmap.getBitmapAt(dstBmBounds.x1, dstBmBounds.y1);
-    int srcRowSize = srcBounds.width() * _nbComponents;
-    int dstRowSize = dstBounds.width() * _nbComponents;
-
-    // offset pointers so that srcData and dstData correspond to pixel (0,0)
-    const PIX* const srcData = srcPixels - (srcBounds.x1 * _nbComponents + srcRowSize * srcBounds.y1);
-    PIX* const dstData       = dstPixels - (dstBounds.x1 * _nbComponents + dstRowSize * dstBounds.y1);
-    const int srcBmRowSize = srcBmBounds.width();
-    const int dstBmRowSize = dstBmBounds.width();
-    const char* const srcBmData = srcBmPixels - (srcBmBounds.x1 + srcBmRowSize * srcBmBounds.y1);
-    char* const dstBmData       = dstBmPixels - (dstBmBounds.x1 + dstBmRowSize * dstBmBounds.y1);
+template <typename T>
+inline void
+convertRow(const T* src,
+           T* dst,
+           std::size_t count)
+{
+    std::copy(src, src + count, dst);
+}
 
-    for (int y = dstRoI.y1; y < dstRoI.y2; ++y) {
-        const PIX* const srcLineStart    = srcData + y * 2 * srcRowSize;
-        PIX* const dstLineStart          = dstData + y     * dstRowSize;
-        const char* const srcBmLineStart = srcBmData + y * 2 * srcBmRowSize;
-        char* const dstBmLineStart       = dstBmData + y     * dstBmRowSize;
-
-        // The current dst row, at y, covers the src rows y*2 (thisRow) and y*2+1 (nextRow).
-        // Check that if are within srcBounds.
-        int srcy = y * 2;
-        bool pickThisRow = srcBounds.y1 <= (srcy + 0) && (srcy + 0) < srcBounds.y2;
-        bool pickNextRow = srcBounds.y1 <= (srcy + 1) && (srcy + 1) < srcBounds.y2;
-        int sumH = (int)pickNextRow + (int)pickThisRow;
-        assert(sumH == 1 || sumH == 2);
-
-        for (int x = dstRoI.x1; x < dstRoI.x2; ++x) {
-            const PIX* const srcPixStart    = srcLineStart   + x * 2 * _nbComponents;
-            const char* const srcBmPixStart = srcBmLineStart + x * 2;
-            PIX* const dstPixStart          = dstLineStart   + x * _nbComponents;
-            char* const dstBmPixStart       = dstBmLineStart + x;
-
-            // The current dst col, at y, covers the src cols x*2 (thisCol) and x*2+1 (nextCol).
-            // Check that if are within srcBounds.
-            int srcx = x * 2;
-            bool pickThisCol = srcBounds.x1 <= (srcx + 0) && (srcx + 0) < srcBounds.x2;
-            bool pickNextCol = srcBounds.x1 <= (srcx + 1) && (srcx + 1) < srcBounds.x2;
-            int sumW = (int)pickThisCol + (int)pickNextCol;
-            assert(sumW == 1 || sumW == 2);
-            const int sum = sumW * sumH;
-            assert(0 < sum && sum <= 4);
-
-            if (sum == 0) { // never happens
-                for (int k = 0; k < _nbComponents; ++k) {
-                    dstPixStart[k] = 0;
-                }
-                if (copyBitMap) {
-                    dstBmPixStart[0] = 0;
-                }
-                continue;
-            }
+inline void
+convertRow(const Half* src,
+           float* dst,
+           std::size_t count)
+{
+    convertHalfToFloat(src, dst, count);
+}
 
-            for (int k = 0; k < _nbComponents; ++k) {
-                ///a b
-                ///c d
+inline void
+convertRow(const float* src,
+           Half* dst,
+           std::size_t count)
+{
+    convertFloatToHalf(src, dst, count);
+}
 
-                const PIX a = (pickThisCol && pickThisRow) ? *(srcPixStart + k) : 0;
-                const PIX b = (pickNextCol && pickThisRow) ? *(srcPixStart + k + _nbComponents) : 0;
-                const PIX c = (pickThisCol && pickNextRow) ? *(srcPixStart + k + srcRowSize) : 0;
-                const PIX d = (pickNextCol && pickNextRow) ? *(srcPixStart + k + srcRowSize  + _nbComponents)  : 0;
-#ifdef DEBUG_NAN
-                assert( !std::isnan(a) ); // check for NaN
-                assert( !std::isnan(b) ); // check for NaN
-                assert( !std::isnan(c) ); // check for NaN
-                assert( !std::isnan(d) ); // check for NaN
-#endif
-                assert( sumW == 2 || ( sumW == 1 && ( (a == 0 && c == 0) || (b == 0 && d == 0) ) ) );
-                assert( sumH == 2 || ( sumH == 1 && ( (a == 0 && b == 0) || (c == 0 && d == 0) ) ) );
-                dstPixStart[k] = (a + b + c + d) / sum;
+/**
+ * @brief Computes a band of rows of the last mipmap level in a single pass over the source rows it covers.
+ * Each intermediate level only keeps the 2 rows being halved, so that the rows of all levels stay in the cache.
+ * PIX is the type of the source and destination pixels and WORK the type of the intermediate levels: Half
+ * images are filtered in float and only rounded to half when writing the last level.
+ **/
+template <typename PIX, typename WORK>
+class MipmapRowPipeline
+{
+public:
+
+    MipmapRowPipeline(const PIX* src,
+                      const RectI& srcBounds,
+                      const std::vector<RectI>& levelBounds,
+                      int nComps)
+        : _src(src)
+        , _srcBounds(srcBounds)
+        , _levelBounds(levelBounds)
+        , _nComps(nComps)
+        , _rows( levelBounds.size() )
+    {
+        // the source rows are read in place when no conversion is needed
+        for (std::size_t l = 0; l < _levelBounds.size(); ++l) {
+            if ( (l > 0) || !std::is_same<PIX, WORK>::value ) {
+                _rows[l].resize( 2 * (std::size_t)_levelBounds[l].width() * _nComps );
             }
+        }
+    }
 
-            if (copyBitMap) {
-                ///a b
-                ///c d
+    // Writes the row y of the last level in dst, which must hold its width
+    void computeLastLevelRow(int y,
+                             PIX* dst)
+    {
+        const int lastLevel = (int)_levelBounds.size() - 1;
 
-                char a = (pickThisCol && pickThisRow) ? *(srcBmPixStart) : 0;
-                char b = (pickNextCol && pickThisRow) ? *(srcBmPixStart + 1) : 0;
-                char c = (pickThisCol && pickNextRow) ? *(srcBmPixStart + srcBmRowSize) : 0;
-                char d = (pickNextCol && pickNextRow) ? *(srcBmPixStart + srcBmRowSize  + 1)  : 0;
-#if NATRON_ENABLE_TRIMAP
-                /*
-                   The only correct solution is to convert pixels being rendered to 0 otherwise the caller
-                   would have to wait for the original fullscale image render to be finished and then re-downscale again.
-                 */
-                if (a == PIXEL_UNAVAILABLE) {
-                    a = 0;
-                }
-                if (b == PIXEL_UNAVAILABLE) {
-                    b = 0;
-                }
-                if (c == PIXEL_UNAVAILABLE) {
-                    c = 0;
-                }
-                if (d == PIXEL_UNAVAILABLE) {
-                    d = 0;
-                }
-#endif
-                assert( sumW == 2 || ( sumW == 1 && ( (a == 0 && c == 0) || (b == 0 && d == 0) ) ) );
-                assert( sumH == 2 || ( sumH == 1 && ( (a == 0 && b == 0) || (c == 0 && d == 0) ) ) );
-                assert(a + b + c + d <= sum); // bitmaps are 0 or 1
-                // the following is an integer division, the result can be 0 or 1
-                dstBmPixStart[0] = (a + b + c + d) / sum;
-                assert(dstBmPixStart[0] == 0 || dstBmPixStart[0] == 1);
+        if ( (lastLevel > 0) && std::is_same<PIX, WORK>::value ) {
+            halveRow(lastLevel, y, (WORK*)dst);
+        } else {
+            convertRow( getRow(lastLevel, y), dst, (std::size_t)_levelBounds[lastLevel].width() * _nComps );
+        }
+    }
+
+private:
+
+    const WORK* getRow(int level,
+                       int y)
+    {
+        const RectI& bounds = _levelBounds[level];
+
+        assert(bounds.y1 <= y && y < bounds.y2);
+        WORK* row = _rows[level].empty() ? NULL : &_rows[level][ (std::size_t)(y & 1) * bounds.width() * _nComps ];
+        if (level == 0) {
+            const PIX* srcRow = _src + ( (std::size_t)(y - _srcBounds.y1) * _srcBounds.width() + (bounds.x1 - _srcBounds.x1) ) * _nComps;
+            if (!row) {
+                return (const WORK*)srcRow;
             }
+            convertRow( srcRow, row, (std::size_t)bounds.width() * _nComps );
+        } else {
+            halveRow(level, y, row);
         }
+
+        return row;
     }
-} // halveRoIForDepth
 
-// code proofread and fixed by @devernay on 8/8/2014
-void
-Image::halveRoI(const RectI & roi,
-                bool copyBitMap,
-                Image* output) const
-{
-    switch ( getBitDepth() ) {
-    case eImageBitDepthByte:
-        halveRoIForDepth<unsigned char, 255>(roi, copyBitMap,  output);
-        break;
-    case eImageBitDepthShort:
-        halveRoIForDepth<unsigned short, 65535>(roi, copyBitMap, output);
-        break;
-    case eImageBitDepthHalf:
-        assert(false);
-        break;
-    case eImageBitDepthFloat:
-        halveRoIForDepth<float, 1>(roi, copyBitMap, output);
-        break;
-    case eImageBitDepthNone:
-        break;
+    void halveRow(int level,
+                  int y,
+                  WORK* dst)
+    {
+        // The row y covers the rows 2y and 2y+1 of the previous level, which go to different buffers.
+        const RectI& prevBounds = _levelBounds[level - 1];
+        const WORK* r0 = (prevBounds.y1 <= 2 * y) ? getRow(level - 1, 2 * y) : NULL;
+        const WORK* r1 = (2 * y + 1 < prevBounds.y2) ? getRow(level - 1, 2 * y + 1) : NULL;
+
+        if (!r0) {
+            r0 = r1;
+            r1 = NULL;
+        }
+        assert(r0);
+        halveRows(r0, r1, prevBounds.x1, prevBounds.x2, _nComps, dst);
     }
-}
 
-// code proofread and fixed by @devernay on 8/8/2014
-template <typename PIX, int maxValue>
-void
-Image::halve1DImageForDepth(const RectI & roi,
-                            Image* output) const
-{
-    int width = roi.width();
-    int height = roi.height();
+    const PIX* _src;
+    RectI _srcBounds;
+    const std::vector<RectI>& _levelBounds;
+    int _nComps;
+    std::vector<std::vector<WORK> > _rows;
+};
 
-    assert(width == 1 || height == 1); /// must be 1D
-    assert( output->getComponents() == getComponents() );
+// Below this number of source pixels per band, the scheduling overhead outweighs the parallelism
+#define NATRON_MIPMAP_MIN_PIXELS_PER_BAND (1 << 16)
 
-    /// Take the lock for both bitmaps since we're about to read/write from them!
-    QWriteLocker k1(&output->_entryLock);
-    QReadLocker k2(&_entryLock);
-    const RectI & srcBounds = _bounds;
-    const RectI & dstBounds = output->_bounds;
-//    assert(dstBounds.x1 * 2 == roi.x1 &&
-//           dstBounds.y1 * 2 == roi.y1 &&
-//           (
-//               dstBounds.x2 * 2 == roi.x2 || // we halve in only 1 dimension
-//               dstBounds.y2 * 2 == roi.y2)
-//           );
-    int halfWidth = width / 2;
-    int halfHeight = height / 2;
-    if (height == 1) { //1 row
-        assert(width != 1); /// widthxheight can't be 1x1
-
-        const PIX* src = (const PIX*)pixelAt(roi.x1, roi.y1);
-        PIX* dst = (PIX*)output->pixelAt(dstBounds.x1, dstBounds.y1);
-        assert(src && dst);
-        for (int x = 0; x < halfWidth; ++x) {
-            for (int k = 0; k < _nbComponents; ++k) {
-#ifdef DEBUG_NAN
-                assert( !std::isnan(*src) ); // check for NaN
-                assert( !std::isnan(*(src + _nbComponents)) ); // check for NaN
-#endif
-                *dst = PIX( (float)( *src + *(src + _nbComponents) ) / 2. );
-#ifdef DEBUG_NAN
-                assert( !std::isnan(*dst) ); // check for NaN
-#endif
-                ++dst;
-                ++src;
-            }
-            src += _nbComponents;
-        }
-    } else if (width == 1) {
-        int rowSize = srcBounds.width() * _nbComponents;
-        const PIX* src = (const PIX*)pixelAt(roi.x1, roi.y1);
-        PIX* dst = (PIX*)output->pixelAt(dstBounds.x1, dstBounds.y1);
-        assert(src && dst);
-        for (int y = 0; y < halfHeight; ++y) {
-            for (int k = 0; k < _nbComponents; ++k) {
-#ifdef DEBUG_NAN
-                assert( !std::isnan(*src) ); // check for NaN
-                assert( !std::isnan(*(src + rowSize)) ); // check for NaN
-#endif
-                *dst = PIX( (float)( *src + (*src + rowSize) ) / 2. );
-#ifdef DEBUG_NAN
-                assert( !std::isnan(*dst) ); // check for NaN
-#endif
-                ++dst;
-                ++src;
-            }
-            src += rowSize;
+template <typename PIX, typename WORK>
+void
+downscaleMipmapPixelsForDepth(int nComps,
+                              const PIX* src,
+                              const RectI& srcBounds,
+                              const RectI& roi,
+                              unsigned int levels,
+                              PIX* dst,
+                              const RectI& dstBounds)
+{
+    std::vector<RectI> levelBounds(levels + 1);
+
+    levelBounds[0] = roi;
+    for (unsigned int l = 1; l <= levels; ++l) {
+        levelBounds[l] = levelBounds[l - 1].downscalePowerOfTwoSmallestEnclosing(1);
+    }
+    const RectI& lastLevelBounds = levelBounds[levels];
+    assert( dstBounds.contains(lastLevelBounds) );
+
+    // Each band of rows of the last level covers its own band of source rows, so that bands are independent
+    const int nRows = lastLevelBounds.height();
+    const int nBands = std::max( 1, std::min( nRows, (int)(roi.area() / NATRON_MIPMAP_MIN_PIXELS_PER_BAND) ) );
+    const int rowsPerBand = (nRows + nBands - 1) / nBands;
+    std::function<void(int)> computeBand = [&](int band) {
+        MipmapRowPipeline<PIX, WORK> pipeline(src, srcBounds, levelBounds, nComps);
+        const int y1 = lastLevelBounds.y1 + band * rowsPerBand;
+        const int y2 = std::min(y1 + rowsPerBand, lastLevelBounds.y2);
+
+        for (int y = y1; y < y2; ++y) {
+            PIX* dstRow = dst + ( (std::size_t)(y - dstBounds.y1) * dstBounds.width() + (lastLevelBounds.x1 - dstBounds.x1) ) * nComps;
+            pipeline.computeLastLevelRow(y, dstRow);
         }
+    };
+
+    TaskScheduler* scheduler = appPTR ? appPTR->getTaskScheduler() : NULL;
+    if ( (nBands > 1) && scheduler ) {
+        scheduler->parallelFor( (nRows + rowsPerBand - 1) / rowsPerBand, computeBand );
+    } else {
+        computeBand(0);
     }
 }
 
-// code proofread and fixed by @devernay on 8/8/2014
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
 void
-Image::halve1DImage(const RectI & roi,
-                    Image* output) const
-{
-    switch ( getBitDepth() ) {
+Image::downscaleMipmapPixels(ImageBitDepthEnum depth,
+                             int nComps,
+                             const void* src,
+                             const RectI& srcBounds,
+                             const RectI& roi,
+                             unsigned int levels,
+                             void* dst,
+                             const RectI& dstBounds)
+{
+    assert( srcBounds.contains(roi) );
+    if ( roi.isNull() || (nComps == 0) ) {
+        return;
+    }
+    switch (depth) {
     case eImageBitDepthByte:
-        halve1DImageForDepth<unsigned char, 255>(roi, output);
+        downscaleMipmapPixelsForDepth<unsigned char, unsigned char>(nComps, (const unsigned char*)src, srcBounds, roi, levels, (unsigned char*)dst, dstBounds);
         break;
     case eImageBitDepthShort:
-        halve1DImageForDepth<unsigned short, 65535>(roi, output);
+        downscaleMipmapPixelsForDepth<unsigned short, unsigned short>(nComps, (const unsigned short*)src, srcBounds, roi, levels, (unsigned short*)dst, dstBounds);
         break;
     case eImageBitDepthHalf:
-        assert(false);
+        downscaleMipmapPixelsForDepth<Half, float>(nComps, (const Half*)src, srcBounds, roi, levels, (Half*)dst, dstBounds);
         break;
     case eImageBitDepthFloat:
-        halve1DImageForDepth<float, 1>(roi, output);
+        downscaleMipmapPixelsForDepth<float, float>(nComps, (const float*)src, srcBounds, roi, levels, (float*)dst, dstBounds);
         break;
     case eImageBitDepthNone:
         break;
@@ -2077,30 +2397,27 @@ Image::downscaleMipmap(const RectD& dstRod,
 
     assert(_bounds.x1 <= roi.x1 && roi.x2 <= _bounds.x2 &&
            _bounds.y1 <= roi.y1 && roi.y2 <= _bounds.y2);
-    double par = getPixelAspectRatio();
     unsigned int downscaleLvls = toLevel - fromLevel;
 
-    assert( !copyBitMap || _bitmap.getBitmap() );
+    assert( !copyBitMap || usesBitMap() );
 
     RectI dstRoI  = roi.downscalePowerOfTwoSmallestEnclosing(downscaleLvls);
-    ImagePtr tmpImg = std::make_shared<Image>( getComponents(), dstRod, dstRoI, toLevel, par, getBitDepth(), getPremultiplication(), getFieldingOrder(), true);
-
-    buildMipmapLevel( dstRod, roi, downscaleLvls, copyBitMap, tmpImg.get() );
 
     // check that the downscaled mipmap is inside the output image (it may not be equal to it)
     assert(dstRoI.x1 >= output->_bounds.x1);
     assert(dstRoI.x2 <= output->_bounds.x2);
     assert(dstRoI.y1 >= output->_bounds.y1);
     assert(dstRoI.y2 <= output->_bounds.y2);
+    Q_UNUSED(dstRoI);
 
-    ///Now copy the result of tmpImg into the output image
-    output->pasteFrom(*tmpImg, dstRoI, copyBitMap);
+    ///All the levels are computed in a single pass, directly into the output image
+    buildMipmapLevel( dstRod, roi, downscaleLvls, copyBitMap, output );
 }
 
 bool
 Image::checkForNaNsAndFix(const RectI& roi)
 {
-    if (getBitDepth() != eImageBitDepthFloat) {
+    if ( (getBitDepth() != eImageBitDepthFloat) && (getBitDepth() != eImageBitDepthHalf) ) {
         return false;
     }
     if (getStorageMode() == eStorageModeGLTex) {
@@ -2110,6 +2427,21 @@ Image::checkForNaNsAndFix(const RectI& roi)
     QWriteLocker k(&_entryLock);
     unsigned int compsCount = getComponentsCount();
     bool hasnan = false;
+    if (getBitDepth() == eImageBitDepthHalf) {
+        for (int y = roi.y1; y < roi.y2; ++y) {
+            Half* pix = (Half*)pixelAt(roi.x1, y);
+            Half* const end = pix +  compsCount * roi.width();
+
+            for (; pix < end; ++pix) {
+                if ( pix->isNan() ) {
+                    *pix = 1.f;
+                    hasnan = true;
+                }
+            }
+        }
+
+        return hasnan;
+    }
     for (int y = roi.y1; y < roi.y2; ++y) {
         float* pix = (float*)pixelAt(roi.x1, y);
         float* const end = pix +  compsCount * roi.width();
@@ -2133,7 +2465,7 @@ Image::checkForNaNsAndFix(const RectI& roi)
 bool
 Image::checkForNaNsNoLock(const RectI& roi) const
 {
-    if (getBitDepth() != eImageBitDepthFloat) {
+    if ( (getBitDepth() != eImageBitDepthFloat) && (getBitDepth() != eImageBitDepthHalf) ) {
         return false;
     }
     if (getStorageMode() == eStorageModeGLTex) {
@@ -2143,6 +2475,20 @@ Image::checkForNaNsNoLock(const RectI& roi) const
     //QWriteLocker k(&_entryLock);
     unsigned int compsCount = getComponentsCount();
     bool hasnan = false;
+    if (getBitDepth() == eImageBitDepthHalf) {
+        for (int y = roi.y1; y < roi.y2; ++y) {
+            const Half* pix = (const Half*)pixelAt(roi.x1, y);
+            const Half* const end = pix +  compsCount * roi.width();
+
+            for (; pix < end; ++pix) {
+                if ( pix->isNan() ) {
+                    hasnan = true;
+                }
+            }
+        }
+
+        return hasnan;
+    }
     for (int y = roi.y1; y < roi.y2; ++y) {
         float* pix = (float*)pixelAt(roi.x1, y);
         float* const end = pix +  compsCount * roi.width();
@@ -2171,7 +2517,7 @@ Image::upscaleMipmapForDepth(const RectI & roi,
                              Image* output) const
 {
     assert( getBitDepth() == output->getBitDepth() );
-    assert( (getBitDepth() == eImageBitDepthByte && sizeof(PIX) == 1) || (getBitDepth() == eImageBitDepthShort && sizeof(PIX) == 2) || (getBitDepth() == eImageBitDepthFloat && sizeof(PIX) == 4) );
+    assert( (getBitDepth() == eImageBitDepthByte && sizeof(PIX) == 1) || (getBitDepth() == eImageBitDepthShort && sizeof(PIX) == 2) || (getBitDepth() == eImageBitDepthHalf && sizeof(PIX) == 2) || (getBitDepth() == eImageBitDepthFloat && sizeof(PIX) == 4) );
 
     ///You should not call this function with a level equal to 0.
     assert(fromLevel > toLevel);
@@ -2261,7 +2607,7 @@ Image::upscaleMipmap(const RectI & roi,
         upscaleMipmapForDepth<unsigned short, 65535>(roi, fromLevel, toLevel, output);
         break;
     case eImageBitDepthHalf:
-        assert(false);
+        upscaleMipmapForDepth<Half, 1>(roi, fromLevel, toLevel, output);
         break;
     case eImageBitDepthFloat:
         upscaleMipmapForDepth<float, 1>(roi, fromLevel, toLevel, output);
@@ -2271,9 +2617,8 @@ Image::upscaleMipmap(const RectI & roi,
     }
 }
 
-// code proofread and fixed by @devernay on 8/8/2014
 void
-Image::buildMipmapLevel(const RectD& dstRoD,
+Image::buildMipmapLevel(const RectD& /*dstRoD*/,
                         const RectI & roi,
                         unsigned int level,
                         bool copyBitMap,
@@ -2294,42 +2639,22 @@ Image::buildMipmapLevel(const RectD& dstRoD,
         return;
     }
 
-    const Image* srcImg = this;
-    Image* dstImg = NULL;
-    bool mustFreeSrc = false;
-    RectI previousRoI = roi;
-    ///Build all the mipmap levels until we reach the one we are interested in
-    for (unsigned int i = 1; i <= level; ++i) {
-        ///Halve the smallest enclosing po2 rect as we need to render a minimum of the renderWindow
-        RectI halvedRoI = previousRoI.downscalePowerOfTwoSmallestEnclosing(1);
-
-        ///Allocate an image with half the size of the source image
-        dstImg = new Image( getComponents(), dstRoD, halvedRoI, getMipmapLevel() + i, getPixelAspectRatio(), getBitDepth(), getPremultiplication(), getFieldingOrder(), true);
-
-        ///Half the source image into dstImg.
-        ///We pass the closestPo2 roi which might not be the entire size of the source image
-        ///If the source image'sroi was originally a po2.
-        srcImg->halveRoI(previousRoI, copyBitMap, dstImg);
-
-        ///Clean-up, we should use shared_ptrs for safety
-        if (mustFreeSrc) {
-            delete srcImg;
-        }
-
-        ///Switch for next pass
-        previousRoI = halvedRoI;
-        srcImg = dstImg;
-        mustFreeSrc = true;
-    }
+    assert( output->getBitDepth() == getBitDepth() );
+    assert(getStorageMode() != eStorageModeGLTex && output->getStorageMode() != eStorageModeGLTex);
+    assert( !copyBitMap || usesBitMap() );
+    assert( _bounds.contains(roi) );
 
-    assert(srcImg->getBounds() == lastLevelRoI);
+    /// Take the lock for both images since we're about to read/write from them!
+    QWriteLocker k1(&output->_entryLock);
+    QReadLocker k2(&_entryLock);
 
-    ///Finally copy the last mipmap level into output.
-    output->pasteFrom( *srcImg, srcImg->getBounds(), copyBitMap);
+    downscaleMipmapPixels( getBitDepth(), _nbComponents, pixelAt(_bounds.x1, _bounds.y1), _bounds, roi, level,
+                           output->pixelAt(output->_bounds.x1, output->_bounds.y1), output->_bounds );
 
-    ///Clean-up, we should use shared_ptrs for safety
-    if (mustFreeSrc) {
-        delete srcImg;
+    if (copyBitMap && output->_useBitmap) {
+        // The pixels being rendered in this image are considered not rendered, otherwise the caller
+        // would have to wait for the original fullscale image render to be finished and then re-downscale again.
+        output->_bitmap.downscaleFrom(_bitmap, roi, level, lastLevelRoI);
     }
 } // buildMipmapLevel
 
@@ -2346,33 +2671,6 @@ Image::getLevelFromScale(double s)
     return retval;
 }
 
-void
-Image::copyBitmapRowPortion(int x1,
-                            int x2,
-                            int y,
-                            const Image& other)
-{
-    _bitmap.copyRowPortion(x1, x2, y, other._bitmap);
-}
-
-void
-Bitmap::copyRowPortion(int x1,
-                       int x2,
-                       int y,
-                       const Bitmap& other)
-{
-    const char* srcBitmap = other.getBitmapAt(x1, y);
-    char* dstBitmap = getBitmapAt(x1, y);
-    const char* end = dstBitmap + (x2 - x1);
-
-    assert(srcBitmap && dstBitmap);
-    while (dstBitmap < end) {
-        *dstBitmap = /**srcBitmap == PIXEL_UNAVAILABLE ? 0 : */ *srcBitmap;
-        ++dstBitmap;
-        ++srcBitmap;
-    }
-}
-
 void
 Image::copyBitmapPortion(const RectI& roi,
                          const Image& other)
@@ -2380,32 +2678,6 @@ Image::copyBitmapPortion(const RectI& roi,
     _bitmap.copyBitmapPortion(roi, other._bitmap);
 }
 
-void
-Bitmap::copyBitmapPortion(const RectI& roi,
-                          const Bitmap& other)
-{
-    assert(roi.x1 >= _bounds.x1 && roi.x2 <= _bounds.x2 && roi.y1 >= _bounds.y1 && roi.y2 <= _bounds.y2);
-    assert(roi.x1 >= other._bounds.x1 && roi.x2 <= other._bounds.x2 && roi.y1 >= other._bounds.y1 && roi.y2 <= other._bounds.y2);
-
-    int srcRowSize = other._bounds.width();
-    int dstRowSize = _bounds.width();
-    const char* srcBitmap = other.getBitmapAt(roi.x1, roi.y1);
-    char* dstBitmap = getBitmapAt(roi.x1, roi.y1);
-
-    for (int y = roi.y1; y < roi.y2; ++y,
-         srcBitmap += srcRowSize,
-         dstBitmap += dstRowSize) {
-        const char* srcCur = srcBitmap;
-        const char* srcEnd = srcBitmap + roi.width();
-        char* dstCur = dstBitmap;
-        while (srcCur < srcEnd) {
-            *dstCur = /**srcCur == PIXEL_UNAVAILABLE ? 0 : */ *srcCur;
-            ++srcCur;
-            ++dstCur;
-        }
-    }
-}
-
 template <typename PIX, bool doPremult>
 void
 Image::premultInternal(const RectI& roi)
@@ -2456,6 +2728,9 @@ Image::premultForDepth(const RectI& roi)
     case eImageBitDepthShort:
         premultInternal<unsigned short, doPremult>(roi);
         break;
+    case eImageBitDepthHalf:
+        premultInternal<Half, doPremult>(roi);
+        break;
     case eImageBitDepthFloat:
         premultInternal<float, doPremult>(roi);
         break;
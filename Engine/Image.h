@@ -30,6 +30,8 @@
 
 #include <list>
 #include <map>
+#include <memory>
+#include <vector>
 #include <algorithm> // min, max
 #include <bitset>
 
@@ -40,6 +42,7 @@ CLANG_DIAG_OFF(deprecated)
 CLANG_DIAG_ON(deprecated)
 #include <QtCore/QReadWriteLock>
 
+#include "Engine/Half.h"
 #include "Engine/ImageKey.h"
 #include "Engine/ImagePlaneDesc.h"
 #include "Engine/ImageParams.h"
@@ -64,46 +67,34 @@ public:
     }
 };
 
+// The bitmap stores the render state per tile of NATRON_BITMAP_TILE_SIZE x NATRON_BITMAP_TILE_SIZE pixels
+#define NATRON_BITMAP_TILE_SIZE_LOG2 6
+#define NATRON_BITMAP_TILE_SIZE (1 << NATRON_BITMAP_TILE_SIZE_LOG2)
+
+/**
+ * @brief The render state of the pixels of an image: 0 if the pixel is not rendered, 1 if it is rendered and,
+ * with the trimap, 2 if another thread is rendering it.
+ *
+ * The state is stored per tile of NATRON_BITMAP_TILE_SIZE x NATRON_BITMAP_TILE_SIZE pixels: a tile whose pixels all have the
+ * same state only stores that state, and only the tiles that are partly rendered (typically the tiles on the edges of
+ * the rendered rectangles) store the state of each of their pixels. Finding the pixels left to render is thus
+ * proportional to the number of tiles rather than the number of pixels, and the number of tiles in each state
+ * gives the fully rendered and the fully non-rendered cases in constant time.
+ *
+ * The bitmap is not thread-safe: it is protected by the lock of the image.
+ **/
 class Bitmap
 {
 public:
-    Bitmap(const RectI & bounds)
-        : _bounds(bounds)
-        , _map( bounds.area() )
-        , _dirtyZone()
-        , _dirtyZoneSet(false)
-    {
-        //Do not assert !rod.isNull() : An empty image can be created for entries that correspond to
-        // "identities" images (i.e: images that are just a link to another image). See EffectInstance :
-        // "!!!Note that if isIdentity is true it will allocate an empty image object with 0 bytes of data."
-        //assert(!rod.isNull());
-        std::fill(_map.begin(), _map.end(), 0);
-    }
+    Bitmap(const RectI & bounds);
 
-    Bitmap()
-        : _bounds()
-        , _map()
-        , _dirtyZone()
-        , _dirtyZoneSet(false)
-    {
-    }
+    Bitmap();
 
-    void initialize(const RectI & bounds)
-    {
-        _bounds = bounds;
-        _map.resize( _bounds.area() );
-
-        std::fill(_map.begin(), _map.end(), 0);
-    }
+    void initialize(const RectI & bounds);
 
-    ~Bitmap()
-    {
-    }
+    ~Bitmap();
 
-    void setTo1()
-    {
-        std::fill(_map.begin(), _map.end(), 1);
-    }
+    void setTo1();
 
     const RectI & getBounds() const
     {
@@ -133,22 +124,31 @@ public:
 
     void swap(Bitmap& other);
 
-    const char* getBitmap() const
-    {
-        return &_map.front();
-    }
+    /**
+     * @brief Copies the state of the pixels of row y in [x1, x2) to buf. The row must be within the bounds.
+     **/
+    void getRow(int y, int x1, int x2, char* buf) const;
 
-    char* getBitmap()
-    {
-        return &_map.front();
-    }
+    void copyBitmapPortion(const RectI& roi, const Bitmap& other);
 
-    const char* getBitmapAt(int x, int y) const;
-    char* getBitmapAt(int x, int y);
+    /**
+     * @brief Sets the pixels of dstRoI from the 2x2 pixels of src they cover, as done when building a mipmap level:
+     * a pixel is rendered only if all the pixels of src it covers (and that are within the bounds of src) are rendered.
+     * Pixels being rendered in src are considered not rendered.
+     **/
+    void halveFrom(const Bitmap& src, const RectI& dstRoI);
 
-    void copyRowPortion(int x1, int x2, int y, const Bitmap& other);
+    /**
+     * @brief Same as halveFrom() but for the 2^levels x 2^levels pixels of src each pixel covers, counting only the pixels
+     * within srcRoI, so that it gives the same result as calling halveFrom() levels times on the intermediate levels.
+     **/
+    void downscaleFrom(const Bitmap& src, const RectI& srcRoI, unsigned int levels, const RectI& dstRoI);
 
-    void copyBitmapPortion(const RectI& roi, const Bitmap& other);
+    /**
+     * @brief The memory used by the bitmap. It only depends on the bounds, the per-pixel states of the partly rendered tiles
+     * are not accounted for.
+     **/
+    std::size_t getMemorySize() const;
 
     void setDirtyZone(const RectI& zone)
     {
@@ -157,11 +157,50 @@ public:
     }
 
 private:
+
+    enum TileStateEnum
+    {
+        // 0, 1 and 2 are the state of all pixels of the tile
+        eTileStateMixed = 3
+    };
+
     void markFor(const RectI & roi, char value);
 
+    void setRow(int y, int x1, int x2, const char* buf);
+
+    template <int trimap>
+    RectI minimalNonMarkedBbox_internal(const RectI& roi, bool* isBeingRenderedElsewhere) const;
+
+    template <int trimap>
+    void minimalNonMarkedRects_internal(const RectI & roi, std::list<RectI>& ret, bool* isBeingRenderedElsewhere) const;
+
+    int getRowFlags(int y, int x1, int x2, bool upwards, int* nRows) const;
+
+    int getColumnFlags(int x, int y1, int y2, bool rightwards, int* nColumns) const;
+
+    RectI getTileRect(int tx, int ty) const;
+
+    char* getTilePixels(int tile);
+
+    void setTileState(int tile, char state);
+
+    // Turns a eTileStateMixed tile back into a uniform tile if all its pixels have the same state
+    void collapseTile(int tile, const RectI& tileRect);
+
+    void collapseTiles(const RectI& roi);
+
 private:
     RectI _bounds;
-    std::vector<char> _map;
+    int _nTilesX, _nTilesY;
+
+    // The state of each tile, either the state of all of its pixels or eTileStateMixed
+    std::vector<char> _tiles;
+
+    // For eTileStateMixed tiles, the state of each pixel, with rows of NATRON_BITMAP_TILE_SIZE pixels
+    std::vector<std::unique_ptr<char[]> > _tilePixels;
+
+    // Number of tiles in each state
+    int _nTilesPerState[4];
 
     /**
      * This represents the zone that has potentially something to render. In minimalNonMarkedRects
@@ -303,7 +342,7 @@ public:
         std::size_t dt = dataSize();
         bool got = _entryLock.tryLockForRead();
 
-        dt += _bitmap.getBounds().area();
+        dt += _bitmap.getMemorySize();
         if (got) {
             _entryLock.unlock();
         }
@@ -405,14 +444,6 @@ public:
 
             return img->pixelAt(x, y);
         }
-
-        const char* bitmapAt(int x,
-                             int y) const
-        {
-            assert(img);
-
-            return img->getBitmapAt(x, y);
-        }
     };
 
     typedef std::shared_ptr<ReadAccess> ReadAccessPtr;
@@ -457,14 +488,6 @@ public:
         {
             return img->pixelAt(x, y);
         }
-
-        char* bitmapAt(int x,
-                       int y) const
-        {
-            assert(img);
-
-            return img->getBitmapAt(x, y);
-        }
     };
 
     typedef std::shared_ptr<WriteAccess> WriteAccessPtr;
@@ -491,18 +514,6 @@ private:
      * of an image.
      **/
 
-    const char* getBitmapAt(int x,
-                            int y) const
-    {
-        return this->_bitmap.getBitmapAt(x, y);
-    }
-
-    char* getBitmapAt(int x,
-                      int y)
-    {
-        return this->_bitmap.getBitmapAt(x, y);
-    }
-
     /**
      * @brief Access pixels. The pointer must be cast to the appropriate type afterwards.
      **/
@@ -760,6 +771,22 @@ public:
      **/
     void upscaleMipmap(const RectI & roi, unsigned int fromLevel, unsigned int toLevel, Image* output) const;
 
+    /**
+     * @brief Box-filters the pixels of roi in src down by 2^levels into dst, which must contain
+     * roi.downscalePowerOfTwoSmallestEnclosing(levels). Each pixel of a level is the average of the pixels of the previous
+     * level it covers, so that pixels on the edges of roi are not darkened.
+     * The levels are computed together row by row, and bands of rows are computed in parallel on the TaskScheduler.
+     * src and dst are buffers of contiguous rows of nComps components with the given bounds.
+     **/
+    static void downscaleMipmapPixels(ImageBitDepthEnum depth,
+                                      int nComps,
+                                      const void* src,
+                                      const RectI& srcBounds,
+                                      const RectI& roi,
+                                      unsigned int levels,
+                                      void* dst,
+                                      const RectI& dstBounds);
+
 
     static unsigned int getLevelFromScale(double s);
 
@@ -872,8 +899,6 @@ public:
      */
     bool checkForNaNsAndFix(const RectI& roi) WARN_UNUSED_RETURN;
 
-    void copyBitmapRowPortion(int x1, int x2, int y, const Image& other);
-
     void copyBitmapPortion(const RectI& roi, const Image& other);
 
     template <typename PIX>
@@ -976,32 +1001,12 @@ private:
      * @brief Given the output buffer,the region of interest and the mip map level, this
      * function computes the mip map of this image in the given roi.
      * If roi is NOT a power of 2, then it will be rounded to the closest power of 2.
+     * All the levels are computed in a single pass with downscaleMipmapPixels().
      **/
     void buildMipmapLevel(const RectD& dstRoD, const RectI & roiCanonical, unsigned int level, bool copyBitMap,
                           Image* output) const;
 
 
-    /**
-     * @brief Halve the given roi of this image into output.
-     * If the RoI bounds are odd, the largest enclosing RoI with even bounds will be considered.
-     **/
-    void halveRoI(const RectI & roi, bool copyBitMap,
-                  Image* output) const;
-
-
-    template <typename PIX, int maxValue>
-    void halveRoIForDepth(const RectI & roi,
-                          bool copyBitMap,
-                          Image* output) const;
-
-    /**
-     * @brief Same as halveRoI but for 1D only (either width == 1 or height == 1)
-     **/
-    void halve1DImage(const RectI & roi, Image* output) const;
-
-    template <typename PIX, int maxValue>
-    void halve1DImageForDepth(const RectI & roi, Image* output) const;
-
     template <typename PIX, int maxValue>
     void upscaleMipmapForDepth(const RectI & roi, unsigned int fromLevel, unsigned int toLevel, Image* output) const;
 
@@ -1064,6 +1069,10 @@ template<>
 inline float
 Image::clampIfInt(float v) { return v; }
 
+template<>
+inline Half
+Image::clampIfInt(float v) { return v; }
+
 NATRON_NAMESPACE_EXIT
 
 #endif // NATRON_ENGINE_IMAGE_H
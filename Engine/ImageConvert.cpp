@@ -32,6 +32,7 @@
 #include <QtCore/QDebug>
 
 #include "Engine/AppManager.h"
+#include "Engine/Half.h"
 #include "Engine/Lut.h"
 
 NATRON_NAMESPACE_ENTER
@@ -103,6 +104,55 @@ Image::convertPixelDepth(float pix)
     return pix;
 }
 
+template <>
+Half
+Image::convertPixelDepth(unsigned char pix)
+{
+    return Color::intToFloat<256>(pix);
+}
+
+template <>
+Half
+Image::convertPixelDepth(unsigned short pix)
+{
+    return Color::intToFloat<65536>(pix);
+}
+
+template <>
+Half
+Image::convertPixelDepth(float pix)
+{
+    return pix;
+}
+
+template <>
+unsigned char
+Image::convertPixelDepth(Half pix)
+{
+    return (unsigned char)Color::floatToInt<256>(pix);
+}
+
+template <>
+unsigned short
+Image::convertPixelDepth(Half pix)
+{
+    return (unsigned short)Color::floatToInt<65536>(pix);
+}
+
+template <>
+float
+Image::convertPixelDepth(Half pix)
+{
+    return pix;
+}
+
+template <>
+Half
+Image::convertPixelDepth(Half pix)
+{
+    return pix;
+}
+
 static const Color::Lut*
 lutFromColorspace(ViewerColorSpaceEnum cs)
 {
@@ -127,6 +177,39 @@ lutFromColorspace(ViewerColorSpaceEnum cs)
     return lut;
 }
 
+///Converts a row of count values without colorspace conversion, returns false if there is no fast path
+///for these depths, in which case the values are converted one by one.
+template <typename SRCPIX, typename DSTPIX>
+static bool
+convertRowDepth(const SRCPIX* /*src*/,
+                DSTPIX* /*dst*/,
+                std::size_t /*count*/)
+{
+    return false;
+}
+
+template <>
+bool
+convertRowDepth(const Half* src,
+                float* dst,
+                std::size_t count)
+{
+    convertHalfToFloat(src, dst, count);
+
+    return true;
+}
+
+template <>
+bool
+convertRowDepth(const float* src,
+                Half* dst,
+                std::size_t count)
+{
+    convertFloatToHalf(src, dst, count);
+
+    return true;
+}
+
 ///Fast version when components are the same
 template <typename SRCPIX, typename DSTPIX, int srcMaxValue, int dstMaxValue>
 void
@@ -157,6 +240,26 @@ Image::convertToFormatInternal_sameComps(const RectI & renderWindow,
     if ( intersection.isNull() ) {
         return;
     }
+    if (!srcLutOp && !dstLutOp) {
+        // Half <-> float conversions are done a whole row at a time (with F16C when available)
+        std::size_t rowElems = (std::size_t)intersection.width() * nComp;
+        const SRCPIX* srcPixels = (const SRCPIX*)srcImg.pixelAt(intersection.x1, intersection.y1);
+        DSTPIX* dstPixels = (DSTPIX*)dstImg.pixelAt(intersection.x1, intersection.y1);
+        if ( convertRowDepth<SRCPIX, DSTPIX>(srcPixels, dstPixels, rowElems) ) {
+            int srcRowElems = r.width() * nComp;
+            int dstRowElems = dstImg._bounds.width() * nComp;
+            for (int y = 1; y < intersection.height(); ++y) {
+                srcPixels += srcRowElems;
+                dstPixels += dstRowElems;
+                convertRowDepth<SRCPIX, DSTPIX>(srcPixels, dstPixels, rowElems);
+            }
+            if (copyBitmap) {
+                dstImg.copyBitmapPortion(intersection, srcImg);
+            }
+
+            return;
+        }
+    }
     for (int y = 0; y < intersection.height(); ++y) {
         // coverity[dont_call]
         int start = rand() % intersection.width();
@@ -201,7 +304,7 @@ Image::convertToFormatInternal_sameComps(const RectI & renderWindow,
                                                              Color::floatToInt<0xff01>(pixFloat) );
                             pix = error[k] >> 8;
                         } else if (dstDepth == eImageBitDepthShort) {
-                            pix = dstLutOp ? dstLut->toColorSpaceUint16FromLinearFloatFast(pixFloat) :
+                            pix = dstLutOp ? DSTPIX( dstLut->toColorSpaceUint16FromLinearFloatFast(pixFloat) ) :
                                   convertPixelDepth<float, DSTPIX>(pixFloat);
                         } else {
                             if (dstLutOp) {
@@ -229,10 +332,10 @@ Image::convertToFormatInternal_sameComps(const RectI & renderWindow,
             srcPixels = srcStart - nComp;
             dstPixels = dstStart - nComp;
         }
+    }
 
-        if (copyBitmap) {
-            dstImg.copyBitmapRowPortion(intersection.x1, intersection.x2, intersection.y1 + y, srcImg);
-        }
+    if (copyBitmap) {
+        dstImg.copyBitmapPortion(intersection, srcImg);
     }
 } // convertToFormatInternal_sameComps
 
@@ -337,11 +440,11 @@ Image::convertToFormatInternalForColorSpace(const RectI & renderWindow,
                         break;
                     case 3:
                         // RGB is opaque, so no alpha, unless channelForAlpha is 0-2
-                        pix = convertPixelDepth<SRCPIX, DSTPIX>(channelForAlpha == -1 ? 0. : srcPixels[channelForAlpha]);
+                        pix = convertPixelDepth<SRCPIX, DSTPIX>(channelForAlpha == -1 ? SRCPIX(0) : srcPixels[channelForAlpha]);
                         break;
                     case 2:
                         // XY is opaque unless channelForAlpha is  0-1
-                        pix = convertPixelDepth<SRCPIX, DSTPIX>(channelForAlpha == -1 ? 0. : srcPixels[channelForAlpha]);
+                        pix = convertPixelDepth<SRCPIX, DSTPIX>(channelForAlpha == -1 ? SRCPIX(0) : srcPixels[channelForAlpha]);
                         break;
                     case 1:
                         // just copy alpha disregarding channelForAlpha
@@ -423,7 +526,7 @@ Image::convertToFormatInternalForColorSpace(const RectI & renderWindow,
                                                                      Color::floatToInt<0xff01>(pixFloat) );
                                     pix = error[k] >> 8;
                                 } else if (dstMaxValue == 65535) {
-                                    pix = dstLutOp ? dstLut->toColorSpaceUint16FromLinearFloatFast(pixFloat) :
+                                    pix = dstLutOp ? DSTPIX( dstLut->toColorSpaceUint16FromLinearFloatFast(pixFloat) ) :
                                           convertPixelDepth<float, DSTPIX>(pixFloat);
                                 } else {
                                     if (dstLutOp) {
@@ -696,6 +799,9 @@ Image::convertToFormatCommon(const RectI & renderWindow,
                                                                                              dstColorSpace, copyBitmap);
                 break;
             case eImageBitDepthHalf:
+                convertToFormatInternal_sameComps<Half, unsigned char, 1, 255>(renderWindow, *this, *dstImg,
+                                                                               srcColorSpace,
+                                                                               dstColorSpace, copyBitmap);
                 break;
             case eImageBitDepthFloat:
                 convertToFormatInternal_sameComps<float, unsigned char, 1, 255>(renderWindow, *this, *dstImg,
@@ -722,6 +828,9 @@ Image::convertToFormatCommon(const RectI & renderWindow,
                                                                                                 dstColorSpace, copyBitmap);
                 break;
             case eImageBitDepthHalf:
+                convertToFormatInternal_sameComps<Half, unsigned short, 1, 65535>(renderWindow, *this, *dstImg,
+                                                                                  srcColorSpace,
+                                                                                  dstColorSpace, copyBitmap);
                 break;
             case eImageBitDepthFloat:
                 convertToFormatInternal_sameComps<float, unsigned short, 1, 65535>(renderWindow, *this, *dstImg,
@@ -734,8 +843,34 @@ Image::convertToFormatCommon(const RectI & renderWindow,
             break;
         }
 
-        case eImageBitDepthHalf:
+        case eImageBitDepthHalf: {
+            switch ( getBitDepth() ) {
+            case eImageBitDepthByte:
+                convertToFormatInternal_sameComps<unsigned char, Half, 255, 1>(renderWindow, *this, *dstImg,
+                                                                               srcColorSpace,
+                                                                               dstColorSpace, copyBitmap);
+                break;
+            case eImageBitDepthShort:
+                convertToFormatInternal_sameComps<unsigned short, Half, 65535, 1>(renderWindow, *this, *dstImg,
+                                                                                  srcColorSpace,
+                                                                                  dstColorSpace, copyBitmap);
+                break;
+            case eImageBitDepthHalf:
+                ///Same as a copy
+                convertToFormatInternal_sameComps<Half, Half, 1, 1>(renderWindow, *this, *dstImg,
+                                                                    srcColorSpace,
+                                                                    dstColorSpace, copyBitmap);
+                break;
+            case eImageBitDepthFloat:
+                convertToFormatInternal_sameComps<float, Half, 1, 1>(renderWindow, *this, *dstImg,
+                                                                     srcColorSpace,
+                                                                     dstColorSpace, copyBitmap);
+                break;
+            case eImageBitDepthNone:
+                break;
+            }
             break;
+        }
 
         case eImageBitDepthFloat: {
             switch ( getBitDepth() ) {
@@ -750,6 +885,9 @@ Image::convertToFormatCommon(const RectI & renderWindow,
                                                                                    dstColorSpace, copyBitmap);
                 break;
             case eImageBitDepthHalf:
+                convertToFormatInternal_sameComps<Half, float, 1, 1>(renderWindow, *this, *dstImg,
+                                                                     srcColorSpace,
+                                                                     dstColorSpace, copyBitmap);
                 break;
             case eImageBitDepthFloat:
                 ///Same as a copy
@@ -787,6 +925,12 @@ Image::convertToFormatCommon(const RectI & renderWindow,
                                                                                            copyBitmap, requiresUnpremult);
                 break;
             case eImageBitDepthHalf:
+                convertToFormatInternalForDepth<Half, unsigned char, 1, 255>(renderWindow, *this, *dstImg,
+                                                                             srcColorSpace,
+                                                                             dstColorSpace,
+                                                                             channelForAlpha,
+                                                                             useAlpha0,
+                                                                             copyBitmap, requiresUnpremult);
                 break;
             case eImageBitDepthFloat:
                 convertToFormatInternalForDepth<float, unsigned char, 1, 255>(renderWindow, *this, *dstImg,
@@ -823,6 +967,12 @@ Image::convertToFormatCommon(const RectI & renderWindow,
 
                 break;
             case eImageBitDepthHalf:
+                convertToFormatInternalForDepth<Half, unsigned short, 1, 65535>(renderWindow, *this, *dstImg,
+                                                                                srcColorSpace,
+                                                                                dstColorSpace,
+                                                                                channelForAlpha,
+                                                                                useAlpha0,
+                                                                                copyBitmap, requiresUnpremult);
                 break;
             case eImageBitDepthFloat:
                 convertToFormatInternalForDepth<float, unsigned short, 1, 65535>(renderWindow, *this, *dstImg,
@@ -837,8 +987,45 @@ Image::convertToFormatCommon(const RectI & renderWindow,
             }
             break;
         }
-        case eImageBitDepthHalf:
+        case eImageBitDepthHalf: {
+            switch ( getBitDepth() ) {
+            case eImageBitDepthByte:
+                convertToFormatInternalForDepth<unsigned char, Half, 255, 1>(renderWindow, *this, *dstImg,
+                                                                             srcColorSpace,
+                                                                             dstColorSpace,
+                                                                             channelForAlpha,
+                                                                             useAlpha0,
+                                                                             copyBitmap, requiresUnpremult);
+                break;
+            case eImageBitDepthShort:
+                convertToFormatInternalForDepth<unsigned short, Half, 65535, 1>(renderWindow, *this, *dstImg,
+                                                                                srcColorSpace,
+                                                                                dstColorSpace,
+                                                                                channelForAlpha,
+                                                                                useAlpha0,
+                                                                                copyBitmap, requiresUnpremult);
+                break;
+            case eImageBitDepthHalf:
+                convertToFormatInternalForDepth<Half, Half, 1, 1>(renderWindow, *this, *dstImg,
+                                                                  srcColorSpace,
+                                                                  dstColorSpace,
+                                                                  channelForAlpha,
+                                                                  useAlpha0,
+                                                                  copyBitmap, requiresUnpremult);
+                break;
+            case eImageBitDepthFloat:
+                convertToFormatInternalForDepth<float, Half, 1, 1>(renderWindow, *this, *dstImg,
+                                                                   srcColorSpace,
+                                                                   dstColorSpace,
+                                                                   channelForAlpha,
+                                                                   useAlpha0,
+                                                                   copyBitmap, requiresUnpremult);
+                break;
+            case eImageBitDepthNone:
+                break;
+            }
             break;
+        }
         case eImageBitDepthFloat: {
             switch ( getBitDepth() ) {
             case eImageBitDepthByte:
@@ -859,6 +1046,12 @@ Image::convertToFormatCommon(const RectI & renderWindow,
 
                 break;
             case eImageBitDepthHalf:
+                convertToFormatInternalForDepth<Half, float, 1, 1>(renderWindow, *this, *dstImg,
+                                                                   srcColorSpace,
+                                                                   dstColorSpace,
+                                                                   channelForAlpha,
+                                                                   useAlpha0,
+                                                                   copyBitmap, requiresUnpremult);
                 break;
             case eImageBitDepthFloat:
                 convertToFormatInternalForDepth<float, float, 1, 1>(renderWindow, *this, *dstImg,
@@ -122,7 +122,7 @@ Image::copyUnProcessedChannelsForPremult(const std::bitset<4> processChannels,
                // Just copy the channels, after all if the user unchecked a channel,
                // we do not want to change the values behind his back.
                // Rather we display a warning in  the GUI.
-#           define DOCHANNEL(c) dst_pixels[c] = (!src_pixels || c >= srcNComps) ? 0 : src_pixels[c];
+#           define DOCHANNEL(c) dst_pixels[c] = (!src_pixels || c >= srcNComps) ? PIX(0) : src_pixels[c];
 #         endif // !NATRON_COPY_CHANNELS_UNPREMULT
 
             if ( (dstNComps == 1) || (dstNComps == 4) ) {
@@ -685,6 +685,9 @@ Image::copyUnProcessedChannels(const RectI& roi,
     case eImageBitDepthShort:
         copyUnProcessedChannelsForDepth<unsigned short, 65535>(premult, roi, processChannels, originalImage, originalPremult, ignorePremult);
         break;
+    case eImageBitDepthHalf:
+        copyUnProcessedChannelsForDepth<Half, 1>(premult, roi, processChannels, originalImage, originalPremult, ignorePremult);
+        break;
     case eImageBitDepthFloat:
         copyUnProcessedChannelsForDepth<float, 1>(premult, roi, processChannels, originalImage, originalPremult, ignorePremult);
         break;
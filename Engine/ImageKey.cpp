@@ -97,4 +97,15 @@ ImageKey::operator==(const ImageKey & other) const
     }
 }
 
+ImageKey
+ImageKey::getKeyAtTime(double time) const
+{
+    ImageKey ret(*this);
+
+    ret._time = time;
+    ret.resetHash();
+
+    return ret;
+}
+
 NATRON_NAMESPACE_EXIT
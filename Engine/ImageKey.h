@@ -70,6 +70,12 @@ public:
 
     bool operator==(const ImageKey & other) const;
 
+    /**
+     * @brief Returns the key of the same image at another time. During playback the keys of the next frames
+     * are predicted this way from the key of the current frame.
+     **/
+    ImageKey getKeyAtTime(double time) const;
+
     double getTime() const
     {
         return _time;
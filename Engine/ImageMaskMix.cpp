@@ -143,6 +143,9 @@ Image::applyMaskMixForDstComponents(const RectI& roi,
     case eImageBitDepthShort:
         applyMaskMixForDepth<srcNComps, dstNComps, unsigned short, 65535>(roi, maskImg, originalImg, masked, maskInvert, mix);
         break;
+    case eImageBitDepthHalf:
+        applyMaskMixForDepth<srcNComps, dstNComps, Half, 1>(roi, maskImg, originalImg, masked, maskInvert, mix);
+        break;
     case eImageBitDepthFloat:
         applyMaskMixForDepth<srcNComps, dstNComps, float, 1>(roi, maskImg, originalImg, masked, maskInvert, mix);
         break;
@@ -402,31 +402,27 @@ Interpolation::solveQuartic(double c0,
     return num;
 } // solveQuartic
 
-/**
- * @brief Interpolates using the control points P0(t0,v0) , P3(t3,v3)
- * and the derivatives P1(t1,v1) (being the derivative at P0 with respect to
- * t \in [t1,t2]) and P2(t2,v2) (being the derivative at P3 with respect to
- * t \in [t1,t2]) the value at 'currentTime' using the
- * interpolation method "interp".
- * Note that for CATMULL-ROM you must use the function interpolate_catmullRom
- * which will compute the derivatives for you.
- **/
-double
-Interpolation::interpolate(double tcur,
-                           const double vcur,              //start control point
-                           const double vcurDerivRight, //being the derivative dv/dt at tcur
-                           const double vnextDerivLeft, //being the derivative dv/dt at tnext
-                           double tnext,
-                           const double vnext,               //end control point
-                           double currentTime,
-                           KeyframeTypeEnum interp,
-                           KeyframeTypeEnum interpNext)
+// compute the cubic coefficients used by interpolate() and interpolateMany(), for the
+// normalized time (currentTime - *tcur) / (*tnext - *tcur)
+static void
+interpolationCoeffs(double *tcur,
+                    const double vcur,
+                    const double vcurDerivRight,
+                    const double vnextDerivLeft,
+                    double *tnext,
+                    const double vnext,
+                    KeyframeTypeEnum interp,
+                    KeyframeTypeEnum interpNext,
+                    double *c0,
+                    double *c1,
+                    double *c2,
+                    double *c3)
 {
     double P0 = vcur;
     double P3 = vnext;
     // Hermite coefficients P0' and P3' are the derivatives with respect to x \in [0,1]
-    double P0pr = vcurDerivRight * (tnext - tcur); // normalize for x \in [0,1]
-    double P3pl = vnextDerivLeft * (tnext - tcur); // normalize for x \in [0,1]
+    double P0pr = vcurDerivRight * (*tnext - *tcur); // normalize for x \in [0,1]
+    double P3pl = vnextDerivLeft * (*tnext - *tcur); // normalize for x \in [0,1]
 
     // if the following is true, this makes the special case for eKeyframeTypeConstant at tnext useless, and we can always use a cubic - the strict "currentTime < tnext" is the key
     // commented-out: the following assert is not true for periodic curves and passing the flag to interpolate would only be required in NDEBUG
@@ -436,7 +432,7 @@ Interpolation::interpolate(double tcur,
         // virtual previous frame at t-1
         P0 = P3 - P3pl;
         P0pr = P3pl;
-        tcur = tnext - 1.;
+        *tcur = *tnext - 1.;
     } else if (interp == eKeyframeTypeConstant) {
         P0pr = 0.;
         P3pl = 0.;
@@ -446,10 +442,33 @@ Interpolation::interpolate(double tcur,
         // virtual next frame at t+1
         P3pl = P0pr;
         P3 = P0 + P0pr;
-        tnext = tcur + 1;
+        *tnext = *tcur + 1;
     }
+    hermiteToCubicCoeffs(P0, P0pr, P3pl, P3, c0, c1, c2, c3);
+}
+
+/**
+ * @brief Interpolates using the control points P0(t0,v0) , P3(t3,v3)
+ * and the derivatives P1(t1,v1) (being the derivative at P0 with respect to
+ * t \in [t1,t2]) and P2(t2,v2) (being the derivative at P3 with respect to
+ * t \in [t1,t2]) the value at 'currentTime' using the
+ * interpolation method "interp".
+ * Note that for CATMULL-ROM you must use the function interpolate_catmullRom
+ * which will compute the derivatives for you.
+ **/
+double
+Interpolation::interpolate(double tcur,
+                           const double vcur,              //start control point
+                           const double vcurDerivRight, //being the derivative dv/dt at tcur
+                           const double vnextDerivLeft, //being the derivative dv/dt at tnext
+                           double tnext,
+                           const double vnext,               //end control point
+                           double currentTime,
+                           KeyframeTypeEnum interp,
+                           KeyframeTypeEnum interpNext)
+{
     double c0, c1, c2, c3;
-    hermiteToCubicCoeffs(P0, P0pr, P3pl, P3, &c0, &c1, &c2, &c3);
+    interpolationCoeffs(&tcur, vcur, vcurDerivRight, vnextDerivLeft, &tnext, vnext, interp, interpNext, &c0, &c1, &c2, &c3);
 
     const double t = (currentTime - tcur) / (tnext - tcur);
     double ret = cubicEval(c0, c1, c2, c3, t);
@@ -460,6 +479,33 @@ Interpolation::interpolate(double tcur,
     return ret;
 }
 
+void
+Interpolation::interpolateMany(double tcur,
+                               const double vcur,              //start control point
+                               const double vcurDerivRight, //being the derivative dv/dt at tcur
+                               const double vnextDerivLeft, //being the derivative dv/dt at tnext
+                               double tnext,
+                               const double vnext,               //end control point
+                               const double* times,
+                               double* values,
+                               std::size_t n,
+                               KeyframeTypeEnum interp,
+                               KeyframeTypeEnum interpNext)
+{
+    double c0, c1, c2, c3;
+    interpolationCoeffs(&tcur, vcur, vcurDerivRight, vnextDerivLeft, &tnext, vnext, interp, interpNext, &c0, &c1, &c2, &c3);
+
+    const double duration = tnext - tcur;
+    // Same operations as cubicEval(), without the branches so that the loop can be vectorized.
+    // The terms with a null coefficient add a signed zero, which leaves the result unchanged for finite times.
+    for (std::size_t i = 0; i < n; ++i) {
+        const double t = (times[i] - tcur) / duration;
+        const double t2 = t * t;
+        const double t3 = t2 * t;
+        values[i] = c0 + c1 * t + c2 * t2 + c3 * t3;
+    }
+}
+
 /// derive at currentTime. The derivative is with respect to currentTime
 double
 Interpolation::derive(double tcur,
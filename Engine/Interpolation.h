@@ -28,6 +28,8 @@
 
 #include "Global/Macros.h"
 
+#include <cstddef>
+
 #include "Global/Enums.h"
 #include "Engine/EngineFwd.h"
 
@@ -50,6 +52,21 @@ double interpolate(double tcur, const double vcur, //start control point
                    KeyframeTypeEnum interp,
                    KeyframeTypeEnum interpNext) WARN_UNUSED_RETURN;
 
+/**
+ * @brief Same as interpolate() for the n times in the 'times' array, which should all lie in the same segment.
+ * The cubic is computed once and evaluated in a loop that the compiler can vectorize.
+ * 'times' and 'values' may be the same array.
+ **/
+void interpolateMany(double tcur, const double vcur, //start control point
+                     const double vcurDerivRight, //being the derivative dv/dt at tcur
+                     const double vnextDerivLeft, //being the derivative dv/dt at tnext
+                     double tnext, const double vnext, //end control point
+                     const double* times,
+                     double* values,
+                     std::size_t n,
+                     KeyframeTypeEnum interp,
+                     KeyframeTypeEnum interpNext);
+
 /// derive at currentTime. The derivative is with respect to currentTime
 double derive(double tcur, const double vcur, //start control point
               const double vcurDerivRight, //being the derivative dv/dt at tcur
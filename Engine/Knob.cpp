@@ -31,6 +31,7 @@
 #include <stdexcept>
 #include <sstream> // stringstream
 #include <cctype> // isspace
+#include <cmath> // floor
 
 #include <QtCore/QDataStream>
 #include <QtCore/QDateTime>
@@ -48,6 +49,7 @@
 #include "Engine/Hash64.h"
 #include "Engine/KnobFile.h"
 #include "Engine/KnobGuiI.h"
+#include "Engine/KnobNativeExpression.h"
 #include "Engine/KnobSerialization.h"
 #include "Engine/KnobTypes.h"
 #include "Engine/LibraryBinary.h"
@@ -370,10 +372,16 @@ struct Expr
     ///The list of pair<knob, dimension> dpendencies for an expression
     std::list<std::pair<KnobIWPtr, int> > dependencies;
 
-    //PyObject* code;
+    ///The call to the expression function compiled once when the expression is set, new ref.
+    ///frame and view are bound as local variables when evaluated.
+    ///Only modified with the Python GIL held.
+    PyObject* code;
+
+    ///The expression parsed to be evaluated without Python, NULL if it uses unsupported syntax
+    KnobNativeExpressionPtr native;
 
     Expr()
-        : expression(), originalExpression(), exprInvalid(), hasRet(false) /*, code(0)*/ {}
+        : expression(), originalExpression(), exprInvalid(), hasRet(false), dependencies(), code(0), native() {}
 };
 
 struct KnobHelperPrivate
@@ -579,6 +587,20 @@ KnobHelper::KnobHelper(KnobHolder* holder,
 
 KnobHelper::~KnobHelper()
 {
+    bool hasCompiledExpression = false;
+    for (std::size_t i = 0; i < _imp->expressions.size(); ++i) {
+        if (_imp->expressions[i].code) {
+            hasCompiledExpression = true;
+        }
+    }
+    // The interpreter may already be finalized when the application quits
+    if ( hasCompiledExpression && Py_IsInitialized() ) {
+        PythonGILLocker pgl;
+        for (std::size_t i = 0; i < _imp->expressions.size(); ++i) {
+            Py_XDECREF(_imp->expressions[i].code);
+            _imp->expressions[i].code = 0;
+        }
+    }
 }
 
 void
@@ -2855,6 +2877,26 @@ KnobHelper::setExpressionInternal(int dimension,
         }
     }
 
+    ///Compile once the call to the expression function so that evaluating it does not parse any script.
+    ///If it fails, executeExpression() falls back on interpreting the script.
+    PyObject* code = 0;
+    if ( exprInvalid.empty() ) {
+        try {
+            NATRON_PYTHON_NAMESPACE::compilePyScript(exprCpy + "(frame, view)\n", &code);
+            assert(code);
+        } catch (const std::exception& /*e*/) {
+            PyErr_Clear();
+            Py_XDECREF(code);
+            code = 0;
+        }
+    }
+
+    ///Single-line expressions on numeric parameters may also be evaluated natively, without the GIL
+    KnobNativeExpressionPtr native;
+    if ( exprInvalid.empty() && !hasRetVariable && isTypePOD() ) {
+        native = KnobNativeExpression::parse( expression, shared_from_this(), dimension );
+    }
+
     //Set internal fields
 
     {
@@ -2863,9 +2905,8 @@ KnobHelper::setExpressionInternal(int dimension,
         _imp->expressions[dimension].expression = exprCpy;
         _imp->expressions[dimension].originalExpression = expression;
         _imp->expressions[dimension].exprInvalid = exprInvalid;
-
-        ///This may throw an exception upon failure
-        //NATRON_PYTHON_NAMESPACE::compilePyScript(exprCpy, &_imp->expressions[dimension].code);
+        _imp->expressions[dimension].code = code;
+        _imp->expressions[dimension].native = native;
     }
 
     if ( getHolder() ) {
@@ -2955,8 +2996,9 @@ KnobHelper::clearExpression(int dimension,
         _imp->expressions[dimension].expression.clear();
         _imp->expressions[dimension].originalExpression.clear();
         _imp->expressions[dimension].exprInvalid.clear();
-        //Py_XDECREF(_imp->expressions[dimension].code); //< new ref
-        //_imp->expressions[dimension].code = 0;
+        Py_XDECREF(_imp->expressions[dimension].code); //< new ref
+        _imp->expressions[dimension].code = 0;
+        _imp->expressions[dimension].native.reset();
     }
     KnobIPtr thisShared = shared_from_this();
     {
@@ -3066,6 +3108,35 @@ catchErrors(PyObject* mainModule,
     return true;
 }
 
+bool
+KnobHelper::executeNativeExpression(double time,
+                                    ViewIdx view,
+                                    int dimension,
+                                    double* ret) const
+{
+    KnobNativeExpressionPtr native;
+    {
+        QMutexLocker k(&_imp->expressionMutex);
+        native = _imp->expressions[dimension].native;
+    }
+    if (!native) {
+        return false;
+    }
+
+    return native->evaluate(time, view, ret);
+}
+
+bool
+KnobHelper::isExpressionNative(int dimension) const
+{
+    if ( (dimension < 0) || ( dimension >= (int)_imp->expressions.size() ) ) {
+        return false;
+    }
+    QMutexLocker k(&_imp->expressionMutex);
+
+    return (bool)_imp->expressions[dimension].native;
+}
+
 ///The return value must be Py_DECRREF
 /// The Python GIL must be held before calling this, so the the PyObject remains valid.
 bool
@@ -3076,15 +3147,84 @@ KnobHelper::executeExpression(double time,
                               std::string* error) const
 {
     std::string expr;
+    PyObject* code;
     {
         QMutexLocker k(&_imp->expressionMutex);
-        expr = _imp->expressions[dimension].expression;
+        code = _imp->expressions[dimension].code;
+        // Keep the code alive even if the expression is changed while it is evaluated
+        Py_XINCREF(code);
+        if (!code) {
+            expr = _imp->expressions[dimension].expression;
+        }
     }
-    std::stringstream ss;
+    if (!code) {
+        std::stringstream ss;
+
+        ss << expr << '(' << time << ", " <<  view << ")\n";
 
-    ss << expr << '(' << time << ", " <<  view << ")\n";
+        return executeExpression(ss.str(), ret, error);
+    }
+
+    bool ok = executeCompiledExpression(code, time, view, ret, error);
+    Py_DECREF(code);
+
+    return ok;
+}
+
+/// The return value must be Py_DECRREF
+/// The Python GIL must be held before calling this, so the the PyObject remains valid.
+bool
+KnobHelper::executeCompiledExpression(PyObject* code,
+                                      double time,
+                                      ViewIdx view,
+                                      PyObject** ret,
+                                      std::string* error)
+{
+#if PY_VERSION_HEX >= 0x030400F0
+    assert(PyGILState_Check());  // Not available prior to Python 3.4
+#endif
+    assert(code);
 
-    return executeExpression(ss.str(), ret, error);
+    PyObject* mainModule = NATRON_PYTHON_NAMESPACE::getMainModule();
+    PyObject* globalDict = PyModule_GetDict(mainModule);
+
+    // Bind frame and view as locals. An integer frame is passed as an int, as it was when the
+    // call was formatted in the script, so that expressions may use it as an index.
+    PyObject* localDict = PyDict_New();
+    PyObject* frameObj = ( time == std::floor(time) ) ? PyLong_FromLong( (long)time ) : PyFloat_FromDouble(time);
+    PyObject* viewObj = PyLong_FromLong( (int)view );
+    PyDict_SetItemString(localDict, "frame", frameObj);
+    PyDict_SetItemString(localDict, "view", viewObj);
+    Py_DECREF(frameObj);
+    Py_DECREF(viewObj);
+
+    PyErr_Clear();
+
+#if PY_MAJOR_VERSION >= 3
+    PyObject* v = PyEval_EvalCode(code, globalDict, localDict);
+#else
+    PyObject* v = PyEval_EvalCode( (PyCodeObject*)code, globalDict, localDict );
+#endif
+    Py_XDECREF(v);
+
+    *ret = 0;
+
+    if ( !catchErrors(mainModule, error) ) {
+        Py_DECREF(localDict);
+
+        return false;
+    }
+    // The compiled script assigns the result of the expression function to ret, in the local dict
+    *ret = PyDict_GetItemString(localDict, "ret"); // borrowed ref
+    Py_XINCREF(*ret);
+    Py_DECREF(localDict);
+    if (!*ret) {
+        *error = "Missing 'ret' attribute";
+
+        return false;
+    }
+
+    return true;
 }
 
 
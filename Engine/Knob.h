@@ -1631,13 +1631,25 @@ protected:
     /// The Python GIL must be held before calling this, so the the PyObject remains valid.
     bool executeExpression(double time, ViewIdx view, int dimension, PyObject** ret, std::string* error) const;
 
+    /// Evaluates the expression without Python if it only uses syntax supported by KnobNativeExpression.
+    /// This does not need the Python GIL. Returns false if the expression must be run by Python instead.
+    bool executeNativeExpression(double time, ViewIdx view, int dimension, double* ret) const;
+
 public:
 
+    /// Returns true if the expression at the given dimension is evaluated without Python
+    bool isExpressionNative(int dimension) const WARN_UNUSED_RETURN;
+
     /// The return value must be Py_DECRREF
     /// The expression must put its result in the Python variable named "ret"
     /// The Python GIL must be held before calling this, so the the PyObject remains valid.
     static bool executeExpression(const std::string& expr, PyObject** ret, std::string* error);
 
+    /// The return value must be Py_DECRREF
+    /// Evaluates an expression compiled by setExpressionInternal(), with frame and view bound as local variables.
+    /// The Python GIL must be held before calling this, so the the PyObject remains valid.
+    static bool executeCompiledExpression(PyObject* code, double time, ViewIdx view, PyObject** ret, std::string* error);
+
     virtual std::pair<int, KnobIPtr> getMaster(int dimension) const OVERRIDE FINAL WARN_UNUSED_RETURN;
     virtual bool isSlave(int dimension) const OVERRIDE FINAL WARN_UNUSED_RETURN;
     virtual NATRON_ENUM::AnimationLevelEnum getAnimationLevel(int dimension) const OVERRIDE FINAL WARN_UNUSED_RETURN;
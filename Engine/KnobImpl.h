@@ -432,6 +432,25 @@ Knob<T>::evaluateExpression(const std::string& expr,
     return true;
 }
 
+template <typename T>
+inline bool
+nativeExpressionResultToType(double v,
+                             T* ret)
+{
+    *ret = (T)v;
+
+    return true;
+}
+
+template <>
+inline bool
+nativeExpressionResultToType(double /*v*/,
+                             std::string* /*ret*/)
+{
+    // string parameters expressions are never evaluated natively
+    return false;
+}
+
 template <typename T>
 bool
 Knob<T>::evaluateExpression(double time,
@@ -440,6 +459,12 @@ Knob<T>::evaluateExpression(double time,
                             T* value,
                             std::string* error)
 {
+    ///Try first without Python, so that render threads do not contend on the GIL
+    double nativeRet;
+    if ( executeNativeExpression(time, view, dimension, &nativeRet) && nativeExpressionResultToType<T>(nativeRet, value) ) {
+        return true;
+    }
+
     PythonGILLocker pgl;
     PyObject *ret;
 
@@ -462,6 +487,11 @@ Knob<T>::evaluateExpression_pod(double time,
                                 double* value,
                                 std::string* error)
 {
+    ///Try first without Python, so that render threads do not contend on the GIL
+    if ( executeNativeExpression(time, view, dimension, value) ) {
+        return true;
+    }
+
     PythonGILLocker pgl;
     PyObject *ret;
 
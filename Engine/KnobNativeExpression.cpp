@@ -0,0 +1,1253 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * (C) 2018-2023 The Natron developers
+ * (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "KnobNativeExpression.h"
+
+#include <algorithm> // min, max
+#include <cassert>
+#include <cctype> // isdigit, isalpha
+#include <cmath>
+#include <cstring> // strlen
+#include <locale>
+#include <sstream> // istringstream
+
+#include "Engine/EffectInstance.h"
+#include "Engine/Knob.h"
+#include "Engine/KnobTypes.h"
+#include "Engine/Node.h"
+#include "Engine/NodeGroup.h"
+#include "Engine/PyExprUtils.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846264338327950288
+#endif
+#ifndef M_E
+#define M_E 2.71828182845904523536028747135266250
+#endif
+
+NATRON_NAMESPACE_ENTER
+
+namespace {
+
+enum ExprFunctionEnum
+{
+    // builtins
+    eExprFunctionAbs = 0,
+    eExprFunctionMin,
+    eExprFunctionMax,
+    eExprFunctionRound,
+    eExprFunctionInt,
+    eExprFunctionFloat,
+    eExprFunctionBool,
+
+    // math module
+    eExprFunctionSin,
+    eExprFunctionCos,
+    eExprFunctionTan,
+    eExprFunctionAsin,
+    eExprFunctionAcos,
+    eExprFunctionAtan,
+    eExprFunctionAtan2,
+    eExprFunctionSinh,
+    eExprFunctionCosh,
+    eExprFunctionTanh,
+    eExprFunctionExp,
+    eExprFunctionLog,
+    eExprFunctionLog10,
+    eExprFunctionLog2,
+    eExprFunctionSqrt,
+    eExprFunctionPow,
+    eExprFunctionFabs,
+    eExprFunctionFloor,
+    eExprFunctionCeil,
+    eExprFunctionTrunc,
+    eExprFunctionFmod,
+    eExprFunctionHypot,
+    eExprFunctionDegrees,
+    eExprFunctionRadians,
+    eExprFunctionCopysign,
+
+    // ExprUtils
+    eExprFunctionBoxstep,
+    eExprFunctionLinearstep,
+    eExprFunctionSmoothstep,
+    eExprFunctionGaussstep,
+    eExprFunctionRemap,
+    eExprFunctionMix,
+    eExprFunctionNoise
+};
+
+struct ExprFunctionDesc
+{
+    const char* name;
+    ExprFunctionEnum function;
+    int minArgs;
+    int maxArgs; // -1 = unbounded
+};
+
+// Functions available without prefix: Python builtins and "from math import *" done by AppManager
+const ExprFunctionDesc globalFunctions[] = {
+    {"abs", eExprFunctionAbs, 1, 1},
+    {"min", eExprFunctionMin, 2, -1},
+    {"max", eExprFunctionMax, 2, -1},
+    {"round", eExprFunctionRound, 1, 1},
+    {"int", eExprFunctionInt, 1, 1},
+    {"float", eExprFunctionFloat, 1, 1},
+    {"bool", eExprFunctionBool, 1, 1},
+    {"sin", eExprFunctionSin, 1, 1},
+    {"cos", eExprFunctionCos, 1, 1},
+    {"tan", eExprFunctionTan, 1, 1},
+    {"asin", eExprFunctionAsin, 1, 1},
+    {"acos", eExprFunctionAcos, 1, 1},
+    {"atan", eExprFunctionAtan, 1, 1},
+    {"atan2", eExprFunctionAtan2, 2, 2},
+    {"sinh", eExprFunctionSinh, 1, 1},
+    {"cosh", eExprFunctionCosh, 1, 1},
+    {"tanh", eExprFunctionTanh, 1, 1},
+    {"exp", eExprFunctionExp, 1, 1},
+    {"log", eExprFunctionLog, 1, 2},
+    {"log10", eExprFunctionLog10, 1, 1},
+    {"log2", eExprFunctionLog2, 1, 1},
+    {"sqrt", eExprFunctionSqrt, 1, 1},
+    {"pow", eExprFunctionPow, 2, 2},
+    {"fabs", eExprFunctionFabs, 1, 1},
+    {"floor", eExprFunctionFloor, 1, 1},
+    {"ceil", eExprFunctionCeil, 1, 1},
+    {"trunc", eExprFunctionTrunc, 1, 1},
+    {"fmod", eExprFunctionFmod, 2, 2},
+    {"hypot", eExprFunctionHypot, 2, 2},
+    {"degrees", eExprFunctionDegrees, 1, 1},
+    {"radians", eExprFunctionRadians, 1, 1},
+    {"copysign", eExprFunctionCopysign, 2, 2},
+    {0, eExprFunctionAbs, 0, 0}
+};
+
+// Scalar functions of the ExprUtils class
+const ExprFunctionDesc exprUtilsFunctions[] = {
+    {"boxstep", eExprFunctionBoxstep, 2, 2},
+    {"linearstep", eExprFunctionLinearstep, 3, 3},
+    {"smoothstep", eExprFunctionSmoothstep, 3, 3},
+    {"gaussstep", eExprFunctionGaussstep, 3, 3},
+    {"remap", eExprFunctionRemap, 5, 5},
+    {"mix", eExprFunctionMix, 3, 3},
+    {"noise", eExprFunctionNoise, 1, 1},
+    {0, eExprFunctionAbs, 0, 0}
+};
+
+const ExprFunctionDesc*
+findFunction(const ExprFunctionDesc* table,
+             const std::string& name)
+{
+    for (const ExprFunctionDesc* f = table; f->name; ++f) {
+        if (name == f->name) {
+            return f;
+        }
+    }
+
+    return 0;
+}
+
+enum ExprTokenTypeEnum
+{
+    eExprTokenNumber = 0,
+    eExprTokenIdentifier,
+    eExprTokenOperator,
+    eExprTokenEnd
+};
+
+struct ExprToken
+{
+    ExprTokenTypeEnum type;
+    std::string text;
+    double value;
+};
+
+bool
+tokenize(const std::string& expr,
+         std::vector<ExprToken>* tokens)
+{
+    std::size_t i = 0;
+    const std::size_t n = expr.size();
+
+    while (i < n) {
+        char c = expr[i];
+        if ( (c == ' ') || (c == '\t') || (c == '\r') ) {
+            ++i;
+            continue;
+        }
+        ExprToken tok;
+        tok.value = 0.;
+        if ( std::isdigit( (unsigned char)c ) || ( (c == '.') && (i + 1 < n) && std::isdigit( (unsigned char)expr[i + 1] ) ) ) {
+            // scan the literal ourselves: strtod depends on the locale
+            std::size_t start = i;
+            while ( i < n && ( std::isdigit( (unsigned char)expr[i] ) || (expr[i] == '.') ) ) {
+                ++i;
+            }
+            if ( (i < n) && ( (expr[i] == 'e') || (expr[i] == 'E') ) ) {
+                std::size_t expStart = i + 1;
+                if ( (expStart < n) && ( (expr[expStart] == '+') || (expr[expStart] == '-') ) ) {
+                    ++expStart;
+                }
+                if ( (expStart < n) && std::isdigit( (unsigned char)expr[expStart] ) ) {
+                    i = expStart;
+                    while ( i < n && std::isdigit( (unsigned char)expr[i] ) ) {
+                        ++i;
+                    }
+                }
+            }
+            // hexadecimal, complex, 1_000 or 1.real are left to Python
+            if ( (i < n) && ( std::isalpha( (unsigned char)expr[i] ) || (expr[i] == '_') ) ) {
+                return false;
+            }
+            tok.text = expr.substr(start, i - start);
+            // leading zeroes in integers are a syntax error in Python 3
+            if ( (tok.text.size() > 1) && (tok.text[0] == '0') && std::isdigit( (unsigned char)tok.text[1] ) ) {
+                return false;
+            }
+            std::istringstream ss(tok.text);
+            ss.imbue( std::locale::classic() );
+            ss >> tok.value;
+            if ( ss.fail() || !ss.eof() ) {
+                // e.g. 1.2.3
+                return false;
+            }
+            tok.type = eExprTokenNumber;
+        } else if ( std::isalpha( (unsigned char)c ) || (c == '_') ) {
+            std::size_t start = i;
+            while ( i < n && ( std::isalnum( (unsigned char)expr[i] ) || (expr[i] == '_') ) ) {
+                ++i;
+            }
+            tok.type = eExprTokenIdentifier;
+            tok.text = expr.substr(start, i - start);
+        } else {
+            static const char* const operators[] = {
+                "**", "//", "<=", ">=", "==", "!=",
+                "+", "-", "*", "/", "%", "<", ">", "(", ")", "[", "]", ",", ".",
+                0
+            };
+            const char* found = 0;
+            for (const char* const* op = operators; *op; ++op) {
+                if (expr.compare(i, std::strlen(*op), *op) == 0) {
+                    found = *op;
+                    break;
+                }
+            }
+            if (!found) {
+                // strings, assignments, lambdas, etc. are left to Python
+                return false;
+            }
+            tok.type = eExprTokenOperator;
+            tok.text = found;
+            i += tok.text.size();
+        }
+        tokens->push_back(tok);
+    }
+    ExprToken end;
+    end.type = eExprTokenEnd;
+    end.value = 0.;
+    tokens->push_back(end);
+
+    return true;
+} // tokenize
+
+bool
+isKnobTypeSupported(KnobI* knob)
+{
+    return dynamic_cast<KnobDoubleBase*>(knob) || dynamic_cast<KnobIntBase*>(knob) || dynamic_cast<KnobBoolBase*>(knob);
+}
+
+bool
+getKnobValue(KnobI* knob,
+             int dimension,
+             bool atTime,
+             double time,
+             double* ret)
+{
+    if ( (dimension < 0) || ( dimension >= knob->getDimension() ) ) {
+        return false;
+    }
+    if ( KnobDoubleBase* isDouble = dynamic_cast<KnobDoubleBase*>(knob) ) {
+        *ret = atTime ? isDouble->getValueAtTime(time, dimension) : isDouble->getValue(dimension);
+    } else if ( KnobIntBase* isInt = dynamic_cast<KnobIntBase*>(knob) ) {
+        *ret = atTime ? isInt->getValueAtTime(time, dimension) : isInt->getValue(dimension);
+    } else if ( KnobBoolBase* isBool = dynamic_cast<KnobBoolBase*>(knob) ) {
+        *ret = ( atTime ? isBool->getValueAtTime(time, dimension) : isBool->getValue(dimension) ) ? 1. : 0.;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+bool
+asIndex(double v,
+        int* index)
+{
+    // Python only accepts integers as subscripts and dimensions
+    if ( v != std::floor(v) ) {
+        return false;
+    }
+    *index = (int)v;
+
+    return true;
+}
+} // anon namespace
+
+/**
+ * @brief Recursive descent parser following the Python grammar precedences:
+ * ternary < or < and < not < comparison < +,- < *,/,//,% < unary -,+ < **
+ **/
+class KnobNativeExpressionParser
+{
+public:
+
+    KnobNativeExpressionParser(const std::vector<ExprToken>& tokens,
+                               KnobNativeExpression* expr,
+                               const KnobIPtr& thisParam,
+                               int dimension)
+        : _tokens(tokens)
+        , _pos(0)
+        , _expr(expr)
+        , _thisParam(thisParam)
+        , _thisNode()
+        , _thisGroup()
+        , _dimension(dimension)
+    {
+        EffectInstance* effect = dynamic_cast<EffectInstance*>( thisParam->getHolder() );
+        if (effect) {
+            _thisNode = effect->getNode();
+            if (_thisNode) {
+                _thisGroup = _thisNode->getGroup();
+            }
+        }
+    }
+
+    bool parse()
+    {
+        int root = parseTernary();
+
+        if ( (root < 0) || (peek().type != eExprTokenEnd) ) {
+            return false;
+        }
+        _expr->_root = root;
+
+        return true;
+    }
+
+private:
+
+    const ExprToken& peek(int offset = 0) const
+    {
+        std::size_t i = std::min(_pos + offset, _tokens.size() - 1);
+
+        return _tokens[i];
+    }
+
+    bool isOperator(const char* op,
+                    int offset = 0) const
+    {
+        const ExprToken& tok = peek(offset);
+
+        return tok.type == eExprTokenOperator && tok.text == op;
+    }
+
+    bool isKeyword(const char* kw,
+                   int offset = 0) const
+    {
+        const ExprToken& tok = peek(offset);
+
+        return tok.type == eExprTokenIdentifier && tok.text == kw;
+    }
+
+    bool acceptOperator(const char* op)
+    {
+        if ( isOperator(op) ) {
+            ++_pos;
+
+            return true;
+        }
+
+        return false;
+    }
+
+    int addNode(const KnobNativeExpression::ExprNode& node)
+    {
+        _expr->_nodes.push_back(node);
+
+        return (int)_expr->_nodes.size() - 1;
+    }
+
+    int addConstant(double value)
+    {
+        KnobNativeExpression::ExprNode node;
+
+        node.op = KnobNativeExpression::eExprOpConstant;
+        node.value = value;
+
+        return addNode(node);
+    }
+
+    // Adds an operation on the given operands, fails if any of them failed to parse
+    int addOp(KnobNativeExpression::ExprOpEnum op,
+              int nOperands,
+              int a,
+              int b = 0,
+              int c = 0)
+    {
+        const int operands[3] = {a, b, c};
+        KnobNativeExpression::ExprNode node;
+
+        node.op = op;
+        for (int i = 0; i < nOperands; ++i) {
+            if (operands[i] < 0) {
+                return -1;
+            }
+            node.args.push_back(operands[i]);
+        }
+
+        return addNode(node);
+    }
+
+    int parseTernary()
+    {
+        int value = parseOr();
+
+        if ( (value < 0) || !isKeyword("if") ) {
+            return value;
+        }
+        ++_pos;
+        int cond = parseOr();
+        if ( (cond < 0) || !isKeyword("else") ) {
+            return -1;
+        }
+        ++_pos;
+        int otherwise = parseTernary();
+        if (otherwise < 0) {
+            return -1;
+        }
+
+        return addOp(KnobNativeExpression::eExprOpIfElse, 3, cond, value, otherwise);
+    }
+
+    int parseOr()
+    {
+        int lhs = parseAnd();
+
+        while ( lhs >= 0 && isKeyword("or") ) {
+            ++_pos;
+            int rhs = parseAnd();
+            if (rhs < 0) {
+                return -1;
+            }
+            lhs = addOp(KnobNativeExpression::eExprOpOr, 2, lhs, rhs);
+        }
+
+        return lhs;
+    }
+
+    int parseAnd()
+    {
+        int lhs = parseNot();
+
+        while ( lhs >= 0 && isKeyword("and") ) {
+            ++_pos;
+            int rhs = parseNot();
+            if (rhs < 0) {
+                return -1;
+            }
+            lhs = addOp(KnobNativeExpression::eExprOpAnd, 2, lhs, rhs);
+        }
+
+        return lhs;
+    }
+
+    int parseNot()
+    {
+        if ( isKeyword("not") ) {
+            ++_pos;
+            int operand = parseNot();
+            if (operand < 0) {
+                return -1;
+            }
+
+            return addOp(KnobNativeExpression::eExprOpNot, 1, operand);
+        }
+
+        return parseComparison();
+    }
+
+    bool acceptComparisonOperator(KnobNativeExpression::ExprOpEnum* op)
+    {
+        if ( acceptOperator("<") ) {
+            *op = KnobNativeExpression::eExprOpLess;
+        } else if ( acceptOperator("<=") ) {
+            *op = KnobNativeExpression::eExprOpLessEqual;
+        } else if ( acceptOperator(">") ) {
+            *op = KnobNativeExpression::eExprOpGreater;
+        } else if ( acceptOperator(">=") ) {
+            *op = KnobNativeExpression::eExprOpGreaterEqual;
+        } else if ( acceptOperator("==") ) {
+            *op = KnobNativeExpression::eExprOpEqual;
+        } else if ( acceptOperator("!=") ) {
+            *op = KnobNativeExpression::eExprOpNotEqual;
+        } else {
+            return false;
+        }
+
+        return true;
+    }
+
+    int parseComparison()
+    {
+        int lhs = parseArith();
+
+        if (lhs < 0) {
+            return -1;
+        }
+        KnobNativeExpression::ExprOpEnum op;
+        if ( !acceptComparisonOperator(&op) ) {
+            return lhs;
+        }
+        int rhs = parseArith();
+        if (rhs < 0) {
+            return -1;
+        }
+        // Chained comparisons (a < b < c) are left to Python
+        KnobNativeExpression::ExprOpEnum chained;
+        if ( acceptComparisonOperator(&chained) ) {
+            return -1;
+        }
+
+        return addOp(op, 2, lhs, rhs);
+    }
+
+    int parseArith()
+    {
+        int lhs = parseTerm();
+
+        while (lhs >= 0) {
+            if ( acceptOperator("+") ) {
+                lhs = addOp( KnobNativeExpression::eExprOpAdd, 2, lhs, parseTerm() );
+            } else if ( acceptOperator("-") ) {
+                lhs = addOp( KnobNativeExpression::eExprOpSub, 2, lhs, parseTerm() );
+            } else {
+                break;
+            }
+        }
+
+        return lhs;
+    }
+
+    int parseTerm()
+    {
+        int lhs = parseUnary();
+
+        while (lhs >= 0) {
+            if ( acceptOperator("*") ) {
+                lhs = addOp( KnobNativeExpression::eExprOpMul, 2, lhs, parseUnary() );
+            } else if ( acceptOperator("/") ) {
+                lhs = addOp( KnobNativeExpression::eExprOpDiv, 2, lhs, parseUnary() );
+            } else if ( acceptOperator("//") ) {
+                lhs = addOp( KnobNativeExpression::eExprOpFloorDiv, 2, lhs, parseUnary() );
+            } else if ( acceptOperator("%") ) {
+                lhs = addOp( KnobNativeExpression::eExprOpMod, 2, lhs, parseUnary() );
+            } else {
+                break;
+            }
+        }
+
+        return lhs;
+    }
+
+    int parseUnary()
+    {
+        if ( acceptOperator("-") ) {
+            return addOp( KnobNativeExpression::eExprOpNeg, 1, parseUnary() );
+        } else if ( acceptOperator("+") ) {
+            return parseUnary();
+        }
+
+        return parsePower();
+    }
+
+    int parsePower()
+    {
+        int base = parseAtom();
+
+        if ( (base >= 0) && acceptOperator("**") ) {
+            // right associative, and binds less tightly than a unary operator on its right: 2**-1
+            return addOp( KnobNativeExpression::eExprOpPow, 2, base, parseUnary() );
+        }
+
+        return base;
+    }
+
+    bool parseArguments(std::vector<int>* args)
+    {
+        if ( !acceptOperator("(") ) {
+            return false;
+        }
+        if ( acceptOperator(")") ) {
+            return true;
+        }
+        for (;;) {
+            int arg = parseTernary();
+            if (arg < 0) {
+                return false;
+            }
+            args->push_back(arg);
+            if ( acceptOperator(")") ) {
+                return true;
+            }
+            if ( !acceptOperator(",") ) {
+                return false;
+            }
+        }
+    }
+
+    int parseFunctionCall(const ExprFunctionDesc* desc)
+    {
+        KnobNativeExpression::ExprNode node;
+
+        node.op = KnobNativeExpression::eExprOpFunction;
+        node.function = (int)desc->function;
+        if ( !parseArguments(&node.args) ) {
+            return -1;
+        }
+        int nArgs = (int)node.args.size();
+        if ( ( nArgs < desc->minArgs) || ( (desc->maxArgs != -1) && (nArgs > desc->maxArgs) ) ) {
+            return -1;
+        }
+
+        return addNode(node);
+    }
+
+    int parseAtom()
+    {
+        const ExprToken tok = peek();
+
+        if (tok.type == eExprTokenNumber) {
+            ++_pos;
+
+            return addConstant(tok.value);
+        } else if ( acceptOperator("(") ) {
+            int inner = parseTernary();
+            if ( (inner < 0) || !acceptOperator(")") ) {
+                return -1;
+            }
+
+            return inner;
+        } else if (tok.type != eExprTokenIdentifier) {
+            return -1;
+        }
+
+        const std::string& name = tok.text;
+
+        // Sibling nodes are declared after the builtins and shadow them
+        NodePtr sibling = getSiblingNode(name);
+        if (sibling) {
+            ++_pos;
+
+            return parseNodeReference(sibling);
+        }
+
+        if ( isOperator("(", 1) ) {
+            const ExprFunctionDesc* desc = findFunction(globalFunctions, name);
+            if (!desc) {
+                return -1;
+            }
+            ++_pos;
+
+            return parseFunctionCall(desc);
+        }
+
+        if ( (name == "ExprUtils") || (name == "NatronEngine") ) {
+            ++_pos;
+            if (name == "NatronEngine") {
+                if ( !acceptOperator(".") || !isKeyword("ExprUtils") ) {
+                    return -1;
+                }
+                ++_pos;
+            }
+            if ( !acceptOperator(".") || (peek().type != eExprTokenIdentifier) ) {
+                return -1;
+            }
+            const ExprFunctionDesc* desc = findFunction(exprUtilsFunctions, peek().text);
+            if (!desc) {
+                return -1;
+            }
+            ++_pos;
+
+            return parseFunctionCall(desc);
+        }
+
+        ++_pos;
+        if (name == "frame") {
+            KnobNativeExpression::ExprNode node;
+            node.op = KnobNativeExpression::eExprOpFrame;
+
+            return addNode(node);
+        } else if (name == "view") {
+            KnobNativeExpression::ExprNode node;
+            node.op = KnobNativeExpression::eExprOpView;
+
+            return addNode(node);
+        } else if (name == "dimension") {
+            return addConstant(_dimension);
+        } else if (name == "True") {
+            return addConstant(1.);
+        } else if (name == "False") {
+            return addConstant(0.);
+        } else if (name == "pi") {
+            return addConstant(M_PI);
+        } else if (name == "e") {
+            return addConstant(M_E);
+        } else if (name == "tau") {
+            return addConstant(2. * M_PI);
+        } else if (name == "thisParam") {
+            return parseKnobMethod(_thisParam, NodePtr());
+        } else if (name == "thisNode") {
+            if (!_thisNode) {
+                return -1;
+            }
+
+            return parseNodeReference(_thisNode);
+        } else if (name == "thisGroup") {
+            if ( !_thisGroup || !acceptOperator(".") || (peek().type != eExprTokenIdentifier) ) {
+                return -1;
+            }
+            NodePtr child = getActivatedNode(_thisGroup.get(), peek().text);
+            if (!child) {
+                return -1;
+            }
+            ++_pos;
+
+            return parseNodeReference(child);
+        }
+
+        return -1;
+    } // parseAtom
+
+    static NodePtr getActivatedNode(const NodeCollection* collection,
+                                    const std::string& name)
+    {
+        if (!collection) {
+            return NodePtr();
+        }
+        NodePtr node = collection->getNodeByName(name);
+        if ( !node || !node->isActivated() || node->getParentMultiInstance() ) {
+            return NodePtr();
+        }
+
+        return node;
+    }
+
+    NodePtr getSiblingNode(const std::string& name) const
+    {
+        if ( (name == "thisNode") || (name == "thisGroup") || (name == "thisParam") ) {
+            return NodePtr();
+        }
+
+        return getActivatedNode(_thisGroup.get(), name);
+    }
+
+    // Parses what follows a node: .childNode(...) for groups, then .knob.method(...)
+    int parseNodeReference(NodePtr node)
+    {
+        for (;;) {
+            if ( !acceptOperator(".") || (peek().type != eExprTokenIdentifier) ) {
+                return -1;
+            }
+            const std::string& name = peek().text;
+            ++_pos;
+            if ( isOperator(".") && (peek(1).type == eExprTokenIdentifier) && isOperator("(", 2) ) {
+                KnobIPtr knob = node->getKnobByName(name);
+                if (!knob) {
+                    return -1;
+                }
+
+                return parseKnobMethod(knob, node);
+            }
+            NodeGroup* isGroup = dynamic_cast<NodeGroup*>( node->getEffectInstance().get() );
+            if (!isGroup) {
+                return -1;
+            }
+            node = getActivatedNode(isGroup, name);
+            if (!node) {
+                return -1;
+            }
+        }
+    }
+
+    // Parses .get(...), .getValue(...) or .getValueAtTime(...) on the given knob
+    int parseKnobMethod(const KnobIPtr& knob,
+                        const NodePtr& node)
+    {
+        if ( !knob || !isKnobTypeSupported( knob.get() ) ) {
+            return -1;
+        }
+        if ( !acceptOperator(".") || (peek().type != eExprTokenIdentifier) ) {
+            return -1;
+        }
+        std::string method = peek().text;
+        ++_pos;
+
+        std::vector<int> args;
+        if ( !parseArguments(&args) ) {
+            return -1;
+        }
+
+        KnobNativeExpression::ExprNode value;
+        value.op = KnobNativeExpression::eExprOpKnobValue;
+        value.knob = knob;
+        if ( node && (node != _thisNode) ) {
+            value.node = node;
+        }
+
+        int dimArg = -1;
+        int timeArg = -1;
+        if (method == "getValue") {
+            if (args.size() > 1) {
+                return -1;
+            }
+            dimArg = args.empty() ? addConstant(0.) : args[0];
+        } else if (method == "getValueAtTime") {
+            if ( args.empty() || (args.size() > 2) ) {
+                return -1;
+            }
+            timeArg = args[0];
+            dimArg = args.size() == 2 ? args[1] : addConstant(0.);
+        } else if (method == "get") {
+            if (args.size() > 1) {
+                return -1;
+            }
+            if (args.size() == 1) {
+                timeArg = args[0];
+            }
+            dimArg = parseTupleComponent(knob);
+        } else {
+            return -1;
+        }
+        if (dimArg < 0) {
+            return -1;
+        }
+        value.args.push_back(dimArg);
+        if (timeArg != -1) {
+            value.args.push_back(timeArg);
+        }
+
+        return addNode(value);
+    } // parseKnobMethod
+
+    // get() returns a scalar for 1-dimensional parameters and a tuple otherwise: the tuple must be subscripted
+    int parseTupleComponent(const KnobIPtr& knob)
+    {
+        int nDims = knob->getDimension();
+
+        if (nDims == 1) {
+            return addConstant(0.);
+        }
+        if ( acceptOperator("[") ) {
+            int index = parseTernary();
+            if ( (index < 0) || !acceptOperator("]") ) {
+                return -1;
+            }
+
+            return index;
+        }
+        if ( !isOperator(".") || (peek(1).type != eExprTokenIdentifier) || isOperator("(", 2) ) {
+            return -1;
+        }
+        const std::string& attr = peek(1).text;
+        bool isColor = dynamic_cast<KnobColor*>( knob.get() ) != 0;
+        static const char* const xyz[] = {"x", "y", "z", 0};
+        static const char* const rgba[] = {"r", "g", "b", "a", 0};
+        const char* const* names = isColor ? rgba : xyz;
+        for (int i = 0; names[i]; ++i) {
+            if (attr == names[i]) {
+                if (i >= nDims) {
+                    return -1;
+                }
+                _pos += 2;
+
+                return addConstant(i);
+            }
+        }
+
+        return -1;
+    }
+
+    const std::vector<ExprToken>& _tokens;
+    std::size_t _pos;
+    KnobNativeExpression* _expr;
+    KnobIPtr _thisParam;
+    NodePtr _thisNode;
+    NodeCollectionPtr _thisGroup;
+    int _dimension;
+};
+
+KnobNativeExpression::KnobNativeExpression()
+    : _nodes()
+    , _root(-1)
+{
+}
+
+KnobNativeExpression::~KnobNativeExpression()
+{
+}
+
+KnobNativeExpressionPtr
+KnobNativeExpression::parse(const std::string& expression,
+                            const KnobIPtr& thisParam,
+                            int dimension)
+{
+    std::vector<ExprToken> tokens;
+
+    if ( !thisParam || !tokenize(expression, &tokens) ) {
+        return KnobNativeExpressionPtr();
+    }
+    KnobNativeExpressionPtr ret( new KnobNativeExpression() );
+    KnobNativeExpressionParser parser(tokens, ret.get(), thisParam, dimension);
+    if ( !parser.parse() ) {
+        return KnobNativeExpressionPtr();
+    }
+
+    return ret;
+}
+
+bool
+KnobNativeExpression::evaluate(double time,
+                               ViewIdx view,
+                               double* ret) const
+{
+    if (_root < 0) {
+        return false;
+    }
+
+    return evaluateNode(_root, time, view, ret);
+}
+
+bool
+KnobNativeExpression::evaluateNode(int index,
+                                   double time,
+                                   ViewIdx view,
+                                   double* ret) const
+{
+    const ExprNode& node = _nodes[index];
+    const std::vector<int>& args = node.args;
+
+    switch (node.op) {
+    case eExprOpConstant:
+        *ret = node.value;
+
+        return true;
+    case eExprOpFrame:
+        *ret = time;
+
+        return true;
+    case eExprOpView:
+        *ret = (int)view;
+
+        return true;
+    case eExprOpAnd:
+    case eExprOpOr: {
+        // Python returns the operand that decided the result, not a boolean
+        double a;
+        if ( !evaluateNode(args[0], time, view, &a) ) {
+            return false;
+        }
+        if ( (node.op == eExprOpAnd) == (a == 0.) ) {
+            *ret = a;
+
+            return true;
+        }
+
+        return evaluateNode(args[1], time, view, ret);
+    }
+    case eExprOpIfElse: {
+        double cond;
+        if ( !evaluateNode(args[0], time, view, &cond) ) {
+            return false;
+        }
+
+        return evaluateNode(cond != 0. ? args[1] : args[2], time, view, ret);
+    }
+    case eExprOpKnobValue: {
+        KnobIPtr knob = node.knob.lock();
+        if (!knob) {
+            return false;
+        }
+        if ( !node.node.expired() ) {
+            NodePtr refNode = node.node.lock();
+            if ( !refNode || !refNode->isActivated() ) {
+                return false;
+            }
+        }
+        double dimValue;
+        if ( !evaluateNode(args[0], time, view, &dimValue) ) {
+            return false;
+        }
+        int dim;
+        if ( !asIndex(dimValue, &dim) ) {
+            return false;
+        }
+        double t = 0.;
+        bool atTime = args.size() > 1;
+        if ( atTime && !evaluateNode(args[1], time, view, &t) ) {
+            return false;
+        }
+
+        return getKnobValue(knob.get(), dim, atTime, t, ret);
+    }
+    default:
+        break;
+    } // switch
+
+    // All other operations evaluate all their operands first
+    double v[5];
+    std::vector<double> moreArgs;
+    std::size_t nArgs = args.size();
+    if (nArgs > 5) {
+        moreArgs.resize(nArgs);
+    }
+    double* a = nArgs > 5 ? &moreArgs[0] : v;
+    for (std::size_t i = 0; i < nArgs; ++i) {
+        if ( !evaluateNode(args[i], time, view, &a[i]) ) {
+            return false;
+        }
+    }
+
+    double r = 0.;
+    switch (node.op) {
+    case eExprOpNeg:
+        r = -a[0];
+        break;
+    case eExprOpNot:
+        r = a[0] == 0. ? 1. : 0.;
+        break;
+    case eExprOpAdd:
+        r = a[0] + a[1];
+        break;
+    case eExprOpSub:
+        r = a[0] - a[1];
+        break;
+    case eExprOpMul:
+        r = a[0] * a[1];
+        break;
+    case eExprOpDiv:
+        if (a[1] == 0.) {
+            return false;
+        }
+        r = a[0] / a[1];
+        break;
+    case eExprOpFloorDiv:
+        if (a[1] == 0.) {
+            return false;
+        }
+        r = std::floor(a[0] / a[1]);
+        break;
+    case eExprOpMod:
+        if (a[1] == 0.) {
+            return false;
+        }
+        // Python's modulo has the sign of the divisor
+        r = std::fmod(a[0], a[1]);
+        if ( (r != 0.) && ( (r < 0.) != (a[1] < 0.) ) ) {
+            r += a[1];
+        }
+        break;
+    case eExprOpPow:
+        r = std::pow(a[0], a[1]);
+        break;
+    case eExprOpLess:
+        r = a[0] < a[1];
+        break;
+    case eExprOpLessEqual:
+        r = a[0] <= a[1];
+        break;
+    case eExprOpGreater:
+        r = a[0] > a[1];
+        break;
+    case eExprOpGreaterEqual:
+        r = a[0] >= a[1];
+        break;
+    case eExprOpEqual:
+        r = a[0] == a[1];
+        break;
+    case eExprOpNotEqual:
+        r = a[0] != a[1];
+        break;
+    case eExprOpFunction:
+        switch ( (ExprFunctionEnum)node.function ) {
+        case eExprFunctionAbs:
+        case eExprFunctionFabs:
+            r = std::fabs(a[0]);
+            break;
+        case eExprFunctionMin:
+            r = a[0];
+            for (std::size_t i = 1; i < nArgs; ++i) {
+                r = std::min(r, a[i]);
+            }
+            break;
+        case eExprFunctionMax:
+            r = a[0];
+            for (std::size_t i = 1; i < nArgs; ++i) {
+                r = std::max(r, a[i]);
+            }
+            break;
+        case eExprFunctionRound:
+            // Python 3 rounds half to even, which is the default rounding mode
+            r = std::nearbyint(a[0]);
+            break;
+        case eExprFunctionInt:
+        case eExprFunctionTrunc:
+            r = std::trunc(a[0]);
+            break;
+        case eExprFunctionFloat:
+            r = a[0];
+            break;
+        case eExprFunctionBool:
+            r = a[0] != 0. ? 1. : 0.;
+            break;
+        case eExprFunctionSin:
+            r = std::sin(a[0]);
+            break;
+        case eExprFunctionCos:
+            r = std::cos(a[0]);
+            break;
+        case eExprFunctionTan:
+            r = std::tan(a[0]);
+            break;
+        case eExprFunctionAsin:
+            r = std::asin(a[0]);
+            break;
+        case eExprFunctionAcos:
+            r = std::acos(a[0]);
+            break;
+        case eExprFunctionAtan:
+            r = std::atan(a[0]);
+            break;
+        case eExprFunctionAtan2:
+            r = std::atan2(a[0], a[1]);
+            break;
+        case eExprFunctionSinh:
+            r = std::sinh(a[0]);
+            break;
+        case eExprFunctionCosh:
+            r = std::cosh(a[0]);
+            break;
+        case eExprFunctionTanh:
+            r = std::tanh(a[0]);
+            break;
+        case eExprFunctionExp:
+            r = std::exp(a[0]);
+            break;
+        case eExprFunctionLog:
+            if ( (a[0] <= 0.) || ( (nArgs == 2) && ( (a[1] <= 0.) || (a[1] == 1.) ) ) ) {
+                return false;
+            }
+            r = nArgs == 2 ? std::log(a[0]) / std::log(a[1]) : std::log(a[0]);
+            break;
+        case eExprFunctionLog10:
+            if (a[0] <= 0.) {
+                return false;
+            }
+            r = std::log10(a[0]);
+            break;
+        case eExprFunctionLog2:
+            if (a[0] <= 0.) {
+                return false;
+            }
+            r = std::log2(a[0]);
+            break;
+        case eExprFunctionSqrt:
+            r = std::sqrt(a[0]);
+            break;
+        case eExprFunctionPow:
+            r = std::pow(a[0], a[1]);
+            break;
+        case eExprFunctionFloor:
+            r = std::floor(a[0]);
+            break;
+        case eExprFunctionCeil:
+            r = std::ceil(a[0]);
+            break;
+        case eExprFunctionFmod:
+            if (a[1] == 0.) {
+                return false;
+            }
+            r = std::fmod(a[0], a[1]);
+            break;
+        case eExprFunctionHypot:
+            r = std::hypot(a[0], a[1]);
+            break;
+        case eExprFunctionDegrees:
+            r = a[0] * 180. / M_PI;
+            break;
+        case eExprFunctionRadians:
+            r = a[0] * M_PI / 180.;
+            break;
+        case eExprFunctionCopysign:
+            r = std::copysign(a[0], a[1]);
+            break;
+        case eExprFunctionBoxstep:
+            r = NATRON_PYTHON_NAMESPACE::ExprUtils::boxstep(a[0], a[1]);
+            break;
+        case eExprFunctionLinearstep:
+            r = NATRON_PYTHON_NAMESPACE::ExprUtils::linearstep(a[0], a[1], a[2]);
+            break;
+        case eExprFunctionSmoothstep:
+            r = NATRON_PYTHON_NAMESPACE::ExprUtils::smoothstep(a[0], a[1], a[2]);
+            break;
+        case eExprFunctionGaussstep:
+            r = NATRON_PYTHON_NAMESPACE::ExprUtils::gaussstep(a[0], a[1], a[2]);
+            break;
+        case eExprFunctionRemap:
+            r = NATRON_PYTHON_NAMESPACE::ExprUtils::remap(a[0], a[1], a[2], a[3], a[4]);
+            break;
+        case eExprFunctionMix:
+            r = NATRON_PYTHON_NAMESPACE::ExprUtils::mix(a[0], a[1], a[2]);
+            break;
+        case eExprFunctionNoise:
+            r = NATRON_PYTHON_NAMESPACE::ExprUtils::noise(a[0]);
+            break;
+        } // switch
+        break;
+    default:
+        assert(false);
+
+        return false;
+    } // switch
+
+    // Python raises on domain errors and overflows (or returns complex numbers): let it handle them
+    if ( !std::isfinite(r) ) {
+        return false;
+    }
+    *ret = r;
+
+    return true;
+} // KnobNativeExpression::evaluateNode
+
+NATRON_NAMESPACE_EXIT
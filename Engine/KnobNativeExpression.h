@@ -0,0 +1,152 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * (C) 2018-2023 The Natron developers
+ * (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_KNOBNATIVEEXPRESSION_H
+#define NATRON_ENGINE_KNOBNATIVEEXPRESSION_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <string>
+#include <vector>
+
+#include "Engine/ViewIdx.h"
+
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief A single-line knob expression compiled to a small tree that can be evaluated without the Python GIL.
+ *
+ * Only a subset of the Python syntax is understood:
+ * - numbers, True, False, pi, e, tau, frame, view, dimension
+ * - the arithmetic operators + - * / // % **, comparisons (not chained), and, or, not, x if cond else y
+ * - the functions of the math module and abs, min, max, round, int, float, bool
+ * - the scalar functions of ExprUtils, prefixed by ExprUtils. or NatronEngine.ExprUtils.
+ * - references to other parameters through thisParam, thisNode, thisGroup and the script-name of sibling nodes,
+ *   read with get(), get(frame), getValue(dimension) and getValueAtTime(frame, dimension).
+ *   Multi-dimensional get() must be subscripted, either with [index] or .x/.y/.z or .r/.g/.b/.a for colors.
+ *
+ * Anything else makes parse() return NULL, in which case the expression is run by Python.
+ * evaluate() also fails whenever Python would raise or produce something not representable as a finite double
+ * (division by zero, a referenced node was deleted...), so that the caller can fall back on Python to get
+ * the exact same result or error.
+ **/
+class KnobNativeExpression
+{
+public:
+
+    enum ExprOpEnum
+    {
+        eExprOpConstant = 0,
+        eExprOpFrame,
+        eExprOpView,
+        eExprOpNeg,
+        eExprOpNot,
+        eExprOpAdd,
+        eExprOpSub,
+        eExprOpMul,
+        eExprOpDiv,
+        eExprOpFloorDiv,
+        eExprOpMod,
+        eExprOpPow,
+        eExprOpLess,
+        eExprOpLessEqual,
+        eExprOpGreater,
+        eExprOpGreaterEqual,
+        eExprOpEqual,
+        eExprOpNotEqual,
+        eExprOpAnd,
+        eExprOpOr,
+        eExprOpIfElse,
+        eExprOpFunction,
+        eExprOpKnobValue
+    };
+
+    struct ExprNode
+    {
+        ExprOpEnum op;
+
+        // eExprOpConstant
+        double value;
+
+        // operands, or arguments of eExprOpFunction, indices in _nodes
+        std::vector<int> args;
+
+        // eExprOpFunction
+        int function;
+
+        // eExprOpKnobValue: args[0] is the dimension, args[1] the time if any.
+        // If the knob belongs to another node, the node is checked to still be activated.
+        KnobIWPtr knob;
+        NodeWPtr node;
+
+        ExprNode()
+            : op(eExprOpConstant)
+            , value(0.)
+            , args()
+            , function(-1)
+            , knob()
+            , node()
+        {
+        }
+    };
+
+private:
+
+    // used by parse()
+    KnobNativeExpression();
+
+public:
+
+    ~KnobNativeExpression();
+
+    /**
+     * @brief Parses the given expression as it was typed by the user on the given dimension of thisParam.
+     * References to other parameters are resolved now, hence the expression must be parsed again whenever
+     * it is set again.
+     * @returns NULL if the expression uses any syntax not supported natively.
+     **/
+    static KnobNativeExpressionPtr parse(const std::string& expression, const KnobIPtr& thisParam, int dimension);
+
+    /**
+     * @brief Evaluates the expression at the given time/view. This is thread-safe and does not take the Python GIL.
+     * @returns False if the expression could not be evaluated natively, in which case it must be run by Python.
+     **/
+    bool evaluate(double time, ViewIdx view, double* ret) const WARN_UNUSED_RETURN;
+
+private:
+
+    bool evaluateNode(int index, double time, ViewIdx view, double* ret) const;
+
+    friend class KnobNativeExpressionParser;
+
+    std::vector<ExprNode> _nodes;
+    int _root;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_KNOBNATIVEEXPRESSION_H
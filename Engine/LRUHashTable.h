@@ -149,6 +149,12 @@ public:
         return it;
     }
 
+    // Find the record of k without updating the access record
+    typename key_to_value_type::iterator find(const key_type & k)
+    {
+        return _key_to_value.find(k);
+    }
+
     void erase(typename key_to_value_type::iterator it)
     {
         _key_tracker.erase(it->second.second);
@@ -267,6 +273,12 @@ public:
         return it;
     }
 
+    // Find the record of k without updating the access record view
+    typename container_type::left_iterator find(const key_type & k)
+    {
+        return _container.left.find(k);
+    }
+
     void erase(typename container_type::left_iterator it)
     {
         _container.left.erase(it);
@@ -383,6 +395,12 @@ public:
         return it;
     }
 
+    // Find the record of k without updating the access record
+    typename key_to_value_type::iterator find(const key_type & k)
+    {
+        return _key_to_value.find(k);
+    }
+
     void erase(typename key_to_value_type::iterator it)
     {
         _key_tracker.erase(it->second.second);
@@ -497,6 +515,12 @@ public:
         return it;
     }
 
+    // Find the record of k without updating the access record view
+    typename container_type::left_iterator find(const key_type & k)
+    {
+        return _container.left.find(k);
+    }
+
     void erase(typename container_type::left_iterator it)
     {
         _container.left.erase(it);
@@ -599,6 +623,12 @@ public:
         return it;
     }
 
+    // Find the record of k without updating the access record view
+    typename container_type::left_iterator find(const key_type & k)
+    {
+        return _container.left.find(k);
+    }
+
     void erase(typename container_type::left_iterator it)
     {
         _container.left.erase(it);
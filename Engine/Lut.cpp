@@ -27,10 +27,27 @@
 
 #include <cstring> // for std::memcpy
 #include <algorithm> // min, max
+#include <atomic>
 #include <cassert>
+#include <functional>
 #include <stdexcept>
 
+#if ( defined(__GNUC__) || defined(__clang__) ) && ( defined(__x86_64__) || defined(__i386__) )
+#define NATRON_LUT_AVX2
+#include <immintrin.h>
+#define NATRON_AVX2_TARGET __attribute__( ( target("avx2") ) )
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "Engine/AppManager.h"
+#include "Engine/CPUFeatures.h"
 #include "Engine/RectI.h"
+#include "Engine/TaskScheduler.h"
+
+// Images with fewer pixels than this are converted by the calling thread only
+#define NATRON_LUT_MIN_PIXELS_PER_BAND (1 << 16)
 
 /*
  * The to_byte* and from_byte* functions implement and generalize the algorithm
@@ -139,7 +156,8 @@ LutManager::LutManager()
 const Lut*
 LutManager::getLut(const std::string & name,
                    fromColorSpaceFunctionV1 fromFunc,
-                   toColorSpaceFunctionV1 toFunc)
+                   toColorSpaceFunctionV1 toFunc,
+                   const PowerTransferFunction* powerFunc)
 {
     LutsMap::iterator found = LutManager::m_instance.luts.find(name);
 
@@ -147,7 +165,7 @@ LutManager::getLut(const std::string & name,
         return found->second;
     } else {
         std::pair<LutsMap::iterator, bool> ret =
-            LutManager::m_instance.luts.insert( std::make_pair( name, new Lut(name, fromFunc, toFunc) ) );
+            LutManager::m_instance.luts.insert( std::make_pair( name, new Lut(name, fromFunc, toFunc, powerFunc) ) );
         assert(ret.second);
 
         return ret.first->second;
@@ -225,6 +243,545 @@ getOffsetsForPacking(PixelPackingEnum format,
     }
 }
 
+/*
+ * Vectorized conversions of rows.
+ *
+ * The conversions to and from a color-space are done channel by channel on rows of pixels by the toColorSpaceRow,
+ * fromColorSpaceRow and fromByteRow functions, with the implementation returned by getLutImplementation(),
+ * which is picked once at runtime from getCPUFeatures():
+ * - the float conversions of the Luts which have a PowerTransferFunction (sRGB and Rec.709) compute
+ *   pow(x, p) = exp(p * log(x)) with the polynomial approximations of log and exp of the Cephes library,
+ *   on 4 values with SSE2 or 8 values with AVX2. The other Luts call their conversion functions.
+ * - the lookups of contiguous bytes in fromFunc_uint8_to_float use the AVX2 gather instructions.
+ * The conversions to bytes are bound by the table lookups and the serial error diffusion, which are not vectorized.
+ * The packed conversions split the rows of large images in bands processed by the TaskScheduler.
+ */
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+std::atomic<int>&
+currentImplementation()
+{
+    static std::atomic<int> impl( (int)getBestLutImplementation() );
+
+    return impl;
+}
+
+// The error diffusion of each row starts at a pseudo-random column, so that rows do not show the same
+// pattern. It only depends on the row, so that rows can be converted by any thread in any order.
+int
+getDitheringStart(int y,
+                  int width)
+{
+    U32 h = (U32)y * 2654435761u;
+
+    h ^= h >> 16;
+
+    return (int)(h % (U32)width);
+}
+
+// Calls convertRows(y1, y2) on bands of the rows of rect, in parallel if the rect is large enough
+void
+convertRowsInBands(const RectI& rect,
+                   const std::function<void(int, int)>& convertRows)
+{
+    const int nRows = rect.height();
+    const int nBands = std::max( 1, std::min( nRows, (int)(rect.area() / NATRON_LUT_MIN_PIXELS_PER_BAND) ) );
+    const int rowsPerBand = (nRows + nBands - 1) / nBands;
+    TaskScheduler* scheduler = appPTR ? appPTR->getTaskScheduler() : NULL;
+
+    if ( (nBands > 1) && scheduler ) {
+        scheduler->parallelFor( (nRows + rowsPerBand - 1) / rowsPerBand, [&](int band) {
+            const int y1 = rect.y1 + band * rowsPerBand;
+            convertRows( y1, std::min(y1 + rowsPerBand, rect.y2) );
+        } );
+    } else {
+        convertRows(rect.y1, rect.y2);
+    }
+}
+
+#ifdef __SSE2__
+// log(x) for x > 0, from the Cephes library (logf)
+inline __m128
+logSSE2(__m128 x)
+{
+    const __m128 one = _mm_set1_ps(1.f);
+
+    // denormals, zero and negative values are clamped to the smallest normalized float
+    x = _mm_max_ps( x, _mm_castsi128_ps( _mm_set1_epi32(0x00800000) ) );
+    __m128i e = _mm_sub_epi32( _mm_srli_epi32(_mm_castps_si128(x), 23), _mm_set1_epi32(0x7f) );
+    // the mantissa in [0.5, 1)
+    x = _mm_or_ps( _mm_and_ps( x, _mm_castsi128_ps( _mm_set1_epi32(~0x7f800000) ) ), _mm_set1_ps(0.5f) );
+    __m128 fe = _mm_add_ps(_mm_cvtepi32_ps(e), one);
+    // if x < sqrt(1/2), x = 2x - 1 and e -= 1, else x = x - 1
+    __m128 mask = _mm_cmplt_ps( x, _mm_set1_ps(0.707106781186547524f) );
+    __m128 tmp = _mm_and_ps(x, mask);
+    x = _mm_sub_ps(x, one);
+    fe = _mm_sub_ps( fe, _mm_and_ps(one, mask) );
+    x = _mm_add_ps(x, tmp);
+
+    __m128 z = _mm_mul_ps(x, x);
+    __m128 y = _mm_set1_ps(7.0376836292E-2f);
+    y = _mm_add_ps( _mm_mul_ps(y, x), _mm_set1_ps(-1.1514610310E-1f) );
+    y = _mm_add_ps( _mm_mul_ps(y, x), _mm_set1_ps(1.1676998740E-1f) );
+    y = _mm_add_ps( _mm_mul_ps(y, x), _mm_set1_ps(-1.2420140846E-1f) );
+    y = _mm_add_ps( _mm_mul_ps(y, x), _mm_set1_ps(1.4249322787E-1f) );
+    y = _mm_add_ps( _mm_mul_ps(y, x), _mm_set1_ps(-1.6668057665E-1f) );
+    y = _mm_add_ps( _mm_mul_ps(y, x), _mm_set1_ps(2.0000714765E-1f) );
+    y = _mm_add_ps( _mm_mul_ps(y, x), _mm_set1_ps(-2.4999993993E-1f) );
+    y = _mm_add_ps( _mm_mul_ps(y, x), _mm_set1_ps(3.3333331174E-1f) );
+    y = _mm_mul_ps( _mm_mul_ps(y, x), z );
+    y = _mm_add_ps( y, _mm_mul_ps( fe, _mm_set1_ps(-2.12194440E-4f) ) );
+    y = _mm_sub_ps( y, _mm_mul_ps( z, _mm_set1_ps(0.5f) ) );
+    x = _mm_add_ps(x, y);
+
+    return _mm_add_ps( x, _mm_mul_ps( fe, _mm_set1_ps(0.693359375f) ) );
+}
+
+// exp(x), from the Cephes library (expf)
+inline __m128
+expSSE2(__m128 x)
+{
+    const __m128 one = _mm_set1_ps(1.f);
+
+    x = _mm_min_ps( x, _mm_set1_ps(88.3762626647949f) );
+    x = _mm_max_ps( x, _mm_set1_ps(-88.3762626647949f) );
+    // exp(x) = exp(g) * 2^n, with n = floor(x / log(2) + 0.5)
+    __m128 fx = _mm_add_ps( _mm_mul_ps( x, _mm_set1_ps(1.44269504088896341f) ), _mm_set1_ps(0.5f) );
+    __m128 tmp = _mm_cvtepi32_ps( _mm_cvttps_epi32(fx) );
+    fx = _mm_sub_ps( tmp, _mm_and_ps(_mm_cmpgt_ps(tmp, fx), one) );
+    x = _mm_sub_ps( x, _mm_mul_ps( fx, _mm_set1_ps(0.693359375f) ) );
+    x = _mm_sub_ps( x, _mm_mul_ps( fx, _mm_set1_ps(-2.12194440E-4f) ) );
+
+    __m128 z = _mm_mul_ps(x, x);
+    __m128 y = _mm_set1_ps(1.9875691500E-4f);
+    y = _mm_add_ps( _mm_mul_ps(y, x), _mm_set1_ps(1.3981999507E-3f) );
+    y = _mm_add_ps( _mm_mul_ps(y, x), _mm_set1_ps(8.3334519073E-3f) );
+    y = _mm_add_ps( _mm_mul_ps(y, x), _mm_set1_ps(4.1665795894E-2f) );
+    y = _mm_add_ps( _mm_mul_ps(y, x), _mm_set1_ps(1.6666665459E-1f) );
+    y = _mm_add_ps( _mm_mul_ps(y, x), _mm_set1_ps(5.0000001201E-1f) );
+    y = _mm_add_ps( _mm_mul_ps(y, z), _mm_add_ps(x, one) );
+
+    // 2^n
+    __m128i n = _mm_slli_epi32(_mm_add_epi32( _mm_cvttps_epi32(fx), _mm_set1_epi32(0x7f) ), 23);
+
+    return _mm_mul_ps( y, _mm_castsi128_ps(n) );
+}
+
+inline __m128
+toPowerSSE2(const PowerTransferFunction& f,
+            __m128 v)
+{
+    __m128 lin = _mm_mul_ps( _mm_max_ps( v, _mm_setzero_ps() ), _mm_set1_ps(f.slope) );
+    __m128 pw = _mm_mul_ps( _mm_set1_ps(f.scale), expSSE2( _mm_mul_ps( _mm_set1_ps(f.toExponent), logSSE2(v) ) ) );
+
+    pw = _mm_sub_ps( pw, _mm_set1_ps(f.offset) );
+    __m128 isLinear = _mm_cmplt_ps( v, _mm_set1_ps(f.linearBreak) );
+
+    return _mm_or_ps( _mm_and_ps(isLinear, lin), _mm_andnot_ps(isLinear, pw) );
+}
+
+inline __m128
+fromPowerSSE2(const PowerTransferFunction& f,
+              __m128 v)
+{
+    __m128 lin = _mm_mul_ps( _mm_max_ps( v, _mm_setzero_ps() ), _mm_set1_ps(1.f / f.slope) );
+    __m128 x = _mm_mul_ps( _mm_add_ps( v, _mm_set1_ps(f.offset) ), _mm_set1_ps(1.f / f.scale) );
+    __m128 pw = expSSE2( _mm_mul_ps( _mm_set1_ps(f.fromExponent), logSSE2(x) ) );
+    __m128 isLinear = _mm_cmplt_ps( v, _mm_set1_ps(f.encodedBreak) );
+
+    return _mm_or_ps( _mm_and_ps(isLinear, lin), _mm_andnot_ps(isLinear, pw) );
+}
+
+inline __m128
+loadStridedSSE2(const float* src,
+                int stride)
+{
+    if (stride == 1) {
+        return _mm_loadu_ps(src);
+    }
+
+    return _mm_setr_ps(src[0], src[stride], src[2 * stride], src[3 * stride]);
+}
+
+inline void
+storeStridedSSE2(__m128 v,
+                 float* dst,
+                 int stride)
+{
+    if (stride == 1) {
+        _mm_storeu_ps(dst, v);
+    } else {
+        float tmp[4];
+        _mm_storeu_ps(tmp, v);
+        for (int i = 0; i < 4; ++i) {
+            dst[i * stride] = tmp[i];
+        }
+    }
+}
+
+int
+toColorSpaceRowSSE2(const PowerTransferFunction& f,
+                    const float* src,
+                    const float* alpha,
+                    int srcStride,
+                    int n,
+                    float* dst,
+                    int dstStride)
+{
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = loadStridedSSE2(src + i * srcStride, srcStride);
+        if (alpha) {
+            v = _mm_mul_ps( v, loadStridedSSE2(alpha + i * srcStride, srcStride) );
+        }
+        storeStridedSSE2(toPowerSSE2(f, v), dst + i * dstStride, dstStride);
+    }
+
+    return i;
+}
+
+int
+fromColorSpaceRowSSE2(const PowerTransferFunction& f,
+                      const float* src,
+                      const float* alpha,
+                      int srcStride,
+                      int n,
+                      float* dst,
+                      int dstStride)
+{
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = loadStridedSSE2(src + i * srcStride, srcStride);
+        if (alpha) {
+            __m128 a = loadStridedSSE2(alpha + i * srcStride, srcStride);
+            __m128 isOpaque = _mm_cmpgt_ps( a, _mm_setzero_ps() );
+            v = _mm_and_ps( isOpaque, _mm_mul_ps( fromPowerSSE2( f, _mm_div_ps(v, a) ), a ) );
+        } else {
+            v = fromPowerSSE2(f, v);
+        }
+        storeStridedSSE2(v, dst + i * dstStride, dstStride);
+    }
+
+    return i;
+}
+
+#endif // __SSE2__
+
+#ifdef NATRON_LUT_AVX2
+// The AVX2 versions of the SSE2 functions above
+
+NATRON_AVX2_TARGET inline __m256
+logAVX2(__m256 x)
+{
+    const __m256 one = _mm256_set1_ps(1.f);
+
+    x = _mm256_max_ps( x, _mm256_castsi256_ps( _mm256_set1_epi32(0x00800000) ) );
+    __m256i e = _mm256_sub_epi32( _mm256_srli_epi32(_mm256_castps_si256(x), 23), _mm256_set1_epi32(0x7f) );
+    x = _mm256_or_ps( _mm256_and_ps( x, _mm256_castsi256_ps( _mm256_set1_epi32(~0x7f800000) ) ), _mm256_set1_ps(0.5f) );
+    __m256 fe = _mm256_add_ps(_mm256_cvtepi32_ps(e), one);
+    __m256 mask = _mm256_cmp_ps(x, _mm256_set1_ps(0.707106781186547524f), _CMP_LT_OQ);
+    __m256 tmp = _mm256_and_ps(x, mask);
+    x = _mm256_sub_ps(x, one);
+    fe = _mm256_sub_ps( fe, _mm256_and_ps(one, mask) );
+    x = _mm256_add_ps(x, tmp);
+
+    __m256 z = _mm256_mul_ps(x, x);
+    __m256 y = _mm256_set1_ps(7.0376836292E-2f);
+    y = _mm256_add_ps( _mm256_mul_ps(y, x), _mm256_set1_ps(-1.1514610310E-1f) );
+    y = _mm256_add_ps( _mm256_mul_ps(y, x), _mm256_set1_ps(1.1676998740E-1f) );
+    y = _mm256_add_ps( _mm256_mul_ps(y, x), _mm256_set1_ps(-1.2420140846E-1f) );
+    y = _mm256_add_ps( _mm256_mul_ps(y, x), _mm256_set1_ps(1.4249322787E-1f) );
+    y = _mm256_add_ps( _mm256_mul_ps(y, x), _mm256_set1_ps(-1.6668057665E-1f) );
+    y = _mm256_add_ps( _mm256_mul_ps(y, x), _mm256_set1_ps(2.0000714765E-1f) );
+    y = _mm256_add_ps( _mm256_mul_ps(y, x), _mm256_set1_ps(-2.4999993993E-1f) );
+    y = _mm256_add_ps( _mm256_mul_ps(y, x), _mm256_set1_ps(3.3333331174E-1f) );
+    y = _mm256_mul_ps( _mm256_mul_ps(y, x), z );
+    y = _mm256_add_ps( y, _mm256_mul_ps( fe, _mm256_set1_ps(-2.12194440E-4f) ) );
+    y = _mm256_sub_ps( y, _mm256_mul_ps( z, _mm256_set1_ps(0.5f) ) );
+    x = _mm256_add_ps(x, y);
+
+    return _mm256_add_ps( x, _mm256_mul_ps( fe, _mm256_set1_ps(0.693359375f) ) );
+}
+
+NATRON_AVX2_TARGET inline __m256
+expAVX2(__m256 x)
+{
+    const __m256 one = _mm256_set1_ps(1.f);
+
+    x = _mm256_min_ps( x, _mm256_set1_ps(88.3762626647949f) );
+    x = _mm256_max_ps( x, _mm256_set1_ps(-88.3762626647949f) );
+    __m256 fx = _mm256_floor_ps( _mm256_add_ps( _mm256_mul_ps( x, _mm256_set1_ps(1.44269504088896341f) ), _mm256_set1_ps(0.5f) ) );
+    x = _mm256_sub_ps( x, _mm256_mul_ps( fx, _mm256_set1_ps(0.693359375f) ) );
+    x = _mm256_sub_ps( x, _mm256_mul_ps( fx, _mm256_set1_ps(-2.12194440E-4f) ) );
+
+    __m256 z = _mm256_mul_ps(x, x);
+    __m256 y = _mm256_set1_ps(1.9875691500E-4f);
+    y = _mm256_add_ps( _mm256_mul_ps(y, x), _mm256_set1_ps(1.3981999507E-3f) );
+    y = _mm256_add_ps( _mm256_mul_ps(y, x), _mm256_set1_ps(8.3334519073E-3f) );
+    y = _mm256_add_ps( _mm256_mul_ps(y, x), _mm256_set1_ps(4.1665795894E-2f) );
+    y = _mm256_add_ps( _mm256_mul_ps(y, x), _mm256_set1_ps(1.6666665459E-1f) );
+    y = _mm256_add_ps( _mm256_mul_ps(y, x), _mm256_set1_ps(5.0000001201E-1f) );
+    y = _mm256_add_ps( _mm256_mul_ps(y, z), _mm256_add_ps(x, one) );
+
+    __m256i n = _mm256_slli_epi32(_mm256_add_epi32( _mm256_cvttps_epi32(fx), _mm256_set1_epi32(0x7f) ), 23);
+
+    return _mm256_mul_ps( y, _mm256_castsi256_ps(n) );
+}
+
+NATRON_AVX2_TARGET inline __m256
+toPowerAVX2(const PowerTransferFunction& f,
+            __m256 v)
+{
+    __m256 lin = _mm256_mul_ps( _mm256_max_ps( v, _mm256_setzero_ps() ), _mm256_set1_ps(f.slope) );
+    __m256 pw = _mm256_mul_ps( _mm256_set1_ps(f.scale), expAVX2( _mm256_mul_ps( _mm256_set1_ps(f.toExponent), logAVX2(v) ) ) );
+
+    pw = _mm256_sub_ps( pw, _mm256_set1_ps(f.offset) );
+
+    return _mm256_blendv_ps( pw, lin, _mm256_cmp_ps(v, _mm256_set1_ps(f.linearBreak), _CMP_LT_OQ) );
+}
+
+NATRON_AVX2_TARGET inline __m256
+fromPowerAVX2(const PowerTransferFunction& f,
+              __m256 v)
+{
+    __m256 lin = _mm256_mul_ps( _mm256_max_ps( v, _mm256_setzero_ps() ), _mm256_set1_ps(1.f / f.slope) );
+    __m256 x = _mm256_mul_ps( _mm256_add_ps( v, _mm256_set1_ps(f.offset) ), _mm256_set1_ps(1.f / f.scale) );
+    __m256 pw = expAVX2( _mm256_mul_ps( _mm256_set1_ps(f.fromExponent), logAVX2(x) ) );
+
+    return _mm256_blendv_ps( pw, lin, _mm256_cmp_ps(v, _mm256_set1_ps(f.encodedBreak), _CMP_LT_OQ) );
+}
+
+// The element offsets of 8 strided values, for the gather instructions
+NATRON_AVX2_TARGET inline __m256i
+strideIndicesAVX2(int stride)
+{
+    return _mm256_mullo_epi32( _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(stride) );
+}
+
+NATRON_AVX2_TARGET inline __m256
+loadStridedAVX2(const float* src,
+                int stride,
+                __m256i indices)
+{
+    if (stride == 1) {
+        return _mm256_loadu_ps(src);
+    }
+
+    return _mm256_i32gather_ps(src, indices, 4);
+}
+
+NATRON_AVX2_TARGET inline void
+storeStridedAVX2(__m256 v,
+                 float* dst,
+                 int stride)
+{
+    if (stride == 1) {
+        _mm256_storeu_ps(dst, v);
+    } else {
+        float tmp[8];
+        _mm256_storeu_ps(tmp, v);
+        for (int i = 0; i < 8; ++i) {
+            dst[i * stride] = tmp[i];
+        }
+    }
+}
+
+NATRON_AVX2_TARGET int
+toColorSpaceRowAVX2(const PowerTransferFunction& f,
+                    const float* src,
+                    const float* alpha,
+                    int srcStride,
+                    int n,
+                    float* dst,
+                    int dstStride)
+{
+    const __m256i indices = strideIndicesAVX2(srcStride);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = loadStridedAVX2(src + i * srcStride, srcStride, indices);
+        if (alpha) {
+            v = _mm256_mul_ps( v, loadStridedAVX2(alpha + i * srcStride, srcStride, indices) );
+        }
+        storeStridedAVX2(toPowerAVX2(f, v), dst + i * dstStride, dstStride);
+    }
+
+    return i;
+}
+
+NATRON_AVX2_TARGET int
+fromColorSpaceRowAVX2(const PowerTransferFunction& f,
+                      const float* src,
+                      const float* alpha,
+                      int srcStride,
+                      int n,
+                      float* dst,
+                      int dstStride)
+{
+    const __m256i indices = strideIndicesAVX2(srcStride);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = loadStridedAVX2(src + i * srcStride, srcStride, indices);
+        if (alpha) {
+            __m256 a = loadStridedAVX2(alpha + i * srcStride, srcStride, indices);
+            __m256 isOpaque = _mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_GT_OQ);
+            v = _mm256_and_ps( isOpaque, _mm256_mul_ps( fromPowerAVX2( f, _mm256_div_ps(v, a) ), a ) );
+        } else {
+            v = fromPowerAVX2(f, v);
+        }
+        storeStridedAVX2(v, dst + i * dstStride, dstStride);
+    }
+
+    return i;
+}
+
+// Only contiguous rows are converted: with strided bytes, the scalar loads of the indices cost more than the gather saves
+NATRON_AVX2_TARGET int
+fromByteRowAVX2(const float* table,
+                const unsigned char* src,
+                int srcStride,
+                int n,
+                float* dst,
+                int dstStride)
+{
+    if (srcStride != 1) {
+        return 0;
+    }
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i b = _mm256_cvtepu8_epi32( _mm_loadl_epi64( (const __m128i*)(src + i) ) );
+        storeStridedAVX2(_mm256_i32gather_ps(table, b, 4), dst + i * dstStride, dstStride);
+    }
+
+    return i;
+}
+
+#endif // NATRON_LUT_AVX2
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+LutImplementationEnum
+getBestLutImplementation()
+{
+#ifdef NATRON_LUT_AVX2
+    if (getCPUFeatures().avx2) {
+        return eLutImplementationAVX2;
+    }
+#endif
+#ifdef __SSE2__
+
+    return eLutImplementationSSE2;
+#else
+
+    return eLutImplementationScalar;
+#endif
+}
+
+LutImplementationEnum
+getLutImplementation()
+{
+    return (LutImplementationEnum)currentImplementation().load();
+}
+
+void
+setLutImplementation(LutImplementationEnum impl)
+{
+    assert(impl <= getBestLutImplementation());
+    currentImplementation().store( (int)impl );
+}
+
+void
+Lut::toColorSpaceRow(const float* src,
+                     const float* alpha,
+                     int srcStride,
+                     int n,
+                     float* dst,
+                     int dstStride) const
+{
+    int i = 0;
+
+    if (_powerFunc) {
+        switch ( getLutImplementation() ) {
+#ifdef NATRON_LUT_AVX2
+        case eLutImplementationAVX2:
+            i = toColorSpaceRowAVX2(*_powerFunc, src, alpha, srcStride, n, dst, dstStride);
+            break;
+#endif
+#ifdef __SSE2__
+        case eLutImplementationSSE2:
+            i = toColorSpaceRowSSE2(*_powerFunc, src, alpha, srcStride, n, dst, dstStride);
+            break;
+#endif
+        default:
+            break;
+        }
+    }
+    for (; i < n; ++i) {
+        const float v = src[i * srcStride];
+        dst[i * dstStride] = _toFunc(alpha ? v * alpha[i * srcStride] : v);
+    }
+}
+
+void
+Lut::fromColorSpaceRow(const float* src,
+                       const float* alpha,
+                       int srcStride,
+                       int n,
+                       float* dst,
+                       int dstStride) const
+{
+    int i = 0;
+
+    if (_powerFunc) {
+        switch ( getLutImplementation() ) {
+#ifdef NATRON_LUT_AVX2
+        case eLutImplementationAVX2:
+            i = fromColorSpaceRowAVX2(*_powerFunc, src, alpha, srcStride, n, dst, dstStride);
+            break;
+#endif
+#ifdef __SSE2__
+        case eLutImplementationSSE2:
+            i = fromColorSpaceRowSSE2(*_powerFunc, src, alpha, srcStride, n, dst, dstStride);
+            break;
+#endif
+        default:
+            break;
+        }
+    }
+    for (; i < n; ++i) {
+        const float v = src[i * srcStride];
+        if (alpha) {
+            const float a = alpha[i * srcStride];
+            dst[i * dstStride] = a <= 0.f ? 0.f : _fromFunc(v / a) * a;
+        } else {
+            dst[i * dstStride] = _fromFunc(v);
+        }
+    }
+}
+
+void
+Lut::fromByteRow(const unsigned char* src,
+                 int srcStride,
+                 int n,
+                 float* dst,
+                 int dstStride) const
+{
+    int i = 0;
+
+#ifdef NATRON_LUT_AVX2
+    if (getLutImplementation() == eLutImplementationAVX2) {
+        i = fromByteRowAVX2(fromFunc_uint8_to_float, src, srcStride, n, dst, dstStride);
+    }
+#endif
+    for (; i < n; ++i) {
+        dst[i * dstStride] = fromFunc_uint8_to_float[src[i * srcStride]];
+    }
+}
+
 float
 Lut::fromColorSpaceUint8ToLinearFloatFast(unsigned char v) const
 {
@@ -422,15 +979,7 @@ Lut::to_float_planar(float* to,
                      int outDelta) const
 {
     validate();
-    if (!alpha) {
-        for (int f = 0, t = 0; f < W; f += inDelta, t += outDelta) {
-            to[t] = toColorSpaceFloatFromLinearFloat(from[f]);
-        }
-    } else {
-        for (int f = 0, t = 0; f < W; f += inDelta, t += outDelta) {
-            to[t] = toColorSpaceFloatFromLinearFloat(from[f] * alpha[f]);
-        }
-    }
+    toColorSpaceRow(from, alpha, inDelta, (W + inDelta - 1) / inDelta, to, outDelta);
 }
 
 void
@@ -465,56 +1014,63 @@ Lut::to_byte_packed(unsigned char* to,
 
     validate();
 
-    for (int y = rect.y1; y < rect.y2; ++y) {
-        // coverity[dont_call]
-        int start = rand() % (rect.x2 - rect.x1) + rect.x1;
-        unsigned error_r, error_g, error_b;
-        error_r = error_g = error_b = 0x80;
-        int srcY = y;
-        if (!invertY) {
-            srcY = srcBounds.y2 - y - 1;
-        }
-
+    const int width = rect.x2 - rect.x1;
+    convertRowsInBands(rect, [&](int y1, int y2) {
+        // the bytes written to dst may alias the variables captured by reference, copy them
+        const int inR = inROffset, inG = inGOffset, inB = inBOffset, inA = (inputHasAlpha && premult) ? inAOffset : -1;
+        const int outR = outROffset, outG = outGOffset, outB = outBOffset, outA = outputHasAlpha ? outAOffset : -1;
+        const int inSize = inPackingSize, outSize = outPackingSize;
+        const unsigned short* table = toFunc_hipart_to_uint8xx;
+
+        for (int y = y1; y < y2; ++y) {
+            int srcY = y;
+            if (!invertY) {
+                srcY = srcBounds.y2 - y - 1;
+            }
 
-        int dstY = dstBounds.y2 - y - 1;
-        const float *src_pixels = from + (srcY * (srcBounds.x2 - srcBounds.x1) * inPackingSize);
-        unsigned char *dst_pixels = to + (dstY * (dstBounds.x2 - dstBounds.x1) * outPackingSize);
-        /* go forwards from starting point to end of line: */
-        for (int x = start; x < rect.x2; ++x) {
-            int inCol = x * inPackingSize;
-            int outCol = x * outPackingSize;
-            float a = (inputHasAlpha && premult) ? src_pixels[inCol + inAOffset] : 1.f;
-            error_r = (error_r & 0xff) + toFunc_hipart_to_uint8xx[hipart(src_pixels[inCol + inROffset] * a)];
-            error_g = (error_g & 0xff) + toFunc_hipart_to_uint8xx[hipart(src_pixels[inCol + inGOffset] * a)];
-            error_b = (error_b & 0xff) + toFunc_hipart_to_uint8xx[hipart(src_pixels[inCol + inBOffset] * a)];
-            assert(error_r < 0x10000 && error_g < 0x10000 && error_b < 0x10000);
-            dst_pixels[outCol + outROffset] = (unsigned char)(error_r >> 8);
-            dst_pixels[outCol + outGOffset] = (unsigned char)(error_g >> 8);
-            dst_pixels[outCol + outBOffset] = (unsigned char)(error_b >> 8);
-            if (outputHasAlpha) {
-                // alpha is linear and should not be dithered
-                dst_pixels[outCol + outAOffset] = floatToInt<256>(a);
+            int dstY = dstBounds.y2 - y - 1;
+            const float *src_pixels = from + (srcY * (srcBounds.x2 - srcBounds.x1) + rect.x1) * inSize;
+            unsigned char *dst_pixels = to + (dstY * (dstBounds.x2 - dstBounds.x1) + rect.x1) * outSize;
+            const int start = getDitheringStart(y, width);
+            unsigned error_r, error_g, error_b;
+            error_r = error_g = error_b = 0x80;
+            /* go forwards from starting point to end of line: */
+            for (int x = start; x < width; ++x) {
+                int inCol = x * inSize;
+                int outCol = x * outSize;
+                float a = (inA != -1) ? src_pixels[inCol + inA] : 1.f;
+                error_r = (error_r & 0xff) + table[hipart(src_pixels[inCol + inR] * a)];
+                error_g = (error_g & 0xff) + table[hipart(src_pixels[inCol + inG] * a)];
+                error_b = (error_b & 0xff) + table[hipart(src_pixels[inCol + inB] * a)];
+                assert(error_r < 0x10000 && error_g < 0x10000 && error_b < 0x10000);
+                dst_pixels[outCol + outR] = (unsigned char)(error_r >> 8);
+                dst_pixels[outCol + outG] = (unsigned char)(error_g >> 8);
+                dst_pixels[outCol + outB] = (unsigned char)(error_b >> 8);
+                if (outA != -1) {
+                    // alpha is linear and should not be dithered
+                    dst_pixels[outCol + outA] = floatToInt<256>(a);
+                }
             }
-        }
-        /* go backwards from starting point to start of line: */
-        error_r = error_g = error_b = 0x80;
-        for (int x = start - 1; x >= rect.x1; --x) {
-            int inCol = x * inPackingSize;
-            int outCol = x * outPackingSize;
-            float a = (inputHasAlpha && premult) ? src_pixels[inCol + inAOffset] : 1.f;
-            error_r = (error_r & 0xff) + toFunc_hipart_to_uint8xx[hipart(src_pixels[inCol + inROffset] * a)];
-            error_g = (error_g & 0xff) + toFunc_hipart_to_uint8xx[hipart(src_pixels[inCol + inGOffset] * a)];
-            error_b = (error_b & 0xff) + toFunc_hipart_to_uint8xx[hipart(src_pixels[inCol + inBOffset] * a)];
-            assert(error_r < 0x10000 && error_g < 0x10000 && error_b < 0x10000);
-            dst_pixels[outCol + outROffset] = (unsigned char)(error_r >> 8);
-            dst_pixels[outCol + outGOffset] = (unsigned char)(error_g >> 8);
-            dst_pixels[outCol + outBOffset] = (unsigned char)(error_b >> 8);
-            if (outputHasAlpha) {
-                // alpha is linear and should not be dithered
-                dst_pixels[outCol + outAOffset] = floatToInt<256>(a);
+            /* go backwards from starting point to start of line: */
+            error_r = error_g = error_b = 0x80;
+            for (int x = start - 1; x >= 0; --x) {
+                int inCol = x * inSize;
+                int outCol = x * outSize;
+                float a = (inA != -1) ? src_pixels[inCol + inA] : 1.f;
+                error_r = (error_r & 0xff) + table[hipart(src_pixels[inCol + inR] * a)];
+                error_g = (error_g & 0xff) + table[hipart(src_pixels[inCol + inG] * a)];
+                error_b = (error_b & 0xff) + table[hipart(src_pixels[inCol + inB] * a)];
+                assert(error_r < 0x10000 && error_g < 0x10000 && error_b < 0x10000);
+                dst_pixels[outCol + outR] = (unsigned char)(error_r >> 8);
+                dst_pixels[outCol + outG] = (unsigned char)(error_g >> 8);
+                dst_pixels[outCol + outB] = (unsigned char)(error_b >> 8);
+                if (outA != -1) {
+                    // alpha is linear and should not be dithered
+                    dst_pixels[outCol + outA] = floatToInt<256>(a);
+                }
             }
         }
-    }
+    });
 } // to_byte_packed
 
 #ifdef DEAD_CODE
@@ -565,29 +1121,31 @@ Lut::to_float_packed(float* to,
 
     validate();
 
-    for (int y = rect.y1; y < rect.y2; ++y) {
-        int srcY = y;
-        if (invertY) {
-            srcY = srcBounds.y2 - y - 1;
-        }
+    const int inOffsets[3] = { inROffset, inGOffset, inBOffset };
+    const int outOffsets[3] = { outROffset, outGOffset, outBOffset };
+    const int width = rect.x2 - rect.x1;
+    convertRowsInBands(rect, [&](int y1, int y2) {
+        for (int y = y1; y < y2; ++y) {
+            int srcY = y;
+            if (invertY) {
+                srcY = srcBounds.y2 - y - 1;
+            }
 
-        int dstY = dstBounds.y2 - y - 1;
-        const float *src_pixels = from + (srcY * (srcBounds.x2 - srcBounds.x1) * inPackingSize);
-        float *dst_pixels = to + (dstY * (dstBounds.x2 - dstBounds.x1) * outPackingSize);
-        /* go forwards from starting point to end of line: */
-        for (int x = rect.x1; x < rect.x2; ++x) {
-            int inCol = x * inPackingSize;
-            int outCol = x * outPackingSize;
-            float a = (inputHasAlpha && premult) ? src_pixels[inCol + inAOffset] : 1.f;;
-            dst_pixels[outCol + outROffset] = toColorSpaceFloatFromLinearFloat(src_pixels[inCol + inROffset] * a);
-            dst_pixels[outCol + outGOffset] = toColorSpaceFloatFromLinearFloat(src_pixels[inCol + inGOffset] * a);
-            dst_pixels[outCol + outBOffset] = toColorSpaceFloatFromLinearFloat(src_pixels[inCol + inBOffset] * a);
+            int dstY = dstBounds.y2 - y - 1;
+            const float *src_pixels = from + (srcY * (srcBounds.x2 - srcBounds.x1) + rect.x1) * inPackingSize;
+            float *dst_pixels = to + (dstY * (dstBounds.x2 - dstBounds.x1) + rect.x1) * outPackingSize;
+            const float* alpha = (inputHasAlpha && premult) ? src_pixels + inAOffset : NULL;
+            for (int c = 0; c < 3; ++c) {
+                toColorSpaceRow(src_pixels + inOffsets[c], alpha, inPackingSize, width, dst_pixels + outOffsets[c], outPackingSize);
+            }
             if (outputHasAlpha) {
                 // alpha is linear and should not be dithered
-                dst_pixels[outCol + outAOffset] = a;
+                for (int x = 0; x < width; ++x) {
+                    dst_pixels[x * outPackingSize + outAOffset] = alpha ? alpha[x * inPackingSize] : 1.f;
+                }
             }
         }
-    }
+    });
 }
 
 void
@@ -600,9 +1158,7 @@ Lut::from_byte_planar(float* to,
 {
     validate();
     if (!alpha) {
-        for (int f = 0, t = 0; f < W; f += inDelta, t += outDelta) {
-            to[f] = fromFunc_uint8_to_float[(int)from[f]];
-        }
+        fromByteRow(from, inDelta, (W + inDelta - 1) / inDelta, to, outDelta);
     } else {
         for (int f = 0, t = 0; f < W; f += inDelta, t += outDelta) {
             to[t] = alpha[f] <= 0 ? 0 : Color::intToFloat<256>(fromFunc_uint8_to_float[(from[f] * 255 + 128) / alpha[f]] * alpha[f]);
@@ -630,16 +1186,7 @@ Lut::from_float_planar(float* to,
                        int outDelta) const
 {
     validate();
-    if (!alpha) {
-        for (int f = 0, t = 0; f < W; f += inDelta, t += outDelta) {
-            to[t] = fromColorSpaceFloatToLinearFloat(from[f]);
-        }
-    } else {
-        for (int f = 0, t = 0; f < W; f += inDelta, t += outDelta) {
-            float a = alpha[f];
-            to[t] = a <= 0. ? 0. : fromColorSpaceFloatToLinearFloat(from[f] / a) * a;
-        }
-    }
+    fromColorSpaceRow(from, alpha, inDelta, (W + inDelta - 1) / inDelta, to, outDelta);
 }
 
 void
@@ -676,50 +1223,52 @@ Lut::from_byte_packed(float* to,
     outPackingSize = outputHasAlpha ? 4 : 3;
 
     validate();
-    for (int y = rect.y1; y < rect.y2; ++y) {
-        int srcY = y;
-        if (invertY) {
-            srcY = srcBounds.y2 - y - 1;
-        }
 
-        const unsigned char *src_pixels = from + (srcY * (srcBounds.x2 - srcBounds.x1) * inPackingSize);
-        float *dst_pixels = to + (y * (dstBounds.x2 - dstBounds.x1) * outPackingSize);
-        for (int x = rect.x1; x < rect.x2; ++x) {
-            int inCol = x * inPackingSize;
-            int outCol = x * outPackingSize;
+    const int inOffsets[3] = { inROffset, inGOffset, inBOffset };
+    const int outOffsets[3] = { outROffset, outGOffset, outBOffset };
+    const int width = rect.x2 - rect.x1;
+    convertRowsInBands(rect, [&](int y1, int y2) {
+        for (int y = y1; y < y2; ++y) {
+            int srcY = y;
+            if (invertY) {
+                srcY = srcBounds.y2 - y - 1;
+            }
+
+            const unsigned char *src_pixels = from + (srcY * (srcBounds.x2 - srcBounds.x1) + rect.x1) * inPackingSize;
+            float *dst_pixels = to + (y * (dstBounds.x2 - dstBounds.x1) + rect.x1) * outPackingSize;
             if (inputHasAlpha && premult) {
-                float rf = 0., gf = 0., bf = 0.;
-                float a = Color::intToFloat<256>(src_pixels[inCol + inAOffset]);
-                if (a > 0) {
-                    rf = Color::intToFloat<256>(src_pixels[inCol + inROffset]) / a;
-                    gf = Color::intToFloat<256>(src_pixels[inCol + inGOffset]) / a;
-                    bf = Color::intToFloat<256>(src_pixels[inCol + inBOffset]) / a;
-                }
-                // we may lose a bit of information, but hey, it's 8-bits anyway, who cares?
-                dst_pixels[outCol + outROffset] = fromColorSpaceUint8ToLinearFloatFast( Color::floatToInt<256>(rf) ) * a;
-                dst_pixels[outCol + outGOffset] = fromColorSpaceUint8ToLinearFloatFast( Color::floatToInt<256>(gf) ) * a;
-                dst_pixels[outCol + outBOffset] = fromColorSpaceUint8ToLinearFloatFast( Color::floatToInt<256>(bf) ) * a;
-                if (outputHasAlpha) {
-                    // alpha is linear
-                    dst_pixels[outCol + outAOffset] = a;
+                for (int x = 0; x < width; ++x) {
+                    int inCol = x * inPackingSize;
+                    int outCol = x * outPackingSize;
+                    float rf = 0., gf = 0., bf = 0.;
+                    float a = Color::intToFloat<256>(src_pixels[inCol + inAOffset]);
+                    if (a > 0) {
+                        rf = Color::intToFloat<256>(src_pixels[inCol + inROffset]) / a;
+                        gf = Color::intToFloat<256>(src_pixels[inCol + inGOffset]) / a;
+                        bf = Color::intToFloat<256>(src_pixels[inCol + inBOffset]) / a;
+                    }
+                    // we may lose a bit of information, but hey, it's 8-bits anyway, who cares?
+                    dst_pixels[outCol + outROffset] = fromColorSpaceUint8ToLinearFloatFast( Color::floatToInt<256>(rf) ) * a;
+                    dst_pixels[outCol + outGOffset] = fromColorSpaceUint8ToLinearFloatFast( Color::floatToInt<256>(gf) ) * a;
+                    dst_pixels[outCol + outBOffset] = fromColorSpaceUint8ToLinearFloatFast( Color::floatToInt<256>(bf) ) * a;
+                    if (outputHasAlpha) {
+                        // alpha is linear
+                        dst_pixels[outCol + outAOffset] = a;
+                    }
                 }
             } else {
-                int r8 = 0, g8 = 0, b8 = 0;
-                r8 = src_pixels[inCol + inROffset];
-                g8 = src_pixels[inCol + inGOffset];
-                b8 = src_pixels[inCol + inBOffset];
-                assert(r8 >= 0 && r8 < 256 && g8 >= 0 && g8 < 256 && b8 >= 0 && b8 < 256);
-                dst_pixels[outCol + outROffset] = fromFunc_uint8_to_float[r8];
-                dst_pixels[outCol + outGOffset] = fromFunc_uint8_to_float[g8];
-                dst_pixels[outCol + outBOffset] = fromFunc_uint8_to_float[b8];
+                for (int c = 0; c < 3; ++c) {
+                    fromByteRow(src_pixels + inOffsets[c], inPackingSize, width, dst_pixels + outOffsets[c], outPackingSize);
+                }
                 if (outputHasAlpha) {
                     // alpha is linear
-                    float a = Color::intToFloat<256>(src_pixels[inCol + inAOffset]);
-                    dst_pixels[outCol + outAOffset] = a;
+                    for (int x = 0; x < width; ++x) {
+                        dst_pixels[x * outPackingSize + outAOffset] = inputHasAlpha ? Color::intToFloat<256>(src_pixels[x * inPackingSize + inAOffset]) : 1.f;
+                    }
                 }
             }
         }
-    }
+    });
 } // from_byte_packed
 
 void
@@ -771,32 +1320,29 @@ Lut::from_float_packed(float* to,
 
     validate();
 
-    for (int y = rect.y1; y < rect.y2; ++y) {
-        int srcY = y;
-        if (invertY) {
-            srcY = srcBounds.y2 - y - 1;
-        }
-        const float *src_pixels = from + (srcY * (srcBounds.x2 - srcBounds.x1) * inPackingSize);
-        float *dst_pixels = to + (y * (dstBounds.x2 - dstBounds.x1) * outPackingSize);
-        for (int x = rect.x1; x < rect.x2; ++x) {
-            int inCol = x * inPackingSize;
-            int outCol = x * outPackingSize;
-            float a = (inputHasAlpha && premult) ? src_pixels[inCol + inAOffset] : 1.f;;
-            float rf = 0., gf = 0., bf = 0.;
-            if (a > 0.) {
-                rf = src_pixels[inCol + inROffset] / a;
-                gf = src_pixels[inCol + inGOffset] / a;
-                bf = src_pixels[inCol + inBOffset] / a;
+    const int inOffsets[3] = { inROffset, inGOffset, inBOffset };
+    const int outOffsets[3] = { outROffset, outGOffset, outBOffset };
+    const int width = rect.x2 - rect.x1;
+    convertRowsInBands(rect, [&](int y1, int y2) {
+        for (int y = y1; y < y2; ++y) {
+            int srcY = y;
+            if (invertY) {
+                srcY = srcBounds.y2 - y - 1;
+            }
+            const float *src_pixels = from + (srcY * (srcBounds.x2 - srcBounds.x1) + rect.x1) * inPackingSize;
+            float *dst_pixels = to + (y * (dstBounds.x2 - dstBounds.x1) + rect.x1) * outPackingSize;
+            const float* alpha = (inputHasAlpha && premult) ? src_pixels + inAOffset : NULL;
+            for (int c = 0; c < 3; ++c) {
+                fromColorSpaceRow(src_pixels + inOffsets[c], alpha, inPackingSize, width, dst_pixels + outOffsets[c], outPackingSize);
             }
-            dst_pixels[outCol + outROffset] = fromColorSpaceFloatToLinearFloat(rf) * a;
-            dst_pixels[outCol + outGOffset] = fromColorSpaceFloatToLinearFloat(gf) * a;
-            dst_pixels[outCol + outBOffset] = fromColorSpaceFloatToLinearFloat(bf) * a;
             if (outputHasAlpha) {
                 // alpha is linear
-                dst_pixels[outCol + outAOffset] = a;
+                for (int x = 0; x < width; ++x) {
+                    dst_pixels[x * outPackingSize + outAOffset] = alpha ? alpha[x * inPackingSize] : 1.f;
+                }
             }
         }
-    }
+    });
 } // from_float_packed
 
 ///////////////////////
@@ -1290,7 +1836,10 @@ to_float_packed(float* to,
 const Lut*
 LutManager::sRGBLut()
 {
-    return LutManager::m_instance.getLut("sRGB", from_func_srgb, to_func_srgb);
+    // the parameters of from_func_srgb and to_func_srgb
+    static const PowerTransferFunction srgb = { 12.92f, 0.0031308f, 0.04045f, 1.055f, 0.055f, 1.0f / 2.4f, 2.4f };
+
+    return LutManager::m_instance.getLut("sRGB", from_func_srgb, to_func_srgb, &srgb);
 }
 
 // Rec.709 and Rec.2020 share the same transfer function (and illuminant), except that
@@ -1330,7 +1879,10 @@ to_func_Rec709(float v)
 const Lut*
 LutManager::Rec709Lut()
 {
-    return LutManager::m_instance.getLut("Rec709", from_func_Rec709, to_func_Rec709);
+    // the parameters of from_func_Rec709 and to_func_Rec709
+    static const PowerTransferFunction rec709 = { 4.5f, 0.0181f, 0.08145f, 1.0993f, 1.0993f - 1.f, 0.45f, 1.0f / 0.45f };
+
+    return LutManager::m_instance.getLut("Rec709", from_func_Rec709, to_func_Rec709, &rec709);
 }
 
 /*
@@ -33,6 +33,7 @@
 ///
 
 
+#include <cassert>
 #include <cmath>
 #include <map>
 #include <string>
@@ -65,6 +66,43 @@ typedef float (*fromColorSpaceFunctionV1)(float v);
 /* @brief Converts a float ranging in [0 - 1.f] in  linear color-space to the desired color-space to also ranging in [0 - 1.f]*/
 typedef float (*toColorSpaceFunctionV1)(float v);
 
+/* @brief The parameters of a transfer function made of a linear segment near black and of a power function above it,
+ * such as the sRGB and Rec.709 ones, for which the Lut has vectorized conversions:
+ * to(v) = v < linearBreak ? max(v, 0) * slope : scale * pow(v, toExponent) - offset
+ * from(v) = v < encodedBreak ? max(v, 0) / slope : pow( (v + offset) / scale, fromExponent )
+ * The vectorized conversions approximate pow() with a relative error below 1e-6.
+ */
+struct PowerTransferFunction
+{
+    float slope;
+    float linearBreak;
+    float encodedBreak;
+    float scale;
+    float offset;
+    float toExponent;
+    float fromExponent;
+};
+
+/// @enum The implementations of the conversions of rows of pixels by Lut.
+enum LutImplementationEnum
+{
+    eLutImplementationScalar = 0,
+    eLutImplementationSSE2,
+    eLutImplementationAVX2
+};
+
+/* @brief Returns the fastest implementation supported by this CPU, which is checked once.
+ */
+LutImplementationEnum getBestLutImplementation();
+
+/* @brief Returns the implementation used by Lut, which is the fastest one unless setLutImplementation() was called.
+ */
+LutImplementationEnum getLutImplementation();
+
+/* @brief Forces the implementation used by Lut, which must be supported by the CPU. This is meant for tests and benchmarks.
+ */
+void setLutImplementation(LutImplementationEnum impl);
+
 
 // a Singleton that holds precomputed LUTs for the whole application.
 // The m_instance member is static and is thus built before the first call to Instance().
@@ -84,7 +122,8 @@ public:
      * If a lut with the same name didn't already exist, then it will create one.
      * WARNING : NOT THREAD-SAFE
      **/
-    static const Lut * getLut(const std::string & name, fromColorSpaceFunctionV1 fromFunc, toColorSpaceFunctionV1 toFunc);
+    static const Lut * getLut(const std::string & name, fromColorSpaceFunctionV1 fromFunc, toColorSpaceFunctionV1 toFunc,
+                              const PowerTransferFunction* powerFunc = NULL);
 
     ///buit-ins color-spaces
     static const Lut* sRGBLut();
@@ -135,6 +174,7 @@ class Lut
     std::string _name;         ///< name of the lut
     fromColorSpaceFunctionV1 _fromFunc;
     toColorSpaceFunctionV1 _toFunc;
+    const PowerTransferFunction* _powerFunc; ///< if not NULL, the parameters of _fromFunc and _toFunc, for vectorized conversions
 
     /// the fast lookup tables are mutable, because they are automatically initialized post-construction,
     /// and never change afterwards
@@ -147,10 +187,12 @@ class Lut
     ///private constructor, used by LutManager
     Lut(const std::string & name,
         fromColorSpaceFunctionV1 fromFunc,
-        toColorSpaceFunctionV1 toFunc)
+        toColorSpaceFunctionV1 toFunc,
+        const PowerTransferFunction* powerFunc)
         : _name(name)
         , _fromFunc(fromFunc)
         , _toFunc(toFunc)
+        , _powerFunc(powerFunc)
         , init_(false)
         , _lock()
     {
@@ -161,6 +203,15 @@ class Lut
     ///Called by validate()
     void fillTables() const;
 
+    /// The conversions of n values of a row, strided by the given number of elements, with the implementation
+    /// returned by getLutImplementation(). The alpha pointers, which may be NULL, have the same stride as src.
+    /// toColorSpaceRow: dst[i] = to(src[i] * alpha[i])
+    void toColorSpaceRow(const float* src, const float* alpha, int srcStride, int n, float* dst, int dstStride) const;
+    /// fromColorSpaceRow: dst[i] = alpha[i] > 0 ? from(src[i] / alpha[i]) * alpha[i] : 0
+    void fromColorSpaceRow(const float* src, const float* alpha, int srcStride, int n, float* dst, int dstStride) const;
+    /// fromByteRow: dst[i] = fromFunc_uint8_to_float[src[i]]
+    void fromByteRow(const unsigned char* src, int srcStride, int n, float* dst, int dstStride) const;
+
 public:
 
     /* @brief Converts a float ranging in [0 - 1.f] in the desired color-space to linear color-space also ranging in [0 - 1.f]
@@ -198,6 +249,16 @@ public:
         return _name;
     }
 
+    /* @brief Returns the table used by toColorSpaceUint8xxFromLinearFloatFast(), for vectorized conversions:
+     * the value for v is at index (float bits of v) >> 16.
+     */
+    const unsigned short* getToColorSpaceUint8xxTable() const
+    {
+        assert(init_);
+
+        return toFunc_hipart_to_uint8xx;
+    }
+
     /* @brief Converts a float ranging in [0 - 1.f] in linear color-space using the look-up tables.
      * @return A float in [0 - 1.f] in the destination color-space.
      */
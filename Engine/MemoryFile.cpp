@@ -413,6 +413,64 @@ MemoryFile::flush(FlushTypeEnum type, void* data, std::size_t size)
     return false;
 }
 
+void
+MemoryFile::prefetch(void* data,
+                     std::size_t size) const
+{
+    char* ptr = data ? (char*)data : _imp->data;
+    std::size_t n = data ? size : _imp->size;
+
+    if (!ptr || !n) {
+        return;
+    }
+#if defined(__NATRON_UNIX__)
+    // madvise requires an address aligned on a page boundary
+    std::size_t pageSize = (std::size_t)::sysconf(_SC_PAGESIZE);
+    std::size_t misalignment = (std::size_t)ptr % pageSize;
+    int rc;
+#ifdef POSIX_MADV_WILLNEED
+    rc = posix_madvise(ptr - misalignment, n + misalignment, POSIX_MADV_WILLNEED);
+#else
+    rc = madvise(ptr - misalignment, n + misalignment, MADV_WILLNEED);
+#endif
+    Q_UNUSED(rc);
+#elif defined(__NATRON_WIN32__)
+    // There is no portable read-ahead hint for a view of a file: touch each page so that it is
+    // faulted in by the calling thread rather than by the thread that reads the data.
+    SYSTEM_INFO info;
+    ::GetSystemInfo(&info);
+    std::size_t pageSize = (std::size_t)info.dwPageSize;
+    volatile char sum = 0;
+    for (std::size_t i = 0; i < n; i += pageSize) {
+        sum += ptr[i];
+    }
+    sum += ptr[n - 1];
+    Q_UNUSED(sum);
+#endif
+}
+
+void
+MemoryFile::prefetchFile(const std::string & filepath,
+                         std::size_t offset,
+                         std::size_t size)
+{
+#if defined(__NATRON_UNIX__) && defined(POSIX_FADV_WILLNEED)
+    int fd = ::open(filepath.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return;
+    }
+    int rc = posix_fadvise(fd, (off_t)offset, (off_t)size, POSIX_FADV_WILLNEED);
+    Q_UNUSED(rc);
+    ::close(fd);
+#else
+    // No read-ahead hint without mapping the file (e.g on macOS and Windows): the pages will be read
+    // when the file is mapped.
+    Q_UNUSED(filepath);
+    Q_UNUSED(offset);
+    Q_UNUSED(size);
+#endif
+}
+
 MemoryFile::~MemoryFile()
 {
     if (_imp->data) {
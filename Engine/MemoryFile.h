@@ -146,6 +146,20 @@ public:
      **/
     bool flush(FlushTypeEnum type, void* data, std::size_t size);
 
+    /**
+     * @brief Asks the system to read the pages of the file into memory ahead of their use.
+     * @param data If non null, only the portion starting at data and spanning size bytes
+     * will be read ahead
+     * This may block on I/O and should be called from a worker thread.
+     **/
+    void prefetch(void* data, std::size_t size) const;
+
+    /**
+     * @brief Same as prefetch() for a file that is not mapped. If size is 0, the whole file
+     * after offset is read ahead.
+     **/
+    static void prefetchFile(const std::string & filepath, std::size_t offset, std::size_t size);
+
     /**
      * @brief Returns the filepath of the backing file.
      **/
@@ -851,7 +851,7 @@ Node::computeHashInternal()
         //        }
 
         ///Also append the effect's label to distinguish 2 instances with the same parameters
-        Hash64_appendQString( &_imp->hash, QString::fromUtf8( getScriptName().c_str() ) );
+        Hash64_appendStdString( &_imp->hash, getScriptName() );
 
         ///Also append the project's creation time in the hash because 2 projects opened concurrently
         ///could reproduce the same (especially simple graphs like Viewer-Reader)
@@ -1599,6 +1599,7 @@ Node::makeInfoForInput(int inputNumber) const
                 break;
             case eImageBitDepthHalf:
                 depthStr = tr("16fp");
+                break;
             case eImageBitDepthNone:
                 break;
         }
@@ -3420,8 +3421,10 @@ Node::makePreviewImage(SequenceTime time,
             renderPreviewForDepth<unsigned short, 65535>(*img, elemCount, width, height, convertToSrgb, buf);
             break;
         }
-        case eImageBitDepthHalf:
+        case eImageBitDepthHalf: {
+            renderPreviewForDepth<Half, 1>(*img, elemCount, width, height, convertToSrgb, buf);
             break;
+        }
         case eImageBitDepthFloat: {
             renderPreviewForDepth<float, 1>(*img, elemCount, width, height, convertToSrgb, buf);
             break;
@@ -5999,6 +6002,16 @@ Node::shouldCacheOutput(bool isFrameVaryingOrAnimated,
     return false;
 } // Node::shouldCacheOutput
 
+ImageBitDepthEnum
+Node::getCachedImagesBitDepth(ImageBitDepthEnum depth) const
+{
+    if ( (depth == eImageBitDepthFloat) && appPTR->getCurrentSettings()->isHalfFloatImagesStorageEnabled() ) {
+        return eImageBitDepthHalf;
+    }
+
+    return depth;
+}
+
 bool
 Node::refreshLayersChoiceSecretness(int inputNb)
 {
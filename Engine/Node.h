@@ -340,6 +340,13 @@ public:
     bool isSupportedBitDepth(ImageBitDepthEnum depth) const;
     ImageBitDepthEnum getClosestSupportedBitDepth(ImageBitDepthEnum depth);
 
+    /**
+     * @brief Returns the bitdepth in which the images of this node rendered in the given depth are stored in the cache.
+     * Float images are stored in half float when the "Store float images in half float" preference is checked,
+     * the plug-in still renders in float and its output is converted when copied to the cached image.
+     **/
+    ImageBitDepthEnum getCachedImagesBitDepth(ImageBitDepthEnum depth) const;
+
     /**
      * @brief Returns the components and index of the channel to use to produce the mask.
      * None = -1
@@ -918,21 +918,30 @@ Node::isSupportedComponent(int inputNb,
 ImageBitDepthEnum
 Node::getClosestSupportedBitDepth(ImageBitDepthEnum depth)
 {
+    // The requested depth wins wherever it is in the list, e.g. half must not be turned into float
+    // because the plug-in happens to list float first
+    if ( std::find(_imp->supportedDepths.begin(), _imp->supportedDepths.end(), depth) != _imp->supportedDepths.end() ) {
+        return depth;
+    }
+
+    bool foundHalf = false;
     bool foundShort = false;
     bool foundByte = false;
 
     for (std::list<ImageBitDepthEnum>::const_iterator it = _imp->supportedDepths.begin(); it != _imp->supportedDepths.end(); ++it) {
-        if (*it == depth) {
-            return depth;
-        } else if (*it == eImageBitDepthFloat) {
+        if (*it == eImageBitDepthFloat) {
             return eImageBitDepthFloat;
+        } else if (*it == eImageBitDepthHalf) {
+            foundHalf = true;
         } else if (*it == eImageBitDepthShort) {
             foundShort = true;
         } else if (*it == eImageBitDepthByte) {
             foundByte = true;
         }
     }
-    if (foundShort) {
+    if (foundHalf) {
+        return eImageBitDepthHalf;
+    } else if (foundShort) {
         return eImageBitDepthShort;
     } else if (foundByte) {
         return eImageBitDepthByte;
@@ -947,6 +956,7 @@ Node::getClosestSupportedBitDepth(ImageBitDepthEnum depth)
 ImageBitDepthEnum
 Node::getBestSupportedBitDepth() const
 {
+    bool foundHalf = false;
     bool foundShort = false;
     bool foundByte = false;
 
@@ -961,6 +971,7 @@ Node::getBestSupportedBitDepth() const
             break;
 
         case eImageBitDepthHalf:
+            foundHalf = true;
             break;
 
         case eImageBitDepthFloat:
@@ -972,7 +983,9 @@ Node::getBestSupportedBitDepth() const
         }
     }
 
-    if (foundShort) {
+    if (foundHalf) {
+        return eImageBitDepthHalf;
+    } else if (foundShort) {
         return eImageBitDepthShort;
     } else if (foundByte) {
         return eImageBitDepthByte;
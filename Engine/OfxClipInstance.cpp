@@ -195,6 +195,8 @@ OfxClipInstance::getUnmappedBitDepth() const
         const std::string& ret = natronsDepthToOfxDepth( effect->getNode()->getClosestSupportedBitDepth(eImageBitDepthFloat) );
         if (ret == floatStr) {
             return floatStr;
+        } else if (ret == halfStr) {
+            return halfStr;
         } else if (ret == shortStr) {
             return shortStr;
         } else if (ret == byteStr) {
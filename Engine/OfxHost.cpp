@@ -52,7 +52,6 @@ CLANG_DIAG_ON(deprecated-register)
 #ifdef OFX_SUPPORTS_MULTITHREAD
 #include <QtCore/QThread>
 #include <QtCore/QThreadStorage>
-#include <QtConcurrentMap> // QtCore on Qt4, QtConcurrent on Qt5
 #endif
 CLANG_DIAG_ON(deprecated)
 CLANG_DIAG_ON(uninitialized)
@@ -108,6 +107,7 @@ CLANG_DIAG_ON(unknown-pragmas)
 #include "Engine/Project.h"
 #include "Engine/Settings.h"
 #include "Engine/StandardPaths.h"
+#include "Engine/TaskScheduler.h"
 #include "Engine/TLSHolder.h"
 #include "Engine/ThreadPool.h"
 
@@ -275,6 +275,7 @@ OfxHost::setProperties()
     _properties.setStringProperty(kOfxImageEffectPropSupportedPixelDepths, kOfxBitDepthFloat, 0);
     _properties.setStringProperty(kOfxImageEffectPropSupportedPixelDepths, kOfxBitDepthShort, 1);
     _properties.setStringProperty(kOfxImageEffectPropSupportedPixelDepths, kOfxBitDepthByte, 2);
+    _properties.setStringProperty(kOfxImageEffectPropSupportedPixelDepths, kOfxBitDepthHalf, 3);
 
     _properties.setStringProperty(kOfxImageEffectPropSupportedContexts, kOfxImageEffectContextGenerator, 0 );
     _properties.setStringProperty(kOfxImageEffectPropSupportedContexts, kOfxImageEffectContextFilter, 1);
@@ -1205,8 +1206,8 @@ OfxHost::setThreadAsActionCaller(OfxImageEffectInstance* instance,
 
 NATRON_NAMESPACE_ANONYMOUS_ENTER
 
-///Using QtConcurrent doesn't work with The Foundry Furnace plug-ins because they expect fresh threads
-///to be created. As QtConcurrent's thread-pool recycles thread, it seems to make Furnace crash.
+///Using the task scheduler doesn't work with The Foundry Furnace plug-ins because they expect fresh threads
+///to be created. As the task scheduler recycles threads, it seems to make Furnace crash.
 ///We think this is because Furnace must keep an internal thread-local state that becomes then dirty
 ///if we re-use the same thread.
 
@@ -1360,22 +1361,16 @@ OfxHost::multiThread(OfxThreadFunctionV1 func,
     bool useThreadPool = appPTR->getUseThreadPool();
 
     if (useThreadPool) {
-        std::vector<uint32_t> threadIndexes(nThreads);
-        for (uint32_t i = 0; i < nThreads; ++i) {
-            threadIndexes[i] = i;
-        }
+        std::vector<OfxStatus> status(nThreads, kOfxStatOK);
+
+        /// The task scheduler is limited by the maximum thread count of the global thread pool, see the documentation excerpt above.
+        /// The calling thread runs some of the thread functions itself instead of waiting, so that a multiThread call made
+        /// from a worker of the scheduler (e.g a tile rendered with host frame threading) does not starve the scheduler.
+        appPTR->getTaskScheduler()->parallelFor(nThreads, [&](int tid) {
+            status[tid] = threadFunctionWrapper(func, (unsigned int)tid, nThreads, spawnerThread, customArg);
+        });
 
-        /// DON'T set the maximum thread count, this is a global application setting, and see the documentation excerpt above
-        //QThreadPool::globalInstance()->setMaxThreadCount(nThreads);
-        std::function<OfxStatus (const uint32_t&)> process = [&](const uint32_t tid) {
-            return threadFunctionWrapper(func, tid, nThreads, spawnerThread, customArg);
-        };
-        QFuture<OfxStatus> future = QtConcurrent::mapped( threadIndexes, process );
-        future.waitForFinished();
-        ///DON'T reset back to the original value the maximum thread count
-        //QThreadPool::globalInstance()->setMaxThreadCount(QThread::idealThreadCount());
-
-        for (QFuture<OfxStatus>::const_iterator it = future.begin(); it != future.end(); ++it) {
+        for (std::vector<OfxStatus>::const_iterator it = status.begin(); it != status.end(); ++it) {
             OfxStatus stat = *it;
             if (stat != kOfxStatOK) {
                 return stat;
@@ -1450,6 +1445,9 @@ OfxHost::multiThreadNumCPUS(unsigned int *nCPUs) const
         // activeThreadCount may be negative (for example if releaseThread() is called)
         int activeThreadsCount = QThreadPool::globalInstance()->activeThreadCount();
 
+        // Add the number of busy workers of the task scheduler (host frame threading, multi-thread suite, viewer renders)
+        activeThreadsCount += appPTR->getTaskScheduler()->getActiveThreadCount();
+
         // Add the number of threads already running by the multiThreadSuite + parallel renders
 #ifndef NATRON_PLAYBACK_USES_THREAD_POOL
         activeThreadsCount += appPTR->getNRunningThreads();
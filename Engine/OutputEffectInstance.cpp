@@ -500,6 +500,11 @@ OutputEffectInstance::reportStats(int time,
         ofile << "Nb cache hit: " << nbCacheMiss << std::endl;
         ofile << "Nb cache miss: " << nbCacheMiss << std::endl;
         ofile << "Nb cache hit requiring mipmap downscaling: " << nbCacheHitButDownscaled << std::endl;
+        int nbTilesScheduled, nbTilesStolen, maxSchedulerQueueDepth;
+        it->second.getSchedulerInfos(&nbTilesScheduled, &nbTilesStolen, &maxSchedulerQueueDepth);
+        ofile << "Nb tiles rendered in parallel: " << nbTilesScheduled << std::endl;
+        ofile << "Nb tiles stolen by other threads: " << nbTilesStolen << std::endl;
+        ofile << "Max scheduler queue depth: " << maxSchedulerQueueDepth << std::endl;
 
         const std::set<std::string> & planes = it->second.getPlanesRendered();
         ofile << "Plane(s) rendered: ";
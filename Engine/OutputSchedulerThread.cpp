@@ -61,6 +61,7 @@
 #include "Engine/RenderStats.h"
 #include "Engine/RotoContext.h"
 #include "Engine/Settings.h"
+#include "Engine/TaskScheduler.h"
 #include "Engine/Timer.h"
 #include "Engine/TimeLine.h"
 #include "Engine/TLSHolder.h"
@@ -3352,6 +3353,19 @@ RenderEngine::getDesiredFPS() const
     return _imp->scheduler ? _imp->scheduler->getDesiredFPS() : 24;
 }
 
+RenderDirectionEnum
+RenderEngine::getPlaybackDirection() const
+{
+    RenderDirectionEnum direction = eRenderDirectionForward;
+
+    if (_imp->scheduler) {
+        std::vector<ViewIdx> views;
+        _imp->scheduler->getLastRunArgs(&direction, &views);
+    }
+
+    return direction;
+}
+
 void
 RenderEngine::notifyFrameProduced(const BufferableObjectPtrList& frames,
                                   const RenderStatsPtr& stats,
@@ -3971,20 +3985,24 @@ ViewerCurrentFrameRequestScheduler::renderCurrentFrame(bool enableRenderStats,
         functorArgs->request = request;
 
         /*
-         * Let at least 1 free thread in the thread-pool to allow the renderer to use the thread pool if we use the thread-pool
+         * Let at least 1 free thread in the task scheduler to allow the renderer to use host frame threading
          */
+        TaskScheduler* scheduler = appPTR->getTaskScheduler();
         int maxThreads = _imp->threadPool->maxThreadCount();
 
         //When painting, limit the number of threads to 1 to be sure strokes are painted in the right order
         if (rotoUse1Thread || isTracking) {
             maxThreads = 1;
         }
-        if ( (maxThreads == 1) || (_imp->threadPool->activeThreadCount() >= maxThreads - 1) ) {
+        if ( (maxThreads == 1) || (scheduler->getActiveThreadCount() >= maxThreads - 1) ) {
             _imp->backupThread.startTask(functorArgs);
         } else {
             RenderCurrentFrameFunctorRunnable* task = new RenderCurrentFrameFunctorRunnable(functorArgs);
             _imp->appendRunnableTask(task);
-            _imp->threadPool->start(task);
+            scheduler->start([task]() {
+                task->run();
+                delete task;
+            });
         }
     }
 } // ViewerCurrentFrameRequestScheduler::renderCurrentFrame
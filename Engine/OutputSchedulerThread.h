@@ -687,6 +687,11 @@ public:
      **/
     double getDesiredFPS() const;
 
+    /**
+     * @brief Returns the direction of the last playback started by the internal scheduler
+     **/
+    RenderDirectionEnum getPlaybackDirection() const;
+
     /**
      * @brief Quit all processing, making sure all threads are finished, this is not blocking
      **/
@@ -0,0 +1,87 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * (C) 2018-2023 The Natron developers
+ * (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "PlaybackPrefetchWindow.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <QtCore/QMutexLocker>
+
+// The duration of playback read ahead, in seconds, and the bounds of the number of frames it spans
+#define NATRON_PLAYBACK_PREFETCH_DURATION 0.5
+#define NATRON_PLAYBACK_PREFETCH_MIN_FRAMES 2
+#define NATRON_PLAYBACK_PREFETCH_MAX_FRAMES 32
+
+NATRON_NAMESPACE_ENTER
+
+PlaybackPrefetchWindow::PlaybackPrefetchWindow()
+    : _lock()
+    , _valid(false)
+    , _forward(true)
+    , _lastPrefetchedFrame(0)
+{
+}
+
+int
+PlaybackPrefetchWindow::getWindowSize(double fps)
+{
+    if ( !(fps > 0.) ) {
+        return NATRON_PLAYBACK_PREFETCH_MIN_FRAMES;
+    }
+    double n = std::ceil(fps * NATRON_PLAYBACK_PREFETCH_DURATION);
+
+    return (int)std::max( (double)NATRON_PLAYBACK_PREFETCH_MIN_FRAMES, std::min( (double)NATRON_PLAYBACK_PREFETCH_MAX_FRAMES, n ) );
+}
+
+void
+PlaybackPrefetchWindow::getFramesToPrefetch(int time,
+                                            bool forward,
+                                            double fps,
+                                            std::vector<int>* frames)
+{
+    int n = getWindowSize(fps);
+    int step = forward ? 1 : -1;
+    int lastFrame = time + step * n;
+
+    QMutexLocker k(&_lock);
+
+    // Frames between time and _lastPrefetchedFrame were already read ahead. A frame looked-up late by a playback
+    // thread may be further than n frames behind the last one read ahead.
+    int ahead = (_lastPrefetchedFrame - time) * step;
+    bool continues = _valid && _forward == forward && ahead >= 0 && ahead <= 2 * n;
+    int firstFrame = continues ? _lastPrefetchedFrame + step : time + step;
+
+    for (int t = firstFrame; (t - lastFrame) * step <= 0; t += step) {
+        frames->push_back(t);
+    }
+    if ( !continues || ( (lastFrame - _lastPrefetchedFrame) * step > 0 ) ) {
+        _lastPrefetchedFrame = lastFrame;
+    }
+    _valid = true;
+    _forward = forward;
+}
+
+NATRON_NAMESPACE_EXIT
@@ -0,0 +1,74 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * (C) 2018-2023 The Natron developers
+ * (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_PLAYBACKPREFETCHWINDOW_H
+#define NATRON_ENGINE_PLAYBACKPREFETCHWINDOW_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <vector>
+
+#include <QtCore/QMutex>
+
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief Decides which frames to read ahead from the caches during playback: the frames that are going to be
+ * displayed within the next half second, in the direction of the playback, and that were not read ahead already.
+ *
+ * Playback threads render several frames concurrently and do not necessarily look them up in order, so a frame
+ * behind the last one looked-up does not change the direction: only a jump outside of the window (e.g when the
+ * playback loops) or a change of direction restarts it. This class is MT-safe.
+ **/
+class PlaybackPrefetchWindow
+{
+public:
+
+    PlaybackPrefetchWindow();
+
+    /**
+     * @brief Called for each frame looked-up during playback at the given fps. Appends to frames the frames
+     * to read ahead, in the order in which they will be displayed.
+     **/
+    void getFramesToPrefetch(int time, bool forward, double fps, std::vector<int>* frames);
+
+    /**
+     * @brief Returns the number of frames ahead of the current frame that are read ahead at the given fps.
+     **/
+    static int getWindowSize(double fps);
+
+private:
+
+    QMutex _lock;
+    bool _valid;
+    bool _forward;
+    int _lastPrefetchedFrame;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_PLAYBACKPREFETCHWINDOW_H
@@ -25,6 +25,7 @@
 
 #include "RenderStats.h"
 
+#include <algorithm> // max
 #include <bitset>
 #include <cassert>
 #include <stdexcept>
@@ -66,6 +67,11 @@ struct NodeRenderStatsPrivate
     int nbCacheHit;
     int nbCacheHitButDownscaledImages;
 
+    //Task scheduler infos for host frame threading
+    int nbTilesScheduled;
+    int nbTilesStolen;
+    int maxSchedulerQueueDepth;
+
     //Is tile support enabled for this render
     bool tileSupportEnabled;
 
@@ -89,6 +95,9 @@ struct NodeRenderStatsPrivate
         , nbCacheMisses(0)
         , nbCacheHit(0)
         , nbCacheHitButDownscaledImages(0)
+        , nbTilesScheduled(0)
+        , nbTilesStolen(0)
+        , maxSchedulerQueueDepth(0)
         , tileSupportEnabled(false)
         , renderScaleSupportEnabled(false)
         , channelsEnabled()
@@ -128,6 +137,9 @@ NodeRenderStats::operator=(const NodeRenderStats& other)
     _imp->nbCacheMisses = other._imp->nbCacheMisses;
     _imp->nbCacheHit = other._imp->nbCacheHit;
     _imp->nbCacheHitButDownscaledImages = other._imp->nbCacheHitButDownscaledImages;
+    _imp->nbTilesScheduled = other._imp->nbTilesScheduled;
+    _imp->nbTilesStolen = other._imp->nbTilesStolen;
+    _imp->maxSchedulerQueueDepth = other._imp->maxSchedulerQueueDepth;
     _imp->tileSupportEnabled = other._imp->tileSupportEnabled;
     _imp->renderScaleSupportEnabled = other._imp->renderScaleSupportEnabled;
     for (int i = 0; i < 4; ++i) {
@@ -254,6 +266,26 @@ NodeRenderStats::getCacheAccessInfos(int* nbCacheMisses,
     *nbCacheHitButDownscaledImages = _imp->nbCacheHitButDownscaledImages;
 }
 
+void
+NodeRenderStats::addSchedulerInfo(int nbTiles,
+                                  int nbTilesStolen,
+                                  int queueDepth)
+{
+    _imp->nbTilesScheduled += nbTiles;
+    _imp->nbTilesStolen += nbTilesStolen;
+    _imp->maxSchedulerQueueDepth = std::max(_imp->maxSchedulerQueueDepth, queueDepth);
+}
+
+void
+NodeRenderStats::getSchedulerInfos(int* nbTiles,
+                                   int* nbTilesStolen,
+                                   int* maxQueueDepth) const
+{
+    *nbTiles = _imp->nbTilesScheduled;
+    *nbTilesStolen = _imp->nbTilesStolen;
+    *maxQueueDepth = _imp->maxSchedulerQueueDepth;
+}
+
 void
 NodeRenderStats::setTilesSupported(bool tilesSupported)
 {
@@ -415,6 +447,20 @@ RenderStats::addCacheInfosForNode(const NodePtr& node,
     stats.addCacheAccessInfo(isCacheMiss, hasDownscaled);
 }
 
+void
+RenderStats::addSchedulerInfosForNode(const NodePtr& node,
+                                      int nbTiles,
+                                      int nbTilesStolen,
+                                      int queueDepth)
+{
+    QMutexLocker k(&_imp->lock);
+
+    assert(_imp->doNodesProfiling);
+
+    NodeRenderStats& stats = _imp->findOrCreateNodeStats(node);
+    stats.addSchedulerInfo(nbTiles, nbTilesStolen, queueDepth);
+}
+
 void
 RenderStats::addRenderInfosForNode(const NodePtr& node,
                                    const NodePtr& identity,
@@ -82,6 +82,9 @@ public:
     void addCacheAccessInfo(bool isCacheMiss, bool hasDownscaled);
     void getCacheAccessInfos(int* nbCacheMisses, int* nbCacheHits, int* nbCacheHitButDownscaledImages) const;
 
+    void addSchedulerInfo(int nbTiles, int nbTilesStolen, int queueDepth);
+    void getSchedulerInfos(int* nbTiles, int* nbTilesStolen, int* maxQueueDepth) const;
+
     void setTilesSupported(bool tilesSupported);
     bool isTilesSupportEnabled() const;
 
@@ -131,6 +134,14 @@ public:
                               bool isCacheMiss,
                               bool hasDownscaled);
 
+    /**
+     * @brief Records how the task scheduler dispatched the tiles of a host frame threading render of the node.
+     **/
+    void addSchedulerInfosForNode(const NodePtr& node,
+                                  int nbTiles,
+                                  int nbTilesStolen,
+                                  int queueDepth);
+
     void addRenderInfosForNode(const NodePtr& node,
                                const NodePtr& identity,
                                const std::string& plane,
@@ -60,6 +60,8 @@
 #include "Engine/RotoContextSerialization.h"
 #include "Engine/RotoDrawableItem.h"
 #include "Engine/RotoLayer.h"
+#include "Engine/RotoPaintCompositor.h"
+#include "Engine/RotoShapeRasterizer.h"
 #include "Engine/RotoStrokeItem.h"
 #include "Engine/Settings.h"
 #include "Engine/TimeLine.h"
@@ -166,6 +168,58 @@ RotoContext::getRotoPaintBottomMergeNode() const
     return bottomMerge;
 }
 
+bool
+RotoContext::isRotoPaintItemFlattenable(const RotoDrawableItemPtr& item)
+{
+    RotoStrokeItem* isStroke = dynamic_cast<RotoStrokeItem*>( item.get() );
+    RotoStrokeType type = isStroke ? isStroke->getBrushType() : eRotoStrokeTypeSolid;
+
+    switch (type) {
+    case eRotoStrokeTypeSolid:
+    case eRotoStrokeTypeEraser:
+    case eRotoStrokeTypeDodge:
+    case eRotoStrokeTypeBurn:
+        break;
+    default:
+        // These need the effect node of the item
+        return false;
+    }
+#ifdef NATRON_ROTO_INVERTIBLE
+    if ( item->getInvertedKnob()->getValue() ) {
+        return false;
+    }
+#endif
+
+    return RotoPaintCompositor::isOperatorSupported( (MergingFunctionEnum)item->getCompositingOperator() );
+}
+
+NodePtr
+RotoContext::getRotoPaintFlattenedItems(std::list<RotoDrawableItemPtr>* flattenedItems) const
+{
+    if ( getNode()->isDuringPaintStrokeCreation() ) {
+        return getRotoPaintBottomMergeNode();
+    }
+
+    std::list<RotoDrawableItemPtr> items = getCurvesByRenderOrder(false /*onlyActiveItems*/);
+    std::list<RotoDrawableItemPtr> flattened;
+    NodePtr treeMerge;
+    for (std::list<RotoDrawableItemPtr>::reverse_iterator it = items.rbegin(); it != items.rend(); ++it) {
+        if ( !isRotoPaintItemFlattenable(*it) ) {
+            treeMerge = (*it)->getMergeNode();
+            break;
+        }
+        flattened.push_front(*it);
+    }
+
+    if ( flattened.empty() ) {
+        // The whole tree is rendered as before, possibly through the global merge nodes
+        return getRotoPaintBottomMergeNode();
+    }
+    flattenedItems->insert( flattenedItems->end(), flattened.begin(), flattened.end() );
+
+    return treeMerge;
+}
+
 void
 RotoContext::getRotoPaintTreeNodes(NodesList* nodes) const
 {
@@ -2156,18 +2210,6 @@ CairoImageWrapper::~CairoImageWrapper()
     }
 }
 
-static void
-adjustToPointToScale(unsigned int mipmapLevel,
-                     double &x,
-                     double &y)
-{
-    if (mipmapLevel != 0) {
-        int pot = (1 << mipmapLevel);
-        x /= pot;
-        y /= pot;
-    }
-}
-
 template <typename PIX, int maxValue, int dstNComps, int srcNComps, bool useOpacity, bool inverted>
 static void
 convertCairoImageToNatronImageForInverted_noColor(cairo_surface_t* cairoImg,
@@ -2319,6 +2361,112 @@ convertCairoImageToNatronImage_noColor(cairo_surface_t* cairoImg,
     }
 }
 
+template <typename PIX, int maxValue, int dstNComps, bool inverted>
+static void
+convertCoverageToNatronImageForInverted(const RotoShapeRasterizer& rasterizer,
+                                        Image* image,
+                                        const RectI & pixelRod,
+                                        double shapeColor[3],
+                                        double opacity)
+{
+    Image::WriteAccess acc = image->getWriteRights();
+    const float r = shapeColor[0] * opacity;
+    const float g = shapeColor[1] * opacity;
+    const float b = shapeColor[2] * opacity;
+    const float a = opacity;
+#ifdef DEBUG_NAN
+    assert( !std::isnan(r) ); // check for NaN
+    assert( !std::isnan(g) ); // check for NaN
+    assert( !std::isnan(b) ); // check for NaN
+#endif
+    const int width = pixelRod.width();
+
+    // the rows are written by several threads
+    rasterizer.rasterize(pixelRod, [&](int y, const float* coverage) {
+        PIX* dstPix = (PIX*)acc.pixelAt(pixelRod.x1, y);
+        assert(dstPix);
+
+        for (int x = 0; x < width; ++x,
+             dstPix += dstNComps) {
+            const float cov = ( !inverted ? coverage[x] : 1.f - coverage[x] ) * maxValue;
+            switch (dstNComps) {
+            case 4:
+                dstPix[0] = PIX(cov * r);
+                dstPix[1] = PIX(cov * g);
+                dstPix[2] = PIX(cov * b);
+                dstPix[3] = PIX(cov * a);
+                break;
+            case 1:
+                dstPix[0] = PIX(cov * a);
+                break;
+            case 3:
+                dstPix[0] = PIX(cov * r);
+                dstPix[1] = PIX(cov * g);
+                dstPix[2] = PIX(cov * b);
+                break;
+            case 2:
+                dstPix[0] = PIX(cov * r);
+                dstPix[1] = PIX(cov * g);
+                break;
+
+            default:
+                break;
+            }
+#         ifdef DEBUG_NAN
+            for (int c = 0; c < dstNComps; ++c) {
+                assert( !std::isnan(dstPix[c]) ); // check for NaN
+            }
+#         endif
+        }
+    });
+} // convertCoverageToNatronImageForInverted
+
+template <typename PIX, int maxValue, int dstNComps>
+static void
+convertCoverageToNatronImageForDstComponents(const RotoShapeRasterizer& rasterizer,
+                                             Image* image,
+                                             const RectI & pixelRod,
+                                             double shapeColor[3],
+                                             double opacity,
+                                             bool inverted)
+{
+    if (inverted) {
+        convertCoverageToNatronImageForInverted<PIX, maxValue, dstNComps, true>(rasterizer, image, pixelRod, shapeColor, opacity);
+    } else {
+        convertCoverageToNatronImageForInverted<PIX, maxValue, dstNComps, false>(rasterizer, image, pixelRod, shapeColor, opacity);
+    }
+}
+
+// Rasterizes the coverage of a shape and writes it to the image, multiplied by the color and the opacity
+template <typename PIX, int maxValue>
+static void
+convertCoverageToNatronImage(const RotoShapeRasterizer& rasterizer,
+                             Image* image,
+                             const RectI & pixelRod,
+                             double shapeColor[3],
+                             double opacity,
+                             bool inverted)
+{
+    int comps = (int)image->getComponentsCount();
+
+    switch (comps) {
+    case 1:
+        convertCoverageToNatronImageForDstComponents<PIX, maxValue, 1>(rasterizer, image, pixelRod, shapeColor, opacity, inverted);
+        break;
+    case 2:
+        convertCoverageToNatronImageForDstComponents<PIX, maxValue, 2>(rasterizer, image, pixelRod, shapeColor, opacity, inverted);
+        break;
+    case 3:
+        convertCoverageToNatronImageForDstComponents<PIX, maxValue, 3>(rasterizer, image, pixelRod, shapeColor, opacity, inverted);
+        break;
+    case 4:
+        convertCoverageToNatronImageForDstComponents<PIX, maxValue, 4>(rasterizer, image, pixelRod, shapeColor, opacity, inverted);
+        break;
+    default:
+        break;
+    }
+}
+
 #if 0
 template <typename PIX, int maxValue, int srcNComps, int dstNComps>
 static void
@@ -2720,10 +2868,22 @@ RotoDrawableItem::renderMaskFromStroke(const ImagePlaneDesc& components,
     NodePtr node = getContext()->getNode();
     ImagePtr image; // = stroke->getStrokeTimePreview();
 
-    ///compute an enhanced hash different from the one of the merge node of the item in order to differentiate within the cache
+    RotoStrokeItem* isStroke = dynamic_cast<RotoStrokeItem*>(this);
+
+    ///The mask of a finished stroke which is not animated is baked once in the cache, keyed on the stroke data only:
+    ///it is not rendered again at each frame, nor each time the image upstream changes the hash of the merge node.
+    U64 rotoHash = 0;
+    bool isStaticStroke = isStroke && isStroke->getStaticStrokeHash(&rotoHash);
+#ifdef NATRON_ROTO_INVERTIBLE
+    if ( isStaticStroke && getInverted(time) ) {
+        // The inverted mask covers the RoD of the source of the Roto
+        isStaticStroke = false;
+    }
+#endif
+
+    ///Otherwise compute an enhanced hash different from the one of the merge node of the item in order to differentiate within the cache
     ///the output image of the node and the mask image.
-    U64 rotoHash;
-    {
+    if (!isStaticStroke) {
         Hash64 hash;
         U64 mergeNodeHash = getMergeNode()->getEffectInstance()->getRenderHash();
         hash.append(mergeNodeHash);
@@ -2733,7 +2893,7 @@ RotoDrawableItem::renderMaskFromStroke(const ImagePlaneDesc& components,
     }
     std::unique_ptr<ImageKey> key( new ImageKey(this,
                                                   rotoHash,
-                                                  /*frameVaryingOrAnimated=*/ true,
+                                                  /*frameVaryingOrAnimated=*/ !isStaticStroke,
                                                   time,
                                                   view,
                                                   /*pixelAspect=*/ 1.,
@@ -2750,7 +2910,6 @@ RotoDrawableItem::renderMaskFromStroke(const ImagePlaneDesc& components,
     }
 
 
-    RotoStrokeItem* isStroke = dynamic_cast<RotoStrokeItem*>(this);
     Bezier* isBezier = dynamic_cast<Bezier*>(this);
     double startTime = time, mbFrameStep = 1., endTime = time;
 #ifdef NATRON_ROTO_ENABLE_MOTION_BLUR
@@ -2775,16 +2934,8 @@ RotoDrawableItem::renderMaskFromStroke(const ImagePlaneDesc& components,
     if (isStroke) {
         isStroke->evaluateStroke(mipmapLevel, time, &strokes, &rotoBbox);
     } else if (isBezier) {
-        bool bboxSet = false;
-        for (double t = startTime; t <= endTime; t += mbFrameStep) {
-            RectD subBbox = isBezier->getBoundingBox(t);
-            if (!bboxSet) {
-                rotoBbox = subBbox;
-                bboxSet = true;
-            } else {
-                rotoBbox.merge(subBbox);
-            }
-        }
+        // the bounding box already is the union of the bounding boxes of the motion blur samples
+        rotoBbox = isBezier->getBoundingBox(time);
         if ( isBezier->isOpenBezier() ) {
             std::list<std::list<ParametricPoint> > decastelJauPolygon;
             isBezier->evaluateAtTime_DeCasteljau_autoNbPoints(false, time, mipmapLevel, &decastelJauPolygon, 0);
@@ -2892,6 +3043,32 @@ RotoDrawableItem::renderMaskInternal(const RectI & roi,
 
     double opacity = getOpacity(time);
 
+    if ( isBezier && !isBezier->isOpenBezier() ) {
+        // Closed shapes are rasterized in float, in parallel bands, directly to the image
+        RotoShapeRasterizer rasterizer;
+        RotoContextPrivate::renderBezier(isBezier, time, startTime, endTime, timeStep, mipmapLevel, &rasterizer);
+
+        switch (depth) {
+        case eImageBitDepthFloat:
+            convertCoverageToNatronImage<float, 1>(rasterizer, image.get(), roi, shapeColor, opacity, inverted);
+            break;
+        case eImageBitDepthByte:
+            convertCoverageToNatronImage<unsigned char, 255>(rasterizer, image.get(), roi, shapeColor, opacity, inverted);
+            break;
+        case eImageBitDepthShort:
+            convertCoverageToNatronImage<unsigned short, 65535>(rasterizer, image.get(), roi, shapeColor, opacity, inverted);
+            break;
+        case eImageBitDepthHalf:
+            convertCoverageToNatronImage<Half, 1>(rasterizer, image.get(), roi, shapeColor, opacity, inverted);
+            break;
+        case eImageBitDepthNone:
+            assert(false);
+            break;
+        }
+
+        return image;
+    }
+
     ////Allocate the cairo temporary buffer
     CairoImageWrapper imgWrapper;
 
@@ -2913,22 +3090,19 @@ RotoDrawableItem::renderMaskInternal(const RectI & roi,
     cairo_set_antialias(imgWrapper.ctx, CAIRO_ANTIALIAS_NONE);
 
 
+    // strokes and open beziers are drawn with cairo
     assert(isStroke || isBezier);
-    if ( isStroke || !isBezier || ( isBezier && isBezier->isOpenBezier() ) ) {
-        std::vector<cairo_pattern_t*> dotPatterns(ROTO_PRESSURE_LEVELS);
-        for (std::size_t i = 0; i < dotPatterns.size(); ++i) {
-            dotPatterns[i] = (cairo_pattern_t*)0;
-        }
-        RotoContextPrivate::renderStroke(imgWrapper.ctx, dotPatterns, strokes, 0, this, doBuildUp, opacity, time, mipmapLevel);
+    std::vector<cairo_pattern_t*> dotPatterns(ROTO_PRESSURE_LEVELS);
+    for (std::size_t i = 0; i < dotPatterns.size(); ++i) {
+        dotPatterns[i] = (cairo_pattern_t*)0;
+    }
+    RotoContextPrivate::renderStroke(imgWrapper.ctx, dotPatterns, strokes, 0, this, doBuildUp, opacity, time, mipmapLevel);
 
-        for (std::size_t i = 0; i < dotPatterns.size(); ++i) {
-            if (dotPatterns[i]) {
-                cairo_pattern_destroy(dotPatterns[i]);
-                dotPatterns[i] = 0;
-            }
+    for (std::size_t i = 0; i < dotPatterns.size(); ++i) {
+        if (dotPatterns[i]) {
+            cairo_pattern_destroy(dotPatterns[i]);
+            dotPatterns[i] = 0;
         }
-    } else {
-        RotoContextPrivate::renderBezier(imgWrapper.ctx, isBezier, opacity, time, startTime, endTime, timeStep, mipmapLevel);
     }
 
     bool useOpacityToConvert = (isBezier != 0);
@@ -2945,6 +3119,8 @@ RotoDrawableItem::renderMaskInternal(const RectI & roi,
         convertCairoImageToNatronImage_noColor<unsigned short, 65535>(imgWrapper.cairoImg, srcNComps, image.get(), roi, shapeColor, opacity, inverted, useOpacityToConvert);
         break;
     case eImageBitDepthHalf:
+        convertCairoImageToNatronImage_noColor<Half, 1>(imgWrapper.cairoImg, srcNComps, image.get(), roi, shapeColor, opacity, inverted, useOpacityToConvert);
+        break;
     case eImageBitDepthNone:
         assert(false);
         break;
@@ -3238,12 +3414,11 @@ RotoContext::allocateAndRenderSingleDotStroke(int brushSizePixel,
 }
 
 void
-RotoContextPrivate::renderBezier(cairo_t* cr,
-                                 const Bezier* bezier,
-                                 double opacity,
+RotoContextPrivate::renderBezier(const Bezier* bezier,
                                  double time,
                                  double startTime, double endTime, double mbFrameStep,
-                                 unsigned int mipmapLevel)
+                                 unsigned int mipmapLevel,
+                                 RotoShapeRasterizer* rasterizer)
 {
     ///render the bezier only if finished (closed) and activated
     if ( !bezier->isCurveFinished() || !bezier->isActivated(time) || ( bezier->getControlPointsCount() <= 1 ) ) {
@@ -3252,34 +3427,27 @@ RotoContextPrivate::renderBezier(cairo_t* cr,
 
 
 
+    int nbSamples = 0;
+    for (double t = startTime; t <= endTime; t+=mbFrameStep) {
+        ++nbSamples;
+    }
+
     for (double t = startTime; t <= endTime; t+=mbFrameStep) {
 
         double fallOff = bezier->getFeatherFallOff(t);
         double featherDist = bezier->getFeatherDistance(t);
-        double shapeColor[3];
-        bezier->getColor(t, shapeColor);
-
-
-        cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
-
-        cairo_new_path(cr);
-
-        ////Define the feather edge pattern
-        cairo_pattern_t* mesh = cairo_pattern_create_mesh();
-        if (cairo_pattern_status(mesh) != CAIRO_STATUS_SUCCESS) {
-            cairo_pattern_destroy(mesh);
-
-            return;
-        }
 
         ///Adjust the feather distance so it takes the mipmap level into account
         if (mipmapLevel != 0) {
             featherDist /= (1 << mipmapLevel);
         }
 
-        Transform::Matrix3x3 transform;
-        bezier->getTransformAtTime(t, &transform);
-
+        // the motion blur samples are averaged in the same pass
+        if (nbSamples > 1) {
+            rasterizer->beginAccumulatedLayer(fallOff, 1. / nbSamples);
+        } else {
+            rasterizer->beginLayer(fallOff);
+        }
 
 #ifdef ROTO_RENDER_TRIANGLES_ONLY
         std::list<RotoFeatherVertex> featherMesh;
@@ -3287,21 +3455,21 @@ RotoContextPrivate::renderBezier(cairo_t* cr,
         std::list<RotoTriangles> internalTriangles;
         std::list<RotoTriangleStrips> internalStrips;
         computeTriangles(bezier, t, mipmapLevel, featherDist, &featherMesh, &internalFans, &internalTriangles, &internalStrips);
-        renderFeather_cairo(featherMesh, shapeColor, fallOff, mesh);
-        renderInternalShape_cairo(internalTriangles, internalFans, internalStrips, shapeColor, mesh);
-        Q_UNUSED(opacity);
+        renderInternalShapeTriangles(internalTriangles, internalFans, internalStrips, rasterizer);
+        renderFeatherTriangles(featherMesh, rasterizer);
 #else
-        renderFeather(bezier, t, mipmapLevel, shapeColor, opacity, featherDist, fallOff, mesh);
-
-
-        // strangely, the above-mentioned cairo bug doesn't affect this function
-        BezierCPs cps = bezier->getControlPoints_mt_safe();
-        renderInternalShape(t, mipmapLevel, shapeColor, opacity, transform, cr, mesh, cps);
-        
+        // The inside is the same polygon as the inner side of the feather, so that they join without seams
+        std::list<ParametricPoint> bezierPolygon;
+        bezier->evaluateAtTime_DeCasteljau(false, t, mipmapLevel,
+#ifdef ROTO_BEZIER_EVAL_ITERATIVE
+                                           50,
+#else
+                                           1,
+#endif
+                                           &bezierPolygon, NULL);
+        rasterizer->addContour( bezierPolygon.begin(), bezierPolygon.end() );
+        renderFeather(bezier, t, mipmapLevel, featherDist, bezierPolygon, rasterizer);
 #endif
-        
-        
-        RotoContextPrivate::applyAndDestroyMask(cr, mesh);
     }
 } // RotoContextPrivate::renderBezier
 
@@ -3309,16 +3477,13 @@ void
 RotoContextPrivate::renderFeather(const Bezier* bezier,
                                   double time,
                                   unsigned int mipmapLevel,
-                                  double shapeColor[3],
-                                  double /*opacity*/,
                                   double featherDist,
-                                  double fallOff,
-                                  cairo_pattern_t* mesh)
+                                  const std::list<ParametricPoint>& bezierPolygon,
+                                  RotoShapeRasterizer* rasterizer)
 {
     ///Note that we do not use the opacity when rendering the bezier, it is rendered with correct floating point opacity/color when converting
     ///to the Natron image.
 
-    double fallOffInverse = 1. / fallOff;
     /*
      * We descretize the feather control points to obtain a polygon so that the feather distance will be of the same thickness around all the shape.
      * If we were to extend only the end points, the resulting bezier interpolation would create a feather with different thickness around the shape,
@@ -3328,7 +3493,6 @@ RotoContextPrivate::renderFeather(const Bezier* bezier,
     ///This is used only if the feather distance is different of 0 and the feather points equal
     ///the control points in order to still be able to apply the feather distance.
     std::list<ParametricPoint> featherPolygon;
-    std::list<ParametricPoint> bezierPolygon;
     RectD featherPolyBBox;
 
     featherPolyBBox.setupInfinity();
@@ -3340,13 +3504,6 @@ RotoContextPrivate::renderFeather(const Bezier* bezier,
                                                     1,
 #endif
                                                     true, &featherPolygon, &featherPolyBBox);
-    bezier->evaluateAtTime_DeCasteljau(false, time, mipmapLevel,
-#ifdef ROTO_BEZIER_EVAL_ITERATIVE
-                                       50,
-#else
-                                       1,
-#endif
-                                       &bezierPolygon, NULL);
 
     bool clockWise = bezier->isFeatherPolygonClockwiseOriented(false, time);
 
@@ -3363,8 +3520,8 @@ RotoContextPrivate::renderFeather(const Bezier* bezier,
     }
     std::list<ParametricPoint>::iterator prev = featherPolygon.end();
     --prev; // can only be valid since we assert the list is not empty
-    std::list<ParametricPoint>::iterator bezIT = bezierPolygon.begin();
-    std::list<ParametricPoint>::iterator prevBez = bezierPolygon.end();
+    std::list<ParametricPoint>::const_iterator bezIT = bezierPolygon.begin();
+    std::list<ParametricPoint>::const_iterator prevBez = bezierPolygon.end();
     --prevBez; // can only be valid since we assert the list is not empty
 
     // prepare p1
@@ -3386,9 +3543,6 @@ RotoContextPrivate::renderFeather(const Bezier* bezier,
     }
 
 
-    double innerOpacity = 1.;
-    double outterOpacity = 0.;
-
     Point origin = p1;
     featherContour.push_back(p1);
 
@@ -3442,7 +3596,7 @@ RotoContextPrivate::renderFeather(const Bezier* bezier,
             continue;
         }*/
 
-        Point p0, p0p1, p1p0, p2, p2p3, p3p2, p3;
+        Point p0, p2, p3;
         p0.x = prevBez->x;
         p0.y = prevBez->y;
         p3.x = bezIT->x;
@@ -3473,53 +3627,14 @@ RotoContextPrivate::renderFeather(const Bezier* bezier,
         }
         featherContour.push_back(p2);
 
-        ///linear interpolation
-        p0p1.x = (p0.x * fallOff * 2. + fallOffInverse * p1.x) / (fallOff * 2. + fallOffInverse);
-        p0p1.y = (p0.y * fallOff * 2. + fallOffInverse * p1.y) / (fallOff * 2. + fallOffInverse);
-        p1p0.x = (p0.x * fallOff + 2. * fallOffInverse * p1.x) / (fallOff + 2. * fallOffInverse);
-        p1p0.y = (p0.y * fallOff + 2. * fallOffInverse * p1.y) / (fallOff + 2. * fallOffInverse);
-
-
-        p2p3.x = (p3.x * fallOff + 2. * fallOffInverse * p2.x) / (fallOff + 2. * fallOffInverse);
-        p2p3.y = (p3.y * fallOff + 2. * fallOffInverse * p2.y) / (fallOff + 2. * fallOffInverse);
-        p3p2.x = (p3.x * fallOff * 2. + fallOffInverse * p2.x) / (fallOff * 2. + fallOffInverse);
-        p3p2.y = (p3.y * fallOff * 2. + fallOffInverse * p2.y) / (fallOff * 2. + fallOffInverse);
-
-
-        ///move to the initial point
-        cairo_mesh_pattern_begin_patch(mesh);
-        cairo_mesh_pattern_move_to(mesh, p0.x, p0.y);
-        cairo_mesh_pattern_curve_to(mesh, p0p1.x, p0p1.y, p1p0.x, p1p0.y, p1.x, p1.y);
-        cairo_mesh_pattern_line_to(mesh, p2.x, p2.y);
-        cairo_mesh_pattern_curve_to(mesh, p2p3.x, p2p3.y, p3p2.x, p3p2.y, p3.x, p3.y);
-        cairo_mesh_pattern_line_to(mesh, p0.x, p0.y);
-        ///Set the 4 corners color
-        ///inner is full color
-
-        // IMPORTANT NOTE:
-        // The two sqrt below are due to a probable cairo bug.
-        // To check whether the bug is present is a given cairo version,
-        // make any shape with a very large feather and set
-        // opacity to 0.5. Then, zoom on the polygon border to check if the intensity is continuous
-        // and approximately equal to 0.5.
-        // If the bug if ixed in cairo, please use #if CAIRO_VERSION>xxx to keep compatibility with
-        // older Cairo versions.
-        cairo_mesh_pattern_set_corner_color_rgba( mesh, 0, shapeColor[0], shapeColor[1], shapeColor[2], innerOpacity);
-        ///outer is faded
-        cairo_mesh_pattern_set_corner_color_rgba(mesh, 1, shapeColor[0], shapeColor[1], shapeColor[2], outterOpacity);
-        cairo_mesh_pattern_set_corner_color_rgba(mesh, 2, shapeColor[0], shapeColor[1], shapeColor[2], outterOpacity);
-        ///inner is full color
-        cairo_mesh_pattern_set_corner_color_rgba(mesh, 3, shapeColor[0], shapeColor[1], shapeColor[2], innerOpacity);
-        assert(cairo_pattern_status(mesh) == CAIRO_STATUS_SUCCESS);
-
-        cairo_mesh_pattern_end_patch(mesh);
+        // The quad p0, p1, p2, p3 goes from the shape (p0, p3) to the feather edge (p1, p2)
+        rasterizer->addFeatherTriangle(p0, 0., p1, 1., p2, 1.);
+        rasterizer->addFeatherTriangle(p0, 0., p2, 1., p3, 0.);
 
         if (mustStop) {
             break;
         }
 
-        //std::swap(innerOpacity, outterOpacity);
-
         p1 = p2;
 
         // increment for next iteration
@@ -3540,164 +3655,25 @@ RotoContextPrivate::renderFeather(const Bezier* bezier,
 } // RotoContextPrivate::renderFeather
 
 void
-RotoContextPrivate::renderFeather_cairo(const std::list<RotoFeatherVertex>& vertices, double shapeColor[3], double fallOff, cairo_pattern_t * mesh)
+RotoContextPrivate::renderFeatherTriangles(const std::list<RotoFeatherVertex>& vertices,
+                                           RotoShapeRasterizer* rasterizer)
 {
     // Roto feather is rendered as triangles
     assert(vertices.size() >= 3 && vertices.size() % 3 == 0);
 
-    double fallOffInverse = 1. / fallOff;
-    
-    std::list<RotoFeatherVertex>::const_iterator next = vertices.begin();
-    ++next;
-    std::list<RotoFeatherVertex>::const_iterator nextNext = next;
-    ++nextNext;
-    int index = 0;
-    for (std::list<RotoFeatherVertex>::const_iterator it = vertices.begin(); it!=vertices.end(); index += 3) {
-
-
-        cairo_mesh_pattern_begin_patch(mesh);
-
-        // Only 3 of the 4 vertices are valid
-        const RotoFeatherVertex* innerVertices[2] = {0, 0};
-        const RotoFeatherVertex* outterVertices[2] = {0, 0};
-
-        {
-            int innerIndex = 0;
-            int outterIndex = 0;
-            if (it->isInner) {
-                innerVertices[innerIndex] = &(*it);
-                ++innerIndex;
-            } else {
-                outterVertices[outterIndex] = &(*it);
-                ++outterIndex;
-            }
-            if (next->isInner) {
-                assert(innerIndex <= 1);
-                if (innerIndex <= 1) {
-                    innerVertices[innerIndex] = &(*next);
-                    ++innerIndex;
-                }
-            } else {
-                assert(outterIndex <= 1);
-                if (outterIndex <= 1) {
-                    outterVertices[outterIndex] = &(*next);
-                    ++outterIndex;
-                }
-            }
-            if (nextNext->isInner) {
-                assert(innerIndex <= 1);
-                if (innerIndex <= 1) {
-                    innerVertices[innerIndex] = &(*nextNext);
-                    ++innerIndex;
-                }
-            } else {
-                assert(outterIndex <= 1);
-                if (outterIndex <= 1) {
-                    outterVertices[outterIndex] = &(*nextNext);
-                    ++outterIndex;
-                }
-            }
-            assert((outterIndex == 1 && innerIndex == 2) || (innerIndex == 1 && outterIndex == 2));
-        }
-        // make a degenerated coons patch out of the triangle so that we can assign a color to each vertex to emulate simple gouraud shaded triangles
-        Point p0, p0p1, p1, p1p0, p2, p2p3, p3p2, p3;
-        p0.x = innerVertices[0]->x;
-        p0.y = innerVertices[0]->y;
-        p1.x = outterVertices[0]->x;
-        p1.y = outterVertices[0]->y;
-        if (outterVertices[1]) {
-            p2.x = outterVertices[1]->x;
-            p2.y = outterVertices[1]->y;
-        } else {
-            // Repeat p1 if only 1 outer vertex
-            p2 = p1;
-        }
-        if (innerVertices[1]) {
-            p3.x = innerVertices[1]->x;
-            p3.y = innerVertices[1]->y;
-        } else {
-            // Repeat p0 if only 1 inner vertex
-            p3 = p0;
+    std::list<RotoFeatherVertex>::const_iterator it = vertices.begin();
+    while (it != vertices.end()) {
+        Point p[3];
+        double ramp[3];
+        for (int i = 0; i < 3 && it != vertices.end(); ++i, ++it) {
+            p[i].x = it->x;
+            p[i].y = it->y;
+            // the ramp goes from the shape to the feather edge
+            ramp[i] = it->isInner ? 0. : 1.;
         }
-
-
-        ///linear interpolation
-        p0p1.x = (p0.x * fallOff * 2. + fallOffInverse * p1.x) / (fallOff * 2. + fallOffInverse);
-        p0p1.y = (p0.y * fallOff * 2. + fallOffInverse * p1.y) / (fallOff * 2. + fallOffInverse);
-        p1p0.x = (p0.x * fallOff + 2. * fallOffInverse * p1.x) / (fallOff + 2. * fallOffInverse);
-        p1p0.y = (p0.y * fallOff + 2. * fallOffInverse * p1.y) / (fallOff + 2. * fallOffInverse);
-
-
-        p2p3.x = (p3.x * fallOff + 2. * fallOffInverse * p2.x) / (fallOff + 2. * fallOffInverse);
-        p2p3.y = (p3.y * fallOff + 2. * fallOffInverse * p2.y) / (fallOff + 2. * fallOffInverse);
-        p3p2.x = (p3.x * fallOff * 2. + fallOffInverse * p2.x) / (fallOff * 2. + fallOffInverse);
-        p3p2.y = (p3.y * fallOff * 2. + fallOffInverse * p2.y) / (fallOff * 2. + fallOffInverse);
-
-
-        // move to the initial point
-        cairo_mesh_pattern_move_to(mesh, p0.x, p0.y);
-        cairo_mesh_pattern_curve_to(mesh, p0p1.x, p0p1.y, p1p0.x, p1p0.y, p1.x, p1.y);
-        cairo_mesh_pattern_line_to(mesh, p2.x, p2.y);
-        cairo_mesh_pattern_curve_to(mesh, p2p3.x, p2p3.y, p3p2.x, p3p2.y, p3.x, p3.y);
-        cairo_mesh_pattern_line_to(mesh, p0.x, p0.y);
-
-        // Set the 4 corners color
-        // inner is full color
-
-        // IMPORTANT NOTE:
-        // The two sqrt below are due to a probable cairo bug.
-        // To check whether the bug is present is a given cairo version,
-        // make any shape with a very large feather and set
-        // opacity to 0.5. Then, zoom on the polygon border to check if the intensity is continuous
-        // and approximately equal to 0.5.
-        // If the bug if ixed in cairo, please use #if CAIRO_VERSION>xxx to keep compatibility with
-        // older Cairo versions.
-        cairo_mesh_pattern_set_corner_color_rgba( mesh, 0, shapeColor[0], shapeColor[1], shapeColor[2], 1.);
-        // outer is faded
-        cairo_mesh_pattern_set_corner_color_rgba(mesh, 1, shapeColor[0], shapeColor[1], shapeColor[2], 0.);
-        cairo_mesh_pattern_set_corner_color_rgba(mesh, 2, shapeColor[0], shapeColor[1], shapeColor[2], 0.);
-        // inner is full color
-        cairo_mesh_pattern_set_corner_color_rgba(mesh, 3, shapeColor[0], shapeColor[1], shapeColor[2], 1.);
-        assert(cairo_pattern_status(mesh) == CAIRO_STATUS_SUCCESS);
-
-        cairo_mesh_pattern_end_patch(mesh);
-
-
-        assert(nextNext != vertices.end());
-        ++nextNext;
-
-        // check if we reached the end
-        if (nextNext == vertices.end()) {
-            break;
-        }
-        // advance a second time
-        ++nextNext;
-        if (nextNext == vertices.end()) {
-            break;
-        }
-        // advance a 3rd time
-        ++nextNext;
-        if (nextNext == vertices.end()) {
-            break;
-        }
-
-        assert(next != vertices.end());
-        ++next;
-        assert(next != vertices.end());
-        ++next;
-        assert(next != vertices.end());
-        ++next;
-        assert(next != vertices.end());
-
-        assert(it != vertices.end());
-        ++it;
-        assert(it != vertices.end());
-        ++it;
-        assert(it != vertices.end());
-        ++it;
-        assert(it != vertices.end());
-    } // for (std::list<RotoFeatherVertex>::const_iterator it = vertices.begin(); it!=vertices.end(); ) 
-} // RotoContextPrivate::renderFeather_cairo
+        rasterizer->addFeatherTriangle(p[0], ramp[0], p[1], ramp[1], p[2], ramp[2]);
+    }
+} // RotoContextPrivate::renderFeatherTriangles
 
 
 struct tessPolygonData
@@ -4025,49 +4001,42 @@ RotoContextPrivate::computeTriangles(const Bezier * bezier, double time, unsigne
 
 } // RotoContextPrivate::computeFeatherTriangles
 
+// Adds the edges of a triangle of the inside of a shape: the triangles do not overlap, so that the non-zero
+// winding rule fills their union whatever their orientation
+static void
+addInternalShapeTriangle(const Point& p0,
+                         const Point& p1,
+                         const Point& p2,
+                         RotoShapeRasterizer* rasterizer)
+{
+    rasterizer->addEdge(p0, p1);
+    rasterizer->addEdge(p1, p2);
+    rasterizer->addEdge(p2, p0);
+}
+
 void
-RotoContextPrivate::renderInternalShape_cairo(const std::list<RotoTriangles>& triangles,
-                                              const std::list<RotoTriangleFans>& fans,
-                                              const std::list<RotoTriangleStrips>& strips,
-                                              double shapeColor[3], cairo_pattern_t * mesh)
+RotoContextPrivate::renderInternalShapeTriangles(const std::list<RotoTriangles>& triangles,
+                                                 const std::list<RotoTriangleFans>& fans,
+                                                 const std::list<RotoTriangleStrips>& strips,
+                                                 RotoShapeRasterizer* rasterizer)
 {
     for (std::list<RotoTriangles>::const_iterator it = triangles.begin(); it!=triangles.end(); ++it ) {
 
         assert(it->vertices.size() >= 3 && it->vertices.size() % 3 == 0);
 
-        int c = 0;
-        const Point* coonsPatchStart = 0;
-        for (std::list<Point>::const_iterator it2 = it->vertices.begin(); it2!=it->vertices.end(); ++it2) {
-            if (c == 0) {
-                cairo_mesh_pattern_begin_patch(mesh);
-                cairo_mesh_pattern_move_to(mesh, it2->x, it2->y);
-                coonsPatchStart = &(*it2);
-            } else {
-                cairo_mesh_pattern_line_to(mesh, it2->x, it2->y);
+        std::list<Point>::const_iterator it2 = it->vertices.begin();
+        while (it2 != it->vertices.end()) {
+            const Point& p0 = *it2;
+            if (++it2 == it->vertices.end()) {
+                break;
             }
-            if (c == 2) {
-                assert(coonsPatchStart);
-                // close coons patch by transforming the triangle into a degenerated coons patch
-                cairo_mesh_pattern_line_to(mesh, coonsPatchStart->x, coonsPatchStart->y);
-                // IMPORTANT NOTE:
-                // The two sqrt below are due to a probable cairo bug.
-                // To check whether the bug is present is a given cairo version,
-                // make any shape with a very large feather and set
-                // opacity to 0.5. Then, zoom on the polygon border to check if the intensity is continuous
-                // and approximately equal to 0.5.
-                // If the bug if ixed in cairo, please use #if CAIRO_VERSION>xxx to keep compatibility with
-                // older Cairo versions.
-                cairo_mesh_pattern_set_corner_color_rgba(mesh, 0, shapeColor[0], shapeColor[1], shapeColor[2], 1);
-                cairo_mesh_pattern_set_corner_color_rgba(mesh, 1, shapeColor[0], shapeColor[1], shapeColor[2], 1);
-                cairo_mesh_pattern_set_corner_color_rgba(mesh, 2, shapeColor[0], shapeColor[1], shapeColor[2], 1);
-                cairo_mesh_pattern_set_corner_color_rgba(mesh, 3, shapeColor[0], shapeColor[1], shapeColor[2], 1);
-                assert(cairo_pattern_status(mesh) == CAIRO_STATUS_SUCCESS);
-
-                cairo_mesh_pattern_end_patch(mesh);
-                c = 0;
-            } else {
-                ++c;
+            const Point& p1 = *it2;
+            if (++it2 == it->vertices.end()) {
+                break;
             }
+            const Point& p2 = *it2;
+            ++it2;
+            addInternalShapeTriangle(p0, p1, p2, rasterizer);
         }
     }
     for (std::list<RotoTriangleFans>::const_iterator it = fans.begin(); it!=fans.end(); ++it ) {
@@ -4079,26 +4048,7 @@ RotoContextPrivate::renderInternalShape_cairo(const std::list<RotoTriangles>& tr
         std::list<Point>::const_iterator next = cur;
         ++next;
         for (;next != it->vertices.end();) {
-            cairo_mesh_pattern_begin_patch(mesh);
-            cairo_mesh_pattern_move_to(mesh, fanStart->x, fanStart->y);
-            cairo_mesh_pattern_line_to(mesh, cur->x, cur->y);
-            cairo_mesh_pattern_line_to(mesh, next->x, next->y);
-            cairo_mesh_pattern_line_to(mesh, fanStart->x, fanStart->y);
-            // IMPORTANT NOTE:
-            // The two sqrt below are due to a probable cairo bug.
-            // To check whether the bug is present is a given cairo version,
-            // make any shape with a very large feather and set
-            // opacity to 0.5. Then, zoom on the polygon border to check if the intensity is continuous
-            // and approximately equal to 0.5.
-            // If the bug if ixed in cairo, please use #if CAIRO_VERSION>xxx to keep compatibility with
-            // older Cairo versions.
-            cairo_mesh_pattern_set_corner_color_rgba(mesh, 0, shapeColor[0], shapeColor[1], shapeColor[2], 1);
-            cairo_mesh_pattern_set_corner_color_rgba(mesh, 1, shapeColor[0], shapeColor[1], shapeColor[2], 1);
-            cairo_mesh_pattern_set_corner_color_rgba(mesh, 2, shapeColor[0], shapeColor[1], shapeColor[2], 1);
-            cairo_mesh_pattern_set_corner_color_rgba(mesh, 3, shapeColor[0], shapeColor[1], shapeColor[2], 1);
-            assert(cairo_pattern_status(mesh) == CAIRO_STATUS_SUCCESS);
-
-            cairo_mesh_pattern_end_patch(mesh);
+            addInternalShapeTriangle(*fanStart, *cur, *next, rasterizer);
 
             ++next;
             ++cur;
@@ -4114,246 +4064,13 @@ RotoContextPrivate::renderInternalShape_cairo(const std::list<RotoTriangles>& tr
         const Point* prev = &(*(cur));
         ++cur;
         for (; cur != it->vertices.end(); ++cur) {
-            cairo_mesh_pattern_begin_patch(mesh);
-            cairo_mesh_pattern_move_to(mesh, prevPrev->x, prevPrev->y);
-            cairo_mesh_pattern_line_to(mesh, prev->x, prev->y);
-            cairo_mesh_pattern_line_to(mesh, cur->x, cur->y);
-            cairo_mesh_pattern_line_to(mesh, prevPrev->x, prevPrev->y);
-
-            // IMPORTANT NOTE:
-            // The two sqrt below are due to a probable cairo bug.
-            // To check whether the bug is present is a given cairo version,
-            // make any shape with a very large feather and set
-            // opacity to 0.5. Then, zoom on the polygon border to check if the intensity is continuous
-            // and approximately equal to 0.5.
-            // If the bug if ixed in cairo, please use #if CAIRO_VERSION>xxx to keep compatibility with
-            // older Cairo versions.
-            cairo_mesh_pattern_set_corner_color_rgba(mesh, 0, shapeColor[0], shapeColor[1], shapeColor[2], 1);
-            cairo_mesh_pattern_set_corner_color_rgba(mesh, 1, shapeColor[0], shapeColor[1], shapeColor[2], 1);
-            cairo_mesh_pattern_set_corner_color_rgba(mesh, 2, shapeColor[0], shapeColor[1], shapeColor[2], 1);
-            cairo_mesh_pattern_set_corner_color_rgba(mesh, 3, shapeColor[0], shapeColor[1], shapeColor[2], 1);
-            assert(cairo_pattern_status(mesh) == CAIRO_STATUS_SUCCESS);
-
-            cairo_mesh_pattern_end_patch(mesh);
-            
+            addInternalShapeTriangle(*prevPrev, *prev, *cur, rasterizer);
+
             prevPrev = prev;
             prev = &(*(cur));
         }
     }
-}
-
-
-void
-RotoContextPrivate::renderInternalShape(double time,
-                                        unsigned int mipmapLevel,
-                                        double /*shapeColor*/[3],
-                                        double /*opacity*/,
-                                        const Transform::Matrix3x3& transform,
-                                        cairo_t* cr,
-#ifdef ROTO_USE_MESH_PATTERN_ONLY
-                                        cairo_pattern_t* mesh,
-#else
-                                        cairo_pattern_t* /*mesh*/,
-#endif
-                                        const BezierCPs & cps)
-{
-    assert( !cps.empty() );
-#ifdef ROTO_USE_MESH_PATTERN_ONLY
-    std::list<BezierCPs> coonPatches;
-    bezulate(time, cps, &coonPatches);
-
-    for (std::list<BezierCPs>::iterator it = coonPatches.begin(); it != coonPatches.end(); ++it) {
-        std::list<BezierCPs> fixedPatch;
-        CoonsRegularization::regularize(*it, time, &fixedPatch);
-        for (std::list<BezierCPs>::iterator it2 = fixedPatch.begin(); it2 != fixedPatch.end(); ++it2) {
-            std::size_t size = it2->size();
-            assert(size <= 4 && size >= 2);
-
-            BezierCPs::iterator patchIT = it2->begin();
-            BezierCPPtr p0ptr, p1ptr, p2ptr, p3ptr;
-            p0ptr = *patchIT;
-            ++patchIT;
-            if (size == 2) {
-                p1ptr = p0ptr;
-                p2ptr = *patchIT;
-                p3ptr = p2ptr;
-            } else if (size == 3) {
-                p1ptr = *patchIT;
-                p2ptr = *patchIT;
-                ++patchIT;
-                p3ptr = *patchIT;
-            } else if (size == 4) {
-                p1ptr = *patchIT;
-                ++patchIT;
-                p2ptr = *patchIT;
-                ++patchIT;
-                p3ptr = *patchIT;
-            }
-            assert(p0ptr && p1ptr && p2ptr && p3ptr);
-
-            Point p0, p0p1, p1p0, p1, p1p2, p2p1, p2p3, p3p2, p2, p3, p3p0, p0p3;
-
-            p0ptr->getLeftBezierPointAtTime(time, &p0p3.x, &p0p3.y);
-            p0ptr->getPositionAtTime(time, &p0.x, &p0.y);
-            p0ptr->getRightBezierPointAtTime(time, &p0p1.x, &p0p1.y);
-
-            p1ptr->getLeftBezierPointAtTime(time, &p1p0.x, &p1p0.y);
-            p1ptr->getPositionAtTime(time, &p1.x, &p1.y);
-            p1ptr->getRightBezierPointAtTime(time, &p1p2.x, &p1p2.y);
-
-            p2ptr->getLeftBezierPointAtTime(time, &p2p1.x, &p2p1.y);
-            p2ptr->getPositionAtTime(time, &p2.x, &p2.y);
-            p2ptr->getRightBezierPointAtTime(time, &p2p3.x, &p2p3.y);
-
-            p3ptr->getLeftBezierPointAtTime(time, &p3p2.x, &p3p2.y);
-            p3ptr->getPositionAtTime(time, &p3.x, &p3.y);
-            p3ptr->getRightBezierPointAtTime(time, &p3p0.x, &p3p0.y);
-
-
-            adjustToPointToScale(mipmapLevel, p0.x, p0.y);
-            adjustToPointToScale(mipmapLevel, p0p1.x, p0p1.y);
-            adjustToPointToScale(mipmapLevel, p1p0.x, p1p0.y);
-            adjustToPointToScale(mipmapLevel, p1.x, p1.y);
-            adjustToPointToScale(mipmapLevel, p1p2.x, p1p2.y);
-            adjustToPointToScale(mipmapLevel, p2p1.x, p2p1.y);
-            adjustToPointToScale(mipmapLevel, p2.x, p2.y);
-            adjustToPointToScale(mipmapLevel, p2p3.x, p2p3.y);
-            adjustToPointToScale(mipmapLevel, p3p2.x, p3p2.y);
-            adjustToPointToScale(mipmapLevel, p3.x, p3.y);
-            adjustToPointToScale(mipmapLevel, p3p0.x, p3p0.y);
-            adjustToPointToScale(mipmapLevel, p0p3.x, p0p3.y);
-
-            // Add a Coons patch such as:
-
-            //         C1  Side 1   C2
-            //        +---------------+
-            //        |               |
-            //        |  P1       P2  |
-            //        |               |
-            // Side 0 |               | Side 2
-            //        |               |
-            //        |               |
-            //        |  P0       P3  |
-            //        |               |
-            //        +---------------+
-            //        C0     Side 3   C3
-
-            // In the above drawing, C0 is p0, P0 is p0p1, P1 is p1p0, C1 is p1 and so on...
-
-            ///move to C0
-            cairo_mesh_pattern_begin_patch(mesh);
-            cairo_mesh_pattern_move_to(mesh, p0.x, p0.y);
-            if (size == 4) {
-                cairo_mesh_pattern_curve_to(mesh, p0p1.x, p0p1.y, p1p0.x, p1p0.y, p1.x, p1.y);
-                cairo_mesh_pattern_curve_to(mesh, p1p2.x, p1p2.y, p2p1.x, p2p1.y, p2.x, p2.y);
-                cairo_mesh_pattern_curve_to(mesh, p2p3.x, p2p3.y, p3p2.x, p3p2.y, p3.x, p3.y);
-                cairo_mesh_pattern_curve_to(mesh, p3p0.x, p3p0.y, p0p3.x, p0p3.y, p0.x, p0.y);
-            } else if (size == 3) {
-                cairo_mesh_pattern_curve_to(mesh, p0p1.x, p0p1.y, p1p0.x, p1p0.y, p1.x, p1.y);
-                cairo_mesh_pattern_line_to(mesh, p2.x, p2.y);
-                cairo_mesh_pattern_curve_to(mesh, p2p3.x, p2p3.y, p3p2.x, p3p2.y, p3.x, p3.y);
-                cairo_mesh_pattern_curve_to(mesh, p3p0.x, p3p0.y, p0p3.x, p0p3.y, p0.x, p0.y);
-            } else {
-                assert(size == 2);
-                cairo_mesh_pattern_line_to(mesh, p1.x, p1.y);
-                cairo_mesh_pattern_curve_to(mesh, p1p2.x, p1p2.y, p2p1.x, p2p1.y, p2.x, p2.y);
-                cairo_mesh_pattern_line_to(mesh, p3.x, p3.y);
-                cairo_mesh_pattern_curve_to(mesh, p3p0.x, p3p0.y, p0p3.x, p0p3.y, p0.x, p0.y);
-            }
-            ///Set the 4 corners color
-
-            // IMPORTANT NOTE:
-            // The two sqrt below are due to a probable cairo bug.
-            // To check whether the bug is present is a given cairo version,
-            // make any shape with a very large feather and set
-            // opacity to 0.5. Then, zoom on the polygon border to check if the intensity is continuous
-            // and approximately equal to 0.5.
-            // If the bug if ixed in cairo, please use #if CAIRO_VERSION>xxx to keep compatibility with
-            // older Cairo versions.
-            cairo_mesh_pattern_set_corner_color_rgba( mesh, 0, shapeColor[0], shapeColor[1], shapeColor[2],
-                                                      std::sqrt(opacity) );
-            cairo_mesh_pattern_set_corner_color_rgba(mesh, 1, shapeColor[0], shapeColor[1], shapeColor[2],
-                                                     opacity);
-            cairo_mesh_pattern_set_corner_color_rgba(mesh, 2, shapeColor[0], shapeColor[1], shapeColor[2],
-                                                     opacity);
-            cairo_mesh_pattern_set_corner_color_rgba( mesh, 3, shapeColor[0], shapeColor[1], shapeColor[2],
-                                                      std::sqrt(opacity) );
-            assert(cairo_pattern_status(mesh) == CAIRO_STATUS_SUCCESS);
-
-            cairo_mesh_pattern_end_patch(mesh);
-        }
-    }
-#else // ifdef ROTO_USE_MESH_PATTERN_ONLY
-
-    cairo_set_source_rgba(cr, 1, 1, 1, 1);
-
-    BezierCPs::const_iterator point = cps.begin();
-    assert( point != cps.end() );
-    if ( point == cps.end() ) {
-        return;
-    }
-    BezierCPs::const_iterator nextPoint = point;
-    if ( nextPoint != cps.end() ) {
-        ++nextPoint;
-    }
-
-
-    Transform::Point3D initCp;
-    (*point)->getPositionAtTime(false, time, ViewIdx(0), &initCp.x, &initCp.y);
-    initCp.z = 1.;
-    initCp = Transform::matApply(transform, initCp);
-
-    adjustToPointToScale(mipmapLevel, initCp.x, initCp.y);
-
-    cairo_move_to(cr, initCp.x, initCp.y);
-
-    while ( point != cps.end() ) {
-        if ( nextPoint == cps.end() ) {
-            nextPoint = cps.begin();
-        }
-
-        Transform::Point3D right, nextLeft, next;
-        (*point)->getRightBezierPointAtTime(false, time, ViewIdx(0), &right.x, &right.y);
-        right.z = 1;
-        (*nextPoint)->getLeftBezierPointAtTime(false, time, ViewIdx(0), &nextLeft.x, &nextLeft.y);
-        nextLeft.z = 1;
-        (*nextPoint)->getPositionAtTime(false, time, ViewIdx(0), &next.x, &next.y);
-        next.z = 1;
-
-        right = Transform::matApply(transform, right);
-        nextLeft = Transform::matApply(transform, nextLeft);
-        next = Transform::matApply(transform, next);
-
-        adjustToPointToScale(mipmapLevel, right.x, right.y);
-        adjustToPointToScale(mipmapLevel, next.x, next.y);
-        adjustToPointToScale(mipmapLevel, nextLeft.x, nextLeft.y);
-        cairo_curve_to(cr, right.x, right.y, nextLeft.x, nextLeft.y, next.x, next.y);
-
-        // increment for next iteration
-        ++point;
-        if ( nextPoint != cps.end() ) {
-            ++nextPoint;
-        }
-    } // while()
-//    if (cairo_get_antialias(cr) != CAIRO_ANTIALIAS_NONE ) {
-//        cairo_fill_preserve(cr);
-//        // These line properties make for a nicer looking polygon mesh
-//        cairo_set_line_join(cr, CAIRO_LINE_JOIN_BEVEL);
-//        cairo_set_line_cap(cr, CAIRO_LINE_CAP_BUTT);
-//        // Comment out the following call to cairo_set_line width
-//        // since the hard-coded width value of 1.0 is not appropriate
-//        // for fills of small areas. Instead, use the line width that
-//        // has already been set by the user via the above call of
-//        // poly_line which in turn calls set_current_context which in
-//        // turn calls cairo_set_line_width for the user-specified
-//        // width.
-//        cairo_set_line_width(cr, 1.0);
-//        cairo_stroke(cr);
-//    } else {
-    cairo_fill(cr);
-//    }
-#endif // ifdef ROTO_USE_MESH_PATTERN_ONLY
-} // RotoContextPrivate::renderInternalShape
+} // RotoContextPrivate::renderInternalShapeTriangles
 
 struct qpointf_compare_less
 {
@@ -4584,19 +4301,6 @@ RotoContextPrivate::bezulate(double time,
     }
 } // RotoContextPrivate::bezulate
 
-void
-RotoContextPrivate::applyAndDestroyMask(cairo_t* cr,
-                                        cairo_pattern_t* mesh)
-{
-    assert(cairo_pattern_status(mesh) == CAIRO_STATUS_SUCCESS);
-    cairo_set_source(cr, mesh);
-
-    ///paint with the feather with the pattern as a mask
-    cairo_mask(cr, mesh);
-
-    cairo_pattern_destroy(mesh);
-}
-
 void
 RotoContext::changeItemScriptName(const std::string& oldFullyQualifiedName,
                                   const std::string& newFullyQUalifiedName)
@@ -376,6 +376,20 @@ public:
 
     NodePtr getRotoPaintBottomMergeNode() const;
 
+    /**
+     * @brief Returns true if the RotoPaint node can composite the item itself, without rendering its internal nodes:
+     * solid, eraser, dodge and burn items with a separable compositing operator.
+     **/
+    static bool isRotoPaintItemFlattenable(const RotoDrawableItemPtr& item);
+
+    /**
+     * @brief Appends to flattenedItems, by render order, the topmost items that the RotoPaint node composites itself,
+     * and returns the merge node of the item below them, which must be rendered by the internal nodes tree.
+     * Returns NULL if all items are flattened.
+     * Nothing is flattened while a paint stroke is being drawn: the internal nodes then render it incrementally.
+     **/
+    NodePtr getRotoPaintFlattenedItems(std::list<RotoDrawableItemPtr>* flattenedItems) const;
+
     void setWhileCreatingPaintStrokeOnMergeNodes(bool b);
 
     /**
@@ -53,6 +53,7 @@ CLANG_DIAG_ON(uninitialized)
 
 #include "Engine/AppManager.h"
 #include "Engine/BezierCP.h"
+#include "Engine/BezierPolygonCache.h"
 #include "Engine/Curve.h"
 #include "Engine/EffectInstance.h"
 #include "Engine/Image.h"
@@ -371,6 +372,8 @@ enum RotoPaintItemLifeTimeTypeEnum
 
 NATRON_NAMESPACE_ENTER
 
+struct ParametricPoint;
+
 struct RotoFeatherVertex
 {
     double x,y;
@@ -408,6 +411,7 @@ struct BezierPrivate
     bool isOpenBezier;
     mutable QMutex guiCopyMutex;
     bool mustCopyGui;
+    mutable BezierPolygonCache polygonCache; //< protected by the itemMutex of the bezier
 
     BezierPrivate(bool isOpenBezier)
         : points()
@@ -421,6 +425,7 @@ struct BezierPrivate
         , isOpenBezier(isOpenBezier)
         , guiCopyMutex()
         , mustCopyGui(false)
+        , polygonCache()
     {
     }
 
@@ -2223,17 +2228,15 @@ public:
                                double opacity,
                                double time,
                                unsigned int mipmapLevel);
-    static void renderBezier(cairo_t* cr, const Bezier* bezier, double opacity, double time, double startTime, double endTime, double mbFrameStep, unsigned int mipmapLevel);
-    static void renderFeather(const Bezier * bezier, double time, unsigned int mipmapLevel, double shapeColor[3], double opacity, double featherDist, double fallOff, cairo_pattern_t * mesh);
-    static void renderFeather_cairo(const std::list<RotoFeatherVertex>& vertices, double shapeColor[3],  double fallOff, cairo_pattern_t * mesh);
-    static void renderInternalShape_cairo(const std::list<RotoTriangles>& triangles,
-                                          const std::list<RotoTriangleFans>& fans,
-                                          const std::list<RotoTriangleStrips>& strips,
-                                          double shapeColor[3],  cairo_pattern_t * mesh);
+    static void renderBezier(const Bezier* bezier, double time, double startTime, double endTime, double mbFrameStep, unsigned int mipmapLevel, RotoShapeRasterizer* rasterizer);
+    static void renderFeather(const Bezier * bezier, double time, unsigned int mipmapLevel, double featherDist, const std::list<ParametricPoint>& bezierPolygon, RotoShapeRasterizer* rasterizer);
+    static void renderFeatherTriangles(const std::list<RotoFeatherVertex>& vertices, RotoShapeRasterizer* rasterizer);
+    static void renderInternalShapeTriangles(const std::list<RotoTriangles>& triangles,
+                                             const std::list<RotoTriangleFans>& fans,
+                                             const std::list<RotoTriangleStrips>& strips,
+                                             RotoShapeRasterizer* rasterizer);
     static void computeTriangles(const Bezier * bezier, double time, unsigned int mipmapLevel,  double featherDist, std::list<RotoFeatherVertex>* featherMesh, std::list<RotoTriangleFans>* internalFans, std::list<RotoTriangles>* internalTriangles,std::list<RotoTriangleStrips>* internalStrips);
-    static void renderInternalShape(double time, unsigned int mipmapLevel, double shapeColor[3], double opacity, const Transform::Matrix3x3 & transform, cairo_t * cr, cairo_pattern_t * mesh, const BezierCPs &cps);
     static void bezulate(double time, const BezierCPs& cps, std::list<BezierCPs>* patches);
-    static void applyAndDestroyMask(cairo_t* cr, cairo_pattern_t* mesh);
 };
 
 NATRON_NAMESPACE_EXIT
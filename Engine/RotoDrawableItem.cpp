@@ -1421,6 +1421,61 @@ RotoDrawableItem::getTransformAtTime(double time,
     *matrix = Transform::matMul(*matrix, extraMat);
 }
 
+/**
+ * @brief Appends the values of all dimensions of the knob to the hash. Returns false if the knob, or the knob it is
+ * slaved to, is animated or has an expression.
+ **/
+template <typename KNOB>
+static bool
+appendStaticKnobValuesToHash(const KNOB& knob,
+                             Hash64* hash)
+{
+    if (!knob) {
+        return true;
+    }
+    if ( knob->hasAnimation() ) {
+        return false;
+    }
+    for (int i = 0; i < knob->getDimension(); ++i) {
+        KnobIPtr master = knob->getMaster(i).second;
+        if ( master && master->hasAnimation() ) {
+            return false;
+        }
+        hash->append( knob->getValue(i) );
+    }
+
+    return true;
+}
+
+bool
+RotoDrawableItem::appendStaticMaskKnobsToHash(Hash64* hash) const
+{
+    // Only the knobs used to draw the mask: the lifetime, the compositing operator and the time offset are
+    // applied by the internal nodes of the item and do not change the mask.
+    return ( appendStaticKnobValuesToHash(_imp->opacity, hash) &&
+#ifdef NATRON_ROTO_INVERTIBLE
+             appendStaticKnobValuesToHash(_imp->inverted, hash) &&
+#endif
+             appendStaticKnobValuesToHash(_imp->color, hash) &&
+             appendStaticKnobValuesToHash(_imp->translate, hash) &&
+             appendStaticKnobValuesToHash(_imp->rotate, hash) &&
+             appendStaticKnobValuesToHash(_imp->scale, hash) &&
+             appendStaticKnobValuesToHash(_imp->scaleUniform, hash) &&
+             appendStaticKnobValuesToHash(_imp->skewX, hash) &&
+             appendStaticKnobValuesToHash(_imp->skewY, hash) &&
+             appendStaticKnobValuesToHash(_imp->skewOrder, hash) &&
+             appendStaticKnobValuesToHash(_imp->center, hash) &&
+             appendStaticKnobValuesToHash(_imp->extraMatrix, hash) &&
+             appendStaticKnobValuesToHash(_imp->brushSize, hash) &&
+             appendStaticKnobValuesToHash(_imp->brushSpacing, hash) &&
+             appendStaticKnobValuesToHash(_imp->brushHardness, hash) &&
+             appendStaticKnobValuesToHash(_imp->pressureOpacity, hash) &&
+             appendStaticKnobValuesToHash(_imp->pressureSize, hash) &&
+             appendStaticKnobValuesToHash(_imp->pressureHardness, hash) &&
+             appendStaticKnobValuesToHash(_imp->buildUp, hash) &&
+             appendStaticKnobValuesToHash(_imp->visiblePortion, hash) );
+}
+
 /**
  * @brief Set the transform at the given time
  **/
@@ -239,6 +239,12 @@ protected:
 
     void rotoKnobChanged(const KnobIPtr& knob, ValueChangedReasonEnum reason);
 
+    /**
+     * @brief Appends to the hash the values of the knobs the mask of the item depends on.
+     * Returns false if any of them is animated, in which case the mask may change over time.
+     **/
+    bool appendStaticMaskKnobsToHash(Hash64* hash) const;
+
     virtual void onTransformSet(double /*time*/) {}
 
     void addKnob(const KnobIPtr& knob);
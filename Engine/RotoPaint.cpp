@@ -27,6 +27,7 @@
 
 #include <sstream> // stringstream
 #include <cassert>
+#include <memory> // unique_ptr, make_shared
 #include <stdexcept>
 
 #include "Engine/AppInstance.h"
@@ -42,6 +43,7 @@
 #include "Engine/RotoStrokeItem.h"
 #include "Engine/KnobTypes.h"
 #include "Engine/RotoDrawableItem.h"
+#include "Engine/RotoPaintCompositor.h"
 #include "Engine/RotoPoint.h"
 #include "Engine/RotoUndoCommand.h"
 #include "Engine/RotoPaintInteract.h"
@@ -1430,7 +1432,8 @@ RotoPaint::getRegionsOfInterest(double time,
                                 RoIMap* ret)
 {
     RotoContextPtr roto = getNode()->getRotoContext();
-    NodePtr bottomMerge = roto->getRotoPaintBottomMergeNode();
+    std::list<RotoDrawableItemPtr> flattenedItems;
+    NodePtr bottomMerge = roto->getRotoPaintFlattenedItems(&flattenedItems);
 
     if (bottomMerge) {
         ret->insert( std::make_pair(bottomMerge->getEffectInstance(), renderWindow) );
@@ -1475,6 +1478,113 @@ RotoPaint::isIdentity(double time,
     return false;
 }
 
+ImagePtr
+RotoPaint::renderFlattenedItems(const RenderActionArgs& args,
+                                const std::list<RotoDrawableItemPtr>& items,
+                                const ImagePtr& treeImg,
+                                const ImagePtr& bgImg)
+{
+    const ImagePlaneDesc& rgba = ImagePlaneDesc::getRGBAComponents();
+    const unsigned int mipmapLevel = args.mappedScale.toMipmapLevel();
+    const ImageBitDepthEnum depth = getBitDepth(-1);
+
+    assert(depth == eImageBitDepthFloat);
+
+    // The compositor reads RGBA float images
+    ImagePtr background;
+    if (bgImg) {
+        background = convertPlanesFormatsIfNeeded(getApp(), bgImg, args.roi, rgba, depth, false, eImagePremultiplicationPremultiplied, 3);
+    }
+    ImagePtr upstream = background;
+    if (treeImg) {
+        upstream = convertPlanesFormatsIfNeeded(getApp(), treeImg, args.roi, rgba, depth, false, eImagePremultiplicationPremultiplied, 3);
+    }
+
+    RotoPaintCompositor compositor;
+    // The images must remain locked for reading while compositing
+    std::list<ImagePtr> images;
+    std::list<Image::ReadAccess> accesses;
+    if (background) {
+        images.push_back(background);
+        accesses.push_back( background->getReadRights() );
+        const RectI& bounds = background->getBounds();
+        compositor.setBackground( (const float*)accesses.back().pixelAt(bounds.x1, bounds.y1), bounds );
+    }
+    const float* upstreamPixels = 0;
+    RectI upstreamBounds;
+    if (upstream) {
+        images.push_back(upstream);
+        accesses.push_back( upstream->getReadRights() );
+        upstreamBounds = upstream->getBounds();
+        if ( !upstreamBounds.isNull() ) {
+            upstreamPixels = (const float*)accesses.back().pixelAt(upstreamBounds.x1, upstreamBounds.y1);
+        }
+    }
+
+    for (std::list<RotoDrawableItemPtr>::const_iterator it = items.begin(); it != items.end(); ++it) {
+        if ( aborted() ) {
+            return ImagePtr();
+        }
+        if ( !(*it)->isActivated(args.time) ) {
+            // The internal nodes of an inactive item are identities
+            continue;
+        }
+
+        RotoStrokeItem* isStroke = dynamic_cast<RotoStrokeItem*>( it->get() );
+        RotoStrokeType type = isStroke ? isStroke->getBrushType() : eRotoStrokeTypeSolid;
+        MergingFunctionEnum op = (MergingFunctionEnum)(*it)->getCompositingOperator();
+        // Solid items are merged as is, the others are merged through their mask, just like their internal Merge node
+        const bool isShape = type == eRotoStrokeTypeSolid;
+        ImagePtr image = (*it)->renderMaskFromStroke(isShape ? rgba : ImagePlaneDesc::getAlphaComponents(),
+                                                     args.time, args.view, depth, mipmapLevel, RectD() );
+        if (!image) {
+            return ImagePtr();
+        }
+        const RectI& bounds = image->getBounds();
+        images.push_back(image);
+        accesses.push_back( image->getReadRights() );
+        const float* pixels = bounds.isNull() ? 0 : (const float*)accesses.back().pixelAt(bounds.x1, bounds.y1);
+
+        switch (type) {
+        case eRotoStrokeTypeSolid:
+            compositor.addShapeLayer(op, pixels, bounds);
+            break;
+        case eRotoStrokeTypeEraser:
+            if (pixels) {
+                compositor.addMaskedLayer(op, RotoPaintCompositor::eSourceBackground, pixels, bounds);
+            }
+            break;
+        case eRotoStrokeTypeDodge:
+        case eRotoStrokeTypeBurn:
+            if (pixels) {
+                compositor.addMaskedLayer(op, RotoPaintCompositor::eSourceUpstream, pixels, bounds);
+            }
+            break;
+        default:
+            assert(false);
+            break;
+        }
+    }
+
+    const ImagePtr& outputImg = args.outputPlanes.front().second;
+    ImagePtr dstImg = std::make_shared<Image>(rgba,
+                                              outputImg->getRoD(),
+                                              args.roi,
+                                              mipmapLevel,
+                                              outputImg->getPixelAspectRatio(),
+                                              depth,
+                                              eImagePremultiplicationPremultiplied,
+                                              outputImg->getFieldingOrder(),
+                                              false,
+                                              eStorageModeRAM);
+    {
+        Image::WriteAccess acc = dstImg->getWriteRights();
+        compositor.composite( upstreamPixels, upstreamBounds, args.roi, (float*)acc.pixelAt(args.roi.x1, args.roi.y1) );
+    }
+
+    return dstImg;
+} // RotoPaint::renderFlattenedItems
+
 StatusEnum
 RotoPaint::render(const RenderActionArgs& args)
 {
@@ -1524,48 +1634,81 @@ RotoPaint::render(const RenderActionArgs& args)
                 throw std::logic_error("RotoPaint::render(): getThreadLocalRotoPaintTreeNodes() failed");
             }
         }
-        NodePtr bottomMerge = roto->getRotoPaintBottomMergeNode();
-        RenderingFlagSetter flagIsRendering( bottomMerge );
+        // The topmost items are composited by this node in a single pass, over the output of the internal nodes tree
+        std::list<RotoDrawableItemPtr> flattenedItems;
+        NodePtr bottomMerge = roto->getRotoPaintFlattenedItems(&flattenedItems);
+        std::unique_ptr<RenderingFlagSetter> flagIsRendering;
+        if (bottomMerge) {
+            flagIsRendering.reset( new RenderingFlagSetter(bottomMerge) );
+        }
         std::bitset<4> copyChannels;
         for (int i = 0; i < 4; ++i) {
             copyChannels[i] = _imp->enabledKnobs[i].lock()->getValue();
         }
 
         unsigned int mipmapLevel = args.mappedScale.toMipmapLevel();
-        RenderRoIArgs rotoPaintArgs(args.time,
-                                    args.mappedScale,
-                                    mipmapLevel,
-                                    args.view,
-                                    args.byPassCache,
-                                    args.roi,
-                                    RectD(),
-                                    neededComps,
-                                    bgDepth,
-                                    false,
-                                    this,
-                                    eStorageModeRAM /*returnOpenGLtex*/,
-                                    args.time);
         std::map<ImagePlaneDesc, ImagePtr> rotoPaintImages;
-        RenderRoIRetCode code = bottomMerge->getEffectInstance()->renderRoI(rotoPaintArgs, &rotoPaintImages);
-        if (code == eRenderRoIRetCodeFailed) {
-            return eStatusFailed;
-        } else if (code == eRenderRoIRetCodeAborted) {
-            return eStatusOK;
-        } else if ( rotoPaintImages.empty() ) {
-            for (std::list<std::pair<ImagePlaneDesc, ImagePtr> >::const_iterator plane = args.outputPlanes.begin();
-                 plane != args.outputPlanes.end(); ++plane) {
-                plane->second->fillZero(args.roi);
+        if (bottomMerge) {
+            std::list<ImagePlaneDesc> treeComps;
+            if ( flattenedItems.empty() ) {
+                treeComps = neededComps;
+            } else {
+                treeComps.push_back( ImagePlaneDesc::getRGBAComponents() );
             }
+            RenderRoIArgs rotoPaintArgs(args.time,
+                                        args.mappedScale,
+                                        mipmapLevel,
+                                        args.view,
+                                        args.byPassCache,
+                                        args.roi,
+                                        RectD(),
+                                        treeComps,
+                                        bgDepth,
+                                        false,
+                                        this,
+                                        eStorageModeRAM /*returnOpenGLtex*/,
+                                        args.time);
+            RenderRoIRetCode code = bottomMerge->getEffectInstance()->renderRoI(rotoPaintArgs, &rotoPaintImages);
+            if (code == eRenderRoIRetCodeFailed) {
+                return eStatusFailed;
+            } else if (code == eRenderRoIRetCodeAborted) {
+                return eStatusOK;
+            } else if ( rotoPaintImages.empty() && flattenedItems.empty() ) {
+                for (std::list<std::pair<ImagePlaneDesc, ImagePtr> >::const_iterator plane = args.outputPlanes.begin();
+                     plane != args.outputPlanes.end(); ++plane) {
+                    plane->second->fillZero(args.roi);
+                }
 
-            return eStatusOK;
+                return eStatusOK;
+            }
         }
-        assert( rotoPaintImages.size() == args.outputPlanes.size() );
 
         RectI bgImgRoI;
         ImagePtr bgImg;
-        ImagePremultiplicationEnum outputPremult = getPremult();
         bool triedGetImage = false;
 
+        if ( !flattenedItems.empty() ) {
+            bgImg = getImage(0, args.time, args.mappedScale, args.view, 0, 0, false /*mapToClipPrefs*/, false /*dontUpscale*/, eStorageModeRAM /*returnOpenGLtexture*/, 0 /*textureDepth*/, &bgImgRoI);
+            triedGetImage = true;
+
+            ImagePtr treeImg;
+            if ( bottomMerge && !rotoPaintImages.empty() ) {
+                treeImg = rotoPaintImages.begin()->second;
+            }
+            ImagePtr flattenedImg = renderFlattenedItems(args, flattenedItems, treeImg, bgImg);
+            if ( !flattenedImg ) {
+                return aborted() ? eStatusOK : eStatusFailed;
+            }
+            rotoPaintImages.clear();
+            for (std::list<std::pair<ImagePlaneDesc, ImagePtr> >::const_iterator plane = args.outputPlanes.begin();
+                 plane != args.outputPlanes.end(); ++plane) {
+                rotoPaintImages[plane->first] = flattenedImg;
+            }
+        }
+        assert( rotoPaintImages.size() == args.outputPlanes.size() );
+
+        ImagePremultiplicationEnum outputPremult = getPremult();
+
         for (std::list<std::pair<ImagePlaneDesc, ImagePtr> >::const_iterator plane = args.outputPlanes.begin();
              plane != args.outputPlanes.end(); ++plane) {
             std::map<ImagePlaneDesc, ImagePtr>::iterator rotoImagesIt = rotoPaintImages.find(plane->first);
@@ -183,6 +183,16 @@ private:
                             ViewIdx* inputView,
                             int* inputNb) OVERRIDE FINAL WARN_UNUSED_RETURN;
     virtual StatusEnum render(const RenderActionArgs& args) OVERRIDE WARN_UNUSED_RETURN;
+
+    /**
+     * @brief Composites the given items over treeImg, or over bgImg if NULL, in a single pass over the render window.
+     * Returns an RGBA image whose bounds are the render window, or NULL if the render failed or was aborted.
+     **/
+    ImagePtr renderFlattenedItems(const RenderActionArgs& args,
+                                  const std::list<RotoDrawableItemPtr>& items,
+                                  const ImagePtr& treeImg,
+                                  const ImagePtr& bgImg);
+
     virtual void refreshExtraStateAfterTimeChanged(bool isPlayback, double time)  OVERRIDE FINAL;
     std::unique_ptr<RotoPaintPrivate> _imp;
 };
@@ -0,0 +1,520 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * (C) 2018-2023 The Natron developers
+ * (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "RotoPaintCompositor.h"
+
+#include <algorithm> // min, max, copy, fill
+#include <cassert>
+#include <cmath>
+
+#include "Engine/AppManager.h"
+#include "Engine/TaskScheduler.h"
+
+// Rois with fewer pixels than this are composited by the calling thread only
+#define NATRON_ROTOPAINT_COMPOSITOR_MIN_PIXELS_PER_BAND (1 << 14)
+
+NATRON_NAMESPACE_ENTER
+
+// The merge functions of the Merge node (see openfx-supportext/ofxsMerging.h), for float images, for one
+// channel of A and B, a and b being the alpha of A and B. They are applied to the alpha channel too.
+template <MergingFunctionEnum f>
+static inline float
+mergeFunctor(float A,
+             float B,
+             float a,
+             float b)
+{
+    switch (f) {
+    case eMergeATop:
+
+        return A * b + B * (1.f - a);
+    case eMergeAverage:
+
+        return (A + B) / 2.f;
+    case eMergeColorBurn:
+        if (A <= 0.f) {
+            return A;
+        }
+
+        return 1.f - std::min(1.f, (1.f - B) / A);
+    case eMergeColorDodge:
+        if (A >= 1.f) {
+            return A;
+        }
+
+        return std::min(1.f, B / (1.f - A) );
+    case eMergeConjointOver:
+        if (a > b) {
+            return A;
+        } else if (b <= 0.f) {
+            return A + B;
+        }
+
+        return A + B * (1.f - a / b);
+    case eMergeCopy:
+
+        return A;
+    case eMergeDifference:
+
+        return std::abs(A - B);
+    case eMergeDisjointOver:
+        if (a + b < 1.f) {
+            return A + B;
+        } else if (b <= 0.f) {
+            return A;
+        }
+
+        return A + B * (1.f - a) / b;
+    case eMergeExclusion:
+
+        return A + B - 2.f * A * B;
+    case eMergeFrom:
+
+        return B - A;
+    case eMergeGrainExtract:
+
+        return B - A + 0.5f;
+    case eMergeGrainMerge:
+
+        return B + A - 0.5f;
+    case eMergeHypot:
+
+        return std::sqrt(A * A + B * B);
+    case eMergeIn:
+
+        return A * b;
+    case eMergeMask:
+
+        return B * a;
+    case eMergeMax:
+
+        return std::max(A, B);
+    case eMergeMin:
+
+        return std::min(A, B);
+    case eMergeMinus:
+
+        return A - B;
+    case eMergeMultiply:
+        if ( (A < 0.f) && (B < 0.f) ) {
+            return 0.f;
+        }
+
+        return A * B;
+    case eMergeOut:
+
+        return A * (1.f - b);
+    case eMergeOver:
+
+        return A + B * (1.f - a);
+    case eMergePlus:
+
+        return A + B;
+    case eMergeScreen:
+        if ( (A <= 1.f) || (B <= 1.f) ) {
+            return A + B - A * B;
+        }
+
+        return std::max(A, B);
+    case eMergeStencil:
+
+        return B * (1.f - a);
+    case eMergeUnder:
+
+        return A * (1.f - b) + B;
+    case eMergeXOR:
+
+        return A * (1.f - b) + B * (1.f - a);
+    default:
+        assert(false);
+
+        return B;
+    } // switch
+} // mergeFunctor
+
+// Merges n RGBA pixels of A into B, through the mask if any. A and the mask are not advanced if their step is 0.
+// A may be B itself.
+template <MergingFunctionEnum f>
+static void
+mergeSpan(const float* A,
+          int aStep,
+          const float* mask,
+          int maskStep,
+          float* B,
+          int n)
+{
+    for (int x = 0; x < n; ++x, A += aStep, B += 4) {
+        float m = 1.f;
+        if (mask) {
+            m = *mask;
+            mask += maskStep;
+            if (m == 0.f) {
+                continue;
+            }
+        }
+        const float a = A[3];
+        const float b = B[3];
+        float out[4];
+        for (int c = 0; c < 4; ++c) {
+            out[c] = mergeFunctor<f>(A[c], B[c], a, b);
+        }
+        if (m == 1.f) {
+            for (int c = 0; c < 4; ++c) {
+                B[c] = out[c];
+            }
+        } else {
+            for (int c = 0; c < 4; ++c) {
+                B[c] += (out[c] - B[c]) * m;
+            }
+        }
+    }
+}
+
+static void
+mergeSpanForOperator(MergingFunctionEnum op,
+                     const float* A,
+                     int aStep,
+                     const float* mask,
+                     int maskStep,
+                     float* B,
+                     int n)
+{
+    switch (op) {
+    case eMergeATop:
+        mergeSpan<eMergeATop>(A, aStep, mask, maskStep, B, n);
+        break;
+    case eMergeAverage:
+        mergeSpan<eMergeAverage>(A, aStep, mask, maskStep, B, n);
+        break;
+    case eMergeColorBurn:
+        mergeSpan<eMergeColorBurn>(A, aStep, mask, maskStep, B, n);
+        break;
+    case eMergeColorDodge:
+        mergeSpan<eMergeColorDodge>(A, aStep, mask, maskStep, B, n);
+        break;
+    case eMergeConjointOver:
+        mergeSpan<eMergeConjointOver>(A, aStep, mask, maskStep, B, n);
+        break;
+    case eMergeCopy:
+        mergeSpan<eMergeCopy>(A, aStep, mask, maskStep, B, n);
+        break;
+    case eMergeDifference:
+        mergeSpan<eMergeDifference>(A, aStep, mask, maskStep, B, n);
+        break;
+    case eMergeDisjointOver:
+        mergeSpan<eMergeDisjointOver>(A, aStep, mask, maskStep, B, n);
+        break;
+    case eMergeExclusion:
+        mergeSpan<eMergeExclusion>(A, aStep, mask, maskStep, B, n);
+        break;
+    case eMergeFrom:
+        mergeSpan<eMergeFrom>(A, aStep, mask, maskStep, B, n);
+        break;
+    case eMergeGrainExtract:
+        mergeSpan<eMergeGrainExtract>(A, aStep, mask, maskStep, B, n);
+        break;
+    case eMergeGrainMerge:
+        mergeSpan<eMergeGrainMerge>(A, aStep, mask, maskStep, B, n);
+        break;
+    case eMergeHypot:
+        mergeSpan<eMergeHypot>(A, aStep, mask, maskStep, B, n);
+        break;
+    case eMergeIn:
+        mergeSpan<eMergeIn>(A, aStep, mask, maskStep, B, n);
+        break;
+    case eMergeMask:
+        mergeSpan<eMergeMask>(A, aStep, mask, maskStep, B, n);
+        break;
+    case eMergeMax:
+        mergeSpan<eMergeMax>(A, aStep, mask, maskStep, B, n);
+        break;
+    case eMergeMin:
+        mergeSpan<eMergeMin>(A, aStep, mask, maskStep, B, n);
+        break;
+    case eMergeMinus:
+        mergeSpan<eMergeMinus>(A, aStep, mask, maskStep, B, n);
+        break;
+    case eMergeMultiply:
+        mergeSpan<eMergeMultiply>(A, aStep, mask, maskStep, B, n);
+        break;
+    case eMergeOut:
+        mergeSpan<eMergeOut>(A, aStep, mask, maskStep, B, n);
+        break;
+    case eMergeOver:
+        mergeSpan<eMergeOver>(A, aStep, mask, maskStep, B, n);
+        break;
+    case eMergePlus:
+        mergeSpan<eMergePlus>(A, aStep, mask, maskStep, B, n);
+        break;
+    case eMergeScreen:
+        mergeSpan<eMergeScreen>(A, aStep, mask, maskStep, B, n);
+        break;
+    case eMergeStencil:
+        mergeSpan<eMergeStencil>(A, aStep, mask, maskStep, B, n);
+        break;
+    case eMergeUnder:
+        mergeSpan<eMergeUnder>(A, aStep, mask, maskStep, B, n);
+        break;
+    case eMergeXOR:
+        mergeSpan<eMergeXOR>(A, aStep, mask, maskStep, B, n);
+        break;
+    default:
+        assert(false);
+        break;
+    } // switch
+} // mergeSpanForOperator
+
+// Returns true if merging a transparent black A leaves B unchanged: the pixels outside of the bounds of a shape
+// may then be skipped.
+static bool
+isIdentityForTransparentA(MergingFunctionEnum op)
+{
+    switch (op) {
+    case eMergeATop:
+    case eMergeConjointOver:
+    case eMergeExclusion:
+    case eMergeFrom:
+    case eMergeOver:
+    case eMergePlus:
+    case eMergeScreen:
+    case eMergeStencil:
+    case eMergeUnder:
+    case eMergeXOR:
+
+        return true;
+    default:
+
+        return false;
+    }
+}
+
+RotoPaintCompositor::RotoPaintCompositor()
+    : _bgPixels(0)
+    , _bgBounds()
+    , _layers()
+{
+}
+
+bool
+RotoPaintCompositor::isOperatorSupported(MergingFunctionEnum op)
+{
+    switch (op) {
+    case eMergeATop:
+    case eMergeAverage:
+    case eMergeColorBurn:
+    case eMergeColorDodge:
+    case eMergeConjointOver:
+    case eMergeCopy:
+    case eMergeDifference:
+    case eMergeDisjointOver:
+    case eMergeExclusion:
+    case eMergeFrom:
+    case eMergeGrainExtract:
+    case eMergeGrainMerge:
+    case eMergeHypot:
+    case eMergeIn:
+    case eMergeMask:
+    case eMergeMax:
+    case eMergeMin:
+    case eMergeMinus:
+    case eMergeMultiply:
+    case eMergeOut:
+    case eMergeOver:
+    case eMergePlus:
+    case eMergeScreen:
+    case eMergeStencil:
+    case eMergeUnder:
+    case eMergeXOR:
+
+        return true;
+    default:
+
+        // The non-separable operators and those depending on the unpremultiplied colors
+        return false;
+    }
+}
+
+void
+RotoPaintCompositor::setBackground(const float* pixels,
+                                   const RectI& bounds)
+{
+    _bgPixels = pixels;
+    _bgBounds = bounds;
+}
+
+void
+RotoPaintCompositor::addShapeLayer(MergingFunctionEnum op,
+                                   const float* pixels,
+                                   const RectI& bounds)
+{
+    assert( isOperatorSupported(op) );
+    Layer layer;
+    layer.op = op;
+    layer.masked = false;
+    layer.source = eSourceBackground;
+    layer.pixels = pixels;
+    layer.bounds = bounds;
+    _layers.push_back(layer);
+}
+
+void
+RotoPaintCompositor::addMaskedLayer(MergingFunctionEnum op,
+                                    SourceEnum source,
+                                    const float* mask,
+                                    const RectI& bounds)
+{
+    assert( isOperatorSupported(op) );
+    Layer layer;
+    layer.op = op;
+    layer.masked = true;
+    layer.source = source;
+    layer.pixels = mask;
+    layer.bounds = bounds;
+    _layers.push_back(layer);
+}
+
+bool
+RotoPaintCompositor::isEmpty() const
+{
+    return _layers.empty();
+}
+
+// Copies the row y of the RGBA image to dst, from x1 to x2, with transparent black outside of the image
+static void
+copyRow(const float* pixels,
+        const RectI& bounds,
+        int y,
+        int x1,
+        int x2,
+        float* dst)
+{
+    const int ix1 = std::max(x1, bounds.x1);
+    const int ix2 = std::min(x2, bounds.x2);
+
+    if ( !pixels || (y < bounds.y1) || (y >= bounds.y2) || (ix1 >= ix2) ) {
+        std::fill(dst, dst + (x2 - x1) * 4, 0.f);
+
+        return;
+    }
+    std::fill(dst, dst + (ix1 - x1) * 4, 0.f);
+    const float* src = pixels + ( (std::size_t)(y - bounds.y1) * bounds.width() + (ix1 - bounds.x1) ) * 4;
+    std::copy(src, src + (ix2 - ix1) * 4, dst + (ix1 - x1) * 4);
+    std::fill(dst + (ix2 - x1) * 4, dst + (x2 - x1) * 4, 0.f);
+}
+
+void
+RotoPaintCompositor::compositeRows(const float* upstream,
+                                   const RectI& upstreamBounds,
+                                   const RectI& roi,
+                                   int y1,
+                                   int y2,
+                                   float* dst) const
+{
+    const int width = roi.width();
+    const float transparent[4] = { 0.f, 0.f, 0.f, 0.f };
+
+    // The background row, read by the eraser layers
+    std::vector<float> bgRow;
+
+    for (int y = y1; y < y2; ++y) {
+        float* row = dst + (std::size_t)(y - roi.y1) * width * 4;
+        const bool upstreamCoversRow = upstream && y >= upstreamBounds.y1 && y < upstreamBounds.y2 &&
+                                       upstreamBounds.x1 <= roi.x1 && upstreamBounds.x2 >= roi.x2;
+        if (upstreamCoversRow) {
+            copyRow(upstream, upstreamBounds, y, roi.x1, roi.x2, row);
+        } else {
+            // the background shows outside of the upstream image
+            copyRow(_bgPixels, _bgBounds, y, roi.x1, roi.x2, row);
+            const int x1 = std::max(roi.x1, upstreamBounds.x1);
+            const int x2 = std::min(roi.x2, upstreamBounds.x2);
+            if ( upstream && (upstream != _bgPixels) && (y >= upstreamBounds.y1) && (y < upstreamBounds.y2) && (x1 < x2) ) {
+                copyRow(upstream, upstreamBounds, y, x1, x2, row + (x1 - roi.x1) * 4);
+            }
+        }
+        bool bgRowLoaded = false;
+
+        for (std::vector<Layer>::const_iterator it = _layers.begin(); it != _layers.end(); ++it) {
+            const bool rowInside = y >= it->bounds.y1 && y < it->bounds.y2;
+            const int x1 = std::max(roi.x1, it->bounds.x1);
+            const int x2 = std::min(roi.x2, it->bounds.x2);
+            const bool hasSpan = rowInside && x1 < x2;
+
+            if (!it->masked) {
+                if ( !isIdentityForTransparentA(it->op) ) {
+                    // merge a transparent A outside of the shape
+                    const int spanStart = hasSpan ? x1 : roi.x2;
+                    const int spanEnd = hasSpan ? x2 : roi.x2;
+                    mergeSpanForOperator(it->op, transparent, 0, 0, 0, row, spanStart - roi.x1);
+                    mergeSpanForOperator(it->op, transparent, 0, 0, 0, row + (spanEnd - roi.x1) * 4, roi.x2 - spanEnd);
+                }
+                if (hasSpan) {
+                    const float* A = it->pixels + ( (std::size_t)(y - it->bounds.y1) * it->bounds.width() + (x1 - it->bounds.x1) ) * 4;
+                    mergeSpanForOperator(it->op, A, 4, 0, 0, row + (x1 - roi.x1) * 4, x2 - x1);
+                }
+            } else if (hasSpan) {
+                const float* mask = it->pixels + (std::size_t)(y - it->bounds.y1) * it->bounds.width() + (x1 - it->bounds.x1);
+                float* B = row + (x1 - roi.x1) * 4;
+                const float* A;
+                if (it->source == eSourceUpstream) {
+                    A = B;
+                } else {
+                    if (!bgRowLoaded) {
+                        bgRow.resize( (std::size_t)width * 4 );
+                        copyRow(_bgPixels, _bgBounds, y, roi.x1, roi.x2, &bgRow[0]);
+                        bgRowLoaded = true;
+                    }
+                    A = &bgRow[(x1 - roi.x1) * 4];
+                }
+                mergeSpanForOperator(it->op, A, 4, mask, 1, B, x2 - x1);
+            }
+        }
+    }
+} // RotoPaintCompositor::compositeRows
+
+void
+RotoPaintCompositor::composite(const float* upstream,
+                               const RectI& upstreamBounds,
+                               const RectI& roi,
+                               float* dst) const
+{
+    if ( roi.isNull() ) {
+        return;
+    }
+    const int nRows = roi.height();
+    const int nBands = std::max( 1, std::min( nRows, (int)(roi.area() / NATRON_ROTOPAINT_COMPOSITOR_MIN_PIXELS_PER_BAND) ) );
+    const int rowsPerBand = (nRows + nBands - 1) / nBands;
+    TaskScheduler* scheduler = appPTR ? appPTR->getTaskScheduler() : NULL;
+
+    if ( (nBands > 1) && scheduler ) {
+        scheduler->parallelFor( (nRows + rowsPerBand - 1) / rowsPerBand, [&](int band) {
+            const int y1 = roi.y1 + band * rowsPerBand;
+            compositeRows( upstream, upstreamBounds, roi, y1, std::min(y1 + rowsPerBand, roi.y2), dst );
+        } );
+    } else {
+        compositeRows(upstream, upstreamBounds, roi, roi.y1, roi.y2, dst);
+    }
+}
+
+NATRON_NAMESPACE_EXIT
@@ -0,0 +1,124 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * (C) 2018-2023 The Natron developers
+ * (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_ROTOPAINTCOMPOSITOR_H
+#define NATRON_ENGINE_ROTOPAINTCOMPOSITOR_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <vector>
+
+#include "Global/Enums.h"
+
+#include "Engine/RectI.h"
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief Composites a stack of roto items in a single pass over the render window, instead of rendering the
+ * internal Merge node of each item one after the other.
+ *
+ * Each layer does what the internal Merge node of an item does: the layers are applied in order, the B input of a
+ * layer being the result of the layers below it. All the images are RGBA float images, except the masks which
+ * only have an alpha channel, and are transparent black outside of their bounds.
+ *
+ * Only the separable merge operators are supported, see isOperatorSupported().
+ * The rows are composited in parallel bands by the TaskScheduler of the application.
+ **/
+class RotoPaintCompositor
+{
+public:
+
+    /**
+     * @brief Where the A input of the merge of a masked layer comes from
+     **/
+    enum SourceEnum
+    {
+        eSourceBackground = 0, //< The background of the RotoPaint node: the eraser
+        eSourceUpstream //< The result of the layers below: dodge and burn
+    };
+
+    RotoPaintCompositor();
+
+    /**
+     * @brief Returns true if the given operator can be composited by addShapeLayer() and addMaskedLayer()
+     **/
+    static bool isOperatorSupported(NATRON_ENUM::MergingFunctionEnum op);
+
+    /**
+     * @brief The image read by the layers whose source is eSourceBackground. The pixels must remain valid until
+     * composite() returns.
+     **/
+    void setBackground(const float* pixels, const RectI& bounds);
+
+    /**
+     * @brief Adds a layer whose A input is the given shape image, already multiplied by its color and opacity,
+     * without mask: this is a solid stroke or a bezier.
+     **/
+    void addShapeLayer(NATRON_ENUM::MergingFunctionEnum op, const float* pixels, const RectI& bounds);
+
+    /**
+     * @brief Adds a layer whose A input comes from the given source, merged with B through the given mask.
+     **/
+    void addMaskedLayer(NATRON_ENUM::MergingFunctionEnum op, SourceEnum source, const float* mask, const RectI& bounds);
+
+    bool isEmpty() const;
+
+    /**
+     * @brief Composites all layers over the upstream image in the roi and writes the result to dst, whose bounds
+     * are the roi. The background shows outside of the upstream image, which may be NULL.
+     **/
+    void composite(const float* upstream,
+                   const RectI& upstreamBounds,
+                   const RectI& roi,
+                   float* dst) const;
+
+private:
+
+    struct Layer
+    {
+        NATRON_ENUM::MergingFunctionEnum op;
+        bool masked;
+        SourceEnum source;
+        const float* pixels;
+        RectI bounds;
+    };
+
+    void compositeRows(const float* upstream,
+                       const RectI& upstreamBounds,
+                       const RectI& roi,
+                       int y1,
+                       int y2,
+                       float* dst) const;
+
+    const float* _bgPixels;
+    RectI _bgBounds;
+    std::vector<Layer> _layers;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_ROTOPAINTCOMPOSITOR_H
@@ -0,0 +1,402 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * (C) 2018-2023 The Natron developers
+ * (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "RotoShapeRasterizer.h"
+
+#include <algorithm> // min, max, sort
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include "Engine/AppManager.h"
+#include "Engine/TaskScheduler.h"
+
+// Rois with fewer pixels than this are rasterized by the calling thread only
+#define NATRON_ROTO_RASTERIZER_MIN_PIXELS_PER_BAND (1 << 14)
+
+// The edges and triangles crossing each group of this many rows are selected once for the whole group
+#define NATRON_ROTO_RASTERIZER_ROWS_PER_CHUNK 16
+
+// The number of intervals of the lookup table of the feather coverage
+#define NATRON_ROTO_RASTERIZER_LUT_SIZE 1024
+
+NATRON_NAMESPACE_ENTER
+
+RotoShapeRasterizer::RotoShapeRasterizer()
+    : _layers()
+{
+}
+
+// The feather used to be a cairo mesh patch whose side going from the shape (u = 0) to the feather edge (u = 1)
+// is a cubic bezier with control points at 1 / (2 * fallOff^2 + 1) and 2 / (fallOff^2 + 2), along which
+// the alpha of the patch is 1 - u. The patch was applied both as the source and as the mask, hence the square.
+// Returns the position along that side of the given u.
+static inline double
+getFeatherRamp(double u,
+               double fallOff)
+{
+    if ( !(fallOff > 0) ) {
+        return u;
+    }
+    const double c1 = 1. / (2. * fallOff * fallOff + 1.);
+    const double c2 = 2. / (fallOff * fallOff + 2.);
+    const double v = 1. - u;
+
+    // increasing since 0 < c1 < c2 < 1
+    return 3. * v * v * u * c1 + 3. * v * u * u * c2 + u * u * u;
+}
+
+double
+RotoShapeRasterizer::getFeatherCoverage(double ramp,
+                                        double fallOff)
+{
+    ramp = std::max( 0., std::min(ramp, 1.) );
+    double lo = 0., hi = 1.;
+    for (int i = 0; i < 50; ++i) {
+        const double u = (lo + hi) / 2.;
+        if (getFeatherRamp(u, fallOff) < ramp) {
+            lo = u;
+        } else {
+            hi = u;
+        }
+    }
+    const double u = (lo + hi) / 2.;
+
+    return (1. - u) * (1. - u);
+}
+
+void
+RotoShapeRasterizer::beginLayer(double fallOff)
+{
+    pushLayer(fallOff, false, 1.);
+}
+
+void
+RotoShapeRasterizer::beginAccumulatedLayer(double fallOff,
+                                           double weight)
+{
+    pushLayer(fallOff, true, weight);
+}
+
+void
+RotoShapeRasterizer::pushLayer(double fallOff,
+                               bool accumulated,
+                               double weight)
+{
+    Layer layer;
+
+    layer.ymin = std::numeric_limits<double>::infinity();
+    layer.ymax = -std::numeric_limits<double>::infinity();
+    if ( !_layers.empty() && (_layers.back().fallOff == fallOff) ) {
+        layer.coverageLut = _layers.back().coverageLut;
+    } else {
+        // invert the ramp by walking along finer samples of u, which is faster than getFeatherCoverage()
+        layer.coverageLut.resize(NATRON_ROTO_RASTERIZER_LUT_SIZE + 1);
+        const int nSamples = NATRON_ROTO_RASTERIZER_LUT_SIZE * 8;
+        int j = 0;
+        double u0 = 0., ramp0 = 0.;
+        double u1 = 1. / nSamples, ramp1 = getFeatherRamp(u1, fallOff);
+        for (int i = 0; i <= NATRON_ROTO_RASTERIZER_LUT_SIZE; ++i) {
+            const double ramp = (double)i / NATRON_ROTO_RASTERIZER_LUT_SIZE;
+            while ( (ramp1 < ramp) && (j + 1 < nSamples) ) {
+                ++j;
+                u0 = u1;
+                ramp0 = ramp1;
+                u1 = (double)(j + 1) / nSamples;
+                ramp1 = getFeatherRamp(u1, fallOff);
+            }
+            const double u = (ramp1 > ramp0) ? u0 + (u1 - u0) * std::max( 0., std::min( (ramp - ramp0) / (ramp1 - ramp0), 1. ) ) : u0;
+            layer.coverageLut[i] = (float)( (1. - u) * (1. - u) );
+        }
+    }
+    layer.fallOff = fallOff;
+    layer.accumulated = accumulated;
+    layer.weight = (float)weight;
+    _layers.push_back(layer);
+}
+
+void
+RotoShapeRasterizer::addEdge(const Point& p0,
+                             const Point& p1)
+{
+    assert( !_layers.empty() );
+    if ( _layers.empty() || (p0.y == p1.y) ) {
+        // horizontal edges cross no row
+        return;
+    }
+    Layer& layer = _layers.back();
+    Edge e;
+    if (p0.y < p1.y) {
+        e.x0 = p0.x;
+        e.y0 = p0.y;
+        e.y1 = p1.y;
+        e.winding = 1;
+    } else {
+        e.x0 = p1.x;
+        e.y0 = p1.y;
+        e.y1 = p0.y;
+        e.winding = -1;
+    }
+    e.dxdy = (p1.x - p0.x) / (p1.y - p0.y);
+    layer.edges.push_back(e);
+    layer.ymin = std::min(layer.ymin, e.y0);
+    layer.ymax = std::max(layer.ymax, e.y1);
+}
+
+void
+RotoShapeRasterizer::addFeatherTriangle(const Point& p0,
+                                        double ramp0,
+                                        const Point& p1,
+                                        double ramp1,
+                                        const Point& p2,
+                                        double ramp2)
+{
+    assert( !_layers.empty() );
+    if ( _layers.empty() ) {
+        return;
+    }
+    const double det = (p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y);
+    if ( (det == 0.) || !(std::abs(det) > 1e-12) ) {
+        // degenerate (or NaN) triangles cover no pixel center
+        return;
+    }
+    Layer& layer = _layers.back();
+    FeatherTriangle t;
+    const Point* v[3] = { &p0, &p1, &p2 };
+    if (v[1]->y < v[0]->y) {
+        std::swap(v[0], v[1]);
+    }
+    if (v[2]->y < v[1]->y) {
+        std::swap(v[1], v[2]);
+    }
+    if (v[1]->y < v[0]->y) {
+        std::swap(v[0], v[1]);
+    }
+    t.ymin = v[0]->y;
+    t.ymid = v[1]->y;
+    t.ymax = v[2]->y;
+    t.xmin = v[0]->x;
+    t.xmid = v[1]->x;
+    // the triangle is not degenerate, so ymin < ymax
+    t.dxdyLong = (v[2]->x - v[0]->x) / (t.ymax - t.ymin);
+    t.dxdyUpper = (t.ymid > t.ymin) ? (v[1]->x - v[0]->x) / (t.ymid - t.ymin) : 0.;
+    t.dxdyLower = (t.ymax > t.ymid) ? (v[2]->x - v[1]->x) / (t.ymax - t.ymid) : 0.;
+    t.a = ( (ramp1 - ramp0) * (p2.y - p0.y) - (ramp2 - ramp0) * (p1.y - p0.y) ) / det;
+    t.b = ( (p1.x - p0.x) * (ramp2 - ramp0) - (p2.x - p0.x) * (ramp1 - ramp0) ) / det;
+    t.c = ramp0 - t.a * p0.x - t.b * p0.y;
+    layer.triangles.push_back(t);
+    layer.ymin = std::min(layer.ymin, t.ymin);
+    layer.ymax = std::max(layer.ymax, t.ymax);
+}
+
+bool
+RotoShapeRasterizer::isEmpty() const
+{
+    for (std::size_t i = 0; i < _layers.size(); ++i) {
+        if ( !_layers[i].edges.empty() || !_layers[i].triangles.empty() ) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Returns the first and last + 1 pixels whose center is in [xa, xb), clipped to [x1, x2)
+static inline void
+getPixelSpan(double xa,
+             double xb,
+             int x1,
+             int x2,
+             int* px1,
+             int* px2)
+{
+    // clamp in double first, the feather of a large shape may be far outside of the roi
+    *px1 = (int)std::max( (double)x1, std::ceil(xa - 0.5) );
+    *px2 = (int)std::min( (double)x2, std::ceil(xb - 0.5) );
+}
+
+void
+RotoShapeRasterizer::renderRows(const RectI& roi,
+                                int y1,
+                                int y2,
+                                const std::function<void(int y, const float* coverage)>& writeRow) const
+{
+    const int width = roi.width();
+    std::vector<float> coverage(width);
+    std::vector<float> layerCoverage(width, 0.f);
+    std::vector<float> ramps(width, -1.f);
+    std::vector<std::pair<double, int> > crossings;
+    std::vector<std::vector<const Edge*> > chunkEdges( _layers.size() );
+    std::vector<std::vector<const FeatherTriangle*> > chunkTriangles( _layers.size() );
+
+    for (int chunkY1 = y1; chunkY1 < y2; chunkY1 += NATRON_ROTO_RASTERIZER_ROWS_PER_CHUNK) {
+        const int chunkY2 = std::min(chunkY1 + NATRON_ROTO_RASTERIZER_ROWS_PER_CHUNK, y2);
+        // the range of the centers of the rows of the chunk
+        const double chunkYMin = chunkY1 + 0.5;
+        const double chunkYMax = chunkY2 - 0.5;
+
+        for (std::size_t l = 0; l < _layers.size(); ++l) {
+            const Layer& layer = _layers[l];
+            chunkEdges[l].clear();
+            chunkTriangles[l].clear();
+            if ( (layer.ymax <= chunkYMin) || (layer.ymin > chunkYMax) ) {
+                continue;
+            }
+            for (std::size_t i = 0; i < layer.edges.size(); ++i) {
+                const Edge& e = layer.edges[i];
+                if ( (e.y1 > chunkYMin) && (e.y0 <= chunkYMax) ) {
+                    chunkEdges[l].push_back(&e);
+                }
+            }
+            // keep the order of the triangles: the last one covering a pixel wins
+            for (std::size_t i = 0; i < layer.triangles.size(); ++i) {
+                const FeatherTriangle& t = layer.triangles[i];
+                if ( (t.ymax > chunkYMin) && (t.ymin <= chunkYMax) ) {
+                    chunkTriangles[l].push_back(&t);
+                }
+            }
+        }
+
+        for (int y = chunkY1; y < chunkY2; ++y) {
+            const double yc = y + 0.5;
+            std::fill(coverage.begin(), coverage.end(), 0.f);
+
+            for (std::size_t l = 0; l < _layers.size(); ++l) {
+                // an accumulated layer is rendered alone, then added to the previous ones
+                const bool accumulated = _layers[l].accumulated;
+                float* dst = accumulated ? &layerCoverage[0] : &coverage[0];
+                int dirtyX1 = roi.x2, dirtyX2 = roi.x1;
+
+                // fill the inside with the non-zero winding rule
+                const std::vector<const Edge*>& edges = chunkEdges[l];
+                crossings.clear();
+                for (std::size_t i = 0; i < edges.size(); ++i) {
+                    const Edge& e = *edges[i];
+                    if ( (yc >= e.y0) && (yc < e.y1) ) {
+                        crossings.push_back( std::make_pair(e.x0 + (yc - e.y0) * e.dxdy, e.winding) );
+                    }
+                }
+                std::sort( crossings.begin(), crossings.end() );
+                int winding = 0;
+                double spanStart = 0.;
+                for (std::size_t i = 0; i < crossings.size(); ++i) {
+                    const int prevWinding = winding;
+                    winding += crossings[i].second;
+                    if ( (prevWinding == 0) && (winding != 0) ) {
+                        spanStart = crossings[i].first;
+                    } else if ( (prevWinding != 0) && (winding == 0) ) {
+                        int px1, px2;
+                        getPixelSpan(spanStart, crossings[i].first, roi.x1, roi.x2, &px1, &px2);
+                        for (int x = px1; x < px2; ++x) {
+                            dst[x - roi.x1] = 1.f;
+                        }
+                        if (px1 < px2) {
+                            dirtyX1 = std::min(dirtyX1, px1);
+                            dirtyX2 = std::max(dirtyX2, px2);
+                        }
+                    }
+                }
+
+                // rasterize the ramp of the feather, then composite it over the inside
+                const std::vector<const FeatherTriangle*>& triangles = chunkTriangles[l];
+                int rampX1 = roi.x2, rampX2 = roi.x1;
+                for (std::size_t i = 0; i < triangles.size(); ++i) {
+                    const FeatherTriangle& t = *triangles[i];
+                    if ( (yc < t.ymin) || (yc >= t.ymax) ) {
+                        continue;
+                    }
+                    const double xa = t.xmin + (yc - t.ymin) * t.dxdyLong;
+                    const double xb = (yc < t.ymid) ? t.xmin + (yc - t.ymin) * t.dxdyUpper : t.xmid + (yc - t.ymid) * t.dxdyLower;
+                    const double xl = std::min(xa, xb);
+                    const double xr = std::max(xa, xb);
+                    int px1, px2;
+                    getPixelSpan(xl, xr, roi.x1, roi.x2, &px1, &px2);
+                    if (px1 >= px2) {
+                        continue;
+                    }
+                    rampX1 = std::min(rampX1, px1);
+                    rampX2 = std::max(rampX2, px2);
+                    const double rowRamp = t.b * yc + t.c;
+                    for (int x = px1; x < px2; ++x) {
+                        ramps[x - roi.x1] = (float)(t.a * (x + 0.5) + rowRamp);
+                    }
+                }
+                const float* lut = &_layers[l].coverageLut[0];
+                for (int x = rampX1; x < rampX2; ++x) {
+                    float& ramp = ramps[x - roi.x1];
+                    if (ramp < -0.5f) {
+                        // not covered by the feather
+                        continue;
+                    }
+                    float index = std::max( 0.f, std::min(ramp, 1.f) ) * NATRON_ROTO_RASTERIZER_LUT_SIZE;
+                    int i = std::min( (int)index, NATRON_ROTO_RASTERIZER_LUT_SIZE - 1 );
+                    float f = lut[i] + (index - i) * (lut[i + 1] - lut[i]);
+                    float& cov = dst[x - roi.x1];
+                    cov = f + cov * (1.f - f);
+                    ramp = -1.f;
+                }
+
+                if (accumulated) {
+                    dirtyX1 = std::min(dirtyX1, rampX1);
+                    dirtyX2 = std::max(dirtyX2, rampX2);
+                    const float weight = _layers[l].weight;
+                    for (int x = dirtyX1; x < dirtyX2; ++x) {
+                        float& cov = coverage[x - roi.x1];
+                        float& layerCov = layerCoverage[x - roi.x1];
+                        cov = std::min(cov + weight * layerCov, 1.f);
+                        layerCov = 0.f;
+                    }
+                }
+            }
+
+            writeRow(y, &coverage[0]);
+        }
+    }
+} // RotoShapeRasterizer::renderRows
+
+void
+RotoShapeRasterizer::rasterize(const RectI& roi,
+                               const std::function<void(int y, const float* coverage)>& writeRow) const
+{
+    if ( roi.isNull() ) {
+        return;
+    }
+    const int nRows = roi.height();
+    const int nBands = std::max( 1, std::min( nRows, (int)(roi.area() / NATRON_ROTO_RASTERIZER_MIN_PIXELS_PER_BAND) ) );
+    const int rowsPerBand = (nRows + nBands - 1) / nBands;
+    TaskScheduler* scheduler = appPTR ? appPTR->getTaskScheduler() : NULL;
+
+    if ( (nBands > 1) && scheduler ) {
+        scheduler->parallelFor( (nRows + rowsPerBand - 1) / rowsPerBand, [&](int band) {
+            const int y1 = roi.y1 + band * rowsPerBand;
+            renderRows( roi, y1, std::min(y1 + rowsPerBand, roi.y2), writeRow );
+        } );
+    } else {
+        renderRows(roi, roi.y1, roi.y2, writeRow);
+    }
+}
+
+NATRON_NAMESPACE_EXIT
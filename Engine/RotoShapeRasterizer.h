@@ -0,0 +1,172 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * (C) 2018-2023 The Natron developers
+ * (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_ROTOSHAPERASTERIZER_H
+#define NATRON_ENGINE_ROTOSHAPERASTERIZER_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <functional>
+#include <vector>
+
+#include "Global/GlobalDefines.h"
+
+#include "Engine/RectI.h"
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief A scanline rasterizer computing the float coverage of closed roto shapes and of their feather.
+ *
+ * The shape is made of layers, composited in order with the OVER operator, or accumulated: each motion blur
+ * sample of a shape is an accumulated layer, so that the samples are averaged in a single pass. The inside of
+ * a layer is the union of its edges, filled with the non-zero winding rule, and has a coverage of 1. Its feather
+ * is made of triangles carrying a ramp which goes from 0 on the shape to 1 on the feather edge: the ramp is
+ * linearly interpolated in each triangle, the last triangle covering a pixel wins, and the feather coverage is
+ * the falloff curve of the ramp, composited over the inside.
+ *
+ * Pixels are sampled at their center, without antialiasing, so that the inside and the feather join without
+ * seams. The rows are rendered in parallel bands by the TaskScheduler of the application.
+ **/
+class RotoShapeRasterizer
+{
+public:
+
+    RotoShapeRasterizer();
+
+    /**
+     * @brief Starts a new layer, composited over the previous ones, whose feather coverage is computed with the
+     * given falloff: the ramp follows the curve that cairo mesh patterns used to draw the feather.
+     **/
+    void beginLayer(double fallOff);
+
+    /**
+     * @brief Starts a new layer, like beginLayer(), whose coverage multiplied by weight is added to the coverage
+     * of the previous layers instead of being composited over it. The result is clamped to 1.
+     **/
+    void beginAccumulatedLayer(double fallOff, double weight);
+
+    /**
+     * @brief Adds an edge of the inside of the current layer. The edges of a layer do not need to be ordered,
+     * but must form closed contours.
+     **/
+    void addEdge(const Point& p0, const Point& p1);
+
+    /**
+     * @brief Adds a closed polygon to the inside of the current layer.
+     **/
+    template <typename POINT_ITERATOR>
+    void addContour(POINT_ITERATOR begin,
+                    POINT_ITERATOR end)
+    {
+        if (begin == end) {
+            return;
+        }
+        Point first, prev;
+        first.x = begin->x;
+        first.y = begin->y;
+        prev = first;
+        for (++begin; begin != end; ++begin) {
+            Point p;
+            p.x = begin->x;
+            p.y = begin->y;
+            addEdge(prev, p);
+            prev = p;
+        }
+        addEdge(prev, first);
+    }
+
+    /**
+     * @brief Adds a triangle of the feather of the current layer, with the value of the ramp at each vertex.
+     **/
+    void addFeatherTriangle(const Point& p0, double ramp0,
+                            const Point& p1, double ramp1,
+                            const Point& p2, double ramp2);
+
+    /**
+     * @brief Returns true if nothing was added.
+     **/
+    bool isEmpty() const;
+
+    /**
+     * @brief Returns the coverage of the feather for the given ramp, with the given falloff.
+     **/
+    static double getFeatherCoverage(double ramp, double fallOff);
+
+    /**
+     * @brief Computes the coverage of each row of roi and calls writeRow(y, coverage) with the roi.width() values
+     * of the row, starting at roi.x1. writeRow is called concurrently by several threads, for different rows.
+     **/
+    void rasterize(const RectI& roi,
+                   const std::function<void(int y, const float* coverage)>& writeRow) const;
+
+private:
+
+    struct Edge
+    {
+        double x0, y0; // the point with the lowest y
+        double y1;
+        double dxdy;
+        int winding;
+    };
+
+    struct FeatherTriangle
+    {
+        // the vertices sorted by y
+        double ymin, ymid, ymax;
+        double xmin, xmid;
+
+        // dx/dy of the edges from ymin to ymax, from ymin to ymid and from ymid to ymax
+        double dxdyLong, dxdyUpper, dxdyLower;
+
+        // The ramp is a * x + b * y + c
+        double a, b, c;
+    };
+
+    struct Layer
+    {
+        double fallOff;
+        bool accumulated;
+        float weight;
+        std::vector<float> coverageLut; //< the feather coverage, indexed by the ramp
+        std::vector<Edge> edges;
+        std::vector<FeatherTriangle> triangles;
+        double ymin, ymax;
+    };
+
+    void pushLayer(double fallOff, bool accumulated, double weight);
+
+    void renderRows(const RectI& roi,
+                    int y1,
+                    int y2,
+                    const std::function<void(int y, const float* coverage)>& writeRow) const;
+
+    std::vector<Layer> _layers;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_ROTOSHAPERASTERIZER_H
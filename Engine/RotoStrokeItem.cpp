@@ -689,6 +689,45 @@ RotoStrokeItem::load(const RotoItemSerialization & obj)
     setStrokeFinished();
 }
 
+static void
+appendKeyFramesToHash(const KeyFrameSet& keys,
+                      Hash64* hash)
+{
+    hash->append( (U64)keys.size() );
+    for (KeyFrameSet::const_iterator it = keys.begin(); it != keys.end(); ++it) {
+        hash->append( it->getTime() );
+        hash->append( it->getValue() );
+        hash->append( it->getLeftDerivative() );
+        hash->append( it->getRightDerivative() );
+    }
+}
+
+bool
+RotoStrokeItem::getStaticStrokeHash(U64* hash) const
+{
+    Hash64 h;
+    {
+        QMutexLocker k(&itemMutex);
+        if (!_imp->finished) {
+            return false;
+        }
+        h.append( (int)_imp->type );
+        h.append( (U64)_imp->strokes.size() );
+        for (std::vector<RotoStrokeItemPrivate::StrokeCurves>::const_iterator it = _imp->strokes.begin(); it != _imp->strokes.end(); ++it) {
+            appendKeyFramesToHash(it->xCurve->getKeyFrames_mt_safe(), &h);
+            appendKeyFramesToHash(it->yCurve->getKeyFrames_mt_safe(), &h);
+            appendKeyFramesToHash(it->pressureCurve->getKeyFrames_mt_safe(), &h);
+        }
+    }
+    if ( !appendStaticMaskKnobsToHash(&h) ) {
+        return false;
+    }
+    h.computeHash();
+    *hash = h.value();
+
+    return true;
+}
+
 RectD
 RotoStrokeItem::computeBoundingBoxInternal(double time) const
 {
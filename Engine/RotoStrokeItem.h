@@ -116,6 +116,13 @@ public:
 
     void setStrokeFinished();
 
+    /**
+     * @brief Once the stroke is finished and none of the knobs its mask depends on is animated, the mask is the same
+     * at any time and whatever the image upstream: it can be baked once in the cache, under the hash of the stroke
+     * data returned by this function. Returns false if the mask must be keyed on the time and the merge node instead.
+     **/
+    bool getStaticStrokeHash(U64* hash) const;
+
 
     virtual void clone(const RotoItem* other) OVERRIDE FINAL;
 
@@ -1233,6 +1233,15 @@ Settings::initializeKnobsCaching()
                                            "output has its settings panel opened.").arg( QString::fromUtf8(NATRON_APPLICATION_NAME) ) );
     _cachingTab->addKnob(_aggressiveCaching);
 
+    _halfFloatImages = AppManager::createKnob<KnobBool>( this, tr("Store float images in half float") );
+    _halfFloatImages->setName("halfFloatImages");
+    _halfFloatImages->setHintToolTip( tr("When checked, the images rendered in 32-bit floating point by the nodes are stored "
+                                         "in 16-bit half float in the caches, which halves the amount of memory they use. "
+                                         "Plug-ins still render in 32-bit floating point and their output is converted "
+                                         "when copied to the cache. Half float only has 11 bits of precision, so this may "
+                                         "introduce small differences in the rendered images.") );
+    _cachingTab->addKnob(_halfFloatImages);
+
     _maxRAMPercent = AppManager::createKnob<KnobInt>( this, tr("Maximum amount of RAM memory used for caching (% of total RAM)") );
     _maxRAMPercent->setName("maxRAMPercent");
     _maxRAMPercent->disableSlider();
@@ -1256,6 +1265,26 @@ Settings::initializeKnobsCaching()
     _maxRAMLabel->setAsLabel();
     _cachingTab->addKnob(_maxRAMLabel);
 
+    _compressedRAMPercent = AppManager::createKnob<KnobInt>( this, tr("Compressed RAM cache size (% of total RAM)") );
+    _compressedRAMPercent->setName("compressedRAMPercent");
+    _compressedRAMPercent->disableSlider();
+    _compressedRAMPercent->setMinimum(0);
+    _compressedRAMPercent->setMaximum(100);
+    _compressedRAMPercent->setHintToolTip( tr("When the memory cache is full, the images it recycles are compressed and kept in RAM "
+                                              "in this additional amount of memory, instead of being deleted. "
+                                              "Mattes and images with large constant areas compress very well, so that many more "
+                                              "of them can be kept without having to render them again. "
+                                              "Images that do not compress well are deleted as usual. "
+                                              "0 disables the compressed cache.") );
+    _compressedRAMPercent->setAddNewLine(false);
+    _cachingTab->addKnob(_compressedRAMPercent);
+
+    _compressedRAMLabel = AppManager::createKnob<KnobString>( this, std::string() );
+    _compressedRAMLabel->setName("compressedRAMLabel");
+    _compressedRAMLabel->setIsPersistent(false);
+    _compressedRAMLabel->setAsLabel();
+    _cachingTab->addKnob(_compressedRAMLabel);
+
 
     _unreachableRAMPercent = AppManager::createKnob<KnobInt>( this, tr("System RAM to keep free (% of total RAM)") );
     _unreachableRAMPercent->setName("unreachableRAMPercent");
@@ -1451,6 +1480,7 @@ Settings::setCachingLabels()
     U64 maxRAM = (U64)( ( (double)maxTotalRam / 100. ) * systemTotalRam );
 
     _maxRAMLabel->setValue( printAsRAM(maxRAM).toStdString() );
+    _compressedRAMLabel->setValue( printAsRAM( (double)systemTotalRam * getCompressedRamPercent() ).toStdString() );
     _unreachableRAMLabel->setValue( printAsRAM( (double)systemTotalRam * ( (double)_unreachableRAMPercent->getValue() / 100. ) ).toStdString() );
 }
 
@@ -1532,7 +1562,9 @@ Settings::setDefaultValues()
 
     // Caching
     _aggressiveCaching->setDefaultValue(false);
+    _halfFloatImages->setDefaultValue(false);
     _maxRAMPercent->setDefaultValue(50, 0);
+    _compressedRAMPercent->setDefaultValue(0);
     _unreachableRAMPercent->setDefaultValue(20); // see https://github.com/NatronGitHub/Natron/issues/486
     _maxViewerDiskCacheGB->setDefaultValue(5, 0);
     _maxDiskCacheNodeGB->setDefaultValue(10, 0);
@@ -2289,6 +2321,11 @@ Settings::onKnobValueChanged(KnobI* k,
             appPTR->setApplicationsCachesMaximumMemoryPercent( getRamMaximumPercent() );
         }
         setCachingLabels();
+    } else if ( k == _compressedRAMPercent.get() ) {
+        if (!_restoringSettings) {
+            appPTR->setApplicationsCachesMaximumCompressedMemoryPercent( getCompressedRamPercent() );
+        }
+        setCachingLabels();
     } else if ( k == _diskCachePath.get() ) {
         QString path = QString::fromUtf8(_diskCachePath->getValue().c_str());
         qputenv(NATRON_DISK_CACHE_PATH_ENV_VAR, path.toUtf8());
@@ -2523,12 +2560,30 @@ Settings::isAggressiveCachingEnabled() const
     return _aggressiveCaching->getValue();
 }
 
+bool
+Settings::isHalfFloatImagesStorageEnabled() const
+{
+    return _halfFloatImages->getValue();
+}
+
+void
+Settings::setHalfFloatImagesStorageEnabled(bool enabled)
+{
+    _halfFloatImages->setValue(enabled);
+}
+
 double
 Settings::getRamMaximumPercent() const
 {
     return (double)_maxRAMPercent->getValue() / 100.;
 }
 
+double
+Settings::getCompressedRamPercent() const
+{
+    return (double)_compressedRAMPercent->getValue() / 100.;
+}
+
 U64
 Settings::getMaximumViewerDiskCacheSize() const
 {
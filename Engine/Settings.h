@@ -107,6 +107,8 @@ public:
 
     double getRamMaximumPercent() const;
 
+    double getCompressedRamPercent() const;
+
     U64 getMaximumViewerDiskCacheSize() const;
 
     U64 getMaximumDiskCacheNodeSize() const;
@@ -280,6 +282,9 @@ public:
 
     bool isAggressiveCachingEnabled() const;
 
+    bool isHalfFloatImagesStorageEnabled() const;
+    void setHalfFloatImagesStorageEnabled(bool enabled);
+
     bool isAutoTurboEnabled() const;
 
     void setAutoTurboModeEnabled(bool e);
@@ -503,6 +508,8 @@ private:
     // Caching
     KnobPagePtr _cachingTab;
     KnobBoolPtr _aggressiveCaching;
+    ///When checked, float images are stored in half float in the caches
+    KnobBoolPtr _halfFloatImages;
     ///The percentage of the value held by _maxRAMPercent to dedicate to playback cache (viewer cache's in-RAM portion) only
     KnobStringPtr _maxPlaybackLabel;
 
@@ -511,6 +518,11 @@ private:
     KnobIntPtr _maxRAMPercent;
     KnobStringPtr _maxRAMLabel;
 
+    ///The percentage of the system total's RAM in which images recycled by the node cache are kept compressed,
+    ///on top of _maxRAMPercent. 0 disables it.
+    KnobIntPtr _compressedRAMPercent;
+    KnobStringPtr _compressedRAMLabel;
+
     ///The percentage of the system total's RAM you want to keep free from cache usage
     ///When the cache grows and reaches a point where it is about to cross that threshold
     ///it starts freeing the LRU entries regardless of the _maxRAMPercent and _maxPlaybackPercent
@@ -0,0 +1,465 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * (C) 2018-2023 The Natron developers
+ * (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "TaskScheduler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <deque>
+#include <exception>
+#include <vector>
+
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include <QtCore/QWaitCondition>
+
+#include "Engine/AbortableRenderInfo.h"
+#include "Engine/EffectInstance.h"
+#include "Engine/ThreadPool.h"
+
+// The maximum number of worker threads of a TaskScheduler
+#define NATRON_TASK_SCHEDULER_MAX_THREADS 256
+
+NATRON_NAMESPACE_ENTER
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+/**
+ * @brief The tasks of one parallelFor() or start() call.
+ * The queues only hold references to the group: whichever thread gets hold of a reference runs the tasks of the
+ * group that were not claimed yet, one at a time. Once all tasks are claimed, the remaining references are no-ops.
+ **/
+struct TaskGroup
+{
+    std::function<void(int)> func;
+    int n;
+    std::atomic<int> nextIndex; //< the next task to claim
+    std::atomic<int> remaining; //< the number of tasks not finished yet
+    std::atomic<int> nStolen;
+    QThread* submitter;
+
+    // The abort info of the submitter, set on the workers while they run the tasks
+    bool hasAbortInfo;
+    bool isRenderResponseToUserInteraction;
+    AbortableRenderInfoPtr abortInfo;
+    EffectInstancePtr treeRoot;
+
+    QMutex doneMutex;
+    QWaitCondition doneCond;
+    std::exception_ptr exception; //< the first exception thrown by a task, protected by doneMutex
+
+    TaskGroup(const std::function<void(int)>& func,
+              int n)
+        : func(func)
+        , n(n)
+        , nextIndex(0)
+        , remaining(n)
+        , nStolen(0)
+        , submitter( QThread::currentThread() )
+        , hasAbortInfo(false)
+        , isRenderResponseToUserInteraction(false)
+        , abortInfo()
+        , treeRoot()
+        , doneMutex()
+        , doneCond()
+        , exception()
+    {
+    }
+
+    /**
+     * @brief Claims and runs tasks until there are no more, and returns the number of tasks run.
+     **/
+    int runTasks()
+    {
+        int nRun = 0;
+
+        for (;;) {
+            int i = nextIndex.fetch_add(1);
+            if (i >= n) {
+                break;
+            }
+            try {
+                func(i);
+            } catch (...) {
+                QMutexLocker k(&doneMutex);
+                if (!exception) {
+                    exception = std::current_exception();
+                }
+            }
+            ++nRun;
+            if (--remaining == 0) {
+                QMutexLocker k(&doneMutex);
+                doneCond.wakeAll();
+            }
+        }
+
+        return nRun;
+    }
+
+    void waitForDone()
+    {
+        QMutexLocker k(&doneMutex);
+
+        while (remaining > 0) {
+            doneCond.wait(&doneMutex);
+        }
+    }
+};
+
+typedef std::shared_ptr<TaskGroup> TaskGroupPtr;
+
+struct WorkerQueue
+{
+    QMutex lock;
+    std::deque<TaskGroupPtr> groups;
+};
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+
+class TaskSchedulerThread
+    : public QThread
+      , public AbortableThread
+{
+public:
+
+    TaskSchedulerThread(TaskSchedulerPrivate* scheduler,
+                        int index)
+        : QThread()
+        , AbortableThread(this)
+        , _scheduler(scheduler)
+        , _index(index)
+    {
+        setThreadName("Task Scheduler");
+    }
+
+    virtual ~TaskSchedulerThread()
+    {
+    }
+
+    TaskSchedulerPrivate* getScheduler() const
+    {
+        return _scheduler;
+    }
+
+    int getIndex() const
+    {
+        return _index;
+    }
+
+private:
+
+    virtual void run() OVERRIDE FINAL;
+
+    TaskSchedulerPrivate* _scheduler;
+    int _index;
+};
+
+struct TaskSchedulerPrivate
+{
+    // The queues of the workers. They are allocated once so that they can be accessed without locking workersMutex.
+    WorkerQueue workerQueues[NATRON_TASK_SCHEDULER_MAX_THREADS];
+
+    // The queue for the work submitted from threads that are not workers
+    WorkerQueue sharedQueue;
+
+    QMutex workersMutex;
+    std::vector<TaskSchedulerThread*> workers;
+    std::atomic<int> nWorkers;
+
+    std::atomic<int> queueDepth;
+    std::atomic<int> activeThreads;
+    std::atomic<U64> stealCount;
+
+    // Idle workers wait on workAvailable
+    QMutex sleepMutex;
+    QWaitCondition workAvailable;
+    bool quit; //< protected by sleepMutex
+
+    TaskSchedulerPrivate()
+        : sharedQueue()
+        , workersMutex()
+        , workers()
+        , nWorkers(0)
+        , queueDepth(0)
+        , activeThreads(0)
+        , stealCount(0)
+        , sleepMutex()
+        , workAvailable()
+        , quit(false)
+    {
+    }
+
+    static int getMaxThreads()
+    {
+        // The global thread pool maximum is set from the preferences
+        return std::max( 1, std::min(QThreadPool::globalInstance()->maxThreadCount(), NATRON_TASK_SCHEDULER_MAX_THREADS) );
+    }
+
+    // Returns the worker thread of this scheduler running the current thread, if any
+    TaskSchedulerThread* getCurrentWorker()
+    {
+        TaskSchedulerThread* worker = dynamic_cast<TaskSchedulerThread*>( QThread::currentThread() );
+
+        if ( worker && (worker->getScheduler() == this) ) {
+            return worker;
+        }
+
+        return 0;
+    }
+
+    void ensureWorkers(int nThreads)
+    {
+        if (nWorkers >= nThreads) {
+            return;
+        }
+        QMutexLocker k(&workersMutex);
+        while ( (int)workers.size() < nThreads ) {
+            TaskSchedulerThread* worker = new TaskSchedulerThread( this, (int)workers.size() );
+            workers.push_back(worker);
+            nWorkers = (int)workers.size();
+            worker->start();
+        }
+    }
+
+    void submit(const TaskGroupPtr& group,
+                int nReferences)
+    {
+        assert(nReferences > 0);
+        TaskSchedulerThread* worker = getCurrentWorker();
+        WorkerQueue& queue = worker ? workerQueues[worker->getIndex()] : sharedQueue;
+        {
+            QMutexLocker k(&queue.lock);
+            for (int i = 0; i < nReferences; ++i) {
+                queue.groups.push_back(group);
+            }
+        }
+        queueDepth += nReferences;
+
+        // Take the lock so that a worker checking queueDepth before sleeping does not miss the wake-up.
+        // Wake all workers: a worker above the maximum number of threads would not pick the work.
+        QMutexLocker k(&sleepMutex);
+        workAvailable.wakeAll();
+    }
+
+    // Pops from the back of the worker's own queue, then from the front of the shared queue, then steals
+    // from the front of the other workers' queues.
+    TaskGroupPtr takeGroup(int workerIndex)
+    {
+        TaskGroupPtr ret;
+        {
+            WorkerQueue& queue = workerQueues[workerIndex];
+            QMutexLocker k(&queue.lock);
+            if ( !queue.groups.empty() ) {
+                ret = queue.groups.back();
+                queue.groups.pop_back();
+            }
+        }
+        if (!ret) {
+            QMutexLocker k(&sharedQueue.lock);
+            if ( !sharedQueue.groups.empty() ) {
+                ret = sharedQueue.groups.front();
+                sharedQueue.groups.pop_front();
+            }
+        }
+        if (!ret) {
+            int n = nWorkers;
+            for (int i = 1; i < n && !ret; ++i) {
+                WorkerQueue& queue = workerQueues[(workerIndex + i) % n];
+                QMutexLocker k(&queue.lock);
+                if ( !queue.groups.empty() ) {
+                    ret = queue.groups.front();
+                    queue.groups.pop_front();
+                }
+            }
+        }
+        if (ret) {
+            --queueDepth;
+        }
+
+        return ret;
+    }
+
+    void runGroup(TaskSchedulerThread* worker,
+                  const TaskGroupPtr& group)
+    {
+        ++activeThreads;
+        if (group->hasAbortInfo) {
+            worker->setAbortInfo(group->isRenderResponseToUserInteraction, group->abortInfo, group->treeRoot);
+        }
+        int nRun = group->runTasks();
+        if (group->hasAbortInfo) {
+            worker->clearAbortInfo();
+        }
+        if ( (nRun > 0) && (group->submitter != worker) ) {
+            group->nStolen += nRun;
+            stealCount += nRun;
+        }
+        --activeThreads;
+    }
+
+    void workerLoop(TaskSchedulerThread* worker)
+    {
+        const int index = worker->getIndex();
+
+        for (;;) {
+            // Workers above the maximum number of threads (it may have been lowered in the preferences) stay idle
+            bool canWork = index < getMaxThreads();
+            if (canWork) {
+                TaskGroupPtr group = takeGroup(index);
+                if (group) {
+                    runGroup(worker, group);
+                    continue;
+                }
+            }
+
+            QMutexLocker k(&sleepMutex);
+            if (quit) {
+                if (queueDepth == 0) {
+                    return;
+                }
+                // finish the remaining work before quitting, whatever the maximum number of threads
+                if (!canWork) {
+                    k.unlock();
+                    TaskGroupPtr group = takeGroup(index);
+                    if (group) {
+                        runGroup(worker, group);
+                    }
+                }
+                continue;
+            }
+            if ( (queueDepth == 0) || !canWork ) {
+                workAvailable.wait(&sleepMutex);
+            }
+        }
+    }
+};
+
+void
+TaskSchedulerThread::run()
+{
+    _scheduler->workerLoop(this);
+}
+
+TaskScheduler::TaskScheduler()
+    : _imp( new TaskSchedulerPrivate() )
+{
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    {
+        QMutexLocker k(&_imp->sleepMutex);
+        _imp->quit = true;
+        _imp->workAvailable.wakeAll();
+    }
+    QMutexLocker k(&_imp->workersMutex);
+    for (std::size_t i = 0; i < _imp->workers.size(); ++i) {
+        _imp->workers[i]->wait();
+        delete _imp->workers[i];
+    }
+    _imp->workers.clear();
+}
+
+void
+TaskScheduler::parallelFor(int n,
+                           const std::function<void(int)>& func,
+                           TaskSchedulerStats* stats)
+{
+    if (n <= 0) {
+        return;
+    }
+
+    TaskGroupPtr group = std::make_shared<TaskGroup>(func, n);
+    AbortableThread* isAbortable = dynamic_cast<AbortableThread*>(group->submitter);
+    if (isAbortable) {
+        group->hasAbortInfo = isAbortable->getAbortInfo(&group->isRenderResponseToUserInteraction, &group->abortInfo, &group->treeRoot);
+    }
+
+    const int queueDepth = _imp->queueDepth;
+
+    // The calling thread runs tasks too: only ask for help from up to maxThreads - 1 workers
+    const int maxThreads = TaskSchedulerPrivate::getMaxThreads();
+    const int nReferences = std::min(n - 1, maxThreads - 1);
+    if (nReferences > 0) {
+        _imp->ensureWorkers(maxThreads);
+        _imp->submit(group, nReferences);
+    }
+
+    // Only run the tasks of this group: the other tasks may change the thread-local storage of this thread
+    group->runTasks();
+    group->waitForDone();
+
+    if (stats) {
+        stats->nTasks = n;
+        stats->nTasksStolen = group->nStolen;
+        stats->queueDepth = queueDepth;
+    }
+
+    if (group->exception) {
+        std::rethrow_exception(group->exception);
+    }
+}
+
+void
+TaskScheduler::start(const std::function<void()>& func)
+{
+    std::function<void(int)> task = [func](int) {
+        func();
+    };
+    TaskGroupPtr group = std::make_shared<TaskGroup>(task, 1);
+
+    // There is nobody to report the exception to, since nobody waits for the task
+    _imp->ensureWorkers( TaskSchedulerPrivate::getMaxThreads() );
+    _imp->submit(group, 1);
+}
+
+int
+TaskScheduler::getActiveThreadCount() const
+{
+    return _imp->activeThreads;
+}
+
+int
+TaskScheduler::getQueueDepth() const
+{
+    return _imp->queueDepth;
+}
+
+U64
+TaskScheduler::getStealCount() const
+{
+    return _imp->stealCount;
+}
+
+bool
+TaskScheduler::isWorkerThread()
+{
+    return dynamic_cast<TaskSchedulerThread*>( QThread::currentThread() ) != 0;
+}
+
+NATRON_NAMESPACE_EXIT
@@ -0,0 +1,133 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * (C) 2018-2023 The Natron developers
+ * (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef Natron_Engine_TaskScheduler_h
+#define Natron_Engine_TaskScheduler_h
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <functional>
+#include <memory>
+
+#include "Global/GlobalDefines.h"
+
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief Statistics about one parallelFor() call.
+ **/
+struct TaskSchedulerStats
+{
+    // The number of tasks, i.e the n passed to parallelFor()
+    int nTasks;
+
+    // The number of tasks that were run by another thread than the one that called parallelFor()
+    int nTasksStolen;
+
+    // The number of requests for a worker thread pending in the scheduler when parallelFor() was called
+    int queueDepth;
+
+    TaskSchedulerStats()
+        : nTasks(0)
+        , nTasksStolen(0)
+        , queueDepth(0)
+    {
+    }
+};
+
+/**
+ * @brief A work-stealing scheduler owned by Natron, shared by the host frame threading of renderRoI,
+ * the OpenFX multi-thread suite and the viewer current frame renders.
+ *
+ * Each worker thread has its own queue: work submitted from a worker is pushed on its own queue and popped
+ * in LIFO order, while idle workers steal from the other queues in FIFO order. Work submitted from any other
+ * thread goes into a shared queue.
+ *
+ * parallelFor() never blocks a thread doing nothing: the calling thread runs the tasks of its own call while
+ * waiting for the other threads, so that nested calls (e.g a tile render that renders its inputs with host frame
+ * threading) neither spawn more threads than the maximum number of threads of the application nor deadlock.
+ * The calling thread never runs tasks of unrelated calls, because tasks may copy the thread-local storage
+ * of the thread that submitted them.
+ *
+ * The worker threads are AbortableThread: the abort info of the thread calling parallelFor() is set on the
+ * worker for the duration of each task, so that EffectInstance::aborted() is accurate in the workers.
+ *
+ * The number of worker threads follows the maximum thread count of the global QThreadPool, which is
+ * set by the preferences.
+ **/
+struct TaskSchedulerPrivate;
+class TaskScheduler
+{
+public:
+
+    TaskScheduler();
+
+    /**
+     * @brief Runs all the tasks submitted with start() and waits for the worker threads to quit.
+     **/
+    ~TaskScheduler();
+
+    /**
+     * @brief Calls func(i) for each i in [0, n) using the calling thread and the worker threads, and returns once all
+     * calls have returned. The order of the calls is not specified.
+     * If stats is not NULL, it is filled with statistics about the call.
+     **/
+    void parallelFor(int n, const std::function<void(int)>& func, TaskSchedulerStats* stats = 0);
+
+    /**
+     * @brief Runs func on a worker thread and returns immediately.
+     **/
+    void start(const std::function<void()>& func);
+
+    /**
+     * @brief The number of worker threads currently running a task.
+     **/
+    int getActiveThreadCount() const;
+
+    /**
+     * @brief The number of requests for a worker thread currently pending.
+     **/
+    int getQueueDepth() const;
+
+    /**
+     * @brief The total number of tasks run by a thread other than the one that submitted them.
+     **/
+    U64 getStealCount() const;
+
+    /**
+     * @brief Returns true if the current thread is one of the worker threads of a TaskScheduler.
+     **/
+    static bool isWorkerThread();
+
+private:
+
+    std::unique_ptr<TaskSchedulerPrivate> _imp;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // Natron_Engine_TaskScheduler_h
@@ -2282,8 +2282,11 @@ TrackerContextPrivate::computeCornerParamsFromTracksEnd(double refTime,
 
     // Create temporary curves and clone the toPoint internal curves at once because setValueAtTime will be slow since it emits
     // signals to create keyframes in keyframeSet
+    // The keyframes are collected first and set at once: each addKeyFrame() publishes a copy of the whole curve.
     Curve tmpToPointsCurveX[4], tmpToPointsCurveY[4];
     Curve tmpFittingErrorCurve;
+    KeyFrameSet toPointsXKeys[4], toPointsYKeys[4];
+    KeyFrameSet fittingErrorKeys;
     bool mustShowFittingWarn = false;
     for (QList<CornerPinData>::const_iterator itResults = validResults.begin(); itResults != validResults.end(); ++itResults) {
         const CornerPinData& dataAtTime = *itResults;
@@ -2294,7 +2297,7 @@ TrackerContextPrivate::computeCornerParamsFromTracksEnd(double refTime,
             if (dataAtTime.rms >= maxFittingError) {
                 mustShowFittingWarn = true;
             }
-            tmpFittingErrorCurve.addKeyFrame(kf);
+            fittingErrorKeys.insert(kf);
         }
 
 
@@ -2304,8 +2307,8 @@ TrackerContextPrivate::computeCornerParamsFromTracksEnd(double refTime,
                 toPoint = applyHomography(refFrom.pts[c], dataAtTime.h);
                 KeyFrame kx(dataAtTime.time, toPoint.x);
                 KeyFrame ky(dataAtTime.time, toPoint.y);
-                tmpToPointsCurveX[c].addKeyFrame(kx);
-                tmpToPointsCurveY[c].addKeyFrame(ky);
+                toPointsXKeys[c].insert(kx);
+                toPointsYKeys[c].insert(ky);
                 //toPoints[c]->setValuesAtTime(dataAtTime[i].time, toPoint.x, toPoint.y, ViewSpec::all(), eValueChangedReasonNatronInternalEdited);
             }
         } else {
@@ -2316,14 +2319,20 @@ TrackerContextPrivate::computeCornerParamsFromTracksEnd(double refTime,
             for (int c = 0; c < 4; ++c) {
                 KeyFrame kx(dataAtTime.time, avgTos.pts[c].x);
                 KeyFrame ky(dataAtTime.time, avgTos.pts[c].y);
-                tmpToPointsCurveX[c].addKeyFrame(kx);
-                tmpToPointsCurveY[c].addKeyFrame(ky);
+                toPointsXKeys[c].insert(kx);
+                toPointsYKeys[c].insert(ky);
             }
 
 
         } // use jitter
 
     } // for each result
+
+    tmpFittingErrorCurve.setKeyframes(fittingErrorKeys, true);
+    for (int c = 0; c < 4; ++c) {
+        tmpToPointsCurveX[c].setKeyframes(toPointsXKeys[c], true);
+        tmpToPointsCurveY[c].setKeyframes(toPointsYKeys[c], true);
+    }
     
     
     
@@ -2498,7 +2507,9 @@ TrackerContextPrivate::computeTransformParamsFromTracksEnd(double refTime,
     animatedKnobsChanged.push_back(fittingErrorKnob);
 
 
+    // The keyframes are collected first and set at once: each addKeyFrame() publishes a copy of the whole curve.
     Curve tmpTXCurve, tmpTYCurve, tmpRotateCurve, tmpScaleCurve, tmpFittingErrorCurve;
+    KeyFrameSet txKeys, tyKeys, rotateKeys, scaleKeys, fittingErrorKeys;
     bool mustShowFittingWarn = false;
     for (QList<TransformData>::const_iterator itResults = validResults.begin(); itResults != validResults.end(); ++itResults) {
         const TransformData& dataAtTime = *itResults;
@@ -2507,7 +2518,7 @@ TrackerContextPrivate::computeTransformParamsFromTracksEnd(double refTime,
             if (dataAtTime.rms >= maxFittingError) {
                 mustShowFittingWarn = true;
             }
-            tmpFittingErrorCurve.addKeyFrame(kf);
+            fittingErrorKeys.insert(kf);
         }
         if (!dataAtTime.hasRotationAndScale) {
             // no rotation or scale: simply extract the translation
@@ -2524,8 +2535,8 @@ TrackerContextPrivate::computeTransformParamsFromTracksEnd(double refTime,
             {
                 KeyFrame kx(dataAtTime.time, translation.x);
                 KeyFrame ky(dataAtTime.time, translation.y);
-                tmpTXCurve.addKeyFrame(kx);
-                tmpTYCurve.addKeyFrame(ky);
+                txKeys.insert(kx);
+                tyKeys.insert(ky);
             }
         } else {
             double rot = 0;
@@ -2538,7 +2549,7 @@ TrackerContextPrivate::computeTransformParamsFromTracksEnd(double refTime,
             }
             {
                 KeyFrame k(dataAtTime.time, rot);
-                tmpRotateCurve.addKeyFrame(k);
+                rotateKeys.insert(k);
             }
             double scale;
             if (smoothSJitter > 1) {
@@ -2550,7 +2561,7 @@ TrackerContextPrivate::computeTransformParamsFromTracksEnd(double refTime,
             }
             {
                 KeyFrame k(dataAtTime.time, scale);
-                tmpScaleCurve.addKeyFrame(k);
+                scaleKeys.insert(k);
             }
             Point translation;
             if (smoothTJitter > 1) {
@@ -2567,12 +2578,18 @@ TrackerContextPrivate::computeTransformParamsFromTracksEnd(double refTime,
             {
                 KeyFrame kx(dataAtTime.time, translation.x);
                 KeyFrame ky(dataAtTime.time, translation.y);
-                tmpTXCurve.addKeyFrame(kx);
-                tmpTYCurve.addKeyFrame(ky);
+                txKeys.insert(kx);
+                tyKeys.insert(ky);
             }
         }
     } // for all samples
 
+    tmpFittingErrorCurve.setKeyframes(fittingErrorKeys, true);
+    tmpTXCurve.setKeyframes(txKeys, true);
+    tmpTYCurve.setKeyframes(tyKeys, true);
+    tmpRotateCurve.setKeyframes(rotateKeys, true);
+    tmpScaleCurve.setKeyframes(scaleKeys, true);
+
     fittingWarningKnob->setSecret(!mustShowFittingWarn);
     fittingErrorKnob->cloneCurve(ViewSpec::all(), 0, tmpFittingErrorCurve);
     translationKnob->cloneCurve(ViewSpec::all(), 0, tmpTXCurve);
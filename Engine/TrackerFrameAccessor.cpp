@@ -324,6 +324,34 @@ TrackerFrameAccessor::GetImage(int /*clip*/,
                 return (mv::FrameAccessor::Key)it->second.image.get();
             }
         }
+
+        /*
+           If the full scale image of the region was already fetched, downscale it instead of rendering the input again
+         */
+        if (mipmapLevel > 0) {
+            FrameAccessorCacheKey fullScaleKey = key;
+            fullScaleKey.mipmapLevel = 0;
+            const RectI fullScaleRoI = roi.upscalePowerOfTwo(mipmapLevel);
+            range = _imp->cache.equal_range(fullScaleKey);
+            for (FrameAccessorCache::iterator it = range.first; it != range.second; ++it) {
+                if ( !it->second.bounds.contains(fullScaleRoI) ) {
+                    continue;
+                }
+                FrameAccessorCacheEntry entry;
+                entry.image = std::make_shared<MvFloatImage>( roi.height(), roi.width() );
+                entry.bounds = roi;
+                entry.referenceCount = 1;
+                Image::downscaleMipmapPixels(eImageBitDepthFloat, 1, it->second.image->Data(), it->second.bounds, fullScaleRoI, mipmapLevel, entry.image->Data(), roi);
+                _imp->cache.insert( std::make_pair(key, entry) );
+                *destination = entry.image.get();
+#ifdef TRACE_LIB_MV
+                qDebug() << QThread::currentThread() << "FrameAccessor::GetImage():" << "Downscaled cached full scale image at frame" << frame << "with RoI x1="
+                         << roi.x1 << "y1=" << roi.y1 << "x2=" << roi.x2 << "y2=" << roi.y2;
+#endif
+
+                return (mv::FrameAccessor::Key)entry.image.get();
+            }
+        }
     }
 
     EffectInstancePtr effect;
@@ -30,6 +30,7 @@
 
 #include <string>
 #include <list>
+#include <vector>
 #include <cstddef>
 
 #include "Global/Enums.h"
@@ -102,6 +103,18 @@ public:
         }
     }
 
+    /**
+     * @brief Returns the rectangles to render in successive passes so that the tiles of the texture cache that are
+     * not rendered yet are filled in order of distance to the given focus point (in pixel coordinates).
+     * Each pass covers twice as many tiles as the previous one, so that the number of passes grows only
+     * logarithmically with the number of tiles. The last pass is the whole RoI.
+     **/
+    static void getTilesRenderPasses(const std::list<CachedTile>& tiles,
+                                     const RectI& roi,
+                                     double focusX,
+                                     double focusY,
+                                     std::vector<RectI>* passes);
+
     virtual std::size_t sizeInRAM() const OVERRIDE FINAL
     {
         std::size_t ret = 0;
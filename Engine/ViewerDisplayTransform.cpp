@@ -0,0 +1,364 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * (C) 2018-2023 The Natron developers
+ * (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "ViewerDisplayTransform.h"
+
+#include <algorithm> // min, max
+#include <cassert>
+#include <limits>
+
+#include "Engine/CPUFeatures.h"
+#include "Engine/Lut.h"
+
+// The vectorized implementations are compiled for their own target, so that they do not depend on the compiler flags,
+// and used if the CPU supports them, which is checked once.
+#if ( defined(__GNUC__) || defined(__clang__) ) && ( defined(__x86_64__) || defined(__i386__) )
+#define NATRON_VIEWER_DISPLAY_SIMD 1
+#include <immintrin.h>
+#define NATRON_SSE41_TARGET __attribute__( ( target("sse4.1") ) )
+#define NATRON_AVX2_TARGET __attribute__( ( target("avx2") ) )
+#endif
+
+NATRON_NAMESPACE_ENTER
+
+ViewerDisplayTransform::ViewerDisplayTransform(double gain,
+                                               double offset,
+                                               double gamma,
+                                               const float* gammaLut,
+                                               int gammaLutIntervals,
+                                               const Color::Lut* colorSpace)
+    : _gain( (float)gain )
+    , _offset( (float)offset )
+    , _gammaMode(eGammaModeIdentity)
+    , _gammaLut(gammaLut)
+    , _gammaLutIntervals(gammaLutIntervals)
+    , _colorSpaceTable(colorSpace ? colorSpace->getToColorSpaceUint8xxTable() : 0)
+{
+    if (gamma <= 0) {
+        _gammaMode = eGammaModeStep;
+    } else if (gamma != 1.) {
+        _gammaMode = eGammaModeLut;
+        assert(_gammaLut && _gammaLutIntervals > 0);
+    }
+}
+
+void
+ViewerDisplayTransform::apply(const float* src,
+                              std::size_t nPixels,
+                              U32* dst) const
+{
+    static const ImplementationEnum impl = getBestImplementation();
+
+    apply(impl, src, nPixels, dst);
+}
+
+void
+ViewerDisplayTransform::apply(ImplementationEnum impl,
+                              const float* src,
+                              std::size_t nPixels,
+                              U32* dst) const
+{
+    switch (impl) {
+    case eImplementationAVX2:
+        applyAVX2(src, nPixels, dst);
+        break;
+    case eImplementationSSE41:
+        applySSE41(src, nPixels, dst);
+        break;
+    case eImplementationScalar:
+        applyScalar(src, nPixels, dst);
+        break;
+    }
+}
+
+void
+ViewerDisplayTransform::applyScalar(const float* src,
+                                    std::size_t nPixels,
+                                    U32* dst) const
+{
+    const float n = (float)_gammaLutIntervals;
+
+    for (std::size_t p = 0; p < nPixels; ++p, src += 4) {
+        U32 texel = (U32)Color::floatToInt<256>(src[3]) << 24;
+        for (int c = 0; c < 3; ++c) {
+            float v = src[c] * _gain + _offset;
+            switch (_gammaMode) {
+            case eGammaModeIdentity:
+                break;
+            case eGammaModeStep:
+                v = (v < 1.f) ? 0.f : (v == 1.f ? 1.f : std::numeric_limits<float>::infinity() );
+                break;
+            case eGammaModeLut:
+                if ( !(v >= 0.f) ) {
+                    v = 0.f;
+                } else if (v > 1.f) {
+                    v = 1.f;
+                } else {
+                    // linear interpolation in the lut
+                    int i = (int)(v * n);
+                    float alpha = std::max( 0.f, std::min(v * n - i, 1.f) );
+                    float a = _gammaLut[i];
+                    float b = (i < _gammaLutIntervals) ? _gammaLut[i + 1] : 0.f;
+                    v = a * (1.f - alpha) + b * alpha;
+                }
+                break;
+            }
+            U32 u;
+            if (_colorSpaceTable) {
+                union
+                {
+                    float f;
+                    U32 i;
+                } bits;
+                bits.f = v;
+                u = Color::uint8xxToChar(_colorSpaceTable[bits.i >> 16]);
+            } else {
+                u = (U32)Color::floatToInt<256>(v);
+            }
+            // B is in the low byte, then G, R and A
+            texel |= u << (8 * (2 - c));
+        }
+        dst[p] = texel;
+    }
+}
+
+#ifdef NATRON_VIEWER_DISPLAY_SIMD
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+// Color::floatToInt<256>, for 8 values
+NATRON_AVX2_TARGET
+inline __m256i
+floatToInt256AVX2(__m256 v)
+{
+    __m256i ret = _mm256_cvttps_epi32( _mm256_add_ps( _mm256_mul_ps( v, _mm256_set1_ps(255.f) ), _mm256_set1_ps(0.5f) ) );
+
+    ret = _mm256_blendv_epi8( ret, _mm256_setzero_si256(), _mm256_castps_si256( _mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_LE_OQ) ) );
+    ret = _mm256_blendv_epi8( ret, _mm256_set1_epi32(255), _mm256_castps_si256( _mm256_cmp_ps(v, _mm256_set1_ps(1.f), _CMP_GE_OQ) ) );
+
+    return _mm256_and_si256( ret, _mm256_set1_epi32(0xff) );
+}
+
+NATRON_SSE41_TARGET
+inline __m128i
+floatToInt256SSE41(__m128 v)
+{
+    __m128i ret = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( v, _mm_set1_ps(255.f) ), _mm_set1_ps(0.5f) ) );
+
+    ret = _mm_blendv_epi8( ret, _mm_setzero_si128(), _mm_castps_si128( _mm_cmple_ps( v, _mm_setzero_ps() ) ) );
+    ret = _mm_blendv_epi8( ret, _mm_set1_epi32(255), _mm_castps_si128( _mm_cmpge_ps( v, _mm_set1_ps(1.f) ) ) );
+
+    return _mm_and_si128( ret, _mm_set1_epi32(0xff) );
+}
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+ViewerDisplayTransform::ImplementationEnum
+ViewerDisplayTransform::getBestImplementation()
+{
+    const CPUFeatures& cpu = getCPUFeatures();
+
+    if (cpu.avx2) {
+        return eImplementationAVX2;
+    } else if (cpu.sse41) {
+        return eImplementationSSE41;
+    }
+
+    return eImplementationScalar;
+}
+
+NATRON_AVX2_TARGET
+void
+ViewerDisplayTransform::applyAVX2(const float* src,
+                                  std::size_t nPixels,
+                                  U32* dst) const
+{
+    const __m256 gain = _mm256_set1_ps(_gain);
+    const __m256 offset = _mm256_set1_ps(_offset);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.f);
+    const __m256 n = _mm256_set1_ps( (float)_gammaLutIntervals );
+    const __m256i lastIndex = _mm256_set1_epi32(_gammaLutIntervals);
+    std::size_t p = 0;
+
+    for (; p + 8 <= nPixels; p += 8, src += 32) {
+        // Load pixels 0-3 in the low lanes and 4-7 in the high lanes, then transpose each lane
+        __m256 m0 = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps(src) ), _mm_loadu_ps(src + 16), 1 );
+        __m256 m1 = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps(src + 4) ), _mm_loadu_ps(src + 20), 1 );
+        __m256 m2 = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps(src + 8) ), _mm_loadu_ps(src + 24), 1 );
+        __m256 m3 = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps(src + 12) ), _mm_loadu_ps(src + 28), 1 );
+        __m256 t0 = _mm256_unpacklo_ps(m0, m1);
+        __m256 t1 = _mm256_unpacklo_ps(m2, m3);
+        __m256 t2 = _mm256_unpackhi_ps(m0, m1);
+        __m256 t3 = _mm256_unpackhi_ps(m2, m3);
+        __m256 rgb[3];
+        rgb[0] = _mm256_shuffle_ps( t0, t1, _MM_SHUFFLE(1, 0, 1, 0) );
+        rgb[1] = _mm256_shuffle_ps( t0, t1, _MM_SHUFFLE(3, 2, 3, 2) );
+        rgb[2] = _mm256_shuffle_ps( t2, t3, _MM_SHUFFLE(1, 0, 1, 0) );
+        __m256 alpha = _mm256_shuffle_ps( t2, t3, _MM_SHUFFLE(3, 2, 3, 2) );
+
+        __m256i texels = _mm256_slli_epi32(floatToInt256AVX2(alpha), 24);
+        for (int c = 0; c < 3; ++c) {
+            __m256 v = _mm256_add_ps(_mm256_mul_ps(rgb[c], gain), offset);
+            switch (_gammaMode) {
+            case eGammaModeIdentity:
+                break;
+            case eGammaModeStep: {
+                __m256 step = _mm256_blendv_ps( _mm256_set1_ps( std::numeric_limits<float>::infinity() ), one, _mm256_cmp_ps(v, one, _CMP_EQ_OQ) );
+                v = _mm256_blendv_ps( step, zero, _mm256_cmp_ps(v, one, _CMP_LT_OQ) );
+                break;
+            }
+            case eGammaModeLut: {
+                // max returns its second operand for NaN
+                __m256 clamped = _mm256_min_ps( _mm256_max_ps(v, zero), one );
+                __m256 x = _mm256_mul_ps(clamped, n);
+                __m256i i = _mm256_cvttps_epi32(x);
+                __m256 w = _mm256_min_ps( _mm256_max_ps( _mm256_sub_ps( x, _mm256_cvtepi32_ps(i) ), zero ), one );
+                __m256 a = _mm256_i32gather_ps(_gammaLut, i, 4);
+                __m256i notLast = _mm256_cmpgt_epi32(lastIndex, i);
+                __m256i next = _mm256_min_epi32( _mm256_add_epi32( i, _mm256_set1_epi32(1) ), lastIndex );
+                __m256 b = _mm256_and_ps( _mm256_i32gather_ps(_gammaLut, next, 4), _mm256_castsi256_ps(notLast) );
+                __m256 interp = _mm256_add_ps( _mm256_mul_ps( a, _mm256_sub_ps(one, w) ), _mm256_mul_ps(b, w) );
+                interp = _mm256_blendv_ps( interp, one, _mm256_cmp_ps(v, one, _CMP_GT_OQ) );
+                v = _mm256_blendv_ps( interp, zero, _mm256_cmp_ps(v, zero, _CMP_NGE_UQ) );
+                break;
+            }
+            }
+            __m256i u;
+            if (_colorSpaceTable) {
+                // Gather the 16-bit values as 32-bit words starting at an even index, so that we never read
+                // past the end of the table, and keep the high half for odd indices.
+                __m256i index = _mm256_srli_epi32(_mm256_castps_si256(v), 16);
+                __m256i even = _mm256_andnot_si256(_mm256_set1_epi32(1), index);
+                __m256i pair = _mm256_i32gather_epi32( (const int*)_colorSpaceTable, even, 2 );
+                __m256i shift = _mm256_slli_epi32(_mm256_and_si256( index, _mm256_set1_epi32(1) ), 4);
+                __m256i quantum = _mm256_and_si256( _mm256_srlv_epi32(pair, shift), _mm256_set1_epi32(0xffff) );
+                // Color::uint8xxToChar
+                u = _mm256_srli_epi32(_mm256_add_epi32( quantum, _mm256_set1_epi32(0x80) ), 8);
+            } else {
+                u = floatToInt256AVX2(v);
+            }
+            texels = _mm256_or_si256( texels, _mm256_sll_epi32( u, _mm_cvtsi32_si128( 8 * (2 - c) ) ) );
+        }
+        _mm256_storeu_si256( (__m256i*)(dst + p), texels );
+    }
+    applyScalar(src, nPixels - p, dst + p);
+} // applyAVX2
+
+NATRON_SSE41_TARGET
+void
+ViewerDisplayTransform::applySSE41(const float* src,
+                                   std::size_t nPixels,
+                                   U32* dst) const
+{
+    const __m128 gain = _mm_set1_ps(_gain);
+    const __m128 offset = _mm_set1_ps(_offset);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.f);
+    const __m128 n = _mm_set1_ps( (float)_gammaLutIntervals );
+    const __m128i lastIndex = _mm_set1_epi32(_gammaLutIntervals);
+    std::size_t p = 0;
+
+    for (; p + 4 <= nPixels; p += 4, src += 16) {
+        __m128 r = _mm_loadu_ps(src);
+        __m128 g = _mm_loadu_ps(src + 4);
+        __m128 b = _mm_loadu_ps(src + 8);
+        __m128 alpha = _mm_loadu_ps(src + 12);
+        _MM_TRANSPOSE4_PS(r, g, b, alpha);
+        __m128 rgb[3] = { r, g, b };
+
+        __m128i texels = _mm_slli_epi32(floatToInt256SSE41(alpha), 24);
+        for (int c = 0; c < 3; ++c) {
+            __m128 v = _mm_add_ps(_mm_mul_ps(rgb[c], gain), offset);
+            switch (_gammaMode) {
+            case eGammaModeIdentity:
+                break;
+            case eGammaModeStep: {
+                __m128 step = _mm_blendv_ps( _mm_set1_ps( std::numeric_limits<float>::infinity() ), one, _mm_cmpeq_ps(v, one) );
+                v = _mm_blendv_ps( step, zero, _mm_cmplt_ps(v, one) );
+                break;
+            }
+            case eGammaModeLut: {
+                __m128 clamped = _mm_min_ps( _mm_max_ps(v, zero), one );
+                __m128 x = _mm_mul_ps(clamped, n);
+                __m128i i = _mm_cvttps_epi32(x);
+                __m128 w = _mm_min_ps( _mm_max_ps( _mm_sub_ps( x, _mm_cvtepi32_ps(i) ), zero ), one );
+                __m128i notLast = _mm_cmpgt_epi32(lastIndex, i);
+                __m128i next = _mm_min_epi32( _mm_add_epi32( i, _mm_set1_epi32(1) ), lastIndex );
+                int idx[4], nextIdx[4];
+                _mm_storeu_si128( (__m128i*)idx, i );
+                _mm_storeu_si128( (__m128i*)nextIdx, next );
+                __m128 a = _mm_setr_ps(_gammaLut[idx[0]], _gammaLut[idx[1]], _gammaLut[idx[2]], _gammaLut[idx[3]]);
+                __m128 bb = _mm_and_ps( _mm_setr_ps(_gammaLut[nextIdx[0]], _gammaLut[nextIdx[1]], _gammaLut[nextIdx[2]], _gammaLut[nextIdx[3]]), _mm_castsi128_ps(notLast) );
+                __m128 interp = _mm_add_ps( _mm_mul_ps( a, _mm_sub_ps(one, w) ), _mm_mul_ps(bb, w) );
+                interp = _mm_blendv_ps( interp, one, _mm_cmpgt_ps(v, one) );
+                v = _mm_blendv_ps( interp, zero, _mm_cmpnge_ps(v, zero) );
+                break;
+            }
+            }
+            __m128i u;
+            if (_colorSpaceTable) {
+                U32 index[4];
+                _mm_storeu_si128( (__m128i*)index, _mm_srli_epi32(_mm_castps_si128(v), 16) );
+                __m128i quantum = _mm_setr_epi32(_colorSpaceTable[index[0]], _colorSpaceTable[index[1]], _colorSpaceTable[index[2]], _colorSpaceTable[index[3]]);
+                // Color::uint8xxToChar
+                u = _mm_srli_epi32(_mm_add_epi32( quantum, _mm_set1_epi32(0x80) ), 8);
+            } else {
+                u = floatToInt256SSE41(v);
+            }
+            texels = _mm_or_si128( texels, _mm_sll_epi32( u, _mm_cvtsi32_si128( 8 * (2 - c) ) ) );
+        }
+        _mm_storeu_si128( (__m128i*)(dst + p), texels );
+    }
+    applyScalar(src, nPixels - p, dst + p);
+} // applySSE41
+
+#else // !NATRON_VIEWER_DISPLAY_SIMD
+
+ViewerDisplayTransform::ImplementationEnum
+ViewerDisplayTransform::getBestImplementation()
+{
+    return eImplementationScalar;
+}
+
+void
+ViewerDisplayTransform::applyAVX2(const float* src,
+                                  std::size_t nPixels,
+                                  U32* dst) const
+{
+    applyScalar(src, nPixels, dst);
+}
+
+void
+ViewerDisplayTransform::applySSE41(const float* src,
+                                   std::size_t nPixels,
+                                   U32* dst) const
+{
+    applyScalar(src, nPixels, dst);
+}
+
+#endif // NATRON_VIEWER_DISPLAY_SIMD
+
+NATRON_NAMESPACE_EXIT
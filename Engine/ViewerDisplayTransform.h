@@ -0,0 +1,107 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * (C) 2018-2023 The Natron developers
+ * (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_VIEWERDISPLAYTRANSFORM_H
+#define NATRON_ENGINE_VIEWERDISPLAYTRANSFORM_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cstddef>
+
+#include "Global/GlobalDefines.h"
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief The display transform of 8bit viewers: converts linear RGBA float pixels to 8bit BGRA texels
+ * (GL_UNSIGNED_INT_8_8_8_8_REV) applying the gain and offset, the gamma and the output colorspace.
+ * Channel selection and the matte overlay are done beforehand, in linear, by the viewer.
+ *
+ * The conversion uses AVX2 or SSE4.1 when the CPU supports it, which is checked once. All implementations
+ * give the same result as applyScalar(), which is the reference, except that NaN colors may map to different
+ * values.
+ **/
+class ViewerDisplayTransform
+{
+public:
+
+    enum ImplementationEnum
+    {
+        eImplementationScalar = 0,
+        eImplementationSSE41,
+        eImplementationAVX2
+    };
+
+    /**
+     * @param gammaLut The gamma lookup table, containing gammaLutIntervals + 1 values sampling pow(x, 1/gamma)
+     * on [0,1]. It is only used if gamma is positive and not 1.
+     * @param colorSpace The output colorspace, or NULL to quantize linearly. It must be validated.
+     **/
+    ViewerDisplayTransform(double gain,
+                           double offset,
+                           double gamma,
+                           const float* gammaLut,
+                           int gammaLutIntervals,
+                           const Color::Lut* colorSpace);
+
+    /**
+     * @brief Converts nPixels RGBA pixels of src to dst with the fastest implementation available.
+     **/
+    void apply(const float* src, std::size_t nPixels, U32* dst) const;
+
+    /**
+     * @brief Converts with the given implementation, which must be supported by the CPU.
+     **/
+    void apply(ImplementationEnum impl, const float* src, std::size_t nPixels, U32* dst) const;
+
+    void applyScalar(const float* src, std::size_t nPixels, U32* dst) const;
+
+    /**
+     * @brief Returns the fastest implementation supported by this CPU.
+     **/
+    static ImplementationEnum getBestImplementation();
+
+private:
+
+    void applySSE41(const float* src, std::size_t nPixels, U32* dst) const;
+    void applyAVX2(const float* src, std::size_t nPixels, U32* dst) const;
+
+    float _gain;
+    float _offset;
+    enum GammaModeEnum
+    {
+        eGammaModeIdentity,
+        eGammaModeStep, // gamma <= 0: everything is zero, except gamma(1)=1
+        eGammaModeLut
+    } _gammaMode;
+    const float* _gammaLut;
+    int _gammaLutIntervals;
+    const unsigned short* _colorSpaceTable; // 2^16 values between 0 and 0xff00, indexed by the 16 high bits of the float
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_VIEWERDISPLAYTRANSFORM_H
@@ -45,6 +45,7 @@ CLANG_DIAG_ON(deprecated)
 #include "Engine/AppInstance.h"
 #include "Engine/AppManager.h"
 #include "Engine/Cache.h"
+#include "Engine/Half.h"
 #include "Engine/Image.h"
 #include "Engine/Log.h"
 #include "Engine/Lut.h"
@@ -60,10 +61,12 @@ CLANG_DIAG_ON(deprecated)
 #include "Engine/RotoPaint.h"
 #include "Engine/RotoStrokeItem.h"
 #include "Engine/Settings.h"
+#include "Engine/TaskScheduler.h"
 #include "Engine/TimeLine.h"
 #include "Engine/Timer.h"
 #include "Engine/UpdateViewerParams.h"
 #include "Engine/Utils.h"
+#include "Engine/ViewerDisplayTransform.h"
 #include "Engine/ViewIdx.h"
 
 #ifndef M_LN2
@@ -97,11 +100,6 @@ struct MinMaxVal {
 
 NATRON_NAMESPACE_ANONYMOUS_EXIT
 
-static void scaleToTexture8bits(const RectI& roi,
-                                const RenderViewerArgs & args,
-                                ViewerInstance* viewer,
-                                const UpdateViewerParams::CachedTile& tile,
-                                U32* output);
 static void scaleToTexture32bits(const RectI& roi,
                                  const RenderViewerArgs & args,
                                  const UpdateViewerParams::CachedTile& tile,
@@ -111,21 +109,18 @@ static MinMaxVal findAutoContrastVminVmax(const ImagePtr inputImage,
                                                          const RectI & rect);
 static void renderFunctor(const RectI& roi,
                           const RenderViewerArgs & args,
-                          ViewerInstance* viewer,
                           UpdateViewerParams::CachedTile tile);
 
 /**
- *@brief Actually converting to ARGB... but it is called BGRA by
-   the texture format GL_UNSIGNED_INT_8_8_8_8_REV
+ *@brief The texture cache does not depend on the display transform (gain, gamma and output colorspace):
+   32bit viewers cache linear float RGBA tiles and the GLSL shader applies the display transform,
+   8bit viewers cache linear half-float RGBA tiles and the display transform is applied on the CPU when uploading.
  **/
-static unsigned int toBGRA(unsigned char r, unsigned char g, unsigned char b, unsigned char a) WARN_UNUSED_RETURN;
-unsigned int
-toBGRA(unsigned char r,
-       unsigned char g,
-       unsigned char b,
-       unsigned char a)
+static ImageBitDepthEnum getTextureCacheBitDepth(ImageBitDepthEnum textureDepth) WARN_UNUSED_RETURN;
+ImageBitDepthEnum
+getTextureCacheBitDepth(ImageBitDepthEnum textureDepth)
 {
-    return (a << 24) | (r << 16) | (g << 8) | b;
+    return textureDepth == eImageBitDepthFloat ? eImageBitDepthFloat : eImageBitDepthHalf;
 }
 
 const Color::Lut*
@@ -172,6 +167,7 @@ ViewerInstance::ViewerInstance(NodePtr node)
 
     QObject::connect( this, SIGNAL(disconnectTextureRequest(int,bool)), this, SLOT(executeDisconnectTextureRequestOnMainThread(int,bool)) );
     QObject::connect( _imp.get(), SIGNAL(mustRedrawViewer()), this, SLOT(redrawViewer()) );
+    QObject::connect( _imp.get(), SIGNAL(mustUpdateRenderedTiles()), _imp.get(), SLOT(onRenderedTilesPosted()) );
     QObject::connect( this, SIGNAL(s_callRedrawOnMainThread()), this, SLOT(redrawViewer()) );
 }
 
@@ -937,6 +933,21 @@ ViewerInstance::setupMinimalUpdateViewerParams(const SequenceTime time,
         outArgs->isDoingPartialUpdates = _imp->isDoingPartialUpdates;
     }
 
+    // The tiles under the mouse cursor are rendered first, or those at the center of the viewport if the cursor
+    // is not over the viewer. The cursor can only be queried on the main thread.
+    {
+        RectD viewport = _imp->uiContext->getViewportRect();
+        outArgs->tilesFocus.x = (viewport.x1 + viewport.x2) / 2.;
+        outArgs->tilesFocus.y = (viewport.y1 + viewport.y2) / 2.;
+        if ( !isSequential && ( QThread::currentThread() == qApp->thread() ) ) {
+            Point cursor;
+            _imp->uiContext->getCursorPosition(cursor.x, cursor.y);
+            if ( viewport.contains(cursor.x, cursor.y) ) {
+                outArgs->tilesFocus = cursor;
+            }
+        }
+    }
+
     // Fill the gamma LUT if it has never been filled yet
     bool gammaLookupEmpty;
     {
@@ -1043,11 +1054,9 @@ ViewerInstance::getViewerRoIAndTexture(const RectD& rod,
             tile.rect.par = outArgs->params->pixelAspectRatio;
             tile.bytesCount = outArgs->params->tileSize * outArgs->params->tileSize * 4; // RGBA
             assert( outArgs->params->roi.contains(tile.rect) );
-            // If we are using floating point textures, multiply by size of float
+            // Cached tiles are either float or half-float, multiply by the size of the component
             assert(tile.bytesCount > 0);
-            if (outArgs->params->depth == eImageBitDepthFloat) {
-                tile.bytesCount *= sizeof(float);
-            }
+            tile.bytesCount *= getSizeOfForBitDepth( getTextureCacheBitDepth(outArgs->params->depth) );
             outArgs->params->tiles.push_back(tile);
         }
     }
@@ -1072,10 +1081,7 @@ ViewerInstance::getViewerRoIAndTexture(const RectD& rod,
             FrameKey key(getNode().get(),
                          outArgs->params->time,
                          viewerHash,
-                         outArgs->params->gain,
-                         outArgs->params->gamma,
-                         outArgs->params->lut,
-                         (int)outArgs->params->depth,
+                         (int)getTextureCacheBitDepth(outArgs->params->depth),
                          outArgs->channels,
                          outArgs->params->view,
                          it->rect,
@@ -1083,7 +1089,6 @@ ViewerInstance::getViewerRoIAndTexture(const RectD& rod,
                          inputToRenderName,
                          outArgs->params->layer,
                          outArgs->params->alphaLayer.getPlaneID() + outArgs->params->alphaChannelName,
-                         outArgs->params->depth == eImageBitDepthFloat,
                          isDraftMode);
             std::list<FrameEntryPtr> entries;
             bool hasTextureCached = appPTR->getTexture(key, &entries);
@@ -1139,6 +1144,38 @@ ViewerInstance::getViewerRoIAndTexture(const RectD& rod,
                 ++outArgs->params->nbCachedTile;
             }
         }
+
+        if (outArgs->params->isSequential) {
+            // During playback, read ahead the tiles of the next frames that are stored on disk, so that looking them up
+            // does not wait for their pages to be read. Their keys are predicted from the current frame.
+            RenderEnginePtr engine = getRenderEngine();
+            if (engine) {
+                std::vector<int> frames;
+                _imp->playbackPrefetchWindow[outArgs->params->textureIndex].getFramesToPrefetch(outArgs->params->time,
+                                                                                                 engine->getPlaybackDirection() == eRenderDirectionForward,
+                                                                                                 engine->getDesiredFPS(),
+                                                                                                 &frames);
+                std::list<FrameKey> keys;
+                for (std::list<UpdateViewerParams::CachedTile>::iterator it = outArgs->params->tiles.begin(); it != outArgs->params->tiles.end(); ++it) {
+                    const FrameKey tileKey(getNode().get(),
+                                           outArgs->params->time,
+                                           viewerHash,
+                                           (int)getTextureCacheBitDepth(outArgs->params->depth),
+                                           outArgs->channels,
+                                           outArgs->params->view,
+                                           it->rect,
+                                           mipmapLevel,
+                                           inputToRenderName,
+                                           outArgs->params->layer,
+                                           outArgs->params->alphaLayer.getPlaneID() + outArgs->params->alphaChannelName,
+                                           isDraftMode);
+                    for (std::vector<int>::iterator itFrame = frames.begin(); itFrame != frames.end(); ++itFrame) {
+                        keys.push_back( tileKey.getKeyAtTime(*itFrame) );
+                    }
+                }
+                appPTR->prefetchTextures(keys);
+            }
+        }
     }
 
 
@@ -1287,6 +1324,47 @@ ViewerInstance::getRenderViewerArgsAndCheckCache(SequenceTime time,
     return getRoDAndLookupCache(true, viewerHash, rotoPaintNode, stats, outArgs);
 }
 
+void
+UpdateViewerParams::getTilesRenderPasses(const std::list<CachedTile>& tiles,
+                                         const RectI& roi,
+                                         double focusX,
+                                         double focusY,
+                                         std::vector<RectI>* passes)
+{
+    std::vector<std::pair<double, RectI> > tilesToRender;
+    for (std::list<CachedTile>::const_iterator it = tiles.begin(); it != tiles.end(); ++it) {
+        if (it->isCached || it->ramBuffer) {
+            continue;
+        }
+        double dx = (it->rectRounded.x1 + it->rectRounded.x2) / 2. - focusX;
+        double dy = (it->rectRounded.y1 + it->rectRounded.y2) / 2. - focusY;
+        tilesToRender.push_back( std::make_pair(dx * dx + dy * dy, it->rectRounded) );
+    }
+    std::stable_sort( tilesToRender.begin(), tilesToRender.end(),
+                      [](const std::pair<double, RectI>& a, const std::pair<double, RectI>& b) {
+                          return a.first < b.first;
+                      } );
+
+    RectI passRect;
+    std::size_t passEnd = 1;
+    for (std::size_t i = 0; i + 1 < tilesToRender.size(); ++i) {
+        if (i == 0) {
+            passRect = tilesToRender[i].second;
+        } else {
+            passRect.merge(tilesToRender[i].second);
+        }
+        if (i + 1 == passEnd) {
+            RectI pass = passRect.intersect(roi);
+            if ( pass.isNull() || (pass == roi) ) {
+                break;
+            }
+            passes->push_back(pass);
+            passEnd *= 2;
+        }
+    }
+    passes->push_back(roi);
+}
+
 ViewerInstance::ViewerRenderRetCode
 ViewerInstance::renderViewer_internal(ViewIdx view,
                                       bool singleThreaded,
@@ -1457,10 +1535,20 @@ ViewerInstance::renderViewer_internal(ViewIdx view,
 
     EffectInstance::NotifyInputNRenderingStarted_RAII inputNIsRendering_RAII(getNode().get(), inArgs.activeInputIndex);
     std::vector<RectI> splitRoi;
+    // When filling the texture cache for the current frame, render the tiles around the cursor first and display
+    // them as soon as they are done instead of waiting for the whole RoI.
+    // Auto-contrast needs the vmin/vmax of the whole RoI: never stream the passes, each would get its own range.
+    const bool streamTiles = useTextureCache && !inArgs.autoContrast && !singleThreaded && !isSequentialRender;
     if (inArgs.isDoingPartialUpdates) {
         for (std::list<UpdateViewerParams::CachedTile>::iterator it = inArgs.params->tiles.begin(); it != inArgs.params->tiles.end(); ++it) {
             splitRoi.push_back(it->rect);
         }
+    } else if (streamTiles) {
+        const double scale = 1. / (1 << inArgs.params->mipmapLevel);
+        UpdateViewerParams::getTilesRenderPasses(inArgs.params->tiles, roi,
+                                                 inArgs.tilesFocus.x * scale / inArgs.params->pixelAspectRatio,
+                                                 inArgs.tilesFocus.y * scale,
+                                                 &splitRoi);
     } else {
         /*
            Just render 1 tile
@@ -1729,17 +1817,16 @@ ViewerInstance::renderViewer_internal(ViewIdx view,
             for (std::list<UpdateViewerParams::CachedTile>::iterator it = updateParams->tiles.begin(); it != updateParams->tiles.end(); ++it) {
                 if (it->isCached) {
                     assert(it->ramBuffer);
+                } else if ( it->ramBuffer || !splitRoi[rectIndex].contains(it->rect) ) {
+                    // The tile was filled by a previous pass or will be by a next one
+                    continue;
                 } else {
-                    assert(!it->ramBuffer);
 
 
                     FrameKey key(getNode().get(),
                                  inArgs.params->time,
                                  viewerHash,
-                                 inArgs.params->gain,
-                                 inArgs.params->gamma,
-                                 inArgs.params->lut,
-                                 (int)inArgs.params->depth,
+                                 (int)getTextureCacheBitDepth(inArgs.params->depth),
                                  inArgs.channels,
                                  inArgs.params->view,
                                  it->rect,
@@ -1747,7 +1834,6 @@ ViewerInstance::renderViewer_internal(ViewIdx view,
                                  inputToRenderName,
                                  inArgs.params->layer,
                                  inArgs.params->alphaLayer.getPlaneID() + inArgs.params->alphaChannelName,
-                                 inArgs.params->depth == eImageBitDepthFloat,
                                  inArgs.draftModeEnabled);
 
 
@@ -1807,9 +1893,11 @@ ViewerInstance::renderViewer_internal(ViewIdx view,
             viewerRenderTimeRecorder = std::make_shared<TimeLapse>();
         }
 
+        // The bitdepth of the buffers we render to: the texture cache only holds linear tiles
+        const ImageBitDepthEnum renderDepth = useTextureCache ? getTextureCacheBitDepth(updateParams->depth) : updateParams->depth;
         std::size_t tileRowElements = inArgs.params->tileSize;
         // Internally the buffer is interpreted as U32 when 8bit, so we do not multiply it by 4 for RGBA
-        if (updateParams->depth == eImageBitDepthFloat) {
+        if (renderDepth != eImageBitDepthByte) {
             tileRowElements *= 4;
         }
 
@@ -1833,25 +1921,26 @@ ViewerInstance::renderViewer_internal(ViewIdx view,
                                         alphaImage,
                                         inArgs.channels,
                                         updateParams->srcPremult,
-                                        updateParams->depth,
+                                        renderDepth,
                                         updateParams->gain,
                                         updateParams->gamma,
                                         updateParams->offset,
                                         lutFromColorspace(srcColorSpace),
                                         lutFromColorspace(updateParams->lut),
                                         alphaChannelIndex,
+                                        &_imp->gammaLookup.front(),
+                                        GAMMA_LUT_NB_VALUES,
                                         viewerRenderRoiOnly,
                                         tileRowElements);
             QReadLocker k(&_imp->gammaLookupMutex);
             for (std::list<UpdateViewerParams::CachedTile>::iterator it = unCachedTiles.begin(); it != unCachedTiles.end(); ++it) {
                 renderFunctor(viewerRenderRoI,
                               args,
-                              this,
                               *it);
             }
         } else {
             bool runInCurrentThread = QThreadPool::globalInstance()->activeThreadCount() >= QThreadPool::globalInstance()->maxThreadCount();
-            if ( !runInCurrentThread && (splitRoi.size() > 1) ) {
+            if ( !runInCurrentThread && inArgs.isDoingPartialUpdates && (splitRoi.size() > 1) ) {
                 runInCurrentThread = true;
             }
 
@@ -1900,13 +1989,15 @@ ViewerInstance::renderViewer_internal(ViewIdx view,
                                         alphaImage,
                                         inArgs.channels,
                                         updateParams->srcPremult,
-                                        updateParams->depth,
+                                        renderDepth,
                                         updateParams->gain,
                                         updateParams->gamma,
                                         updateParams->offset,
                                         lutFromColorspace(srcColorSpace),
                                         lutFromColorspace(updateParams->lut),
                                         alphaChannelIndex,
+                                        &_imp->gammaLookup.front(),
+                                        GAMMA_LUT_NB_VALUES,
                                         viewerRenderRoiOnly,
                                         tileRowElements);
 
@@ -1914,18 +2005,28 @@ ViewerInstance::renderViewer_internal(ViewIdx view,
                 QReadLocker k(&_imp->gammaLookupMutex);
                 for (std::list<UpdateViewerParams::CachedTile>::iterator it = unCachedTiles.begin(); it != unCachedTiles.end(); ++it) {
                     renderFunctor(viewerRenderRoI,
-                                  args, this, *it);
+                                  args, *it);
                 }
             } else {
                 QReadLocker k(&_imp->gammaLookupMutex);
                 QtConcurrent::map( unCachedTiles,
                                    [&](const UpdateViewerParams::CachedTile &tile) {
-                                    renderFunctor(viewerRenderRoI, args, this, tile);
+                                    renderFunctor(viewerRenderRoI, args, tile);
                                    } ).waitForFinished();
             }
 
             if (inArgs.isDoingPartialUpdates) {
                 partialUpdateObjects.push_back(updateParams);
+            } else if ( streamTiles && (rectIndex + 1 < splitRoi.size()) ) {
+                // Display the tiles filled so far while the next passes render
+                UpdateViewerParamsPtr renderedParams = std::make_shared<UpdateViewerParams>(*updateParams);
+                renderedParams->tiles.clear();
+                for (std::list<UpdateViewerParams::CachedTile>::const_iterator it = updateParams->tiles.begin(); it != updateParams->tiles.end(); ++it) {
+                    if (it->ramBuffer) {
+                        renderedParams->tiles.push_back(*it);
+                    }
+                }
+                _imp->postRenderedTiles(renderedParams);
             }
         } // if (singleThreaded)
 
@@ -1982,15 +2083,52 @@ ViewerInstance::updateViewer(UpdateViewerParamsPtr & frame)
 void
 renderFunctor(const RectI& roi,
               const RenderViewerArgs & args,
-              ViewerInstance* viewer,
               UpdateViewerParams::CachedTile tile)
 {
     if ( (args.bitDepth == eImageBitDepthFloat) ) {
         // image is stored as linear, the OpenGL shader with do gamma/sRGB/Rec709 decompression, as well as gain and offset
         scaleToTexture32bits(roi, args, tile, (float*)tile.ramBuffer);
+    } else if (args.bitDepth == eImageBitDepthHalf) {
+        // image is stored as linear half-float in the texture cache, the display transform is applied in updateViewer
+        const bool renderOnlyRoI = args.renderOnlyRoI;
+        if ( (renderOnlyRoI && !tile.rect.contains(roi)) || (!renderOnlyRoI && !roi.contains(tile.rect)) ) {
+            return;
+        }
+        std::vector<float> floatBuffer(tile.bytesCount / sizeof(Half));
+        scaleToTexture32bits(roi, args, tile, &floatBuffer.front());
+
+        // Only convert the portion that was written
+        const std::size_t dstRowElements = renderOnlyRoI ? tile.rect.width() * 4 : args.tileRowElements;
+        const RectI& written = renderOnlyRoI ? roi : tile.rect;
+        const std::size_t offset = renderOnlyRoI ?
+                                   (roi.y1 - tile.rect.y1) * dstRowElements + (roi.x1 - tile.rect.x1) * 4 :
+                                   (tile.rect.y1 - tile.rectRounded.y1) * dstRowElements + (tile.rect.x1 - tile.rectRounded.x1) * 4;
+        const float* src = &floatBuffer.front() + offset;
+        Half* dst = (Half*)tile.ramBuffer + offset;
+        for (int y = written.y1; y < written.y2; ++y, src += dstRowElements, dst += dstRowElements) {
+            convertFloatToHalf(src, dst, written.width() * 4);
+        }
     } else {
-        // texture is stored as sRGB/Rec709 compressed 8-bit RGBA
-        scaleToTexture8bits(roi, args, viewer, tile, (U32*)tile.ramBuffer);
+        // texture is stored as sRGB/Rec709 compressed 8-bit RGBA: render linear pixels by bands of rows
+        // and apply the display transform on them
+        assert(args.renderOnlyRoI);
+        if ( !tile.rect.contains(roi) || roi.isNull() ) {
+            return;
+        }
+        const ViewerDisplayTransform displayTransform(args.gain, args.offset, args.gamma, args.gammaLut, args.gammaLutIntervals, args.colorSpace);
+        const int width = roi.width();
+        const int bandHeight = std::max(1, 4096 / width);
+        std::vector<float> band( (std::size_t)width * bandHeight * 4 );
+        UpdateViewerParams::CachedTile bandTile = tile;
+        U32* dst_pixels = (U32*)tile.ramBuffer + (roi.y1 - tile.rect.y1) * tile.rect.width() + (roi.x1 - tile.rect.x1);
+        for (int y = roi.y1; y < roi.y2; y += bandHeight) {
+            const RectI bandRoI( roi.x1, y, roi.x2, std::min(y + bandHeight, roi.y2) );
+            bandTile.rect.set(bandRoI);
+            scaleToTexture32bits(bandRoI, args, bandTile, &band.front());
+            for (int row = 0; row < bandRoI.height(); ++row, dst_pixels += tile.rect.width()) {
+                displayTransform.apply(&band[(std::size_t)row * width * 4], width, dst_pixels);
+            }
+        }
     }
 }
 
@@ -2112,401 +2250,6 @@ findAutoContrastVminVmax(const ImagePtr inputImage,
     }
 } // findAutoContrastVminVmax
 
-template <typename PIX, int maxValue, bool opaque, bool applyMatte, int rOffset, int gOffset, int bOffset>
-void
-scaleToTexture8bits_generic(const RectI& roi,
-                            const RenderViewerArgs & args,
-                            int nComps,
-                            ViewerInstance* viewer,
-                            const UpdateViewerParams::CachedTile& tile,
-                            U32* tileBuffer)
-{
-    const size_t pixelSize = sizeof(PIX);
-    const bool luminance = (args.channels == eDisplayChannelsY);
-    Image::ReadAccess acc = Image::ReadAccess( args.inputImage.get() );
-    const RectI srcImgBounds = args.inputImage->getBounds();
-
-    if ( (args.renderOnlyRoI && !tile.rect.contains(roi)) || (!args.renderOnlyRoI && !roi.contains(tile.rect)) ) {
-        return;
-    }
-    assert(tile.rect.x2 > tile.rect.x1);
-
-    int dstRowElements;
-    U32* dst_pixels;
-    if (args.renderOnlyRoI) {
-        dstRowElements = tile.rect.width();
-        dst_pixels = tileBuffer + (roi.y1 - tile.rect.y1) * dstRowElements + (roi.x1 - tile.rect.x1);
-    } else {
-        dstRowElements = args.tileRowElements;
-        dst_pixels = tileBuffer + (tile.rect.y1 - tile.rectRounded.y1) * args.tileRowElements + (tile.rect.x1 - tile.rectRounded.x1);
-    }
-
-    const int y1 = args.renderOnlyRoI ? roi.y1 : tile.rect.y1;
-    const int y2 = args.renderOnlyRoI ? roi.y2 : tile.rect.y2;
-    const int x1 = args.renderOnlyRoI ? roi.x1 : tile.rect.x1;
-    const int x2 = args.renderOnlyRoI ? roi.x2 : tile.rect.x2;
-    const PIX* src_pixels = (const PIX*)acc.pixelAt(x1, y1);
-    const int srcRowElements = (int)args.inputImage->getRowElements();
-    Image::ReadAccessPtr matteAcc;
-    if (applyMatte) {
-        matteAcc = std::make_shared<Image::ReadAccess>( args.matteImage.get() );
-    }
-
-    for (int y = y1; y < y2;
-         ++y,
-         dst_pixels += dstRowElements) {
-        // coverity[dont_call]
-        int start = (int)( rand() % (x2 - x1) );
-
-
-        for (int backward = 0; backward < 2; ++backward) {
-            int index = backward ? start - 1 : start;
-
-            assert( backward == 1 || ( index >= 0 && index < (x2 - x1) ) );
-
-            unsigned error_r = 0x80;
-            unsigned error_g = 0x80;
-            unsigned error_b = 0x80;
-
-            while (index < (x2 - x1) && index >= 0) {
-                double r = 0.;
-                double g = 0.;
-                double b = 0.;
-                int uA = 0;
-                double a = 0;
-                if (nComps >= 4) {
-                    r = (src_pixels ? src_pixels[index * nComps + rOffset] : 0.);
-                    g = (src_pixels ? src_pixels[index * nComps + gOffset] : 0.);
-                    b = (src_pixels ? src_pixels[index * nComps + bOffset] : 0.);
-                    if (opaque) {
-                        a = 1;
-                        uA = 255;
-                    } else {
-                        a = src_pixels ? src_pixels[index * nComps + 3] : 0;
-                        uA = Color::floatToInt<256>(a);
-                    }
-                } else if (nComps == 3) {
-                    // coverity[dead_error_line]
-                    r = (src_pixels && rOffset < nComps) ? src_pixels[index * nComps + rOffset] : 0.;
-                    // coverity[dead_error_line]
-                    g = (src_pixels && gOffset < nComps) ? src_pixels[index * nComps + gOffset] : 0.;
-                    // coverity[dead_error_line]
-                    b = (src_pixels && bOffset < nComps) ? src_pixels[index * nComps + bOffset] : 0.;
-                    a = (src_pixels ? 1 : 0);
-                    uA = a * 255;
-                } else if (nComps == 2) {
-                    // coverity[dead_error_line]
-                    r = (src_pixels && rOffset < nComps) ? src_pixels[index * nComps + rOffset] : 0.;
-                    // coverity[dead_error_line]
-                    g = (src_pixels && gOffset < nComps) ? src_pixels[index * nComps + gOffset] : 0.;
-                    b = 0;
-                    a = (src_pixels ? 1 : 0);
-                    uA = a * 255;
-                } else if (nComps == 1) {
-                    // coverity[dead_error_line]
-                    r = (src_pixels && rOffset < nComps) ? src_pixels[index * nComps + rOffset] : 0.;
-                    g = b = r;
-                    a = (src_pixels ? 1 : 0);
-                    uA = a * 255;
-                } else {
-                    assert(false);
-                }
-
-
-                switch (pixelSize) {
-                case sizeof(unsigned char):     //byte
-                    if (args.srcColorSpace) {
-                        r = args.srcColorSpace->fromColorSpaceUint8ToLinearFloatFast( (unsigned char)r );
-                        g = args.srcColorSpace->fromColorSpaceUint8ToLinearFloatFast( (unsigned char)g );
-                        b = args.srcColorSpace->fromColorSpaceUint8ToLinearFloatFast( (unsigned char)b );
-                    } else {
-                        r = (double)Image::convertPixelDepth<unsigned char, float>( (unsigned char)r );
-                        g = (double)Image::convertPixelDepth<unsigned char, float>( (unsigned char)g );
-                        b = (double)Image::convertPixelDepth<unsigned char, float>( (unsigned char)b );
-                    }
-                    break;
-                case sizeof(unsigned short):     //short
-                    if (args.srcColorSpace) {
-                        r = args.srcColorSpace->fromColorSpaceUint16ToLinearFloatFast( (unsigned short)r );
-                        g = args.srcColorSpace->fromColorSpaceUint16ToLinearFloatFast( (unsigned short)g );
-                        b = args.srcColorSpace->fromColorSpaceUint16ToLinearFloatFast( (unsigned short)b );
-                    } else {
-                        r = (double)Image::convertPixelDepth<unsigned short, float>( (unsigned char)r );
-                        g = (double)Image::convertPixelDepth<unsigned short, float>( (unsigned char)g );
-                        b = (double)Image::convertPixelDepth<unsigned short, float>( (unsigned char)b );
-                    }
-                    break;
-                case sizeof(float):     //float
-                    if (args.srcColorSpace) {
-                        r = args.srcColorSpace->fromColorSpaceFloatToLinearFloat(r);
-                        g = args.srcColorSpace->fromColorSpaceFloatToLinearFloat(g);
-                        b = args.srcColorSpace->fromColorSpaceFloatToLinearFloat(b);
-                    }
-                    break;
-                default:
-                    break;
-                }
-
-                r = r * args.gain + args.offset;
-                g = g * args.gain + args.offset;
-                b = b * args.gain + args.offset;
-                if  (args.gamma <= 0) {
-                    r = (r < 1.) ? 0. : (r == 1. ? 1. : std::numeric_limits<double>::infinity() );
-                    g = (g < 1.) ? 0. : (g == 1. ? 1. : std::numeric_limits<double>::infinity() );
-                    b = (b < 1.) ? 0. : (b == 1. ? 1. : std::numeric_limits<double>::infinity() );
-                } else if (args.gamma != 1.) {
-                    r = viewer->interpolateGammaLut(r);
-                    g = viewer->interpolateGammaLut(g);
-                    b = viewer->interpolateGammaLut(b);
-                }
-
-
-                if (luminance) {
-                    r = 0.299 * r + 0.587 * g + 0.114 * b;
-                    g = r;
-                    b = r;
-                }
-
-
-                U8 uR, uG, uB;
-                if (!args.colorSpace) {
-                    uR = Color::floatToInt<256>(r);
-                    uG = Color::floatToInt<256>(g);
-                    uB = Color::floatToInt<256>(b);
-                } else {
-                    error_r = (error_r & 0xff) + args.colorSpace->toColorSpaceUint8xxFromLinearFloatFast(r);
-                    error_g = (error_g & 0xff) + args.colorSpace->toColorSpaceUint8xxFromLinearFloatFast(g);
-                    error_b = (error_b & 0xff) + args.colorSpace->toColorSpaceUint8xxFromLinearFloatFast(b);
-                    assert(error_r < 0x10000 && error_g < 0x10000 && error_b < 0x10000);
-                    uR = (U8)(error_r >> 8);
-                    uG = (U8)(error_g >> 8);
-                    uB = (U8)(error_b >> 8);
-                }
-
-                if (applyMatte) {
-                    double alphaMatteValue = 0;
-                    if (args.matteImage == args.inputImage) {
-                        switch (args.alphaChannelIndex) {
-                        case 0:
-                            alphaMatteValue = r;
-                            break;
-                        case 1:
-                            alphaMatteValue = g;
-                            break;
-                        case 2:
-                            alphaMatteValue = b;
-                            break;
-                        case 3:
-                            alphaMatteValue = a;
-                            break;
-                        default:
-                            break;
-                        }
-                    } else {
-                        const PIX* src_pixels = (const PIX*)matteAcc->pixelAt(x1 + index, y);
-                        if (src_pixels) {
-                            alphaMatteValue = (double)src_pixels[args.alphaChannelIndex];
-                            switch (pixelSize) {
-                            case sizeof(unsigned char):     //byte
-                                alphaMatteValue = (double)Image::convertPixelDepth<unsigned char, float>( (unsigned char)r );
-                                break;
-                            case sizeof(unsigned short):     //short
-                                alphaMatteValue = (double)Image::convertPixelDepth<unsigned short, float>( (unsigned short)r );
-                                break;
-                            default:
-                                break;
-                            }
-                        }
-                    }
-                    U8 matteA;
-                    if (args.colorSpace) {
-                        matteA = args.colorSpace->toColorSpaceUint8FromLinearFloatFast(alphaMatteValue) / 2;
-                    } else {
-                        matteA = Color::floatToInt<256>(alphaMatteValue) / 2;
-                    }
-                    uR = Image::clampIfInt<U8>( (double)uR + matteA );
-                }
-
-                dst_pixels[index] = toBGRA(uR, uG, uB, uA);
-
-                if (backward) {
-                    --index;
-                } else {
-                    ++index;
-                }
-            } // while (index < args.texRect.w && index >= 0) {
-        } // for (int backward = 0; backward < 2; ++backward) {
-        if (src_pixels) {
-            src_pixels += srcRowElements;
-        }
-    } // for (int y = yRange.first; y < yRange.second;
-} // scaleToTexture8bits_generic
-
-template <typename PIX, int maxValue, int nComps, bool opaque, bool matteOverlay, int rOffset, int gOffset, int bOffset>
-void
-scaleToTexture8bits_internal(const RectI& roi,
-                             const RenderViewerArgs & args,
-                             ViewerInstance* viewer,
-                             const UpdateViewerParams::CachedTile& tile,
-                             U32* output)
-{
-    scaleToTexture8bits_generic<PIX, maxValue, opaque, matteOverlay, rOffset, gOffset, bOffset>(roi, args, nComps, viewer, tile, output);
-}
-
-template <typename PIX, int maxValue, int nComps, bool opaque, int rOffset, int gOffset, int bOffset>
-void
-scaleToTexture8bitsForMatte(const RectI& roi,
-                            const RenderViewerArgs & args,
-                            ViewerInstance* viewer,
-                            const UpdateViewerParams::CachedTile& tile,
-                            U32* output)
-{
-    bool applyMate = args.matteImage.get() && args.alphaChannelIndex >= 0;
-
-    if (applyMate) {
-        scaleToTexture8bits_internal<PIX, maxValue, nComps, opaque, true, rOffset, gOffset, bOffset>(roi, args, viewer, tile, output);
-    } else {
-        scaleToTexture8bits_internal<PIX, maxValue, nComps, opaque, false, rOffset, gOffset, bOffset>(roi, args, viewer, tile, output);
-    }
-}
-
-template <typename PIX, int maxValue, bool opaque, int rOffset, int gOffset, int bOffset>
-void
-scaleToTexture8bitsForDepthForComponents(const RectI& roi,
-                                         const RenderViewerArgs & args,
-                                         ViewerInstance* viewer,
-                                         const UpdateViewerParams::CachedTile& tile,
-                                         U32* output)
-{
-    int nComps = args.inputImage->getComponents().getNumComponents();
-
-    switch (nComps) {
-    case 4:
-        scaleToTexture8bitsForMatte<PIX, maxValue, 4, opaque, rOffset, gOffset, bOffset>(roi, args, viewer, tile, output);
-        break;
-    case 3:
-        scaleToTexture8bitsForMatte<PIX, maxValue, 3, opaque, rOffset, gOffset, bOffset>(roi, args, viewer, tile, output);
-        break;
-    case 2:
-        scaleToTexture8bitsForMatte<PIX, maxValue, 2, opaque, rOffset, gOffset, bOffset>(roi, args, viewer, tile, output);
-        break;
-    case 1:
-        scaleToTexture8bitsForMatte<PIX, maxValue, 1, opaque, rOffset, gOffset, bOffset>(roi, args, viewer, tile, output);
-        break;
-    default:
-        bool applyMate = args.matteImage.get() && args.alphaChannelIndex >= 0;
-        if (applyMate) {
-            scaleToTexture8bits_generic<PIX, maxValue, opaque, true, rOffset, gOffset, bOffset>(roi, args, nComps, viewer, tile, output);
-        } else {
-            scaleToTexture8bits_generic<PIX, maxValue, opaque, false, rOffset, gOffset, bOffset>(roi, args, nComps, viewer, tile, output);
-        }
-        break;
-    }
-}
-
-template <typename PIX, int maxValue, bool opaque>
-void
-scaleToTexture8bitsForPremult(const RectI& roi,
-                              const RenderViewerArgs & args,
-                              ViewerInstance* viewer,
-                              const UpdateViewerParams::CachedTile& tile,
-                              U32* output)
-{
-    switch (args.channels) {
-    case eDisplayChannelsRGB:
-    case eDisplayChannelsY:
-    case eDisplayChannelsMatte:
-
-        scaleToTexture8bitsForDepthForComponents<PIX, maxValue, opaque, 0, 1, 2>(roi, args, viewer, tile, output);
-        break;
-    case eDisplayChannelsG:
-        scaleToTexture8bitsForDepthForComponents<PIX, maxValue, opaque, 1, 1, 1>(roi, args, viewer, tile, output);
-        break;
-    case eDisplayChannelsB:
-        scaleToTexture8bitsForDepthForComponents<PIX, maxValue, opaque, 2, 2, 2>(roi, args, viewer, tile, output);
-        break;
-    case eDisplayChannelsA:
-        switch (args.alphaChannelIndex) {
-        case -1:
-            scaleToTexture8bitsForDepthForComponents<PIX, maxValue, opaque, 3, 3, 3>(roi, args, viewer, tile, output);
-            break;
-        case 0:
-            scaleToTexture8bitsForDepthForComponents<PIX, maxValue, opaque, 0, 0, 0>(roi, args, viewer, tile, output);
-            break;
-        case 1:
-            scaleToTexture8bitsForDepthForComponents<PIX, maxValue, opaque, 1, 1, 1>(roi, args, viewer, tile, output);
-            break;
-        case 2:
-            scaleToTexture8bitsForDepthForComponents<PIX, maxValue, opaque, 2, 2, 2>(roi, args, viewer, tile, output);
-            break;
-        case 3:
-            scaleToTexture8bitsForDepthForComponents<PIX, maxValue, opaque, 3, 3, 3>(roi, args, viewer, tile, output);
-            break;
-        default:
-            scaleToTexture8bitsForDepthForComponents<PIX, maxValue, opaque, 3, 3, 3>(roi, args, viewer, tile, output);
-        }
-
-        break;
-    case eDisplayChannelsR:
-    default:
-        scaleToTexture8bitsForDepthForComponents<PIX, maxValue, opaque, 0, 0, 0>(roi, args, viewer, tile, output);
-
-        break;
-    }
-}
-
-template <typename PIX, int maxValue>
-void
-scaleToTexture8bitsForDepth(const RectI& roi,
-                            const RenderViewerArgs & args,
-                            ViewerInstance* viewer,
-                            const UpdateViewerParams::CachedTile& tile,
-                            U32* output)
-{
-    switch (args.srcPremult) {
-    case eImagePremultiplicationOpaque:
-        scaleToTexture8bitsForPremult<PIX, maxValue, true>(roi, args, viewer, tile, output);
-        break;
-    case eImagePremultiplicationPremultiplied:
-    case eImagePremultiplicationUnPremultiplied:
-    default:
-        scaleToTexture8bitsForPremult<PIX, maxValue, false>(roi, args, viewer, tile, output);
-        break;
-    }
-}
-
-void
-scaleToTexture8bits(const RectI& roi,
-                    const RenderViewerArgs & args,
-                    ViewerInstance* viewer,
-                    const UpdateViewerParams::CachedTile& tile,
-                    U32* output)
-{
-    assert(output);
-    switch ( args.inputImage->getBitDepth() ) {
-    case eImageBitDepthFloat:
-        scaleToTexture8bitsForDepth<float, 1>(roi, args, viewer, tile, output);
-        break;
-    case eImageBitDepthByte:
-        scaleToTexture8bitsForDepth<unsigned char, 255>(roi, args, viewer, tile, output);
-        break;
-    case eImageBitDepthShort:
-        scaleToTexture8bitsForDepth<unsigned short, 65535>(roi, args, viewer, tile, output);
-        break;
-    case eImageBitDepthHalf:
-        assert(false);
-        break;
-    case eImageBitDepthNone:
-        break;
-    }
-} // scaleToTexture8bits
-
-float
-ViewerInstance::interpolateGammaLut(float value)
-{
-    return _imp->lookupGammaLut(value);
-}
-
 void
 ViewerInstance::markAllOnGoingRendersAsAborted(bool keepOldestRender)
 {
@@ -2539,7 +2282,6 @@ scaleToTexture32bitsGeneric(const RectI& roi,
                             const UpdateViewerParams::CachedTile& tile,
                             float *tileBuffer)
 {
-    const size_t pixelSize = sizeof(PIX);
     const bool luminance = (args.channels == eDisplayChannelsY);
     const int dstRowElements = args.renderOnlyRoI ? tile.rect.width() * 4 : args.tileRowElements;
     Image::ReadAccess acc = Image::ReadAccess( args.inputImage.get() );
@@ -2563,7 +2305,7 @@ scaleToTexture32bitsGeneric(const RectI& roi,
     const int y2 = args.renderOnlyRoI ? roi.y2 : tile.rect.y2;
     const int x1 = args.renderOnlyRoI ? roi.x1 : tile.rect.x1;
     const int x2 = args.renderOnlyRoI ? roi.x2 : tile.rect.x2;
-    const float* src_pixels = (const float*)acc.pixelAt(x1, y1);
+    const PIX* src_pixels = (const PIX*)acc.pixelAt(x1, y1);
     const int srcRowElements = (const int)args.inputImage->getRowElements();
 
     for (int y = y1; y < y2;
@@ -2577,32 +2319,32 @@ scaleToTexture32bitsGeneric(const RectI& roi,
             double a = 0.;
 
             if (nComps >= 4) {
-                r = (src_pixels && rOffset < nComps) ? src_pixels[x * nComps + rOffset] : 0.;
-                g = (src_pixels && gOffset < nComps) ? src_pixels[x * nComps + gOffset] : 0.;
-                b = (src_pixels && bOffset < nComps) ? src_pixels[x * nComps + bOffset] : 0.;
+                r = (src_pixels && rOffset < nComps) ? (double)src_pixels[x * nComps + rOffset] : 0.;
+                g = (src_pixels && gOffset < nComps) ? (double)src_pixels[x * nComps + gOffset] : 0.;
+                b = (src_pixels && bOffset < nComps) ? (double)src_pixels[x * nComps + bOffset] : 0.;
                 if (opaque) {
                     a = 1.;
                 } else {
-                    a = src_pixels ? src_pixels[x * nComps + 3] : 0.;
+                    a = src_pixels ? (double)src_pixels[x * nComps + 3] / maxValue : 0.;
                 }
             } else if (nComps == 3) {
                 // coverity[dead_error_line]
-                r = (src_pixels && rOffset < nComps) ? src_pixels[x * nComps + rOffset] : 0.;
+                r = (src_pixels && rOffset < nComps) ? (double)src_pixels[x * nComps + rOffset] : 0.;
                 // coverity[dead_error_line]
-                g = (src_pixels && gOffset < nComps) ? src_pixels[x * nComps + gOffset] : 0.;
+                g = (src_pixels && gOffset < nComps) ? (double)src_pixels[x * nComps + gOffset] : 0.;
                 // coverity[dead_error_line]
-                b = (src_pixels && bOffset < nComps) ? src_pixels[x * nComps + bOffset] : 0.;
+                b = (src_pixels && bOffset < nComps) ? (double)src_pixels[x * nComps + bOffset] : 0.;
                 a = 1.;
             } else if (nComps == 2) {
                 // coverity[dead_error_line]
-                r = (src_pixels && rOffset < nComps) ? src_pixels[x * nComps + rOffset] : 0.;
+                r = (src_pixels && rOffset < nComps) ? (double)src_pixels[x * nComps + rOffset] : 0.;
                 // coverity[dead_error_line]
-                g = (src_pixels && gOffset < nComps) ? src_pixels[x * nComps + gOffset] : 0.;
+                g = (src_pixels && gOffset < nComps) ? (double)src_pixels[x * nComps + gOffset] : 0.;
                 b = 0.;
                 a = 1.;
             } else if (nComps == 1) {
                 // coverity[dead_error_line]
-                r = (src_pixels && rOffset < nComps) ? src_pixels[x * nComps + rOffset] : 0.;
+                r = (src_pixels && rOffset < nComps) ? (double)src_pixels[x * nComps + rOffset] : 0.;
                 g = b = r;
                 a = 1.;
             } else {
@@ -2610,8 +2352,8 @@ scaleToTexture32bitsGeneric(const RectI& roi,
             }
 
 
-            switch (pixelSize) {
-            case sizeof(unsigned char):
+            switch (maxValue) {
+            case 255:
                 if (args.srcColorSpace) {
                     r = args.srcColorSpace->fromColorSpaceUint8ToLinearFloatFast( (unsigned char)r );
                     g = args.srcColorSpace->fromColorSpaceUint8ToLinearFloatFast( (unsigned char)g );
@@ -2622,29 +2364,30 @@ scaleToTexture32bitsGeneric(const RectI& roi,
                     b = (double)Image::convertPixelDepth<unsigned char, float>( (unsigned char)b );
                 }
                 break;
-            case sizeof(unsigned short):
+            case 65535:
                 if (args.srcColorSpace) {
                     r = args.srcColorSpace->fromColorSpaceUint16ToLinearFloatFast( (unsigned short)r );
                     g = args.srcColorSpace->fromColorSpaceUint16ToLinearFloatFast( (unsigned short)g );
                     b = args.srcColorSpace->fromColorSpaceUint16ToLinearFloatFast( (unsigned short)b );
                 } else {
-                    r = (double)Image::convertPixelDepth<unsigned short, float>( (unsigned char)r );
-                    g = (double)Image::convertPixelDepth<unsigned short, float>( (unsigned char)g );
-                    b = (double)Image::convertPixelDepth<unsigned short, float>( (unsigned char)b );
+                    r = (double)Image::convertPixelDepth<unsigned short, float>( (unsigned short)r );
+                    g = (double)Image::convertPixelDepth<unsigned short, float>( (unsigned short)g );
+                    b = (double)Image::convertPixelDepth<unsigned short, float>( (unsigned short)b );
                 }
                 break;
-            case sizeof(float):
+            default: // float and half
                 if (args.srcColorSpace) {
                     r = args.srcColorSpace->fromColorSpaceFloatToLinearFloat(r);
                     g = args.srcColorSpace->fromColorSpaceFloatToLinearFloat(g);
                     b = args.srcColorSpace->fromColorSpaceFloatToLinearFloat(b);
                 }
                 break;
-            default:
-                break;
             }
 
 
+            // Luminance and the matte overlay are computed on linear values, before gain, gamma and the
+            // output colorspace (as the float viewer shader does). The 8-bit viewer used to compute them
+            // on display values, so in these modes its output differs from older versions by more than rounding.
             if (luminance) {
                 r = 0.299 * r + 0.587 * g + 0.114 * b;
                 g = r;
@@ -2671,19 +2414,9 @@ scaleToTexture32bitsGeneric(const RectI& roi,
                         break;
                     }
                 } else {
-                    const PIX* src_pixels = (const PIX*)matteAcc->pixelAt(x, y);
-                    if (src_pixels) {
-                        alphaMatteValue = (double)src_pixels[args.alphaChannelIndex];
-                        switch (pixelSize) {
-                        case sizeof(unsigned char):     //byte
-                            alphaMatteValue = (double)Image::convertPixelDepth<unsigned char, float>( (unsigned char)r );
-                            break;
-                        case sizeof(unsigned short):     //short
-                            alphaMatteValue = (double)Image::convertPixelDepth<unsigned short, float>( (unsigned short)r );
-                            break;
-                        default:
-                            break;
-                        }
+                    const PIX* matte_pixels = (const PIX*)matteAcc->pixelAt(x1 + x, y);
+                    if (matte_pixels) {
+                        alphaMatteValue = (double)matte_pixels[args.alphaChannelIndex] / maxValue;
                     }
                 }
                 r += alphaMatteValue * 0.5;
@@ -2847,13 +2580,34 @@ scaleToTexture32bits(const RectI& roi,
         scaleToTexture32bitsForPremult<unsigned short, 65535>(roi, args, tile, output);
         break;
     case eImageBitDepthHalf:
-        assert(false);
+        scaleToTexture32bitsForPremult<Half, 1>(roi, args, tile, output);
         break;
     case eImageBitDepthNone:
         break;
     }
 } // scaleToTexture32bits
 
+void
+ViewerInstance::ViewerInstancePrivate::applyDisplayTransformToTile(const UpdateViewerParams& params,
+                                                                   const Color::Lut* colorSpace,
+                                                                   const UpdateViewerParams::CachedTile& tile,
+                                                                   U32* output) const
+{
+    const Half* src = (const Half*)tile.ramBuffer;
+    const std::size_t nPixels = tile.bytesCount / (4 * sizeof(Half));
+    const ViewerDisplayTransform displayTransform(params.gain, params.offset, params.gamma, &gammaLookup.front(), GAMMA_LUT_NB_VALUES, colorSpace);
+
+    // Work by chunks so that the intermediate float pixels stay in the L1 cache
+    const std::size_t chunkPixels = 512;
+    float pixels[chunkPixels * 4];
+
+    for (std::size_t start = 0; start < nPixels; start += chunkPixels) {
+        const std::size_t n = std::min(chunkPixels, nPixels - start);
+        convertHalfToFloat(src + start * 4, pixels, n * 4);
+        displayTransform.apply(pixels, n, output + start);
+    }
+}
+
 void
 ViewerInstance::ViewerInstancePrivate::updateViewer(UpdateViewerParamsPtr params)
 {
@@ -2880,12 +2634,45 @@ ViewerInstance::ViewerInstancePrivate::updateViewer(UpdateViewerParamsPtr params
 
         assert( (params->isPartialRect && params->tiles.size() == 1) || !params->isPartialRect );
 
+        // Tiles of the texture cache are linear half-float: apply the display transform to get 8bit textures
+        std::vector<const UpdateViewerParams::CachedTile*> linearTiles;
+        for (std::list<UpdateViewerParams::CachedTile>::iterator it = params->tiles.begin(); it != params->tiles.end(); ++it) {
+            if ( it->ramBuffer && it->cachedData && ( (ImageBitDepthEnum)it->cachedData->getKey().getBitDepth() == eImageBitDepthHalf ) ) {
+                linearTiles.push_back(&*it);
+            }
+        }
+        std::vector<std::vector<U32> > displayBuffers( linearTiles.size() );
+        if ( !linearTiles.empty() ) {
+            const Color::Lut* colorSpace = ViewerInstance::lutFromColorspace(params->lut);
+            std::function<void (int)> transformTile = [&](int i) {
+                displayBuffers[i].resize( linearTiles[i]->bytesCount / (4 * sizeof(Half)) );
+                applyDisplayTransformToTile(*params, colorSpace, *linearTiles[i], &displayBuffers[i].front());
+            };
+            QReadLocker k(&gammaLookupMutex);
+            TaskScheduler* scheduler = appPTR ? appPTR->getTaskScheduler() : NULL;
+            if ( (linearTiles.size() > 1) && scheduler ) {
+                scheduler->parallelFor( (int)linearTiles.size(), transformTile );
+            } else {
+                for (int i = 0; i < (int)linearTiles.size(); ++i) {
+                    transformTile(i);
+                }
+            }
+        }
+
         TexturePtr texture;
         bool isFirstTile = true;
+        std::size_t linearTileIndex = 0;
         for (std::list<UpdateViewerParams::CachedTile>::iterator it = params->tiles.begin(); it != params->tiles.end(); ++it) {
             if (!it->ramBuffer) {
                 continue;
             }
+            unsigned char* ramBuffer = it->ramBuffer;
+            std::size_t bytesCount = it->bytesCount;
+            if ( (linearTileIndex < linearTiles.size()) && (linearTiles[linearTileIndex] == &*it) ) {
+                ramBuffer = (unsigned char*)&displayBuffers[linearTileIndex].front();
+                bytesCount = displayBuffers[linearTileIndex].size() * sizeof(U32);
+                ++linearTileIndex;
+            }
 
             // For cached tiles, some tiles might not have the standard tile, (i.e: the last tile column/row).
             // Since the internal buffer is rounded to the tile size anyway we want the glTexSubImage2D call to ensure
@@ -2896,7 +2683,7 @@ ViewerInstance::ViewerInstancePrivate::updateViewer(UpdateViewerParamsPtr params
             texRect.set(it->rectRounded);
     
             assert(params->roi.contains(texRect));
-            uiContext->transferBufferFromRAMtoGPU(it->ramBuffer, it->bytesCount, params->roi, params->roiNotRoundedToTileSize, texRect, params->textureIndex, params->isPartialRect, isFirstTile, &texture);
+            uiContext->transferBufferFromRAMtoGPU(ramBuffer, bytesCount, params->roi, params->roiNotRoundedToTileSize, texRect, params->textureIndex, params->isPartialRect, isFirstTile, &texture);
             isFirstTile = false;
         }
 
@@ -2918,7 +2705,7 @@ ViewerInstance::ViewerInstancePrivate::updateViewer(UpdateViewerParamsPtr params
         } else {
             assert(firstTile.cachedData);
             if (firstTile.cachedData) {
-                depth = (ImageBitDepthEnum)firstTile.cachedData->getKey().getBitDepth();
+                depth = params->depth;
             } else {
                 depth = eImageBitDepthByte;
             }
@@ -2937,6 +2724,29 @@ ViewerInstance::ViewerInstancePrivate::updateViewer(UpdateViewerParamsPtr params
     //    updateViewerCond.wakeOne();
 } // ViewerInstance::ViewerInstancePrivate::updateViewer
 
+void
+ViewerInstance::ViewerInstancePrivate::onRenderedTilesPosted()
+{
+    // always running in the main thread
+    assert( qApp && qApp->thread() == QThread::currentThread() );
+
+    std::list<UpdateViewerParamsPtr> tiles;
+    {
+        QMutexLocker k(&renderedTilesMutex);
+        tiles.swap(renderedTiles);
+    }
+    if ( tiles.empty() || !uiContext ) {
+        return;
+    }
+    for (std::list<UpdateViewerParamsPtr>::iterator it = tiles.begin(); it != tiles.end(); ++it) {
+        // Do not overwrite the texture of a more recent render that was already displayed
+        if ( checkAgeNoUpdate( (*it)->textureIndex, (*it)->abortInfo->getRenderAge() ) ) {
+            updateViewer(*it);
+        }
+    }
+    uiContext->redraw();
+}
+
 bool
 ViewerInstance::isInputOptional(int n) const
 {
@@ -56,6 +56,7 @@ public:
     bool userRoIEnabled;
     bool mustComputeRoDAndLookupCache;
     bool isDoingPartialUpdates;
+    Point tilesFocus; //< in canonical coordinates, the tiles closest to this point are rendered and displayed first
 };
 
 class ViewerInstance
@@ -298,8 +299,6 @@ public:
 
     struct ViewerInstancePrivate;
 
-    float interpolateGammaLut(float value);
-
     void markAllOnGoingRendersAsAborted(bool keepOldestRender);
 
     /**
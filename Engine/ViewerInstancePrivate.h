@@ -30,6 +30,7 @@
 
 #include "ViewerInstance.h"
 
+#include <list>
 #include <map>
 #include <set>
 #include <vector>
@@ -49,7 +50,9 @@
 #include "Engine/FrameEntry.h"
 #include "Engine/Settings.h"
 #include "Engine/Image.h"
+#include "Engine/PlaybackPrefetchWindow.h"
 #include "Engine/TextureRect.h"
+#include "Engine/UpdateViewerParams.h"
 #include "Engine/EngineFwd.h"
 
 #define GAMMA_LUT_NB_VALUES 1023
@@ -81,6 +84,8 @@ struct RenderViewerArgs
                      double offset_,
                      const Color::Lut* srcColorSpace_,
                      const Color::Lut* colorSpace_,
+                     const float* gammaLut_,
+                     int gammaLutIntervals_,
                      int alphaChannelIndex_,
                      bool renderOnlyRoI_,
                      std::size_t tileRowElements_)
@@ -94,6 +99,8 @@ struct RenderViewerArgs
         , offset(offset_)
         , srcColorSpace(srcColorSpace_)
         , colorSpace(colorSpace_)
+        , gammaLut(gammaLut_)
+        , gammaLutIntervals(gammaLutIntervals_)
         , alphaChannelIndex(alphaChannelIndex_)
         , renderOnlyRoI(renderOnlyRoI_)
         , tileRowElements(tileRowElements_)
@@ -110,6 +117,8 @@ struct RenderViewerArgs
     double offset;
     const Color::Lut* srcColorSpace;
     const Color::Lut* colorSpace;
+    const float* gammaLut; // protected by gammaLookupMutex
+    int gammaLutIntervals;
     int alphaChannelIndex;
     bool renderOnlyRoI;
     std::size_t tileRowElements;
@@ -154,6 +163,8 @@ public:
         , renderAgeMutex()
         , renderAge()
         , displayAge()
+        , renderedTilesMutex()
+        , renderedTiles()
     {
         for (int i = 0; i < 2; ++i) {
             forceRender[i] = false;
@@ -169,6 +180,19 @@ public:
         Q_EMIT mustRedrawViewer();
     }
 
+    /**
+     * @brief Called by the render thread to display the tiles of a frame that are done rendering before
+     * the whole frame is rendered.
+     **/
+    void postRenderedTiles(const UpdateViewerParamsPtr& params)
+    {
+        {
+            QMutexLocker k(&renderedTilesMutex);
+            renderedTiles.push_back(params);
+        }
+        Q_EMIT mustUpdateRenderedTiles();
+    }
+
 public:
 
     virtual void lock(const FrameEntryPtr& entry) OVERRIDE FINAL
@@ -333,22 +357,15 @@ public:
         }
     }
 
-    float lookupGammaLut(float value) const
-    {
-        if (value < 0.) {
-            return 0.;
-        } else if (value > 1.) {
-            return 1.;
-        } else {
-            int i = (int)(value * GAMMA_LUT_NB_VALUES);
-            assert(0 <= i && i <= GAMMA_LUT_NB_VALUES);
-            float alpha = std::max( 0.f, std::min(value * GAMMA_LUT_NB_VALUES - i, 1.f) );
-            float a = gammaLookup[i];
-            float b = (i  < GAMMA_LUT_NB_VALUES) ? gammaLookup[i + 1] : 0.f;
-
-            return a * (1.f - alpha) + b * alpha;
-        }
-    }
+    /**
+     * @brief Applies the display transform (gain/offset, gamma and output colorspace) to a linear half-float
+     * tile of the texture cache and converts it to the 8bit BGRA texture format.
+     * gammaLookupMutex should already be locked
+     **/
+    void applyDisplayTransformToTile(const UpdateViewerParams& params,
+                                     const Color::Lut* colorSpace,
+                                     const UpdateViewerParams::CachedTile& tile,
+                                     U32* output) const;
 
 public Q_SLOTS:
 
@@ -358,10 +375,17 @@ public Q_SLOTS:
      **/
     void updateViewer(UpdateViewerParamsPtr params);
 
+    /**
+     * @brief Uploads the tiles posted with postRenderedTiles(), unless a more recent render was displayed since.
+     **/
+    void onRenderedTilesPosted();
+
 Q_SIGNALS:
 
     void mustRedrawViewer();
 
+    void mustUpdateRenderedTiles();
+
 public:
     const ViewerInstance* const instance;
     OpenGLViewerI* uiContext; // written in the main thread before render thread creation, accessed from render thread
@@ -424,6 +448,13 @@ public:
     //A priority list recording the ongoing renders. This is used for abortable renders (i.e: when moving a slider or scrubbing the timeline)
     //The purpose of this is to always at least keep 1 active render (non abortable) and abort more recent renders that do no longer make sense
     OnGoingRenders currentRenderAges[2];
+
+    // The frames whose textures are read ahead from the cache during playback
+    PlaybackPrefetchWindow playbackPrefetchWindow[2];
+
+    // The tiles rendered so far by the renders of the current frame, waiting to be uploaded by the main thread
+    mutable QMutex renderedTilesMutex;
+    std::list<UpdateViewerParamsPtr> renderedTiles;
 };
 
 NATRON_NAMESPACE_EXIT
@@ -246,6 +246,17 @@ CurveGui::getCurveYRange() const
     return getInternalCurve()->getCurveYRange();
 }
 
+void
+CurveGui::evaluateMany(bool useExpr,
+                       const double* xs,
+                       double* ys,
+                       std::size_t n) const
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        ys[i] = evaluate(useExpr, xs[i]);
+    }
+}
+
 CurvePtr
 CurveGui::getInternalCurve() const
 {
@@ -350,27 +361,46 @@ CurveGui::drawCurve(int curveIndex,
             KeyFrame x1Key;
             KeyFrameSet::const_iterator lastUpperIt = keyframes.end();
 
+            // First compute the x positions, which do not depend on the values, then evaluate
+            // all the points that are not keyframes at once.
+            std::vector<double> xs, ys;
+            std::vector<std::size_t> evaluated; // indices in xs of the points to evaluate
+            std::vector<double> evaluatedXs;
             while ( x1 < (widgetWidth - 1) ) {
-                double x, y;
+                double x;
                 if (!isX1AKey) {
                     x = _curveWidget->toZoomCoordinates(x1, 0).x();
-                    y = evaluate(false, x);
+                    evaluated.push_back( xs.size() );
+                    evaluatedXs.push_back(x);
+                    ys.push_back(0.);
                 } else {
                     x = x1Key.getTime();
-                    y = x1Key.getValue();
+                    ys.push_back( x1Key.getValue() );
                 }
+                xs.push_back(x);
 
-                vertices.push_back( (float)x );
-                vertices.push_back( (float)y );
                 nextPointForSegment(x, keyframes, isPeriodic, parametricRange.first, parametricRange.second,  &lastUpperIt, &x2, &x1Key, &isX1AKey);
                 x1 = x2;
             }
             //also add the last point
             {
                 double x = _curveWidget->toZoomCoordinates(x1, 0).x();
-                double y = evaluate(false, x);
-                vertices.push_back( (float)x );
-                vertices.push_back( (float)y );
+                evaluated.push_back( xs.size() );
+                evaluatedXs.push_back(x);
+                xs.push_back(x);
+                ys.push_back(0.);
+            }
+
+            std::vector<double> evaluatedYs( evaluatedXs.size() );
+            evaluateMany( false, &evaluatedXs[0], &evaluatedYs[0], evaluatedXs.size() );
+            for (std::size_t i = 0; i < evaluated.size(); ++i) {
+                ys[evaluated[i]] = evaluatedYs[i];
+            }
+
+            vertices.reserve(xs.size() * 2);
+            for (std::size_t i = 0; i < xs.size(); ++i) {
+                vertices.push_back( (float)xs[i] );
+                vertices.push_back( (float)ys[i] );
             }
         } catch (...) {
         }
@@ -685,6 +715,26 @@ KnobCurveGui::evaluate(bool useExpr,
     }
 }
 
+void
+KnobCurveGui::evaluateMany(bool useExpr,
+                           const double* xs,
+                           double* ys,
+                           std::size_t n) const
+{
+    KnobIPtr knob = getInternalKnob();
+
+    KnobParametric* isParametric = dynamic_cast<KnobParametric*>( knob.get() );
+    if (isParametric) {
+        isParametric->getParametricCurve(_dimension)->getValuesAt(xs, ys, n, false);
+    } else if (useExpr) {
+        CurveGui::evaluateMany(useExpr, xs, ys, n);
+    } else {
+        assert(_internalCurve);
+
+        _internalCurve->getValuesAt(xs, ys, n, false);
+    }
+}
+
 CurvePtr
 KnobCurveGui::getInternalCurve() const
 {
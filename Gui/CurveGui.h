@@ -117,6 +117,11 @@ public:
      * The coordinates are those of the curve, not of the widget.
      **/
     virtual double evaluate(bool useExpr, double x) const = 0;
+
+    /**
+     * @brief Same as evaluate() for the n positions in xs, preferably sorted. The default implementation calls evaluate().
+     **/
+    virtual void evaluateMany(bool useExpr, const double* xs, double* ys, std::size_t n) const;
     virtual CurvePtr  getInternalCurve() const;
 
     void drawCurve(int curveIndex, int curvesCount, double screenPixelRatio);
@@ -196,6 +201,7 @@ public:
     }
 
     virtual double evaluate(bool useExpr, double x) const OVERRIDE FINAL WARN_UNUSED_RETURN;
+    virtual void evaluateMany(bool useExpr, const double* xs, double* ys, std::size_t n) const OVERRIDE FINAL;
     RotoContextPtr getRotoContext() const { return _roto; }
 
     KnobIPtr getInternalKnob() const;
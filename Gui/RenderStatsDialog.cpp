@@ -25,6 +25,7 @@
 
 #include "RenderStatsDialog.h"
 
+#include <algorithm> // max
 #include <bitset>
 #include <stdexcept>
 
@@ -65,8 +66,10 @@
 #define COL_NB_CACHE_HIT 13
 #define COL_NB_CACHE_HIT_DOWNSCALED 14
 #define COL_NB_CACHE_MISS 15
+#define COL_NB_TILES_STOLEN 16
+#define COL_SCHEDULER_QUEUE_DEPTH 17
 
-#define NUM_COLS 16
+#define NUM_COLS 18
 
 NATRON_NAMESPACE_ENTER
 
@@ -646,6 +649,70 @@ public:
                 }
             }
         }
+        {
+            TableItem* item = 0;
+            int nb = 0;
+            if (exists) {
+                item = view->item(row, COL_NB_TILES_STOLEN);
+                if (item) {
+                    nb = item->text().toInt();
+                }
+            } else {
+                item = new TableItem;
+                QString tt = NATRON_NAMESPACE::convertFromPlainText(tr("The number of tiles rendered with host frame threading "
+                                                               "by another thread than the one that requested them."), NATRON_NAMESPACE::WhiteSpaceNormal);
+                item->setToolTip(tt);
+                item->setFlags(Qt::ItemIsSelectable | Qt::ItemIsEnabled);
+            }
+            assert(item);
+            if (item) {
+                int nbTiles, nbTilesStolen, maxQueueDepth;
+                stats.getSchedulerInfos(&nbTiles, &nbTilesStolen, &maxQueueDepth);
+                nb += nbTilesStolen;
+
+                QString str = QString::number(nb);
+                if (nodeUi) {
+                    item->setTextColor(Qt::black);
+                    item->setBackgroundColor(c);
+                }
+                item->setText(str);
+                if (!exists) {
+                    view->setItem(row, COL_NB_TILES_STOLEN, item);
+                }
+            }
+        }
+        {
+            TableItem* item = 0;
+            int nb = 0;
+            if (exists) {
+                item = view->item(row, COL_SCHEDULER_QUEUE_DEPTH);
+                if (item) {
+                    nb = item->text().toInt();
+                }
+            } else {
+                item = new TableItem;
+                QString tt = NATRON_NAMESPACE::convertFromPlainText(tr("The maximum number of requests for a thread pending in the task scheduler "
+                                                               "when this node started rendering tiles with host frame threading."), NATRON_NAMESPACE::WhiteSpaceNormal);
+                item->setToolTip(tt);
+                item->setFlags(Qt::ItemIsSelectable | Qt::ItemIsEnabled);
+            }
+            assert(item);
+            if (item) {
+                int nbTiles, nbTilesStolen, maxQueueDepth;
+                stats.getSchedulerInfos(&nbTiles, &nbTilesStolen, &maxQueueDepth);
+                nb = std::max(nb, maxQueueDepth);
+
+                QString str = QString::number(nb);
+                if (nodeUi) {
+                    item->setTextColor(Qt::black);
+                    item->setBackgroundColor(c);
+                }
+                item->setText(str);
+                if (!exists) {
+                    view->setItem(row, COL_SCHEDULER_QUEUE_DEPTH, item);
+                }
+            }
+        }
         if (!exists) {
             rows.push_back(node);
         }
@@ -891,7 +958,9 @@ RenderStatsDialog::RenderStatsDialog(Gui* gui)
         << tr("Rendered Planes")
         << tr("Cache Hits")
         << tr("Cache Hits Higher Scale")
-        << tr("Cache Misses");
+        << tr("Cache Misses")
+        << tr("Tiles Stolen")
+        << tr("Scheduler Queue Depth");
 
     _imp->view->setColumnCount( dimensionNames.size() );
     _imp->view->setHorizontalHeaderLabels(dimensionNames);
@@ -965,6 +1034,8 @@ RenderStatsDialog::refreshAdvancedColsVisibility()
     _imp->view->setColumnHidden(COL_NB_CACHE_HIT, !checked);
     _imp->view->setColumnHidden(COL_NB_CACHE_HIT_DOWNSCALED, !checked);
     _imp->view->setColumnHidden(COL_NB_CACHE_MISS, !checked);
+    _imp->view->setColumnHidden(COL_NB_TILES_STOLEN, !checked);
+    _imp->view->setColumnHidden(COL_SCHEDULER_QUEUE_DEPTH, !checked);
 }
 
 void
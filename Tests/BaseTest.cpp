@@ -25,7 +25,10 @@
 
 #include "Global/Macros.h"
 
+#include <chrono>
 #include <cstdlib>
+#include <iostream>
+#include <string>
 
 #include "BaseTest.h"
 
@@ -57,6 +60,13 @@ CLANG_DIAG_ON(unknown-pragmas)
 #include "Engine/Curve.h"
 #include "Engine/CLArgs.h"
 #include "Engine/ViewIdx.h"
+#include "Engine/Settings.h"
+#include "Engine/Bezier.h"
+#include "Engine/Image.h"
+#include "Engine/ImagePlaneDesc.h"
+#include "Engine/RotoContext.h"
+#include "Engine/RotoPoint.h"
+#include "Engine/RotoStrokeItem.h"
 
 NATRON_NAMESPACE_USING
 
@@ -283,6 +293,229 @@ TEST_F(BaseTest, GenerateDot)
     QFile::remove(filePath);
 }
 
+///With the half float preference, the images of a float plug-in are cached in half float
+TEST_F(BaseTest, HalfFloatImagesStorage)
+{
+    SettingsPtr settings = appPTR->getCurrentSettings();
+    ASSERT_TRUE( bool(settings) );
+
+    NodePtr generator = createNode(_generatorPluginID);
+    NodePtr writer = createNode(_writeOIIOPluginID);
+
+    ASSERT_TRUE( bool(generator) && bool(writer) );
+    ASSERT_TRUE( generator->isSupportedBitDepth(eImageBitDepthFloat) );
+
+    EXPECT_EQ( eImageBitDepthFloat, generator->getCachedImagesBitDepth(eImageBitDepthFloat) );
+    settings->setHalfFloatImagesStorageEnabled(true);
+    EXPECT_EQ( eImageBitDepthHalf, generator->getCachedImagesBitDepth(eImageBitDepthFloat) );
+    EXPECT_EQ( eImageBitDepthByte, generator->getCachedImagesBitDepth(eImageBitDepthByte) );
+    // The plug-in itself still renders in float
+    EXPECT_EQ( eImageBitDepthFloat, generator->getClosestSupportedBitDepth(eImageBitDepthFloat) );
+    settings->setHalfFloatImagesStorageEnabled(false);
+
+    KnobIPtr frameRange = generator->getApp()->getProject()->getKnobByName("frameRange");
+    ASSERT_TRUE( bool(frameRange) );
+    KnobInt* knob = dynamic_cast<KnobInt*>( frameRange.get() );
+    ASSERT_TRUE(knob);
+    knob->setValue(1, ViewSpec::all(), 0);
+    knob->setValue(1, ViewSpec::all(), 1);
+
+    Format f(0, 0, 200, 200, "toto", 1.);
+    generator->getApp()->getProject()->setOrAddProjectFormat(f);
+
+    KnobBool* forceCaching = dynamic_cast<KnobBool*>( generator->getKnobByName("forceCaching").get() );
+    ASSERT_TRUE(forceCaching);
+    forceCaching->setValue(true);
+
+    const QString& binPath = appPTR->getApplicationBinaryPath();
+    QString filePath = binPath + QString::fromUtf8("/test_half_float_images.jpg");
+    writer->setOutputFilesForWriter( filePath.toStdString() );
+    connectNodes(generator, writer, 0, true);
+
+    std::list<AppInstance::RenderWork> works;
+    AppInstance::RenderWork w;
+    w.writer = dynamic_cast<OutputEffectInstance*>( writer->getEffectInstance().get() );
+    assert(w.writer);
+    w.firstFrame = INT_MIN;
+    w.lastFrame = INT_MAX;
+    w.frameStep = INT_MIN;
+    w.useRenderStats = false;
+    works.push_back(w);
+
+    // Render once with float images, then once with half images and compare what the generator holds in the cache
+    std::size_t floatRAM, halfRAM, diskOccupied;
+    appPTR->removeAllCacheEntriesForHolder(generator.get(), true);
+    getApp()->startWritersRendering(false, works);
+    appPTR->getMemoryStatsForCacheEntryHolder(generator.get(), &floatRAM, &diskOccupied);
+    EXPECT_TRUE( QFile::exists(filePath) );
+    QFile::remove(filePath);
+
+    settings->setHalfFloatImagesStorageEnabled(true);
+    appPTR->removeAllCacheEntriesForHolder(generator.get(), true);
+    getApp()->startWritersRendering(false, works);
+    appPTR->getMemoryStatsForCacheEntryHolder(generator.get(), &halfRAM, &diskOccupied);
+    settings->setHalfFloatImagesStorageEnabled(false);
+    EXPECT_TRUE( QFile::exists(filePath) );
+    QFile::remove(filePath);
+
+    ASSERT_GT(floatRAM, 0u);
+    EXPECT_GT(halfRAM, 0u);
+    // 200x200 RGBA: 640000 bytes of float pixels, 320000 bytes of half pixels, plus the same bitmap for both
+    EXPECT_GE(floatRAM - halfRAM, (std::size_t)200 * 200 * 4 * 2);
+}
+
+///The mask of a closed bezier is rasterized in float directly into the cached image
+TEST_F(BaseTest, RotoClosedBezierMask)
+{
+    NodePtr roto = createNode( QString::fromUtf8(PLUGINID_NATRON_ROTO) );
+
+    ASSERT_TRUE( bool(roto) );
+    RotoContextPtr context = roto->getRotoContext();
+    ASSERT_TRUE( bool(context) );
+
+    const double time = 1.;
+    BezierPtr bezier = context->makeBezier(100, 100, "Bezier", time, false);
+    ASSERT_TRUE( bool(bezier) );
+    bezier->addControlPoint(300, 100, time);
+    bezier->addControlPoint(300, 300, time);
+    bezier->addControlPoint(100, 300, time);
+    bezier->setCurveFinished(true);
+    bezier->getFeatherKnob()->setValue(20.);
+    ASSERT_TRUE( bool( bezier->getMergeNode() ) );
+
+    ImagePtr mask = bezier->renderMaskFromStroke(ImagePlaneDesc::getAlphaComponents(), time, ViewIdx(0), eImageBitDepthFloat, 0, RectD());
+    ASSERT_TRUE( bool(mask) );
+    EXPECT_EQ( eImageBitDepthFloat, mask->getBitDepth() );
+
+    const RectI bounds = mask->getBounds();
+    ASSERT_TRUE( bounds.contains(90, 200) && bounds.contains(309, 200) && bounds.contains(200, 200) );
+    Image::ReadAccess acc = mask->getReadRights();
+    const float inside = *(const float*)acc.pixelAt(200, 200);
+    const float featherLeft = *(const float*)acc.pixelAt(90, 200);
+    const float featherRight = *(const float*)acc.pixelAt(309, 200);
+
+    EXPECT_EQ(1.f, inside);
+    // Both pixels are 9.5 pixels outside the shape, in the feather
+    EXPECT_GT(featherLeft, 0.f);
+    EXPECT_LT(featherLeft, 1.f);
+    EXPECT_NEAR(featherLeft, featherRight, 1e-3);
+
+    // The second call is served from the cache
+    ImagePtr cachedMask = bezier->renderMaskFromStroke(ImagePlaneDesc::getAlphaComponents(), time, ViewIdx(0), eImageBitDepthFloat, 0, RectD());
+    EXPECT_EQ( mask.get(), cachedMask.get() );
+}
+
+// Changes the first dimension of the knob and returns its previous value, or returns false if it is not of a handled type
+static bool
+changeKnobValue(const KnobIPtr& knob,
+                double* previousValue)
+{
+    if ( KnobDoubleBase* isDouble = dynamic_cast<KnobDoubleBase*>( knob.get() ) ) {
+        *previousValue = isDouble->getValue();
+        isDouble->setValue(*previousValue < 0.5 ? *previousValue + 0.25 : *previousValue - 0.25);
+    } else if ( KnobIntBase* isInt = dynamic_cast<KnobIntBase*>( knob.get() ) ) {
+        *previousValue = isInt->getValue();
+        isInt->setValue(*previousValue == 0 ? 1 : 0);
+    } else if ( KnobBoolBase* isBool = dynamic_cast<KnobBoolBase*>( knob.get() ) ) {
+        *previousValue = isBool->getValue();
+        isBool->setValue(*previousValue == 0);
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+static void
+restoreKnobValue(const KnobIPtr& knob,
+                 double previousValue)
+{
+    if ( KnobDoubleBase* isDouble = dynamic_cast<KnobDoubleBase*>( knob.get() ) ) {
+        isDouble->setValue(previousValue);
+    } else if ( KnobIntBase* isInt = dynamic_cast<KnobIntBase*>( knob.get() ) ) {
+        isInt->setValue( (int)previousValue );
+    } else if ( KnobBoolBase* isBool = dynamic_cast<KnobBoolBase*>( knob.get() ) ) {
+        isBool->setValue(previousValue != 0);
+    }
+}
+
+///A finished stroke which is not animated is baked once in the cache, keyed on the stroke data and the knobs its mask depends on
+TEST_F(BaseTest, RotoStaticStrokeMask)
+{
+    NodePtr rotoPaint = createNode( QString::fromUtf8(PLUGINID_NATRON_ROTOPAINT) );
+
+    ASSERT_TRUE( bool(rotoPaint) );
+    RotoContextPtr context = rotoPaint->getRotoContext();
+    ASSERT_TRUE( bool(context) );
+
+    RotoStrokeItemPtr stroke = context->makeStroke(eRotoStrokeTypeSolid, "Brush", true);
+    ASSERT_TRUE( bool(stroke) );
+    for (int i = 0; i < 10; ++i) {
+        stroke->appendPoint( i == 0, RotoPoint(100 + i * 10, 100 + i * 5, 1., i * 0.02) );
+    }
+
+    U64 hash;
+    // The stroke may still change while it is being painted
+    EXPECT_FALSE( stroke->getStaticStrokeHash(&hash) );
+    stroke->setStrokeFinished();
+    ASSERT_TRUE( stroke->getStaticStrokeHash(&hash) );
+
+    std::vector<KnobIPtr> knobs;
+    knobs.push_back( stroke->getOpacityKnob() );
+    knobs.push_back( stroke->getColorKnob() );
+    knobs.push_back( stroke->getKnobByName("translate") );
+    knobs.push_back( stroke->getKnobByName("rotate") );
+    knobs.push_back( stroke->getKnobByName("scale") );
+    knobs.push_back( stroke->getKnobByName("uniform") );
+    knobs.push_back( stroke->getKnobByName("skewx") );
+    knobs.push_back( stroke->getKnobByName("skewy") );
+    knobs.push_back( stroke->getKnobByName("skewOrder") );
+    knobs.push_back( stroke->getCenterKnob() );
+    knobs.push_back( stroke->getKnobByName("extraMatrix") );
+    knobs.push_back( stroke->getBrushSizeKnob() );
+    knobs.push_back( stroke->getBrushSpacingKnob() );
+    knobs.push_back( stroke->getBrushHardnessKnob() );
+    knobs.push_back( stroke->getPressureOpacityKnob() );
+    knobs.push_back( stroke->getPressureSizeKnob() );
+    knobs.push_back( stroke->getPressureHardnessKnob() );
+    knobs.push_back( stroke->getBuildupKnob() );
+    knobs.push_back( stroke->getBrushVisiblePortionKnob() );
+
+    for (std::size_t i = 0; i < knobs.size(); ++i) {
+        ASSERT_TRUE( bool(knobs[i]) ) << "knob #" << i;
+        const std::string name = knobs[i]->getName();
+
+        // Editing the knob changes the key
+        double previousValue;
+        ASSERT_TRUE( changeKnobValue(knobs[i], &previousValue) ) << name;
+        U64 editedHash;
+        ASSERT_TRUE( stroke->getStaticStrokeHash(&editedHash) ) << name;
+        EXPECT_NE(hash, editedHash) << name;
+        restoreKnobValue(knobs[i], previousValue);
+        U64 restoredHash;
+        ASSERT_TRUE( stroke->getStaticStrokeHash(&restoredHash) ) << name;
+        EXPECT_EQ(hash, restoredHash) << name;
+
+        // Animating it disables the baking
+        KnobDoubleBase* isDouble = dynamic_cast<KnobDoubleBase*>( knobs[i].get() );
+        if (isDouble) {
+            isDouble->setValueAtTime(10, isDouble->getValue(), ViewSpec::all(), 0);
+            EXPECT_FALSE( stroke->getStaticStrokeHash(&restoredHash) ) << name;
+            isDouble->removeAnimation(ViewSpec::all(), 0);
+            ASSERT_TRUE( stroke->getStaticStrokeHash(&restoredHash) ) << name;
+            EXPECT_EQ(hash, restoredHash) << name;
+        }
+    }
+
+    // The mask is rendered once and served from the cache at any other frame
+    ImagePtr mask = stroke->renderMaskFromStroke(ImagePlaneDesc::getAlphaComponents(), 1, ViewIdx(0), eImageBitDepthFloat, 0, RectD());
+    ASSERT_TRUE( bool(mask) );
+    for (double time = 2; time <= 50; time += 16) {
+        ImagePtr cachedMask = stroke->renderMaskFromStroke(ImagePlaneDesc::getAlphaComponents(), time, ViewIdx(0), eImageBitDepthFloat, 0, RectD());
+        EXPECT_EQ( mask.get(), cachedMask.get() ) << "time=" << time;
+    }
+}
+
 TEST_F(BaseTest, SetValues)
 {
     NodePtr generator = createNode(_generatorPluginID);
@@ -323,3 +556,144 @@ TEST_F(BaseTest, SimpleNodeConnections) {
     disconnectNodes(generator, writer, false);
     connectNodes(generator, writer, 0, true);
 }
+
+///Simple expressions are evaluated without Python and give the same results
+TEST_F(BaseTest, NativeExpressions)
+{
+    NodePtr generator = createNode(_generatorPluginID);
+
+    ASSERT_TRUE(generator);
+    KnobDoubleBase* master = dynamic_cast<KnobDoubleBase*>( generator->getKnobByName("noiseZSlope").get() );
+    ASSERT_TRUE(master != 0);
+    master->setValue(0.5);
+
+    // find another 1-dimensional double parameter
+    KnobDoubleBase* slave = 0;
+    const KnobsVec& knobs = generator->getKnobs();
+    for (KnobsVec::const_iterator it = knobs.begin(); it != knobs.end(); ++it) {
+        KnobDoubleBase* knob = dynamic_cast<KnobDoubleBase*>( it->get() );
+        if ( knob && (knob != master) && (knob->getDimension() == 1) && !knob->getIsSecret() ) {
+            slave = knob;
+            break;
+        }
+    }
+    ASSERT_TRUE(slave != 0);
+
+    struct NativeExpr
+    {
+        const char* expr;
+        double expected; // at frame 3
+    };
+    const NativeExpr exprs[] = {
+        {"frame * 2 + 1", 7.},
+        {"thisNode.noiseZSlope.get() * 2 + frame", 4.},
+        {"thisNode.noiseZSlope.getValueAtTime(frame - 1) ** 2", 0.25},
+        {"-7 // 2 + -7 % 3", -2.},
+        {"max(frame, 1) if frame > 2 else 0", 3.},
+        {"floor(sin(pi / 2) * 10) / 4", 2.5},
+        {0, 0.}
+    };
+    for (int i = 0; exprs[i].expr; ++i) {
+        slave->setExpression(0, exprs[i].expr, false, true);
+        EXPECT_TRUE( slave->isExpressionNative(0) ) << exprs[i].expr;
+        KnobI* knob = slave;
+        knob->clearExpressionsResults(0);
+        EXPECT_DOUBLE_EQ( exprs[i].expected, slave->getValueAtTime(3, 0, ViewSpec::current(), false) ) << exprs[i].expr;
+    }
+
+    // Unsupported syntax falls back on Python
+    slave->setExpression(0, "len(str(int(frame)))", false, true);
+    EXPECT_FALSE( slave->isExpressionNative(0) );
+    EXPECT_DOUBLE_EQ( 2., slave->getValueAtTime(42, 0, ViewSpec::current(), false) );
+
+    // Errors are still reported by Python
+    slave->setExpression(0, "1 / (frame - 3)", false, true);
+    EXPECT_TRUE( slave->isExpressionNative(0) );
+    EXPECT_DOUBLE_EQ( 1., slave->getValueAtTime(4, 0, ViewSpec::current(), false) );
+    (void)slave->getValueAtTime(3, 0, ViewSpec::current(), false);
+    EXPECT_FALSE( slave->isExpressionValid(0, 0) );
+}
+
+///Python expressions are compiled once and evaluated with the frame of each call
+TEST_F(BaseTest, CompiledExpressions)
+{
+    NodePtr generator = createNode(_generatorPluginID);
+
+    ASSERT_TRUE(generator);
+    KnobDoubleBase* knob = dynamic_cast<KnobDoubleBase*>( generator->getKnobByName("noiseZSlope").get() );
+    ASSERT_TRUE(knob != 0);
+    KnobI* knobI = knob;
+
+    knob->setExpression(0, "len(str(int(frame)))", false, true);
+    EXPECT_FALSE( knob->isExpressionNative(0) );
+    EXPECT_DOUBLE_EQ( 1., knob->getValueAtTime(9, 0, ViewSpec::current(), false) );
+    EXPECT_DOUBLE_EQ( 2., knob->getValueAtTime(10, 0, ViewSpec::current(), false) );
+    knobI->clearExpressionsResults(0);
+    EXPECT_DOUBLE_EQ( 3., knob->getValueAtTime(100, 0, ViewSpec::current(), false) );
+
+    // Integral frames are passed as ints
+    knob->setExpression(0, "1 if isinstance(frame, int) else 0", false, true);
+    EXPECT_FALSE( knob->isExpressionNative(0) );
+    EXPECT_DOUBLE_EQ( 1., knob->getValueAtTime(3, 0, ViewSpec::current(), false) );
+    EXPECT_DOUBLE_EQ( 0., knob->getValueAtTime(3.5, 0, ViewSpec::current(), false) );
+
+    // Replacing the expression replaces the compiled code
+    knob->setExpression(0, "len(str(int(frame))) * 10", false, true);
+    EXPECT_DOUBLE_EQ( 20., knob->getValueAtTime(10, 0, ViewSpec::current(), false) );
+    EXPECT_TRUE( knob->isExpressionValid(0, 0) );
+}
+
+///Not a correctness test: evaluate a graph of 1000 knob expressions at many frames.
+///Each node has its first double knob driven by the frame and the other ones linked to it.
+///Disabled by default, run it with --gtest_also_run_disabled_tests.
+TEST_F(BaseTest, DISABLED_ExpressionsBenchmark)
+{
+    const std::size_t nExpressions = 1000;
+    const int nFrames = 100;
+    std::vector<std::pair<KnobDoubleBase*, int> > exprKnobs;
+    std::vector<NodePtr> nodes;
+
+    while (exprKnobs.size() < nExpressions) {
+        NodePtr generator = createNode(_generatorPluginID);
+        ASSERT_TRUE(generator);
+        nodes.push_back(generator);
+
+        std::string masterName;
+        const KnobsVec& knobs = generator->getKnobs();
+        for (KnobsVec::const_iterator it = knobs.begin(); it != knobs.end() && exprKnobs.size() < nExpressions; ++it) {
+            KnobDoubleBase* knob = dynamic_cast<KnobDoubleBase*>( it->get() );
+            if ( !knob || knob->getIsSecret() ) {
+                continue;
+            }
+            if ( masterName.empty() ) {
+                if (knob->getDimension() != 1) {
+                    continue;
+                }
+                masterName = knob->getName();
+                knob->setExpression(0, "frame", false, true);
+                exprKnobs.push_back( std::make_pair(knob, 0) );
+                continue;
+            }
+            for (int d = 0; d < knob->getDimension() && exprKnobs.size() < nExpressions; ++d) {
+                knob->setExpression(d, "thisNode." + masterName + ".getValue() * 2 + frame", false, true);
+                exprKnobs.push_back( std::make_pair(knob, d) );
+            }
+        }
+        ASSERT_FALSE( masterName.empty() );
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    double sum = 0.;
+    for (int f = 1; f <= nFrames; ++f) {
+        for (std::size_t i = 0; i < exprKnobs.size(); ++i) {
+            // Expression results are cached per time: force an evaluation for each frame
+            KnobI* knob = exprKnobs[i].first;
+            knob->clearExpressionsResults(exprKnobs[i].second);
+            sum += exprKnobs[i].first->getValueAtTime(f, exprKnobs[i].second, ViewSpec::current(), false);
+        }
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Evaluated " << nExpressions << " expressions at " << nFrames << " frames in " << elapsed << " s ("
+              << elapsed * 1e6 / (nExpressions * nFrames) << " us per expression)" << std::endl;
+    EXPECT_TRUE(sum > 0.);
+}
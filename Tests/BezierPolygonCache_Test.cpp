@@ -0,0 +1,220 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * (C) 2018-2023 The Natron developers
+ * (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <atomic>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "Engine/BezierPolygonCache.h"
+
+NATRON_NAMESPACE_USING
+
+static BezierPolygonCache::Key
+makeKey(double time,
+        unsigned int mipmapLevel = 0)
+{
+    BezierPolygonCache::Key key;
+
+    key.useGuiCurves = false;
+    key.feather = false;
+    key.evaluateIfEqual = true;
+    key.time = time;
+    key.mipmapLevel = mipmapLevel;
+    key.precision = 10;
+
+    return key;
+}
+
+// A closed shape made of n straight segments along the x axis
+static std::vector<BezierPolygonCache::Segment>
+makeSegments(int n)
+{
+    std::vector<BezierPolygonCache::Segment> segments(n);
+
+    for (int i = 0; i < n; ++i) {
+        BezierPolygonCache::Segment& s = segments[i];
+        s.p0.x = i; s.p0.y = 0.;
+        s.p1.x = i + 1. / 3; s.p1.y = 0.;
+        s.p2.x = i + 2. / 3; s.p2.y = 0.;
+        s.p3.x = i + 1; s.p3.y = 0.;
+    }
+
+    return segments;
+}
+
+static BezierPolygonCache::EvaluateFunction
+makeEvaluate(std::atomic<int>* nCalls)
+{
+    return [nCalls](const BezierPolygonCache::Segment& segment, std::list<ParametricPoint>* polygon) {
+        ++(*nCalls);
+        for (int i = 0; i < 10; ++i) {
+            ParametricPoint p;
+            p.t = i / 9.;
+            p.x = segment.p0.x + (segment.p3.x - segment.p0.x) * p.t;
+            p.y = segment.p0.y + (segment.p3.y - segment.p0.y) * p.t;
+            polygon->push_back(p);
+        }
+    };
+}
+
+TEST(BezierPolygonCache, SegmentsAreEvaluatedOnce)
+{
+    BezierPolygonCache cache;
+    std::atomic<int> nCalls(0);
+    std::vector<BezierPolygonCache::Segment> segments = makeSegments(8);
+    std::vector<BezierPolygonCache::PolygonPtr> polygons;
+
+    EXPECT_EQ( 8, cache.getPolygons(makeKey(1), segments, makeEvaluate(&nCalls), &polygons) );
+    ASSERT_EQ( 8u, polygons.size() );
+    for (std::size_t i = 0; i < polygons.size(); ++i) {
+        ASSERT_TRUE(polygons[i]);
+        EXPECT_EQ( 10u, polygons[i]->size() );
+        EXPECT_EQ( (double)i, polygons[i]->front().x );
+        EXPECT_EQ( (double)i + 1, polygons[i]->back().x );
+    }
+
+    std::vector<BezierPolygonCache::PolygonPtr> polygons2;
+    EXPECT_EQ( 0, cache.getPolygons(makeKey(1), segments, makeEvaluate(&nCalls), &polygons2) );
+    EXPECT_EQ(8, nCalls);
+    for (std::size_t i = 0; i < polygons.size(); ++i) {
+        EXPECT_EQ(polygons[i], polygons2[i]);
+    }
+}
+
+TEST(BezierPolygonCache, OnlyEditedSegmentsAreEvaluated)
+{
+    BezierPolygonCache cache;
+    std::atomic<int> nCalls(0);
+    std::vector<BezierPolygonCache::Segment> segments = makeSegments(100);
+    std::vector<BezierPolygonCache::PolygonPtr> polygons;
+
+    cache.getPolygons(makeKey(1), segments, makeEvaluate(&nCalls), &polygons);
+
+    // Moving a control point changes the two segments around it
+    segments[41].p3.y = 5.;
+    segments[42].p0.y = 5.;
+    EXPECT_EQ( 2, cache.getPolygons(makeKey(1), segments, makeEvaluate(&nCalls), &polygons) );
+    EXPECT_EQ( 5., polygons[41]->back().y );
+    EXPECT_EQ( 5., polygons[42]->front().y );
+
+    // Inserting a control point replaces a segment by two new ones, the segments after it are shifted
+    BezierPolygonCache::Segment half = segments[10];
+    half.p3.x = half.p0.x + 0.5;
+    segments.insert(segments.begin() + 10, half);
+    segments[11].p0.x = half.p3.x;
+    EXPECT_EQ( 2, cache.getPolygons(makeKey(1), segments, makeEvaluate(&nCalls), &polygons) );
+    ASSERT_EQ( 101u, polygons.size() );
+    EXPECT_EQ( 10.5, polygons[10]->back().x );
+    EXPECT_EQ( 10.5, polygons[11]->front().x );
+    EXPECT_EQ( 100., polygons[100]->back().x );
+}
+
+TEST(BezierPolygonCache, StaticShapeIsSharedAcrossTimes)
+{
+    BezierPolygonCache cache;
+    std::atomic<int> nCalls(0);
+    std::vector<BezierPolygonCache::Segment> segments = makeSegments(16);
+    std::vector<BezierPolygonCache::PolygonPtr> polygons;
+
+    EXPECT_EQ( 16, cache.getPolygons(makeKey(1), segments, makeEvaluate(&nCalls), &polygons) );
+    EXPECT_EQ( 0, cache.getPolygons(makeKey(2), segments, makeEvaluate(&nCalls), &polygons) );
+    EXPECT_EQ( 0, cache.getPolygons(makeKey(3), segments, makeEvaluate(&nCalls), &polygons) );
+
+    // The polygons of another mipmap level are in other coordinates
+    EXPECT_EQ( 16, cache.getPolygons(makeKey(1, 1), segments, makeEvaluate(&nCalls), &polygons) );
+    EXPECT_EQ( 4u, cache.getNumEntries() );
+}
+
+TEST(BezierPolygonCache, LeastRecentlyUsedEntriesAreEvicted)
+{
+    BezierPolygonCache cache(4);
+    std::atomic<int> nCalls(0);
+    std::vector<BezierPolygonCache::PolygonPtr> polygons;
+
+    for (int t = 0; t < 10; ++t) {
+        // Each time has its own shape
+        std::vector<BezierPolygonCache::Segment> segments = makeSegments(4);
+        for (std::size_t i = 0; i < segments.size(); ++i) {
+            segments[i].p0.y = segments[i].p3.y = t;
+        }
+        EXPECT_EQ( 4, cache.getPolygons(makeKey(t), segments, makeEvaluate(&nCalls), &polygons) );
+        EXPECT_LE( cache.getNumEntries(), 4u );
+    }
+    cache.clear();
+    EXPECT_EQ( 0u, cache.getNumEntries() );
+}
+
+TEST(BezierPolygonCache, ReservedEntriesKeepAllSamples)
+{
+    BezierPolygonCache cache(4);
+    std::atomic<int> nCalls(0);
+    std::vector<BezierPolygonCache::PolygonPtr> polygons;
+    const int nSamples = 40;
+
+    // As many entries as the motion blur samples of an animated shape
+    cache.reserveEntries(nSamples);
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int t = 0; t < nSamples; ++t) {
+            std::vector<BezierPolygonCache::Segment> segments = makeSegments(4);
+            for (std::size_t i = 0; i < segments.size(); ++i) {
+                segments[i].p0.y = segments[i].p3.y = t;
+            }
+            // The second pass finds all the samples in the cache
+            EXPECT_EQ( pass == 0 ? 4 : 0, cache.getPolygons(makeKey(t), segments, makeEvaluate(&nCalls), &polygons) ) << "t=" << t;
+        }
+    }
+    EXPECT_EQ( (std::size_t)nSamples, cache.getNumEntries() );
+
+    // Reserving fewer entries does not evict any
+    cache.reserveEntries(8);
+    std::vector<BezierPolygonCache::Segment> segments = makeSegments(4);
+    cache.getPolygons(makeKey(nSamples), segments, makeEvaluate(&nCalls), &polygons);
+    EXPECT_EQ( (std::size_t)nSamples, cache.getNumEntries() );
+}
+
+TEST(BezierPolygonCache, ManySegmentsMatchSequentialEvaluation)
+{
+    BezierPolygonCache cache;
+    std::atomic<int> nCalls(0);
+    std::vector<BezierPolygonCache::Segment> segments = makeSegments(1000);
+    std::vector<BezierPolygonCache::PolygonPtr> polygons;
+
+    EXPECT_EQ( 1000, cache.getPolygons(makeKey(1), segments, makeEvaluate(&nCalls), &polygons) );
+    EXPECT_EQ(1000, nCalls);
+    for (std::size_t i = 0; i < polygons.size(); ++i) {
+        ASSERT_TRUE(polygons[i]);
+        std::list<ParametricPoint> expected;
+        std::atomic<int> unused(0);
+        makeEvaluate(&unused)(segments[i], &expected);
+        ASSERT_EQ( expected.size(), polygons[i]->size() );
+        std::list<ParametricPoint>::const_iterator itE = expected.begin();
+        for (std::list<ParametricPoint>::const_iterator it = polygons[i]->begin(); it != polygons[i]->end(); ++it, ++itE) {
+            EXPECT_EQ(itE->x, it->x);
+            EXPECT_EQ(itE->y, it->y);
+        }
+    }
+}
@@ -0,0 +1,807 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * (C) 2018-2023 The Natron developers
+ * (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <list>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#ifdef __NATRON_UNIX__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <gtest/gtest.h>
+
+#include <QtCore/QByteArray>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+
+#include "Engine/Cache.h"
+#include "Engine/CacheCompression.h"
+#include "Engine/CacheEntry.h"
+#include "Engine/CacheIndexFile.h"
+#include "Engine/FrameKey.h"
+#include "Engine/Image.h"
+#include "Engine/ImageKey.h"
+#include "Engine/ImageParams.h"
+#include "Engine/MemoryFile.h"
+#include "Engine/PlaybackPrefetchWindow.h"
+#include "Engine/StandardPaths.h"
+#include "Engine/TextureRect.h"
+#include "Engine/ViewIdx.h"
+
+NATRON_NAMESPACE_USING
+
+namespace {
+
+ImageKey
+makeTestKey(U64 nodeHash)
+{
+    return ImageKey(NULL, nodeHash, false, 0, ViewIdx(0), 1., false, false);
+}
+
+ImageParamsPtr
+makeTestParams(StorageModeEnum storage = eStorageModeRAM)
+{
+    return std::make_shared<ImageParams>(RectD(0, 0, 16, 16),
+                                         1.,
+                                         0,
+                                         RectI(0, 0, 16, 16),
+                                         eImageBitDepthFloat,
+                                         eImageFieldingOrderNone,
+                                         eImagePremultiplicationPremultiplied,
+                                         false,
+                                         ImagePlaneDesc::getRGBAComponents(),
+                                         storage,
+                                         0);
+}
+
+// Each thread works on its own range of keys: half of the calls create entries, the other half look them up.
+void
+lookupOrInsertEntries(const Cache<Image>* cache,
+                      const ImageParamsPtr& params,
+                      U64 firstKey,
+                      int nKeys,
+                      int nIterations)
+{
+    for (int i = 0; i < nIterations; ++i) {
+        ImageKey key = makeTestKey( firstKey + (i % nKeys) );
+        if (i < nKeys) {
+            ImagePtr entry;
+            cache->getOrCreate(key, params, NULL, &entry);
+        } else {
+            std::list<ImagePtr> entries;
+            cache->get(key, &entries);
+        }
+    }
+}
+} // anon namespace
+
+TEST(Cache, GetOrCreate)
+{
+    Cache<Image> cache("CacheTest", NATRON_CACHE_VERSION, 1024 * 1024 * 1024, 1.);
+    ImageParamsPtr params = makeTestParams();
+
+    ImagePtr created;
+    EXPECT_FALSE( cache.getOrCreate(makeTestKey(1), params, NULL, &created) );
+    ASSERT_TRUE(created);
+
+    ImagePtr found;
+    EXPECT_TRUE( cache.getOrCreate(makeTestKey(1), params, NULL, &found) );
+    EXPECT_EQ(created, found);
+
+    std::list<ImagePtr> entries;
+    EXPECT_FALSE( cache.get(makeTestKey(2), &entries) );
+    EXPECT_TRUE( cache.get(makeTestKey(1), &entries) );
+    ASSERT_EQ( (std::size_t)1, entries.size() );
+    EXPECT_EQ( created, entries.front() );
+
+    cache.removeEntry(created);
+    entries.clear();
+    EXPECT_FALSE( cache.get(makeTestKey(1), &entries) );
+    cache.waitForDeleterThread();
+}
+
+TEST(Cache, ConcurrentLookupsKeepEveryEntry)
+{
+    const int nThreads = 8;
+    const int nKeysPerThread = 256;
+    ImageParamsPtr params = makeTestParams();
+    Cache<Image> cache("CacheTest", NATRON_CACHE_VERSION, 1024 * 1024 * 1024, 1.);
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < nThreads; ++i) {
+        threads.push_back( std::thread(lookupOrInsertEntries, &cache, params, (U64)i * nKeysPerThread, nKeysPerThread, 4 * nKeysPerThread) );
+    }
+    for (std::size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+
+    // Every key inserted by every thread must still be there
+    std::list<ImagePtr> copy;
+    cache.getCopy(&copy);
+    EXPECT_EQ( (std::size_t)nThreads * nKeysPerThread, copy.size() );
+    for (U64 k = 0; k < (U64)nThreads * nKeysPerThread; ++k) {
+        std::list<ImagePtr> entries;
+        EXPECT_TRUE( cache.get(makeTestKey(k), &entries) );
+    }
+    cache.waitForDeleterThread();
+}
+
+// Not a correctness test: prints the throughput of concurrent get()/getOrCreate() calls on distinct keys
+// for an increasing number of threads, which should scale since keys are spread across the cache shards.
+// Disabled by default, run it with --gtest_also_run_disabled_tests.
+TEST(Cache, DISABLED_ConcurrentLookupBenchmark)
+{
+    const int nKeysPerThread = 256;
+    const int nOpsTotal = 1 << 18;
+    ImageParamsPtr params = makeTestParams();
+
+    for (int nThreads = 1; nThreads <= 64; nThreads *= 2) {
+        Cache<Image> cache("CacheTest", NATRON_CACHE_VERSION, 1024 * 1024 * 1024, 1.);
+        std::vector<std::thread> threads;
+        int nIterations = nOpsTotal / nThreads;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int i = 0; i < nThreads; ++i) {
+            threads.push_back( std::thread(lookupOrInsertEntries, &cache, params, (U64)i * nKeysPerThread, nKeysPerThread, nIterations) );
+        }
+        for (std::size_t i = 0; i < threads.size(); ++i) {
+            threads[i].join();
+        }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "Cache lookups with " << nThreads << " thread(s): "
+                  << (int)(nOpsTotal / elapsed) << " ops/s" << std::endl;
+        cache.waitForDeleterThread();
+    }
+}
+
+TEST(CacheCompression, RoundTrip)
+{
+    const std::size_t sizes[] = { 0, 1, 13, 1000, 65536, 65537, 300001 };
+
+    srand(2018);
+    for (int elementSize = 1; elementSize <= 4; elementSize *= 2) {
+        for (std::size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+            std::size_t size = sizes[s];
+            // Random bytes, zeros and sparse runs
+            for (int pattern = 0; pattern < 3; ++pattern) {
+                std::vector<unsigned char> data(size);
+                for (std::size_t i = 0; i < size; ++i) {
+                    data[i] = pattern == 0 ? (unsigned char)rand() : pattern == 1 ? 0 : ( (i / 37) % 3 ? 0 : rand() % 4 );
+                }
+                std::vector<unsigned char> compressed( CacheCompression::getMaxCompressedSize(size) + 1 );
+                std::size_t compressedSize = CacheCompression::compress(size ? &data[0] : NULL, size, elementSize, &compressed[0]);
+                ASSERT_LE( compressedSize, CacheCompression::getMaxCompressedSize(size) );
+                if ( (pattern == 1) && (size >= 1000) ) {
+                    EXPECT_LT(compressedSize * 100, size);
+                }
+
+                std::vector<unsigned char> uncompressed(size + 1, 0xcd);
+                ASSERT_TRUE( CacheCompression::uncompress(&compressed[0], compressedSize, elementSize, &uncompressed[0], size) );
+                EXPECT_TRUE( size == 0 || std::memcmp(&data[0], &uncompressed[0], size) == 0 ) << "size " << size << " element size " << elementSize;
+                EXPECT_EQ(0xcd, uncompressed[size]);
+                if (compressedSize > 0) {
+                    EXPECT_FALSE( CacheCompression::uncompress(&compressed[0], compressedSize - 1, elementSize, &uncompressed[0], size) );
+                }
+            }
+        }
+    }
+}
+
+// Images recycled by the memory portion of the cache are kept compressed and found again by get()
+TEST(Cache, CompressedPortion)
+{
+    const int nImages = 64;
+    // Room for 8 images of 16x16 RGBA float in the memory portion
+    Cache<Image> cache("CacheTest", NATRON_CACHE_VERSION, 8 * 16 * 16 * 4 * sizeof(float), 1.);
+    cache.setMaximumCompressedSize(1024 * 1024);
+    ImageParamsPtr params = makeTestParams();
+
+    for (int i = 0; i < nImages; ++i) {
+        ImagePtr image;
+        ASSERT_FALSE( cache.getOrCreate(makeTestKey(i), params, NULL, &image) );
+        image->allocateMemory();
+        image->fill(image->getBounds(), 0.f, 0.f, 0.f, (float)i / nImages);
+    }
+    EXPECT_GT( cache.getCompressedCacheSize(), (std::size_t)0 );
+
+    for (int i = 0; i < nImages; ++i) {
+        std::list<ImagePtr> entries;
+        ASSERT_TRUE( cache.get(makeTestKey(i), &entries) ) << "image " << i << " was deleted";
+        ASSERT_EQ( (std::size_t)1, entries.size() );
+        Image::ReadAccess access = entries.front()->getReadRights();
+        const float* pixel = (const float*)access.pixelAt(15, 15);
+        ASSERT_TRUE(pixel != NULL);
+        EXPECT_EQ( (float)i / nImages, pixel[3] );
+        EXPECT_EQ( 0.f, pixel[0] );
+    }
+
+    cache.clear();
+    EXPECT_EQ( (std::size_t)0, cache.getCompressedCacheSize() );
+    cache.waitForDeleterThread();
+}
+
+namespace {
+CacheIndexRecord
+makeTestRecord(int i)
+{
+    CacheIndexRecord record;
+
+    // Spread the records over a few hashes so that several records share the same hash
+    record.hash = (U64)(i / 4) * 0x9E3779B97F4A7C15ULL;
+    record.size = 1000 + i;
+    record.dataOffsetInFile = i;
+    std::stringstream ss;
+    ss << std::hex << record.hash << "_" << i << "." NATRON_CACHE_FILE_EXT;
+    record.filePath = ss.str();
+    record.data = std::string(100 + i % 300, (char)i);
+
+    return record;
+}
+} // anon namespace
+
+// The index persists the records across sessions, and only returns those not loaded by this session
+TEST(CacheIndexFile, Records)
+{
+    const int nRecords = 10000;
+    QDir dir( StandardPaths::writableLocation(StandardPaths::eStandardLocationTemp) );
+    dir.mkpath( QString::fromUtf8(".") );
+    std::string filePath = dir.absoluteFilePath( QString::fromUtf8("NatronUnitTestCacheIndex." NATRON_CACHE_FILE_EXT) ).toStdString();
+    std::remove( filePath.c_str() );
+
+    std::size_t totalSize = 0;
+    {
+        CacheIndexFile index(filePath, NATRON_CACHE_VERSION);
+        EXPECT_EQ( (std::size_t)0, index.getRecordsCount() );
+        // Enough records for the table to be rebuilt several times
+        for (int i = 0; i < nRecords; ++i) {
+            ASSERT_TRUE( index.insert( makeTestRecord(i) ) );
+            totalSize += makeTestRecord(i).size;
+        }
+        ASSERT_TRUE( index.insert( makeTestRecord(5) ) );
+        EXPECT_EQ( (std::size_t)nRecords, index.getRecordsCount() );
+
+        // Records inserted by this session belong to loaded entries
+        std::list<CacheIndexRecord> records;
+        index.find(makeTestRecord(0).hash, &records);
+        EXPECT_TRUE( records.empty() );
+        CacheIndexRecord evicted;
+        EXPECT_FALSE( index.evict(&evicted) );
+
+        index.remove(makeTestRecord(1).hash, makeTestRecord(1).filePath);
+        totalSize -= makeTestRecord(1).size;
+
+        CacheIndexRecord tooLarge = makeTestRecord(nRecords);
+        tooLarge.data = std::string(4096, 'x');
+        EXPECT_FALSE( index.insert(tooLarge) );
+    }
+
+    {
+        CacheIndexFile index(filePath, NATRON_CACHE_VERSION);
+        EXPECT_EQ( (std::size_t)nRecords - 1, index.getRecordsCount() );
+        EXPECT_EQ( totalSize, index.getTotalSize() );
+        for (int i = 0; i < nRecords; i += 4) {
+            std::list<CacheIndexRecord> records;
+            index.find(makeTestRecord(i).hash, &records);
+            ASSERT_EQ( (std::size_t)(i == 0 ? 3 : 4), records.size() );
+            for (std::list<CacheIndexRecord>::iterator it = records.begin(); it != records.end(); ++it) {
+                int j = (int)it->dataOffsetInFile;
+                ASSERT_TRUE(j >= i && j < i + 4 && j != 1);
+                CacheIndexRecord expected = makeTestRecord(j);
+                EXPECT_EQ(expected.filePath, it->filePath);
+                EXPECT_EQ(expected.size, it->size);
+                EXPECT_EQ(expected.data, it->data);
+            }
+        }
+
+        // A record acquired by a look-up is not evicted
+        EXPECT_TRUE( index.acquire(makeTestRecord(8).hash, makeTestRecord(8).filePath) );
+        EXPECT_FALSE( index.acquire(makeTestRecord(8).hash, makeTestRecord(8).filePath) );
+        int nEvicted = 0;
+        CacheIndexRecord evicted;
+        while ( index.evict(&evicted) ) {
+            EXPECT_NE(makeTestRecord(8).filePath, evicted.filePath);
+            ++nEvicted;
+        }
+        EXPECT_EQ(nRecords - 2, nEvicted);
+        EXPECT_EQ( (std::size_t)1, index.getRecordsCount() );
+    }
+
+    {
+        // An index written for another version of the cache is discarded
+        CacheIndexFile index(filePath, NATRON_CACHE_VERSION + 1);
+        EXPECT_EQ( (std::size_t)0, index.getRecordsCount() );
+    }
+    std::remove( filePath.c_str() );
+}
+
+// After a crash, the index may be truncated or hold damaged records: only the intact records are restored
+TEST(CacheIndexFile, RestoreDamagedIndex)
+{
+    const int nRecords = 1000;
+    QDir dir( StandardPaths::writableLocation(StandardPaths::eStandardLocationTemp) );
+    dir.mkpath( QString::fromUtf8(".") );
+    std::string filePath = dir.absoluteFilePath( QString::fromUtf8("NatronUnitTestCacheIndexDamaged." NATRON_CACHE_FILE_EXT) ).toStdString();
+    std::remove( filePath.c_str() );
+
+    {
+        CacheIndexFile index(filePath, NATRON_CACHE_VERSION);
+        for (int i = 0; i < nRecords; ++i) {
+            ASSERT_TRUE( index.insert( makeTestRecord(i) ) );
+        }
+
+        // The index is opened by one process at a time
+        EXPECT_THROW( { CacheIndexFile other(filePath, NATRON_CACHE_VERSION); }, std::runtime_error );
+    }
+
+    // Find where each record is stored from its file path, which is followed by its data
+    QFile file( QString::fromUtf8( filePath.c_str() ) );
+    ASSERT_TRUE( file.open(QIODevice::ReadWrite) );
+    QByteArray contents = file.readAll();
+    std::vector<int> recordsBegin(nRecords), recordsEnd(nRecords);
+    for (int i = 0; i < nRecords; ++i) {
+        CacheIndexRecord record = makeTestRecord(i);
+        recordsBegin[i] = contents.indexOf( QByteArray( record.filePath.c_str() ) );
+        ASSERT_GE(recordsBegin[i], 0);
+        recordsEnd[i] = recordsBegin[i] + (int)record.filePath.size() + (int)record.data.size();
+    }
+    std::vector<int> sortedBegins(recordsBegin);
+    std::sort( sortedBegins.begin(), sortedBegins.end() );
+
+    // Cut the file in the middle of a record, and damage a record before the cut
+    const int cut = sortedBegins[nRecords / 2] + 5;
+    const int damaged = (int)( std::find( recordsBegin.begin(), recordsBegin.end(), sortedBegins[nRecords / 4] ) - recordsBegin.begin() );
+    const int damagedByte = recordsEnd[damaged] - 3;
+    char flipped = contents[damagedByte] ^ 0x5a;
+    ASSERT_TRUE( file.seek(damagedByte) );
+    ASSERT_EQ( 1, file.write(&flipped, 1) );
+    ASSERT_TRUE( file.resize(cut) );
+    file.close();
+
+    std::set<int> intact;
+    std::size_t intactSize = 0;
+    for (int i = 0; i < nRecords; ++i) {
+        if ( (i != damaged) && (recordsEnd[i] <= cut) ) {
+            intact.insert(i);
+            intactSize += makeTestRecord(i).size;
+        }
+    }
+    ASSERT_FALSE( intact.empty() );
+
+    {
+        CacheIndexFile index(filePath, NATRON_CACHE_VERSION);
+        EXPECT_EQ( intact.size(), index.getRecordsCount() );
+        EXPECT_EQ( intactSize, index.getTotalSize() );
+        std::set<int> restored;
+        for (int i = 0; i < nRecords; i += 4) {
+            std::list<CacheIndexRecord> records;
+            index.find(makeTestRecord(i).hash, &records);
+            for (std::list<CacheIndexRecord>::iterator it = records.begin(); it != records.end(); ++it) {
+                int j = (int)it->dataOffsetInFile;
+                ASSERT_TRUE( j >= i && j < i + 4 );
+                CacheIndexRecord expected = makeTestRecord(j);
+                EXPECT_EQ(expected.filePath, it->filePath);
+                EXPECT_EQ(expected.data, it->data);
+                restored.insert(j);
+            }
+        }
+        EXPECT_TRUE(restored == intact);
+    }
+    std::remove( filePath.c_str() );
+}
+
+TEST(TileCacheFile, AllocFree)
+{
+    TileCacheFile file;
+
+    file.initTiles(1000);
+    std::set<int> allocated;
+    for (int i = 0; i < 1000; ++i) {
+        int index = file.allocTile();
+        ASSERT_TRUE(index >= 0 && index < 1000);
+        ASSERT_TRUE( allocated.insert(index).second ) << "A tile was allocated twice";
+    }
+    EXPECT_TRUE( file.isFull() );
+    EXPECT_EQ( -1, file.allocTile() );
+
+    file.freeTile(517);
+    EXPECT_FALSE( file.isTileUsed(517) );
+    EXPECT_EQ( 517, file.allocTile() );
+
+    EXPECT_FALSE( file.markTileUsed(3) );
+    file.freeTile(3);
+    EXPECT_TRUE( file.markTileUsed(3) );
+    EXPECT_EQ( (std::size_t)1000, file.getUsedTilesCount() );
+}
+
+namespace {
+void
+allocAndFreeTiles(TileCacheFile* file,
+                  int nTiles,
+                  int nRounds)
+{
+    std::vector<int> tiles(nTiles);
+
+    for (int r = 0; r < nRounds; ++r) {
+        for (int i = 0; i < nTiles; ++i) {
+            tiles[i] = file->allocTile();
+        }
+        for (int i = 0; i < nTiles; ++i) {
+            if (tiles[i] != -1) {
+                file->freeTile(tiles[i]);
+            }
+        }
+    }
+}
+} // anon namespace
+
+namespace {
+void
+allocTiles(TileCacheFile* file,
+           int nTiles,
+           std::vector<int>* tiles)
+{
+    for (int i = 0; i < nTiles; ++i) {
+        tiles->push_back( file->allocTile() );
+    }
+}
+} // anon namespace
+
+TEST(TileCacheFile, ConcurrentAllocFree)
+{
+    const int nThreads = 8;
+    const int nTiles = 1000;
+    TileCacheFile file;
+    file.initTiles(nTiles);
+
+    // Threads allocating all the tiles concurrently never get the same one
+    std::vector<std::vector<int> > tiles(nThreads);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < nThreads; ++i) {
+        threads.push_back( std::thread(allocTiles, &file, nTiles / nThreads, &tiles[i]) );
+    }
+    for (std::size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+    std::set<int> allocated;
+    for (int i = 0; i < nThreads; ++i) {
+        for (std::size_t j = 0; j < tiles[i].size(); ++j) {
+            ASSERT_TRUE(tiles[i][j] >= 0 && tiles[i][j] < nTiles);
+            EXPECT_TRUE( allocated.insert(tiles[i][j]).second ) << "A tile was allocated twice";
+        }
+    }
+    EXPECT_TRUE( file.isFull() );
+
+    // Concurrent allocations and frees leave no tile used
+    for (int i = 0; i < nTiles; ++i) {
+        file.freeTile(i);
+    }
+    threads.clear();
+    for (int i = 0; i < nThreads; ++i) {
+        threads.push_back( std::thread(allocAndFreeTiles, &file, nTiles / nThreads, 16) );
+    }
+    for (std::size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+    EXPECT_EQ( (std::size_t)0, file.getUsedTilesCount() );
+}
+
+// Not a correctness test: prints the time taken to allocate and free millions of tiles, compared to
+// a linear scan of a std::vector<bool> as was done before tiles used a bitmap.
+// Disabled by default, run it with --gtest_also_run_disabled_tests.
+TEST(TileCacheFile, DISABLED_AllocFreeBenchmark)
+{
+    const int nTilesPerFile = NATRON_TILE_CACHE_FILE_SIZE_BYTES / (256 * 256 * 4);
+    // The linear scan is quadratic in the number of tiles, so run it for fewer rounds and compare the time per tile
+    const int nLinearScanRounds = 8;
+    const int nRounds = 256;
+
+    {
+        std::vector<bool> usedTiles(nTilesPerFile, false);
+        std::vector<int> tiles(nTilesPerFile);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int r = 0; r < nLinearScanRounds; ++r) {
+            for (int i = 0; i < nTilesPerFile; ++i) {
+                for (std::size_t t = 0; t < usedTiles.size(); ++t) {
+                    if (!usedTiles[t]) {
+                        usedTiles[t] = true;
+                        tiles[i] = t;
+                        break;
+                    }
+                }
+            }
+            for (int i = 0; i < nTilesPerFile; ++i) {
+                usedTiles[tiles[i]] = false;
+            }
+        }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Linear scan: " << elapsed * 1e9 / ( (double)nLinearScanRounds * nTilesPerFile ) << " ns per tile allocated and freed" << std::endl;
+    }
+
+    for (int nThreads = 1; nThreads <= 16; nThreads *= 4) {
+        TileCacheFile file;
+        file.initTiles(nTilesPerFile);
+
+        std::vector<std::thread> threads;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int i = 0; i < nThreads; ++i) {
+            threads.push_back( std::thread(allocAndFreeTiles, &file, nTilesPerFile / nThreads, nRounds) );
+        }
+        for (std::size_t i = 0; i < threads.size(); ++i) {
+            threads[i].join();
+        }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Bitmap with " << nThreads << " thread(s): " << elapsed * 1e9 / ( (double)nRounds * nTilesPerFile )
+                  << " ns per tile allocated and freed" << std::endl;
+    }
+}
+
+TEST(PlaybackPrefetchWindow, Frames)
+{
+    PlaybackPrefetchWindow window;
+    const int n = PlaybackPrefetchWindow::getWindowSize(24.);
+    EXPECT_EQ(12, n);
+    EXPECT_EQ( 2, PlaybackPrefetchWindow::getWindowSize(0.) );
+    EXPECT_EQ( 32, PlaybackPrefetchWindow::getWindowSize(240.) );
+
+    std::vector<int> frames;
+    window.getFramesToPrefetch(1, true, 24., &frames);
+    ASSERT_EQ( (std::size_t)n, frames.size() );
+    EXPECT_EQ( 2, frames.front() );
+    EXPECT_EQ( 1 + n, frames.back() );
+
+    // Only the frames entering the window are read ahead
+    frames.clear();
+    window.getFramesToPrefetch(3, true, 24., &frames);
+    ASSERT_EQ( (std::size_t)2, frames.size() );
+    EXPECT_EQ( 2 + n, frames[0] );
+    EXPECT_EQ( 3 + n, frames[1] );
+
+    // A frame looked-up late by another playback thread does not restart the window
+    frames.clear();
+    window.getFramesToPrefetch(2, true, 24., &frames);
+    EXPECT_TRUE( frames.empty() );
+
+    // Looping back to the first frame restarts it
+    frames.clear();
+    window.getFramesToPrefetch(100, true, 24., &frames);
+    frames.clear();
+    window.getFramesToPrefetch(1, true, 24., &frames);
+    ASSERT_EQ( (std::size_t)n, frames.size() );
+    EXPECT_EQ( 2, frames.front() );
+
+    // So does a change of direction
+    frames.clear();
+    window.getFramesToPrefetch(5, false, 24., &frames);
+    ASSERT_EQ( (std::size_t)n, frames.size() );
+    EXPECT_EQ( 4, frames.front() );
+    EXPECT_EQ( 5 - n, frames.back() );
+}
+
+namespace {
+ImageKey
+makeTestFrameKey(U64 nodeHash,
+                 double time)
+{
+    return ImageKey(NULL, nodeHash, true, time, ViewIdx(0), 1., false, false);
+}
+
+// Creates the sub-folders in which a cache that is not tiled stores its entries on disk
+void
+makeCacheFolders(const QString& cachePath)
+{
+    QDir cacheFolder(cachePath);
+
+    cacheFolder.mkpath( QString::fromUtf8(".") );
+    for (int i = 0; i < 256; ++i) {
+        cacheFolder.mkdir( QString::fromUtf8("%1").arg(i, 2, 16, QChar::fromLatin1('0')) );
+    }
+}
+} // anon namespace
+
+// The keys predicted from the key of the current frame for the frames of the read-ahead window are those of the
+// images of these frames, and only the entries of these images stored on disk are read ahead
+TEST(Cache, PlaybackPrefetch)
+{
+    const int nFrames = 20;
+    const U64 nodeHash = 42;
+    Cache<Image> cache("CachePrefetchTest", NATRON_CACHE_VERSION, 1024 * 1024 * 1024, 1.);
+    makeCacheFolders( cache.getCachePath() );
+    ImageParamsPtr diskParams = makeTestParams(eStorageModeDisk);
+
+    // Frames 1 to nFrames of the node are cached on disk
+    for (int i = 1; i <= nFrames; ++i) {
+        ImagePtr image;
+        ASSERT_FALSE( cache.getOrCreate(makeTestFrameKey(nodeHash, i), diskParams, NULL, &image) );
+        image->allocateMemory();
+        ASSERT_TRUE( image->isStoredOnDisk() );
+    }
+    // The same frames for another version of the node, e.g. before a parameter changed, and an image held in RAM
+    ImagePtr otherVersion, inRAM;
+    ASSERT_FALSE( cache.getOrCreate(makeTestFrameKey(nodeHash + 1, 2), diskParams, NULL, &otherVersion) );
+    otherVersion->allocateMemory();
+    ASSERT_FALSE( cache.getOrCreate(makeTestFrameKey(nodeHash + 2, 2), makeTestParams(), NULL, &inRAM) );
+    inRAM->allocateMemory();
+
+    const ImageKey currentKey = makeTestFrameKey(nodeHash, 1);
+    PlaybackPrefetchWindow window;
+    std::vector<int> frames;
+    window.getFramesToPrefetch(1, true, 24., &frames);
+    ASSERT_FALSE( frames.empty() );
+    for (std::vector<int>::iterator it = frames.begin(); it != frames.end(); ++it) {
+        ImageKey predicted = currentKey.getKeyAtTime(*it);
+        EXPECT_TRUE( predicted == makeTestFrameKey(nodeHash, *it) ) << "frame " << *it;
+        EXPECT_EQ( makeTestFrameKey(nodeHash, *it).getHash(), predicted.getHash() ) << "frame " << *it;
+        EXPECT_EQ( (std::size_t)(*it <= nFrames ? 1 : 0), cache.prefetch(predicted) ) << "frame " << *it;
+    }
+
+    EXPECT_EQ( (std::size_t)0, cache.prefetch( currentKey.getKeyAtTime(nFrames + 1) ) );
+    EXPECT_EQ( (std::size_t)1, cache.prefetch( makeTestFrameKey(nodeHash + 1, 2) ) );
+    EXPECT_EQ( (std::size_t)0, cache.prefetch( makeTestFrameKey(nodeHash + 2, 2) ) );
+
+    // Reading ahead leaves the images stored on disk
+    std::list<ImagePtr> entries;
+    ASSERT_TRUE( cache.get(makeTestFrameKey(nodeHash, 2), &entries) );
+    ASSERT_EQ( (std::size_t)1, entries.size() );
+    EXPECT_TRUE( entries.front()->isStoredOnDisk() );
+
+    cache.clear();
+    cache.waitForDeleterThread();
+    QDir( cache.getCachePath() ).removeRecursively();
+}
+
+// The key of a viewer texture at another time only differs by its time
+TEST(Cache, PlaybackPrefetchTextureKeys)
+{
+    TextureRect rect(0, 0, 256, 256, 256, 1.);
+    FrameKey key(NULL, 10, 42, (int)eImageBitDepthHalf, 0, ViewIdx(0), rect, 1, "Input1", ImagePlaneDesc::getRGBAComponents(), std::string(), false);
+    FrameKey expected(NULL, 11, 42, (int)eImageBitDepthHalf, 0, ViewIdx(0), rect, 1, "Input1", ImagePlaneDesc::getRGBAComponents(), std::string(), false);
+    FrameKey predicted = key.getKeyAtTime(11);
+
+    EXPECT_TRUE(predicted == expected);
+    EXPECT_EQ( expected.getHash(), predicted.getHash() );
+    EXPECT_NE( key.getHash(), predicted.getHash() );
+}
+
+namespace {
+// Writes the file to disk and evicts its pages from the page cache, as if it was written by a previous session
+void
+dropFromPageCache(const std::string& filePath)
+{
+#if defined(__NATRON_UNIX__) && defined(POSIX_FADV_DONTNEED)
+    int fd = ::open(filePath.c_str(), O_RDONLY);
+    if (fd != -1) {
+        ::fsync(fd);
+        int rc = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        Q_UNUSED(rc);
+        ::close(fd);
+    }
+#else
+    Q_UNUSED(filePath);
+#endif
+}
+
+// Plays the frames back at fps: each frame is mapped and read as the viewer would upload it, then the playback
+// waits for the time of the next frame. Returns the longest time taken to read a frame, in seconds. The first frame
+// cannot be read ahead and is left out of the results.
+double
+playbackFrames(const std::vector<std::string>& files,
+               double fps,
+               bool prefetch,
+               int* nLateFrames)
+{
+    PlaybackPrefetchWindow window;
+    const std::chrono::duration<double> framePeriod(1. / fps);
+    std::chrono::steady_clock::time_point nextFrameTime = std::chrono::steady_clock::now();
+    double maxReadTime = 0.;
+    volatile unsigned char sum = 0;
+
+    *nLateFrames = 0;
+    for (int i = 0; i < (int)files.size(); ++i) {
+        if (prefetch) {
+            std::vector<int> frames;
+            window.getFramesToPrefetch(i, true, fps, &frames);
+            for (std::vector<int>::iterator it = frames.begin(); it != frames.end(); ++it) {
+                if ( *it < (int)files.size() ) {
+                    MemoryFile::prefetchFile(files[*it], 0, 0);
+                }
+            }
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        {
+            MemoryFile file(files[i], MemoryFile::eFileOpenModeEnumIfExistsKeepElseFail);
+            const unsigned char* data = (const unsigned char*)file.data();
+            for (std::size_t j = 0; j < file.size(); j += 4096) {
+                sum += data[j];
+            }
+        }
+        double readTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (i == 0) {
+            // Start the playback clock once the first frame is displayed
+            nextFrameTime = std::chrono::steady_clock::now();
+        } else {
+            maxReadTime = std::max(maxReadTime, readTime);
+            if ( readTime > framePeriod.count() ) {
+                ++*nLateFrames;
+            }
+        }
+
+        nextFrameTime += std::chrono::duration_cast<std::chrono::steady_clock::duration>(framePeriod);
+        std::this_thread::sleep_until(nextFrameTime);
+    }
+    Q_UNUSED(sum);
+
+    return maxReadTime;
+}
+} // anon namespace
+
+// Not a correctness test: plays back at 24 fps a range of frames cached on disk whose pages are not in the
+// page cache, with and without reading ahead the next frames, and prints the longest time taken to read a frame.
+// Disabled by default, run it with --gtest_also_run_disabled_tests.
+TEST(MemoryFile, DISABLED_PlaybackPrefetchBenchmark)
+{
+    const int nFrames = 24;
+    const std::size_t frameSize = 8 * 1024 * 1024;
+    const double fps = 24.;
+    QDir dir( StandardPaths::writableLocation(StandardPaths::eStandardLocationTemp) );
+    dir.mkpath( QString::fromUtf8(".") );
+
+    std::vector<std::string> files;
+    for (int i = 0; i < nFrames; ++i) {
+        std::stringstream ss;
+        ss << "NatronUnitTestPlaybackFrame" << i << "." NATRON_CACHE_FILE_EXT;
+        files.push_back( dir.absoluteFilePath( QString::fromUtf8( ss.str().c_str() ) ).toStdString() );
+        MemoryFile file(files.back(), frameSize, MemoryFile::eFileOpenModeEnumIfExistsTruncateElseCreate);
+        std::memset(file.data(), i, frameSize);
+        file.flush(MemoryFile::eFlushTypeSync, NULL, 0);
+    }
+
+    for (int prefetch = 0; prefetch < 2; ++prefetch) {
+        for (int i = 0; i < nFrames; ++i) {
+            dropFromPageCache(files[i]);
+        }
+        int nLateFrames;
+        double maxReadTime = playbackFrames(files, fps, prefetch == 1, &nLateFrames);
+        std::cout << (prefetch ? "With" : "Without") << " read ahead: " << maxReadTime * 1e3 << " ms to read the slowest frame, "
+                  << nLateFrames << " frame(s) out of " << nFrames - 1 << " read slower than " << fps << " fps" << std::endl;
+    }
+
+    for (int i = 0; i < nFrames; ++i) {
+        std::remove( files[i].c_str() );
+    }
+}
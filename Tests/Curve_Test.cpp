@@ -25,6 +25,12 @@
 
 #include "Global/Macros.h"
 
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 #include <QtCore/QString>
@@ -124,4 +130,224 @@ TEST(Curve, Basic)
     KeyFrame k2(1., 20.);
 }
 
+// Many threads evaluating the same curve while it is being edited, as happens when
+// several render threads read an animated parameter.
+TEST(Curve, ConcurrentReads)
+{
+    const int nKeys = 1000;
+    const int nThreads = 8;
+    const int nReadsPerThread = 50000;
+    Curve c;
+
+    for (int i = 0; i < nKeys; ++i) {
+        c.addKeyFrame( KeyFrame(i, 2. * i) );
+    }
+
+    std::atomic<bool> failed(false);
+    std::atomic<bool> readersDone(false);
+
+    // the writer adds keyframes between the existing ones, which does not change
+    // the value of the curve at the existing keyframes
+    std::thread writer([&c, &readersDone]() {
+        for (int i = 0; i < nKeys - 1 && !readersDone; ++i) {
+            c.addKeyFrame( KeyFrame(i + 0.5, 2. * i + 1.) );
+        }
+    });
+
+    std::vector<std::thread> readers;
+    for (int t = 0; t < nThreads; ++t) {
+        readers.push_back( std::thread([&c, &failed, t]() {
+            unsigned int k = 7919 * (t + 1);
+            for (int i = 0; i < nReadsPerThread; ++i) {
+                k = k * 1103515245 + 12345;
+                int time = (int)( (k >> 8) % nKeys );
+                if ( c.getValueAt(time) != 2. * time ) {
+                    failed = true;
+                }
+            }
+        }) );
+    }
+    for (std::size_t t = 0; t < readers.size(); ++t) {
+        readers[t].join();
+    }
+    readersDone = true;
+    writer.join();
+
+    EXPECT_FALSE(failed);
+    EXPECT_LE( nKeys, c.getKeyFramesCount() );
+}
+
+// Not a correctness test: prints the evaluation throughput of ConcurrentReads above with 1 to 16 reader threads.
+// Disabled by default, run it with --gtest_also_run_disabled_tests.
+TEST(Curve, DISABLED_ConcurrentReadsBenchmark)
+{
+    const int nKeys = 1000;
+    const int nReadsPerThread = 200000;
+    Curve c;
+
+    for (int i = 0; i < nKeys; ++i) {
+        c.addKeyFrame( KeyFrame(i, 2. * i) );
+    }
+
+    for (int nThreads = 1; nThreads <= 16; nThreads *= 2) {
+        std::atomic<bool> failed(false);
+        std::atomic<bool> readersDone(false);
+
+        std::thread writer([&c, &readersDone]() {
+            for (int i = 0; i < nKeys - 1 && !readersDone; ++i) {
+                c.addKeyFrame( KeyFrame(i + 0.5, 2. * i + 1.) );
+            }
+        });
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::vector<std::thread> readers;
+        for (int t = 0; t < nThreads; ++t) {
+            readers.push_back( std::thread([&c, &failed, t]() {
+                unsigned int k = 7919 * (t + 1);
+                for (int i = 0; i < nReadsPerThread; ++i) {
+                    k = k * 1103515245 + 12345;
+                    int time = (int)( (k >> 8) % nKeys );
+                    if ( c.getValueAt(time) != 2. * time ) {
+                        failed = true;
+                    }
+                }
+            }) );
+        }
+        for (std::size_t t = 0; t < readers.size(); ++t) {
+            readers[t].join();
+        }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        readersDone = true;
+        writer.join();
+
+        EXPECT_FALSE(failed);
+        std::cout << "Curve::getValueAt() with " << nThreads << " reader thread(s): "
+                  << (double)nThreads * nReadsPerThread / elapsed << " evaluations/s" << std::endl;
+
+        // remove the keyframes added by the writer
+        KeyFrameSet keys;
+        for (int i = 0; i < nKeys; ++i) {
+            keys.insert( KeyFrame(i, 2. * i) );
+        }
+        c.setKeyframes(keys, true);
+    }
+    EXPECT_EQ( nKeys, c.getKeyFramesCount() );
+}
+
+// Not a correctness test: each addKeyFrame() publishes a copy of the whole curve, so adding keyframes one
+// by one is quadratic, while setKeyframes() publishes once. Prints the time taken by both.
+// Disabled by default, run it with --gtest_also_run_disabled_tests.
+TEST(Curve, DISABLED_AddKeyFramesBenchmark)
+{
+    for (int nKeys = 1000; nKeys <= 16000; nKeys *= 4) {
+        Curve oneByOne;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int i = 0; i < nKeys; ++i) {
+            oneByOne.addKeyFrame( KeyFrame(i, 2. * i) );
+        }
+        double oneByOneElapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        Curve atOnce;
+        start = std::chrono::steady_clock::now();
+        KeyFrameSet keys;
+        for (int i = 0; i < nKeys; ++i) {
+            keys.insert( KeyFrame(i, 2. * i) );
+        }
+        atOnce.setKeyframes(keys, true);
+        double atOnceElapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        EXPECT_EQ( nKeys, oneByOne.getKeyFramesCount() );
+        EXPECT_EQ( nKeys, atOnce.getKeyFramesCount() );
+        std::cout << nKeys << " keyframes: addKeyFrame() " << oneByOneElapsed * 1000. << " ms, setKeyframes() "
+                  << atOnceElapsed * 1000. << " ms" << std::endl;
+    }
+}
+
+// Operations changing many keyframes publish the curve once, at the end: the result must be the same as
+// changing the keyframes one by one.
+TEST(Curve, BatchChanges)
+{
+    const int nKeys = 100;
+    Curve byKey, batch;
+    KeyFrameSet keys;
+
+    for (int i = 0; i < nKeys; ++i) {
+        KeyFrame k(i, (i * 37) % 11);
+        byKey.addKeyFrame(k);
+        keys.insert(k);
+    }
+    batch.setKeyframes(keys, true);
+    EXPECT_EQ( nKeys, batch.getKeyFramesCount() );
+    for (double t = -1.; t <= nKeys; t += 0.25) {
+        EXPECT_EQ( byKey.getValueAt(t), batch.getValueAt(t) ) << "t=" << t;
+    }
+
+    batch.setCurveInterpolation(eKeyframeTypeConstant);
+    for (int i = 0; i < nKeys - 1; ++i) {
+        EXPECT_EQ( (double)( (i * 37) % 11 ), batch.getValueAt(i + 0.5) ) << "t=" << i + 0.5;
+    }
+
+    // smooth() sets all the keyframes in a batch too
+    batch.setCurveInterpolation(eKeyframeTypeLinear);
+    batch.smooth(NULL);
+    EXPECT_EQ( nKeys, batch.getKeyFramesCount() );
+    EXPECT_NE( byKey.getValueAt(50.), batch.getValueAt(50.) );
+}
 
+TEST(Curve, BatchEvaluation)
+{
+    Curve c;
+
+    c.addKeyFrame( KeyFrame(0., 1.) );
+    c.addKeyFrame( KeyFrame(10., -3.) );
+    c.addKeyFrame( KeyFrame(15., 8.) );
+    KeyFrame constantKey(30., 2.);
+    constantKey.setInterpolation(eKeyframeTypeConstant);
+    c.addKeyFrame(constantKey);
+    c.addKeyFrame( KeyFrame(42., 5.) );
+
+    // sorted times, before/after the keyframes and exactly on them
+    const std::size_t n = 1000;
+    std::vector<double> times(n), values(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        times[i] = -10. + i * 0.07;
+    }
+    c.getValuesAt(&times[0], &values[0], n);
+    for (std::size_t i = 0; i < n; ++i) {
+        EXPECT_EQ( c.getValueAt(times[i]), values[i] );
+    }
+
+    // unsorted times
+    for (std::size_t i = 0; i < n; ++i) {
+        times[i] = -10. + ( (i * 7919) % n ) * 0.07;
+    }
+    c.getValuesAt(&times[0], &values[0], n);
+    for (std::size_t i = 0; i < n; ++i) {
+        EXPECT_EQ( c.getValueAt(times[i]), values[i] );
+    }
+
+    // uniform times
+    c.getValuesAtUniformTimes(-10., 0.07, &values[0], n);
+    for (std::size_t i = 0; i < n; ++i) {
+        EXPECT_EQ( c.getValueAt(-10. + i * 0.07), values[i] );
+    }
+
+    // periodic curve
+    Curve p;
+    p.setXRange(0., 20.);
+    p.setPeriodic(true);
+    p.addKeyFrame( KeyFrame(2., 0.) );
+    p.addKeyFrame( KeyFrame(8., 1.) );
+    p.addKeyFrame( KeyFrame(15., -1.) );
+    p.getValuesAtUniformTimes(-30., 0.1, &values[0], n);
+    for (std::size_t i = 0; i < n; ++i) {
+        EXPECT_EQ( p.getValueAt(-30. + i * 0.1), values[i] );
+    }
+
+    // empty curve
+    Curve e;
+    e.getValuesAtUniformTimes(0., 1., &values[0], n);
+    for (std::size_t i = 0; i < n; ++i) {
+        EXPECT_EQ( 0., values[i] );
+    }
+}
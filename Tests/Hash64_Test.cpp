@@ -25,7 +25,12 @@
 
 #include "Global/Macros.h"
 
+#include <chrono>
 #include <cstdlib>
+#include <iostream>
+#include <set>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 #include "Engine/Hash64.h"
@@ -91,3 +96,102 @@ TEST(Hash64,
     EXPECT_NE(hash1, hash2);
 } // TEST
 
+
+TEST(Hash64,
+     Collisions)
+{
+    std::set<U64> hashes;
+
+    // Small consecutive values, as appended for knob values and ages, must not collide
+    for (U64 i = 0; i < 100000; ++i) {
+        Hash64 h;
+        h.append(i);
+        h.computeHash();
+        ASSERT_TRUE( h.valid() );
+        EXPECT_TRUE( hashes.insert( h.value() ).second ) << "Collision for value " << i;
+    }
+
+    // Swapping 2 inputs must change the hash
+    Hash64 ab, ba;
+    ab.append<U64>(1);
+    ab.append<U64>(2);
+    ab.computeHash();
+    ba.append<U64>(2);
+    ba.append<U64>(1);
+    ba.computeHash();
+    EXPECT_NE(ab, ba);
+
+    // Appending more values after computing the hash keeps accumulating
+    Hash64 incremental, full;
+    incremental.append<int>(10);
+    incremental.computeHash();
+    U64 partialHash = incremental.value();
+    incremental.append<int>(20);
+    incremental.computeHash();
+    full.append<int>(10);
+    full.append<int>(20);
+    full.computeHash();
+    EXPECT_NE( partialHash, incremental.value() );
+    EXPECT_EQ(incremental, full);
+
+    // Strings only differing by trailing zeroes must not collide
+    Hash64 s1, s2;
+    const char str[3] = { 'a', 0, 0 };
+    s1.appendBytes(str, 2);
+    s1.computeHash();
+    s2.appendBytes(str, 3);
+    s2.computeHash();
+    EXPECT_NE(s1, s2);
+} // TEST
+
+// Hashes every node of a large synthetic graph, each node hashing its knobs values, its inputs hashes and its name,
+// as Node::computeHashInternal does.
+static void
+hashNodeGraph(int round,
+              std::vector<U64>* nodeHashes)
+{
+    const int nKnobValuesPerNode = 200;
+    const std::string nodeName("Transform12");
+
+    for (int n = 0; n < (int)nodeHashes->size(); ++n) {
+        Hash64 h;
+        for (int k = 0; k < nKnobValuesPerNode; ++k) {
+            h.append<double>(k * 0.5 + round);
+        }
+        // Each node has its 2 previous nodes as inputs
+        for (int i = 1; i <= 2 && n - i >= 0; ++i) {
+            h.append( (*nodeHashes)[n - i] + i );
+        }
+        Hash64_appendStdString(&h, nodeName);
+        h.computeHash();
+        (*nodeHashes)[n] = h.value();
+    }
+}
+
+TEST(Hash64,
+     NodeGraphHashesAreUnique)
+{
+    const int nNodes = 600;
+    std::vector<U64> nodeHashes(nNodes, 0);
+
+    hashNodeGraph(0, &nodeHashes);
+    std::set<U64> uniqueHashes( nodeHashes.begin(), nodeHashes.end() );
+    EXPECT_EQ( (std::size_t)nNodes, uniqueHashes.size() );
+}
+
+// Not a correctness test: prints the time taken to recompute the hash of every node of the graph above.
+// Disabled by default, run it with --gtest_also_run_disabled_tests.
+TEST(Hash64,
+     DISABLED_NodeGraphBenchmark)
+{
+    const int nNodes = 600;
+    const int nRecomputes = 100;
+    std::vector<U64> nodeHashes(nNodes, 0);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int r = 0; r < nRecomputes; ++r) {
+        hashNodeGraph(r, &nodeHashes);
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Hashing a " << nNodes << " nodes graph: " << elapsed * 1e3 / nRecomputes << " ms per recompute" << std::endl;
+}
@@ -0,0 +1,267 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * (C) 2018-2023 The Natron developers
+ * (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include <QtCore/QThread>
+
+#include <gtest/gtest.h>
+
+#include "Engine/HistogramCPU.h"
+#include "Engine/Image.h"
+#include "Engine/ImagePlaneDesc.h"
+
+NATRON_NAMESPACE_USING
+
+static ImagePtr
+makeRGBAImage(const RectI& bounds)
+{
+    return std::make_shared<Image>( ImagePlaneDesc::getRGBAComponents(), RectD(bounds.x1, bounds.y1, bounds.x2, bounds.y2), bounds, 0, 1.,
+                                    eImageBitDepthFloat, eImagePremultiplicationPremultiplied, eImageFieldingOrderNone, true );
+}
+
+TEST(HistogramCPU,
+     BinPixels)
+{
+    srand(2000);
+
+    ///every channel value is at the center of a bin, so that there is no rounding ambiguity
+    const int binsCount = 100;
+    const double vmin = -0.5;
+    const double vmax = 1.5;
+    const double binSize = (vmax - vmin) / binsCount;
+    RectI bounds(-3, 5, 34, 28);
+    ImagePtr image = makeRGBAImage(bounds);
+    std::vector<int> expected(4 * binsCount, 0);
+    {
+        Image::WriteAccess acc = image->getWriteRights();
+        for (int y = bounds.y1; y < bounds.y2; ++y) {
+            float* pix = (float*)acc.pixelAt(bounds.x1, y);
+            for (int x = bounds.x1; x < bounds.x2; ++x, pix += 4) {
+                for (int c = 0; c < 4; ++c) {
+                    // coverity[dont_call]
+                    int bin = rand() % (binsCount + 20) - 10; // some values are out of [vmin, vmax)
+                    pix[c] = (float)( vmin + (bin + 0.5) * binSize );
+                    if ( (0 <= bin) && (bin < binsCount) ) {
+                        ++expected[c * binsCount + bin];
+                    }
+                }
+            }
+        }
+    }
+
+    ///RGB bins the 3 channels in one pass
+    std::vector<U32> rgb(3 * binsCount, 0);
+    U32* rgbBins[3] = { &rgb[0], &rgb[binsCount], &rgb[2 * binsCount] };
+    HistogramCPU::binPixels(image.get(), bounds, 0, binsCount, vmin, vmax, rgbBins);
+    for (int i = 0; i < 3 * binsCount; ++i) {
+        EXPECT_EQ(expected[i], (int)rgb[i]);
+    }
+
+    ///alpha, with a rectangle larger than the image
+    std::vector<U32> alpha(binsCount, 0);
+    U32* alphaBins[3] = { &alpha[0], 0, 0 };
+    HistogramCPU::binPixels(image.get(), RectI(-10, 0, 40, 40), 1, binsCount, vmin, vmax, alphaBins);
+    for (int i = 0; i < binsCount; ++i) {
+        EXPECT_EQ(expected[3 * binsCount + i], (int)alpha[i]);
+    }
+}
+
+///Values below vmin, infinite or NaN are not binned, and must not touch the memory around the bins
+TEST(HistogramCPU,
+     BinPixelsOutOfRange)
+{
+    const int binsCount = 100;
+    const double vmin = 0.;
+    const double vmax = 1.;
+    const float values[] = {
+        -1000.f, -1e30f, std::numeric_limits<float>::quiet_NaN(), -std::numeric_limits<float>::infinity(),
+        std::numeric_limits<float>::infinity(), 1e30f, -0.5f, 0.255f, 0.995f, 1.f, 0.005f
+    };
+    const int nValues = sizeof(values) / sizeof(values[0]);
+    RectI bounds(0, 0, 37, 3);
+    ImagePtr image = makeRGBAImage(bounds);
+    std::vector<int> expected(4 * binsCount, 0);
+    {
+        Image::WriteAccess acc = image->getWriteRights();
+        int i = 0;
+        for (int y = bounds.y1; y < bounds.y2; ++y) {
+            float* pix = (float*)acc.pixelAt(bounds.x1, y);
+            for (int x = bounds.x1; x < bounds.x2; ++x, pix += 4) {
+                for (int c = 0; c < 4; ++c, ++i) {
+                    pix[c] = values[(i * 7) % nValues];
+                    if ( (vmin <= pix[c]) && (pix[c] < vmax) ) {
+                        ++expected[c * binsCount + (int)( (pix[c] - vmin) * binsCount / (vmax - vmin) )];
+                    }
+                }
+            }
+        }
+    }
+
+    ///The histograms of the channels are contiguous, with one guard bin after the last one
+    std::vector<U32> rgb(3 * binsCount + 1, 0);
+    U32* rgbBins[3] = { &rgb[0], &rgb[binsCount], &rgb[2 * binsCount] };
+    HistogramCPU::binPixels(image.get(), bounds, 0, binsCount, vmin, vmax, rgbBins);
+    for (int i = 0; i < 3 * binsCount; ++i) {
+        EXPECT_EQ(expected[i], (int)rgb[i]) << "bin " << i;
+    }
+    EXPECT_EQ(0U, rgb[3 * binsCount]);
+
+    ///The luminance of these values
+    std::vector<U32> y(binsCount + 1, 0);
+    U32* yBins[3] = { &y[0], 0, 0 };
+    HistogramCPU::binPixels(image.get(), bounds, 2, binsCount, vmin, vmax, yBins);
+    EXPECT_EQ(0U, y[binsCount]);
+}
+
+///Computes the histogram of the image in the histogram thread and waits for it, at most 10 seconds
+static bool
+computeHistogramAndWait(HistogramCPU& histogram,
+                        const ImagePtr& image,
+                        std::vector<float>* histogram1)
+{
+    const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+
+    histogram.computeHistogram(0, image, image->getBounds(), 500, 0., 1., 1);
+    while ( !histogram.hasProducedHistogram() ) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            ADD_FAILURE() << "The histogram was not produced within 10 seconds";
+
+            return false;
+        }
+        QThread::msleep(1);
+    }
+    std::vector<float> histogram2, histogram3;
+    unsigned int binsCount, pixelsCount, mipmapLevel;
+    int mode;
+    double vmin, vmax;
+    EXPECT_TRUE( histogram.getMostRecentlyProducedHistogram(histogram1, &histogram2, &histogram3, &binsCount, &pixelsCount, &mode, &vmin, &vmax, &mipmapLevel) );
+    EXPECT_EQ(500U, binsCount);
+
+    return true;
+}
+
+static void
+fillRamp(const ImagePtr& image)
+{
+    const RectI& bounds = image->getBounds();
+    Image::WriteAccess acc = image->getWriteRights();
+    float* pix = (float*)acc.pixelAt(bounds.x1, bounds.y1);
+
+    for (std::size_t i = 0; i < (std::size_t)bounds.area() * 4; ++i) {
+        pix[i] = (float)(i % 1021) / 1021.f;
+    }
+}
+
+///Once the image is rendered, the bins of its bands are reused when it is updated and must give the same histogram
+TEST(HistogramCPU,
+     IncrementalMatchesFull)
+{
+    RectI bounds(0, 0, 1000, 500);
+    ImagePtr image = makeRGBAImage(bounds);
+
+    fillRamp(image);
+
+    HistogramCPU histogram;
+    std::vector<float> full;
+    ASSERT_TRUE( computeHistogramAndWait(histogram, image, &full) );
+    ASSERT_FALSE( full.empty() );
+
+    image->markForRendered(bounds);
+    ASSERT_TRUE( computeHistogramAndWait(histogram, image, &full) );
+    std::vector<float> incremental;
+    ASSERT_TRUE( computeHistogramAndWait(histogram, image, &incremental) );
+    EXPECT_TRUE(full == incremental);
+}
+
+///A band which was not fully rendered is binned again by the next request
+TEST(HistogramCPU,
+     IncrementalRebinsRenderedBands)
+{
+    RectI bounds(0, 0, 1000, 500);
+    ImagePtr image = makeRGBAImage(bounds);
+
+    fillRamp(image);
+
+    // Only the bottom half is rendered: the bands of the top half are incomplete
+    image->markForRendered( RectI(0, 0, 1000, 256) );
+    HistogramCPU histogram;
+    std::vector<float> before;
+    ASSERT_TRUE( computeHistogramAndWait(histogram, image, &before) );
+
+    // Render a band of the top half
+    const RectI band(0, 320, 1000, 384);
+    {
+        Image::WriteAccess acc = image->getWriteRights();
+        for (int y = band.y1; y < band.y2; ++y) {
+            float* pix = (float*)acc.pixelAt(band.x1, y);
+            for (int i = 0; i < band.width() * 4; ++i) {
+                pix[i] = 0.9f;
+            }
+        }
+    }
+    image->markForRendered(band);
+
+    std::vector<float> incremental;
+    ASSERT_TRUE( computeHistogramAndWait(histogram, image, &incremental) );
+    EXPECT_FALSE(before == incremental);
+
+    // Same as the histogram of a new thread, which bins all the bands
+    HistogramCPU other;
+    std::vector<float> full;
+    ASSERT_TRUE( computeHistogramAndWait(other, image, &full) );
+    EXPECT_TRUE(full == incremental);
+}
+
+///Not a correctness test: prints the time taken to compute the histogram of a 4K image, then to update it
+///once the image is rendered. Disabled by default, run it with --gtest_also_run_disabled_tests.
+TEST(HistogramCPU,
+     DISABLED_Benchmark4K)
+{
+    RectI bounds(0, 0, 3840, 2160);
+    ImagePtr image = makeRGBAImage(bounds);
+
+    fillRamp(image);
+
+    HistogramCPU histogram;
+    std::vector<float> full;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    computeHistogramAndWait(histogram, image, &full);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "4K RGB histogram: " << elapsed * 1e3 << " ms" << std::endl;
+
+    image->markForRendered(bounds);
+    computeHistogramAndWait(histogram, image, &full);
+    start = std::chrono::steady_clock::now();
+    computeHistogramAndWait(histogram, image, &full);
+    elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "4K RGB histogram, image unchanged: " << elapsed * 1e3 << " ms" << std::endl;
+}
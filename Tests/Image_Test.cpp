@@ -25,14 +25,40 @@
 
 #include "Global/Macros.h"
 
-#include <cstring>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <vector>
 #include <gtest/gtest.h>
 
+#include "Engine/Half.h"
 #include "Engine/Image.h"
 #include "Engine/ViewIdx.h"
 
 NATRON_NAMESPACE_USING
 
+///returns true if all the pixels of roi are in the given state
+static bool
+bitmapHasOnly(const Bitmap& bm,
+              const RectI& roi,
+              char state)
+{
+    std::vector<char> row( roi.width() );
+
+    for (int y = roi.y1; y < roi.y2; ++y) {
+        bm.getRow(y, roi.x1, roi.x2, &row.front());
+        for (int x = 0; x < roi.width(); ++x) {
+            if (row[x] != state) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
 TEST(BitmapTest,
      SimpleRect)
 {
@@ -52,8 +78,7 @@ TEST(BitmapTest,
     ASSERT_TRUE(rod == nonRenderedRectsUnion);
 
     ///assert that the "underlying" bitmap is clean
-    const char* map = bm.getBitmap();
-    ASSERT_TRUE( !std::memchr( map, 1, rod.area() ) );
+    ASSERT_TRUE( bitmapHasOnly(bm, rod, 0) );
     ASSERT_TRUE( bm.isNonMarked(rod) );
 
     RectI halfRoD(0, 0, 100, 50);
@@ -69,14 +94,12 @@ TEST(BitmapTest,
 
 
     ///assert that the underlying bitmap is marked as expected
-    const char* start = map;
 
     ///check that there are only ones in the rendered half
-    ASSERT_TRUE( !memchr( start, 0, halfRoD.area() ) );
+    ASSERT_TRUE( bitmapHasOnly(bm, halfRoD, 1) );
 
     ///check that there are only 0s in the non rendered half
-    start = map + halfRoD.area();
-    ASSERT_TRUE( !memchr( start, 1, halfRoD.area() ) );
+    ASSERT_TRUE( bitmapHasOnly(bm, nonRenderedHalf, 0) );
 
     ///mark for renderer the other half of the rod
     bm.markForRendered(nonRenderedHalf);
@@ -85,7 +108,7 @@ TEST(BitmapTest,
     nonRenderedRects.clear();
     bm.minimalNonMarkedRects(rod, nonRenderedRects);
     ASSERT_TRUE( nonRenderedRects.empty() );
-    ASSERT_TRUE( !memchr( map, 0, rod.area() ) );
+    ASSERT_TRUE( bitmapHasOnly(bm, rod, 1) );
 
     ///More complex example where A,B,C,D are not rendered check that both trimap & bitmap yield the same result
     // BBBBBBBBBBBBBB
@@ -117,6 +140,187 @@ TEST(BitmapTest,
     EXPECT_TRUE(nonRenderedRects.size() == 3);
 } // TEST
 
+///A bitmap storing the state of each pixel, to check the tiled Bitmap against
+struct ReferenceBitmap
+{
+    RectI bounds;
+    std::vector<char> pixels;
+
+    ReferenceBitmap(const RectI& bounds)
+        : bounds(bounds)
+        , pixels(bounds.area(), 0)
+    {
+    }
+
+    char& at(int x,
+             int y)
+    {
+        return pixels[(y - bounds.y1) * bounds.width() + (x - bounds.x1)];
+    }
+
+    void markFor(const RectI& roi,
+                 char value)
+    {
+        RectI r = roi.intersect(bounds);
+
+        for (int y = r.y1; y < r.y2; ++y) {
+            for (int x = r.x1; x < r.x2; ++x) {
+                at(x, y) = value;
+            }
+        }
+    }
+};
+
+static bool
+bitmapEquals(const Bitmap& bm,
+             ReferenceBitmap& ref)
+{
+    std::vector<char> row( ref.bounds.width() );
+
+    for (int y = ref.bounds.y1; y < ref.bounds.y2; ++y) {
+        bm.getRow(y, ref.bounds.x1, ref.bounds.x2, &row.front());
+        for (int x = ref.bounds.x1; x < ref.bounds.x2; ++x) {
+            if ( row[x - ref.bounds.x1] != ref.at(x, y) ) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static bool
+rectsContain(const std::list<RectI>& rects,
+             int x,
+             int y)
+{
+    for (std::list<RectI>::const_iterator it = rects.begin(); it != rects.end(); ++it) {
+        if ( it->contains(x, y) ) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static RectI
+randomRect(const RectI& bounds)
+{
+    // coverity[dont_call]
+    int x1 = bounds.x1 - 10 + rand() % (bounds.width() + 20);
+    // coverity[dont_call]
+    int y1 = bounds.y1 - 10 + rand() % (bounds.height() + 20);
+    // coverity[dont_call]
+    int w = rand() % 150;
+    // coverity[dont_call]
+    int h = rand() % 150;
+
+    return RectI(x1, y1, x1 + w, y1 + h);
+}
+
+TEST(BitmapTest,
+     Tiles)
+{
+    srand(2000);
+
+    ///bounds that are neither aligned on the tiles nor a multiple of the tile size
+    RectI rod(-37, 11, 263, 211);
+    Bitmap bm(rod);
+    ReferenceBitmap ref(rod);
+
+    for (int i = 0; i < 200; ++i) {
+        RectI r = randomRect(rod);
+        // coverity[dont_call]
+        int op = rand() % 3;
+        if (op == 0) {
+            bm.markForRendered(r);
+            ref.markFor(r, 1);
+        } else if (op == 1) {
+            bm.clear(r);
+            ref.markFor(r, 0);
+        } else {
+            bm.markForRendering(r);
+            ref.markFor(r, 2);
+        }
+        ASSERT_TRUE( bitmapEquals(bm, ref) );
+
+        ///the rects to render must cover all the non rendered pixels, with and without the trimap
+        RectI roi = randomRect(rod);
+        std::list<RectI> rects;
+        std::list<RectI> trimapRects;
+        bool beingRenderedElseWhere = false;
+        bm.minimalNonMarkedRects(roi, rects);
+        bm.minimalNonMarkedRects_trimap(roi, trimapRects, &beingRenderedElseWhere);
+        RectI clippedRoI = roi.intersect(rod);
+        bool nonMarked = true;
+        for (int y = clippedRoI.y1; y < clippedRoI.y2; ++y) {
+            for (int x = clippedRoI.x1; x < clippedRoI.x2; ++x) {
+                if (ref.at(x, y) != 0) {
+                    nonMarked = false;
+                } else {
+                    ASSERT_TRUE( rectsContain(rects, x, y) );
+                    ASSERT_TRUE( rectsContain(trimapRects, x, y) );
+                }
+            }
+        }
+        EXPECT_EQ( nonMarked, bm.isNonMarked(roi) );
+    }
+
+    ///copy with tiles that are aligned, then not aligned
+    RectI alignedBounds(rod.x1 + NATRON_BITMAP_TILE_SIZE, rod.y1, rod.x2 + NATRON_BITMAP_TILE_SIZE, rod.y2);
+    RectI unalignedBounds(rod.x1 + 5, rod.y1 - 3, rod.x2 + 5, rod.y2 - 3);
+    RectI bounds[2] = { alignedBounds, unalignedBounds };
+    for (int i = 0; i < 2; ++i) {
+        Bitmap copy(bounds[i]);
+        ReferenceBitmap copyRef(bounds[i]);
+        RectI roi = bounds[i].intersect(rod);
+        copy.copyBitmapPortion(roi, bm);
+        for (int y = roi.y1; y < roi.y2; ++y) {
+            for (int x = roi.x1; x < roi.x2; ++x) {
+                copyRef.at(x, y) = ref.at(x, y);
+            }
+        }
+        ASSERT_TRUE( bitmapEquals(copy, copyRef) );
+    }
+
+    ///a pixel of the half scale bitmap is rendered if all the pixels it covers are rendered
+    RectI halfRoD(-18, 6, 131, 105);
+    Bitmap half(halfRoD);
+    ReferenceBitmap halfRef(halfRoD);
+    RectI halfRoI(-18, 6, 131, 105);
+    half.halveFrom(bm, halfRoI);
+    for (int y = halfRoI.y1; y < halfRoI.y2; ++y) {
+        for (int x = halfRoI.x1; x < halfRoI.x2; ++x) {
+            bool rendered = true;
+            for (int j = 0; j < 2; ++j) {
+                for (int i = 0; i < 2; ++i) {
+                    if ( rod.contains(x * 2 + i, y * 2 + j) && (ref.at(x * 2 + i, y * 2 + j) != 1) ) {
+                        rendered = false;
+                    }
+                }
+            }
+            halfRef.at(x, y) = rendered ? 1 : 0;
+        }
+    }
+    ASSERT_TRUE( bitmapEquals(half, halfRef) );
+
+    ///the bitmap of a large image only stores the state of each tile
+    Bitmap large( RectI(0, 0, 8192, 8192) );
+    EXPECT_TRUE( large.getMemorySize() < (std::size_t)8192 * 8192 / 100 );
+    large.markForRendered( RectI(10, 10, 5000, 5000) );
+    std::list<RectI> rects;
+    large.minimalNonMarkedRects(RectI(0, 0, 8192, 8192), rects);
+    RectI rectsUnion;
+    for (std::list<RectI>::iterator it = rects.begin(); it != rects.end(); ++it) {
+        rectsUnion.merge(*it);
+    }
+    EXPECT_TRUE( rectsUnion == RectI(0, 0, 8192, 8192) );
+    large.markForRendered( RectI(0, 0, 8192, 8192) );
+    rects.clear();
+    large.minimalNonMarkedRects(RectI(0, 0, 8192, 8192), rects);
+    EXPECT_TRUE( rects.empty() );
+} // TEST
+
 TEST(ImageKeyTest, Equality) {
     srand(2000);
     // coverity[dont_call]
@@ -160,3 +364,144 @@ TEST(ImageKeyTest, Difference) {
     ASSERT_TRUE(keyHash1 != keyHash2);
 }
 
+
+TEST(HalfTest, Conversions) {
+    // values that are exactly representable as halfs convert back unchanged
+    const float exact[] = { 0.f, -0.f, 1.f, -2.f, 0.5f, 65504.f, 6.103515625e-05f, 5.9604644775390625e-08f };
+    for (std::size_t i = 0; i < sizeof(exact) / sizeof(exact[0]); ++i) {
+        EXPECT_EQ( exact[i], (float)Half(exact[i]) );
+    }
+    EXPECT_EQ( 0x3c00, Half(1.f).bits() );
+    EXPECT_EQ( 0xc000, Half(-2.f).bits() );
+
+    // rounding to the nearest half, ties to even
+    EXPECT_EQ( 0x3c00, Half(1.f + 1.f / 4096).bits() );
+    EXPECT_EQ( 0x3c02, Half(1.f + 3.f / 2048).bits() );
+
+    // overflow to infinity and NaNs
+    EXPECT_EQ( 0x7c00, Half(65520.f).bits() );
+    EXPECT_TRUE( Half( std::numeric_limits<float>::quiet_NaN() ).isNan() );
+    EXPECT_FALSE( Half( std::numeric_limits<float>::infinity() ).isNan() );
+
+    // the bulk conversions give the same results as the scalar ones, including the unaligned tail
+    std::vector<float> src(1003);
+    for (std::size_t i = 0; i < src.size(); ++i) {
+        src[i] = ( (float)i - 500.f ) * 0.37f;
+    }
+    std::vector<Half> halfs( src.size() );
+    std::vector<float> dst( src.size() );
+    convertFloatToHalf( &src.front(), &halfs.front(), src.size() );
+    convertHalfToFloat( &halfs.front(), &dst.front(), src.size() );
+    for (std::size_t i = 0; i < src.size(); ++i) {
+        EXPECT_EQ( Half(src[i]).bits(), halfs[i].bits() );
+        EXPECT_EQ( (float)Half(src[i]), dst[i] );
+    }
+}
+
+TEST(ImageTest, DownscaleMipmapPixels) {
+    srand(2000);
+
+    ///a constant image stays constant, even on the edges of a region which is not aligned on the levels
+    RectI bounds(-37, 11, 263, 211);
+    RectI roi(-35, 12, 251, 207);
+    const unsigned int levels = 3;
+    RectI lastLevel = roi.downscalePowerOfTwoSmallestEnclosing(levels);
+    for (int nComps = 1; nComps <= 4; ++nComps) {
+        std::vector<float> src(bounds.area() * nComps, 0.75f);
+        std::vector<float> dst(lastLevel.area() * nComps, 0.f);
+        Image::downscaleMipmapPixels(eImageBitDepthFloat, nComps, &src.front(), bounds, roi, levels, &dst.front(), lastLevel);
+        for (std::size_t i = 0; i < dst.size(); ++i) {
+            EXPECT_EQ(0.75f, dst[i]);
+        }
+    }
+
+    ///each level is the average of the 2x2 pixels of the previous level, with an integer division for integer depths
+    std::vector<unsigned char> src(bounds.area() * 4);
+    for (std::size_t i = 0; i < src.size(); ++i) {
+        // coverity[dont_call]
+        src[i] = (unsigned char)(rand() % 256);
+    }
+    std::vector<unsigned char> level( src.begin(), src.end() );
+    RectI levelBounds = bounds;
+    for (unsigned int l = 0; l < levels; ++l) {
+        RectI halfBounds = levelBounds.downscalePowerOfTwoSmallestEnclosing(1);
+        std::vector<unsigned char> half(halfBounds.area() * 4);
+        for (int y = halfBounds.y1; y < halfBounds.y2; ++y) {
+            for (int x = halfBounds.x1; x < halfBounds.x2; ++x) {
+                for (int k = 0; k < 4; ++k) {
+                    int sum = 0;
+                    int count = 0;
+                    for (int j = 0; j < 2; ++j) {
+                        for (int i = 0; i < 2; ++i) {
+                            if ( levelBounds.contains(x * 2 + i, y * 2 + j) ) {
+                                sum += level[( (y * 2 + j - levelBounds.y1) * levelBounds.width() + (x * 2 + i - levelBounds.x1) ) * 4 + k];
+                                ++count;
+                            }
+                        }
+                    }
+                    half[( (y - halfBounds.y1) * halfBounds.width() + (x - halfBounds.x1) ) * 4 + k] = (unsigned char)(sum / count);
+                }
+            }
+        }
+        level.swap(half);
+        levelBounds = halfBounds;
+    }
+    std::vector<unsigned char> dst(levelBounds.area() * 4);
+    Image::downscaleMipmapPixels(eImageBitDepthByte, 4, &src.front(), bounds, bounds, levels, &dst.front(), levelBounds);
+    EXPECT_TRUE(dst == level);
+}
+
+TEST(BitmapTest, DownscaleFrom) {
+    srand(2000);
+
+    ///downscaling several levels at once gives the same result as halving each level
+    RectI rod(-37, 11, 263, 211);
+    Bitmap bm(rod);
+    for (int i = 0; i < 50; ++i) {
+        // coverity[dont_call]
+        if (rand() % 2) {
+            bm.markForRendered( randomRect(rod) );
+        } else {
+            bm.markForRendering( randomRect(rod) );
+        }
+    }
+    RectI levelBounds = rod;
+    std::unique_ptr<Bitmap> level;
+    for (unsigned int l = 1; l <= 3; ++l) {
+        RectI halfBounds = levelBounds.downscalePowerOfTwoSmallestEnclosing(1);
+        std::unique_ptr<Bitmap> half( new Bitmap(halfBounds) );
+        half->halveFrom(level ? *level : bm, halfBounds);
+        level.swap(half);
+        levelBounds = halfBounds;
+    }
+    Bitmap downscaled(levelBounds);
+    downscaled.downscaleFrom(bm, rod, 3, levelBounds);
+    std::vector<char> row( levelBounds.width() );
+    std::vector<char> refRow( levelBounds.width() );
+    for (int y = levelBounds.y1; y < levelBounds.y2; ++y) {
+        downscaled.getRow(y, levelBounds.x1, levelBounds.x2, &row.front());
+        level->getRow(y, levelBounds.x1, levelBounds.x2, &refRow.front());
+        EXPECT_TRUE(row == refRow);
+    }
+}
+
+///Not a correctness test: prints the time taken to downscale a UHD RGBA float image to 1/4 scale,
+///as when rendering the viewer at a lower mipmap level. The result is checked by DownscaleMipmapPixels.
+///Disabled by default, run it with --gtest_also_run_disabled_tests.
+TEST(ImageTest, DISABLED_DownscaleMipmapPixelsBenchmark) {
+    RectI bounds(0, 0, 3840, 2160);
+    const unsigned int levels = 2;
+    RectI lastLevel = bounds.downscalePowerOfTwoSmallestEnclosing(levels);
+    std::vector<float> src(bounds.area() * 4);
+    for (std::size_t i = 0; i < src.size(); ++i) {
+        src[i] = (float)(i % 1021) / 1021.f;
+    }
+    std::vector<float> dst(lastLevel.area() * 4);
+    const int nRuns = 10;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < nRuns; ++i) {
+        Image::downscaleMipmapPixels(eImageBitDepthFloat, 4, &src.front(), bounds, bounds, levels, &dst.front(), lastLevel);
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "UHD RGBA float to mipmap level " << levels << ": " << elapsed * 1e3 / nRuns << " ms" << std::endl;
+}
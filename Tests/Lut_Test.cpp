@@ -25,9 +25,17 @@
 
 #include "Global/Macros.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <cstdlib>
+#include <iostream>
+#include <vector>
+
 #include <gtest/gtest.h>
 #include "Engine/Lut.h"
+#include "Engine/RectI.h"
+#include "Engine/ViewerDisplayTransform.h"
 
 NATRON_NAMESPACE_USING
 using namespace NATRON_NAMESPACE::Color;
@@ -52,3 +60,213 @@ TEST(Lut, IntConversions) {
         EXPECT_EQ( i, uint8xxToChar( charToUint8xx(i) ) );
     }
 }
+
+static std::vector<float>
+makeGammaLut(double gamma,
+             int intervals)
+{
+    std::vector<float> lut(intervals + 1);
+
+    for (int i = 0; i <= intervals; ++i) {
+        lut[i] = (float)std::max( 0., std::min( 1., std::pow(double(i) / intervals, 1. / gamma) ) );
+    }
+
+    return lut;
+}
+
+// All implementations supported by the CPU must give the same texels as the scalar one
+TEST(ViewerDisplayTransform, ImplementationsMatch) {
+    const std::size_t nPixels = 100003;
+    std::vector<float> src(nPixels * 4);
+
+    srand(2);
+    for (std::size_t i = 0; i < src.size(); ++i) {
+        src[i] = rand() / (float)RAND_MAX * 2.5f - 0.5f;
+    }
+    // values at the boundaries of the gamma and colorspace luts
+    const float special[] = { 0.f, -0.f, 1.f, 0.5f, 1e-30f, -1e-30f, 1.0000001f, 0.9999999f, INFINITY, -INFINITY };
+    std::copy( special, special + sizeof(special) / sizeof(special[0]), src.begin() );
+
+    const int intervals = 1023;
+    const double gammas[] = { 1., 2.2, 0.45, 0., -1. };
+    const Lut* colorSpaces[] = { 0, LutManager::sRGBLut(), LutManager::Rec709Lut(), LutManager::CineonLut() };
+    const ViewerDisplayTransform::ImplementationEnum best = ViewerDisplayTransform::getBestImplementation();
+    std::vector<U32> reference(nPixels), texels(nPixels);
+
+    for (std::size_t g = 0; g < sizeof(gammas) / sizeof(gammas[0]); ++g) {
+        std::vector<float> gammaLut = makeGammaLut(gammas[g] > 0 ? gammas[g] : 1., intervals);
+        for (std::size_t c = 0; c < sizeof(colorSpaces) / sizeof(colorSpaces[0]); ++c) {
+            if (colorSpaces[c]) {
+                colorSpaces[c]->validate();
+            }
+            ViewerDisplayTransform transform(1.7, -0.05, gammas[g], &gammaLut.front(), intervals, colorSpaces[c]);
+            transform.applyScalar(&src.front(), nPixels, &reference.front());
+            for (int impl = ViewerDisplayTransform::eImplementationSSE41; impl <= best; ++impl) {
+                transform.apply( (ViewerDisplayTransform::ImplementationEnum)impl, &src.front(), nPixels, &texels.front() );
+                for (std::size_t i = 0; i < nPixels; ++i) {
+                    ASSERT_EQ(reference[i], texels[i]) << "implementation " << impl << " gamma " << gammas[g] << " colorspace " << c << " pixel " << i;
+                }
+            }
+        }
+    }
+}
+
+TEST(ViewerDisplayTransform, Texels) {
+    const float src[8] = { 0.f, 0.5f, 1.f, 1.f, 2.f, -1.f, 0.25f, 0.5f };
+    U32 dst[2];
+    ViewerDisplayTransform linear(1., 0., 1., 0, 0, 0);
+
+    linear.apply(src, 2, dst);
+    // A R G B from the high byte
+    EXPECT_EQ(0xff0080ffU, dst[0]);
+    EXPECT_EQ(0x80ff0040U, dst[1]);
+
+    const Lut* sRGB = LutManager::sRGBLut();
+    sRGB->validate();
+    ViewerDisplayTransform display(1., 0., 1., 0, 0, sRGB);
+    display.apply(src, 2, dst);
+    EXPECT_EQ( (U32)sRGB->toColorSpaceUint8FromLinearFloatFast(0.5f) << 8, dst[0] & 0xff00 );
+}
+
+// Not a correctness test: prints the throughput of the conversion of a 4K linear RGBA float image to an 8bit sRGB texture.
+// Disabled by default, run it with --gtest_also_run_disabled_tests.
+TEST(ViewerDisplayTransform, DISABLED_Benchmark4K) {
+    const std::size_t nPixels = 3840 * 2160;
+    std::vector<float> src(nPixels * 4);
+
+    for (std::size_t i = 0; i < src.size(); ++i) {
+        src[i] = (i % 1031) / 1030.f * 1.2f;
+    }
+    std::vector<float> gammaLut = makeGammaLut(2.2, 1023);
+    const Lut* sRGB = LutManager::sRGBLut();
+    sRGB->validate();
+    ViewerDisplayTransform transform(1.2, 0., 2.2, &gammaLut.front(), 1023, sRGB);
+    std::vector<U32> texels(nPixels);
+    const char* names[] = { "scalar", "SSE4.1", "AVX2" };
+    for (int impl = ViewerDisplayTransform::eImplementationScalar; impl <= ViewerDisplayTransform::getBestImplementation(); ++impl) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        transform.apply( (ViewerDisplayTransform::ImplementationEnum)impl, &src.front(), nPixels, &texels.front() );
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "4K RGBA float to 8bit, " << names[impl] << ": " << elapsed * 1e3 << " ms, "
+                  << nPixels / elapsed / 1e6 << " Mpixels/s" << std::endl;
+    }
+}
+
+// The vectorized pow() of the sRGB and Rec.709 conversions has a relative error below 1e-6
+static bool
+nearlyEqual(float reference,
+            float value)
+{
+    if ( std::isnan(reference) ) {
+        return std::isnan(value);
+    }
+    if (reference == value) {
+        return true;
+    }
+
+    return std::abs(reference - value) <= 2e-6f * std::max( 1.f, std::abs(reference) );
+}
+
+// All implementations of the Lut conversions supported by the CPU must give the same bytes as the scalar one,
+// and floats within the tolerance of the vectorized pow()
+TEST(Lut, ImplementationsMatch) {
+    const int width = 1001, height = 7;
+    const RectI bounds(0, 0, width, height);
+    const std::size_t nPixels = (std::size_t)width * height;
+    std::vector<float> src(nPixels * 4);
+
+    srand(2);
+    for (std::size_t i = 0; i < src.size(); ++i) {
+        src[i] = rand() / (float)RAND_MAX * 2.5f - 0.5f;
+    }
+    // values at the boundaries of the linear segments and of the colorspace luts
+    const float special[] = { 0.f, -0.f, 1.f, 0.5f, 1e-30f, -1e-30f, 1.0000001f, 0.9999999f, 0.0031308f, 0.04045f, 0.0181f, 0.08145f };
+    std::copy( special, special + sizeof(special) / sizeof(special[0]), src.begin() );
+
+    const Lut* luts[] = { LutManager::sRGBLut(), LutManager::Rec709Lut(), LutManager::CineonLut() };
+    const LutImplementationEnum best = getBestLutImplementation();
+    std::vector<unsigned char> refBytes(nPixels * 4), bytes(nPixels * 4);
+    std::vector<float> refFloats(nPixels * 4), floats(nPixels * 4);
+    std::vector<float> refFromBytes(nPixels * 4), fromBytes(nPixels * 4);
+
+    for (std::size_t l = 0; l < sizeof(luts) / sizeof(luts[0]); ++l) {
+        for (int premult = 0; premult < 2; ++premult) {
+            for (int toColorSpace = 0; toColorSpace < 2; ++toColorSpace) {
+                setLutImplementation(eLutImplementationScalar);
+                luts[l]->to_byte_packed(&refBytes.front(), &src.front(), bounds, bounds, bounds, ePixelPackingRGBA, ePixelPackingBGRA, true, premult);
+                luts[l]->from_byte_packed(&refFromBytes.front(), &refBytes.front(), bounds, bounds, bounds, ePixelPackingBGRA, ePixelPackingRGBA, true, premult);
+                if (toColorSpace) {
+                    luts[l]->to_float_packed(&refFloats.front(), &src.front(), bounds, bounds, bounds, ePixelPackingRGBA, ePixelPackingRGBA, true, premult);
+                } else {
+                    luts[l]->from_float_packed(&refFloats.front(), &src.front(), bounds, bounds, bounds, ePixelPackingRGBA, ePixelPackingRGBA, true, premult);
+                }
+                for (int impl = eLutImplementationSSE2; impl <= best; ++impl) {
+                    setLutImplementation( (LutImplementationEnum)impl );
+                    luts[l]->to_byte_packed(&bytes.front(), &src.front(), bounds, bounds, bounds, ePixelPackingRGBA, ePixelPackingBGRA, true, premult);
+                    luts[l]->from_byte_packed(&fromBytes.front(), &refBytes.front(), bounds, bounds, bounds, ePixelPackingBGRA, ePixelPackingRGBA, true, premult);
+                    if (toColorSpace) {
+                        luts[l]->to_float_packed(&floats.front(), &src.front(), bounds, bounds, bounds, ePixelPackingRGBA, ePixelPackingRGBA, true, premult);
+                    } else {
+                        luts[l]->from_float_packed(&floats.front(), &src.front(), bounds, bounds, bounds, ePixelPackingRGBA, ePixelPackingRGBA, true, premult);
+                    }
+                    for (std::size_t i = 0; i < nPixels * 4; ++i) {
+                        ASSERT_EQ(refBytes[i], bytes[i]) << "implementation " << impl << " lut " << luts[l]->getName() << " premult " << premult << " value " << i;
+                        ASSERT_EQ(refFromBytes[i], fromBytes[i]) << "implementation " << impl << " lut " << luts[l]->getName() << " premult " << premult << " value " << i;
+                        ASSERT_TRUE( nearlyEqual(refFloats[i], floats[i]) ) << refFloats[i] << " != " << floats[i]
+                                                                            << " implementation " << impl << " lut " << luts[l]->getName() << " premult " << premult << " to " << toColorSpace << " value " << i;
+                    }
+                }
+            }
+        }
+
+        // the planar conversions of one channel of a packed row, as done by the viewer
+        setLutImplementation(eLutImplementationScalar);
+        luts[l]->to_float_planar(&refFloats.front(), &src.front(), (int)src.size(), &src[3], 4, 4);
+        luts[l]->from_float_planar(&refFloats[1], &src[1], (int)src.size() - 1, 0, 4, 4);
+        for (int impl = eLutImplementationSSE2; impl <= best; ++impl) {
+            setLutImplementation( (LutImplementationEnum)impl );
+            luts[l]->to_float_planar(&floats.front(), &src.front(), (int)src.size(), &src[3], 4, 4);
+            luts[l]->from_float_planar(&floats[1], &src[1], (int)src.size() - 1, 0, 4, 4);
+            for (std::size_t i = 0; i < nPixels * 4; i += 4) {
+                ASSERT_TRUE( nearlyEqual(refFloats[i], floats[i]) ) << refFloats[i] << " != " << floats[i] << " implementation " << impl << " lut " << luts[l]->getName() << " value " << i;
+                ASSERT_TRUE( nearlyEqual(refFloats[i + 1], floats[i + 1]) ) << refFloats[i + 1] << " != " << floats[i + 1] << " implementation " << impl << " lut " << luts[l]->getName() << " value " << i;
+            }
+        }
+    }
+    setLutImplementation(best);
+}
+
+// Not a correctness test: prints the throughput of the conversions of a 4K RGBA float image with the sRGB Lut.
+// Disabled by default, run it with --gtest_also_run_disabled_tests.
+TEST(Lut, DISABLED_Benchmark4K) {
+    const RectI bounds(0, 0, 3840, 2160);
+    const std::size_t nPixels = (std::size_t)bounds.area();
+    std::vector<float> src(nPixels * 4), floats(nPixels * 4);
+    std::vector<unsigned char> bytes(nPixels * 4);
+
+    for (std::size_t i = 0; i < src.size(); ++i) {
+        src[i] = (i % 1031) / 1030.f * 1.2f;
+    }
+    const Lut* sRGB = LutManager::sRGBLut();
+    sRGB->validate();
+    // touch the destination buffers before timing
+    sRGB->to_byte_packed(&bytes.front(), &src.front(), bounds, bounds, bounds, ePixelPackingRGBA, ePixelPackingBGRA, true, true);
+    sRGB->to_float_packed(&floats.front(), &src.front(), bounds, bounds, bounds, ePixelPackingRGBA, ePixelPackingRGBA, true, false);
+    const char* names[] = { "scalar", "SSE2", "AVX2" };
+    const LutImplementationEnum best = getBestLutImplementation();
+    for (int impl = eLutImplementationScalar; impl <= best; ++impl) {
+        setLutImplementation( (LutImplementationEnum)impl );
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        sRGB->to_byte_packed(&bytes.front(), &src.front(), bounds, bounds, bounds, ePixelPackingRGBA, ePixelPackingBGRA, true, true);
+        double toByte = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        start = std::chrono::steady_clock::now();
+        sRGB->to_float_packed(&floats.front(), &src.front(), bounds, bounds, bounds, ePixelPackingRGBA, ePixelPackingRGBA, true, false);
+        double toFloat = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        start = std::chrono::steady_clock::now();
+        sRGB->from_float_packed(&floats.front(), &src.front(), bounds, bounds, bounds, ePixelPackingRGBA, ePixelPackingRGBA, true, true);
+        double fromFloat = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "4K RGBA sRGB, " << names[impl] << ": to 8bit " << toByte * 1e3 << " ms, to float " << toFloat * 1e3
+                  << " ms, from float " << fromFloat * 1e3 << " ms" << std::endl;
+    }
+    setLutImplementation(best);
+}
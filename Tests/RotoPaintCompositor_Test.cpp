@@ -0,0 +1,237 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * (C) 2018-2023 The Natron developers
+ * (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "Engine/RectI.h"
+#include "Engine/RotoPaintCompositor.h"
+
+NATRON_NAMESPACE_USING
+
+// An RGBA image filled with the given color
+static std::vector<float>
+makeImage(const RectI& bounds,
+          float r,
+          float g,
+          float b,
+          float a)
+{
+    std::vector<float> pixels( (std::size_t)bounds.area() * 4 );
+
+    for (std::size_t i = 0; i < pixels.size(); i += 4) {
+        pixels[i] = r;
+        pixels[i + 1] = g;
+        pixels[i + 2] = b;
+        pixels[i + 3] = a;
+    }
+
+    return pixels;
+}
+
+static const float*
+pixelAt(const std::vector<float>& pixels,
+        const RectI& bounds,
+        int x,
+        int y)
+{
+    return &pixels[( (std::size_t)(y - bounds.y1) * bounds.width() + (x - bounds.x1) ) * 4];
+}
+
+static std::vector<float>
+composite(const RotoPaintCompositor& compositor,
+          const std::vector<float>& upstream,
+          const RectI& upstreamBounds,
+          const RectI& roi)
+{
+    std::vector<float> dst( (std::size_t)roi.area() * 4, -1.f );
+
+    compositor.composite(upstream.empty() ? 0 : &upstream[0], upstreamBounds, roi, &dst[0]);
+
+    return dst;
+}
+
+TEST(RotoPaintCompositor, ShapeOver) {
+    const RectI roi(0, 0, 20, 10);
+    const std::vector<float> upstream = makeImage(roi, 0.2f, 0.4f, 0.6f, 1.f);
+    const RectI shapeBounds(5, 2, 10, 8);
+    // premultiplied by an alpha of 0.5
+    const std::vector<float> shape = makeImage(shapeBounds, 0.5f, 0.f, 0.25f, 0.5f);
+    RotoPaintCompositor compositor;
+
+    compositor.addShapeLayer(eMergeOver, &shape[0], shapeBounds);
+    std::vector<float> dst = composite(compositor, upstream, roi, roi);
+
+    const float* inside = pixelAt(dst, roi, 7, 5);
+    EXPECT_FLOAT_EQ(0.5f + 0.2f * 0.5f, inside[0]);
+    EXPECT_FLOAT_EQ(0.4f * 0.5f, inside[1]);
+    EXPECT_FLOAT_EQ(0.25f + 0.6f * 0.5f, inside[2]);
+    EXPECT_FLOAT_EQ(1.f, inside[3]);
+    // over leaves the pixels outside of the shape alone
+    const float* outside = pixelAt(dst, roi, 15, 5);
+    EXPECT_FLOAT_EQ(0.2f, outside[0]);
+    EXPECT_FLOAT_EQ(1.f, outside[3]);
+}
+
+TEST(RotoPaintCompositor, TransparentShapeOutsideOfBounds) {
+    const RectI roi(0, 0, 20, 10);
+    const std::vector<float> upstream = makeImage(roi, 0.5f, 0.5f, 0.5f, 1.f);
+    const RectI shapeBounds(5, 2, 10, 8);
+    const std::vector<float> shape = makeImage(shapeBounds, 1.f, 1.f, 1.f, 1.f);
+    RotoPaintCompositor compositor;
+
+    // just like the Merge node, multiply and in clear B where A is transparent
+    compositor.addShapeLayer(eMergeMultiply, &shape[0], shapeBounds);
+    std::vector<float> dst = composite(compositor, upstream, roi, roi);
+    EXPECT_FLOAT_EQ(0.5f, pixelAt(dst, roi, 7, 5)[0]);
+    EXPECT_FLOAT_EQ(0.f, pixelAt(dst, roi, 15, 5)[0]);
+    EXPECT_FLOAT_EQ(0.f, pixelAt(dst, roi, 7, 9)[3]);
+
+    RotoPaintCompositor inCompositor;
+    inCompositor.addShapeLayer(eMergeIn, &shape[0], shapeBounds);
+    dst = composite(inCompositor, upstream, roi, roi);
+    EXPECT_FLOAT_EQ(1.f, pixelAt(dst, roi, 7, 5)[0]);
+    EXPECT_FLOAT_EQ(0.f, pixelAt(dst, roi, 0, 0)[3]);
+}
+
+TEST(RotoPaintCompositor, EraserRevealsBackground) {
+    const RectI roi(0, 0, 16, 16);
+    const std::vector<float> bg = makeImage(roi, 0.1f, 0.2f, 0.3f, 1.f);
+    const std::vector<float> shape = makeImage(roi, 1.f, 0.f, 0.f, 1.f);
+    const RectI maskBounds(4, 4, 12, 12);
+    std::vector<float> mask( (std::size_t)maskBounds.area(), 1.f );
+    // a soft edge on the first column of the mask
+    for (int y = 0; y < maskBounds.height(); ++y) {
+        mask[(std::size_t)y * maskBounds.width()] = 0.25f;
+    }
+    RotoPaintCompositor compositor;
+
+    compositor.setBackground(&bg[0], roi);
+    compositor.addShapeLayer(eMergeOver, &shape[0], roi);
+    compositor.addMaskedLayer(eMergeCopy, RotoPaintCompositor::eSourceBackground, &mask[0], maskBounds);
+    std::vector<float> dst = composite(compositor, bg, roi, roi);
+
+    EXPECT_FLOAT_EQ(1.f, pixelAt(dst, roi, 2, 2)[0]);
+    EXPECT_FLOAT_EQ(0.1f, pixelAt(dst, roi, 8, 8)[0]);
+    EXPECT_FLOAT_EQ(0.2f, pixelAt(dst, roi, 8, 8)[1]);
+    EXPECT_FLOAT_EQ(1.f * 0.75f + 0.1f * 0.25f, pixelAt(dst, roi, 4, 8)[0]);
+
+    // without background, the eraser makes the pixels transparent
+    RotoPaintCompositor noBgCompositor;
+    noBgCompositor.addShapeLayer(eMergeOver, &shape[0], roi);
+    noBgCompositor.addMaskedLayer(eMergeCopy, RotoPaintCompositor::eSourceBackground, &mask[0], maskBounds);
+    dst = composite(noBgCompositor, std::vector<float>(), RectI(), roi);
+    EXPECT_FLOAT_EQ(0.f, pixelAt(dst, roi, 8, 8)[0]);
+    EXPECT_FLOAT_EQ(0.f, pixelAt(dst, roi, 8, 8)[3]);
+    EXPECT_FLOAT_EQ(1.f, pixelAt(dst, roi, 2, 2)[3]);
+}
+
+TEST(RotoPaintCompositor, DodgeAndBurnUpstream) {
+    const RectI roi(0, 0, 8, 8);
+    const std::vector<float> upstream = makeImage(roi, 0.25f, 0.5f, 0.75f, 1.f);
+    std::vector<float> mask( (std::size_t)roi.area(), 1.f );
+    RotoPaintCompositor dodge;
+
+    dodge.addMaskedLayer(eMergeColorDodge, RotoPaintCompositor::eSourceUpstream, &mask[0], roi);
+    std::vector<float> dst = composite(dodge, upstream, roi, roi);
+    EXPECT_FLOAT_EQ(0.25f / 0.75f, dst[0]);
+    EXPECT_FLOAT_EQ(1.f, dst[1]);
+
+    RotoPaintCompositor burn;
+    burn.addMaskedLayer(eMergeColorBurn, RotoPaintCompositor::eSourceUpstream, &mask[0], roi);
+    dst = composite(burn, upstream, roi, roi);
+    EXPECT_FLOAT_EQ(0.f, dst[0]);
+    EXPECT_FLOAT_EQ(1.f - 0.25f / 0.75f, dst[2]);
+}
+
+TEST(RotoPaintCompositor, BackgroundShowsOutsideOfUpstream) {
+    const RectI roi(0, 0, 16, 16);
+    const std::vector<float> bg = makeImage(roi, 0.1f, 0.1f, 0.1f, 1.f);
+    const RectI upstreamBounds(4, 4, 12, 12);
+    const std::vector<float> upstream = makeImage(upstreamBounds, 0.9f, 0.9f, 0.9f, 1.f);
+    RotoPaintCompositor compositor;
+
+    compositor.setBackground(&bg[0], roi);
+    std::vector<float> dst = composite(compositor, upstream, upstreamBounds, roi);
+    EXPECT_FLOAT_EQ(0.1f, pixelAt(dst, roi, 0, 0)[0]);
+    EXPECT_FLOAT_EQ(0.1f, pixelAt(dst, roi, 2, 8)[0]);
+    EXPECT_FLOAT_EQ(0.9f, pixelAt(dst, roi, 8, 8)[0]);
+}
+
+// Many small strokes over a 1080p frame: only the painted area should matter
+TEST(RotoPaintCompositor, ManyStrokesMatchSequentialMerges) {
+    const RectI roi(0, 0, 1920, 1080);
+    const std::vector<float> bg = makeImage(roi, 0.3f, 0.3f, 0.3f, 1.f);
+    const int nStrokes = 2000;
+    std::vector<RectI> bounds(nStrokes);
+    std::vector<std::vector<float> > images(nStrokes);
+    RotoPaintCompositor compositor;
+
+    compositor.setBackground(&bg[0], roi);
+    for (int i = 0; i < nStrokes; ++i) {
+        const int x = (i * 97) % 1860;
+        const int y = (i * 61) % 1020;
+        bounds[i] = RectI(x, y, x + 60, y + 60);
+        const bool isEraser = i % 5 == 4;
+        if (isEraser) {
+            images[i].assign( (std::size_t)bounds[i].area(), 0.5f );
+            compositor.addMaskedLayer(eMergeCopy, RotoPaintCompositor::eSourceBackground, &images[i][0], bounds[i]);
+        } else {
+            images[i] = makeImage(bounds[i], 0.5f * (i % 3) / 2.f, 0.25f, 0.5f, 0.5f);
+            compositor.addShapeLayer(eMergeOver, &images[i][0], bounds[i]);
+        }
+    }
+
+    std::vector<float> dst = composite(compositor, bg, roi, roi);
+
+    // what the chain of Merge nodes computes, one stroke after the other
+    std::vector<float> expected = bg;
+    for (int i = 0; i < nStrokes; ++i) {
+        const bool isEraser = i % 5 == 4;
+        for (int y = bounds[i].y1; y < bounds[i].y2; ++y) {
+            for (int x = bounds[i].x1; x < bounds[i].x2; ++x) {
+                float* B = &expected[( (std::size_t)y * roi.width() + x ) * 4];
+                if (isEraser) {
+                    const float m = images[i][(std::size_t)(y - bounds[i].y1) * bounds[i].width() + (x - bounds[i].x1)];
+                    const float* bgPix = pixelAt(bg, roi, x, y);
+                    for (int c = 0; c < 4; ++c) {
+                        B[c] = B[c] * (1.f - m) + bgPix[c] * m;
+                    }
+                } else {
+                    const float* A = pixelAt(images[i], bounds[i], x, y);
+                    const float a = A[3];
+                    for (int c = 0; c < 4; ++c) {
+                        B[c] = A[c] + B[c] * (1.f - a);
+                    }
+                }
+            }
+        }
+    }
+    for (std::size_t i = 0; i < dst.size(); ++i) {
+        ASSERT_NEAR(expected[i], dst[i], 1e-5) << "pixel " << i / 4 << " channel " << i % 4;
+    }
+}
@@ -0,0 +1,278 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * (C) 2018-2023 The Natron developers
+ * (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "Engine/RectI.h"
+#include "Engine/RotoShapeRasterizer.h"
+
+NATRON_NAMESPACE_USING
+
+static Point
+makePoint(double x,
+          double y)
+{
+    Point p;
+
+    p.x = x;
+    p.y = y;
+
+    return p;
+}
+
+// Returns the coverage of roi, row by row
+static std::vector<float>
+rasterizeToBuffer(const RotoShapeRasterizer& rasterizer,
+                  const RectI& roi)
+{
+    std::vector<float> buffer( (std::size_t)roi.area(), -1.f );
+
+    rasterizer.rasterize(roi, [&](int y, const float* coverage) {
+        std::copy( coverage, coverage + roi.width(), &buffer[(std::size_t)(y - roi.y1) * roi.width()] );
+    });
+
+    return buffer;
+}
+
+static void
+addRectangle(RotoShapeRasterizer* rasterizer,
+             double x1,
+             double y1,
+             double x2,
+             double y2,
+             bool clockWise)
+{
+    std::vector<Point> contour;
+
+    contour.push_back( makePoint(x1, y1) );
+    if (clockWise) {
+        contour.push_back( makePoint(x1, y2) );
+        contour.push_back( makePoint(x2, y2) );
+        contour.push_back( makePoint(x2, y1) );
+    } else {
+        contour.push_back( makePoint(x2, y1) );
+        contour.push_back( makePoint(x2, y2) );
+        contour.push_back( makePoint(x1, y2) );
+    }
+    rasterizer->addContour( contour.begin(), contour.end() );
+}
+
+TEST(RotoShapeRasterizer, FillSamplesPixelCenters) {
+    RotoShapeRasterizer rasterizer;
+
+    rasterizer.beginLayer(1.);
+    // pixel centers are at .5: this covers the columns 10 to 19 and the rows 5 to 14
+    addRectangle(&rasterizer, 9.6, 4.6, 19.6, 14.6, false);
+    const RectI roi(0, 0, 32, 24);
+    std::vector<float> buffer = rasterizeToBuffer(rasterizer, roi);
+    for (int y = roi.y1; y < roi.y2; ++y) {
+        for (int x = roi.x1; x < roi.x2; ++x) {
+            const bool inside = x >= 10 && x < 20 && y >= 5 && y < 15;
+            EXPECT_EQ(inside ? 1.f : 0.f, buffer[y * roi.width() + x]) << "x=" << x << " y=" << y;
+        }
+    }
+}
+
+TEST(RotoShapeRasterizer, NonZeroWinding) {
+    const RectI roi(0, 0, 30, 30);
+
+    for (int sameOrientation = 0; sameOrientation < 2; ++sameOrientation) {
+        RotoShapeRasterizer rasterizer;
+        rasterizer.beginLayer(1.);
+        addRectangle(&rasterizer, 0, 0, 30, 30, false);
+        addRectangle(&rasterizer, 10, 10, 20, 20, sameOrientation == 0);
+        std::vector<float> buffer = rasterizeToBuffer(rasterizer, roi);
+        // a hole only if the inner contour turns the other way
+        EXPECT_EQ(sameOrientation ? 1.f : 0.f, buffer[15 * roi.width() + 15]);
+        EXPECT_EQ(1.f, buffer[5 * roi.width() + 5]);
+    }
+}
+
+TEST(RotoShapeRasterizer, FeatherRamp) {
+    for (int i = 0; i <= 10; ++i) {
+        const double s = i / 10.;
+        EXPECT_NEAR( (1. - s) * (1. - s), RotoShapeRasterizer::getFeatherCoverage(s, 1.), 1e-9 );
+    }
+    EXPECT_NEAR( 1., RotoShapeRasterizer::getFeatherCoverage(0., 3.), 1e-9 );
+    EXPECT_NEAR( 0., RotoShapeRasterizer::getFeatherCoverage(1., 0.3), 1e-9 );
+    // a larger falloff makes the feather fade faster
+    EXPECT_LT( RotoShapeRasterizer::getFeatherCoverage(0.3, 3.), RotoShapeRasterizer::getFeatherCoverage(0.3, 0.5) );
+
+    // a feather going from the shape at x = 0 to its edge at x = 100
+    const double fallOffs[] = { 1., 0.4, 2.5 };
+    for (int f = 0; f < 3; ++f) {
+        RotoShapeRasterizer rasterizer;
+        rasterizer.beginLayer(fallOffs[f]);
+        rasterizer.addFeatherTriangle(makePoint(0, 0), 0., makePoint(100, 0), 1., makePoint(100, 10), 1.);
+        rasterizer.addFeatherTriangle(makePoint(0, 0), 0., makePoint(100, 10), 1., makePoint(0, 10), 0.);
+        const RectI roi(-10, 0, 110, 10);
+        std::vector<float> buffer = rasterizeToBuffer(rasterizer, roi);
+        for (int y = roi.y1; y < roi.y2; ++y) {
+            for (int x = roi.x1; x < roi.x2; ++x) {
+                const double s = (x + 0.5) / 100.;
+                const double expected = (x < 0 || x >= 100) ? 0. : RotoShapeRasterizer::getFeatherCoverage(s, fallOffs[f]);
+                EXPECT_NEAR(expected, buffer[(y - roi.y1) * roi.width() + x - roi.x1], 1e-4) << "fallOff=" << fallOffs[f] << " x=" << x << " y=" << y;
+            }
+        }
+    }
+}
+
+TEST(RotoShapeRasterizer, LayersAreCompositedOver) {
+    RotoShapeRasterizer rasterizer;
+
+    // the feather of the first layer is covered by the inside of the second one
+    rasterizer.beginLayer(1.);
+    rasterizer.addFeatherTriangle(makePoint(0, 0), 0.5, makePoint(20, 0), 0.5, makePoint(0, 20), 0.5);
+    rasterizer.beginLayer(1.);
+    addRectangle(&rasterizer, 0, 0, 5, 20, false);
+    rasterizer.addFeatherTriangle(makePoint(0, 0), 0.5, makePoint(20, 0), 0.5, makePoint(20, 20), 0.5);
+    const RectI roi(0, 0, 20, 20);
+    std::vector<float> buffer = rasterizeToBuffer(rasterizer, roi);
+    const float f = 0.25f;
+    EXPECT_FLOAT_EQ(1.f, buffer[2 * roi.width() + 2]);
+    // only the first feather
+    EXPECT_FLOAT_EQ(f, buffer[10 * roi.width() + 7]);
+    // only the second feather
+    EXPECT_FLOAT_EQ(f, buffer[7 * roi.width() + 15]);
+    // both feathers
+    EXPECT_FLOAT_EQ(f + f * (1.f - f), buffer[2 * roi.width() + 7]);
+}
+
+TEST(RotoShapeRasterizer, AccumulatedLayersAreAveraged) {
+    RotoShapeRasterizer rasterizer;
+
+    // 4 motion blur samples of a rectangle moving by 2 pixels along x
+    for (int i = 0; i < 4; ++i) {
+        rasterizer.beginAccumulatedLayer(1., 0.25);
+        addRectangle(&rasterizer, 2 * i, 0, 2 * i + 10, 10, false);
+    }
+    const RectI roi(0, 0, 20, 10);
+    std::vector<float> buffer = rasterizeToBuffer(rasterizer, roi);
+    for (int x = roi.x1; x < roi.x2; ++x) {
+        // the number of samples covering the column
+        int expected = 0;
+        for (int i = 0; i < 4; ++i) {
+            if ( (x >= 2 * i) && (x < 2 * i + 10) ) {
+                ++expected;
+            }
+        }
+        EXPECT_FLOAT_EQ(expected * 0.25f, buffer[5 * roi.width() + x]) << "x=" << x;
+    }
+
+    // the feather of each sample is composited over its own inside before being accumulated
+    RotoShapeRasterizer feathered;
+    const float f = 0.25f;
+    feathered.beginAccumulatedLayer(1., 0.5);
+    addRectangle(&feathered, 0, 0, 5, 20, false);
+    feathered.addFeatherTriangle(makePoint(0, 0), 0.5, makePoint(20, 0), 0.5, makePoint(0, 20), 0.5);
+    feathered.beginAccumulatedLayer(1., 0.5);
+    feathered.addFeatherTriangle(makePoint(0, 0), 0.5, makePoint(20, 0), 0.5, makePoint(20, 20), 0.5);
+    const RectI roi2(0, 0, 20, 20);
+    buffer = rasterizeToBuffer(feathered, roi2);
+    // only the inside of the first sample, its feather does not add to it
+    EXPECT_FLOAT_EQ(0.5f, buffer[3 * roi2.width() + 1]);
+    // both feathers
+    EXPECT_FLOAT_EQ(f, buffer[2 * roi2.width() + 7]);
+    // only the second feather
+    EXPECT_FLOAT_EQ(0.5f * f, buffer[7 * roi2.width() + 15]);
+    EXPECT_FLOAT_EQ(0.f, buffer[16 * roi2.width() + 12]);
+}
+
+// A star-like shape with a feather, as renderBezier does it
+static void
+addFeatheredShape(RotoShapeRasterizer* rasterizer,
+                 double cx,
+                 double cy,
+                 double radius,
+                 double featherDist,
+                 int nPoints)
+{
+    std::vector<Point> contour, feather;
+
+    for (int i = 0; i < nPoints; ++i) {
+        const double a = 2. * M_PI * i / nPoints;
+        const double r = radius * ( 1. + 0.3 * std::sin(5. * a) );
+        contour.push_back( makePoint(cx + r * std::cos(a), cy + r * std::sin(a) ) );
+        feather.push_back( makePoint(cx + (r + featherDist) * std::cos(a), cy + (r + featherDist) * std::sin(a) ) );
+    }
+    rasterizer->addContour( contour.begin(), contour.end() );
+    for (int i = 0; i < nPoints; ++i) {
+        const int j = (i + 1) % nPoints;
+        rasterizer->addFeatherTriangle(contour[i], 0., feather[i], 1., feather[j], 1.);
+        rasterizer->addFeatherTriangle(contour[i], 0., feather[j], 1., contour[j], 0.);
+    }
+}
+
+TEST(RotoShapeRasterizer, BandsMatchRows) {
+    RotoShapeRasterizer rasterizer;
+
+    rasterizer.beginLayer(0.7);
+    addFeatheredShape(&rasterizer, 300, 200, 150, 40, 90);
+    rasterizer.beginLayer(1.5);
+    addFeatheredShape(&rasterizer, 330, 210, 150, 40, 90);
+    const RectI roi(0, 0, 640, 480);
+
+    // the roi is large enough to be rendered in parallel bands
+    std::vector<float> buffer = rasterizeToBuffer(rasterizer, roi);
+    for (int y = roi.y1; y < roi.y2; ++y) {
+        const RectI row(roi.x1, y, roi.x2, y + 1);
+        std::vector<float> rowBuffer = rasterizeToBuffer(rasterizer, row);
+        for (int x = roi.x1; x < roi.x2; ++x) {
+            ASSERT_EQ(rowBuffer[x - roi.x1], buffer[(y - roi.y1) * roi.width() + x - roi.x1]) << "x=" << x << " y=" << y;
+        }
+    }
+    // sanity checks
+    EXPECT_EQ(1.f, buffer[200 * roi.width() + 300]);
+    EXPECT_EQ(0.f, buffer[5 * roi.width() + 5]);
+}
+
+// Not a correctness test: prints the time taken to rasterize feathered shapes over a 4K image.
+// Disabled by default, run it with --gtest_also_run_disabled_tests.
+TEST(RotoShapeRasterizer, DISABLED_Benchmark4K) {
+    const RectI format(0, 0, 3840, 2160);
+    std::vector<float> buffer( (std::size_t)format.area() );
+
+    // 200 shapes of 10 control points evaluated with 50 points per segment, each rendered in its bounding box
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 200; ++i) {
+        const double cx = 200 + (i % 20) * 170;
+        const double cy = 200 + (i / 20) * 170;
+        RotoShapeRasterizer rasterizer;
+        rasterizer.beginLayer(1.);
+        addFeatheredShape(&rasterizer, cx, cy, 100, 30, 500);
+        const RectI roi( (int)cx - 170, (int)cy - 170, (int)cx + 170, (int)cy + 170 );
+        rasterizer.rasterize(roi, [&](int y, const float* coverage) {
+            std::copy( coverage, coverage + roi.width(), &buffer[(std::size_t)y * format.width() + roi.x1] );
+        });
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "200 feathered shapes of 340x340 pixels: " << elapsed * 1e3 << " ms" << std::endl;
+}
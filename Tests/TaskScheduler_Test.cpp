@@ -0,0 +1,142 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * (C) 2018-2023 The Natron developers
+ * (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
+
+#include <gtest/gtest.h>
+
+#include "Engine/TaskScheduler.h"
+
+NATRON_NAMESPACE_USING
+
+TEST(TaskScheduler,
+     ParallelFor)
+{
+    TaskScheduler scheduler;
+    const int n = 1000;
+    std::vector<std::atomic<int> > counts(n);
+
+    for (int i = 0; i < n; ++i) {
+        counts[i] = 0;
+    }
+
+    TaskSchedulerStats stats;
+    scheduler.parallelFor(n, [&](int i) {
+        ++counts[i];
+    }, &stats);
+
+    for (int i = 0; i < n; ++i) {
+        EXPECT_EQ( 1, counts[i].load() ) << "task " << i << " must run exactly once";
+    }
+    EXPECT_EQ(n, stats.nTasks);
+    EXPECT_GE(stats.nTasksStolen, 0);
+    EXPECT_LE(stats.nTasksStolen, n);
+
+    // Nothing to do
+    scheduler.parallelFor(0, [&](int) {
+        ADD_FAILURE() << "no task expected";
+    });
+}
+
+TEST(TaskScheduler,
+     NestedParallelFor)
+{
+    // Nested calls, as when a tile rendered with host frame threading renders its inputs, must neither deadlock
+    // nor skip tasks
+    TaskScheduler scheduler;
+    const int nOuter = 16;
+    const int nInner = 64;
+    std::vector<std::atomic<int> > counts(nOuter * nInner);
+
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+        counts[i] = 0;
+    }
+
+    scheduler.parallelFor(nOuter, [&](int i) {
+        scheduler.parallelFor(nInner, [&, i](int j) {
+            ++counts[i * nInner + j];
+        });
+    });
+
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+        EXPECT_EQ( 1, counts[i].load() );
+    }
+}
+
+TEST(TaskScheduler,
+     Exception)
+{
+    TaskScheduler scheduler;
+    std::atomic<int> nRun(0);
+
+    EXPECT_THROW(scheduler.parallelFor(100, [&](int i) {
+        ++nRun;
+        if (i == 42) {
+            throw std::runtime_error("task failed");
+        }
+    }), std::runtime_error);
+
+    // The other tasks still run
+    EXPECT_EQ( 100, nRun.load() );
+
+    // The scheduler is still usable
+    nRun = 0;
+    scheduler.parallelFor(100, [&](int) {
+        ++nRun;
+    });
+    EXPECT_EQ( 100, nRun.load() );
+}
+
+TEST(TaskScheduler,
+     Start)
+{
+    TaskScheduler scheduler;
+    const int n = 200;
+    QMutex mutex;
+    QWaitCondition cond;
+    int nDone = 0;
+
+    for (int i = 0; i < n; ++i) {
+        scheduler.start([&]() {
+            QMutexLocker k(&mutex);
+            ++nDone;
+            cond.wakeAll();
+        });
+    }
+
+    QMutexLocker k(&mutex);
+    while (nDone < n) {
+        cond.wait(&mutex);
+    }
+    EXPECT_EQ(n, nDone);
+    EXPECT_TRUE( !TaskScheduler::isWorkerThread() );
+}
@@ -44,14 +44,21 @@ SOURCES += \
     google-test/src/gtest-all.cc \
     google-mock/src/gmock-all.cc \
     BaseTest.cpp \
+    BezierPolygonCache_Test.cpp \
+    Cache_Test.cpp \
     Curve_Test.cpp \
     FileSystemModel_Test.cpp \
     Hash64_Test.cpp \
+    Histogram_Test.cpp \
     Image_Test.cpp \
     KnobFile_Test.cpp \
     Lut_Test.cpp \
     OSGLContext_Test.cpp \
+    RotoPaintCompositor_Test.cpp \
+    RotoShapeRasterizer_Test.cpp \
+    TaskScheduler_Test.cpp \
     Tracker_Test.cpp \
+    UpdateViewerParams_Test.cpp \
     wmain.cpp
 
 HEADERS += \
@@ -0,0 +1,134 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <https://natrongithub.github.io/>,
+ * (C) 2018-2023 The Natron developers
+ * (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <list>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "Engine/UpdateViewerParams.h"
+
+NATRON_NAMESPACE_USING
+
+// A grid of nx * ny tiles of the given size, none of them rendered
+static std::list<UpdateViewerParams::CachedTile>
+makeTiles(int nx,
+          int ny,
+          int tileSize)
+{
+    std::list<UpdateViewerParams::CachedTile> tiles;
+
+    for (int y = 0; y < ny; ++y) {
+        for (int x = 0; x < nx; ++x) {
+            UpdateViewerParams::CachedTile tile;
+            tile.rectRounded = RectI(x * tileSize, y * tileSize, (x + 1) * tileSize, (y + 1) * tileSize);
+            tiles.push_back(tile);
+        }
+    }
+
+    return tiles;
+}
+
+TEST(UpdateViewerParams,
+     TilesRenderPassesGrowFromFocus)
+{
+    const int tileSize = 256;
+    const std::list<UpdateViewerParams::CachedTile> tiles = makeTiles(8, 8, tileSize);
+    const RectI roi(0, 0, 8 * tileSize, 8 * tileSize);
+    // Focus in the tile (5, 2)
+    const RectI focusTile(5 * tileSize, 2 * tileSize, 6 * tileSize, 3 * tileSize);
+    std::vector<RectI> passes;
+
+    UpdateViewerParams::getTilesRenderPasses(tiles, roi, 5.5 * tileSize, 2.5 * tileSize, &passes);
+
+    ASSERT_FALSE( passes.empty() );
+    EXPECT_EQ(focusTile, passes.front());
+    EXPECT_EQ(roi, passes.back());
+    // One pass per doubling of the number of tiles at most
+    EXPECT_LE(passes.size(), 7u);
+    for (std::size_t i = 1; i < passes.size(); ++i) {
+        EXPECT_TRUE( passes[i].contains(passes[i - 1]) ) << "pass " << i;
+        EXPECT_NE(passes[i], passes[i - 1]) << "pass " << i;
+        EXPECT_TRUE( roi.contains(passes[i]) ) << "pass " << i;
+    }
+}
+
+TEST(UpdateViewerParams,
+     TilesRenderPassesSkipRenderedTiles)
+{
+    const int tileSize = 256;
+    std::list<UpdateViewerParams::CachedTile> tiles = makeTiles(4, 4, tileSize);
+    const RectI roi(0, 0, 4 * tileSize, 4 * tileSize);
+    // Only the tiles (3, 3) and (0, 3) are left to render: the focus tile (0, 0) is already cached
+    for (std::list<UpdateViewerParams::CachedTile>::iterator it = tiles.begin(); it != tiles.end(); ++it) {
+        it->isCached = it->rectRounded.y1 != 3 * tileSize || (it->rectRounded.x1 != 0 && it->rectRounded.x1 != 3 * tileSize);
+    }
+    std::vector<RectI> passes;
+
+    UpdateViewerParams::getTilesRenderPasses(tiles, roi, 0.5 * tileSize, 0.5 * tileSize, &passes);
+
+    ASSERT_EQ(2u, passes.size());
+    EXPECT_EQ(RectI(0, 3 * tileSize, tileSize, 4 * tileSize), passes[0]);
+    EXPECT_EQ(roi, passes[1]);
+}
+
+TEST(UpdateViewerParams,
+     TilesRenderPassesClipToRoI)
+{
+    const int tileSize = 256;
+    const std::list<UpdateViewerParams::CachedTile> tiles = makeTiles(4, 4, tileSize);
+    // The RoI does not cover the whole tiles on its borders
+    const RectI roi(100, 50, 4 * tileSize - 30, 4 * tileSize - 70);
+    std::vector<RectI> passes;
+
+    UpdateViewerParams::getTilesRenderPasses(tiles, roi, 0., 0., &passes);
+
+    ASSERT_FALSE( passes.empty() );
+    EXPECT_EQ(RectI(100, 50, tileSize, tileSize), passes.front());
+    EXPECT_EQ(roi, passes.back());
+    for (std::size_t i = 0; i < passes.size(); ++i) {
+        EXPECT_TRUE( roi.contains(passes[i]) ) << "pass " << i;
+    }
+}
+
+TEST(UpdateViewerParams,
+     TilesRenderPassesNothingToRender)
+{
+    const int tileSize = 256;
+    std::list<UpdateViewerParams::CachedTile> tiles = makeTiles(4, 4, tileSize);
+    const RectI roi(0, 0, 4 * tileSize, 4 * tileSize);
+    for (std::list<UpdateViewerParams::CachedTile>::iterator it = tiles.begin(); it != tiles.end(); ++it) {
+        it->isCached = true;
+    }
+    std::vector<RectI> passes;
+
+    UpdateViewerParams::getTilesRenderPasses(tiles, roi, 0., 0., &passes);
+
+    // The whole RoI is still rendered once, in a single pass
+    ASSERT_EQ(1u, passes.size());
+    EXPECT_EQ(roi, passes[0]);
+}